@@ -0,0 +1,67 @@
+SET search_path TO documentdb_api_catalog;
+
+SET citus.next_shard_id TO 457000;
+SET documentdb.next_collection_id TO 4570;
+SET documentdb.next_collection_index_id TO 4570;
+
+-- Sliding frames remove the departing rows incrementally, which must match recomputing the frame
+SELECT documentdb_api.insert_one('db','slidingWindow','{ "_id": 1, "a": 3 }', NULL);
+SELECT documentdb_api.insert_one('db','slidingWindow','{ "_id": 2, "a": 1 }', NULL);
+SELECT documentdb_api.insert_one('db','slidingWindow','{ "_id": 3, "a": 1 }', NULL);
+SELECT documentdb_api.insert_one('db','slidingWindow','{ "_id": 4, "a": 4 }', NULL);
+SELECT documentdb_api.insert_one('db','slidingWindow','{ "_id": 5, "a": 1 }', NULL);
+SELECT documentdb_api.insert_one('db','slidingWindow','{ "_id": 6, "a": 2 }', NULL);
+
+SET documentdb.enableWindowAggregateInverseTransition TO on;
+SELECT document FROM documentdb_api_catalog.bson_aggregation_pipeline('db',
+    '{ "aggregate": "slidingWindow", "pipeline":  [{"$setWindowFields": {"sortBy": {"_id": 1}, "output": {"min": { "$min": "$a", "window": {"documents": [-1, 1]}}, "max": { "$max": "$a", "window": {"documents": [-1, 1]}}, "minN": { "$minN": {"input": "$a", "n": 2}, "window": {"documents": [-1, 1]}}, "set": { "$addToSet": "$a", "window": {"documents": [-1, 1]}}}}}, {"$project": {"a": 0}}]}');
+
+SET documentdb.enableWindowAggregateInverseTransition TO off;
+SELECT document FROM documentdb_api_catalog.bson_aggregation_pipeline('db',
+    '{ "aggregate": "slidingWindow", "pipeline":  [{"$setWindowFields": {"sortBy": {"_id": 1}, "output": {"min": { "$min": "$a", "window": {"documents": [-1, 1]}}, "max": { "$max": "$a", "window": {"documents": [-1, 1]}}, "minN": { "$minN": {"input": "$a", "n": 2}, "window": {"documents": [-1, 1]}}, "set": { "$addToSet": "$a", "window": {"documents": [-1, 1]}}}}}, {"$project": {"a": 0}}]}');
+
+-- Two partitions with ties on the sort key and the values, nulls and missing fields
+SELECT COUNT(documentdb_api.insert_one('db', 'slidingWindowCompare',
+    FORMAT('{ "_id": %s, "g": %s, "t": %s, "s": %s %s }', i, i % 2, i / 4, (i * 13) % 7,
+        CASE WHEN i % 11 = 0 THEN '' WHEN i % 7 = 0 THEN ', "a": null' ELSE FORMAT(', "a": %s', (i * 7) % 5) END)::documentdb_core.bson,
+    NULL)) FROM generate_series(1, 200) i;
+
+-- Each pipeline runs with the inverse transition on and off, the results must be the same
+\set pipeline '{ "aggregate": "slidingWindowCompare", "pipeline":  [{"$setWindowFields": {"partitionBy": "$g", "sortBy": {"_id": 1}, "output": {"min": { "$min": "$a", "window": {"documents": [-3, 2]}}, "max": { "$max": "$a", "window": {"documents": [-3, 2]}}, "minN": { "$minN": {"input": "$a", "n": 3}, "window": {"documents": [-3, 2]}}, "maxN": { "$maxN": {"input": "$a", "n": 3}, "window": {"documents": [-3, 2]}}, "set": { "$addToSet": "$a", "window": {"documents": [-3, 2]}}}}}]}'
+SET documentdb.enableWindowAggregateInverseTransition TO on;
+CREATE TEMP TABLE incremental AS SELECT document::text FROM documentdb_api_catalog.bson_aggregation_pipeline('db', :'pipeline');
+SET documentdb.enableWindowAggregateInverseTransition TO off;
+CREATE TEMP TABLE recomputed AS SELECT document::text FROM documentdb_api_catalog.bson_aggregation_pipeline('db', :'pipeline');
+SELECT (SELECT COUNT(*) FROM incremental) AS rows, (SELECT COUNT(*) FROM (SELECT * FROM incremental EXCEPT SELECT * FROM recomputed UNION ALL (SELECT * FROM recomputed EXCEPT SELECT * FROM incremental)) q) AS mismatches;
+DROP TABLE incremental, recomputed;
+
+-- $top, $bottom, $topN and $bottomN break ties on their sort key in the order the rows were added
+\set pipeline '{ "aggregate": "slidingWindowCompare", "pipeline":  [{"$setWindowFields": {"partitionBy": "$g", "sortBy": {"_id": 1}, "output": {"top": { "$top": {"output": "$_id", "sortBy": {"a": 1}}, "window": {"documents": [-4, 0]}}, "bottom": { "$bottom": {"output": "$_id", "sortBy": {"a": 1}}, "window": {"documents": [-4, 0]}}, "topN": { "$topN": {"output": ["$_id", "$a"], "sortBy": {"a": -1}, "n": 2}, "window": {"documents": [-4, 0]}}, "bottomN": { "$bottomN": {"output": "$a", "sortBy": {"s": 1}, "n": 3}, "window": {"documents": [-4, 0]}}}}}]}'
+SET documentdb.enableWindowAggregateInverseTransition TO on;
+CREATE TEMP TABLE incremental AS SELECT document::text FROM documentdb_api_catalog.bson_aggregation_pipeline('db', :'pipeline');
+SET documentdb.enableWindowAggregateInverseTransition TO off;
+CREATE TEMP TABLE recomputed AS SELECT document::text FROM documentdb_api_catalog.bson_aggregation_pipeline('db', :'pipeline');
+SELECT (SELECT COUNT(*) FROM incremental) AS rows, (SELECT COUNT(*) FROM (SELECT * FROM incremental EXCEPT SELECT * FROM recomputed UNION ALL (SELECT * FROM recomputed EXCEPT SELECT * FROM incremental)) q) AS mismatches;
+DROP TABLE incremental, recomputed;
+
+-- Range frames over a sort key with ties add and remove several rows at once
+\set pipeline '{ "aggregate": "slidingWindowCompare", "pipeline":  [{"$setWindowFields": {"partitionBy": "$g", "sortBy": {"t": 1}, "output": {"min": { "$min": "$a", "window": {"range": [-2, 0]}}, "max": { "$max": "$s", "window": {"range": [-1, 1]}}, "maxN": { "$maxN": {"input": "$a", "n": 2}, "window": {"range": [-2, 0]}}, "set": { "$addToSet": "$s", "window": {"range": [-1, 1]}}, "top": { "$top": {"output": "$_id", "sortBy": {"s": -1}}, "window": {"range": [-3, -1]}}}}}]}'
+SET documentdb.enableWindowAggregateInverseTransition TO on;
+CREATE TEMP TABLE incremental AS SELECT document::text FROM documentdb_api_catalog.bson_aggregation_pipeline('db', :'pipeline');
+SET documentdb.enableWindowAggregateInverseTransition TO off;
+CREATE TEMP TABLE recomputed AS SELECT document::text FROM documentdb_api_catalog.bson_aggregation_pipeline('db', :'pipeline');
+SELECT (SELECT COUNT(*) FROM incremental) AS rows, (SELECT COUNT(*) FROM (SELECT * FROM incremental EXCEPT SELECT * FROM recomputed UNION ALL (SELECT * FROM recomputed EXCEPT SELECT * FROM incremental)) q) AS mismatches;
+DROP TABLE incremental, recomputed;
+
+-- $addToSet keeps a value while any of its duplicates is still in the frame
+\set pipeline '{ "aggregate": "slidingWindowCompare", "pipeline":  [{"$setWindowFields": {"sortBy": {"_id": 1}, "output": {"set": { "$addToSet": "$s", "window": {"documents": [-5, 0]}}, "nullableSet": { "$addToSet": "$a", "window": {"documents": [-12, -1]}}}}}]}'
+SET documentdb.enableWindowAggregateInverseTransition TO on;
+CREATE TEMP TABLE incremental AS SELECT document::text FROM documentdb_api_catalog.bson_aggregation_pipeline('db', :'pipeline');
+SET documentdb.enableWindowAggregateInverseTransition TO off;
+CREATE TEMP TABLE recomputed AS SELECT document::text FROM documentdb_api_catalog.bson_aggregation_pipeline('db', :'pipeline');
+SELECT (SELECT COUNT(*) FROM incremental) AS rows, (SELECT COUNT(*) FROM (SELECT * FROM incremental EXCEPT SELECT * FROM recomputed UNION ALL (SELECT * FROM recomputed EXCEPT SELECT * FROM incremental)) q) AS mismatches;
+DROP TABLE incremental, recomputed;
+
+RESET documentdb.enableWindowAggregateInverseTransition;
+SELECT documentdb_api.drop_collection('db', 'slidingWindow');
+SELECT documentdb_api.drop_collection('db', 'slidingWindowCompare');
@@ -0,0 +1,62 @@
+SET search_path TO documentdb_api,documentdb_api_catalog,documentdb_api_internal,documentdb_core;
+
+SET citus.next_shard_id TO 461000;
+SET documentdb.next_collection_id TO 4610;
+SET documentdb.next_collection_index_id TO 4610;
+
+set documentdb.enableExtendedExplainPlans to on;
+
+-- if documentdb_extended_rum exists, set alternate index handler
+SELECT pg_catalog.set_config('documentdb.alternate_index_handler_name', 'extended_rum', false), extname FROM pg_extension WHERE extname = 'documentdb_extended_rum';
+
+SELECT documentdb_api.create_collection('skip_db', 'skip_scan');
+SELECT documentdb_api_internal.create_indexes_non_concurrently('skip_db', '{ "createIndexes": "skip_scan", "indexes": [ { "key": { "tenant": 1, "ts": 1 }, "enableCompositeTerm": true, "name": "tenant_ts" }] }', true);
+
+-- 5 tenants with 200 timestamps each
+SELECT COUNT(documentdb_api.insert_one('skip_db', 'skip_scan', FORMAT('{ "_id": %s, "tenant": "t%s", "ts": %s }', i, i % 5, i / 5)::bson)) FROM generate_series(0, 999) AS i;
+ANALYZE documentdb_data.documents_4611;
+
+-- The results of a scan of the whole collection to compare with
+CREATE TEMP TABLE range_expected AS SELECT document::text FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": { "$gte": 10, "$lt": 15 } } }');
+CREATE TEMP TABLE equal_expected AS SELECT document::text FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": 20 } }');
+SELECT (SELECT COUNT(*) FROM range_expected) AS range_rows, (SELECT COUNT(*) FROM equal_expected) AS equal_rows;
+
+-- Without the skip scan the index can't serve a query that doesn't filter on tenant
+set documentdb.enableCompositeIndexSkipScan to off;
+SELECT bool_or(line ~ 'Bitmap Index Scan on tenant_ts') AS uses_index, bool_or(line ~ 'entryRangeSkips: [1-9]') AS skips FROM documentdb_distributed_test_helpers.run_explain_and_trim($cmd$ EXPLAIN (COSTS OFF, ANALYZE ON, BUFFERS OFF, SUMMARY OFF, TIMING OFF) SELECT document FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": { "$gte": 10, "$lt": 15 } } }') $cmd$) line;
+SELECT bool_or(line ~ 'Bitmap Index Scan on tenant_ts') AS uses_index, bool_or(line ~ 'entryRangeSkips: [1-9]') AS skips FROM documentdb_distributed_test_helpers.run_explain_and_trim($cmd$ EXPLAIN (COSTS OFF, ANALYZE ON, BUFFERS OFF, SUMMARY OFF, TIMING OFF) SELECT document FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": 20 } }') $cmd$) line;
+CREATE TEMP TABLE range_actual AS SELECT document::text FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": { "$gte": 10, "$lt": 15 } } }');
+CREATE TEMP TABLE equal_actual AS SELECT document::text FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": 20 } }');
+SELECT (SELECT COUNT(*) FROM (SELECT * FROM range_actual EXCEPT SELECT * FROM range_expected UNION ALL (SELECT * FROM range_expected EXCEPT SELECT * FROM range_actual)) q) AS range_mismatches,
+       (SELECT COUNT(*) FROM (SELECT * FROM equal_actual EXCEPT SELECT * FROM equal_expected UNION ALL (SELECT * FROM equal_expected EXCEPT SELECT * FROM equal_actual)) q) AS equal_mismatches;
+DROP TABLE range_actual, equal_actual;
+
+-- With it, the bitmap scan of the index seeks to the range of each tenant
+set documentdb.enableCompositeIndexSkipScan to on;
+set documentdb_rum.enablePartialMatchSkipScan to on;
+set enable_seqscan to off;
+set enable_indexscan to off;
+SELECT bool_or(line ~ 'Bitmap Index Scan on tenant_ts') AS uses_index, bool_or(line ~ 'entryRangeSkips: [1-9]') AS skips FROM documentdb_distributed_test_helpers.run_explain_and_trim($cmd$ EXPLAIN (COSTS OFF, ANALYZE ON, BUFFERS OFF, SUMMARY OFF, TIMING OFF) SELECT document FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": { "$gte": 10, "$lt": 15 } } }') $cmd$) line;
+SELECT bool_or(line ~ 'Bitmap Index Scan on tenant_ts') AS uses_index, bool_or(line ~ 'entryRangeSkips: [1-9]') AS skips FROM documentdb_distributed_test_helpers.run_explain_and_trim($cmd$ EXPLAIN (COSTS OFF, ANALYZE ON, BUFFERS OFF, SUMMARY OFF, TIMING OFF) SELECT document FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": 20 } }') $cmd$) line;
+CREATE TEMP TABLE range_actual AS SELECT document::text FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": { "$gte": 10, "$lt": 15 } } }');
+CREATE TEMP TABLE equal_actual AS SELECT document::text FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": 20 } }');
+SELECT (SELECT COUNT(*) FROM (SELECT * FROM range_actual EXCEPT SELECT * FROM range_expected UNION ALL (SELECT * FROM range_expected EXCEPT SELECT * FROM range_actual)) q) AS range_mismatches,
+       (SELECT COUNT(*) FROM (SELECT * FROM equal_actual EXCEPT SELECT * FROM equal_expected UNION ALL (SELECT * FROM equal_expected EXCEPT SELECT * FROM equal_actual)) q) AS equal_mismatches;
+DROP TABLE range_actual, equal_actual;
+
+-- The same scan walks all the entries in between when the runtime skip is off
+set documentdb_rum.enablePartialMatchSkipScan to off;
+SELECT bool_or(line ~ 'Bitmap Index Scan on tenant_ts') AS uses_index, bool_or(line ~ 'entryRangeSkips: [1-9]') AS skips FROM documentdb_distributed_test_helpers.run_explain_and_trim($cmd$ EXPLAIN (COSTS OFF, ANALYZE ON, BUFFERS OFF, SUMMARY OFF, TIMING OFF) SELECT document FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": { "$gte": 10, "$lt": 15 } } }') $cmd$) line;
+SELECT bool_or(line ~ 'Bitmap Index Scan on tenant_ts') AS uses_index, bool_or(line ~ 'entryRangeSkips: [1-9]') AS skips FROM documentdb_distributed_test_helpers.run_explain_and_trim($cmd$ EXPLAIN (COSTS OFF, ANALYZE ON, BUFFERS OFF, SUMMARY OFF, TIMING OFF) SELECT document FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": 20 } }') $cmd$) line;
+CREATE TEMP TABLE range_actual AS SELECT document::text FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": { "$gte": 10, "$lt": 15 } } }');
+CREATE TEMP TABLE equal_actual AS SELECT document::text FROM bson_aggregation_find('skip_db', '{ "find": "skip_scan", "filter": { "ts": 20 } }');
+SELECT (SELECT COUNT(*) FROM (SELECT * FROM range_actual EXCEPT SELECT * FROM range_expected UNION ALL (SELECT * FROM range_expected EXCEPT SELECT * FROM range_actual)) q) AS range_mismatches,
+       (SELECT COUNT(*) FROM (SELECT * FROM equal_actual EXCEPT SELECT * FROM equal_expected UNION ALL (SELECT * FROM equal_expected EXCEPT SELECT * FROM equal_actual)) q) AS equal_mismatches;
+DROP TABLE range_actual, equal_actual;
+
+reset enable_seqscan;
+reset enable_indexscan;
+reset documentdb.enableCompositeIndexSkipScan;
+reset documentdb_rum.enablePartialMatchSkipScan;
+DROP TABLE range_expected, equal_expected;
+SELECT documentdb_api.drop_collection('skip_db', 'skip_scan');
@@ -0,0 +1,102 @@
+SET search_path TO documentdb_api_catalog;
+
+SET citus.next_shard_id TO 459000;
+SET documentdb.next_collection_id TO 4590;
+SET documentdb.next_collection_index_id TO 4590;
+
+-- Points every 0.5 from 0 to 12, as legacy pairs in "p" and GeoJSON in "g", the shapes below have their edges and corners on them
+SELECT COUNT(documentdb_api.insert_one('db', 'geoPrepared',
+    FORMAT('{ "_id": %s, "p": [ %s, %s ], "g": { "type": "Point", "coordinates": [ %s, %s ] } }', i, x, y, x, y)::documentdb_core.bson, NULL))
+FROM (SELECT i, (i % 25) / 2.0::float8 AS x, (i / 25) / 2.0::float8 AS y FROM generate_series(0, 624) i) points;
+
+-- Points just off the corners and edges of the shapes
+SELECT COUNT(documentdb_api.insert_one('db', 'geoPrepared',
+    FORMAT('{ "_id": %s, "p": [ %s, %s ], "g": { "type": "Point", "coordinates": [ %s, %s ] } }', i, x, y, x, y)::documentdb_core.bson, NULL))
+FROM (VALUES (1000, 4.0000000001, 4.0000000001), (1001, 3.9999999999, 4.0000000001), (1002, 4.0000000001, 3.9999999999),
+             (1003, 10.0000000001, 2), (1004, 9.9999999999, 2), (1005, 6.0000000001, 5.9999999999),
+             (1006, 5.9999999999, 6.0000000001), (1007, 8, 2.0000000001), (1008, 7.9999999999, 5), (1009, 5, 8.0000000001)) AS points(i, x, y);
+
+-- Multikey values: two legacy pairs in "p", a GeoJSON point and a line in "g"
+SELECT COUNT(documentdb_api.insert_one('db', 'geoPrepared',
+    FORMAT('{ "_id": %s, "p": [ [ %s, %s ], [ %s, %s ] ], "g": [ { "type": "Point", "coordinates": [ %s, %s ] }, { "type": "LineString", "coordinates": [ [ %s, %s ], [ %s, %s ] ] } ] }',
+        2000 + i, i % 13, 12 - i % 7, 13 - i % 5, i % 11, i % 13, 12 - i % 7, 13 - i % 5, i % 11, 14 - i % 5, i % 11 + 1)::documentdb_core.bson, NULL))
+FROM generate_series(0, 59) i;
+
+-- Each query runs with the prepared query on and off, the results must be the same
+-- $box with the points on its edges
+\set filter '{ "p": { "$geoWithin": { "$box": [ [ 2, 2 ], [ 8, 6 ] ] } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+
+-- A concave $polygon: points on its edges and corners, and inside its bounds but outside of it
+\set filter '{ "p": { "$geoWithin": { "$polygon": [ [ 0, 0 ], [ 10, 0 ], [ 10, 4 ], [ 4, 4 ], [ 4, 10 ], [ 0, 10 ] ] } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+
+-- A $polygon with a diagonal edge
+\set filter '{ "p": { "$geoWithin": { "$polygon": [ [ 0, 0 ], [ 12, 0 ], [ 0, 12 ] ] } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+
+-- A star shaped $polygon whose edges span several bands
+\set filter '{ "p": { "$geoWithin": { "$polygon": [ [ 6, 0 ], [ 8, 5 ], [ 12, 6 ], [ 8, 7 ], [ 6, 12 ], [ 4, 7 ], [ 0, 6 ], [ 4, 5 ] ] } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+
+-- $center with the points on the circle
+\set filter '{ "p": { "$geoWithin": { "$center": [ [ 5, 5 ], 3 ] } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+
+-- Spherical shapes: the points within their bounding box are left to postgis
+\set filter '{ "g": { "$geoWithin": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ 0, 0 ], [ 10, 0 ], [ 10, 4 ], [ 4, 4 ], [ 4, 10 ], [ 0, 10 ], [ 0, 0 ] ] ] } } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+\set filter '{ "g": { "$geoIntersects": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ 0, 0 ], [ 10, 0 ], [ 10, 4 ], [ 4, 4 ], [ 4, 10 ], [ 0, 10 ], [ 0, 0 ] ] ] } } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+\set filter '{ "g": { "$geoIntersects": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ 0, 0 ], [ 12, 0 ], [ 12, 12 ], [ 0, 12 ], [ 0, 0 ] ], [ [ 4, 4 ], [ 8, 4 ], [ 8, 8 ], [ 4, 8 ], [ 4, 4 ] ] ] } } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+\set filter '{ "g": { "$geoWithin": { "$centerSphere": [ [ 5, 5 ], 0.05 ] } } }'
+SET documentdb.enableGeospatialPreparedQuery TO on;
+CREATE TEMP TABLE prepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SET documentdb.enableGeospatialPreparedQuery TO off;
+CREATE TEMP TABLE unprepared AS SELECT object_id::text FROM documentdb_api.collection('db', 'geoPrepared') WHERE document @@ :'filter';
+SELECT (SELECT COUNT(*) FROM prepared) > 0 AS some_matched, (SELECT COUNT(*) FROM prepared) < 695 AS some_not_matched, (SELECT COUNT(*) FROM (SELECT * FROM prepared EXCEPT SELECT * FROM unprepared UNION ALL (SELECT * FROM unprepared EXCEPT SELECT * FROM prepared)) q) AS mismatches;
+DROP TABLE prepared, unprepared;
+
+RESET documentdb.enableGeospatialPreparedQuery;
+SELECT documentdb_api.drop_collection('db', 'geoPrepared');
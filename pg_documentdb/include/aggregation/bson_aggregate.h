@@ -62,4 +62,6 @@ GetMaxAlignedVarlena(bytea *bytes)
 }
 
 
+void CheckAggregateIntermediateResultSize(uint32_t size);
+
 #endif
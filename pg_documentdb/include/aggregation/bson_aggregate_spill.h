@@ -0,0 +1,36 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/aggregation/bson_aggregate_spill.h
+ *
+ * Common declarations for spilling the state of group accumulators
+ * to temporary files.
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef BSON_AGGREGATE_SPILL_H
+#define BSON_AGGREGATE_SPILL_H
+
+#include "io/bson_core.h"
+
+/* A temporary file holding the values spilled by an aggregate state */
+typedef struct AggregateSpillFile AggregateSpillFile;
+
+/* A position of a value in a spill file */
+typedef struct AggregateSpillPosition
+{
+	int fileNumber;
+	off_t offset;
+} AggregateSpillPosition;
+
+AggregateSpillFile * CreateAggregateSpillFile(MemoryContext aggregateContext);
+void AggregateSpillFileWrite(AggregateSpillFile *spillFile, const pgbson *value);
+AggregateSpillPosition AggregateSpillFileStart(AggregateSpillFile *spillFile);
+AggregateSpillPosition AggregateSpillFileEnd(AggregateSpillFile *spillFile);
+pgbson * AggregateSpillFileRead(AggregateSpillFile *spillFile,
+								AggregateSpillPosition *position, bool *isNull);
+
+int64 AggregateSpillThresholdBytes(void);
+void CheckAggregateSpilledResultSize(int64 size);
+
+#endif
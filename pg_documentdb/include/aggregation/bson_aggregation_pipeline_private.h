@@ -69,6 +69,7 @@ typedef enum
 	Stage_Merge,
 	Stage_Out,
 	Stage_Project,
+	Stage_QueryStats,
 	Stage_Redact,
 	Stage_ReplaceRoot,
 	Stage_ReplaceWith,
@@ -179,6 +180,9 @@ typedef struct
 
 	/*Parent Stage Name*/
 	ParentStageName parentStageName;
+
+	/* Whether the command set allowDiskUse to false */
+	bool disallowDiskUse;
 } AggregationPipelineBuildContext;
 
 
@@ -261,6 +265,8 @@ Query * HandleIndexStats(const bson_value_t *existingValue, Query *query,
 						 AggregationPipelineBuildContext *context);
 Query * HandleCurrentOp(const bson_value_t *existingValue, Query *query,
 						AggregationPipelineBuildContext *context);
+Query * HandleQueryStats(const bson_value_t *existingValue, Query *query,
+						 AggregationPipelineBuildContext *context);
 Query * HandleChangeStream(const bson_value_t *existingValue, Query *query,
 						   AggregationPipelineBuildContext *context);
 
@@ -287,6 +293,8 @@ Query * HandleNativeVectorSearch(const bson_value_t *existingValue, Query *query
 
 /* Metadata based query generators */
 Query * GenerateConfigDatabaseQuery(AggregationPipelineBuildContext *context);
+Query * BuildSingleFunctionQuery(Oid queryFunctionOid, List *queryArgs, bool
+								 isMultiRow);
 
 bool IsPartitionByFieldsOnShardKey(const pgbson *partitionByFields,
 								   const MongoCollection *collection);
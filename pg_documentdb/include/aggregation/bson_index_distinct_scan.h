@@ -0,0 +1,21 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/aggregation/bson_index_distinct_scan.h
+ *
+ * Common declarations of functions for answering distinct and $group
+ * queries from the distinct keys of an index.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef BSON_INDEX_DISTINCT_SCAN_H
+#define BSON_INDEX_DISTINCT_SCAN_H
+
+#include "io/bson_core.h"
+#include "metadata/collection.h"
+#include "utils/string_view.h"
+
+Oid GetIndexForDistinctScan(MongoCollection *collection, const StringView *path);
+
+#endif
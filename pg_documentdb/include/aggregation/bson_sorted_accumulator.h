@@ -81,6 +81,8 @@ Datum BsonOrderTransition(PG_FUNCTION_ARGS, bool invertSort, bool isSingle, bool
 Datum BsonOrderTransitionOnSorted(PG_FUNCTION_ARGS, bool invertSort, bool isSingle);
 Datum BsonOrderCombine(PG_FUNCTION_ARGS, bool invertSort);
 Datum BsonOrderFinal(PG_FUNCTION_ARGS, bool isSingle, bool invert);
+Datum BsonOrderFinalFromState(PG_FUNCTION_ARGS, BsonOrderAggState *state, bool isSingle,
+							  bool invert);
 Datum BsonOrderFinalOnSorted(PG_FUNCTION_ARGS, bool isSingle);
 
 #endif
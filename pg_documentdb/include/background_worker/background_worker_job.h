@@ -58,6 +58,23 @@ typedef struct
 typedef int (*get_schedule_interval_in_seconds_hook_type)(void);
 
 
+/*
+ * Scheduling priority of a background worker job. When the number of
+ * concurrent job slots is bounded, jobs with a higher priority are started
+ * first. High priority jobs are also never postponed because of foreground
+ * load.
+ */
+typedef enum BackgroundWorkerJobPriority
+{
+	BackgroundWorkerJobPriority_Low = -1,
+
+	/* Default for jobs that do not set a priority explicitly */
+	BackgroundWorkerJobPriority_Normal = 0,
+
+	BackgroundWorkerJobPriority_High = 1,
+} BackgroundWorkerJobPriority;
+
+
 /* Background worker job definition */
 typedef struct
 {
@@ -89,6 +106,9 @@ typedef struct
 
 	/* Flag to decide whether to run the job on metadata coordinator only or on all nodes. */
 	bool toBeExecutedOnMetadataCoordinatorOnly;
+
+	/* Scheduling priority of the job. */
+	BackgroundWorkerJobPriority priority;
 } BackgroundWorkerJob;
 
 /*
@@ -96,4 +116,11 @@ typedef struct
  */
 void RegisterBackgroundWorkerJob(BackgroundWorkerJob job);
 
+/*
+ * Shared memory used by the background worker leader for its latch
+ * and the per-job scheduling statistics.
+ */
+Size BackgroundWorkerShmemSize(void);
+void BackgroundWorkerShmemInit(void);
+
 #endif /* DOCUMENTS_BACKGROUND_WORKER_JOB_H */
@@ -73,6 +73,12 @@ typedef struct
 	/* Whether or not the index path has 2dsphere index */
 	bool has2dsphereIndex;
 
+	/*
+	 * Whether or not the 2dsphere paths are indexed as cell terms on RUM
+	 * alongside the regular paths of the index.
+	 */
+	bool has2dsphereCellIndex;
+
 	/* Whether or not index path has descending indexes */
 	bool hasDescendingIndex;
 
@@ -0,0 +1,99 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/geospatial/bson_geospatial_cells.h
+ *
+ * Hierarchical cell decomposition of the sphere used to build index terms
+ * for 2dsphere indexes on the RUM access method.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef BSON_GEOSPATIAL_CELLS_H
+#define BSON_GEOSPATIAL_CELLS_H
+
+#include "postgres.h"
+
+/*
+ * The sphere is projected onto the 6 faces of the enclosing cube and every face is
+ * recursively split into 4 quadrants up to GEO_CELL_MAX_LEVEL (~1cm cells at the earth's
+ * surface). A cell id holds 3 bits of face, 2 bits per level of the quadrant path and a
+ * trailing sentinel bit, so that all the descendants of a cell form a contiguous range
+ * of ids around the id of the cell itself.
+ */
+#define GEO_CELL_MAX_LEVEL 30
+
+/* Number of faces of the cube the sphere is projected on */
+#define GEO_CELL_NUM_FACES 6
+
+/* Default limits on the number of cells a geography is covered with */
+#define GEO_CELL_DEFAULT_MAX_CELLS 8
+#define GEO_CELL_MAX_CELLS_LIMIT 64
+
+/*
+ * An axis aligned box in geocentric (unit sphere) coordinates, the same space
+ * Postgis computes the bounding boxes of geographies in.
+ */
+typedef struct GeoCellBox
+{
+	double min[3];
+	double max[3];
+} GeoCellBox;
+
+
+/*
+ * Returns the level of the cell, 0 for a cube face.
+ */
+int GeoCellLevel(uint64 cellId);
+
+/*
+ * Returns the ancestor of the cell at the level just above it.
+ */
+uint64 GeoCellParent(uint64 cellId);
+
+/*
+ * Returns the smallest and largest ids of the descendants of a cell at
+ * GEO_CELL_MAX_LEVEL, the cell's own id lies in between.
+ */
+uint64 GeoCellRangeMin(uint64 cellId);
+uint64 GeoCellRangeMax(uint64 cellId);
+
+/*
+ * Converts a cell id to an index term and back. Index terms are compared as signed
+ * int8 values, the sign bit is flipped so that the order of terms is the order of ids.
+ */
+inline static int64
+GeoCellIdToTerm(uint64 cellId)
+{
+	return (int64) (cellId ^ (UINT64CONST(1) << 63));
+}
+
+
+inline static uint64
+GeoCellTermToId(int64 term)
+{
+	return ((uint64) term) ^ (UINT64CONST(1) << 63);
+}
+
+
+/*
+ * Covers the given box with at most maxCells cells (unless the box needs more
+ * top level cells than that) no finer than maxLevel. Returns the number of cells
+ * written to cells, which must have room for Max(maxCells, 4 * GEO_CELL_NUM_FACES)
+ * entries.
+ */
+int GetGeoCellCoveringForBox(const GeoCellBox *box, int maxCells, int maxLevel,
+							 uint64 *cells);
+
+/*
+ * Returns the 6 face cells, whose descendants cover the whole sphere.
+ */
+int GetGeoCellCoveringForSphere(uint64 *cells);
+
+/*
+ * Computes the geocentric bounding box of a geography datum. Returns false if
+ * the geography has no usable box (e.g. it is empty).
+ */
+bool GetGeographyGeoCellBox(Datum geography, GeoCellBox *box);
+
+#endif
@@ -112,6 +112,9 @@ typedef struct CommonBsonGeospatialState
 	Datum geoSpatialDatum;
 } CommonBsonGeospatialState;
 
+/* Query shape prepared once per query, see bson_geospatial_prepared_query.h */
+struct PreparedGeospatialQuery;
+
 /* Signature for runtime function to get match result for $geoWithin and $geoIntersects */
 typedef bool (*GeospatialQueryMatcherFunc)(const ProcessCommonGeospatialState *,
 										   StringInfo);
@@ -134,6 +137,9 @@ typedef struct RuntimeQueryMatcherInfo
 	/* Query geometry/geography datum precomputed */
 	Datum queryGeoDatum;
 
+	/* Prepared query shape to match points without postgis, NULL if not available */
+	const struct PreparedGeospatialQuery *preparedQuery;
+
 	/* True when matched */
 	bool isMatched;
 } RuntimeQueryMatcherInfo;
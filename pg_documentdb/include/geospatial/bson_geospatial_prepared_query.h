@@ -0,0 +1,43 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/geospatial/bson_geospatial_prepared_query.h
+ *
+ * Query shapes of $geoWithin and $geoIntersects prepared once per query so that
+ * document points can be matched without building a postgis datum.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef BSON_GEOSPATIAL_PREPARED_QUERY_H
+#define BSON_GEOSPATIAL_PREPARED_QUERY_H
+
+#include "postgres.h"
+#include "lib/stringinfo.h"
+
+#include "geospatial/bson_geospatial_shape_operators.h"
+
+/*
+ * Result of matching a document value against a prepared query
+ */
+typedef enum PreparedGeospatialMatch
+{
+	/* The prepared query can't decide, the postgis predicate needs to be evaluated */
+	PreparedGeospatialMatch_Unknown = 0,
+
+	/* The value matches the query */
+	PreparedGeospatialMatch_Matched,
+
+	/* The value doesn't match the query */
+	PreparedGeospatialMatch_NotMatched,
+} PreparedGeospatialMatch;
+
+typedef struct PreparedGeospatialQuery PreparedGeospatialQuery;
+
+PreparedGeospatialQuery * PrepareGeospatialQuery(const ShapeOperatorInfo *opInfo,
+												 bool isSpherical, Datum queryDatum);
+PreparedGeospatialMatch MatchPreparedGeospatialQuery(const
+													 PreparedGeospatialQuery *query,
+													 const StringInfo documentWKB);
+
+#endif
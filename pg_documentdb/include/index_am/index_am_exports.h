@@ -13,6 +13,7 @@
 
 #include <postgres.h>
 #include <utils/rel.h>
+#include <utils/snapshot.h>
 
 struct IndexScanDescData;
 struct ExplainState;
@@ -23,6 +24,41 @@ typedef void (*TryExplainIndexFunc)(struct IndexScanDescData *scan, struct
 typedef bool (*GetMultikeyStatusFunc)(Relation indexRelation);
 typedef bool (*GetTruncationStatusFunc)(Relation indexRelation);
 
+/*
+ * Result of visiting a chunk of the TIDs of an index entry key.
+ * CODESYNC: Keep in sync with RumEntryKeyVisitResult in pg_documentdb_rum.h
+ */
+typedef enum IndexEntryKeyVisitResult
+{
+	/* Send the next chunk of TIDs of the same key (if any) */
+	IndexEntryKeyVisit_NextChunk = 0,
+
+	/* Done with the current key, move to the next one */
+	IndexEntryKeyVisit_NextKey = 1,
+
+	/* Stop the enumeration */
+	IndexEntryKeyVisit_Stop = 2,
+} IndexEntryKeyVisitResult;
+
+typedef IndexEntryKeyVisitResult (*IndexEntryKeyVisitorFunc)(Datum key,
+															 ItemPointerData *items,
+															 int32 numItems,
+															 void *state);
+typedef void (*EnumerateIndexEntryKeysFunc)(Relation indexRelation, OffsetNumber attnum,
+											Snapshot snapshot,
+											IndexEntryKeyVisitorFunc visitor,
+											void *state);
+
+/*
+ * Functions that build an index from the tuples of a heap scan shared with
+ * other indexes, rather than from a heap scan of its own.
+ * CODESYNC: Keep in sync with documentdb_rum_shared_build_* in ruminsert.c
+ */
+typedef void *(*BeginSharedIndexBuildFunc)(Relation indexRelation, int maxMemoryKb);
+typedef void (*AddSharedIndexBuildTupleFunc)(void *state, ItemPointer tid,
+											 Datum *values, bool *isnull);
+typedef double (*EndSharedIndexBuildFunc)(void *state);
+
 /*
  * Data structure for an alternative index acess method for indexing bosn.
  * It contains the indexing capability and various utility function.
@@ -60,6 +96,14 @@ typedef struct
 
 	/* Optional function to that returns the truncation status of an index */
 	GetTruncationStatusFunc get_truncation_status;
+
+	/* Optional function that walks the distinct entry keys of an index */
+	EnumerateIndexEntryKeysFunc enumerate_entry_keys;
+
+	/* Optional functions that build the index from a shared heap scan */
+	BeginSharedIndexBuildFunc begin_shared_build;
+	AddSharedIndexBuildTupleFunc add_shared_build_tuple;
+	EndSharedIndexBuildFunc end_shared_build;
 } BsonIndexAmEntry;
 
 /*
@@ -66,6 +66,16 @@ bool GetIndexAmSupportsIndexOnlyScan(Oid indexAm, Oid opFamilyOid,
 									 GetMultikeyStatusFunc *getMultiKeyStatus,
 									 GetTruncationStatusFunc *getTruncationStatus);
 
+EnumerateIndexEntryKeysFunc GetIndexAmEnumerateEntryKeysFunc(Oid indexAm,
+															 GetMultikeyStatusFunc *
+															 getMultiKeyStatus,
+															 GetTruncationStatusFunc *
+															 getTruncationStatus);
+
+bool GetIndexAmSharedBuildFuncs(Oid indexAm, BeginSharedIndexBuildFunc *beginBuild,
+								AddSharedIndexBuildTupleFunc *addTuple,
+								EndSharedIndexBuildFunc *endBuild);
+
 void TryExplainByIndexAm(struct IndexScanDescData *scan, struct ExplainState *es);
 
 #endif
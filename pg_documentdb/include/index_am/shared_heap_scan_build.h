@@ -0,0 +1,30 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/index_am/shared_heap_scan_build.h
+ *
+ * Declarations for building several indexes of a collection from a single
+ * heap scan.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef SHARED_HEAP_SCAN_BUILD_H
+#define SHARED_HEAP_SCAN_BUILD_H
+
+#include <postgres.h>
+#include <access/amapi.h>
+#include <nodes/execnodes.h>
+
+#include "index_am/documentdb_rum.h"
+
+void BeginSharedHeapScanIndexBuild(Oid heapRelationId);
+void EndSharedHeapScanIndexBuild(void);
+void ResetSharedHeapScanIndexBuild(void);
+
+bool TryDeferIndexBuildToSharedHeapScan(Relation heapRelation, Relation indexRelation,
+										IndexInfo *indexInfo,
+										UpdateMultikeyStatusFunc updateMultikeyStatus,
+										IndexBuildResult **result);
+
+#endif
@@ -0,0 +1,26 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/infrastructure/database_profiler.h
+ *
+ * Common declarations for the database profiler (system.profile).
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef DOCUMENTDB_DATABASE_PROFILER_H
+#define DOCUMENTDB_DATABASE_PROFILER_H
+#include <postgres.h>
+
+/* Shared memory setup */
+Size DatabaseProfilerShmemSize(void);
+void InitializeDatabaseProfilerShmem(void);
+
+/* Executor hooks that capture the profiled commands */
+void InstallDatabaseProfilerHooks(void);
+void UninstallDatabaseProfilerHooks(void);
+
+/* Background job that flushes the captured commands to system.profile */
+void RegisterDatabaseProfilerBackgroundWorkerJob(void);
+
+#endif
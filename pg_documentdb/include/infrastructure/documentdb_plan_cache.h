@@ -124,6 +124,9 @@
 /* GUC that controls the query plan cache size */
 extern int QueryPlanCacheSizeLimit;
 
+/* Number of plan cache lookups of this backend that found a cached plan */
+extern uint64 QueryPlanCacheHitCount;
+
 
 void InitializeQueryPlanCache(void);
 SPIPlanPtr GetSPIQueryPlan(uint64 collectionId, uint64 queryId,
@@ -13,6 +13,8 @@
 
 #define DOCUMENTDB_INDEX_BUILD_JOB1_JOBID 90
 #define DOCUMENTDB_INDEX_BUILD_JOB2_JOBID 91
+#define DOCUMENTDB_COMPRESSION_DICTIONARY_JOBID 92
+#define DOCUMENTDB_DATABASE_PROFILER_JOBID 93
 
 extern bool EnableBackgroundWorker;
 extern bool EnableBackgroundWorkerJobs;
@@ -24,4 +26,7 @@ void UnscheduleIndexBuildTasks(char *extensionPrefix);
 void ScheduleIndexBuildTasks(char *extensionPrefix);
 void RegisterIndexBuildBackgroundWorkerJobs(void);
 
+/* compression dictionary tasks */
+void RegisterCompressionDictionaryBackgroundWorkerJob(void);
+
 #endif
@@ -0,0 +1,39 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/infrastructure/query_stats.h
+ *
+ * Common declarations for the per query shape statistics ($queryStats).
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef DOCUMENTDB_QUERY_STATS_H
+#define DOCUMENTDB_QUERY_STATS_H
+#include <postgres.h>
+
+#include "utils/query_shape.h"
+
+/*
+ * The measurements of one execution of a command, added to the statistics
+ * of its query shape.
+ */
+typedef struct QueryStatsMeasurements
+{
+	uint64 durationMicros;
+	uint64 keysExamined;
+	uint64 docsExamined;
+	uint64 docsReturned;
+	uint64 planCacheHits;
+	uint64 spillBytes;
+} QueryStatsMeasurements;
+
+/* Shared memory setup */
+Size QueryStatsShmemSize(void);
+void InitializeQueryStatsShmem(void);
+
+bool IsQueryStatsEnabled(void);
+void RecordQueryStats(const QueryShape *queryShape,
+					  const QueryStatsMeasurements *measurements);
+
+#endif
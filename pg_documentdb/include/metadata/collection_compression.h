@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/metadata/collection_compression.h
+ *
+ * Declarations for the compression dictionaries of collections.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef COLLECTION_COMPRESSION_H
+#define COLLECTION_COMPRESSION_H
+
+#include "io/bson_core.h"
+#include "io/bson_compression.h"
+#include "metadata/collection.h"
+
+pgbson * DecompressStoredDocument(pgbson *document);
+bool CollectionHasCompressedDocuments(uint64 collectionId);
+
+pgbson * CompressDocumentForCollection(const MongoCollection *collection,
+									   pgbson *document);
+pgbson * CompressUpdatedDocumentLike(pgbson *document, const pgbson *storedDocument);
+
+void UpdateCollectionCompression(const MongoCollection *collection, bool enable,
+								 pgbson_writer *writer);
+void DeleteCollectionCompression(uint64 collectionId);
+
+#endif
@@ -0,0 +1,44 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/metadata/collection_field_dictionary.h
+ *
+ * Declarations for the field name dictionaries of collections.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef COLLECTION_FIELD_DICTIONARY_H
+#define COLLECTION_FIELD_DICTIONARY_H
+
+#include "io/bson_core.h"
+#include "io/bson_field_dictionary.h"
+#include "metadata/collection.h"
+
+/*
+ * Read the document column of a collection's data table, decoding the
+ * document if it is stored encoded. Only for functions that are handed the
+ * column itself, such as query operators and index support functions; other
+ * reads are decoded by the planner (see documents_planner.c).
+ */
+#define DatumGetStoredPgBson(n) DecodeStoredDocument(DatumGetPgBson(n))
+#define PG_GETARG_STORED_PGBSON(n) DatumGetStoredPgBson(PG_GETARG_DATUM(n))
+#define PG_GETARG_STORED_PGBSON_PACKED(n) \
+	DecodeStoredDocument(PG_GETARG_PGBSON_PACKED(n))
+
+pgbson * DecodeStoredDocument(pgbson *document);
+const char * EncodeStoredDocumentFieldPath(const pgbson *document, const char *path);
+bool CollectionHasEncodedDocuments(uint64 collectionId);
+
+const BsonFieldDictionary * GetCollectionFieldDictionaryForWrite(const
+																 MongoCollection *
+																 collection);
+pgbson * EncodeDocumentForCollection(const MongoCollection *collection,
+									 pgbson *document);
+pgbson * EncodeUpdatedDocumentLike(pgbson *document, const pgbson *storedDocument);
+
+void UpdateCollectionFieldDictionary(const MongoCollection *collection, bool enable,
+									 pgbson_writer *writer);
+void DeleteCollectionFieldDictionary(uint64 collectionId);
+
+#endif
@@ -0,0 +1,36 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/metadata/collection_shared_cache.h
+ *
+ * Common declarations for the shared memory collection metadata cache.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef COLLECTION_SHARED_CACHE_H
+#define COLLECTION_SHARED_CACHE_H
+
+#include "metadata/collection.h"
+
+/* Shared memory setup */
+Size SharedCollectionCacheShmemSize(void);
+void InitializeSharedCollectionCacheShmem(void);
+
+/* Lookup and population */
+bool IsSharedCollectionCacheEnabled(void);
+uint64 GetSharedCollectionCacheGeneration(void);
+bool TryGetCollectionFromSharedCacheByName(const MongoCollectionName *name,
+										   MongoCollection *collection);
+bool TryGetCollectionFromSharedCacheById(uint64 collectionId,
+										 MongoCollection *collection);
+void AddCollectionToSharedCache(const MongoCollection *collection, uint64 generation);
+
+/* Invalidation */
+void RecordCollectionCatalogChange(uint64 collectionId);
+void RecordCollectionCatalogReset(void);
+void AtEOXactSharedCollectionCache(bool isCommit);
+void AtPrePrepareSharedCollectionCache(void);
+void AtPrepareSharedCollectionCache(void);
+
+#endif
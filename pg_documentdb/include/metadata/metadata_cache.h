@@ -83,6 +83,9 @@ Oid BsonRangeMatchFunctionId(void);
 Oid BsonRangeMatchOperatorOid(void);
 Oid BsonFullScanFunctionOid(void);
 Oid BsonIndexHintFunctionOid(void);
+Oid BsonDecodeStoredDocumentFunctionOid(void);
+Oid BsonUpdateDocumentFunctionOid(void);
+Oid UpdateBsonDocumentFunctionOid(void);
 Oid BsonInMatchFunctionId(void);
 Oid BsonNinMatchFunctionId(void);
 Oid BsonNotEqualMatchFunctionId(void);
@@ -404,6 +407,8 @@ Oid BsonLastNAggregateAllArgsFunctionOid(void);
 Oid BsonLastNOnSortedAggregateFunctionOid(void);
 Oid BsonLastNOnSortedAggregateAllArgsFunctionOid(void);
 Oid BsonAddToSetAggregateFunctionOid(void);
+Oid BsonAddToSetWithSpillAggregateFunctionOid(void);
+Oid BsonArrayAggregateWithSpillFunctionOid(void);
 Oid BsonStdDevPopAggregateFunctionOid(void);
 Oid BsonStdDevSampAggregateFunctionOid(void);
 Oid PostgresAnyValueFunctionOid(void);
@@ -415,12 +420,14 @@ Oid BsonLookupExtractFilterArrayFunctionOid(void);
 Oid BsonLookupUnwindFunctionOid(void);
 Oid BsonDistinctUnwindFunctionOid(void);
 Oid BsonDollarBucketAutoFunctionOid(void);
+Oid BsonIndexDistinctScanFunctionOid(void);
 Oid BsonDistinctAggregateFunctionOid(void);
 Oid RowGetBsonFunctionOid(void);
 Oid ApiChangeStreamAggregationFunctionOid(void);
 Oid ApiCollStatsAggregationFunctionOid(void);
 Oid ApiIndexStatsAggregationFunctionOid(void);
 Oid BsonCurrentOpAggregationFunctionId(void);
+Oid BsonQueryStatsAggregationFunctionId(void);
 Oid BsonMaxNAggregateFunctionOid(void);
 Oid BsonMinNAggregateFunctionOid(void);
 Oid BsonMedianAggregateFunctionOid(void);
@@ -443,6 +450,7 @@ Oid BsonDensifyFullWindowFunctionOid(void);
 
 /* Catalog */
 Oid ApiDataNamespaceOid(void);
+Oid ApiCatalogCollectionsTableOid(void);
 
 /* CRUD functions */
 Oid UpdateWorkerFunctionOid(void);
@@ -177,6 +177,19 @@ typedef struct
 	int path;
 } Bson2dGeographyPathOptions;
 
+/*
+ * This is the serialized post-processed structure that holds the indexing options
+ * for 2dsphere paths indexed as cell terms on RUM. The path must stay at the same
+ * offset as in Bson2dGeographyPathOptions.
+ */
+typedef struct
+{
+	BsonGinIndexOptionsBase base;
+	int path;
+	int32_t maxCells;
+	int32_t maxLevel;
+} Bson2dGeographyCellPathOptions;
+
 typedef struct
 {
 	BsonGinIndexOptionsBase base;
@@ -14,6 +14,9 @@
 #include <postgres.h>
 #include <optimizer/optimizer.h>
 
+#include "io/bson_core.h"
+#include "opclass/bson_gin_common.h"
+
 /* The low selectivity - based on prior guess. */
 static const double LowSelectivity = 0.01;
 
@@ -24,4 +27,11 @@ double GetDollarOperatorSelectivity(PlannerInfo *planner, Oid selectivityOpExpr,
 									List *args, Oid collation, int varRelId, double
 									defaultExprSelectivity);
 
+bool TryGetPathStatisticsSelectivity(PlannerInfo *planner, Node *documentExpr,
+									 int varRelId, BsonIndexStrategy indexStrategy,
+									 const pgbsonelement *queryElement,
+									 double *selectivity);
+double GetPathStatisticsDistinctValues(PlannerInfo *planner, Node *documentExpr,
+									   int varRelId, const char *path);
+
 #endif
@@ -19,7 +19,7 @@
 #include <port/atomics.h>
 
 #define MAX_FEATURE_NAME_LENGTH 255
-#define MAX_FEATURE_COUNT 404
+#define MAX_FEATURE_COUNT 410
 
 /* Internal features that are not exposed */
 #define INTERNAL_FEATURE_TYPE MAX_FEATURE_COUNT
@@ -414,6 +414,7 @@ typedef enum
 	FEATURE_STAGE_OUT,
 	FEATURE_STAGE_PROJECT,
 	FEATURE_STAGE_PROJECT_FIND,
+	FEATURE_STAGE_QUERY_STATS,
 	FEATURE_STAGE_REDACT,
 	FEATURE_STAGE_REPLACE_ROOT,
 	FEATURE_STAGE_REPLACE_WITH,
@@ -0,0 +1,40 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/utils/query_shape.h
+ *
+ * Normalized shapes of commands, used to group executions of the same
+ * query with different literals.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include "io/bson_core.h"
+
+#ifndef QUERY_SHAPE_H
+#define QUERY_SHAPE_H
+
+/*
+ * The shape of a command: the parts of the command that determine how it
+ * executes, with the literals replaced by placeholders of their type.
+ */
+typedef struct QueryShape
+{
+	/* The command, e.g. find */
+	const char *commandName;
+
+	/* The collection the command runs on, NULL for database commands */
+	const char *collectionName;
+
+	/* { cmdNs: { db, coll }, command, <normalized command fields> } */
+	pgbson *shape;
+
+	/* Hash of the shape */
+	uint64 shapeHash;
+} QueryShape;
+
+void BuildQueryShape(const char *databaseName, const char *commandName,
+					 pgbson *commandSpec, QueryShape *queryShape);
+char * QueryShapeHashToString(uint64 shapeHash);
+
+#endif
@@ -25,6 +25,8 @@
 #include "udfs/commands_diagnostic/coll_stats--0.110-0.sql"
 #include "udfs/commands_diagnostic/current_op--0.110-0.sql"
 #include "udfs/commands_diagnostic/db_stats--0.110-0.sql"
+#include "udfs/commands_diagnostic/profile--0.110-0.sql"
+#include "udfs/commands_diagnostic/query_stats--0.110-0.sql"
 #include "udfs/metadata/list_databases--0.110-0.sql"
 #include "udfs/commands_diagnostic/validate--0.110-0.sql"
 #include "udfs/commands_crud/insert_one_helper--0.110-0.sql"
@@ -43,5 +45,19 @@ REVOKE EXECUTE ON ALL FUNCTIONS IN SCHEMA documentdb_api_v2 FROM PUBLIC;
 #include "udfs/commands_crud/insert--0.110-0.sql"
 #include "udfs/commands_crud/update--0.110-0.sql"
 #include "udfs/query/bson_orderby--0.110-0.sql"
-
-#include "udfs/rum/composite_path_operator_functions--0.110-0.sql"
\ No newline at end of file
+#include "udfs/aggregation/bson_index_distinct_scan--0.110-0.sql"
+#include "udfs/metadata/collection_update_trigger--0.110-0.sql"
+#include "schema/collection_metadata--0.110-0.sql"
+#include "schema/collection_field_dictionary--0.110-0.sql"
+#include "udfs/metadata/bson_decode_stored_document--0.110-0.sql"
+#include "schema/collection_compression--0.110-0.sql"
+#include "udfs/metadata/train_compression_dictionaries_background--0.110-0.sql"
+#include "udfs/metadata/flush_profile_entries_background--0.110-0.sql"
+#include "udfs/telemetry/background_worker_job_stats--0.110-0.sql"
+#include "udfs/aggregation/window_aggregate_support--0.110-0.sql"
+#include "udfs/aggregation/group_aggregates_support--0.110-0.sql"
+#include "udfs/aggregation/group_aggregates--0.110-0.sql"
+
+#include "udfs/rum/composite_path_operator_functions--0.110-0.sql"
+#include "udfs/rum/bson_rum_geography_cell_functions--0.110-0.sql"
+#include "schema/bson_geography_cell_operator_class--0.110-0.sql"
@@ -0,0 +1,15 @@
+-- 2dsphere index on cell terms: the geography at the path is covered with cells of a
+-- hierarchical decomposition of the sphere and indexed as their int8 ids, so that it
+-- can be compounded with regular index paths in a single index.
+CREATE OPERATOR CLASS __API_OPCLASS_SCHEMA__.__EXTENSION_SHORTENED_INDEX_OPCLASS__(__API_INDEX_PREFIX_NAME__, _geography_cell)
+    FOR TYPE __CORE_SCHEMA__.bson USING __EXTENSION_OBJECT__(_rum) AS
+        OPERATOR        23      __API_CATALOG_SCHEMA__.@|-| (__CORE_SCHEMA__.bson, __CORE_SCHEMA__.bson),
+        OPERATOR        24      __API_CATALOG_SCHEMA__.@|#| (__CORE_SCHEMA__.bson, __CORE_SCHEMA__.bson),
+        OPERATOR        31      __API_SCHEMA_INTERNAL_V2__.@|><| (__CORE_SCHEMA__.bson, __CORE_SCHEMA__.bson),
+        FUNCTION        1       btint8cmp(int8,int8),
+        FUNCTION        2       __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_extract_value(__CORE_SCHEMA__.bson, internal),
+        FUNCTION        3       __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_extract_query(__CORE_SCHEMA__.bson, internal, int2, internal, internal, internal, internal),
+        FUNCTION        4       __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_consistent(internal, int2, anyelement, int4, internal, internal),
+        FUNCTION        5       __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_compare_partial(int8, int8, int2, internal),
+        FUNCTION        11      (__CORE_SCHEMA__.bson) __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_options(internal),
+    STORAGE         int8;
@@ -0,0 +1,32 @@
+/*
+ * The document compression settings of collections. dictionary_version is
+ * the version of the dictionary new writes are compressed with, 0 until one
+ * is trained. The sample sizes are those of the documents the current
+ * dictionary was trained on, uncompressed and compressed with it.
+ */
+CREATE TABLE __API_CATALOG_SCHEMA__.collection_compression (
+    collection_id bigint not null PRIMARY KEY,
+    is_enabled bool not null default true,
+    dictionary_version int not null default 0,
+    trained_at timestamptz,
+    sample_uncompressed_bytes bigint not null default 0,
+    sample_compressed_bytes bigint not null default 0
+);
+
+GRANT SELECT ON TABLE __API_CATALOG_SCHEMA__.collection_compression TO public;
+GRANT ALL ON TABLE __API_CATALOG_SCHEMA__.collection_compression TO __API_ADMIN_ROLE__;
+
+/*
+ * The trained zstd dictionaries of collections. Compressed documents record
+ * the version they were compressed with, so versions are immutable and kept
+ * as long as the collection exists.
+ */
+CREATE TABLE __API_CATALOG_SCHEMA__.collection_compression_dictionary (
+    collection_id bigint not null,
+    dictionary_version int not null,
+    dictionary bytea not null,
+    PRIMARY KEY (collection_id, dictionary_version)
+);
+
+GRANT SELECT ON TABLE __API_CATALOG_SCHEMA__.collection_compression_dictionary TO public;
+GRANT ALL ON TABLE __API_CATALOG_SCHEMA__.collection_compression_dictionary TO __API_ADMIN_ROLE__;
@@ -0,0 +1,14 @@
+/*
+ * The field name dictionaries of collections that store documents with
+ * dictionary encoded field names. field_names is append only: the id of a
+ * name is its position (0 based), and documents record how many names they
+ * were encoded with.
+ */
+CREATE TABLE __API_CATALOG_SCHEMA__.collection_field_dictionary (
+    collection_id bigint not null PRIMARY KEY,
+    is_enabled bool not null default true,
+    field_names text[] not null default '{}'
+);
+
+GRANT SELECT ON TABLE __API_CATALOG_SCHEMA__.collection_field_dictionary TO public;
+GRANT ALL ON TABLE __API_CATALOG_SCHEMA__.collection_field_dictionary TO __API_ADMIN_ROLE__;
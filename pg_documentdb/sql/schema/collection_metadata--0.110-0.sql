@@ -0,0 +1,3 @@
+CREATE OR REPLACE TRIGGER collections_trigger
+ AFTER INSERT OR UPDATE OR DELETE ON __API_CATALOG_SCHEMA_V2__.collections
+ FOR EACH ROW EXECUTE FUNCTION __API_SCHEMA_INTERNAL_V2__.collection_update_trigger();
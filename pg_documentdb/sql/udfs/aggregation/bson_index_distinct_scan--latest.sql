@@ -0,0 +1,5 @@
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.bson_index_distinct_scan(p_index_id oid, p_group_spec __CORE_SCHEMA__.bson DEFAULT NULL)
+ RETURNS SETOF __CORE_SCHEMA__.bson
+ LANGUAGE c
+ STABLE
+AS 'MODULE_PATHNAME', $function$bson_index_distinct_scan$function$;
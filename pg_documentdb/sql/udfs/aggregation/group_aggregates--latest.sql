@@ -31,6 +31,10 @@ CREATE OR REPLACE AGGREGATE __API_CATALOG_SCHEMA__.BSONMAX(__CORE_SCHEMA__.bson)
     FINALFUNC = __API_CATALOG_SCHEMA__.bson_min_max_final,
     stype = __CORE_SCHEMA__.bson,
     COMBINEFUNC = __API_CATALOG_SCHEMA__.bson_max_combine,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_max_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_value_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
     PARALLEL = SAFE
 );
 
@@ -40,6 +44,10 @@ CREATE OR REPLACE AGGREGATE __API_CATALOG_SCHEMA__.BSONMIN(__CORE_SCHEMA__.bson)
     FINALFUNC = __API_CATALOG_SCHEMA__.bson_min_max_final,
     stype = __CORE_SCHEMA__.bson,
     COMBINEFUNC = __API_CATALOG_SCHEMA__.bson_min_combine,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_min_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_value_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
     PARALLEL = SAFE
 );
 
@@ -238,6 +246,30 @@ CREATE OR REPLACE AGGREGATE __API_CATALOG_SCHEMA__.BSON_ARRAY_AGG(__CORE_SCHEMA_
 );
 
 CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSON_ADD_TO_SET(__CORE_SCHEMA_V2__.bson)
+(
+    SFUNC = __API_SCHEMA_INTERNAL_V2__.bson_add_to_set_transition,
+    FINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_add_to_set_final,
+    stype = bytea,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_add_to_set_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_array_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
+    PARALLEL = SAFE
+);
+
+/*
+ * Implementation of the bson_array_agg and bson_add_to_set aggregators with the addition
+ * of a boolean field that indicates whether the state can be spilled to disk (allowDiskUse).
+ */
+CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSON_ARRAY_AGG(__CORE_SCHEMA__.bson, text, boolean, boolean)
+(
+    SFUNC = __API_SCHEMA_INTERNAL_V2__.bson_array_agg_transition,
+    FINALFUNC = __API_CATALOG_SCHEMA__.bson_array_agg_final,
+    stype = bytea,
+    PARALLEL = SAFE
+);
+
+CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSON_ADD_TO_SET(__CORE_SCHEMA_V2__.bson, boolean)
 (
     SFUNC = __API_SCHEMA_INTERNAL_V2__.bson_add_to_set_transition,
     FINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_add_to_set_final,
@@ -300,6 +332,10 @@ CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSONFIRST(__CORE_SCHEMA__
     FINALFUNC = __API_CATALOG_SCHEMA__.bson_first_last_final,
     stype = bytea,
     COMBINEFUNC = __API_CATALOG_SCHEMA__.bson_first_combine,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_first_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_value_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
     PARALLEL = SAFE
 );
 
@@ -312,6 +348,10 @@ CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSONLAST(__CORE_SCHEMA__.
     FINALFUNC = __API_CATALOG_SCHEMA__.bson_first_last_final,
     stype = bytea,
     COMBINEFUNC = __API_CATALOG_SCHEMA__.bson_last_combine,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_last_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_value_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
     PARALLEL = SAFE
 );
 
@@ -324,6 +364,10 @@ CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSONFIRSTN(__CORE_SCHEMA_
     FINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_firstn_final,
     stype = bytea,
     COMBINEFUNC = __API_CATALOG_SCHEMA__.bson_firstn_combine,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_firstn_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_array_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
     PARALLEL = SAFE
 );
 
@@ -336,6 +380,10 @@ CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSONLASTN(__CORE_SCHEMA__
     FINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_lastn_final,
     stype = bytea,
     COMBINEFUNC = __API_CATALOG_SCHEMA__.bson_lastn_combine,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_lastn_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_array_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
     PARALLEL = SAFE
 );
 
@@ -345,6 +393,10 @@ CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSONMAXN(__CORE_SCHEMA__.
     FINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_maxminn_final,
     stype = bytea,
     COMBINEFUNC = __API_SCHEMA_INTERNAL_V2__.bson_maxminn_combine,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_maxn_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_array_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
     PARALLEL = SAFE
 );
 
@@ -354,6 +406,10 @@ CREATE OR REPLACE AGGREGATE __API_SCHEMA_INTERNAL_V2__.BSONMINN(__CORE_SCHEMA__.
     FINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_maxminn_final,
     stype = bytea,
     COMBINEFUNC = __API_SCHEMA_INTERNAL_V2__.bson_maxminn_combine,
+    mstype = bytea,
+    MSFUNC = __API_SCHEMA_INTERNAL_V2__.bson_minn_moving_transition,
+    MFINALFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_array_final,
+    MINVFUNC = __API_SCHEMA_INTERNAL_V2__.bson_sliding_window_invtransition,
     PARALLEL = SAFE
 );
 
@@ -116,6 +116,12 @@ CREATE OR REPLACE FUNCTION __API_CATALOG_SCHEMA__.bson_array_agg_transition(byte
  STABLE
 AS 'MODULE_PATHNAME', $function$bson_array_agg_transition$function$;
 
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.bson_array_agg_transition(bytea, __CORE_SCHEMA__.bson, text, boolean, boolean)
+ RETURNS bytea
+ LANGUAGE c
+ STABLE
+AS 'MODULE_PATHNAME', $function$bson_array_agg_transition$function$;
+
 CREATE OR REPLACE FUNCTION __API_CATALOG_SCHEMA__.bson_array_agg_final(bytea)
  RETURNS __CORE_SCHEMA__.bson
  LANGUAGE c
@@ -200,6 +206,12 @@ CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.bson_add_to_set_transition
  STABLE
 AS 'MODULE_PATHNAME', $function$bson_add_to_set_transition$function$;
 
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.bson_add_to_set_transition(bytea, __CORE_SCHEMA_V2__.bson, boolean)
+ RETURNS bytea
+ LANGUAGE c
+ STABLE
+AS 'MODULE_PATHNAME', $function$bson_add_to_set_transition$function$;
+
 CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.bson_add_to_set_final(bytea)
  RETURNS __CORE_SCHEMA_V2__.bson
  LANGUAGE c
@@ -0,0 +1,10 @@
+-- profile database command implementation for the wire protocol
+CREATE OR REPLACE FUNCTION __API_SCHEMA_V2__.profile(
+    IN p_database_name text,
+    IN p_spec __CORE_SCHEMA_V2__.bson)
+RETURNS __CORE_SCHEMA_V2__.bson
+LANGUAGE C
+VOLATILE PARALLEL UNSAFE STRICT
+AS 'MODULE_PATHNAME', $function$command_profile$function$;
+COMMENT ON FUNCTION __API_SCHEMA_V2__.profile(text, __CORE_SCHEMA_V2__.bson)
+    IS 'Sets or gets the profiling level of a database';
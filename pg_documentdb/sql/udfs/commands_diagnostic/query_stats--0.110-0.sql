@@ -0,0 +1,17 @@
+-- $queryStats aggregation stage: the statistics of every query shape of the database
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.query_stats_aggregation(p_spec __CORE_SCHEMA_V2__.bson, OUT document __CORE_SCHEMA_V2__.bson)
+RETURNS SETOF __CORE_SCHEMA_V2__.bson
+ LANGUAGE c
+ VOLATILE STRICT ROWS 100
+AS 'MODULE_PATHNAME', $function$command_query_stats_aggregation$function$;
+
+CREATE OR REPLACE FUNCTION __API_SCHEMA_V2__.query_stats_reset()
+RETURNS void
+ LANGUAGE c
+ VOLATILE PARALLEL UNSAFE
+AS 'MODULE_PATHNAME', $function$command_query_stats_reset$function$;
+COMMENT ON FUNCTION __API_SCHEMA_V2__.query_stats_reset()
+    IS 'Discards the statistics collected for all query shapes';
+
+REVOKE ALL ON FUNCTION __API_SCHEMA_V2__.query_stats_reset() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION __API_SCHEMA_V2__.query_stats_reset() TO __API_ADMIN_ROLE__;
@@ -0,0 +1,11 @@
+/*
+ * Decodes a document read from a collection's data table if it is stored
+ * encoded. The planner wraps reads of the document column of collections
+ * with encoded documents in it.
+ */
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.bson_decode_stored_document(
+    document __CORE_SCHEMA__.bson)
+RETURNS __CORE_SCHEMA__.bson
+LANGUAGE C
+STABLE STRICT PARALLEL SAFE
+AS 'MODULE_PATHNAME', $function$bson_decode_stored_document$function$;
@@ -13,15 +13,10 @@ CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL__.ensure_valid_db_coll(text, te
  STRICT
 AS 'MODULE_PATHNAME', $function$command_ensure_valid_db_coll$function$;
 
-CREATE FUNCTION __API_SCHEMA_INTERNAL_V2__.collection_update_trigger()
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.collection_update_trigger()
  RETURNS trigger
- LANGUAGE plpgsql
-AS $function$
-BEGIN
-	PERFORM __API_SCHEMA_INTERNAL_V2__.invalidate_collection_cache();
-	RETURN NULL;
-END;
-$function$;
+ LANGUAGE c
+AS 'MODULE_PATHNAME', $function$command_collection_update_trigger$function$;
 
 CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.invalidate_collection_cache()
  RETURNS void
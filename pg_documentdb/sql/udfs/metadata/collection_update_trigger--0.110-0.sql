@@ -0,0 +1,4 @@
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.collection_update_trigger()
+ RETURNS trigger
+ LANGUAGE c
+AS 'MODULE_PATHNAME', $function$command_collection_update_trigger$function$;
@@ -0,0 +1,10 @@
+/*
+ * Called periodically by the background worker framework to write the
+ * profiled commands of this database to system.profile.
+ */
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL__.flush_profile_entries_background()
+RETURNS void
+LANGUAGE C
+AS 'MODULE_PATHNAME', $function$command_flush_profile_entries_background$function$;
+COMMENT ON FUNCTION __API_SCHEMA_INTERNAL__.flush_profile_entries_background()
+    IS 'Writes the profiled commands to the system.profile collections';
@@ -0,0 +1,10 @@
+/*
+ * Called periodically by the background worker framework to retrain the
+ * compression dictionaries of collections with document compression.
+ */
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL__.train_compression_dictionaries_background()
+RETURNS void
+LANGUAGE C
+AS 'MODULE_PATHNAME', $function$command_train_compression_dictionaries_background$function$;
+COMMENT ON FUNCTION __API_SCHEMA_INTERNAL__.train_compression_dictionaries_background()
+    IS 'Retrains the compression dictionaries of collections with document compression';
@@ -0,0 +1,29 @@
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_extract_value(__CORE_SCHEMA__.bson, internal)
+ RETURNS internal
+ LANGUAGE c
+ IMMUTABLE PARALLEL SAFE STRICT
+AS 'MODULE_PATHNAME', $function$gin_bson_geography_cell_extract_value$function$;
+
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_extract_query(__CORE_SCHEMA__.bson, internal, int2, internal, internal, internal, internal)
+ RETURNS internal
+ LANGUAGE c
+ IMMUTABLE PARALLEL SAFE STRICT
+AS 'MODULE_PATHNAME', $function$gin_bson_geography_cell_extract_query$function$;
+
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_compare_partial(int8, int8, int2, internal)
+ RETURNS integer
+ LANGUAGE c
+ IMMUTABLE PARALLEL SAFE STRICT
+AS 'MODULE_PATHNAME', $function$gin_bson_geography_cell_compare_partial$function$;
+
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_consistent(internal, smallint, anyelement, integer, internal, internal)
+ RETURNS boolean
+ LANGUAGE c
+ IMMUTABLE PARALLEL SAFE STRICT
+AS 'MODULE_PATHNAME', $function$gin_bson_geography_cell_consistent$function$;
+
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.gin_bson_geography_cell_options(internal)
+ RETURNS void
+ LANGUAGE c
+ IMMUTABLE PARALLEL SAFE STRICT
+AS 'MODULE_PATHNAME', $function$gin_bson_geography_cell_options$function$;
@@ -0,0 +1,18 @@
+-- Returns the scheduling statistics of the background worker jobs.
+-- latency_histogram holds the number of completed runs per run time bucket,
+-- the upper bounds of the buckets are 1s, 2s, 4s, ... 1024s and the last
+-- bucket counts the runs that took longer than that.
+CREATE OR REPLACE FUNCTION __API_SCHEMA_INTERNAL_V2__.background_worker_job_stats(
+	OUT job_id int,
+	OUT job_name text,
+	OUT priority text,
+	OUT runs bigint,
+	OUT failures bigint,
+	OUT timeouts bigint,
+	OUT deferred_for_load bigint,
+	OUT deferred_for_slots bigint,
+	OUT total_run_time_ms bigint,
+	OUT latency_histogram bigint[])
+RETURNS SETOF RECORD
+LANGUAGE C VOLATILE PARALLEL SAFE
+AS 'MODULE_PATHNAME', $$get_background_worker_job_stats$$;
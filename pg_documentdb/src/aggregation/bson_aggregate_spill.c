@@ -0,0 +1,221 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/aggregation/bson_aggregate_spill.c
+ *
+ * Temporary files for the state of group accumulators ($push, $addToSet)
+ * that grows past documentdb.aggregateStateSpillThresholdMB.
+ *
+ * Values are appended to a BufFile as length prefixed bson documents and
+ * read back at finalize from any recorded position, so that a state can
+ * keep several sorted runs in the same file. The files are owned by the
+ * resource owner of the executing portal and are closed when the
+ * aggregate memory context is reset.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <postgres.h>
+#include <access/xact.h>
+#include <storage/buffile.h>
+#include <utils/memutils.h>
+
+#include "aggregation/bson_aggregate_spill.h"
+#include "utils/documentdb_errors.h"
+
+extern int AggregateStateSpillThresholdMB;
+
+/* The length written for a NULL value */
+#define SPILLED_NULL_VALUE_LENGTH -1
+
+struct AggregateSpillFile
+{
+	BufFile *file;
+
+	/* The position of the first value */
+	AggregateSpillPosition start;
+
+	/* The position the next value is written at */
+	AggregateSpillPosition end;
+
+	/* Whether the file is positioned at the end (no reads since the last write) */
+	bool isPositionedAtEnd;
+
+	/* Closes the file when the aggregate context is reset */
+	MemoryContextCallback resetCallback;
+};
+
+
+static void AggregateSpillFileResetCallback(void *arg);
+static void SeekAggregateSpillFile(AggregateSpillFile *spillFile,
+								   AggregateSpillPosition position);
+static void ReadAggregateSpillFileExact(AggregateSpillFile *spillFile, void *buffer,
+										size_t size);
+
+
+/*
+ * Creates a spill file that lives as long as the aggregate context.
+ */
+AggregateSpillFile *
+CreateAggregateSpillFile(MemoryContext aggregateContext)
+{
+	MemoryContext oldContext = MemoryContextSwitchTo(aggregateContext);
+
+	AggregateSpillFile *spillFile = palloc0(sizeof(AggregateSpillFile));
+
+	bool interXact = false;
+	spillFile->file = BufFileCreateTemp(interXact);
+	BufFileTell(spillFile->file, &spillFile->start.fileNumber,
+				&spillFile->start.offset);
+	spillFile->end = spillFile->start;
+	spillFile->isPositionedAtEnd = true;
+
+	spillFile->resetCallback.func = AggregateSpillFileResetCallback;
+	spillFile->resetCallback.arg = spillFile;
+	MemoryContextRegisterResetCallback(aggregateContext, &spillFile->resetCallback);
+
+	MemoryContextSwitchTo(oldContext);
+	return spillFile;
+}
+
+
+/*
+ * Appends a value (NULL allowed) at the end of the spill file.
+ */
+void
+AggregateSpillFileWrite(AggregateSpillFile *spillFile, const pgbson *value)
+{
+	if (!spillFile->isPositionedAtEnd)
+	{
+		SeekAggregateSpillFile(spillFile, spillFile->end);
+		spillFile->isPositionedAtEnd = true;
+	}
+
+	int32 length = value == NULL ? SPILLED_NULL_VALUE_LENGTH :
+				   (int32) VARSIZE_ANY_EXHDR(value);
+	BufFileWrite(spillFile->file, (void *) &length, sizeof(int32));
+	if (value != NULL)
+	{
+		BufFileWrite(spillFile->file, (void *) VARDATA_ANY(value), length);
+	}
+
+	BufFileTell(spillFile->file, &spillFile->end.fileNumber, &spillFile->end.offset);
+}
+
+
+/*
+ * Returns the position of the first value of the spill file.
+ */
+AggregateSpillPosition
+AggregateSpillFileStart(AggregateSpillFile *spillFile)
+{
+	return spillFile->start;
+}
+
+
+/*
+ * Returns the position the next value will be written at.
+ */
+AggregateSpillPosition
+AggregateSpillFileEnd(AggregateSpillFile *spillFile)
+{
+	return spillFile->end;
+}
+
+
+/*
+ * Reads the value at the given position and advances the position past it.
+ * The value is allocated in the current memory context.
+ */
+pgbson *
+AggregateSpillFileRead(AggregateSpillFile *spillFile,
+					   AggregateSpillPosition *position, bool *isNull)
+{
+	SeekAggregateSpillFile(spillFile, *position);
+	spillFile->isPositionedAtEnd = false;
+
+	int32 length;
+	ReadAggregateSpillFileExact(spillFile, &length, sizeof(int32));
+
+	pgbson *value = NULL;
+	*isNull = length == SPILLED_NULL_VALUE_LENGTH;
+	if (!*isNull)
+	{
+		value = palloc(length + VARHDRSZ);
+		SET_VARSIZE(value, length + VARHDRSZ);
+		ReadAggregateSpillFileExact(spillFile, VARDATA(value), length);
+	}
+
+	BufFileTell(spillFile->file, &position->fileNumber, &position->offset);
+	return value;
+}
+
+
+/*
+ * The size a state can hold in memory before it spills.
+ */
+int64
+AggregateSpillThresholdBytes(void)
+{
+	return (int64) AggregateStateSpillThresholdMB * 1024 * 1024;
+}
+
+
+/*
+ * States that spill are no longer bound by the intermediate size limit, but
+ * their values are still written to a single document at finalize.
+ */
+void
+CheckAggregateSpilledResultSize(int64 size)
+{
+	if (size > (int64) MaxAllocSize)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERMEDIATERESULTTOOLARGE),
+						errmsg(
+							"Size " INT64_FORMAT
+							" is larger than maximum size allowed for a spilled intermediate document %zu",
+							size, MaxAllocSize)));
+	}
+}
+
+
+/*
+ * Closes the file when the aggregate context is reset. On abort the file
+ * was already closed by the resource owner.
+ */
+static void
+AggregateSpillFileResetCallback(void *arg)
+{
+	AggregateSpillFile *spillFile = (AggregateSpillFile *) arg;
+	if (spillFile->file != NULL && IsTransactionState())
+	{
+		BufFileClose(spillFile->file);
+	}
+
+	spillFile->file = NULL;
+}
+
+
+static void
+SeekAggregateSpillFile(AggregateSpillFile *spillFile, AggregateSpillPosition position)
+{
+	if (BufFileSeek(spillFile->file, position.fileNumber, position.offset,
+					SEEK_SET) != 0)
+	{
+		ereport(ERROR, (errcode_for_file_access(),
+						errmsg("could not seek in aggregate spill file")));
+	}
+}
+
+
+static void
+ReadAggregateSpillFileExact(AggregateSpillFile *spillFile, void *buffer, size_t size)
+{
+	size_t bytesRead = BufFileRead(spillFile->file, buffer, size);
+	if (bytesRead != size)
+	{
+		ereport(ERROR, (errcode_for_file_access(),
+						errmsg("could not read from aggregate spill file: read only %zu "
+							   "of %zu bytes", bytesRead, size)));
+	}
+}
@@ -14,11 +14,13 @@
 #include <common/int.h>
 
 #include "aggregation/bson_aggregate.h"
+#include "aggregation/bson_aggregate_spill.h"
 #include "io/bson_core.h"
 #include "query/bson_compare.h"
 #include <utils/array.h>
 #include <utils/builtins.h>
 #include <utils/heap_utils.h>
+#include <utils/memutils.h>
 #include "utils/documentdb_errors.h"
 #include "metadata/collection.h"
 #include "commands/insert.h"
@@ -45,7 +47,7 @@ typedef struct BsonNumericAggState
 typedef struct BsonArrayAggState
 {
 	/* The total size of documents accumulated so far */
-	int32 currentSizeWritten;
+	int64 currentSizeWritten;
 
 	/* The list of accumulated documents */
 	List *aggregateList;
@@ -55,6 +57,18 @@ typedef struct BsonArrayAggState
 	bool isWindowAggregation;
 
 	bool handleSingleValueElement;
+
+	/* Whether the documents can be spilled to disk (allowDiskUse) */
+	bool allowSpill;
+
+	/* The size of the documents in aggregateList (when spilling is allowed) */
+	int64 inMemorySize;
+
+	/* The context of the documents in aggregateList (when spilling is allowed) */
+	MemoryContext valuesContext;
+
+	/* The documents spilled so far, written before aggregateList */
+	AggregateSpillFile *spillFile;
 } BsonArrayAggState;
 
 
@@ -76,8 +90,45 @@ typedef struct BsonAddToSetState
 	List *aggregateList;
 
 	bool isWindowAggregation;
+
+	/* Whether the set can be spilled to disk as sorted runs (allowDiskUse) */
+	bool allowSpill;
+
+	/* The size of the values in set (when spilling is allowed) */
+	int64 inMemorySize;
+
+	/* The context of set and its values (when spilling is allowed) */
+	MemoryContext valuesContext;
+
+	/* The sorted runs spilled so far (AddToSetSpilledRun) */
+	AggregateSpillFile *spillFile;
+	List *spilledRuns;
 } BsonAddToSetState;
 
+/* A sorted run of distinct values spilled by $addToSet */
+typedef struct AddToSetSpilledRun
+{
+	AggregateSpillPosition start;
+	int64 numValues;
+} AddToSetSpilledRun;
+
+/* A source of sorted values merged by the $addToSet final function */
+typedef struct AddToSetMergeSource
+{
+	/* The spilled run read from (NULL for the values in memory) */
+	AddToSetSpilledRun *run;
+	AggregateSpillPosition position;
+	int64 remainingValues;
+
+	/* The values in memory, sorted */
+	bson_value_t *values;
+
+	/* The current value, and the document holding it if read from a run */
+	bool hasCurrent;
+	bson_value_t current;
+	pgbson *currentDocument;
+} AddToSetMergeSource;
+
 /* state used for maxN and minN both */
 typedef struct DynamicHeapState
 {
@@ -95,7 +146,6 @@ const char charset[] = "abcdefghijklmnopqrstuvwxyz0123456789";
 /* --------------------------------------------------------- */
 
 static MaxAlignedVarlena * AllocateBsonNumericAggState(void);
-static void CheckAggregateIntermediateResultSize(uint32_t size);
 static void CreateObjectAggTreeNodes(BsonObjectAggState *currentState,
 									 pgbson *currentValue);
 static void ValidateMergeObjectsInput(pgbson *input);
@@ -103,6 +153,19 @@ static Datum ParseAndReturnMergeObjectsTree(BsonObjectAggState *state);
 static Datum bson_maxminn_transition(PG_FUNCTION_ARGS, bool isMaxN);
 static void BsonArrayAggFinalCore(BsonArrayAggState *state,
 								  pgbson_array_writer *arrayWriter);
+static void WriteArrayAggValue(BsonArrayAggState *state, pgbson *currentValue,
+							   pgbson_array_writer *arrayWriter);
+static void SpillArrayAggState(BsonArrayAggState *state,
+							   MemoryContext aggregateContext);
+static void SpillAddToSetState(BsonAddToSetState *state,
+							   MemoryContext aggregateContext);
+static void WriteSpilledAddToSetValues(BsonAddToSetState *state,
+									   pgbson_array_writer *arrayWriter);
+static void AdvanceAddToSetMergeSource(BsonAddToSetState *state,
+									   AddToSetMergeSource *source);
+static bson_value_t * GetSortedAddToSetValues(BsonAddToSetState *state,
+											  int64 *numValues);
+static int CompareBsonValuesForSort(const void *left, const void *right);
 
 void DeserializeBinaryHeapState(bytea *byteArray, DynamicHeapState *state);
 bytea * SerializeBinaryHeapState(MemoryContext aggregateContext, DynamicHeapState *state,
@@ -164,7 +227,7 @@ bson_out_final(PG_FUNCTION_ARGS)
 
 inline static Datum
 BsonArrayAggTransitionCore(PG_FUNCTION_ARGS, bool handleSingleValueElement,
-						   const char *path)
+						   const char *path, bool allowSpill)
 {
 	BsonArrayAggState *currentState = { 0 };
 	MaxAlignedVarlena *bytes;
@@ -192,6 +255,15 @@ BsonArrayAggTransitionCore(PG_FUNCTION_ARGS, bool handleSingleValueElement,
 		currentState->aggregateList = NIL;
 		currentState->handleSingleValueElement = handleSingleValueElement;
 		currentState->path = pstrdup(path);
+
+		/* Window frames remove values from the head of the list so they stay in memory */
+		currentState->allowSpill = allowSpill && !isWindowAggregation;
+		if (currentState->allowSpill)
+		{
+			currentState->valuesContext = AllocSetContextCreate(aggregateContext,
+																"BsonArrayAggValues",
+																ALLOCSET_DEFAULT_SIZES);
+		}
 	}
 	else
 	{
@@ -205,6 +277,23 @@ BsonArrayAggTransitionCore(PG_FUNCTION_ARGS, bool handleSingleValueElement,
 	{
 		currentState->aggregateList = lappend(currentState->aggregateList, NULL);
 	}
+	else if (currentState->allowSpill)
+	{
+		uint32 currentValueSize = PgbsonGetBsonSize(currentValue);
+		CheckAggregateSpilledResultSize(currentState->currentSizeWritten +
+										currentValueSize);
+		pgbson *copiedPgbson = CopyPgbsonIntoMemoryContext(currentValue,
+														   currentState->valuesContext);
+		currentState->aggregateList = lappend(currentState->aggregateList,
+											  copiedPgbson);
+		currentState->currentSizeWritten += currentValueSize;
+		currentState->inMemorySize += currentValueSize;
+
+		if (currentState->inMemorySize > AggregateSpillThresholdBytes())
+		{
+			SpillArrayAggState(currentState, aggregateContext);
+		}
+	}
 	else
 	{
 		uint32 currentValueSize = PgbsonGetBsonSize(currentValue);
@@ -231,10 +320,15 @@ bson_array_agg_transition(PG_FUNCTION_ARGS)
 {
 	char *path = text_to_cstring(PG_GETARG_TEXT_P(2));
 
-	/* We currently have 2 implementations of bson_array_agg. The newest has a parameter for handleSingleValueElement. */
-	bool handleSingleValueElement = PG_NARGS() == 4 ? PG_GETARG_BOOL(3) : false;
+	/*
+	 * We currently have 3 implementations of bson_array_agg. The newer ones have a parameter
+	 * for handleSingleValueElement, and then one for whether the state can spill to disk.
+	 */
+	bool handleSingleValueElement = PG_NARGS() >= 4 ? PG_GETARG_BOOL(3) : false;
+	bool allowSpill = PG_NARGS() == 5 ? PG_GETARG_BOOL(4) : false;
 
-	return BsonArrayAggTransitionCore(fcinfo, handleSingleValueElement, path);
+	return BsonArrayAggTransitionCore(fcinfo, handleSingleValueElement, path,
+									  allowSpill);
 }
 
 
@@ -296,7 +390,9 @@ bson_distinct_array_agg_transition(PG_FUNCTION_ARGS)
 {
 	bool handleSingleValueElement = true;
 	char *path = "values";
-	return BsonArrayAggTransitionCore(fcinfo, handleSingleValueElement, path);
+	bool allowSpill = false;
+	return BsonArrayAggTransitionCore(fcinfo, handleSingleValueElement, path,
+									  allowSpill);
 }
 
 
@@ -1109,8 +1205,25 @@ bson_add_to_set_transition(PG_FUNCTION_ARGS)
 		currentState = (BsonAddToSetState *) bytes->state;
 		currentState->currentSizeWritten = 0;
 		currentState->aggregateList = NIL;
-		currentState->set = CreateBsonValueHashSet();
 		currentState->isWindowAggregation = isWindowAggregation;
+
+		/*
+		 * The newer bson_add_to_set has a parameter for whether the state can spill
+		 * to disk. Spilled runs are merged from the list of values in memory so this
+		 * requires the rewrite.
+		 */
+		currentState->allowSpill = PG_NARGS() == 3 && PG_GETARG_BOOL(2) &&
+								   !isWindowAggregation &&
+								   EnableAddToSetAggregationRewrite;
+		if (currentState->allowSpill)
+		{
+			currentState->valuesContext = AllocSetContextCreate(aggregateContext,
+																"BsonAddToSetValues",
+																ALLOCSET_DEFAULT_SIZES);
+			MemoryContextSwitchTo(currentState->valuesContext);
+		}
+
+		currentState->set = CreateBsonValueHashSet();
 	}
 	else
 	{
@@ -1118,12 +1231,26 @@ bson_add_to_set_transition(PG_FUNCTION_ARGS)
 		currentState = (BsonAddToSetState *) bytes->state;
 	}
 
+	/* Values of states that spill are allocated in their own context */
+	if (currentState->allowSpill)
+	{
+		MemoryContextSwitchTo(currentState->valuesContext);
+	}
+
 	pgbson *currentValue = PG_GETARG_MAYBE_NULL_PGBSON(1);
 	if (currentValue != NULL && !IsPgbsonEmptyDocument(currentValue))
 	{
 		uint32 currentValueSize = PgbsonGetBsonSize(currentValue);
-		CheckAggregateIntermediateResultSize(currentState->currentSizeWritten +
-											 currentValueSize);
+		if (currentState->allowSpill)
+		{
+			CheckAggregateSpilledResultSize(currentState->currentSizeWritten +
+											currentValueSize);
+		}
+		else
+		{
+			CheckAggregateIntermediateResultSize(currentState->currentSizeWritten +
+												 currentValueSize);
+		}
 
 		/*
 		 * We need to copy the whole pgbson because otherwise the pointers we store
@@ -1148,12 +1275,13 @@ bson_add_to_set_transition(PG_FUNCTION_ARGS)
 			if (!found)
 			{
 				currentState->currentSizeWritten += PgbsonGetBsonSize(currentValue);
+				currentState->inMemorySize += PgbsonGetBsonSize(currentValue);
 			}
 
 			/*
 			 * If rewrite is enabled, append to list to avoid hash table iteration in final function.
 			 */
-			if (!found && EnableAddToSetAggregationRewrite)
+			if (!found && (EnableAddToSetAggregationRewrite || currentState->allowSpill))
 			{
 				bson_value_t *bsonValueCopy = palloc(sizeof(bson_value_t));
 				*bsonValueCopy = singleBsonElement.bsonValue;
@@ -1166,6 +1294,12 @@ bson_add_to_set_transition(PG_FUNCTION_ARGS)
 			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
 							errmsg("Bad input format for addToSet transition.")));
 		}
+
+		if (currentState->allowSpill &&
+			currentState->inMemorySize > AggregateSpillThresholdBytes())
+		{
+			SpillAddToSetState(currentState, aggregateContext);
+		}
 	}
 
 	MemoryContextSwitchTo(oldContext);
@@ -1191,7 +1325,12 @@ bson_add_to_set_final(PG_FUNCTION_ARGS)
 		pgbson_array_writer arrayWriter;
 		PgbsonWriterStartArray(&writer, "", 0, &arrayWriter);
 
-		if (EnableAddToSetAggregationRewrite)
+		if (state->spillFile != NULL)
+		{
+			/* The set and the list are kept so that this can be called again on ReScan */
+			WriteSpilledAddToSetValues(state, &arrayWriter);
+		}
+		else if (EnableAddToSetAggregationRewrite)
 		{
 			ListCell *cell;
 			foreach(cell, state->aggregateList)
@@ -1290,40 +1429,273 @@ AllocateBsonNumericAggState()
 static void
 BsonArrayAggFinalCore(BsonArrayAggState *state, pgbson_array_writer *arrayWriter)
 {
+	if (state->spillFile != NULL)
+	{
+		/* The spilled documents precede the ones in memory */
+		AggregateSpillPosition position = AggregateSpillFileStart(state->spillFile);
+		AggregateSpillPosition end = AggregateSpillFileEnd(state->spillFile);
+		while (position.fileNumber != end.fileNumber || position.offset != end.offset)
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			bool isNull;
+			pgbson *currentValue = AggregateSpillFileRead(state->spillFile, &position,
+														  &isNull);
+			WriteArrayAggValue(state, currentValue, arrayWriter);
+			if (currentValue != NULL)
+			{
+				pfree(currentValue);
+			}
+		}
+	}
+
 	ListCell *cell;
 	foreach(cell, state->aggregateList)
 	{
-		pgbson *currentValue = lfirst(cell);
-		if (currentValue == NULL)
+		WriteArrayAggValue(state, lfirst(cell), arrayWriter);
+	}
+}
+
+
+/*
+ * Writes a single accumulated document of the bson array aggregation.
+ */
+static void
+WriteArrayAggValue(BsonArrayAggState *state, pgbson *currentValue,
+				   pgbson_array_writer *arrayWriter)
+{
+	if (currentValue == NULL)
+	{
+		if (!state->isWindowAggregation)
 		{
-			if (!state->isWindowAggregation)
+			PgbsonArrayWriterWriteNull(arrayWriter);
+		}
+	}
+	else
+	{
+		/* Empty pgbson values are missing field values which should not be pushed to the array */
+		bool isMissingValue = IsPgbsonEmptyDocument(currentValue);
+		if (!isMissingValue)
+		{
+			pgbsonelement singleBsonElement;
+			if (state->handleSingleValueElement &&
+				TryGetSinglePgbsonElementFromPgbson(currentValue,
+													&singleBsonElement) &&
+				singleBsonElement.pathLength == 0)
 			{
-				PgbsonArrayWriterWriteNull(arrayWriter);
+				/* If it's a bson that's { "": value } */
+				PgbsonArrayWriterWriteValue(arrayWriter,
+											&singleBsonElement.bsonValue);
+			}
+			else
+			{
+				PgbsonArrayWriterWriteDocument(arrayWriter, currentValue);
 			}
 		}
-		else
+	}
+}
+
+
+/*
+ * Appends the documents in memory of the bson array aggregation to its
+ * spill file and releases them.
+ */
+static void
+SpillArrayAggState(BsonArrayAggState *state, MemoryContext aggregateContext)
+{
+	if (state->spillFile == NULL)
+	{
+		state->spillFile = CreateAggregateSpillFile(aggregateContext);
+	}
+
+	ListCell *cell;
+	foreach(cell, state->aggregateList)
+	{
+		AggregateSpillFileWrite(state->spillFile, lfirst(cell));
+	}
+
+	/* The list itself is in the aggregate context */
+	list_free(state->aggregateList);
+	state->aggregateList = NIL;
+	MemoryContextReset(state->valuesContext);
+	state->inMemorySize = 0;
+}
+
+
+/*
+ * Writes the distinct values in memory of $addToSet to its spill file as a
+ * sorted run and starts a new set. The caller is in the values context.
+ */
+static void
+SpillAddToSetState(BsonAddToSetState *state, MemoryContext aggregateContext)
+{
+	if (state->spillFile == NULL)
+	{
+		state->spillFile = CreateAggregateSpillFile(aggregateContext);
+	}
+
+	int64 numValues = 0;
+	bson_value_t *values = GetSortedAddToSetValues(state, &numValues);
+
+	AddToSetSpilledRun *run = MemoryContextAlloc(aggregateContext,
+												 sizeof(AddToSetSpilledRun));
+	run->start = AggregateSpillFileEnd(state->spillFile);
+	run->numValues = numValues;
+	state->spilledRuns = lappend(state->spilledRuns, run);
+
+	for (int64 i = 0; i < numValues; i++)
+	{
+		pgbson *valueDocument = BsonValueToDocumentPgbson(&values[i]);
+		AggregateSpillFileWrite(state->spillFile, valueDocument);
+		pfree(valueDocument);
+	}
+
+	/* Releases the set, its values and the list of values */
+	MemoryContextReset(state->valuesContext);
+	state->set = CreateBsonValueHashSet();
+	state->aggregateList = NIL;
+	state->inMemorySize = 0;
+}
+
+
+/*
+ * Writes the distinct values of a $addToSet state that spilled: the sorted
+ * runs on disk and the values in memory are merged, and values present in
+ * more than one run are written once.
+ */
+static void
+WriteSpilledAddToSetValues(BsonAddToSetState *state, pgbson_array_writer *arrayWriter)
+{
+	int numSources = list_length(state->spilledRuns) + 1;
+	AddToSetMergeSource *sources = palloc0(sizeof(AddToSetMergeSource) * numSources);
+
+	int sourceIndex = 0;
+	ListCell *cell;
+	foreach(cell, state->spilledRuns)
+	{
+		AddToSetSpilledRun *run = lfirst(cell);
+		sources[sourceIndex].run = run;
+		sources[sourceIndex].position = run->start;
+		sources[sourceIndex].remainingValues = run->numValues;
+		AdvanceAddToSetMergeSource(state, &sources[sourceIndex]);
+		sourceIndex++;
+	}
+
+	AddToSetMergeSource *memorySource = &sources[sourceIndex];
+	memorySource->values = GetSortedAddToSetValues(state,
+												   &memorySource->remainingValues);
+	AdvanceAddToSetMergeSource(state, memorySource);
+
+	bson_value_t lastWritten = { 0 };
+	pgbson *lastWrittenDocument = NULL;
+	bool hasLastWritten = false;
+	while (true)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		AddToSetMergeSource *smallest = NULL;
+		for (int i = 0; i < numSources; i++)
+		{
+			if (sources[i].hasCurrent &&
+				(smallest == NULL ||
+				 CompareBsonValuesForSort(&sources[i].current, &smallest->current) < 0))
+			{
+				smallest = &sources[i];
+			}
+		}
+
+		if (smallest == NULL)
 		{
-			/* Empty pgbson values are missing field values which should not be pushed to the array */
-			bool isMissingValue = IsPgbsonEmptyDocument(currentValue);
-			if (!isMissingValue)
+			break;
+		}
+
+		/* Runs are sorted, so a value spilled more than once is seen consecutively */
+		if (!hasLastWritten ||
+			CompareBsonValuesForSort(&lastWritten, &smallest->current) != 0)
+		{
+			PgbsonArrayWriterWriteValue(arrayWriter, &smallest->current);
+			if (lastWrittenDocument != NULL)
 			{
-				pgbsonelement singleBsonElement;
-				if (state->handleSingleValueElement &&
-					TryGetSinglePgbsonElementFromPgbson(currentValue,
-														&singleBsonElement) &&
-					singleBsonElement.pathLength == 0)
-				{
-					/* If it's a bson that's { "": value } */
-					PgbsonArrayWriterWriteValue(arrayWriter,
-												&singleBsonElement.bsonValue);
-				}
-				else
-				{
-					PgbsonArrayWriterWriteDocument(arrayWriter, currentValue);
-				}
+				pfree(lastWrittenDocument);
 			}
+
+			lastWritten = smallest->current;
+			lastWrittenDocument = smallest->currentDocument;
+			hasLastWritten = true;
 		}
+		else if (smallest->currentDocument != NULL)
+		{
+			pfree(smallest->currentDocument);
+		}
+
+		smallest->currentDocument = NULL;
+		AdvanceAddToSetMergeSource(state, smallest);
+	}
+
+	pfree(sources);
+}
+
+
+/*
+ * Moves a merge source of $addToSet to its next value, if any.
+ */
+static void
+AdvanceAddToSetMergeSource(BsonAddToSetState *state, AddToSetMergeSource *source)
+{
+	source->hasCurrent = source->remainingValues > 0;
+	if (!source->hasCurrent)
+	{
+		return;
+	}
+
+	if (source->run == NULL)
+	{
+		source->current = *source->values;
+		source->values++;
 	}
+	else
+	{
+		bool isNull;
+		source->currentDocument = AggregateSpillFileRead(state->spillFile,
+														 &source->position, &isNull);
+
+		pgbsonelement element;
+		PgbsonToSinglePgbsonElement(source->currentDocument, &element);
+		source->current = element.bsonValue;
+	}
+
+	source->remainingValues--;
+}
+
+
+/*
+ * Returns the distinct values in memory of a $addToSet state sorted.
+ */
+static bson_value_t *
+GetSortedAddToSetValues(BsonAddToSetState *state, int64 *numValues)
+{
+	*numValues = list_length(state->aggregateList);
+	bson_value_t *values = palloc(sizeof(bson_value_t) * Max(*numValues, 1));
+
+	int64 index = 0;
+	ListCell *cell;
+	foreach(cell, state->aggregateList)
+	{
+		values[index++] = *(bson_value_t *) lfirst(cell);
+	}
+
+	qsort(values, *numValues, sizeof(bson_value_t), CompareBsonValuesForSort);
+	return values;
+}
+
+
+static int
+CompareBsonValuesForSort(const void *left, const void *right)
+{
+	bool isComparisonValidIgnore;
+	return CompareBsonValueAndType((const bson_value_t *) left,
+								   (const bson_value_t *) right,
+								   &isComparisonValidIgnore);
 }
 
 
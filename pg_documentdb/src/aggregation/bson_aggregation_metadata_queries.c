@@ -62,9 +62,6 @@ static Query * GenerateBaseListIndexesQuery(text *databaseDatum, const
 											StringView *collectionName,
 											AggregationPipelineBuildContext *context);
 
-static Query * BuildSingleFunctionQuery(Oid queryFunctionOid, List *queryArgs, bool
-										isMultiRow);
-
 
 /*
  * Generates the base query for collection agnostic aggregate queries
@@ -688,11 +685,51 @@ HandleIndexStats(const bson_value_t *existingValue, Query *query,
 }
 
 
+/*
+ * Modifies the query to handle the $queryStats stage.
+ * This stage will form the query
+ * SELECT document FROM ApiInternalSchema.query_stats_aggregation({ queryStatsSpec });
+ * Requires this to be the first stage on the admin database, so the prior
+ * query is discarded.
+ */
+Query *
+HandleQueryStats(const bson_value_t *existingValue, Query *query,
+				 AggregationPipelineBuildContext *context)
+{
+	ReportFeatureUsage(FEATURE_STAGE_QUERY_STATS);
+	EnsureTopLevelFieldValueType("$queryStats", existingValue, BSON_TYPE_DOCUMENT);
+
+	if (context->stageNum != 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_LOCATION40602),
+						errmsg(
+							"The $queryStats operator can only be used as the initial stage in the pipeline.")));
+	}
+
+	const char *databaseStr = text_to_cstring(context->databaseNameDatum);
+	if (strcmp(databaseStr, "admin") != 0 ||
+		query->jointree->fromlist != NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INVALIDNAMESPACE),
+						errmsg(
+							"$queryStats must be executed on the 'admin' database with parameter {aggregate: 1}")));
+	}
+
+	/* The spec is validated by the function */
+	pgbson *bson = PgbsonInitFromDocumentBsonValue(existingValue);
+	List *queryStatsArgs = list_make1(MakeBsonConst(bson));
+
+	bool isMultiRow = true;
+	return BuildSingleFunctionQuery(BsonQueryStatsAggregationFunctionId(),
+									queryStatsArgs, isMultiRow);
+}
+
+
 /*
  * Builds a single query that is the equivalent of
  * SELECT document FROM queryFunction(args);
  */
-static Query *
+Query *
 BuildSingleFunctionQuery(Oid queryFunctionOid, List *queryArgs, bool isMultiRow)
 {
 	Query *query = makeNode(Query);
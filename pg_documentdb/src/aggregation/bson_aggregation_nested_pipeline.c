@@ -795,6 +795,7 @@ CreateInverseMatchFromCollectionQuery(InverseMatchArgs *inverseMatchArgs,
 	subPipelineContext.nestedPipelineLevel = context->nestedPipelineLevel + 1;
 	subPipelineContext.databaseNameDatum = context->databaseNameDatum;
 	subPipelineContext.variableSpec = context->variableSpec;
+	subPipelineContext.disallowDiskUse = context->disallowDiskUse;
 	subPipelineContext.parentStageName = ParentStageName_INVERSEMATCH;
 	strncpy((char *) subPipelineContext.collationString, context->collationString,
 			MAX_ICU_COLLATION_LENGTH);
@@ -1079,6 +1080,7 @@ HandleUnionWith(const bson_value_t *existingValue, Query *query,
 		subPipelineContext.nestedPipelineLevel = context->nestedPipelineLevel + 1;
 		subPipelineContext.databaseNameDatum = context->databaseNameDatum;
 		subPipelineContext.variableSpec = context->variableSpec;
+		subPipelineContext.disallowDiskUse = context->disallowDiskUse;
 		subPipelineContext.parentStageName = ParentStageName_UNIONWITH;
 		strncpy((char *) subPipelineContext.collationString, context->collationString,
 				MAX_ICU_COLLATION_LENGTH);
@@ -1098,6 +1100,7 @@ HandleUnionWith(const bson_value_t *existingValue, Query *query,
 		subPipelineContext.nestedPipelineLevel = context->nestedPipelineLevel + 1;
 		subPipelineContext.databaseNameDatum = context->databaseNameDatum;
 		subPipelineContext.variableSpec = context->variableSpec;
+		subPipelineContext.disallowDiskUse = context->disallowDiskUse;
 		subPipelineContext.parentStageName = ParentStageName_UNIONWITH;
 		strncpy((char *) subPipelineContext.collationString, context->collationString,
 				MAX_ICU_COLLATION_LENGTH);
@@ -1279,6 +1282,7 @@ BuildFacetUnionAllQuery(int numStages, const bson_value_t *facetValue,
 		nestedContext.databaseNameDatum = parentContext->databaseNameDatum;
 		nestedContext.sortSpec = *sortSpec;
 		nestedContext.variableSpec = parentContext->variableSpec;
+		nestedContext.disallowDiskUse = parentContext->disallowDiskUse;
 		nestedContext.parentStageName = ParentStageName_FACET;
 		strncpy((char *) nestedContext.collationString, parentContext->collationString,
 				MAX_ICU_COLLATION_LENGTH);
@@ -1337,6 +1341,7 @@ BuildFacetUnionAllQuery(int numStages, const bson_value_t *facetValue,
 			nestedContext.databaseNameDatum = parentContext->databaseNameDatum;
 			nestedContext.sortSpec = *sortSpec;
 			nestedContext.variableSpec = parentContext->variableSpec;
+			nestedContext.disallowDiskUse = parentContext->disallowDiskUse;
 			nestedContext.parentStageName = ParentStageName_FACET;
 			strncpy((char *) nestedContext.collationString,
 					parentContext->collationString, MAX_ICU_COLLATION_LENGTH);
@@ -3570,6 +3575,7 @@ GenerateBaseCaseQuery(AggregationPipelineBuildContext *parentContext,
 	subPipelineContext.nestedPipelineLevel = parentContext->nestedPipelineLevel + 2;
 	subPipelineContext.databaseNameDatum = parentContext->databaseNameDatum;
 	subPipelineContext.variableSpec = parentContext->variableSpec;
+	subPipelineContext.disallowDiskUse = parentContext->disallowDiskUse;
 	strncpy((char *) subPipelineContext.collationString, parentContext->collationString,
 			MAX_ICU_COLLATION_LENGTH);
 	pg_uuid_t *collectionUuid = NULL;
@@ -3670,6 +3676,7 @@ GenerateRecursiveCaseQuery(AggregationPipelineBuildContext *parentContext,
 	subPipelineContext.nestedPipelineLevel = parentContext->nestedPipelineLevel + 2;
 	subPipelineContext.databaseNameDatum = parentContext->databaseNameDatum;
 	subPipelineContext.variableSpec = parentContext->variableSpec;
+	subPipelineContext.disallowDiskUse = parentContext->disallowDiskUse;
 	strncpy((char *) subPipelineContext.collationString, parentContext->collationString,
 			MAX_ICU_COLLATION_LENGTH);
 	pg_uuid_t *collectionUuid = NULL;
@@ -3845,6 +3852,7 @@ BuildRecursiveGraphLookupQuery(QuerySource parentSource, GraphLookupArgs *args,
 	subPipelineContext.nestedPipelineLevel = parentContext->nestedPipelineLevel + 1;
 	subPipelineContext.databaseNameDatum = parentContext->databaseNameDatum;
 	subPipelineContext.variableSpec = parentContext->variableSpec;
+	subPipelineContext.disallowDiskUse = parentContext->disallowDiskUse;
 	strncpy((char *) subPipelineContext.collationString, parentContext->collationString,
 			MAX_ICU_COLLATION_LENGTH);
 
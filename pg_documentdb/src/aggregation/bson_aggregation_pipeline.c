@@ -72,6 +72,7 @@
 #include "aggregation/bson_densify.h"
 #include "collation/collation.h"
 #include "api_hooks.h"
+#include "aggregation/bson_index_distinct_scan.h"
 
 extern bool EnableCursorsOnAggregationQueryRewrite;
 extern bool EnableCollation;
@@ -84,6 +85,8 @@ extern bool EnableNewCountAggregates;
 extern bool EnableUseLookupNewProjectInlineMethod;
 extern bool InlineChangeStreamMatchStage;
 extern bool RemoveMatchNamespaceFilters;
+extern bool EnableIndexDistinctScan;
+extern bool EnableAggregateSpill;
 
 /* GUC to config tdigest compression */
 extern int TdigestCompressionAccuracy;
@@ -217,6 +220,10 @@ static Query * HandleGeoNear(const bson_value_t *existingValue, Query *query,
 static Query * HandleMatchAggregationStage(const bson_value_t *existingValue,
 										   Query *query,
 										   AggregationPipelineBuildContext *context);
+static Query * BuildIndexDistinctScanQuery(Oid indexId, pgbson *groupSpec);
+static Query * TryBuildIndexGroupCountQuery(const bson_value_t *existingValue,
+											Query *query,
+											AggregationPipelineBuildContext *context);
 
 static bool RequiresPersistentCursorFalse(const bson_value_t *pipelineValue,
 										  bool *isSingleRowResult);
@@ -660,6 +667,24 @@ static const AggregationStageDefinition StageDefinitions[] =
 		.allowBaseShardTablePushdown = true,
 		.stageEnum = Stage_Project,
 	},
+	{
+		.stage = "$queryStats",
+		.mutateFunc = &HandleQueryStats,
+		.requiresPersistentCursor = &RequiresPersistentCursorTrue,
+
+		/* Changes the projector - can't be inlined */
+		.canInlineLookupStageFunc = NULL,
+
+		/* queryStats changes the output format */
+		.preservesStableSortOrder = false,
+
+		.canHandleAgnosticQueries = true,
+		.isProjectTransform = false,
+		.isOutputStage = false,
+		.pipelineCheckFunc = NULL,
+		.allowBaseShardTablePushdown = false,
+		.stageEnum = Stage_QueryStats,
+	},
 	{
 		.stage = "$redact",
 		.mutateFunc = &HandleRedact,
@@ -1261,8 +1286,9 @@ GenerateAggregationQuery(text *database, pgbson *aggregationSpec, QueryData *que
 		}
 		else if (StringViewEqualsCString(&keyView, "allowDiskUse"))
 		{
-			/* We otherwise ignore this for now (TODO Support this) */
+			/* Honored by the accumulators that can spill to disk (see HandleGroup) */
 			EnsureTopLevelFieldType("allowDiskUse", &aggregationIterator, BSON_TYPE_BOOL);
+			context.disallowDiskUse = !bson_iter_bool(&aggregationIterator);
 		}
 		else if (StringViewEqualsCString(&keyView, "explain"))
 		{
@@ -2351,6 +2377,27 @@ GenerateDistinctQuery(text *databaseDatum, pgbson *distinctSpec, bool setStateme
 		query = HandleMatch(&filter, query, &context);
 		context.stageNum++;
 	}
+	else if (EnableIndexDistinctScan)
+	{
+		/* Unfiltered distinct: see if we can walk the keys of an index instead */
+		Oid distinctIndexId = GetIndexForDistinctScan(context.mongoCollection,
+													  &distinctKey);
+		if (OidIsValid(distinctIndexId))
+		{
+			query = BuildIndexDistinctScanQuery(distinctIndexId, NULL);
+
+			ParseState *parseState = make_parsestate(NULL);
+			parseState->p_expr_kind = EXPR_KIND_SELECT_TARGET;
+
+			TargetEntry *firstEntry = linitial(query->targetList);
+			parseState->p_next_resno = firstEntry->resno + 1;
+			Aggref *aggref = CreateSingleArgAggregate(BsonDistinctAggregateFunctionOid(),
+													  firstEntry->expr, parseState);
+			firstEntry->expr = (Expr *) aggref;
+			query->hasAggs = true;
+			return query;
+		}
+	}
 
 	query = HandleDistinct(&distinctKey, query, &context);
 
@@ -2358,6 +2405,27 @@ GenerateDistinctQuery(text *databaseDatum, pgbson *distinctSpec, bool setStateme
 }
 
 
+/*
+ * Builds the query
+ * SELECT document FROM ApiInternalSchemaName.bson_index_distinct_scan(indexId, groupSpec)
+ * which produces the distinct values (or the per value counts if groupSpec is
+ * specified) of the first path of the index by walking its keys.
+ */
+static Query *
+BuildIndexDistinctScanQuery(Oid indexId, pgbson *groupSpec)
+{
+	Const *indexIdConst = makeConst(OIDOID, -1, InvalidOid, sizeof(Oid),
+									ObjectIdGetDatum(indexId), false, true);
+	Const *groupSpecConst = groupSpec != NULL ? MakeBsonConst(groupSpec) :
+							makeNullConst(BsonTypeId(), -1, InvalidOid);
+
+	bool isMultiRow = true;
+	return BuildSingleFunctionQuery(BsonIndexDistinctScanFunctionOid(),
+									list_make2(indexIdConst, groupSpecConst),
+									isMultiRow);
+}
+
+
 /*
  * Parses the GetMore wire protocol spec and returns the cursorId associated
  * with it. Also updates the queryData with cursor related information.
@@ -5238,16 +5306,15 @@ GetDocumentExprForGroupAccumulatorValue(const bson_value_t *accumulatorValue,
 
 
 /*
- * Simple helper method that has logic to insert a Group accumulator to a query.
- * This adds the group aggregate to the TargetEntry (for projection)
- * and also adds the necessary data to the bson_repath_and_build arguments.
+ * Same as AddSimpleGroupAccumulator for aggregates that take an additional
+ * argument after the accumulated value (if extraArgument is not NULL).
  */
-inline static List *
-AddSimpleGroupAccumulator(Query *query, const bson_value_t *accumulatorValue,
-						  List *repathArgs, Const *accumulatorText,
-						  ParseState *parseState, char *identifiers,
-						  Expr *documentExpr, Oid aggregateFunctionOid,
-						  Expr *variableSpec)
+static List *
+AddSimpleGroupAccumulatorWithArgument(Query *query, const bson_value_t *accumulatorValue,
+									  List *repathArgs, Const *accumulatorText,
+									  ParseState *parseState, char *identifiers,
+									  Expr *documentExpr, Oid aggregateFunctionOid,
+									  Expr *variableSpec, Expr *extraArgument)
 {
 	Expr *constValue = (Expr *) MakeBsonConst(BsonValueToDocumentPgbson(
 												  accumulatorValue));
@@ -5282,8 +5349,21 @@ AddSimpleGroupAccumulator(Query *query, const bson_value_t *accumulatorValue,
 			InvalidOid, COERCE_EXPLICIT_CALL);
 	}
 
-	Aggref *aggref = CreateSingleArgAggregate(aggregateFunctionOid,
-											  (Expr *) accumFunc, parseState);
+	Aggref *aggref;
+	if (extraArgument == NULL)
+	{
+		aggref = CreateSingleArgAggregate(aggregateFunctionOid, (Expr *) accumFunc,
+										  parseState);
+	}
+	else
+	{
+		aggref = CreateMultiArgAggregate(aggregateFunctionOid,
+										 list_make2(accumFunc, extraArgument),
+										 list_make2_oid(BsonTypeId(),
+														exprType((Node *) extraArgument)),
+										 parseState);
+	}
+
 	repathArgs = lappend(repathArgs, AddGroupExpression((Expr *) accumulatorText,
 														parseState, identifiers,
 														query, TEXTOID, NULL));
@@ -5295,6 +5375,27 @@ AddSimpleGroupAccumulator(Query *query, const bson_value_t *accumulatorValue,
 }
 
 
+/*
+ * Simple helper method that has logic to insert a Group accumulator to a query.
+ * This adds the group aggregate to the TargetEntry (for projection)
+ * and also adds the necessary data to the bson_repath_and_build arguments.
+ */
+inline static List *
+AddSimpleGroupAccumulator(Query *query, const bson_value_t *accumulatorValue,
+						  List *repathArgs, Const *accumulatorText,
+						  ParseState *parseState, char *identifiers,
+						  Expr *documentExpr, Oid aggregateFunctionOid,
+						  Expr *variableSpec)
+{
+	Expr *extraArgument = NULL;
+	return AddSimpleGroupAccumulatorWithArgument(query, accumulatorValue, repathArgs,
+												 accumulatorText, parseState,
+												 identifiers, documentExpr,
+												 aggregateFunctionOid, variableSpec,
+												 extraArgument);
+}
+
+
 inline static List *
 AddSumGroupAccumulator(Query *query, const bson_value_t *accumulatorValue,
 					   List *repathArgs, Const *accumulatorText,
@@ -5349,7 +5450,7 @@ AddArrayAggGroupAccumulator(Query *query, const bson_value_t *accumulatorValue,
 							ParseState *parseState, char *identifiers,
 							Expr *documentExpr, Oid aggregateFunctionOid,
 							char *fieldPath, bool handleSingleValue,
-							Expr *variableSpec)
+							Expr *variableSpec, Const *allowSpillConst)
 {
 	Expr *constValue = (Expr *) MakeBsonConst(BsonValueToDocumentPgbson(
 												  accumulatorValue));
@@ -5380,6 +5481,12 @@ AddArrayAggGroupAccumulator(Query *query, const bson_value_t *accumulatorValue,
 		MakeBoolValueConst(handleSingleValue));
 	List *argTypesList = list_make3_oid(BsonTypeId(), TEXTOID, BOOLOID);
 
+	if (allowSpillConst != NULL)
+	{
+		aggregateArgs = lappend(aggregateArgs, allowSpillConst);
+		argTypesList = lappend_oid(argTypesList, BOOLOID);
+	}
+
 	Aggref *aggref = CreateMultiArgAggregate(aggregateFunctionOid,
 											 aggregateArgs,
 											 argTypesList,
@@ -5815,6 +5922,111 @@ AddPercentileMedianGroupAccumulator(Query *query, const bson_value_t *accumulato
 }
 
 
+/*
+ * Checks whether a $group is of the form
+ * { $group: { _id: "$path", count1: { $sum: 1 }, count2: { $count: {} }, ... } }
+ * and is the first stage on a collection that has an index that can walk the
+ * distinct keys of "path". If so, returns a query that produces the group
+ * counts from the index keys. Otherwise returns NULL.
+ */
+static Query *
+TryBuildIndexGroupCountQuery(const bson_value_t *existingValue, Query *query,
+							 AggregationPipelineBuildContext *context)
+{
+	if (context->stageNum != 0 || context->mongoCollection == NULL ||
+		list_length(query->rtable) != 1 || query->jointree->quals != NULL ||
+		query->sortClause != NIL || query->limitCount != NULL)
+	{
+		return NULL;
+	}
+
+	RangeTblEntry *rte = linitial(query->rtable);
+	if (rte->rtekind != RTE_RELATION)
+	{
+		return NULL;
+	}
+
+	StringView groupPath = { 0 };
+	List *countFields = NIL;
+
+	pgbson_writer groupSpecWriter;
+	PgbsonWriterInit(&groupSpecWriter);
+
+	bson_iter_t groupIter;
+	BsonValueInitIterator(existingValue, &groupIter);
+	while (bson_iter_next(&groupIter))
+	{
+		StringView keyView = bson_iter_key_string_view(&groupIter);
+		const bson_value_t *value = bson_iter_value(&groupIter);
+		if (StringViewEquals(&keyView, &IdFieldStringView))
+		{
+			if (value->value_type != BSON_TYPE_UTF8 ||
+				value->value.v_utf8.len < 2 ||
+				value->value.v_utf8.str[0] != '$' ||
+				value->value.v_utf8.str[1] == '$')
+			{
+				return NULL;
+			}
+
+			groupPath.string = value->value.v_utf8.str + 1;
+			groupPath.length = value->value.v_utf8.len - 1;
+			continue;
+		}
+
+		/* Leave the validation of the field names to the regular path */
+		if (StringViewContains(&keyView, '.') || keyView.length == 0 ||
+			keyView.string[0] == '$')
+		{
+			return NULL;
+		}
+
+		ListCell *fieldCell;
+		foreach(fieldCell, countFields)
+		{
+			if (strcmp(lfirst(fieldCell), keyView.string) == 0)
+			{
+				return NULL;
+			}
+		}
+
+		pgbsonelement accumulatorElement;
+		if (value->value_type != BSON_TYPE_DOCUMENT ||
+			!TryGetBsonValueToPgbsonElement(value, &accumulatorElement))
+		{
+			return NULL;
+		}
+
+		bool isCountAccumulator =
+			(strcmp(accumulatorElement.path, "$sum") == 0 &&
+			 accumulatorElement.bsonValue.value_type == BSON_TYPE_INT32 &&
+			 accumulatorElement.bsonValue.value.v_int32 == 1) ||
+			(strcmp(accumulatorElement.path, "$count") == 0 &&
+			 IsBsonValueEmptyDocument(&accumulatorElement.bsonValue));
+		if (!isCountAccumulator)
+		{
+			return NULL;
+		}
+
+		countFields = lappend(countFields, (char *) keyView.string);
+		PgbsonWriterAppendInt32(&groupSpecWriter, keyView.string, keyView.length, 1);
+	}
+
+	if (groupPath.length == 0 || StringViewContains(&groupPath, '$'))
+	{
+		return NULL;
+	}
+
+	Oid groupIndexId = GetIndexForDistinctScan(context->mongoCollection, &groupPath);
+	if (!OidIsValid(groupIndexId))
+	{
+		return NULL;
+	}
+
+	return BuildIndexDistinctScanQuery(groupIndexId,
+									   PgbsonWriterGetPgbson(&groupSpecWriter));
+}
+
+
 /*
  * Handles the $group stage.
  * Creates a subquery.
@@ -5849,6 +6061,16 @@ HandleGroup(const bson_value_t *existingValue, Query *query,
 							"The fields of a group must be explicitly defined within an object")));
 	}
 
+	if (EnableIndexDistinctScan)
+	{
+		Query *indexGroupQuery = TryBuildIndexGroupCountQuery(existingValue, query,
+															  context);
+		if (indexGroupQuery != NULL)
+		{
+			return indexGroupQuery;
+		}
+	}
+
 	/* Push prior stuff to a subquery first since we're gonna aggregate our way */
 	if (list_length(query->targetList) > 1 || query->hasAggs ||
 		list_length(query->groupClause) > 0 || list_length(query->sortClause) > 0 ||
@@ -5933,6 +6155,16 @@ HandleGroup(const bson_value_t *existingValue, Query *query,
 														identifiers, query, BsonTypeId(),
 														&groupEntry));
 
+	/*
+	 * $push and $addToSet can spill their state to disk unless the aggregate
+	 * command sets allowDiskUse to false.
+	 */
+	Const *allowSpillConst = NULL;
+	if (EnableAggregateSpill)
+	{
+		allowSpillConst = (Const *) MakeBoolValueConst(!context->disallowDiskUse);
+	}
+
 	/* Now add accumulators */
 	parseState->p_expr_kind = EXPR_KIND_SELECT_TARGET;
 	BsonValueInitIterator(existingValue, &groupIter);
@@ -6213,14 +6445,31 @@ HandleGroup(const bson_value_t *existingValue, Query *query,
 		else if (StringViewEqualsCString(&accumulatorName, "$addToSet"))
 		{
 			ReportFeatureUsage(FEATURE_AGGREGATE_GROUP_ADD_TO_SET);
-			repathArgs = AddSimpleGroupAccumulator(query,
-												   &accumulatorElement.bsonValue,
-												   repathArgs,
-												   accumulatorText, parseState,
-												   identifiers,
-												   origEntry->expr,
-												   BsonAddToSetAggregateFunctionOid(),
-												   context->variableSpec);
+			if (allowSpillConst != NULL)
+			{
+				repathArgs = AddSimpleGroupAccumulatorWithArgument(query,
+																   &accumulatorElement.
+																   bsonValue,
+																   repathArgs,
+																   accumulatorText,
+																   parseState,
+																   identifiers,
+																   origEntry->expr,
+																   BsonAddToSetWithSpillAggregateFunctionOid(),
+																   context->variableSpec,
+																   (Expr *) allowSpillConst);
+			}
+			else
+			{
+				repathArgs = AddSimpleGroupAccumulator(query,
+													   &accumulatorElement.bsonValue,
+													   repathArgs,
+													   accumulatorText, parseState,
+													   identifiers,
+													   origEntry->expr,
+													   BsonAddToSetAggregateFunctionOid(),
+													   context->variableSpec);
+			}
 		}
 		else if (StringViewEqualsCString(&accumulatorName, "$mergeObjects"))
 		{
@@ -6255,16 +6504,20 @@ HandleGroup(const bson_value_t *existingValue, Query *query,
 			ReportFeatureUsage(FEATURE_AGGREGATE_GROUP_PUSH);
 			char *fieldPath = "";
 			bool handleSingleValue = true;
+			Oid arrayAggFunctionOid = allowSpillConst != NULL ?
+									  BsonArrayAggregateWithSpillFunctionOid() :
+									  BsonArrayAggregateAllArgsFunctionOid();
 			repathArgs = AddArrayAggGroupAccumulator(query,
 													 &accumulatorElement.bsonValue,
 													 repathArgs,
 													 accumulatorText, parseState,
 													 identifiers,
 													 origEntry->expr,
-													 BsonArrayAggregateAllArgsFunctionOid(),
+													 arrayAggFunctionOid,
 													 fieldPath,
 													 handleSingleValue,
-													 context->variableSpec);
+													 context->variableSpec,
+													 allowSpillConst);
 		}
 		else if (StringViewEqualsCString(&accumulatorName, "$stdDevSamp"))
 		{
@@ -3048,10 +3048,9 @@ HandleDollarConstFillWindowOperator(const bson_value_t *opValue,
 
 /*
  * Handle the $min window operator. This uses the existing
- * `bsonmin` aggregate function.
- *
- * TODO: This is just a quick implementation. Later add inverse transition
- * to make it performant for moving windows
+ * `bsonmin` aggregate function, whose moving-aggregate support
+ * (bson_min_moving_transition) handles sliding frames without
+ * recomputing the frame for every row.
  */
 static WindowFunc *
 HandleDollarMinWindowOperator(const bson_value_t *opValue,
@@ -3065,10 +3064,9 @@ HandleDollarMinWindowOperator(const bson_value_t *opValue,
 
 /*
  * Handle the $max window operator. This uses the existing
- * `bsonmax` aggregate function.
- *
- * TODO: This is just a quick implementation. Later add inverse transition
- * to make it performant for moving windows
+ * `bsonmax` aggregate function, whose moving-aggregate support
+ * (bson_max_moving_transition) handles sliding frames without
+ * recomputing the frame for every row.
  */
 static WindowFunc *
 HandleDollarMaxWindowOperator(const bson_value_t *opValue,
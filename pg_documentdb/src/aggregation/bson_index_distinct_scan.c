@@ -0,0 +1,569 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/aggregation/bson_index_distinct_scan.c
+ *
+ * Implementation of answering distinct and simple $group queries by walking
+ * the distinct keys of a composite index (a loose index scan) instead of
+ * reading every document in the collection.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <postgres.h>
+#include <miscadmin.h>
+#include <access/genam.h>
+#include <access/table.h>
+#include <access/tableam.h>
+#include <access/visibilitymap.h>
+#include <catalog/index.h>
+#include <catalog/pg_type.h>
+#include <executor/spi.h>
+#include <executor/tuptable.h>
+#include <storage/bufmgr.h>
+#include <utils/acl.h>
+#include <utils/builtins.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+#include <utils/rel.h>
+#include <utils/relcache.h>
+#include <utils/snapmgr.h>
+
+#include "io/bson_core.h"
+#include "io/bson_set_returning_functions.h"
+#include "aggregation/bson_index_distinct_scan.h"
+#include "index_am/index_am_utils.h"
+#include "metadata/metadata_cache.h"
+#include "opclass/bson_gin_index_mgmt.h"
+#include "opclass/bson_gin_index_term.h"
+#include "query/bson_compare.h"
+#include "utils/query_utils.h"
+
+
+/*
+ * State threaded through the entry key visitor.
+ */
+typedef struct IndexDistinctScanState
+{
+	/* The collection table and what's needed to check the visibility of TIDs */
+	Relation heapRelation;
+	IndexFetchTableData *fetchData;
+	TupleTableSlot *slot;
+	Buffer vmBuffer;
+	Snapshot snapshot;
+
+	/* The output of the function */
+	Tuplestorestate *tupleStore;
+	TupleDesc tupleDescriptor;
+
+	/* The $group spec with the count fields, or NULL for distinct */
+	pgbson *groupSpec;
+
+	/* The last value emitted (distinct) or being counted ($group) */
+	pgbson *currentValueDocument;
+	bson_value_t currentValue;
+	int64 currentCount;
+
+	/* For $group: the count of documents with a null or missing value */
+	int64 nullCount;
+
+	/* Temporary memory context reset for every key visited */
+	MemoryContext keyContext;
+} IndexDistinctScanState;
+
+
+PG_FUNCTION_INFO_V1(bson_index_distinct_scan);
+
+static bool IsIndexUsableForDistinctScan(Relation indexRelation, const StringView *path);
+static IndexEntryKeyVisitResult VisitDistinctEntryKey(Datum key, ItemPointerData *items,
+													  int32 numItems, void *state);
+static bool IsIndexDistinctItemVisible(IndexDistinctScanState *state, ItemPointer item);
+static void SetCurrentDistinctValue(IndexDistinctScanState *state,
+									const bson_value_t *value);
+static void WriteGroupCountRow(IndexDistinctScanState *state, const bson_value_t *value,
+							   int64 count);
+static void WriteDistinctRowsFromCollection(IndexDistinctScanState *state,
+											Relation indexRelation);
+
+
+/*
+ * bson_index_distinct_scan walks the distinct keys of the (composite) index
+ * given and returns the distinct values of its first path.
+ * If a group spec is given, this returns a document of the form
+ * { "_id": <value>, "<field>": <count>, ... } for every value with the number
+ * of documents that have that value for each field in the group spec
+ * (i.e. the $group { _id: "$path", <field>: { $sum: 1 } }). Otherwise,
+ * this returns a document of the form { "": <value> } for every distinct value
+ * (same as bson_distinct_unwind).
+ *
+ * Callers must ensure that the index is usable for this (see
+ * GetIndexForDistinctScan). If the index stopped being usable after the query
+ * was planned, the same rows are computed from the documents instead.
+ */
+Datum
+bson_index_distinct_scan(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(0))
+	{
+		ereport(ERROR, (errmsg("index id must not be null")));
+	}
+
+	Oid indexId = PG_GETARG_OID(0);
+	pgbson *groupSpec = PG_ARGISNULL(1) ? NULL : PG_GETARG_PGBSON(1);
+
+	TupleDesc descriptor;
+	Tuplestorestate *tupleStore = SetupBsonTuplestore(fcinfo, &descriptor);
+
+	Oid heapId = IndexGetRelation(indexId, false);
+	AclResult aclResult = pg_class_aclcheck(heapId, GetUserId(), ACL_SELECT);
+	if (aclResult != ACLCHECK_OK)
+	{
+		aclcheck_error(aclResult, OBJECT_TABLE, get_rel_name(heapId));
+	}
+
+	Relation heapRelation = table_open(heapId, AccessShareLock);
+	Relation indexRelation = index_open(indexId, AccessShareLock);
+
+	IndexDistinctScanState state = { 0 };
+	state.heapRelation = heapRelation;
+	state.fetchData = table_index_fetch_begin(heapRelation);
+	state.slot = table_slot_create(heapRelation, NULL);
+	state.vmBuffer = InvalidBuffer;
+	state.snapshot = GetActiveSnapshot();
+	state.tupleStore = tupleStore;
+	state.tupleDescriptor = descriptor;
+	state.groupSpec = groupSpec;
+	state.keyContext = AllocSetContextCreate(CurrentMemoryContext,
+											 "IndexDistinctScanKeyContext",
+											 ALLOCSET_DEFAULT_SIZES);
+
+	if (IsIndexUsableForDistinctScan(indexRelation, NULL))
+	{
+		GetMultikeyStatusFunc getMultiKeyStatus = NULL;
+		GetTruncationStatusFunc getTruncationStatus = NULL;
+		EnumerateIndexEntryKeysFunc enumerateEntryKeys =
+			GetIndexAmEnumerateEntryKeysFunc(indexRelation->rd_rel->relam,
+											 &getMultiKeyStatus, &getTruncationStatus);
+
+		AttrNumber firstAttribute = 1;
+		enumerateEntryKeys(indexRelation, firstAttribute, state.snapshot,
+						   VisitDistinctEntryKey, &state);
+	}
+	else
+	{
+		/*
+		 * The index became multi-key (or got truncated terms) since the query
+		 * was planned: Its keys no longer reproduce the values, so run the
+		 * regular query over the collection instead.
+		 */
+		WriteDistinctRowsFromCollection(&state, indexRelation);
+	}
+
+	if (groupSpec != NULL)
+	{
+		if (state.currentValueDocument != NULL)
+		{
+			WriteGroupCountRow(&state, &state.currentValue, state.currentCount);
+		}
+
+		if (state.nullCount > 0)
+		{
+			bson_value_t nullValue = { .value_type = BSON_TYPE_NULL };
+			WriteGroupCountRow(&state, &nullValue, state.nullCount);
+		}
+	}
+
+	if (BufferIsValid(state.vmBuffer))
+	{
+		ReleaseBuffer(state.vmBuffer);
+	}
+
+	ExecDropSingleTupleTableSlot(state.slot);
+	table_index_fetch_end(state.fetchData);
+	MemoryContextDelete(state.keyContext);
+
+	index_close(indexRelation, NoLock);
+	table_close(heapRelation, NoLock);
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * Returns the index to use to get the distinct values of the given path of
+ * the collection by walking its keys, or InvalidOid if there is none.
+ * This needs a composite index on the collection's local table whose first
+ * path is the requested path and whose terms reproduce the values exactly:
+ * i.e. it must not be a wildcard, partial, multi-key or have truncated terms.
+ */
+Oid
+GetIndexForDistinctScan(MongoCollection *collection, const StringView *path)
+{
+	if (collection == NULL || collection->viewDefinition != NULL ||
+		collection->shardKey != NULL)
+	{
+		return InvalidOid;
+	}
+
+	/* The index is only useful if the data is on this node */
+	Oid tableId = TryGetCollectionShardTable(collection, AccessShareLock);
+	if (!OidIsValid(tableId))
+	{
+		return InvalidOid;
+	}
+
+	Relation tableRelation = table_open(tableId, AccessShareLock);
+	List *indexIdList = RelationGetIndexList(tableRelation);
+	table_close(tableRelation, NoLock);
+
+	Oid distinctIndexId = InvalidOid;
+	ListCell *indexCell;
+	foreach(indexCell, indexIdList)
+	{
+		Oid indexId = lfirst_oid(indexCell);
+		Relation indexRelation = index_open(indexId, AccessShareLock);
+		bool isUsable = IsIndexUsableForDistinctScan(indexRelation, path);
+		index_close(indexRelation, NoLock);
+
+		if (isUsable)
+		{
+			distinctIndexId = indexId;
+			break;
+		}
+	}
+
+	list_free(indexIdList);
+	return distinctIndexId;
+}
+
+
+/*
+ * Whether the index can answer the distinct values of path (or of its first
+ * path if path is NULL) from its keys.
+ */
+static bool
+IsIndexUsableForDistinctScan(Relation indexRelation, const StringView *path)
+{
+	Oid relam = indexRelation->rd_rel->relam;
+	if (!indexRelation->rd_index->indisvalid ||
+		IndexRelationGetNumberOfKeyAttributes(indexRelation) != 1 ||
+		!IsBsonRegularIndexAm(relam) ||
+		!IsCompositeOpFamilyOid(relam, indexRelation->rd_opfamily[0]) ||
+		indexRelation->rd_opcoptions[0] == NULL ||
+		RelationGetIndexPredicate(indexRelation) != NIL)
+	{
+		return false;
+	}
+
+	GetMultikeyStatusFunc getMultiKeyStatus = NULL;
+	GetTruncationStatusFunc getTruncationStatus = NULL;
+	EnumerateIndexEntryKeysFunc enumerateEntryKeys =
+		GetIndexAmEnumerateEntryKeysFunc(relam, &getMultiKeyStatus,
+										 &getTruncationStatus);
+	if (enumerateEntryKeys == NULL || getMultiKeyStatus == NULL ||
+		getTruncationStatus == NULL)
+	{
+		return false;
+	}
+
+	BsonGinCompositePathOptions *options =
+		(BsonGinCompositePathOptions *) indexRelation->rd_opcoptions[0];
+	if (options->base.type != IndexOptionsType_Composite ||
+		options->wildcardPathIndex >= 0)
+	{
+		return false;
+	}
+
+	if (path != NULL &&
+		!StringViewEqualsCString(path, GetCompositeFirstIndexPath(options)))
+	{
+		return false;
+	}
+
+	/* Arrays produce a key per element, and truncated keys lose the value */
+	return !getMultiKeyStatus(indexRelation) && !getTruncationStatus(indexRelation);
+}
+
+
+/*
+ * Visits a chunk of TIDs of an index key: For distinct, emits the value of the
+ * key as soon as a visible document is found for it. For $group, counts the
+ * visible documents for the value.
+ * Keys with equal values (e.g. 1 and 1.0) are adjacent in the index so they're
+ * merged by comparing against the last value seen.
+ */
+static IndexEntryKeyVisitResult
+VisitDistinctEntryKey(Datum key, ItemPointerData *items, int32 numItems, void *state)
+{
+	IndexDistinctScanState *scanState = (IndexDistinctScanState *) state;
+
+	CHECK_FOR_INTERRUPTS();
+
+	MemoryContextReset(scanState->keyContext);
+	MemoryContext oldContext = MemoryContextSwitchTo(scanState->keyContext);
+
+	bytea *serializedTerms[INDEX_MAX_KEYS] = { 0 };
+	InitializeSerializedCompositeIndexTerm(DatumGetByteaPP(key), serializedTerms);
+	if (IsSerializedIndexTermMetadata(serializedTerms[0]))
+	{
+		MemoryContextSwitchTo(oldContext);
+		return IndexEntryKeyVisit_NextKey;
+	}
+
+	BsonIndexTerm term;
+	InitializeBsonIndexTerm(serializedTerms[0], &term);
+	bool isGroup = scanState->groupSpec != NULL;
+	bool isNullGroup = IsIndexTermValueUndefined(&term) ||
+					   term.element.bsonValue.value_type == BSON_TYPE_NULL;
+
+	if (!isGroup && IsIndexTermValueUndefined(&term))
+	{
+		/* distinct doesn't return missing values */
+		MemoryContextSwitchTo(oldContext);
+		return IndexEntryKeyVisit_NextKey;
+	}
+
+	bool isCurrentValue = scanState->currentValueDocument != NULL &&
+						  !(isGroup && isNullGroup) &&
+						  BsonValueEquals(&scanState->currentValue,
+										  &term.element.bsonValue);
+	MemoryContextSwitchTo(oldContext);
+
+	if (!isGroup)
+	{
+		if (isCurrentValue)
+		{
+			/* Already emitted */
+			return IndexEntryKeyVisit_NextKey;
+		}
+
+		for (int32 i = 0; i < numItems; i++)
+		{
+			if (IsIndexDistinctItemVisible(scanState, &items[i]))
+			{
+				SetCurrentDistinctValue(scanState, &term.element.bsonValue);
+
+				Datum values[1] = { PointerGetDatum(scanState->currentValueDocument) };
+				bool nulls[1] = { false };
+				tuplestore_putvalues(scanState->tupleStore, scanState->tupleDescriptor,
+									 values, nulls);
+				return IndexEntryKeyVisit_NextKey;
+			}
+		}
+
+		return IndexEntryKeyVisit_NextChunk;
+	}
+
+	int64 numVisible = 0;
+	for (int32 i = 0; i < numItems; i++)
+	{
+		if (IsIndexDistinctItemVisible(scanState, &items[i]))
+		{
+			numVisible++;
+		}
+	}
+
+	if (numVisible == 0)
+	{
+		return IndexEntryKeyVisit_NextChunk;
+	}
+
+	if (isNullGroup)
+	{
+		/* null and missing are the same group, but may not be adjacent */
+		scanState->nullCount += numVisible;
+	}
+	else if (isCurrentValue)
+	{
+		scanState->currentCount += numVisible;
+	}
+	else
+	{
+		if (scanState->currentValueDocument != NULL)
+		{
+			WriteGroupCountRow(scanState, &scanState->currentValue,
+							   scanState->currentCount);
+		}
+
+		SetCurrentDistinctValue(scanState, &term.element.bsonValue);
+		scanState->currentCount = numVisible;
+	}
+
+	return IndexEntryKeyVisit_NextChunk;
+}
+
+
+/*
+ * Whether the heap tuple for the item is visible to the scan's snapshot.
+ * Like index only scans, we avoid the heap fetch for all-visible pages.
+ */
+static bool
+IsIndexDistinctItemVisible(IndexDistinctScanState *state, ItemPointer item)
+{
+	if (VM_ALL_VISIBLE(state->heapRelation, ItemPointerGetBlockNumber(item),
+					   &state->vmBuffer))
+	{
+		return true;
+	}
+
+	bool callAgain = false;
+	bool allDead = false;
+	bool found = table_index_fetch_tuple(state->fetchData, item, state->snapshot,
+										 state->slot, &callAgain, &allDead);
+	ExecClearTuple(state->slot);
+	return found;
+}
+
+
+/*
+ * Copies the value of the key being visited into the scan state (the key only
+ * lives as long as the visit).
+ */
+static void
+SetCurrentDistinctValue(IndexDistinctScanState *state, const bson_value_t *value)
+{
+	if (state->currentValueDocument != NULL)
+	{
+		pfree(state->currentValueDocument);
+	}
+
+	pgbsonelement element;
+	state->currentValueDocument = BsonValueToDocumentPgbson(value);
+	PgbsonToSinglePgbsonElement(state->currentValueDocument, &element);
+	state->currentValue = element.bsonValue;
+}
+
+
+/*
+ * Writes the $group output row for a value and its count.
+ */
+static void
+WriteGroupCountRow(IndexDistinctScanState *state, const bson_value_t *value, int64 count)
+{
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+	PgbsonWriterAppendValue(&writer, "_id", 3, value);
+
+	bson_iter_t groupSpecIter;
+	PgbsonInitIterator(state->groupSpec, &groupSpecIter);
+	while (bson_iter_next(&groupSpecIter))
+	{
+		StringView field = bson_iter_key_string_view(&groupSpecIter);
+
+		/* $sum: 1 stays an int32 until it overflows */
+		if (count <= PG_INT32_MAX)
+		{
+			PgbsonWriterAppendInt32(&writer, field.string, field.length, (int32) count);
+		}
+		else
+		{
+			PgbsonWriterAppendInt64(&writer, field.string, field.length, count);
+		}
+	}
+
+	Datum values[1] = { PointerGetDatum(PgbsonWriterGetPgbson(&writer)) };
+	bool nulls[1] = { false };
+	tuplestore_putvalues(state->tupleStore, state->tupleDescriptor, values, nulls);
+}
+
+
+/*
+ * Produces the rows of the scan by reading the documents of the collection the
+ * way the regular distinct and $group queries do: For distinct, this is
+ * bson_distinct_unwind of the path (duplicates are removed by the aggregate
+ * over the scan). For $group, the documents are counted per value of the path,
+ * with null and missing values in the same group.
+ */
+static void
+WriteDistinctRowsFromCollection(IndexDistinctScanState *state, Relation indexRelation)
+{
+	BsonGinCompositePathOptions *options =
+		(BsonGinCompositePathOptions *) indexRelation->rd_opcoptions[0];
+	if (options == NULL || options->base.type != IndexOptionsType_Composite)
+	{
+		ereport(ERROR, (errmsg("index %u is not a composite index",
+							   RelationGetRelid(indexRelation))));
+	}
+
+	const char *path = GetCompositeFirstIndexPath(options);
+	const char *tableName = quote_qualified_identifier(
+		get_namespace_name(RelationGetNamespace(state->heapRelation)),
+		RelationGetRelationName(state->heapRelation));
+
+	const char *query;
+	int nargs = 1;
+	Oid argTypes[1];
+	Datum argValues[1];
+	if (state->groupSpec == NULL)
+	{
+		query = FormatSqlQuery("SELECT %s.bson_distinct_unwind(document, $1) FROM %s",
+							   ApiCatalogSchemaName, tableName);
+		argTypes[0] = TEXTOID;
+		argValues[0] = CStringGetTextDatum(path);
+	}
+	else
+	{
+		query = FormatSqlQuery(
+			"SELECT %s.bson_expression_get(document, $1, true), COUNT(*) FROM %s"
+			" GROUP BY 1", ApiCatalogSchemaName, tableName);
+
+		pgbson_writer expressionWriter;
+		PgbsonWriterInit(&expressionWriter);
+		PgbsonWriterAppendUtf8(&expressionWriter, "", 0, psprintf("$%s", path));
+		argTypes[0] = BsonTypeId();
+		argValues[0] = PointerGetDatum(PgbsonWriterGetPgbson(&expressionWriter));
+	}
+
+	bool readOnly = true;
+	SPI_connect();
+
+	Portal portal = SPI_cursor_open_with_args("indexDistinctScanFallback", query, nargs,
+											  argTypes, argValues, NULL, readOnly, 0);
+	while (true)
+	{
+		/* Rows are fetched in batches so they don't all live in SPI memory */
+		SPI_cursor_fetch(portal, true, 1000);
+		if (SPI_processed == 0 || SPI_tuptable == NULL)
+		{
+			break;
+		}
+
+		for (uint64 i = 0; i < SPI_processed; i++)
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			bool isNull;
+			AttrNumber valueAttribute = 1;
+			Datum valueDatum = SPI_getbinval(SPI_tuptable->vals[i],
+											 SPI_tuptable->tupdesc, valueAttribute,
+											 &isNull);
+			if (isNull)
+			{
+				continue;
+			}
+
+			/* The tuplestore copies the rows written into its own context */
+			if (state->groupSpec == NULL)
+			{
+				bool nulls[1] = { false };
+				tuplestore_putvalues(state->tupleStore, state->tupleDescriptor,
+									 &valueDatum, nulls);
+				continue;
+			}
+
+			AttrNumber countAttribute = 2;
+			int64 count = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[i],
+													  SPI_tuptable->tupdesc,
+													  countAttribute, &isNull));
+
+			pgbsonelement element;
+			PgbsonToSinglePgbsonElement(DatumGetPgBson(valueDatum), &element);
+			WriteGroupCountRow(state, &element.bsonValue, count);
+		}
+
+		SPI_freetuptable(SPI_tuptable);
+	}
+
+	SPI_cursor_close(portal);
+	SPI_finish();
+}
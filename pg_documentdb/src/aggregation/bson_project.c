@@ -39,6 +39,9 @@
 #include "commands/commands_common.h"
 #include "collation/collation.h"
 
+/* Largest size a projection presizes its output writer to */
+#define MAX_PROJECTION_WRITER_SIZE_HINT (64 * 1024)
+
 
 /* --------------------------------------------------------- */
 /* Error-Messages */
@@ -51,6 +54,17 @@ const char COLLISION_ERR_MSG[75] =
 /* Data types */
 /* --------------------------------------------------------- */
 
+/*
+ * Size of the last document projected with a BsonProjectionQueryState, used
+ * to presize the writer of the next one.
+ */
+typedef struct ProjectionWriterSizeHint
+{
+	/* 0 until the first document is projected */
+	uint32_t lastDocumentSize;
+} ProjectionWriterSizeHint;
+
+
 /*
  * State for projection that is cached across
  * query calls.
@@ -79,6 +93,13 @@ typedef struct BsonProjectionQueryState
 
 	/* Optional: Bson Project Document stage function hooks */
 	BsonProjectDocumentFunctions projectDocumentFuncs;
+
+	/*
+	 * Optional: Hint to presize the writer of the next projected document.
+	 * The state is read only once built, the hint is updated on every
+	 * document and so is kept behind a pointer.
+	 */
+	ProjectionWriterSizeHint *writerSizeHint;
 } BsonProjectionQueryState;
 
 
@@ -1522,8 +1543,19 @@ pgbson *
 ProjectDocumentWithState(pgbson *sourceDocument,
 						 const BsonProjectionQueryState *state)
 {
+	/*
+	 * Projections mostly write documents of the same shape row after row. The
+	 * hint is capped so that a large document doesn't make every following
+	 * row allocate as much, larger documents grow their writer instead.
+	 */
+	uint32_t sizeHint = state->writerSizeHint != NULL &&
+						state->writerSizeHint->lastDocumentSize > 0 ?
+						state->writerSizeHint->lastDocumentSize :
+						PgbsonGetBsonSize(sourceDocument);
+	sizeHint = Min(sizeHint, MAX_PROJECTION_WRITER_SIZE_HINT);
+
 	pgbson_writer writer;
-	PgbsonWriterInit(&writer);
+	PgbsonWriterInitWithSizeHint(&writer, sizeHint);
 	bson_iter_t documentIterator;
 	PgbsonInitIterator(sourceDocument, &documentIterator);
 
@@ -1548,7 +1580,14 @@ ProjectDocumentWithState(pgbson *sourceDocument,
 	TraverseObjectAndAppendToWriter(&documentIterator, state->root, &writer,
 									state->projectNonMatchingFields,
 									&projectDocState, isInNestedArray);
-	return PgbsonWriterGetPgbson(&writer);
+
+	pgbson *result = PgbsonWriterGetPgbson(&writer);
+	if (state->writerSizeHint != NULL)
+	{
+		state->writerSizeHint->lastDocumentSize = PgbsonGetBsonSize(result);
+	}
+
+	return result;
 }
 
 
@@ -1782,6 +1821,7 @@ BuildBsonPathTreeForDollarProjectCore(BsonProjectionQueryState *state,
 	state->hasInclusion = pathTreeContext->hasInclusion;
 	state->hasExclusion = pathTreeContext->hasExclusion;
 	state->projectNonMatchingFields = pathTreeContext->hasExclusion;
+	state->writerSizeHint = palloc0(sizeof(ProjectionWriterSizeHint));
 
 	SetVariableSpec(&state->variableContext, projectionContext->variableSpec);
 }
@@ -1823,6 +1863,7 @@ BuildBsonPathTreeForDollarAddFields(BsonProjectionQueryState *state,
 	state->hasInclusion = context.hasInclusion;
 	state->hasExclusion = context.hasExclusion;
 	state->projectNonMatchingFields = true;
+	state->writerSizeHint = palloc0(sizeof(ProjectionWriterSizeHint));
 
 	SetVariableSpec(&state->variableContext, variableSpec);
 }
@@ -1886,6 +1927,7 @@ BuildBsonPathTreeForDollarUnset(BsonProjectionQueryState *state,
 	state->hasExclusion = hasExclusion;
 	state->projectNonMatchingFields = hasExclusion;
 	state->variableContext = NULL;
+	state->writerSizeHint = palloc0(sizeof(ProjectionWriterSizeHint));
 }
 
 
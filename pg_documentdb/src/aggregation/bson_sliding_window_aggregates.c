@@ -0,0 +1,1167 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/aggregation/bson_sliding_window_aggregates.c
+ *
+ * Moving-aggregate (MSFUNC/MINVFUNC/MFINALFUNC) support for the window
+ * accumulators that cannot be inverted arithmetically:
+ * $min, $max, $minN, $maxN, $top, $bottom, $topN, $bottomN and $addToSet.
+ *
+ * Postgres removes rows from a moving aggregate in the same order in which
+ * they were added, so the state keeps the rows of the current frame in a
+ * FIFO ring along with a structure that answers the accumulator without
+ * rescanning the frame:
+ *   - $min/$max/$top/$bottom keep a monotonic deque of candidates, the front
+ *     of which is always the answer for the frame.
+ *   - $minN/$maxN/$topN/$bottomN keep a red-black tree in sort order, the
+ *     answer is its first N entries.
+ *   - $addToSet keeps a multiset counting how many rows of the frame carry
+ *     each distinct value.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <postgres.h>
+#include <fmgr.h>
+#include <lib/rbtree.h>
+#include <utils/array.h>
+#include <utils/hsearch.h>
+
+#include "io/bson_core.h"
+#include "query/bson_compare.h"
+#include "query/bson_dollar_operators.h"
+#include "aggregation/bson_aggregate.h"
+#include "aggregation/bson_aggregation_pipeline.h"
+#include "aggregation/bson_sorted_accumulator.h"
+#include "operators/bson_expression_operators.h"
+#include "utils/documentdb_errors.h"
+#include "utils/hashset_utils.h"
+
+extern bool EnableWindowAggregateInverseTransition;
+
+/* --------------------------------------------------------- */
+/* Data-types */
+/* --------------------------------------------------------- */
+
+typedef enum SlidingWindowAggregateKind
+{
+	SlidingWindowAggregateKind_Min = 1,
+	SlidingWindowAggregateKind_Max,
+	SlidingWindowAggregateKind_MinN,
+	SlidingWindowAggregateKind_MaxN,
+	SlidingWindowAggregateKind_Top,
+	SlidingWindowAggregateKind_Bottom,
+	SlidingWindowAggregateKind_TopN,
+	SlidingWindowAggregateKind_BottomN,
+	SlidingWindowAggregateKind_AddToSet,
+} SlidingWindowAggregateKind;
+
+/*
+ * A distinct value tracked by $addToSet along with the rows of
+ * the frame that carry it.
+ */
+typedef struct SlidingWindowSetEntry
+{
+	/* key for hash entry; should be the first field */
+	bson_value_t bsonValue;
+
+	/* Collation string; should be the second field (always NULL) */
+	const char *collationString;
+
+	/* The { "": value } document that owns bsonValue */
+	pgbson *document;
+
+	/* Number of rows in the frame with this value */
+	int64 count;
+
+	/* Sequence of the oldest and newest row in the frame with this value */
+	int64 firstSequence;
+	int64 lastSequence;
+} SlidingWindowSetEntry;
+
+/*
+ * A row of the window frame that contributes to the accumulator.
+ */
+typedef struct SlidingWindowEntry
+{
+	/* Position of the row in the order rows were added to the aggregate */
+	int64 sequence;
+
+	/* $min/$max: the value. $minN/$maxN: the input document.
+	 * $top(N)/$bottom(N): the document (may be NULL). Unused for $addToSet. */
+	pgbson *document;
+
+	/* $minN/$maxN: the value being ranked, points into document */
+	bson_value_t value;
+
+	/* $top(N)/$bottom(N): the sort key values, 0 for a NULL document */
+	Datum *sortKeyValues;
+
+	/* $addToSet: the distinct value of this row and the sequence of the next
+	 * row in the frame with the same value (-1 if there is none) */
+	SlidingWindowSetEntry *setEntry;
+	int64 nextSameSequence;
+} SlidingWindowEntry;
+
+typedef struct SlidingWindowTreeNode
+{
+	/* Should be the first field */
+	RBTNode node;
+
+	SlidingWindowEntry *entry;
+} SlidingWindowTreeNode;
+
+typedef struct BsonSlidingWindowState
+{
+	SlidingWindowAggregateKind kind;
+
+	/* The per-aggregate window context that owns everything below */
+	MemoryContext context;
+
+	/* Number of rows added to and removed from the aggregate so far,
+	 * the frame is made of the rows with sequence [removedCount, addedCount) */
+	int64 addedCount;
+	int64 removedCount;
+
+	/* Ring of the rows in the frame indexed by sequence % rowsCapacity,
+	 * NULL for rows that don't contribute to the result */
+	SlidingWindowEntry **rows;
+	int64 rowsCapacity;
+
+	/* $min/$max/$top/$bottom: ring of candidates in sequence order where
+	 * each entry sorts before every entry that follows it */
+	SlidingWindowEntry **deque;
+	int64 dequeCapacity;
+	int64 dequeHead;
+	int64 dequeCount;
+
+	/* $minN/$maxN/$topN/$bottomN: the contributing rows in result order */
+	RBTree *tree;
+
+	/* The N for the N accumulators (0 until known), 1 otherwise */
+	int64 maxElements;
+
+	/* $top(N)/$bottom(N): sort specification and input expression */
+	int numSortKeys;
+	Datum *sortSpecs;
+	bool sortDirections[32];
+	pgbson *inputExpression;
+
+	/* $addToSet: the distinct values in the frame */
+	HTAB *set;
+	int64 currentSizeWritten;
+} BsonSlidingWindowState;
+
+#define SLIDING_WINDOW_INITIAL_CAPACITY 64
+
+/* --------------------------------------------------------- */
+/* Forward declaration */
+/* --------------------------------------------------------- */
+
+static Datum SlidingWindowTransitionCore(PG_FUNCTION_ARGS,
+										 SlidingWindowAggregateKind kind);
+static BsonSlidingWindowState * CreateSlidingWindowState(PG_FUNCTION_ARGS,
+														 SlidingWindowAggregateKind
+														 kind,
+														 MemoryContext
+														 aggregateContext);
+static SlidingWindowEntry * CreateMinMaxEntry(PG_FUNCTION_ARGS,
+											  BsonSlidingWindowState *state);
+static SlidingWindowEntry * CreateMaxMinNEntry(PG_FUNCTION_ARGS,
+											   BsonSlidingWindowState *state);
+static SlidingWindowEntry * CreateOrderedEntry(PG_FUNCTION_ARGS,
+											   BsonSlidingWindowState *state);
+static SlidingWindowEntry * CreateAddToSetEntry(PG_FUNCTION_ARGS,
+												BsonSlidingWindowState *state);
+static void AddSlidingWindowRow(BsonSlidingWindowState *state,
+								SlidingWindowEntry *entry);
+static void RemoveSlidingWindowRow(BsonSlidingWindowState *state,
+								   SlidingWindowEntry *entry);
+static int CompareSlidingWindowEntries(const BsonSlidingWindowState *state,
+									   const SlidingWindowEntry *left,
+									   const SlidingWindowEntry *right);
+static void DequePushBack(BsonSlidingWindowState *state, SlidingWindowEntry *entry);
+static void ExtractMaxMinNArguments(const pgbson *document, bson_value_t *input,
+									bson_value_t *elementsToFetch);
+static int SlidingWindowTreeComparator(const RBTNode *a, const RBTNode *b, void *arg);
+static void SlidingWindowTreeCombiner(RBTNode *existing, const RBTNode *newdata,
+									  void *arg);
+static RBTNode * SlidingWindowTreeAlloc(void *arg);
+static void SlidingWindowTreeFree(RBTNode *node, void *arg);
+static pgbson * GetEmptySlidingWindowResult(bool isSingle);
+
+/*
+ * The moving state is handed to Postgres as a varlena that holds a pointer to
+ * the in-memory state. The state is only ever passed back to the same window
+ * aggregate, and keeping the pointer indirection means it stays valid if
+ * Postgres copies the transition value into its aggregate context.
+ */
+static inline BsonSlidingWindowState *
+GetSlidingWindowState(bytea *bytes)
+{
+	return *((BsonSlidingWindowState **) GetMaxAlignedVarlena(bytes)->state);
+}
+
+
+static inline SlidingWindowEntry *
+DequeFront(BsonSlidingWindowState *state)
+{
+	return state->deque[state->dequeHead];
+}
+
+
+static inline SlidingWindowEntry *
+DequeBack(BsonSlidingWindowState *state)
+{
+	return state->deque[(state->dequeHead + state->dequeCount - 1) %
+						state->dequeCapacity];
+}
+
+
+static inline bool
+IsSlidingWindowNKind(SlidingWindowAggregateKind kind)
+{
+	return kind == SlidingWindowAggregateKind_MinN ||
+		   kind == SlidingWindowAggregateKind_MaxN ||
+		   kind == SlidingWindowAggregateKind_TopN ||
+		   kind == SlidingWindowAggregateKind_BottomN;
+}
+
+
+static inline bool
+IsSlidingWindowOrderedKind(SlidingWindowAggregateKind kind)
+{
+	return kind == SlidingWindowAggregateKind_Top ||
+		   kind == SlidingWindowAggregateKind_Bottom ||
+		   kind == SlidingWindowAggregateKind_TopN ||
+		   kind == SlidingWindowAggregateKind_BottomN;
+}
+
+
+/* --------------------------------------------------------- */
+/* Top level exports */
+/* --------------------------------------------------------- */
+
+PG_FUNCTION_INFO_V1(bson_min_moving_transition);
+PG_FUNCTION_INFO_V1(bson_max_moving_transition);
+PG_FUNCTION_INFO_V1(bson_minn_moving_transition);
+PG_FUNCTION_INFO_V1(bson_maxn_moving_transition);
+PG_FUNCTION_INFO_V1(bson_first_moving_transition);
+PG_FUNCTION_INFO_V1(bson_last_moving_transition);
+PG_FUNCTION_INFO_V1(bson_firstn_moving_transition);
+PG_FUNCTION_INFO_V1(bson_lastn_moving_transition);
+PG_FUNCTION_INFO_V1(bson_add_to_set_moving_transition);
+PG_FUNCTION_INFO_V1(bson_sliding_window_invtransition);
+PG_FUNCTION_INFO_V1(bson_sliding_window_value_final);
+PG_FUNCTION_INFO_V1(bson_sliding_window_array_final);
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $min.
+ */
+Datum
+bson_min_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_Min);
+}
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $max.
+ */
+Datum
+bson_max_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_Max);
+}
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $minN.
+ */
+Datum
+bson_minn_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_MinN);
+}
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $maxN.
+ */
+Datum
+bson_maxn_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_MaxN);
+}
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $top.
+ */
+Datum
+bson_first_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_Top);
+}
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $bottom.
+ */
+Datum
+bson_last_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_Bottom);
+}
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $topN.
+ */
+Datum
+bson_firstn_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_TopN);
+}
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $bottomN.
+ */
+Datum
+bson_lastn_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_BottomN);
+}
+
+
+/*
+ * Applies the moving "state transition" (MSFUNC) for $addToSet.
+ */
+Datum
+bson_add_to_set_moving_transition(PG_FUNCTION_ARGS)
+{
+	return SlidingWindowTransitionCore(fcinfo, SlidingWindowAggregateKind_AddToSet);
+}
+
+
+/*
+ * Applies the "inverse state transition" (MINVFUNC) for all the sliding
+ * window aggregates. Postgres calls this in the same order in which rows
+ * were added, so the row leaving the frame is always the oldest row in the
+ * state and the arguments beyond the state don't need to be inspected.
+ */
+Datum
+bson_sliding_window_invtransition(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggregateContext;
+	if (AggCheckCallContext(fcinfo, &aggregateContext) != AGG_CONTEXT_WINDOW)
+	{
+		ereport(ERROR, errmsg(
+					"window aggregate function called in non-window-aggregate context"));
+	}
+
+	if (PG_ARGISNULL(0) || !EnableWindowAggregateInverseTransition)
+	{
+		/* Returning NULL is an indication that inverse can't be applied and the aggregation needs to be redone */
+		PG_RETURN_NULL();
+	}
+
+	bytea *bytes = PG_GETARG_BYTEA_P(0);
+	BsonSlidingWindowState *state = GetSlidingWindowState(bytes);
+
+	if (state->removedCount >= state->addedCount)
+	{
+		PG_RETURN_NULL();
+	}
+
+	SlidingWindowEntry *entry = state->rows[state->removedCount % state->rowsCapacity];
+	state->rows[state->removedCount % state->rowsCapacity] = NULL;
+	state->removedCount++;
+
+	if (entry != NULL)
+	{
+		RemoveSlidingWindowRow(state, entry);
+	}
+
+	PG_RETURN_POINTER(bytes);
+}
+
+
+/*
+ * Applies the moving "final" (MFINALFUNC) for $min, $max, $top and $bottom.
+ * Returns { "": null } for empty frames.
+ */
+Datum
+bson_sliding_window_value_final(PG_FUNCTION_ARGS)
+{
+	BsonSlidingWindowState *state = PG_ARGISNULL(0) ? NULL :
+									GetSlidingWindowState(PG_GETARG_BYTEA_P(0));
+
+	if (state == NULL || state->dequeCount == 0)
+	{
+		PG_RETURN_POINTER(GetEmptySlidingWindowResult(true));
+	}
+
+	SlidingWindowEntry *front = DequeFront(state);
+	if (!IsSlidingWindowOrderedKind(state->kind))
+	{
+		PG_RETURN_POINTER(PgbsonCloneFromPgbson(front->document));
+	}
+
+	if (front->document == NULL)
+	{
+		PG_RETURN_POINTER(GetEmptySlidingWindowResult(true));
+	}
+
+	BsonOrderAggValue value = { 0 };
+	BsonOrderAggValue *currentResult[1] = { &value };
+	value.value = front->document;
+
+	BsonOrderAggState orderState = { 0 };
+	orderState.currentResult = currentResult;
+	orderState.numAggValues = 1;
+	orderState.currentCount = 1;
+	orderState.numSortKeys = state->numSortKeys;
+	orderState.inputExpression = state->inputExpression;
+
+	bool isSingle = true;
+	bool invert = false;
+	return BsonOrderFinalFromState(fcinfo, &orderState, isSingle, invert);
+}
+
+
+/*
+ * Applies the moving "final" (MFINALFUNC) for $minN, $maxN, $topN, $bottomN
+ * and $addToSet. Returns { "": [] } for empty frames.
+ */
+Datum
+bson_sliding_window_array_final(PG_FUNCTION_ARGS)
+{
+	BsonSlidingWindowState *state = PG_ARGISNULL(0) ? NULL :
+									GetSlidingWindowState(PG_GETARG_BYTEA_P(0));
+
+	if (state == NULL)
+	{
+		PG_RETURN_POINTER(GetEmptySlidingWindowResult(false));
+	}
+
+	if (state->kind == SlidingWindowAggregateKind_TopN ||
+		state->kind == SlidingWindowAggregateKind_BottomN)
+	{
+		BsonOrderAggState orderState = { 0 };
+		orderState.currentResult = palloc0(sizeof(BsonOrderAggValue *) *
+										   Min(state->maxElements,
+											   state->addedCount - state->removedCount + 1));
+		orderState.numSortKeys = state->numSortKeys;
+		orderState.inputExpression = state->inputExpression;
+
+		RBTreeIterator iterator;
+		SlidingWindowTreeNode *node;
+		rbt_begin_iterate(state->tree, LeftRightWalk, &iterator);
+		while (orderState.currentCount < state->maxElements &&
+			   (node = (SlidingWindowTreeNode *) rbt_iterate(&iterator)) != NULL)
+		{
+			BsonOrderAggValue *value = palloc0(sizeof(BsonOrderAggValue));
+			value->value = node->entry->document;
+			orderState.currentResult[orderState.currentCount++] = value;
+		}
+
+		orderState.numAggValues = orderState.currentCount;
+
+		bool isSingle = false;
+		bool invert = state->kind == SlidingWindowAggregateKind_BottomN;
+		return BsonOrderFinalFromState(fcinfo, &orderState, isSingle, invert);
+	}
+
+	pgbson_writer writer;
+	pgbson_array_writer arrayWriter;
+	PgbsonWriterInit(&writer);
+	PgbsonWriterStartArray(&writer, "", 0, &arrayWriter);
+
+	if (state->kind == SlidingWindowAggregateKind_AddToSet)
+	{
+		/* Emit each distinct value at the position of its oldest row in the frame
+		 * which matches the order of a fresh aggregation over the frame */
+		for (int64 sequence = state->removedCount; sequence < state->addedCount;
+			 sequence++)
+		{
+			SlidingWindowEntry *entry = state->rows[sequence % state->rowsCapacity];
+			if (entry != NULL && entry->setEntry->firstSequence == sequence)
+			{
+				PgbsonArrayWriterWriteValue(&arrayWriter, &entry->setEntry->bsonValue);
+			}
+		}
+	}
+	else
+	{
+		int64 numWritten = 0;
+		RBTreeIterator iterator;
+		SlidingWindowTreeNode *node;
+		rbt_begin_iterate(state->tree, LeftRightWalk, &iterator);
+		while (numWritten < state->maxElements &&
+			   (node = (SlidingWindowTreeNode *) rbt_iterate(&iterator)) != NULL)
+		{
+			PgbsonArrayWriterWriteValue(&arrayWriter, &node->entry->value);
+			numWritten++;
+		}
+	}
+
+	PgbsonWriterEndArray(&writer, &arrayWriter);
+	PG_RETURN_POINTER(PgbsonWriterGetPgbson(&writer));
+}
+
+
+/* --------------------------------------------------------- */
+/* Private helper methods */
+/* --------------------------------------------------------- */
+
+/*
+ * Common moving transition: builds the entry for the incoming row in the
+ * aggregate context, records it in the frame and in the accumulator's
+ * structure.
+ */
+static Datum
+SlidingWindowTransitionCore(PG_FUNCTION_ARGS, SlidingWindowAggregateKind kind)
+{
+	MemoryContext aggregateContext;
+	if (AggCheckCallContext(fcinfo, &aggregateContext) != AGG_CONTEXT_WINDOW)
+	{
+		ereport(ERROR, errmsg(
+					"window aggregate function called in non-window-aggregate context"));
+	}
+
+	bytea *bytes;
+	BsonSlidingWindowState *state;
+	if (PG_ARGISNULL(0))
+	{
+		MemoryContext oldContext = MemoryContextSwitchTo(aggregateContext);
+		MaxAlignedVarlena *stateBytes = AllocateMaxAlignedVarlena(
+			sizeof(BsonSlidingWindowState *));
+		state = CreateSlidingWindowState(fcinfo, kind, aggregateContext);
+		*((BsonSlidingWindowState **) stateBytes->state) = state;
+		bytes = (bytea *) stateBytes;
+		MemoryContextSwitchTo(oldContext);
+	}
+	else
+	{
+		bytes = PG_GETARG_BYTEA_P(0);
+		state = GetSlidingWindowState(bytes);
+		if (state->kind != kind)
+		{
+			ereport(ERROR, errmsg(
+						"window aggregate function received an invalid sliding window state"));
+		}
+	}
+
+	SlidingWindowEntry *entry = NULL;
+	switch (kind)
+	{
+		case SlidingWindowAggregateKind_Min:
+		case SlidingWindowAggregateKind_Max:
+		{
+			entry = CreateMinMaxEntry(fcinfo, state);
+			break;
+		}
+
+		case SlidingWindowAggregateKind_MinN:
+		case SlidingWindowAggregateKind_MaxN:
+		{
+			entry = CreateMaxMinNEntry(fcinfo, state);
+			break;
+		}
+
+		case SlidingWindowAggregateKind_Top:
+		case SlidingWindowAggregateKind_Bottom:
+		case SlidingWindowAggregateKind_TopN:
+		case SlidingWindowAggregateKind_BottomN:
+		{
+			entry = CreateOrderedEntry(fcinfo, state);
+			break;
+		}
+
+		case SlidingWindowAggregateKind_AddToSet:
+		{
+			entry = CreateAddToSetEntry(fcinfo, state);
+			break;
+		}
+
+		default:
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+							errmsg("Unknown sliding window aggregate kind %d", kind)));
+		}
+	}
+
+	AddSlidingWindowRow(state, entry);
+	PG_RETURN_POINTER(bytes);
+}
+
+
+/*
+ * Allocates the state for a sliding window aggregate in the aggregate context
+ * (which must be the CurrentMemoryContext). The sort specification and input
+ * expression of $top(N)/$bottom(N) are constant across rows so they are
+ * captured once from the first row.
+ */
+static BsonSlidingWindowState *
+CreateSlidingWindowState(PG_FUNCTION_ARGS, SlidingWindowAggregateKind kind,
+						 MemoryContext aggregateContext)
+{
+	BsonSlidingWindowState *state = palloc0(sizeof(BsonSlidingWindowState));
+	state->kind = kind;
+	state->context = aggregateContext;
+	state->maxElements = IsSlidingWindowNKind(kind) ? 0 : 1;
+	state->rowsCapacity = SLIDING_WINDOW_INITIAL_CAPACITY;
+	state->rows = palloc0(sizeof(SlidingWindowEntry *) * state->rowsCapacity);
+
+	if (IsSlidingWindowNKind(kind))
+	{
+		state->tree = rbt_create(sizeof(SlidingWindowTreeNode),
+								 SlidingWindowTreeComparator,
+								 SlidingWindowTreeCombiner,
+								 SlidingWindowTreeAlloc,
+								 SlidingWindowTreeFree,
+								 state);
+	}
+	else if (kind == SlidingWindowAggregateKind_AddToSet)
+	{
+		state->set = CreateBsonValueWithCollationHashSet(
+			sizeof(SlidingWindowSetEntry) - sizeof(BsonValueHashEntry));
+	}
+	else
+	{
+		state->dequeCapacity = SLIDING_WINDOW_INITIAL_CAPACITY;
+		state->deque = palloc(sizeof(SlidingWindowEntry *) * state->dequeCapacity);
+	}
+
+	if (IsSlidingWindowOrderedKind(kind))
+	{
+		bool isSingle = kind == SlidingWindowAggregateKind_Top ||
+						kind == SlidingWindowAggregateKind_Bottom;
+		int sortSpecArg = isSingle ? 2 : 3;
+
+		if (!isSingle)
+		{
+			state->maxElements = PG_GETARG_INT64(2);
+			Assert(state->maxElements > 0);
+		}
+
+		ArrayType *sortSpecArray = PG_GETARG_ARRAYTYPE_P(sortSpecArg);
+		bool *nulls;
+		deconstruct_array(sortSpecArray,
+						  ARR_ELEMTYPE(sortSpecArray), -1, false, TYPALIGN_INT,
+						  &state->sortSpecs, &nulls, &state->numSortKeys);
+
+		Assert(state->numSortKeys != 0);
+		if (state->numSortKeys > 32)
+		{
+			ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR), errmsg(
+								"Too many compound keys. A maximum of 32 keys is allowed.")));
+		}
+
+		for (int i = 0; i < state->numSortKeys; i++)
+		{
+			state->sortSpecs[i] = PointerGetDatum(PgbsonCloneFromPgbson(
+													  DatumGetPgBson(
+														  state->sortSpecs[i])));
+
+			pgbsonelement sortKeyElement;
+			PgbsonToSinglePgbsonElement(DatumGetPgBson(state->sortSpecs[i]),
+										&sortKeyElement);
+			state->sortDirections[i] =
+				BsonValueAsInt32(&sortKeyElement.bsonValue) == 1;
+		}
+
+		pgbson *inputExpression = PG_GETARG_MAYBE_NULL_PGBSON(sortSpecArg + 1);
+		state->inputExpression = inputExpression == NULL ? NULL :
+								 PgbsonCloneFromPgbson(inputExpression);
+	}
+
+	return state;
+}
+
+
+/*
+ * $min/$max: every non-NULL input contributes its { "": value } document.
+ */
+static SlidingWindowEntry *
+CreateMinMaxEntry(PG_FUNCTION_ARGS, BsonSlidingWindowState *state)
+{
+	pgbson *currentValue = PG_GETARG_MAYBE_NULL_PGBSON(1);
+	if (currentValue == NULL)
+	{
+		return NULL;
+	}
+
+	SlidingWindowEntry *entry = MemoryContextAllocZero(state->context,
+													   sizeof(SlidingWindowEntry));
+	entry->document = CopyPgbsonIntoMemoryContext(currentValue, state->context);
+	return entry;
+}
+
+
+/*
+ * $minN/$maxN: the input is { "": { input: <value>, n: <N> } }. Null and
+ * undefined values are ignored, as in bson_maxminn_transition.
+ */
+static SlidingWindowEntry *
+CreateMaxMinNEntry(PG_FUNCTION_ARGS, BsonSlidingWindowState *state)
+{
+	pgbson *currentValue = PG_GETARG_MAYBE_NULL_PGBSON(1);
+	if (currentValue == NULL)
+	{
+		return NULL;
+	}
+
+	bool isMaxN = state->kind == SlidingWindowAggregateKind_MaxN;
+	bson_value_t inputBsonValue = { 0 };
+	bson_value_t elementBsonValue = { 0 };
+	ExtractMaxMinNArguments(currentValue, &inputBsonValue, &elementBsonValue);
+
+	/* Ensure that N is a valid integer value. */
+	ValidateElementForNGroupAccumulators(&elementBsonValue, isMaxN ? "maxN" : "minN");
+	if (state->maxElements == 0)
+	{
+		bool throwIfFailed = true;
+		state->maxElements = BsonValueAsInt64WithRoundingMode(&elementBsonValue,
+															  ConversionRoundingMode_Floor,
+															  throwIfFailed);
+	}
+
+	/*if the input is null or an undefined path, ignore it */
+	if (IsExpressionResultNullOrUndefined(&inputBsonValue))
+	{
+		return NULL;
+	}
+
+	SlidingWindowEntry *entry = MemoryContextAllocZero(state->context,
+													   sizeof(SlidingWindowEntry));
+	entry->document = CopyPgbsonIntoMemoryContext(currentValue, state->context);
+	ExtractMaxMinNArguments(entry->document, &entry->value, &elementBsonValue);
+	return entry;
+}
+
+
+/*
+ * $top(N)/$bottom(N): every row contributes, including NULL documents which
+ * sort with all keys missing as in BsonOrderTransition.
+ */
+static SlidingWindowEntry *
+CreateOrderedEntry(PG_FUNCTION_ARGS, BsonSlidingWindowState *state)
+{
+	pgbson *inputDocument = PG_GETARG_MAYBE_NULL_PGBSON(1);
+
+	SlidingWindowEntry *entry = MemoryContextAllocZero(state->context,
+													   sizeof(SlidingWindowEntry));
+	entry->sortKeyValues = MemoryContextAllocZero(state->context,
+												  sizeof(Datum) * state->numSortKeys);
+	if (inputDocument == NULL)
+	{
+		return entry;
+	}
+
+	/* TODO: support collation with sorted accumulators*/
+	char *collationString = NULL;
+	bool validateSort = false;
+
+	entry->document = CopyPgbsonIntoMemoryContext(inputDocument, state->context);
+	for (int i = 0; i < state->numSortKeys; i++)
+	{
+		Datum sortKey = BsonOrderby(inputDocument,
+									DatumGetPgBson(state->sortSpecs[i]),
+									validateSort, collationString);
+		entry->sortKeyValues[i] = PointerGetDatum(
+			CopyPgbsonIntoMemoryContext(DatumGetPgBson(sortKey), state->context));
+	}
+
+	return entry;
+}
+
+
+/*
+ * $addToSet: rows with the same value share a set entry that counts them.
+ * NULL inputs and empty documents are ignored, as in bson_add_to_set_transition.
+ */
+static SlidingWindowEntry *
+CreateAddToSetEntry(PG_FUNCTION_ARGS, BsonSlidingWindowState *state)
+{
+	pgbson *currentValue = PG_GETARG_MAYBE_NULL_PGBSON(1);
+	if (currentValue == NULL || IsPgbsonEmptyDocument(currentValue))
+	{
+		return NULL;
+	}
+
+	pgbsonelement singleBsonElement;
+	if (!TryGetSinglePgbsonElementFromPgbson(currentValue, &singleBsonElement) ||
+		singleBsonElement.pathLength != 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Bad input format for addToSet transition.")));
+	}
+
+	int64 sequence = state->addedCount;
+	SlidingWindowSetEntry searchEntry = { 0 };
+	searchEntry.bsonValue = singleBsonElement.bsonValue;
+
+	bool found = false;
+	SlidingWindowSetEntry *setEntry = hash_search(state->set, &searchEntry,
+												  HASH_ENTER, &found);
+	if (!found)
+	{
+		uint32 currentValueSize = PgbsonGetBsonSize(currentValue);
+		CheckAggregateIntermediateResultSize(state->currentSizeWritten +
+											 currentValueSize);
+
+		/* Point the key at a copy owned by the set entry */
+		setEntry->document = CopyPgbsonIntoMemoryContext(currentValue, state->context);
+		PgbsonToSinglePgbsonElement(setEntry->document, &singleBsonElement);
+		setEntry->bsonValue = singleBsonElement.bsonValue;
+		setEntry->collationString = NULL;
+		setEntry->count = 0;
+		setEntry->firstSequence = sequence;
+		state->currentSizeWritten += currentValueSize;
+	}
+	else
+	{
+		SlidingWindowEntry *previous =
+			state->rows[setEntry->lastSequence % state->rowsCapacity];
+		previous->nextSameSequence = sequence;
+	}
+
+	setEntry->count++;
+	setEntry->lastSequence = sequence;
+
+	SlidingWindowEntry *entry = MemoryContextAllocZero(state->context,
+													   sizeof(SlidingWindowEntry));
+	entry->setEntry = setEntry;
+	entry->nextSameSequence = -1;
+	return entry;
+}
+
+
+/*
+ * Appends the incoming row (entry may be NULL for rows that don't contribute)
+ * to the frame and to the accumulator's structure.
+ */
+static void
+AddSlidingWindowRow(BsonSlidingWindowState *state, SlidingWindowEntry *entry)
+{
+	int64 sequence = state->addedCount;
+
+	if (sequence - state->removedCount == state->rowsCapacity)
+	{
+		int64 newCapacity = state->rowsCapacity * 2;
+		SlidingWindowEntry **newRows = MemoryContextAllocHuge(state->context,
+															  sizeof(SlidingWindowEntry
+																	 *) *
+															  newCapacity);
+		for (int64 i = state->removedCount; i < sequence; i++)
+		{
+			newRows[i % newCapacity] = state->rows[i % state->rowsCapacity];
+		}
+
+		pfree(state->rows);
+		state->rows = newRows;
+		state->rowsCapacity = newCapacity;
+	}
+
+	state->rows[sequence % state->rowsCapacity] = entry;
+	state->addedCount++;
+
+	if (entry == NULL)
+	{
+		return;
+	}
+
+	entry->sequence = sequence;
+	if (state->tree != NULL)
+	{
+		bool isNew;
+		SlidingWindowTreeNode node = { 0 };
+		node.entry = entry;
+		rbt_insert(state->tree, &node.node, &isNew);
+	}
+	else if (state->deque != NULL)
+	{
+		/*
+		 * Drop the candidates that can never be the answer again: they sort
+		 * after the new row and leave the frame before it does. $min/$max
+		 * return the most recent of equal values (see bson_min_transition)
+		 * while $top/$bottom keep the earliest one.
+		 */
+		bool preferNewerOnTie = !IsSlidingWindowOrderedKind(state->kind);
+		while (state->dequeCount > 0)
+		{
+			int comparison = CompareSlidingWindowEntries(state, DequeBack(state),
+														 entry);
+			if (comparison > 0 || (comparison == 0 && preferNewerOnTie))
+			{
+				state->dequeCount--;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		DequePushBack(state, entry);
+	}
+}
+
+
+/*
+ * Removes the oldest row of the frame from the accumulator's structure
+ * and releases its memory.
+ */
+static void
+RemoveSlidingWindowRow(BsonSlidingWindowState *state, SlidingWindowEntry *entry)
+{
+	if (state->tree != NULL)
+	{
+		SlidingWindowTreeNode node = { 0 };
+		node.entry = entry;
+		RBTNode *existing = rbt_find(state->tree, &node.node);
+		Assert(existing != NULL);
+		if (existing != NULL)
+		{
+			rbt_delete(state->tree, existing);
+		}
+	}
+	else if (state->deque != NULL)
+	{
+		/* The deque is in sequence order, so the oldest row can only be at the front */
+		if (state->dequeCount > 0 && DequeFront(state) == entry)
+		{
+			state->dequeHead = (state->dequeHead + 1) % state->dequeCapacity;
+			state->dequeCount--;
+		}
+	}
+	else
+	{
+		SlidingWindowSetEntry *setEntry = entry->setEntry;
+		setEntry->count--;
+		if (setEntry->count == 0)
+		{
+			SlidingWindowSetEntry searchEntry = *setEntry;
+			state->currentSizeWritten -= PgbsonGetBsonSize(searchEntry.document);
+			hash_search(state->set, &searchEntry, HASH_REMOVE, NULL);
+			pfree(searchEntry.document);
+		}
+		else
+		{
+			setEntry->firstSequence = entry->nextSameSequence;
+		}
+	}
+
+	if (entry->sortKeyValues != NULL)
+	{
+		for (int i = 0; i < state->numSortKeys; i++)
+		{
+			if (entry->sortKeyValues[i] != 0)
+			{
+				pfree(DatumGetPointer(entry->sortKeyValues[i]));
+			}
+		}
+
+		pfree(entry->sortKeyValues);
+	}
+
+	if (entry->document != NULL)
+	{
+		pfree(entry->document);
+	}
+
+	pfree(entry);
+}
+
+
+/*
+ * Orders two entries the way the accumulator ranks them: a negative value
+ * means left belongs before right in the result.
+ */
+static int
+CompareSlidingWindowEntries(const BsonSlidingWindowState *state,
+							const SlidingWindowEntry *left,
+							const SlidingWindowEntry *right)
+{
+	bool isComparisonValidIgnore;
+	switch (state->kind)
+	{
+		case SlidingWindowAggregateKind_Min:
+		{
+			return ComparePgbson(left->document, right->document);
+		}
+
+		case SlidingWindowAggregateKind_Max:
+		{
+			return ComparePgbson(right->document, left->document);
+		}
+
+		case SlidingWindowAggregateKind_MinN:
+		{
+			return CompareBsonValueAndType(&left->value, &right->value,
+										   &isComparisonValidIgnore);
+		}
+
+		case SlidingWindowAggregateKind_MaxN:
+		{
+			return CompareBsonValueAndType(&right->value, &left->value,
+										   &isComparisonValidIgnore);
+		}
+
+		default:
+		{
+			/* $bottom(N) ranks by the inverted sort, see BsonOrderTransition */
+			bool invertSort = state->kind == SlidingWindowAggregateKind_Bottom ||
+							  state->kind == SlidingWindowAggregateKind_BottomN;
+			for (int i = 0; i < state->numSortKeys; i++)
+			{
+				pgbson *leftKey = left->sortKeyValues[i] == 0 ? NULL :
+								  DatumGetPgBson(left->sortKeyValues[i]);
+				pgbson *rightKey = right->sortKeyValues[i] == 0 ? NULL :
+								   DatumGetPgBson(right->sortKeyValues[i]);
+
+				int comparisonResult = CompareNullablePgbson(leftKey, rightKey);
+				if (!state->sortDirections[i])
+				{
+					comparisonResult = -comparisonResult;
+				}
+
+				if (invertSort)
+				{
+					comparisonResult = -comparisonResult;
+				}
+
+				if (comparisonResult != 0)
+				{
+					return comparisonResult;
+				}
+			}
+
+			return 0;
+		}
+	}
+}
+
+
+static void
+DequePushBack(BsonSlidingWindowState *state, SlidingWindowEntry *entry)
+{
+	if (state->dequeCount == state->dequeCapacity)
+	{
+		int64 newCapacity = state->dequeCapacity * 2;
+		SlidingWindowEntry **newDeque = MemoryContextAllocHuge(state->context,
+															   sizeof(
+																   SlidingWindowEntry
+																   *) *
+															   newCapacity);
+		for (int64 i = 0; i < state->dequeCount; i++)
+		{
+			newDeque[i] = state->deque[(state->dequeHead + i) % state->dequeCapacity];
+		}
+
+		pfree(state->deque);
+		state->deque = newDeque;
+		state->dequeCapacity = newCapacity;
+		state->dequeHead = 0;
+	}
+
+	state->deque[(state->dequeHead + state->dequeCount) % state->dequeCapacity] = entry;
+	state->dequeCount++;
+}
+
+
+/*
+ * Reads input and n from the { "": { input: <value>, n: <N> } } argument of $maxN/$minN.
+ */
+static void
+ExtractMaxMinNArguments(const pgbson *document, bson_value_t *input,
+						bson_value_t *elementsToFetch)
+{
+	pgbsonelement currentValueElement;
+	PgbsonToSinglePgbsonElement(document, &currentValueElement);
+
+	bson_iter_t docIter;
+	BsonValueInitIterator(&currentValueElement.bsonValue, &docIter);
+	while (bson_iter_next(&docIter))
+	{
+		const char *key = bson_iter_key(&docIter);
+		if (strcmp(key, "input") == 0)
+		{
+			*input = *bson_iter_value(&docIter);
+		}
+		else if (strcmp(key, "n") == 0)
+		{
+			*elementsToFetch = *bson_iter_value(&docIter);
+		}
+	}
+}
+
+
+/*
+ * Tree nodes are ordered by the accumulator's ranking and then by the row
+ * sequence, so every row has a unique position and ties keep arrival order.
+ */
+static int
+SlidingWindowTreeComparator(const RBTNode *a, const RBTNode *b, void *arg)
+{
+	const SlidingWindowEntry *left = ((const SlidingWindowTreeNode *) a)->entry;
+	const SlidingWindowEntry *right = ((const SlidingWindowTreeNode *) b)->entry;
+
+	int comparison = CompareSlidingWindowEntries((BsonSlidingWindowState *) arg,
+												 left, right);
+	if (comparison != 0)
+	{
+		return comparison;
+	}
+
+	return left->sequence < right->sequence ? -1 :
+		   left->sequence > right->sequence ? 1 : 0;
+}
+
+
+static void
+SlidingWindowTreeCombiner(RBTNode *existing, const RBTNode *newdata, void *arg)
+{
+	/* Sequences are unique so a row can never be inserted twice */
+	ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+					errmsg("Sliding window row was added more than once")));
+}
+
+
+static RBTNode *
+SlidingWindowTreeAlloc(void *arg)
+{
+	BsonSlidingWindowState *state = (BsonSlidingWindowState *) arg;
+	return (RBTNode *) MemoryContextAlloc(state->context,
+										  sizeof(SlidingWindowTreeNode));
+}
+
+
+static void
+SlidingWindowTreeFree(RBTNode *node, void *arg)
+{
+	pfree(node);
+}
+
+
+static pgbson *
+GetEmptySlidingWindowResult(bool isSingle)
+{
+	if (isSingle)
+	{
+		/* Mongo returns $null for empty sets */
+		pgbsonelement finalValue;
+		finalValue.path = "";
+		finalValue.pathLength = 0;
+		finalValue.bsonValue.value_type = BSON_TYPE_NULL;
+		return PgbsonElementToPgbson(&finalValue);
+	}
+
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+	PgbsonWriterAppendEmptyArray(&writer, "", 0);
+	return PgbsonWriterGetPgbson(&writer);
+}
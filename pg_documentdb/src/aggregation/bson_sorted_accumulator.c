@@ -958,6 +958,29 @@ BsonOrderCombine(PG_FUNCTION_ARGS, bool invertSort)
  */
 Datum
 BsonOrderFinal(PG_FUNCTION_ARGS, bool isSingle, bool invert)
+{
+	BsonOrderAggState state = { 0 };
+	BsonOrderAggState *statePointer = NULL;
+
+	if (!PG_ARGISNULL(0))
+	{
+		DeserializeOrderState(PG_GETARG_BYTEA_P(0), &state);
+		statePointer = &state;
+	}
+
+	return BsonOrderFinalFromState(fcinfo, statePointer, isSingle, invert);
+}
+
+
+/*
+ * Produces the final result of the accumulator from an already materialized
+ * state. A NULL state is treated as an empty set. This is shared by the
+ * serialized aggregates and the sliding window aggregates, which keep their
+ * state in memory across rows of the window frame.
+ */
+Datum
+BsonOrderFinalFromState(PG_FUNCTION_ARGS, BsonOrderAggState *state, bool isSingle,
+						bool invert)
 {
 	MemoryContext aggregateContext;
 	int aggContext = AggCheckCallContext(fcinfo, &aggregateContext);
@@ -967,24 +990,19 @@ BsonOrderFinal(PG_FUNCTION_ARGS, bool isSingle, bool invert)
 							"Aggregate function invoked in non-aggregate context")));
 	}
 	bool returnNull = false;
-	BsonOrderAggState state = { 0 };
 
-	if (PG_ARGISNULL(0))
+	if (state == NULL)
 	{
 		returnNull = true;
 	}
-	else
+	else if (isSingle)
 	{
-		DeserializeOrderState(PG_GETARG_BYTEA_P(0), &state);
-		if (isSingle)
+		/* Validate there is a value to return. */
+		bson_iter_t pathSpecIter;
+		PgbsonInitIterator(state->currentResult[0]->value, &pathSpecIter);
+		if (!bson_iter_next(&pathSpecIter))
 		{
-			/* Validate there is a value to return. */
-			bson_iter_t pathSpecIter;
-			PgbsonInitIterator(state.currentResult[0]->value, &pathSpecIter);
-			if (!bson_iter_next(&pathSpecIter))
-			{
-				returnNull = true;
-			}
+			returnNull = true;
 		}
 	}
 
@@ -1023,10 +1041,10 @@ BsonOrderFinal(PG_FUNCTION_ARGS, bool isSingle, bool invert)
 	 */
 	if (aggContext == AGG_CONTEXT_WINDOW)
 	{
-		if (state.inputExpression != NULL)
+		if (state->inputExpression != NULL)
 		{
 			pgbsonelement element;
-			PgbsonToSinglePgbsonElement(state.inputExpression, &element);
+			PgbsonToSinglePgbsonElement(state->inputExpression, &element);
 
 			path = (StringView) {
 				.length = element.pathLength,
@@ -1065,17 +1083,17 @@ BsonOrderFinal(PG_FUNCTION_ARGS, bool isSingle, bool invert)
 	pgbson *result = NULL;
 	if (isSingle)
 	{
-		result = state.currentResult[0]->value;
+		result = state->currentResult[0]->value;
 		if (aggContext == AGG_CONTEXT_WINDOW)
 		{
-			if (state.inputExpression != NULL)
+			if (state->inputExpression != NULL)
 			{
 				/* Apply the inputExpression to the result documents to calculate result for $top/$bottom */
 				bool isNullOnEmpty = true;
 				pgbson_writer writer;
 				PgbsonWriterInit(&writer);
 				EvaluateAggregationExpressionDataToWriter(aggregationExpressionState,
-														  state.currentResult[0]->value,
+														  state->currentResult[0]->value,
 														  path,
 														  &writer,
 														  variableContext, isNullOnEmpty);
@@ -1092,24 +1110,24 @@ BsonOrderFinal(PG_FUNCTION_ARGS, bool isSingle, bool invert)
 		PgbsonWriterInit(&writer);
 		PgbsonWriterStartArray(&writer, "", 0, &arrayWriter);
 
-		int currentPoint = invert ? state.currentCount - 1 : 0;
-		int toPoint = invert ? -1 : state.currentCount;
+		int currentPoint = invert ? state->currentCount - 1 : 0;
+		int toPoint = invert ? -1 : state->currentCount;
 		int direction = invert ? -1 : 1;
 
 		for (int i = currentPoint; i != toPoint; i += direction)
 		{
-			if (state.currentResult[i] == NULL)
+			if (state->currentResult[i] == NULL)
 			{
 				/* No additional results found*/
 				break;
 			}
 
 			/* Check for Null value*/
-			if (state.currentResult[i]->value != NULL)
+			if (state->currentResult[i]->value != NULL)
 			{
 				if (aggContext == AGG_CONTEXT_WINDOW)
 				{
-					if (state.inputExpression != NULL)
+					if (state->inputExpression != NULL)
 					{
 						/* Apply the inputExpression to the result documents to calculate result for $topN/$bottomN */
 						bool isNullOnEmpty = true;
@@ -1117,7 +1135,7 @@ BsonOrderFinal(PG_FUNCTION_ARGS, bool isSingle, bool invert)
 						PgbsonWriterInit(&innerWriter);
 						EvaluateAggregationExpressionDataToWriter(
 							aggregationExpressionState,
-							state.currentResult[i]->value,
+							state->currentResult[i]->value,
 							path,
 							&innerWriter,
 							variableContext,
@@ -1131,7 +1149,7 @@ BsonOrderFinal(PG_FUNCTION_ARGS, bool isSingle, bool invert)
 				else
 				{
 					PgbsonArrayWriterWriteDocument(&arrayWriter,
-												   state.currentResult[i]->value);
+												   state->currentResult[i]->value);
 				}
 			}
 			else
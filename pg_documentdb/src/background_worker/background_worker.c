@@ -28,7 +28,13 @@
 #include <utils/builtins.h>
 #include <access/xact.h>
 #include <utils/snapmgr.h>
+#include <utils/array.h>
+#include <utils/tuplestore.h>
 #include <catalog/pg_proc_d.h>
+#include <catalog/pg_type_d.h>
+#include <executor/spi.h>
+#include <funcapi.h>
+#include <storage/spin.h>
 #include "utils/query_utils.h"
 #include "utils/documentdb_errors.h"
 #include "utils/syscache.h"
@@ -48,17 +54,91 @@
 
 #define ONE_SEC_IN_MS 1000L
 
+/*
+ * Maximum number of background worker jobs that can be registered. This only
+ * sizes the registry and the shared memory statistics, leave room for new jobs.
+ */
+#define MAX_BACKGROUND_WORKER_JOBS 16
+
+/*
+ * Job durations are tracked in a histogram with exponentially growing buckets.
+ * The upper bound of the first bucket is 1 second and each following bucket
+ * doubles it, the last bucket counts every run longer than ~17 minutes.
+ */
+#define BACKGROUND_WORKER_JOB_LATENCY_BUCKETS 12
+#define BACKGROUND_WORKER_JOB_LATENCY_FIRST_BUCKET_MS 1000
+
+#define BACKGROUND_WORKER_JOB_STATS_COLUMNS 10
+
+/*
+ * Scheduling statistics kept for a single background worker job.
+ * These are only updated by the background worker leader.
+ */
+typedef struct BackgroundWorkerJobStats
+{
+	int jobId;
+
+	char jobName[NAMEDATALEN];
+
+	BackgroundWorkerJobPriority priority;
+
+	/* Number of times the job was started. */
+	uint64 runs;
+
+	/* Number of runs that completed with an error. */
+	uint64 failures;
+
+	/* Number of runs that were canceled because of the job timeout. */
+	uint64 timeouts;
+
+	/* Number of scheduling cycles the job was postponed due to foreground load. */
+	uint64 deferredForLoad;
+
+	/* Number of scheduling cycles the job was postponed due to lack of free slots. */
+	uint64 deferredForSlots;
+
+	/* Accumulated run time of the completed runs. */
+	uint64 totalRunTimeMs;
+
+	/* Run time histogram of the completed runs. */
+	uint64 latencyHistogram[BACKGROUND_WORKER_JOB_LATENCY_BUCKETS];
+} BackgroundWorkerJobStats;
+
 /*
  * The main background worker shmem struct.  On shared memory we store this main
  * struct. This struct keeps:
  *
  * latch Sharable latch
+ * mutex Protects the job statistics below
+ * jobStats Scheduling statistics of the registered jobs
  */
 typedef struct BackgroundWorkerShmemStruct
 {
 	Latch latch;
+
+	slock_t mutex;
+
+	int numJobStats;
+
+	BackgroundWorkerJobStats jobStats[MAX_BACKGROUND_WORKER_JOBS];
 } BackgroundWorkerShmemStruct;
 
+/*
+ * Snapshot of the foreground activity of the server, used to decide whether
+ * background jobs should be postponed.
+ */
+typedef struct ForegroundLoadSample
+{
+	/* Client backends currently executing a query. */
+	int64 activeBackends;
+
+	/* Active client backends currently waiting on IO. */
+	int64 ioWaitBackends;
+
+	/* Maximum replay lag across the connected replicas. */
+	int64 replicationLagMs;
+} ForegroundLoadSample;
+
 PGDLLEXPORT void DocumentDBBackgroundWorkerMain(Datum);
 
 extern char *BackgroundWorkerDatabaseName;
@@ -66,13 +146,16 @@ extern char *LocalhostConnectionString;
 
 extern int LatchTimeOutSec;
 extern int BackgroundWorkerJobTimeoutThresholdSec;
+extern int BackgroundWorkerMaxConcurrentJobs;
+extern int BackgroundWorkerMaxActiveBackends;
+extern int BackgroundWorkerMaxIOWaitBackends;
+extern int BackgroundWorkerMaxReplicationLagMs;
+extern int BackgroundWorkerMaxLoadDeferralSec;
 
 static bool BackgroundWorkerReloadConfig = false;
 
 /* Shared memory segment for BackgroundWorker */
 static BackgroundWorkerShmemStruct *BackgroundWorkerShmem;
-static Size BackgroundWorkerShmemSize(void);
-static void BackgroundWorkerShmemInit(void);
 static void BackgroundWorkerKill(int code, Datum arg);
 
 /* Flags set by signal handlers */
@@ -125,6 +208,15 @@ typedef struct
 
 	/* Job state. */
 	BackgroundWorkerJobState state;
+
+	/* Whether the current run reported an error. */
+	bool runFailed;
+
+	/* Time when the job was first postponed due to foreground load, 0 if it wasn't. */
+	TimestampTz deferredSince;
+
+	/* Index of the job statistics in shared memory. */
+	int statsIndex;
 } BackgroundWorkerJobExecution;
 
 extern void RegisterBackgroundWorkerJobAllowedCommand(BackgroundWorkerJobCommand command);
@@ -137,18 +229,33 @@ static void ValidateJob(BackgroundWorkerJob job);
 static void ManageJobsLifeCycle(List *jobExecutions, char *userName, char *databaseName);
 static void ExecuteJob(BackgroundWorkerJobExecution *jobExec, char *userName,
 					   char *databaseName, TimestampTz currentTime);
-static void CheckJobCompletion(BackgroundWorkerJobExecution *jobExec);
+static void CheckJobCompletion(BackgroundWorkerJobExecution *jobExec,
+							   TimestampTz currentTime);
 static void FreeJobExecutions(List *jobExecutions);
 static bool CheckIfMetadataCoordinator(void);
 static bool CheckIfJobCommandIsAllowed(BackgroundWorkerJobCommand command);
 static bool CanExecuteJob(BackgroundWorkerJobExecution *jobExec, TimestampTz currentTime);
 static bool CheckIfRoleExists(const char *roleName);
 static List * GenerateJobExecutions(void);
-static BackgroundWorkerJobExecution * CreateJobExecutionObj(BackgroundWorkerJob job);
+static BackgroundWorkerJobExecution * CreateJobExecutionObj(BackgroundWorkerJob job,
+															int statsIndex);
 static char * GenerateCommandQuery(BackgroundWorkerJob job, MemoryContext stableContext);
 static void CancelJobIfTimeIsUp(BackgroundWorkerJobExecution *jobExec, TimestampTz
 								currentTime);
 static void WaitForBackgroundWorkerDependencies(void);
+static int CompareJobExecutionsForScheduling(const ListCell *left,
+											 const ListCell *right);
+static bool CanPostponeJobForLoad(BackgroundWorkerJobExecution *jobExec,
+								  TimestampTz currentTime);
+static bool IsForegroundLoadHigh(void);
+static bool SampleForegroundLoad(ForegroundLoadSample *sample);
+static void InitializeJobStats(void);
+static void RecordJobStarted(BackgroundWorkerJobExecution *jobExec);
+static void RecordJobFinished(BackgroundWorkerJobExecution *jobExec,
+							  TimestampTz currentTime);
+static void RecordJobTimedOut(BackgroundWorkerJobExecution *jobExec);
+static void RecordJobDeferred(BackgroundWorkerJobExecution *jobExec, bool dueToLoad);
+static const char * JobPriorityToString(BackgroundWorkerJobPriority priority);
 
 /*
  * The allowed commands registry should not be exposed outside this c file to avoid unpredictable behavior.
@@ -162,7 +269,6 @@ static int AllowedCommandEntries = 0;
 /*
  * The jobs registry should not be exposed outside this c file to avoid unpredictable behavior.
  */
-#define MAX_BACKGROUND_WORKER_JOBS 5
 static BackgroundWorkerJob JobRegistry[MAX_BACKGROUND_WORKER_JOBS];
 static int JobEntries = 0;
 
@@ -386,16 +492,23 @@ RegisterBackgroundWorkerJob(BackgroundWorkerJob job)
 
 /*
  * ManageJobsLifeCycle walks through the list of jobs and takes action based on their state.
+ *
+ * Jobs that are due are started in priority order as long as there are free
+ * concurrency slots (BackgroundWorkerMaxConcurrentJobs). Jobs that are not high
+ * priority are postponed while the foreground load of the server is above the
+ * configured thresholds, up to BackgroundWorkerMaxLoadDeferralSec.
  */
 static void
 ManageJobsLifeCycle(List *jobExecutions, char *userName, char *databaseName)
 {
 	TimestampTz currentTime = GetCurrentTimestamp();
 	ListCell *jobExecCell = NULL;
+	List *dueJobExecutions = NIL;
+	int runningJobs = 0;
 
 	/*
-	 * Manages each job execution's state. Execute if possible and
-	 * complete when done.
+	 * Manages each job execution's state. Complete when done and collect the
+	 * ones that are due to execute.
 	 */
 	foreach(jobExecCell, jobExecutions)
 	{
@@ -406,14 +519,230 @@ ManageJobsLifeCycle(List *jobExecutions, char *userName, char *databaseName)
 		CancelJobIfTimeIsUp(jobExec, currentTime);
 
 		/* Check if job completed in case the job is running. */
-		CheckJobCompletion(jobExec);
+		CheckJobCompletion(jobExec, currentTime);
+
+		if (jobExec->state == JOB_RUNNING)
+		{
+			runningJobs++;
+		}
+		else if (CanExecuteJob(jobExec, currentTime))
+		{
+			/* Job hasn't started and the scheduled interval was reached. */
+			dueJobExecutions = lappend(dueJobExecutions, jobExec);
+		}
+	}
+
+	if (dueJobExecutions == NIL)
+	{
+		return;
+	}
+
+	list_sort(dueJobExecutions, CompareJobExecutionsForScheduling);
+
+	bool isLoadSampled = false;
+	bool isLoadHigh = false;
+	foreach(jobExecCell, dueJobExecutions)
+	{
+		BackgroundWorkerJobExecution *jobExec = (BackgroundWorkerJobExecution *) lfirst(
+			jobExecCell);
 
-		/* Executes job if it hasn't started and the scheduled interval was reached. */
-		if (CanExecuteJob(jobExec, currentTime))
+		if (BackgroundWorkerMaxConcurrentJobs > 0 &&
+			runningJobs >= BackgroundWorkerMaxConcurrentJobs)
 		{
-			ExecuteJob(jobExec, userName, databaseName, currentTime);
+			RecordJobDeferred(jobExec, false);
+			continue;
 		}
+
+		if (CanPostponeJobForLoad(jobExec, currentTime))
+		{
+			if (!isLoadSampled)
+			{
+				isLoadHigh = IsForegroundLoadHigh();
+				isLoadSampled = true;
+			}
+
+			if (isLoadHigh)
+			{
+				if (jobExec->deferredSince == 0)
+				{
+					jobExec->deferredSince = currentTime;
+				}
+
+				RecordJobDeferred(jobExec, true);
+				continue;
+			}
+		}
+
+		ExecuteJob(jobExec, userName, databaseName, currentTime);
+		if (jobExec->state == JOB_RUNNING)
+		{
+			jobExec->deferredSince = 0;
+			runningJobs++;
+		}
+	}
+
+	list_free(dueJobExecutions);
+}
+
+
+/*
+ * High priority jobs always run. Other jobs yield to the foreground workload,
+ * but only up to BackgroundWorkerMaxLoadDeferralSec so that they don't fall
+ * behind indefinitely.
+ */
+static bool
+CanPostponeJobForLoad(BackgroundWorkerJobExecution *jobExec, TimestampTz currentTime)
+{
+	if (jobExec->job.priority >= BackgroundWorkerJobPriority_High)
+	{
+		return false;
+	}
+
+	if (jobExec->deferredSince == 0 || BackgroundWorkerMaxLoadDeferralSec <= 0)
+	{
+		return true;
+	}
+
+	return !TimestampDifferenceExceeds(jobExec->deferredSince, currentTime,
+									   BackgroundWorkerMaxLoadDeferralSec * ONE_SEC_IN_MS);
+}
+
+
+/*
+ * Orders job executions so that jobs with a higher priority come first, and
+ * among jobs of the same priority the one that started the longest ago.
+ */
+static int
+CompareJobExecutionsForScheduling(const ListCell *left, const ListCell *right)
+{
+	BackgroundWorkerJobExecution *leftJob = (BackgroundWorkerJobExecution *) lfirst(
+		left);
+	BackgroundWorkerJobExecution *rightJob = (BackgroundWorkerJobExecution *) lfirst(
+		right);
+
+	if (leftJob->job.priority != rightJob->job.priority)
+	{
+		return leftJob->job.priority > rightJob->job.priority ? -1 : 1;
+	}
+
+	if (leftJob->lastStartTime != rightJob->lastStartTime)
+	{
+		return leftJob->lastStartTime < rightJob->lastStartTime ? -1 : 1;
 	}
+
+	return 0;
+}
+
+
+/*
+ * Returns true if the foreground workload exceeds any of the configured
+ * thresholds. Returns false if no threshold is configured or the load
+ * could not be sampled.
+ */
+static bool
+IsForegroundLoadHigh(void)
+{
+	if (BackgroundWorkerMaxActiveBackends <= 0 &&
+		BackgroundWorkerMaxIOWaitBackends <= 0 &&
+		BackgroundWorkerMaxReplicationLagMs <= 0)
+	{
+		return false;
+	}
+
+	ForegroundLoadSample sample = { 0 };
+	if (!SampleForegroundLoad(&sample))
+	{
+		return false;
+	}
+
+	bool isLoadHigh =
+		(BackgroundWorkerMaxActiveBackends > 0 &&
+		 sample.activeBackends > BackgroundWorkerMaxActiveBackends) ||
+		(BackgroundWorkerMaxIOWaitBackends > 0 &&
+		 sample.ioWaitBackends > BackgroundWorkerMaxIOWaitBackends) ||
+		(BackgroundWorkerMaxReplicationLagMs > 0 &&
+		 sample.replicationLagMs > BackgroundWorkerMaxReplicationLagMs);
+
+	if (isLoadHigh)
+	{
+		ereport(DEBUG1, (errmsg(
+							 "Postponing background worker jobs due to foreground load: "
+							 "active backends %ld, io wait backends %ld, replication lag %ld ms",
+							 (long) sample.activeBackends, (long) sample.ioWaitBackends,
+							 (long) sample.replicationLagMs)));
+	}
+
+	return isLoadHigh;
+}
+
+
+/*
+ * Samples the foreground activity from pg_stat_activity and pg_stat_replication.
+ * Backends of the background worker role (i.e. the job connections) are not
+ * counted. Returns false if the sample could not be taken.
+ */
+static bool
+SampleForegroundLoad(ForegroundLoadSample *sample)
+{
+	const char *query =
+		"SELECT "
+		" count(*) FILTER (WHERE a.state = 'active'),"
+		" count(*) FILTER (WHERE a.state = 'active' AND a.wait_event_type = 'IO'),"
+		" (SELECT COALESCE(EXTRACT(EPOCH FROM max(r.replay_lag)) * 1000, 0)::int8"
+		"  FROM pg_catalog.pg_stat_replication r)"
+		" FROM pg_catalog.pg_stat_activity a"
+		" WHERE a.backend_type = 'client backend'"
+		" AND a.usename::text IS DISTINCT FROM $1";
+
+	SetCurrentStatementStartTimestamp();
+	PopAllActiveSnapshots();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	MemoryContext oldMemContext = CurrentMemoryContext;
+
+	/* declared volatile because of the longjmp in PG_CATCH */
+	volatile bool sampled = false;
+
+	PG_TRY();
+	{
+		int nargs = 1;
+		Oid argTypes[1] = { TEXTOID };
+		Datum argValues[1] = { CStringGetTextDatum(ApiBgWorkerRole) };
+		char argNulls[1] = { ' ' };
+		Datum results[3] = { 0 };
+		bool isNulls[3] = { 0 };
+		bool readOnly = true;
+
+		ExtensionExecuteMultiValueQueryWithArgsViaSPI(query, nargs, argTypes, argValues,
+													  argNulls, readOnly, SPI_OK_SELECT,
+													  results, isNulls, 3);
+
+		sample->activeBackends = isNulls[0] ? 0 : DatumGetInt64(results[0]);
+		sample->ioWaitBackends = isNulls[1] ? 0 : DatumGetInt64(results[1]);
+		sample->replicationLagMs = isNulls[2] ? 0 : DatumGetInt64(results[2]);
+		sampled = true;
+
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		MemoryContextSwitchTo(oldMemContext);
+		ErrorData *edata = CopyErrorDataAndFlush();
+
+		ereport(LOG, (errcode(edata->sqlerrcode),
+					  errmsg(
+						  "couldn't sample the foreground load for the background worker: "
+						  "file: %s, line: %d, message_id: %s",
+						  edata->filename, edata->lineno, edata->message_id)));
+
+		PopAllActiveSnapshots();
+		AbortCurrentTransaction();
+	}
+	PG_END_TRY();
+
+	return sampled;
 }
 
 
@@ -449,7 +778,7 @@ CanExecuteJob(BackgroundWorkerJobExecution *jobExec, TimestampTz currentTime)
  * If positive, closes the job PG connection and resets it.
  */
 static void
-CheckJobCompletion(BackgroundWorkerJobExecution *jobExec)
+CheckJobCompletion(BackgroundWorkerJobExecution *jobExec, TimestampTz currentTime)
 {
 	PGconn *conn = jobExec->connection;
 	if (jobExec->state == JOB_IDLE)
@@ -457,7 +786,10 @@ CheckJobCompletion(BackgroundWorkerJobExecution *jobExec)
 		return;
 	}
 
-	/* Checks if command is busy. If not, close connection and reset it. */
+	/*
+	 * Checks if command is busy. If not, drain the results without blocking and
+	 * once all of them are consumed close connection and reset it.
+	 */
 	PG_TRY();
 	{
 		if (PQconsumeInput(conn) == 0)
@@ -465,11 +797,24 @@ CheckJobCompletion(BackgroundWorkerJobExecution *jobExec)
 			PGConnReportError(conn, NULL, ERROR);
 		}
 
-		if (!PQisBusy(conn))
+		while (!PQisBusy(conn))
 		{
-			PQfinish(conn);
-			jobExec->connection = NULL;
-			jobExec->state = JOB_IDLE;
+			PGresult *result = PQgetResult(conn);
+			if (result == NULL)
+			{
+				PQfinish(conn);
+				jobExec->connection = NULL;
+				jobExec->state = JOB_IDLE;
+				RecordJobFinished(jobExec, currentTime);
+				break;
+			}
+
+			if (PQresultStatus(result) == PGRES_FATAL_ERROR)
+			{
+				jobExec->runFailed = true;
+			}
+
+			PQclear(result);
 		}
 	}
 	PG_CATCH();
@@ -483,6 +828,8 @@ CheckJobCompletion(BackgroundWorkerJobExecution *jobExec)
 		/* Set state to idle so it can run in the next iteration. */
 		jobExec->connection = NULL;
 		jobExec->state = JOB_IDLE;
+		jobExec->runFailed = true;
+		RecordJobFinished(jobExec, currentTime);
 
 		ereport(WARNING, (errmsg(
 							  "Failed to execute background worker job %s with id %d. Could not consume input from the connection.",
@@ -605,6 +952,8 @@ ExecuteJob(BackgroundWorkerJobExecution *jobExec, char *userName, char *database
 		jobExec->connection = conn;
 		jobExec->state = JOB_RUNNING;
 		jobExec->lastStartTime = currentTime;
+		jobExec->runFailed = false;
+		RecordJobStarted(jobExec);
 	}
 	PG_CATCH();
 	{
@@ -658,6 +1007,7 @@ CancelJobIfTimeIsUp(BackgroundWorkerJobExecution *jobExec, TimestampTz currentTi
 		PQfinish(conn);
 		jobExec->connection = NULL;
 		jobExec->state = JOB_IDLE;
+		RecordJobTimedOut(jobExec);
 
 		ereport(LOG, (errmsg(
 						  "Canceled background worker job %s with id %d because of connection timeout of %d seconds.",
@@ -736,6 +1086,14 @@ ValidateJob(BackgroundWorkerJob job)
 	{
 		ereport(ERROR, (errmsg("Background worker job command is not allowed")));
 	}
+
+	if (job.priority < BackgroundWorkerJobPriority_Low ||
+		job.priority > BackgroundWorkerJobPriority_High)
+	{
+		ereport(ERROR, (errmsg(
+							"Priority of background worker job \'%s\' is not valid",
+							job.jobName)));
+	}
 }
 
 
@@ -771,9 +1129,11 @@ GenerateJobExecutions(void)
 {
 	List *jobExecutions = NIL;
 
+	InitializeJobStats();
+
 	for (int i = 0; i < JobEntries; i++)
 	{
-		BackgroundWorkerJobExecution *jobExec = CreateJobExecutionObj(JobRegistry[i]);
+		BackgroundWorkerJobExecution *jobExec = CreateJobExecutionObj(JobRegistry[i], i);
 
 		/*
 		 * Check for nullity. NULL is returned if an error happened while creating
@@ -800,7 +1160,7 @@ GenerateJobExecutions(void)
  * object. We need it to keep track of execution states and database connection.
  */
 static BackgroundWorkerJobExecution *
-CreateJobExecutionObj(BackgroundWorkerJob job)
+CreateJobExecutionObj(BackgroundWorkerJob job, int statsIndex)
 {
 	BackgroundWorkerJobExecution *jobExec = NULL;
 	char *commandQuery = NULL;
@@ -817,6 +1177,9 @@ CreateJobExecutionObj(BackgroundWorkerJob job)
 	jobExec->connection = NULL;
 	jobExec->commandQuery = commandQuery;
 	jobExec->state = JOB_IDLE;
+	jobExec->runFailed = false;
+	jobExec->deferredSince = 0;
+	jobExec->statsIndex = statsIndex;
 
 	return jobExec;
 }
@@ -961,7 +1324,7 @@ GenerateCommandQuery(BackgroundWorkerJob job, MemoryContext stableContext)
 /*
  * Report shared-memory space needed by BackgroundWorkerShmemInit
  */
-static Size
+Size
 BackgroundWorkerShmemSize(void)
 {
 	Size size;
@@ -975,7 +1338,7 @@ BackgroundWorkerShmemSize(void)
  * BackgroundWorkerShmemInit
  * Allocate and initialize Background worker-related shared memory
  */
-static void
+void
 BackgroundWorkerShmemInit(void)
 {
 	bool found;
@@ -988,7 +1351,216 @@ BackgroundWorkerShmemInit(void)
 		/* First time through, so initialize */
 		MemSet(BackgroundWorkerShmem, 0, BackgroundWorkerShmemSize());
 		InitSharedLatch(&BackgroundWorkerShmem->latch);
+		SpinLockInit(&BackgroundWorkerShmem->mutex);
+	}
+}
+
+
+/*
+ * Associates the shared memory job statistics with the registered jobs.
+ * Statistics of a job are kept across background worker restarts as long as
+ * the job registered in the same position.
+ */
+static void
+InitializeJobStats(void)
+{
+	SpinLockAcquire(&BackgroundWorkerShmem->mutex);
+	for (int i = 0; i < JobEntries; i++)
+	{
+		BackgroundWorkerJobStats *stats = &BackgroundWorkerShmem->jobStats[i];
+		if (stats->jobId != JobRegistry[i].jobId ||
+			strncmp(stats->jobName, JobRegistry[i].jobName, NAMEDATALEN) != 0)
+		{
+			MemSet(stats, 0, sizeof(BackgroundWorkerJobStats));
+			stats->jobId = JobRegistry[i].jobId;
+			strlcpy(stats->jobName, JobRegistry[i].jobName, NAMEDATALEN);
+		}
+
+		stats->priority = JobRegistry[i].priority;
 	}
+
+	BackgroundWorkerShmem->numJobStats = JobEntries;
+	SpinLockRelease(&BackgroundWorkerShmem->mutex);
+}
+
+
+/*
+ * Records that a job run was started.
+ */
+static void
+RecordJobStarted(BackgroundWorkerJobExecution *jobExec)
+{
+	BackgroundWorkerJobStats *stats =
+		&BackgroundWorkerShmem->jobStats[jobExec->statsIndex];
+
+	SpinLockAcquire(&BackgroundWorkerShmem->mutex);
+	stats->runs++;
+	SpinLockRelease(&BackgroundWorkerShmem->mutex);
+}
+
+
+/*
+ * Records the completion of a job run in its run time histogram.
+ */
+static void
+RecordJobFinished(BackgroundWorkerJobExecution *jobExec, TimestampTz currentTime)
+{
+	BackgroundWorkerJobStats *stats =
+		&BackgroundWorkerShmem->jobStats[jobExec->statsIndex];
+
+	long secs;
+	int microsecs;
+	TimestampDifference(jobExec->lastStartTime, currentTime, &secs, &microsecs);
+	uint64 durationMs = (uint64) secs * ONE_SEC_IN_MS + microsecs / 1000;
+
+	int bucket = 0;
+	uint64 bucketUpperBoundMs = BACKGROUND_WORKER_JOB_LATENCY_FIRST_BUCKET_MS;
+	while (bucket < BACKGROUND_WORKER_JOB_LATENCY_BUCKETS - 1 &&
+		   durationMs > bucketUpperBoundMs)
+	{
+		bucket++;
+		bucketUpperBoundMs *= 2;
+	}
+
+	SpinLockAcquire(&BackgroundWorkerShmem->mutex);
+	stats->totalRunTimeMs += durationMs;
+	stats->latencyHistogram[bucket]++;
+	if (jobExec->runFailed)
+	{
+		stats->failures++;
+	}
+	SpinLockRelease(&BackgroundWorkerShmem->mutex);
+}
+
+
+/*
+ * Records that a job run was canceled due to its timeout.
+ */
+static void
+RecordJobTimedOut(BackgroundWorkerJobExecution *jobExec)
+{
+	BackgroundWorkerJobStats *stats =
+		&BackgroundWorkerShmem->jobStats[jobExec->statsIndex];
+
+	SpinLockAcquire(&BackgroundWorkerShmem->mutex);
+	stats->timeouts++;
+	SpinLockRelease(&BackgroundWorkerShmem->mutex);
+}
+
+
+/*
+ * Records that a job that was due got postponed, either due to foreground
+ * load or due to all concurrency slots being in use.
+ */
+static void
+RecordJobDeferred(BackgroundWorkerJobExecution *jobExec, bool dueToLoad)
+{
+	BackgroundWorkerJobStats *stats =
+		&BackgroundWorkerShmem->jobStats[jobExec->statsIndex];
+
+	SpinLockAcquire(&BackgroundWorkerShmem->mutex);
+	if (dueToLoad)
+	{
+		stats->deferredForLoad++;
+	}
+	else
+	{
+		stats->deferredForSlots++;
+	}
+	SpinLockRelease(&BackgroundWorkerShmem->mutex);
+}
+
+
+static const char *
+JobPriorityToString(BackgroundWorkerJobPriority priority)
+{
+	switch (priority)
+	{
+		case BackgroundWorkerJobPriority_Low:
+		{
+			return "low";
+		}
+
+		case BackgroundWorkerJobPriority_High:
+		{
+			return "high";
+		}
+
+		case BackgroundWorkerJobPriority_Normal:
+		default:
+		{
+			return "normal";
+		}
+	}
+}
+
+
+PG_FUNCTION_INFO_V1(get_background_worker_job_stats);
+
+/*
+ * get_background_worker_job_stats returns the scheduling statistics of the
+ * background worker jobs: the number of runs, failures, timeouts and
+ * postponements, as well as the run time histogram of each job.
+ */
+Datum
+get_background_worker_job_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *resultSet = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc tupleDescriptor = NULL;
+	if (get_call_result_type(fcinfo, NULL, &tupleDescriptor) != TYPEFUNC_COMPOSITE)
+	{
+		elog(ERROR, "return type must be a row type");
+	}
+
+	MemoryContext perQueryContext = resultSet->econtext->ecxt_per_query_memory;
+	MemoryContext oldContext = MemoryContextSwitchTo(perQueryContext);
+	Tuplestorestate *tupleStore = tuplestore_begin_heap(true, false, work_mem);
+	resultSet->returnMode = SFRM_Materialize;
+	resultSet->setResult = tupleStore;
+	resultSet->setDesc = tupleDescriptor;
+	MemoryContextSwitchTo(oldContext);
+
+	if (BackgroundWorkerShmem == NULL)
+	{
+		PG_RETURN_VOID();
+	}
+
+	/* Take a consistent copy so that we don't build tuples under the spinlock */
+	BackgroundWorkerJobStats jobStats[MAX_BACKGROUND_WORKER_JOBS];
+	SpinLockAcquire(&BackgroundWorkerShmem->mutex);
+	int numJobStats = BackgroundWorkerShmem->numJobStats;
+	memcpy(jobStats, BackgroundWorkerShmem->jobStats,
+		   sizeof(BackgroundWorkerJobStats) * numJobStats);
+	SpinLockRelease(&BackgroundWorkerShmem->mutex);
+
+	for (int i = 0; i < numJobStats; i++)
+	{
+		Datum values[BACKGROUND_WORKER_JOB_STATS_COLUMNS] = { 0 };
+		bool isNulls[BACKGROUND_WORKER_JOB_STATS_COLUMNS] = { 0 };
+		Datum histogram[BACKGROUND_WORKER_JOB_LATENCY_BUCKETS];
+
+		for (int j = 0; j < BACKGROUND_WORKER_JOB_LATENCY_BUCKETS; j++)
+		{
+			histogram[j] = Int64GetDatum((int64) jobStats[i].latencyHistogram[j]);
+		}
+
+		values[0] = Int32GetDatum(jobStats[i].jobId);
+		values[1] = CStringGetTextDatum(jobStats[i].jobName);
+		values[2] = CStringGetTextDatum(JobPriorityToString(jobStats[i].priority));
+		values[3] = Int64GetDatum((int64) jobStats[i].runs);
+		values[4] = Int64GetDatum((int64) jobStats[i].failures);
+		values[5] = Int64GetDatum((int64) jobStats[i].timeouts);
+		values[6] = Int64GetDatum((int64) jobStats[i].deferredForLoad);
+		values[7] = Int64GetDatum((int64) jobStats[i].deferredForSlots);
+		values[8] = Int64GetDatum((int64) jobStats[i].totalRunTimeMs);
+		values[9] = PointerGetDatum(construct_array(histogram,
+													BACKGROUND_WORKER_JOB_LATENCY_BUCKETS,
+													INT8OID, sizeof(int64),
+													FLOAT8PASSBYVAL, TYPALIGN_DOUBLE));
+		tuplestore_putvalues(tupleStore, tupleDescriptor, values, isNulls);
+	}
+
+	PG_RETURN_VOID();
 }
 
 
@@ -23,6 +23,8 @@
 #include "commands/commands_common.h"
 #include "utils/documentdb_errors.h"
 #include "metadata/collection.h"
+#include "metadata/collection_compression.h"
+#include "metadata/collection_field_dictionary.h"
 #include "api_hooks.h"
 #include "metadata/index.h"
 #include "metadata/metadata_cache.h"
@@ -35,6 +37,8 @@
 extern bool EnablePrepareUnique;
 extern bool EnableCollModUnique;
 extern bool ForceUpdateIndexInline;
+extern bool EnableFieldNameDictionary;
+extern bool EnableDocumentCompression;
 
 
 /* --------------------------------------------------------- */
@@ -79,6 +83,12 @@ typedef struct
 	/* The validation action for the collection */
 	char *validationAction;
 
+	/* Whether documents are stored with dictionary encoded field names */
+	bool fieldNameDictionary;
+
+	/* Whether documents are stored compressed with a trained dictionary */
+	bool documentCompression;
+
 	/* TODO: Add more options when they are supported e.g.: Validators etc */
 } CollModOptions;
 
@@ -103,6 +113,12 @@ typedef enum CollModSpecFlags
 	/* validation update */
 	HAS_VALIDATION_OPTION = 1 << 9,
 
+	/* field name dictionary update */
+	HAS_FIELD_NAME_DICTIONARY = 1 << 10,
+
+	/* document compression update */
+	HAS_DOCUMENT_COMPRESSION = 1 << 11,
+
 	/* TODO: More OPTIONS to follow */
 } CollModSpecFlags;
 
@@ -285,6 +301,30 @@ command_coll_mod(PG_FUNCTION_ARGS)
 							   collModOptions.validationAction);
 	}
 
+	if (specFlags & HAS_FIELD_NAME_DICTIONARY)
+	{
+		if (!EnableFieldNameDictionary)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
+							errmsg("collMod.fieldNameDictionary is not supported yet")));
+		}
+
+		UpdateCollectionFieldDictionary(collection,
+										collModOptions.fieldNameDictionary, &writer);
+	}
+
+	if (specFlags & HAS_DOCUMENT_COMPRESSION)
+	{
+		if (!EnableDocumentCompression)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
+							errmsg("collMod.documentCompression is not supported yet")));
+		}
+
+		UpdateCollectionCompression(collection, collModOptions.documentCompression,
+									&writer);
+	}
+
 	PG_RETURN_POINTER(PgbsonWriterGetPgbson(&writer));
 }
 
@@ -368,6 +408,18 @@ ParseSpecSetCollModOptions(const pgbson *collModSpec,
 																				 &
 																				 hasSchemaValidation);
 		}
+		else if (strcmp(key, "fieldNameDictionary") == 0)
+		{
+			EnsureTopLevelFieldIsBooleanLike("collMod.fieldNameDictionary", &iter);
+			collModOptions->fieldNameDictionary = BsonValueAsBool(value);
+			specFlags |= HAS_FIELD_NAME_DICTIONARY;
+		}
+		else if (strcmp(key, "documentCompression") == 0)
+		{
+			EnsureTopLevelFieldIsBooleanLike("collMod.documentCompression", &iter);
+			collModOptions->documentCompression = BsonValueAsBool(value);
+			specFlags |= HAS_DOCUMENT_COMPRESSION;
+		}
 		else if (IsCommonSpecIgnoredField(key))
 		{
 			/*
@@ -65,6 +65,7 @@
 #include "vector/vector_common.h"
 #include "vector/vector_utilities.h"
 #include "index_am/index_am_utils.h"
+#include "index_am/shared_heap_scan_build.h"
 
 /* Return value of TryCreateCollectionIndexes */
 typedef struct
@@ -166,9 +167,11 @@ extern bool EnableCompositeWildcardIndex;
 extern bool EnableCompositeReducedCorrelatedTerms;
 extern bool EnableUniqueCompositeReducedCorrelatedTerms;
 extern bool EnableCompositeShardDocumentTerms;
+extern bool EnableSharedHeapScanIndexBuild;
 
 extern bool EnableCollationWithIndexes;
 extern bool SkipFailOnCollation;
+extern bool EnableGeospatialCellIndex;
 
 extern char *AlternateIndexHandler;
 
@@ -310,6 +313,8 @@ static char * GenerateIndexExprStr(const char *indexAmSuffix,
 								   const char *indexAmOpClassInternalCatalogSchema,
 								   const char *collationString);
 static char * Generate2dsphereIndexExprStr(const IndexDefKey *indexDefKey);
+static char * Generate2dsphereCellIndexExprStr(const IndexDefKey *indexDefKey,
+											   const BsonIndexAmEntry *indexAm);
 static char * Generate2dsphereSparseExprStr(const IndexDefKey *indexDefKey);
 static char * GenerateIndexFilterStr(uint64 collectionId, Expr *indexDefPartFilterExpr);
 static char * DeparseSimpleExprForDocument(uint64 collectionId, Expr *expr);
@@ -1056,32 +1061,61 @@ create_indexes_non_concurrently(Datum dbNameDatum, CreateIndexesArg createIndexe
 	/* pop the snapshot that we've just pushed above */
 	PopActiveSnapshot();
 
+	/*
+	 * When several indexes are created on an unsharded collection, build them
+	 * all from a single scan of the data table instead of one scan per index.
+	 */
+	bool useSharedHeapScanBuild = EnableSharedHeapScanIndexBuild && isUnsharded &&
+								  list_length(createIndexesArg.indexDefList) > 1;
+	if (useSharedHeapScanBuild)
+	{
+		BeginSharedHeapScanIndexBuild(collection->relationId);
+	}
+
 	/* create indexes on data table and record them in metadata */
-	ListCell *indexDefCell = NULL;
-	foreach(indexDefCell, createIndexesArg.indexDefList)
+	List *createdIndexIdList = NIL;
+	PG_TRY();
 	{
-		IndexDef *indexDef = (IndexDef *) lfirst(indexDefCell);
-		if (uniqueIndexOnly && indexDef->unique != BoolIndexOption_True)
+		ListCell *indexDefCell = NULL;
+		foreach(indexDefCell, createIndexesArg.indexDefList)
 		{
-			continue;
-		}
+			IndexDef *indexDef = (IndexDef *) lfirst(indexDefCell);
+			if (uniqueIndexOnly && indexDef->unique != BoolIndexOption_True)
+			{
+				continue;
+			}
 
-		/*
-		 * Record the index as valid since we will anyway rollback the
-		 * transaction in case of an error.
-		 */
-		const IndexSpec indexSpec = MakeIndexSpecForIndexDef(indexDef);
-		bool indexIsValid = true;
-		int indexId = RecordCollectionIndex(collectionId, &indexSpec, indexIsValid);
+			/*
+			 * Record the index as valid since we will anyway rollback the
+			 * transaction in case of an error.
+			 */
+			const IndexSpec indexSpec = MakeIndexSpecForIndexDef(indexDef);
+			bool indexIsValid = true;
+			int indexId = RecordCollectionIndex(collectionId, &indexSpec,
+												indexIsValid);
 
-		bool createIndexesConcurrently = false;
-		bool isTempCollection = false;
-		CreatePostgresIndex(collectionId, indexDef, indexId, createIndexesConcurrently,
-							isTempCollection, isUnsharded);
+			bool createIndexesConcurrently = false;
+			bool isTempCollection = false;
+			CreatePostgresIndex(collectionId, indexDef, indexId,
+								createIndexesConcurrently,
+								isTempCollection, isUnsharded);
+			createdIndexIdList = lappend_int(createdIndexIdList, indexId);
+		}
 
-		/* Set statistics for the created indexes */
-		UpdateIndexStatsForPostgresIndex(collectionId, list_make1_int(indexId));
+		if (useSharedHeapScanBuild)
+		{
+			EndSharedHeapScanIndexBuild();
+		}
 	}
+	PG_CATCH();
+	{
+		ResetSharedHeapScanIndexBuild();
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	/* Set statistics for the created indexes */
+	UpdateIndexStatsForPostgresIndex(collectionId, createdIndexIdList);
 
 	/*
 	 * Set "note" field of the response message based on whether we
@@ -3095,9 +3129,22 @@ ParseIndexDefKeyDocument(const bson_iter_t *indexDefDocIter)
 	if ((allindexKinds & MongoIndexKind_2dsphere) == MongoIndexKind_2dsphere &&
 		(allindexKinds & MongoIndexKind_Regular) == MongoIndexKind_Regular)
 	{
-		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
-						errmsg(
-							"Compound Regular & 2dsphere indexes are not supported yet")));
+		if (!EnableGeospatialCellIndex)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
+							errmsg(
+								"Compound Regular & 2dsphere indexes are not supported yet")));
+		}
+
+		if (wildcardIndexKind != 0)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
+							errmsg(
+								"Compound wildcard & 2dsphere indexes are not supported yet")));
+		}
+
+		/* The GIST index can't hold the regular paths, index the geographies as cells on RUM */
+		indexDefKey->has2dsphereCellIndex = true;
 	}
 
 	if (numHashedIndexes > 1)
@@ -5179,6 +5226,24 @@ CreatePostgresIndexCreationCmd(uint64 collectionId, IndexDef *indexDef, int inde
 												indexDef->partialFilterExpr) : "",
 						 indexDef->partialFilterExpr ? ")" : "");
 	}
+	else if (indexDef->key->has2dsphereCellIndex)
+	{
+		appendStringInfo(cmdStr,
+						 "CREATE INDEX %s " DOCUMENT_DATA_TABLE_INDEX_NAME_FORMAT
+						 " ON %s." DOCUMENT_DATA_TABLE_NAME_FORMAT
+						 " USING %s_%s(%s) WHERE (%s)"
+						 " %s%s%s",
+						 concurrently ? "CONCURRENTLY" : "", indexId,
+						 ApiDataSchemaName, collectionId,
+						 ExtensionObjectPrefix, indexAm->am_name,
+						 Generate2dsphereCellIndexExprStr(indexDef->key, indexAm),
+						 Generate2dsphereSparseExprStr(indexDef->key),
+						 indexDef->partialFilterExpr ? " AND (" : "",
+						 indexDef->partialFilterExpr ?
+						 GenerateIndexFilterStr(collectionId,
+												indexDef->partialFilterExpr) : "",
+						 indexDef->partialFilterExpr ? ")" : "");
+	}
 	else if (indexDef->key->has2dsphereIndex)
 	{
 		appendStringInfo(cmdStr,
@@ -5331,30 +5396,88 @@ Generate2dsphereIndexExprStr(const IndexDefKey *indexDefKey)
 }
 
 
+/*
+ * Generates the RUM Index expression for 2dsphere fields compounded with regular
+ * fields: the regular fields use the single path opclass and the 2dsphere fields the
+ * cell opclass on the same expression the GIST 2dsphere index is built on, so that
+ * the geospatial operators match either index.
+ */
+static char *
+Generate2dsphereCellIndexExprStr(const IndexDefKey *indexDefKey,
+								 const BsonIndexAmEntry *indexAm)
+{
+	StringInfo cellIndexExpr = makeStringInfo();
+	ListCell *keyPathCell = NULL;
+	foreach(keyPathCell, indexDefKey->keyPathList)
+	{
+		IndexDefKeyPath *indexKeyPath = (IndexDefKeyPath *) lfirst(keyPathCell);
+		const char *quotedPath = quote_literal_cstr(indexKeyPath->path);
+		if (foreach_current_index(keyPathCell) > 0)
+		{
+			appendStringInfoChar(cellIndexExpr, ',');
+		}
+
+		if (indexKeyPath->indexKind == MongoIndexKind_2dsphere)
+		{
+			appendStringInfo(cellIndexExpr,
+							 "%s.bson_validate_geography(document, %s::text) "
+							 "%s.%s_%s_geography_cell_ops(path=%s)",
+							 ApiCatalogSchemaName, quotedPath,
+							 indexAm->get_opclass_catalog_schema(),
+							 ExtensionObjectPrefix, indexAm->am_name, quotedPath);
+		}
+		else
+		{
+			appendStringInfo(cellIndexExpr,
+							 "document %s.bson_%s_single_path_ops(path=%s)",
+							 indexAm->get_opclass_catalog_schema(),
+							 indexAm->am_name, quotedPath);
+		}
+	}
+
+	if (cellIndexExpr->len >= MAX_INDEX_OPTIONS_LENGTH)
+	{
+		int lengthDelta = cellIndexExpr->len - MAX_INDEX_OPTIONS_LENGTH;
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_CANNOTCREATEINDEX),
+						errmsg(
+							"The index path or expression is too long. Try a shorter path or reducing paths by %d characters.",
+							lengthDelta)));
+	}
+
+	return cellIndexExpr->data;
+}
+
+
 /*
  * Generates the 2dsphere Index Sparse expression for multiple index fields.
+ * Regular fields compounded with 2dsphere fields do not make the index sparse.
  */
 static char *
 Generate2dsphereSparseExprStr(const IndexDefKey *indexDefKey)
 {
-	int keysLength = list_length(indexDefKey->keyPathList);
-	Assert(keysLength > 0);
+	Assert(list_length(indexDefKey->keyPathList) > 0);
 	StringInfo sphereIndexExpr = makeStringInfo();
-	int index = 0;
+	bool isFirstPath = true;
 	ListCell *keyPathCell = NULL;
 	foreach(keyPathCell, indexDefKey->keyPathList)
 	{
 		IndexDefKeyPath *indexKeyPath = (IndexDefKeyPath *) lfirst(keyPathCell);
+		if (indexKeyPath->indexKind != MongoIndexKind_2dsphere)
+		{
+			continue;
+		}
+
+		if (!isFirstPath)
+		{
+			appendStringInfo(sphereIndexExpr, "%s", "OR");
+		}
+
 		appendStringInfo(sphereIndexExpr,
 						 " %s.bson_validate_geography(document, %s::text)"
 						 " IS NOT NULL ",
 						 ApiCatalogSchemaName,
 						 quote_literal_cstr(indexKeyPath->path));
-		index++;
-		if (index < keysLength)
-		{
-			appendStringInfo(sphereIndexExpr, "%s", "OR");
-		}
+		isFirstPath = false;
 	}
 	return sphereIndexExpr->data;
 }
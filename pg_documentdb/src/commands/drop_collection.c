@@ -21,6 +21,8 @@
 
 #include "utils/documentdb_errors.h"
 #include "metadata/collection.h"
+#include "metadata/collection_compression.h"
+#include "metadata/collection_field_dictionary.h"
 #include "metadata/metadata_cache.h"
 #include "metadata/index.h"
 #include "utils/query_utils.h"
@@ -190,6 +192,12 @@ command_drop_collection(PG_FUNCTION_ARGS)
 
 	DeleteAllCollectionIndexRecords(collection->collectionId);
 
+	if (IsClusterVersionAtleast(DocDB_V0, 110, 0))
+	{
+		DeleteCollectionFieldDictionary(collection->collectionId);
+		DeleteCollectionCompression(collection->collectionId);
+	}
+
 	PG_RETURN_BOOL(true);
 }
 
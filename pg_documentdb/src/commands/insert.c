@@ -33,6 +33,8 @@
 #include "commands/insert.h"
 #include "commands/parse_error.h"
 #include "metadata/collection.h"
+#include "metadata/collection_compression.h"
+#include "metadata/collection_field_dictionary.h"
 #include "infrastructure/documentdb_plan_cache.h"
 #include "sharding/sharding.h"
 #include "commands/retryable_writes.h"
@@ -1519,7 +1521,8 @@ PreprocessInsertionDoc(const bson_value_t *docValue, MongoCollection *collection
 		*objectId = PgbsonGetDocumentId(insertDoc);
 	}
 
-	return insertDoc;
+	pgbson *storedDoc = EncodeDocumentForCollection(collection, insertDoc);
+	return CompressDocumentForCollection(collection, storedDoc);
 }
 
 
@@ -60,6 +60,13 @@ bool TTLSkipCaughtUpIndexes = DEFAULT_SKIP_CAUGHT_UP_TTL_INDEXES;
 #define DEFAULT_ENABLE_TTL_DESC_SORT false
 bool EnableTTLDescSort = DEFAULT_ENABLE_TTL_DESC_SORT;
 
+#define DEFAULT_COMPRESSION_DICTIONARY_RETRAIN_INTERVAL_SEC 86400
+int CompressionDictionaryRetrainIntervalSec =
+	DEFAULT_COMPRESSION_DICTIONARY_RETRAIN_INTERVAL_SEC;
+
+#define DEFAULT_DATABASE_PROFILER_FLUSH_INTERVAL_SEC 5
+int DatabaseProfilerFlushIntervalSec = DEFAULT_DATABASE_PROFILER_FLUSH_INTERVAL_SEC;
+
 #define DEFAULT_ENABLE_BG_WORKER true
 bool EnableBackgroundWorker = DEFAULT_ENABLE_BG_WORKER;
 
@@ -69,6 +76,21 @@ bool EnableBackgroundWorkerJobs = DEFAULT_ENABLE_BG_WORKER_JOBS;
 #define DEFAULT_BG_WORKER_JOB_TIMEOUT_THRESHOLD_SEC 300
 int BackgroundWorkerJobTimeoutThresholdSec = DEFAULT_BG_WORKER_JOB_TIMEOUT_THRESHOLD_SEC;
 
+#define DEFAULT_BG_WORKER_MAX_CONCURRENT_JOBS 0
+int BackgroundWorkerMaxConcurrentJobs = DEFAULT_BG_WORKER_MAX_CONCURRENT_JOBS;
+
+#define DEFAULT_BG_WORKER_MAX_ACTIVE_BACKENDS 0
+int BackgroundWorkerMaxActiveBackends = DEFAULT_BG_WORKER_MAX_ACTIVE_BACKENDS;
+
+#define DEFAULT_BG_WORKER_MAX_IO_WAIT_BACKENDS 0
+int BackgroundWorkerMaxIOWaitBackends = DEFAULT_BG_WORKER_MAX_IO_WAIT_BACKENDS;
+
+#define DEFAULT_BG_WORKER_MAX_REPLICATION_LAG_MS 0
+int BackgroundWorkerMaxReplicationLagMs = DEFAULT_BG_WORKER_MAX_REPLICATION_LAG_MS;
+
+#define DEFAULT_BG_WORKER_MAX_LOAD_DEFERRAL_SEC 600
+int BackgroundWorkerMaxLoadDeferralSec = DEFAULT_BG_WORKER_MAX_LOAD_DEFERRAL_SEC;
+
 #define DEFAULT_BG_DATABASE_NAME "postgres"
 char *BackgroundWorkerDatabaseName = DEFAULT_BG_DATABASE_NAME;
 
@@ -298,6 +320,77 @@ InitializeBackgroundJobConfigurations(const char *prefix, const char *newGucPref
 		PGC_USERSET,
 		0,
 		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.backgroundWorkerMaxConcurrentJobs", newGucPrefix),
+		gettext_noop(
+			"Maximum number of background worker jobs that can run at the same time, 0 means unlimited."),
+		NULL, &BackgroundWorkerMaxConcurrentJobs,
+		DEFAULT_BG_WORKER_MAX_CONCURRENT_JOBS, 0, INT_MAX,
+		PGC_SIGHUP,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.backgroundWorkerMaxActiveBackends", newGucPrefix),
+		gettext_noop(
+			"Number of active client backends above which non high priority background worker jobs are postponed, 0 disables the check."),
+		NULL, &BackgroundWorkerMaxActiveBackends,
+		DEFAULT_BG_WORKER_MAX_ACTIVE_BACKENDS, 0, INT_MAX,
+		PGC_SIGHUP,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.backgroundWorkerMaxIOWaitBackends", newGucPrefix),
+		gettext_noop(
+			"Number of active client backends waiting on IO above which non high priority background worker jobs are postponed, 0 disables the check."),
+		NULL, &BackgroundWorkerMaxIOWaitBackends,
+		DEFAULT_BG_WORKER_MAX_IO_WAIT_BACKENDS, 0, INT_MAX,
+		PGC_SIGHUP,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.backgroundWorkerMaxReplicationLagMs", newGucPrefix),
+		gettext_noop(
+			"Replication replay lag in milliseconds above which non high priority background worker jobs are postponed, 0 disables the check."),
+		NULL, &BackgroundWorkerMaxReplicationLagMs,
+		DEFAULT_BG_WORKER_MAX_REPLICATION_LAG_MS, 0, INT_MAX,
+		PGC_SIGHUP,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.backgroundWorkerMaxLoadDeferralSec", newGucPrefix),
+		gettext_noop(
+			"Maximum time in seconds a background worker job can be postponed due to foreground load before it runs regardless, 0 means no limit."),
+		NULL, &BackgroundWorkerMaxLoadDeferralSec,
+		DEFAULT_BG_WORKER_MAX_LOAD_DEFERRAL_SEC, 0, INT_MAX / 1000,
+		PGC_SIGHUP,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.compressionDictionaryRetrainIntervalSec", newGucPrefix),
+		gettext_noop(
+			"Interval in seconds after which the background worker retrains the compression dictionary of a collection, 0 disables retraining."),
+		NULL, &CompressionDictionaryRetrainIntervalSec,
+		DEFAULT_COMPRESSION_DICTIONARY_RETRAIN_INTERVAL_SEC, 0, INT_MAX,
+		PGC_SIGHUP,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.profilerFlushIntervalSec", newGucPrefix),
+		gettext_noop(
+			"Interval in seconds at which the background worker writes the profiled commands to system.profile. "
+			"The job is not started while no command was profiled since its last run."),
+		NULL, &DatabaseProfilerFlushIntervalSec,
+		DEFAULT_DATABASE_PROFILER_FLUSH_INTERVAL_SEC, 1, 3600,
+		PGC_SIGHUP,
+		0,
+		NULL, NULL, NULL);
 }
 
 
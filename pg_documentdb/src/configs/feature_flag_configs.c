@@ -83,6 +83,18 @@ bool DefaultUseCompositeOpClass = DEFAULT_USE_NEW_COMPOSITE_INDEX_OPCLASS;
 #define DEFAULT_ENABLE_COMPOSITE_INDEX_PLANNER false
 bool EnableCompositeIndexPlanner = DEFAULT_ENABLE_COMPOSITE_INDEX_PLANNER;
 
+#define DEFAULT_ENABLE_COMPOSITE_INDEX_SKIP_SCAN false
+bool EnableCompositeIndexSkipScan = DEFAULT_ENABLE_COMPOSITE_INDEX_SKIP_SCAN;
+
+#define DEFAULT_ENABLE_INDEX_DISTINCT_SCAN false
+bool EnableIndexDistinctScan = DEFAULT_ENABLE_INDEX_DISTINCT_SCAN;
+
+#define DEFAULT_ENABLE_GEOSPATIAL_CELL_INDEX false
+bool EnableGeospatialCellIndex = DEFAULT_ENABLE_GEOSPATIAL_CELL_INDEX;
+
+#define DEFAULT_ENABLE_GEOSPATIAL_PREPARED_QUERY true
+bool EnableGeospatialPreparedQuery = DEFAULT_ENABLE_GEOSPATIAL_PREPARED_QUERY;
+
 /* Ready to remove */
 #define DEFAULT_ENABLE_INDEX_ORDERBY_PUSHDOWN true
 bool EnableIndexOrderbyPushdown = DEFAULT_ENABLE_INDEX_ORDERBY_PUSHDOWN;
@@ -138,12 +150,19 @@ bool EnableCompositeShardDocumentTerms = DEFAULT_ENABLE_COMPOSITE_SHARD_DOCUMENT
 bool EnableCompositeWildcardSkipEmptyEntries =
 	DEFAULT_ENABLE_COMPOSITE_WILDCARD_SKIP_EMPTY_ENTRIES;
 
+#define DEFAULT_ENABLE_SHARED_HEAP_SCAN_INDEX_BUILD false
+bool EnableSharedHeapScanIndexBuild = DEFAULT_ENABLE_SHARED_HEAP_SCAN_INDEX_BUILD;
+
 /*
  * SECTION: Planner feature flags
  */
 #define DEFAULT_ENABLE_NEW_OPERATOR_SELECTIVITY false
 bool EnableNewOperatorSelectivityMode = DEFAULT_ENABLE_NEW_OPERATOR_SELECTIVITY;
 
+#define DEFAULT_ENABLE_BSON_PATH_STATISTICS_SELECTIVITY true
+bool EnableBsonPathStatisticsSelectivity =
+	DEFAULT_ENABLE_BSON_PATH_STATISTICS_SELECTIVITY;
+
 /* Remove after v109 */
 #define DEFAULT_LOOKUP_ENABLE_INNER_JOIN true
 bool EnableLookupInnerJoin = DEFAULT_LOOKUP_ENABLE_INNER_JOIN;
@@ -188,6 +207,15 @@ bool EnablePrimaryKeyCursorScan = DEFAULT_ENABLE_PRIMARY_KEY_CURSOR_SCAN;
 #define DEFAULT_ENABLE_CONTINUATION_FAST_BITMAP_LOOKUP false
 bool EnableContinuationFastBitmapLookup = DEFAULT_ENABLE_CONTINUATION_FAST_BITMAP_LOOKUP;
 
+#define DEFAULT_ENABLE_DATABASE_PROFILER true
+bool EnableDatabaseProfiler = DEFAULT_ENABLE_DATABASE_PROFILER;
+
+#define DEFAULT_ENABLE_QUERY_STATS false
+bool EnableQueryStats = DEFAULT_ENABLE_QUERY_STATS;
+
+#define DEFAULT_ENABLE_AGGREGATE_SPILL false
+bool EnableAggregateSpill = DEFAULT_ENABLE_AGGREGATE_SPILL;
+
 #define DEFAULT_USE_FILE_BASED_PERSISTED_CURSORS false
 bool UseFileBasedPersistedCursors = DEFAULT_USE_FILE_BASED_PERSISTED_CURSORS;
 
@@ -226,6 +254,10 @@ bool EnableUseForeignKeyLookupInline = DEFAULT_USE_FOREIGN_KEY_LOOKUP_INLINE;
 #define DEFAULT_ENABLE_ADD_TO_SET_AGGREGATION_REWRITE true
 bool EnableAddToSetAggregationRewrite = DEFAULT_ENABLE_ADD_TO_SET_AGGREGATION_REWRITE;
 
+#define DEFAULT_ENABLE_WINDOW_AGGREGATE_INVERSE_TRANSITION true
+bool EnableWindowAggregateInverseTransition =
+	DEFAULT_ENABLE_WINDOW_AGGREGATE_INVERSE_TRANSITION;
+
 /*
  * SECTION: Let support feature flags
  */
@@ -262,6 +294,12 @@ bool EnableCollationWithIndexes = DEFAULT_ENABLE_COLLATION_WITH_INDEXES;
 #define DEFAULT_RUM_FAIL_ON_LOST_PATH false
 bool RumFailOnLostPath = DEFAULT_RUM_FAIL_ON_LOST_PATH;
 
+#define DEFAULT_ENABLE_FIELD_NAME_DICTIONARY false
+bool EnableFieldNameDictionary = DEFAULT_ENABLE_FIELD_NAME_DICTIONARY;
+
+#define DEFAULT_ENABLE_DOCUMENT_COMPRESSION false
+bool EnableDocumentCompression = DEFAULT_ENABLE_DOCUMENT_COMPRESSION;
+
 
 /*
  * SECTION: Cluster administration & DDL feature flags
@@ -366,6 +404,14 @@ InitializeFeatureFlagConfigurations(const char *prefix, const char *newGucPrefix
 		DEFAULT_ENABLE_NEW_OPERATOR_SELECTIVITY,
 		PGC_USERSET, 0, NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		psprintf("%s.enableBsonPathStatisticsSelectivity", newGucPrefix),
+		gettext_noop(
+			"Determines whether the per path statistics ANALYZE collects are used for selectivity."),
+		NULL, &EnableBsonPathStatisticsSelectivity,
+		DEFAULT_ENABLE_BSON_PATH_STATISTICS_SELECTIVITY,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		psprintf("%s.enableSchemaValidation", prefix),
 		gettext_noop(
@@ -537,6 +583,38 @@ InitializeFeatureFlagConfigurations(const char *prefix, const char *newGucPrefix
 		NULL, &EnableCompositeIndexPlanner, DEFAULT_ENABLE_COMPOSITE_INDEX_PLANNER,
 		PGC_USERSET, 0, NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		psprintf("%s.enableCompositeIndexSkipScan", newGucPrefix),
+		gettext_noop(
+			"Whether to consider composite indexes for queries that don't filter on the first index path "
+			"by skipping over the distinct values of the leading path."),
+		NULL, &EnableCompositeIndexSkipScan, DEFAULT_ENABLE_COMPOSITE_INDEX_SKIP_SCAN,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enableIndexDistinctScan", newGucPrefix),
+		gettext_noop(
+			"Whether to answer distinct and simple $group queries on an indexed path "
+			"by walking the distinct keys of a composite index."),
+		NULL, &EnableIndexDistinctScan, DEFAULT_ENABLE_INDEX_DISTINCT_SCAN,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enableGeospatialCellIndex", newGucPrefix),
+		gettext_noop(
+			"Whether to build 2dsphere keys compounded with regular keys as cell terms "
+			"on the RUM index instead of rejecting the index."),
+		NULL, &EnableGeospatialCellIndex, DEFAULT_ENABLE_GEOSPATIAL_CELL_INDEX,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enableGeospatialPreparedQuery", newGucPrefix),
+		gettext_noop(
+			"Whether to prepare the query shape of $geoWithin and $geoIntersects once "
+			"per query and match document points against it without postgis."),
+		NULL, &EnableGeospatialPreparedQuery, DEFAULT_ENABLE_GEOSPATIAL_PREPARED_QUERY,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		psprintf("%s.enableIndexOrderbyPushdown", newGucPrefix),
 		gettext_noop(
@@ -598,6 +676,26 @@ InitializeFeatureFlagConfigurations(const char *prefix, const char *newGucPrefix
 		DEFAULT_RUM_FAIL_ON_LOST_PATH,
 		PGC_USERSET, 0, NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		psprintf("%s.enableFieldNameDictionary", newGucPrefix),
+		gettext_noop(
+			"Whether collections can store documents with field names encoded by a per collection dictionary."),
+		gettext_noop(
+			"Only collMod and writes depend on this: documents already stored encoded are decoded on read either way."),
+		&EnableFieldNameDictionary,
+		DEFAULT_ENABLE_FIELD_NAME_DICTIONARY,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enableDocumentCompression", newGucPrefix),
+		gettext_noop(
+			"Whether collections can store documents compressed with a trained per collection zstd dictionary."),
+		gettext_noop(
+			"Only collMod, writes and the retraining job depend on this: documents already stored compressed are decompressed on read either way."),
+		&EnableDocumentCompression,
+		DEFAULT_ENABLE_DOCUMENT_COMPRESSION,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		psprintf("%s.enableDelayedHoldPortal", newGucPrefix),
 		gettext_noop(
@@ -767,6 +865,15 @@ InitializeFeatureFlagConfigurations(const char *prefix, const char *newGucPrefix
 		DEFAULT_ENABLE_UNIQUE_REDUCED_CORRELATED_TERMS,
 		PGC_USERSET, 0, NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		psprintf("%s.enableSharedHeapScanIndexBuild", newGucPrefix),
+		gettext_noop(
+			"Whether indexes created together by a blocking createIndexes, or one run in a transaction block, are built from a single scan of the collection. "
+			"Indexes built from the background index queue are still built one scan per index."),
+		NULL, &EnableSharedHeapScanIndexBuild,
+		DEFAULT_ENABLE_SHARED_HEAP_SCAN_INDEX_BUILD,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		psprintf("%s.enableCompositeShardDocumentTerms", newGucPrefix),
 		gettext_noop(
@@ -816,6 +923,16 @@ InitializeFeatureFlagConfigurations(const char *prefix, const char *newGucPrefix
 		DEFAULT_ENABLE_ADD_TO_SET_AGGREGATION_REWRITE,
 		PGC_USERSET, 0, NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		psprintf("%s.enableWindowAggregateInverseTransition", newGucPrefix),
+		gettext_noop(
+			"Whether sliding window frames remove departing rows from $min, $max, $minN, "
+			"$maxN, $top, $bottom, $topN, $bottomN and $addToSet incrementally instead "
+			"of recomputing the whole frame."),
+		NULL, &EnableWindowAggregateInverseTransition,
+		DEFAULT_ENABLE_WINDOW_AGGREGATE_INVERSE_TRANSITION,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		psprintf("%s.inlineChangeStreamMatchStage", newGucPrefix),
 		gettext_noop(
@@ -839,4 +956,28 @@ InitializeFeatureFlagConfigurations(const char *prefix, const char *newGucPrefix
 		NULL, &EnableContinuationFastBitmapLookup,
 		DEFAULT_ENABLE_CONTINUATION_FAST_BITMAP_LOOKUP,
 		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enableDatabaseProfiler", newGucPrefix),
+		gettext_noop(
+			"Whether to capture the commands of databases with a profiling level in system.profile."),
+		NULL, &EnableDatabaseProfiler,
+		DEFAULT_ENABLE_DATABASE_PROFILER,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enableQueryStats", newGucPrefix),
+		gettext_noop(
+			"Whether to aggregate the execution statistics of commands per query shape for $queryStats."),
+		NULL, &EnableQueryStats,
+		DEFAULT_ENABLE_QUERY_STATS,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enableAggregateSpill", newGucPrefix),
+		gettext_noop(
+			"Whether $push and $addToSet in $group and $bucketAuto spill their state to temporary files when allowDiskUse is not false."),
+		NULL, &EnableAggregateSpill,
+		DEFAULT_ENABLE_AGGREGATE_SPILL,
+		PGC_USERSET, 0, NULL, NULL, NULL);
 }
@@ -154,6 +154,13 @@ int MaxAllowedCursorIntermediateFileSizeMB =
 #define DEFAULT_MAX_CURSOR_FILE_COUNT 5000
 int MaxCursorFileCount = DEFAULT_MAX_CURSOR_FILE_COUNT;
 
+/*
+ * An entry takes about 2kB of shared memory with its name entry, so the
+ * default reserves about 2MB at startup.
+ */
+#define DEFAULT_SHARED_COLLECTION_CACHE_MAX_ENTRIES 1024
+int SharedCollectionCacheMaxEntries = DEFAULT_SHARED_COLLECTION_CACHE_MAX_ENTRIES;
+
 /* Starting pg18 use documentdb_extended_rum for the rum library */
 #if PG_VERSION_NUM >= 180000
 #define DEFAULT_RUM_LIBRARY_LOAD_OPTION RumLibraryLoadOption_RequireDocumentDBRum
@@ -166,6 +173,30 @@ RumLibraryLoadOptions DocumentDBRumLibraryLoadOption = DEFAULT_RUM_LIBRARY_LOAD_
 #define DEFAULT_ENABLE_STATEMENT_TIMEOUT true
 bool EnableBackendStatementTimeout = DEFAULT_ENABLE_STATEMENT_TIMEOUT;
 
+#define DEFAULT_DOCUMENT_COMPRESSION_LEVEL 3
+int DocumentCompressionLevel = DEFAULT_DOCUMENT_COMPRESSION_LEVEL;
+
+#define DEFAULT_DOCUMENT_COMPRESSION_MIN_SIZE_BYTES 256
+int DocumentCompressionMinSizeBytes = DEFAULT_DOCUMENT_COMPRESSION_MIN_SIZE_BYTES;
+
+#define DEFAULT_PROFILER_RING_BUFFER_ENTRIES 1024
+int DatabaseProfilerRingBufferEntries = DEFAULT_PROFILER_RING_BUFFER_ENTRIES;
+
+#define DEFAULT_PROFILER_DEFAULT_SLOW_MS 100
+int DatabaseProfilerDefaultSlowMs = DEFAULT_PROFILER_DEFAULT_SLOW_MS;
+
+#define DEFAULT_PROFILER_CAPTURE_STAGE_TIMINGS true
+bool DatabaseProfilerCaptureStageTimings = DEFAULT_PROFILER_CAPTURE_STAGE_TIMINGS;
+
+#define DEFAULT_MAX_PROFILE_COLLECTION_DOCUMENTS 10000
+int MaxProfileCollectionDocuments = DEFAULT_MAX_PROFILE_COLLECTION_DOCUMENTS;
+
+#define DEFAULT_QUERY_STATS_MAX_ENTRIES 1000
+int QueryStatsMaxEntries = DEFAULT_QUERY_STATS_MAX_ENTRIES;
+
+#define DEFAULT_AGGREGATE_STATE_SPILL_THRESHOLD_MB 16
+int AggregateStateSpillThresholdMB = DEFAULT_AGGREGATE_STATE_SPILL_THRESHOLD_MB;
+
 static struct config_enum_entry rum_load_options[4] = {
 	{ "none", RumLibraryLoadOption_None, false },
 	{ "prefer_documentdb_extended_rum", RumLibraryLoadOption_PreferDocumentDBRum, false },
@@ -454,6 +485,15 @@ InitializeSystemConfigurations(const char *prefix, const char *newGucPrefix)
 		DEFAULT_MAX_CURSOR_FILE_COUNT, 0, INT_MAX,
 		PGC_USERSET, 0, NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		psprintf("%s.sharedCollectionCacheMaxEntries", newGucPrefix),
+		gettext_noop(
+			"Maximum number of collections kept in the shared memory collection metadata cache. "
+			"Index metadata is not shared. Set to 0 to disable the shared cache."),
+		NULL, &SharedCollectionCacheMaxEntries,
+		DEFAULT_SHARED_COLLECTION_CACHE_MAX_ENTRIES, 0, 1000000,
+		PGC_POSTMASTER, 0, NULL, NULL, NULL);
+
 	DefineCustomEnumVariable(
 		psprintf("%s.rum_library_load_option", newGucPrefix),
 		gettext_noop("Specifies the RUM library load option for DocumentDB."),
@@ -468,4 +508,68 @@ InitializeSystemConfigurations(const char *prefix, const char *newGucPrefix)
 			"Whether to enable per statement backend timeout override in the backend."),
 		NULL, &EnableBackendStatementTimeout, DEFAULT_ENABLE_STATEMENT_TIMEOUT,
 		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.documentCompressionLevel", newGucPrefix),
+		gettext_noop(
+			"The zstd level used to compress documents of collections with document compression."),
+		NULL, &DocumentCompressionLevel,
+		DEFAULT_DOCUMENT_COMPRESSION_LEVEL, 1, 19,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.documentCompressionMinSizeBytes", newGucPrefix),
+		gettext_noop(
+			"Documents smaller than this size are stored uncompressed in collections with document compression."),
+		NULL, &DocumentCompressionMinSizeBytes,
+		DEFAULT_DOCUMENT_COMPRESSION_MIN_SIZE_BYTES, 0, INT_MAX,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.profilerRingBufferEntries", newGucPrefix),
+		gettext_noop(
+			"The number of profiled commands kept in shared memory until they are written to system.profile, 0 disables the profiler."),
+		NULL, &DatabaseProfilerRingBufferEntries,
+		DEFAULT_PROFILER_RING_BUFFER_ENTRIES, 0, 1000000,
+		PGC_POSTMASTER, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.profilerDefaultSlowMs", newGucPrefix),
+		gettext_noop(
+			"The slowms threshold of databases whose profile command does not set one."),
+		NULL, &DatabaseProfilerDefaultSlowMs,
+		DEFAULT_PROFILER_DEFAULT_SLOW_MS, 0, INT_MAX,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.profilerCaptureStageTimings", newGucPrefix),
+		gettext_noop(
+			"Whether the profiler times each plan stage of profiled commands."),
+		NULL, &DatabaseProfilerCaptureStageTimings,
+		DEFAULT_PROFILER_CAPTURE_STAGE_TIMINGS,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.maxProfileCollectionDocuments", newGucPrefix),
+		gettext_noop(
+			"The number of most recent documents kept in the system.profile collection of a database."),
+		NULL, &MaxProfileCollectionDocuments,
+		DEFAULT_MAX_PROFILE_COLLECTION_DOCUMENTS, 1, INT_MAX,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.queryStatsMaxEntries", newGucPrefix),
+		gettext_noop(
+			"The number of query shapes whose statistics are kept in shared memory, 0 disables the query stats."),
+		NULL, &QueryStatsMaxEntries,
+		DEFAULT_QUERY_STATS_MAX_ENTRIES, 0, 100000,
+		PGC_POSTMASTER, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.aggregateStateSpillThresholdMB", newGucPrefix),
+		gettext_noop(
+			"The size of the values an accumulator keeps in memory before spilling them to a temporary file."),
+		NULL, &AggregateStateSpillThresholdMB,
+		DEFAULT_AGGREGATE_STATE_SPILL_THRESHOLD_MB, 1, 1024,
+		PGC_USERSET, 0, NULL, NULL, NULL);
 }
@@ -28,7 +28,10 @@
 #include "configs/config_initialization.h"
 #include "index_am/documentdb_rum.h"
 #include "infrastructure/cursor_store.h"
+#include "metadata/collection_shared_cache.h"
 #include "infrastructure/job_management.h"
+#include "infrastructure/database_profiler.h"
+#include "infrastructure/query_stats.h"
 #include "background_worker/background_worker_job.h"
 #include "index_am/roaring_bitmap_adapter.h"
 #include "utils/error_utils.h"
@@ -112,6 +115,8 @@ InstallDocumentDBApiPostgresHooks(void)
 	LoadRumRoutine();
 
 	SetupCursorStorage();
+
+	InstallDatabaseProfilerHooks();
 }
 
 
@@ -162,6 +167,8 @@ UninstallDocumentDBApiPostgresHooks(void)
 	get_relation_info_hook = ExtensionPreviousGetRelationInfoHook;
 	ExtensionPreviousGetRelationInfoHook = NULL;
 
+	UninstallDatabaseProfilerHooks();
+
 	UnregisterXactCallback(DocumentDBTransactionCallback, NULL);
 	UnregisterSubXactCallback(DocumentDBSubTransactionCallback, NULL);
 }
@@ -192,6 +199,17 @@ InitializeBackgroundWorkerJobAllowedCommands(void)
 		.name = "build_index_background", .schema = ApiInternalSchemaName
 	};
 	RegisterBackgroundWorkerJobAllowedCommand(buildIndexConcurrently);
+
+	BackgroundWorkerJobCommand trainCompressionDictionaries = {
+		.name = "train_compression_dictionaries_background",
+		.schema = ApiInternalSchemaName
+	};
+	RegisterBackgroundWorkerJobAllowedCommand(trainCompressionDictionaries);
+
+	BackgroundWorkerJobCommand flushProfileEntries = {
+		.name = "flush_profile_entries_background", .schema = ApiInternalSchemaName
+	};
+	RegisterBackgroundWorkerJobAllowedCommand(flushProfileEntries);
 }
 
 
@@ -202,6 +220,8 @@ void
 RegisterDocumentDBBackgroundWorkerJobs(void)
 {
 	RegisterIndexBuildBackgroundWorkerJobs();
+	RegisterCompressionDictionaryBackgroundWorkerJob();
+	RegisterDatabaseProfilerBackgroundWorkerJob();
 }
 
 
@@ -221,6 +241,10 @@ DocumentDBSharedMemoryRequest(void)
 	RequestAddinShmemSpace(SharedFeatureCounterShmemSize());
 	RequestAddinShmemSpace(VersionCacheShmemSize());
 	RequestAddinShmemSpace(FileCursorShmemSize());
+	RequestAddinShmemSpace(SharedCollectionCacheShmemSize());
+	RequestAddinShmemSpace(BackgroundWorkerShmemSize());
+	RequestAddinShmemSpace(DatabaseProfilerShmemSize());
+	RequestAddinShmemSpace(QueryStatsShmemSize());
 }
 
 
@@ -231,6 +255,10 @@ DocumentDBSharedMemoryInit(void)
 	SharedFeatureCounterShmemInit();
 	InitializeVersionCache();
 	InitializeFileCursorShmem();
+	InitializeSharedCollectionCacheShmem();
+	BackgroundWorkerShmemInit();
+	InitializeDatabaseProfilerShmem();
+	InitializeQueryStatsShmem();
 
 	if (prev_shmem_startup_hook != NULL)
 	{
@@ -244,11 +272,30 @@ DocumentDBTransactionCallback(XactEvent event, void *arg)
 {
 	switch (event)
 	{
+		case XACT_EVENT_COMMIT:
+		{
+			AtEOXactSharedCollectionCache(true);
+			break;
+		}
+
+		case XACT_EVENT_PRE_PREPARE:
+		{
+			AtPrePrepareSharedCollectionCache();
+			break;
+		}
+
+		case XACT_EVENT_PREPARE:
+		{
+			AtPrepareSharedCollectionCache();
+			break;
+		}
+
 		case XACT_EVENT_ABORT:
 		case XACT_EVENT_PARALLEL_ABORT:
 		{
 			ConnMgrTryCancelActiveConnection();
 			DeletePendingCursorFiles();
+			AtEOXactSharedCollectionCache(false);
 			break;
 		}
 
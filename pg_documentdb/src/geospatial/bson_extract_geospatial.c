@@ -19,6 +19,7 @@
 #include "geospatial/bson_geospatial_common.h"
 #include "geospatial/bson_geospatial_private.h"
 #include "utils/list_utils.h"
+#include "metadata/collection_field_dictionary.h"
 
 PG_FUNCTION_INFO_V1(bson_extract_geometry);
 PG_FUNCTION_INFO_V1(bson_extract_geometry_array);
@@ -36,7 +37,7 @@ PG_FUNCTION_INFO_V1(bson_validate_geography);
 Datum
 bson_extract_geometry(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON_PACKED(0);
 	text *path = PG_GETARG_TEXT_P(1);
 	StringView pathView = CreateStringViewFromText(path);
 	Datum geometryDatum = BsonExtractGeometryStrict(document, &pathView);
@@ -69,7 +70,7 @@ bson_extract_geometry_array(PG_FUNCTION_ARGS)
 Datum
 bson_extract_geometry_runtime(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	text *path = PG_GETARG_TEXT_P(1);
 	StringView pathView = CreateStringViewFromText(path);
 	Datum geometryRuntimeDatum = BsonExtractGeometryRuntime(document, &pathView);
@@ -111,7 +112,7 @@ bson_extract_geometry_runtime(PG_FUNCTION_ARGS)
 Datum
 bson_validate_geometry(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	text *path = PG_GETARG_TEXT_P(1);
 	StringView pathView = CreateStringViewFromText(path);
 
@@ -163,7 +164,7 @@ bson_validate_geometry(PG_FUNCTION_ARGS)
 Datum
 bson_validate_geography(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	text *path = PG_GETARG_TEXT_P(1);
 	StringView pathView = CreateStringViewFromText(path);
 
@@ -0,0 +1,382 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/geospatial/bson_geospatial_cells.c
+ *
+ * Hierarchical cell decomposition of the sphere used to build index terms
+ * for 2dsphere indexes on the RUM access method.
+ *
+ * The sphere is projected on the 6 faces of the enclosing cube, a point belongs
+ * to the face of its largest (absolute) geocentric coordinate and is projected to
+ * (u, v) in [-1, 1] x [-1, 1] by dividing the 2 other coordinates by it. Each face
+ * is a quadtree: a cell of level L is split in 4 cells of level L + 1 and the cell
+ * ids are laid out in the Z-order of the quadrants so that all the descendants of a
+ * cell are a contiguous range of ids. A geography indexed with a set of cells and a
+ * query covered with another set intersect only if a cell of one of the sets is an
+ * ancestor of (or equal to) a cell of the other one, which is what the index scans.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "access/gist.h"
+#include "fmgr.h"
+#include "math.h"
+#include "port/pg_bitutils.h"
+
+#include "geospatial/bson_geospatial_cells.h"
+#include "metadata/metadata_cache.h"
+
+/* Number of cells along a face side at GEO_CELL_MAX_LEVEL */
+#define GEO_CELL_MAX_SIZE (UINT64CONST(1) << GEO_CELL_MAX_LEVEL)
+
+/* Position of the face bits in the cell id */
+#define GEO_CELL_FACE_SHIFT (2 * GEO_CELL_MAX_LEVEL + 1)
+
+/*
+ * A point on the unit sphere has its largest coordinate at least 1/sqrt(3) in absolute
+ * value, boxes that do not reach that far on an axis do not touch the faces of that axis.
+ * The bound is lowered slightly so that rounding only ever widens the covering.
+ */
+#define GEO_CELL_FACE_MIN_MAJOR (0.57735026918962576 - 1e-9)
+
+/* Slack added to the face coordinates of boxes to absorb rounding */
+#define GEO_CELL_UV_EPSILON 1e-12
+
+
+/*
+ * This is a copy of the GIDX structure that Postgis uses to store the n-dimensional
+ * bounding boxes of geographies, we define it here to extract the geocentric box
+ * from the compressed index key.
+ */
+typedef struct BSON_GIDX
+{
+	/* varlena header */
+	int32 varsize;
+
+	/* min and max of each dimension, interleaved */
+	float c[FLEXIBLE_ARRAY_MEMBER];
+} BSON_GIDX;
+
+#define BSON_GIDX_NDIMS(gidx) ((VARSIZE(gidx) - VARHDRSZ) / (2 * sizeof(float)))
+
+
+/* The part of a face a box projects to, in GEO_CELL_MAX_LEVEL cell coordinates */
+typedef struct FaceRect
+{
+	bool isValid;
+	uint32 iMin;
+	uint32 iMax;
+	uint32 jMin;
+	uint32 jMax;
+} FaceRect;
+
+/* A cell while it is being refined */
+typedef struct CellCandidate
+{
+	int face;
+	int level;
+	uint32 i;
+	uint32 j;
+} CellCandidate;
+
+
+static bool GetFaceRect(const GeoCellBox *box, int face, FaceRect *rect);
+static int GetFaceRectCandidates(const FaceRect *rect, int face, int maxLevel,
+								 CellCandidate *candidates);
+static int GetIntersectingChildren(const CellCandidate *cell, const FaceRect *rect,
+								   CellCandidate *children);
+static uint64 GeoCellIdFromCandidate(const CellCandidate *cell);
+
+
+int
+GeoCellLevel(uint64 cellId)
+{
+	return (2 * GEO_CELL_MAX_LEVEL - pg_rightmost_one_pos64(cellId)) / 2;
+}
+
+
+uint64
+GeoCellParent(uint64 cellId)
+{
+	uint64 lsb = cellId & (~cellId + 1);
+	uint64 parentLsb = lsb << 2;
+	return (cellId & (~parentLsb + 1)) | parentLsb;
+}
+
+
+uint64
+GeoCellRangeMin(uint64 cellId)
+{
+	uint64 lsb = cellId & (~cellId + 1);
+	return cellId - (lsb - 1);
+}
+
+
+uint64
+GeoCellRangeMax(uint64 cellId)
+{
+	uint64 lsb = cellId & (~cellId + 1);
+	return cellId + (lsb - 1);
+}
+
+
+int
+GetGeoCellCoveringForSphere(uint64 *cells)
+{
+	for (int face = 0; face < GEO_CELL_NUM_FACES; face++)
+	{
+		CellCandidate faceCell = { .face = face, .level = 0, .i = 0, .j = 0 };
+		cells[face] = GeoCellIdFromCandidate(&faceCell);
+	}
+
+	return GEO_CELL_NUM_FACES;
+}
+
+
+/*
+ * The covering starts, on every face the box touches, with the (at most 4) cells of the
+ * finest level at which the box spans no more than 2 cells per axis. The coarsest cell
+ * is then repeatedly replaced by its children that intersect the box as long as that
+ * keeps the covering within maxCells, which tightens the covering where it matters most.
+ */
+int
+GetGeoCellCoveringForBox(const GeoCellBox *box, int maxCells, int maxLevel,
+						 uint64 *cells)
+{
+	maxLevel = Max(0, Min(maxLevel, GEO_CELL_MAX_LEVEL));
+	maxCells = Max(1, maxCells);
+
+	FaceRect rects[GEO_CELL_NUM_FACES];
+	CellCandidate *candidates = palloc(sizeof(CellCandidate) *
+									   Max(maxCells, 4 * GEO_CELL_NUM_FACES));
+	int numCandidates = 0;
+	for (int face = 0; face < GEO_CELL_NUM_FACES; face++)
+	{
+		if (GetFaceRect(box, face, &rects[face]))
+		{
+			numCandidates += GetFaceRectCandidates(&rects[face], face, maxLevel,
+												   &candidates[numCandidates]);
+		}
+	}
+
+	while (numCandidates > 0)
+	{
+		int coarsest = -1;
+		for (int i = 0; i < numCandidates; i++)
+		{
+			if (candidates[i].level < maxLevel &&
+				(coarsest < 0 || candidates[i].level < candidates[coarsest].level))
+			{
+				coarsest = i;
+			}
+		}
+
+		if (coarsest < 0)
+		{
+			break;
+		}
+
+		CellCandidate children[4];
+		int numChildren = GetIntersectingChildren(&candidates[coarsest],
+												  &rects[candidates[coarsest].face],
+												  children);
+		if (numCandidates - 1 + numChildren > maxCells)
+		{
+			break;
+		}
+
+		candidates[coarsest] = children[0];
+		for (int i = 1; i < numChildren; i++)
+		{
+			candidates[numCandidates++] = children[i];
+		}
+	}
+
+	for (int i = 0; i < numCandidates; i++)
+	{
+		cells[i] = GeoCellIdFromCandidate(&candidates[i]);
+	}
+
+	pfree(candidates);
+	return numCandidates;
+}
+
+
+/*
+ * Gets the geocentric bounding box Postgis computes for the geography, which accounts
+ * for the curvature of the edges, by running the Postgis GIST compress function on it.
+ */
+bool
+GetGeographyGeoCellBox(Datum geography, GeoCellBox *box)
+{
+	GISTENTRY entry;
+	gistentryinit(entry, geography, NULL, NULL, (OffsetNumber) 0, true);
+
+	GISTENTRY *result = (GISTENTRY *) DatumGetPointer(
+		OidFunctionCall1(PostgisGeographyGistCompressFunctionId(),
+						 PointerGetDatum(&entry)));
+	if (result == NULL || DatumGetPointer(result->key) == NULL)
+	{
+		return false;
+	}
+
+	BSON_GIDX *gidx = (BSON_GIDX *) DatumGetPointer(result->key);
+	if (BSON_GIDX_NDIMS(gidx) < 3)
+	{
+		/* Postgis uses a dimensionless box for empty and invalid geographies */
+		return false;
+	}
+
+	for (int dim = 0; dim < 3; dim++)
+	{
+		box->min[dim] = gidx->c[2 * dim];
+		box->max[dim] = gidx->c[2 * dim + 1];
+		if (isnan(box->min[dim]) || isnan(box->max[dim]) ||
+			box->min[dim] > box->max[dim])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * Computes the range of face coordinates the points of the box that belong to the face
+ * can project to. The range is conservative: it may include points of other faces or
+ * outside the sphere but never misses a point of the face.
+ */
+static bool
+GetFaceRect(const GeoCellBox *box, int face, FaceRect *rect)
+{
+	int axis = face % 3;
+	bool isNegative = face >= 3;
+
+	double majorMin = isNegative ? -box->max[axis] : box->min[axis];
+	double majorMax = isNegative ? -box->min[axis] : box->max[axis];
+	majorMin = Max(majorMin, GEO_CELL_FACE_MIN_MAJOR);
+	majorMax = Min(majorMax, 1.0);
+
+	rect->isValid = false;
+	if (majorMin > majorMax)
+	{
+		return false;
+	}
+
+	double uvMin[2];
+	double uvMax[2];
+	for (int k = 0; k < 2; k++)
+	{
+		int minorAxis = (axis + 1 + k) % 3;
+		double minorMin = box->min[minorAxis];
+		double minorMax = box->max[minorAxis];
+
+		/* Dividing by the major coordinate pushes values away from 0 the most at its minimum */
+		uvMin[k] = minorMin >= 0 ? minorMin / majorMax : minorMin / majorMin;
+		uvMax[k] = minorMax >= 0 ? minorMax / majorMin : minorMax / majorMax;
+		uvMin[k] = Max(uvMin[k] - GEO_CELL_UV_EPSILON, -1.0);
+		uvMax[k] = Min(uvMax[k] + GEO_CELL_UV_EPSILON, 1.0);
+		if (uvMin[k] > uvMax[k])
+		{
+			return false;
+		}
+	}
+
+	double scale = (double) GEO_CELL_MAX_SIZE / 2;
+	uint64 maxCoordinate = GEO_CELL_MAX_SIZE - 1;
+	rect->iMin = (uint32) Min((uint64) floor((uvMin[0] + 1) * scale), maxCoordinate);
+	rect->iMax = (uint32) Min((uint64) floor((uvMax[0] + 1) * scale), maxCoordinate);
+	rect->jMin = (uint32) Min((uint64) floor((uvMin[1] + 1) * scale), maxCoordinate);
+	rect->jMax = (uint32) Min((uint64) floor((uvMax[1] + 1) * scale), maxCoordinate);
+	rect->isValid = true;
+	return true;
+}
+
+
+/*
+ * Writes the cells of the finest level (up to maxLevel) at which the rect spans at
+ * most 2 cells on each axis.
+ */
+static int
+GetFaceRectCandidates(const FaceRect *rect, int face, int maxLevel,
+					  CellCandidate *candidates)
+{
+	int level = maxLevel;
+	int shift = GEO_CELL_MAX_LEVEL - level;
+	while (level > 0 &&
+		   ((rect->iMax >> shift) - (rect->iMin >> shift) > 1 ||
+			(rect->jMax >> shift) - (rect->jMin >> shift) > 1))
+	{
+		level--;
+		shift++;
+	}
+
+	int numCandidates = 0;
+	for (uint32 i = rect->iMin >> shift; i <= rect->iMax >> shift; i++)
+	{
+		for (uint32 j = rect->jMin >> shift; j <= rect->jMax >> shift; j++)
+		{
+			CellCandidate *candidate = &candidates[numCandidates++];
+			candidate->face = face;
+			candidate->level = level;
+			candidate->i = i;
+			candidate->j = j;
+		}
+	}
+
+	return numCandidates;
+}
+
+
+static int
+GetIntersectingChildren(const CellCandidate *cell, const FaceRect *rect,
+						CellCandidate *children)
+{
+	int childLevel = cell->level + 1;
+	int shift = GEO_CELL_MAX_LEVEL - childLevel;
+	int numChildren = 0;
+	for (uint32 i = 2 * cell->i; i <= 2 * cell->i + 1; i++)
+	{
+		if (i < (rect->iMin >> shift) || i > (rect->iMax >> shift))
+		{
+			continue;
+		}
+
+		for (uint32 j = 2 * cell->j; j <= 2 * cell->j + 1; j++)
+		{
+			if (j < (rect->jMin >> shift) || j > (rect->jMax >> shift))
+			{
+				continue;
+			}
+
+			CellCandidate *child = &children[numChildren++];
+			child->face = cell->face;
+			child->level = childLevel;
+			child->i = i;
+			child->j = j;
+		}
+	}
+
+	return numChildren;
+}
+
+
+static uint64
+GeoCellIdFromCandidate(const CellCandidate *cell)
+{
+	/* Interleave the bits of i and j, most significant quadrant first */
+	uint64 position = 0;
+	for (int bit = cell->level - 1; bit >= 0; bit--)
+	{
+		position = (position << 2) |
+				   (((uint64) (cell->i >> bit) & 1) << 1) |
+				   ((uint64) (cell->j >> bit) & 1);
+	}
+
+	int sentinelShift = 2 * (GEO_CELL_MAX_LEVEL - cell->level);
+	return ((uint64) cell->face << GEO_CELL_FACE_SHIFT) |
+		   (position << (sentinelShift + 1)) |
+		   (UINT64CONST(1) << sentinelShift);
+}
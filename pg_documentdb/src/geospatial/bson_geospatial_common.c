@@ -340,8 +340,7 @@ SetQueryMatcherResult(ProcessCommonGeospatialState *state)
 	if (!isMatched)
 	{
 		/* Reset the buffer for next multikey value */
-		DeepFreeWKB(state->WKBBuffer);
-		state->WKBBuffer = makeStringInfo();
+		resetStringInfo(state->WKBBuffer);
 	}
 }
 
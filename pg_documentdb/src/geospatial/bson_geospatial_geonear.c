@@ -30,6 +30,7 @@
 #include "utils/fmgr_utils.h"
 #include "utils/version_utils.h"
 #include "aggregation/bson_aggregation_pipeline_private.h"
+#include "metadata/collection_field_dictionary.h"
 
 static bool GeonearDistanceWithinRange(const GeonearDistanceState *state,
 									   const pgbson *document);
@@ -61,7 +62,7 @@ PG_FUNCTION_INFO_V1(bson_geonear_within_range);
 Datum
 bson_geonear_distance(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON_PACKED(0);
 	const pgbson *queryBson = PG_GETARG_PGBSON_PACKED(1);
 
 	const GeonearDistanceState *state;
@@ -95,7 +96,7 @@ bson_geonear_distance(PG_FUNCTION_ARGS)
 Datum
 bson_geonear_within_range(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON_PACKED(0);
 	const pgbson *queryBson = PG_GETARG_PGBSON_PACKED(1);
 
 	const GeonearDistanceState *state;
@@ -0,0 +1,606 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/geospatial/bson_geospatial_prepared_query.c
+ *
+ * Implementation of the prepared query shapes for $geoWithin and $geoIntersects.
+ *
+ * Runtime matching evaluates a postgis predicate per document value, which means
+ * converting the WKB of the value to a postgis datum and running the generic predicate
+ * against the whole query shape. The query shape is instead prepared once per query:
+ *
+ * - Every shape keeps its bounds, points outside of them can never match.
+ * - Flat polygons ($box and $polygon) keep their edges bucketed by horizontal bands,
+ *   so that a point in polygon test only looks at the edges of the point's band.
+ * - $center keeps the circle.
+ *
+ * Points read straight from the WKB buffer the document traversal produces are then
+ * decided without postgis, unless they lie too close to the boundary of the shape
+ * for the floating point result to be trusted, in which case postgis decides.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "math.h"
+
+#include "geospatial/bson_geospatial_cells.h"
+#include "geospatial/bson_geospatial_common.h"
+#include "geospatial/bson_geospatial_prepared_query.h"
+#include "geospatial/bson_geospatial_wkb_iterator.h"
+#include "metadata/metadata_cache.h"
+
+/* Tolerance relative to the extent of the shape under which postgis decides the match */
+#define PREPARED_QUERY_RELATIVE_EPSILON 1e-9
+
+/* Tolerance on the geocentric bounding box of spherical shapes */
+#define PREPARED_QUERY_GEOCENTRIC_EPSILON 1e-9
+
+/* Upper bound on the number of bands of the edge index */
+#define PREPARED_QUERY_MAX_BANDS 4096
+
+/* Edges are copied to every band they span, this bounds the copies per edge on average */
+#define PREPARED_QUERY_MAX_COPIES_PER_EDGE 8
+
+
+/*
+ * Kind of the prepared query shape
+ */
+typedef enum PreparedShapeKind
+{
+	/* Only the bounds of the shape are known */
+	PreparedShapeKind_Bounds = 0,
+
+	/* A flat polygon or multi polygon with its edge index */
+	PreparedShapeKind_Polygon,
+
+	/* A flat circle */
+	PreparedShapeKind_Circle,
+
+	/* A spherical shape with its geocentric bounding box */
+	PreparedShapeKind_Geocentric,
+} PreparedShapeKind;
+
+
+typedef struct PreparedEdge
+{
+	double x1;
+	double y1;
+	double x2;
+	double y2;
+} PreparedEdge;
+
+
+struct PreparedGeospatialQuery
+{
+	PreparedShapeKind kind;
+
+	/* Flat bounds of the shape */
+	double minX;
+	double minY;
+	double maxX;
+	double maxY;
+
+	/* Absolute tolerance for flat shapes */
+	double epsilon;
+
+	/* Geocentric bounding box of spherical shapes */
+	GeoCellBox geocentricBox;
+
+	/* Center and radius of the circle */
+	Point center;
+	double radius;
+
+	/*
+	 * The edge index of polygons, edges of band i are
+	 * bandEdges[bandOffsets[i]] ... bandEdges[bandOffsets[i + 1] - 1]
+	 */
+	int32 numBands;
+	double bandHeight;
+	int32 *bandOffsets;
+	PreparedEdge *bandEdges;
+};
+
+
+/*
+ * State to collect the points and the edges of a flat query shape
+ */
+typedef struct CollectShapeState
+{
+	PreparedGeospatialQuery *query;
+
+	/* Whether all the geometries of the shape are polygons */
+	bool isPolygonal;
+
+	/* Whether any point was found */
+	bool hasPoints;
+
+	PreparedEdge *edges;
+	int32 numEdges;
+	int32 maxEdges;
+} CollectShapeState;
+
+
+static bool PrepareFlatShape(PreparedGeospatialQuery *query, Datum queryDatum);
+static void BuildEdgeIndex(PreparedGeospatialQuery *query, PreparedEdge *edges,
+						   int32 numEdges);
+static int32 CountBandEdges(const PreparedGeospatialQuery *query, PreparedEdge *edges,
+							int32 numEdges, int32 numBands, double bandHeight,
+							int32 *bandCounts);
+static PreparedGeospatialMatch MatchPointInPolygon(const PreparedGeospatialQuery *query,
+												   const Point *point);
+static PreparedGeospatialMatch MatchPointInCircle(const PreparedGeospatialQuery *query,
+												  const Point *point);
+static PreparedGeospatialMatch MatchPointInGeocentricBox(const
+														 PreparedGeospatialQuery *query,
+														 const Point *point);
+
+static void CollectShapeGeometry(const WKBGeometryConst *geometryConst, void *state);
+static void CollectShapePoint(const WKBGeometryConst *pointConst, void *state);
+static void CollectShapeRing(const WKBGeometryConst *ringConst, void *state);
+
+
+/*
+ * Collects the bounds and polygon edges of a flat query shape
+ */
+static const WKBVisitorFunctions CollectShapeVisitorFuncs = {
+	.ContinueTraversal = NULL,
+	.VisitEachPoint = CollectShapePoint,
+	.VisitGeometry = CollectShapeGeometry,
+	.VisitSingleGeometry = CollectShapeGeometry,
+	.VisitPolygonRing = CollectShapeRing
+};
+
+
+/*
+ * Prepares the query shape of a $geoWithin or $geoIntersects query. Returns NULL
+ * if the shape has nothing to prepare, in which case all the values are matched
+ * with postgis.
+ */
+PreparedGeospatialQuery *
+PrepareGeospatialQuery(const ShapeOperatorInfo *opInfo, bool isSpherical,
+					   Datum queryDatum)
+{
+	if (opInfo == NULL || queryDatum == (Datum) 0)
+	{
+		return NULL;
+	}
+
+	if (opInfo->op == GeospatialShapeOperator_CENTERSPHERE)
+	{
+		/* The points of $centerSphere are already matched by their distance to the center */
+		return NULL;
+	}
+
+	PreparedGeospatialQuery *query = palloc0(sizeof(PreparedGeospatialQuery));
+	if (isSpherical)
+	{
+		query->kind = PreparedShapeKind_Geocentric;
+		if (!GetGeographyGeoCellBox(queryDatum, &query->geocentricBox))
+		{
+			pfree(query);
+			return NULL;
+		}
+
+		return query;
+	}
+
+	if (!PrepareFlatShape(query, queryDatum))
+	{
+		pfree(query);
+		return NULL;
+	}
+
+	if (opInfo->op == GeospatialShapeOperator_CENTER)
+	{
+		DollarCenterOperatorState *centerState =
+			(DollarCenterOperatorState *) opInfo->opState;
+		if (centerState == NULL || centerState->isRadiusInfinite)
+		{
+			pfree(query);
+			return NULL;
+		}
+
+		query->kind = PreparedShapeKind_Circle;
+		query->center.x = query->minX;
+		query->center.y = query->minY;
+		query->radius = centerState->radius;
+		query->epsilon = PREPARED_QUERY_RELATIVE_EPSILON *
+						 Max(Max(1.0, query->radius),
+							 Max(fabs(query->center.x), fabs(query->center.y)));
+	}
+
+	return query;
+}
+
+
+/*
+ * Matches a document value given as a WKB buffer against the prepared query.
+ * Only single points are decided here, any other geometry is left to postgis.
+ */
+PreparedGeospatialMatch
+MatchPreparedGeospatialQuery(const PreparedGeospatialQuery *query,
+							 const StringInfo documentWKB)
+{
+	if (query == NULL ||
+		documentWKB->len != WKB_BYTE_SIZE_ORDER + WKB_BYTE_SIZE_TYPE +
+		WKB_BYTE_SIZE_POINT)
+	{
+		return PreparedGeospatialMatch_Unknown;
+	}
+
+	WKBGeometryType wkbType = WKBGeometryType_Invalid;
+	memcpy(&wkbType, documentWKB->data + WKB_BYTE_SIZE_ORDER, WKB_BYTE_SIZE_TYPE);
+	if (wkbType != WKBGeometryType_Point)
+	{
+		return PreparedGeospatialMatch_Unknown;
+	}
+
+	Point point;
+	memcpy(&point, documentWKB->data + WKB_BYTE_SIZE_ORDER + WKB_BYTE_SIZE_TYPE,
+		   WKB_BYTE_SIZE_POINT);
+
+	if (isnan(point.x) || isnan(point.y))
+	{
+		return PreparedGeospatialMatch_Unknown;
+	}
+
+	switch (query->kind)
+	{
+		case PreparedShapeKind_Geocentric:
+		{
+			return MatchPointInGeocentricBox(query, &point);
+		}
+
+		case PreparedShapeKind_Circle:
+		{
+			return MatchPointInCircle(query, &point);
+		}
+
+		case PreparedShapeKind_Polygon:
+		case PreparedShapeKind_Bounds:
+		{
+			if (point.x < query->minX - query->epsilon ||
+				point.x > query->maxX + query->epsilon ||
+				point.y < query->minY - query->epsilon ||
+				point.y > query->maxY + query->epsilon)
+			{
+				return PreparedGeospatialMatch_NotMatched;
+			}
+
+			return query->kind == PreparedShapeKind_Polygon ?
+				   MatchPointInPolygon(query, &point) :
+				   PreparedGeospatialMatch_Unknown;
+		}
+
+		default:
+		{
+			return PreparedGeospatialMatch_Unknown;
+		}
+	}
+}
+
+
+/*
+ * Walks the WKB of a flat query shape to find its bounds and, for polygons, builds
+ * the edge index. Returns false if the shape has no points.
+ */
+static bool
+PrepareFlatShape(PreparedGeospatialQuery *query, Datum queryDatum)
+{
+	bytea *wkbBytea = DatumGetByteaP(OidFunctionCall1(PostgisGeometryAsBinaryFunctionId(),
+													  queryDatum));
+
+	CollectShapeState state;
+	memset(&state, 0, sizeof(CollectShapeState));
+	state.query = query;
+	state.isPolygonal = true;
+	state.maxEdges = 16;
+	state.edges = palloc(state.maxEdges * sizeof(PreparedEdge));
+
+	query->kind = PreparedShapeKind_Bounds;
+	query->minX = query->minY = INFINITY;
+	query->maxX = query->maxY = -INFINITY;
+
+	TraverseWKBBytea(wkbBytea, &CollectShapeVisitorFuncs, &state);
+	pfree(wkbBytea);
+
+	if (!state.hasPoints || !isfinite(query->minX) || !isfinite(query->minY) ||
+		!isfinite(query->maxX) || !isfinite(query->maxY))
+	{
+		pfree(state.edges);
+		return false;
+	}
+
+	query->epsilon = PREPARED_QUERY_RELATIVE_EPSILON *
+					 Max(Max(1.0, Max(fabs(query->minX), fabs(query->maxX))),
+						 Max(fabs(query->minY), fabs(query->maxY)));
+
+	if (state.isPolygonal && state.numEdges > 0)
+	{
+		BuildEdgeIndex(query, state.edges, state.numEdges);
+	}
+
+	pfree(state.edges);
+	return true;
+}
+
+
+/*
+ * Buckets the polygon edges into horizontal bands of equal height. An edge is added to
+ * every band its y range (widened by the tolerance) overlaps, the number of bands is
+ * reduced if long edges would make the index too large.
+ */
+static void
+BuildEdgeIndex(PreparedGeospatialQuery *query, PreparedEdge *edges, int32 numEdges)
+{
+	double height = query->maxY - query->minY;
+	int32 numBands = Min(Max(numEdges / 2, 1), PREPARED_QUERY_MAX_BANDS);
+	if (!(height > 0) || !isfinite(height))
+	{
+		numBands = 1;
+	}
+
+	int32 *bandCounts = palloc((numBands + 1) * sizeof(int32));
+	int32 maxTotal = numEdges * PREPARED_QUERY_MAX_COPIES_PER_EDGE;
+	double bandHeight;
+	int32 total;
+	while (true)
+	{
+		bandHeight = numBands > 1 ? height / numBands : INFINITY;
+		total = CountBandEdges(query, edges, numEdges, numBands, bandHeight, bandCounts);
+		if (total <= maxTotal || numBands == 1)
+		{
+			break;
+		}
+
+		numBands = Max(numBands / 2, 1);
+	}
+
+	query->numBands = numBands;
+	query->bandHeight = bandHeight;
+	query->bandOffsets = palloc((numBands + 1) * sizeof(int32));
+	query->bandEdges = palloc(Max(total, 1) * sizeof(PreparedEdge));
+
+	query->bandOffsets[0] = 0;
+	for (int32 band = 0; band < numBands; band++)
+	{
+		query->bandOffsets[band + 1] = query->bandOffsets[band] + bandCounts[band];
+
+		/* Reuse the counts as the insert positions */
+		bandCounts[band] = query->bandOffsets[band];
+	}
+
+	for (int32 i = 0; i < numEdges; i++)
+	{
+		double edgeMinY = Min(edges[i].y1, edges[i].y2) - query->epsilon;
+		double edgeMaxY = Max(edges[i].y1, edges[i].y2) + query->epsilon;
+
+		int32 firstBand = 0, lastBand = numBands - 1;
+		if (numBands > 1)
+		{
+			firstBand = (int32) Max(0, floor((edgeMinY - query->minY) / bandHeight));
+			lastBand = (int32) Min(numBands - 1, floor((edgeMaxY - query->minY) /
+													   bandHeight));
+		}
+
+		for (int32 band = firstBand; band <= lastBand; band++)
+		{
+			query->bandEdges[bandCounts[band]++] = edges[i];
+		}
+	}
+
+	pfree(bandCounts);
+	query->kind = PreparedShapeKind_Polygon;
+}
+
+
+/*
+ * Counts the edges of each band for the given band layout and returns the total
+ */
+static int32
+CountBandEdges(const PreparedGeospatialQuery *query, PreparedEdge *edges, int32 numEdges,
+			   int32 numBands, double bandHeight, int32 *bandCounts)
+{
+	memset(bandCounts, 0, numBands * sizeof(int32));
+
+	int32 total = 0;
+	for (int32 i = 0; i < numEdges; i++)
+	{
+		int32 firstBand = 0, lastBand = numBands - 1;
+		if (numBands > 1)
+		{
+			double edgeMinY = Min(edges[i].y1, edges[i].y2) - query->epsilon;
+			double edgeMaxY = Max(edges[i].y1, edges[i].y2) + query->epsilon;
+			firstBand = (int32) Max(0, floor((edgeMinY - query->minY) / bandHeight));
+			lastBand = (int32) Min(numBands - 1, floor((edgeMaxY - query->minY) /
+													   bandHeight));
+		}
+
+		for (int32 band = firstBand; band <= lastBand; band++)
+		{
+			bandCounts[band]++;
+		}
+
+		total += lastBand - firstBand + 1;
+	}
+
+	return total;
+}
+
+
+/*
+ * Even-odd point in polygon test over the edges of the point's band. The rings of
+ * a valid polygon or multi polygon don't cross, so the parity of the edges crossed by
+ * a ray going right from the point tells whether it is inside. Points within the
+ * tolerance of an edge are left to postgis, which treats the boundary as covered.
+ */
+static PreparedGeospatialMatch
+MatchPointInPolygon(const PreparedGeospatialQuery *query, const Point *point)
+{
+	int32 band = 0;
+	if (query->numBands > 1)
+	{
+		band = (int32) floor((point->y - query->minY) / query->bandHeight);
+		band = Max(0, Min(query->numBands - 1, band));
+	}
+
+	double epsilon = query->epsilon;
+	bool isInside = false;
+	for (int32 i = query->bandOffsets[band]; i < query->bandOffsets[band + 1]; i++)
+	{
+		const PreparedEdge *edge = &query->bandEdges[i];
+		if (point->y < Min(edge->y1, edge->y2) - epsilon ||
+			point->y > Max(edge->y1, edge->y2) + epsilon)
+		{
+			continue;
+		}
+
+		/* Distance from the point to the edge */
+		double dx = edge->x2 - edge->x1;
+		double dy = edge->y2 - edge->y1;
+		double lengthSquared = dx * dx + dy * dy;
+		double t = 0;
+		if (lengthSquared > 0)
+		{
+			t = ((point->x - edge->x1) * dx + (point->y - edge->y1) * dy) /
+				lengthSquared;
+			t = Max(0, Min(1, t));
+		}
+
+		double distanceX = point->x - (edge->x1 + t * dx);
+		double distanceY = point->y - (edge->y1 + t * dy);
+		if (distanceX * distanceX + distanceY * distanceY <= epsilon * epsilon)
+		{
+			return PreparedGeospatialMatch_Unknown;
+		}
+
+		if ((edge->y1 > point->y) != (edge->y2 > point->y))
+		{
+			double crossX = edge->x1 + (point->y - edge->y1) * dx / dy;
+			if (point->x < crossX)
+			{
+				isInside = !isInside;
+			}
+		}
+	}
+
+	return isInside ? PreparedGeospatialMatch_Matched :
+		   PreparedGeospatialMatch_NotMatched;
+}
+
+
+/*
+ * Matches a point against the $center circle, points about the radius away from the
+ * center are left to postgis.
+ */
+static PreparedGeospatialMatch
+MatchPointInCircle(const PreparedGeospatialQuery *query, const Point *point)
+{
+	double distance = hypot(point->x - query->center.x, point->y - query->center.y);
+	if (distance < query->radius - query->epsilon)
+	{
+		return PreparedGeospatialMatch_Matched;
+	}
+	else if (distance > query->radius + query->epsilon)
+	{
+		return PreparedGeospatialMatch_NotMatched;
+	}
+
+	return PreparedGeospatialMatch_Unknown;
+}
+
+
+/*
+ * A spherical shape can only cover or intersect points inside its geocentric
+ * bounding box, points inside the box are left to postgis.
+ */
+static PreparedGeospatialMatch
+MatchPointInGeocentricBox(const PreparedGeospatialQuery *query, const Point *point)
+{
+	double longitude = point->x * M_PI / 180.0;
+	double latitude = point->y * M_PI / 180.0;
+	double coordinates[3] = {
+		cos(latitude) * cos(longitude),
+		cos(latitude) * sin(longitude),
+		sin(latitude)
+	};
+
+	const GeoCellBox *box = &query->geocentricBox;
+	for (int dim = 0; dim < 3; dim++)
+	{
+		if (coordinates[dim] < box->min[dim] - PREPARED_QUERY_GEOCENTRIC_EPSILON ||
+			coordinates[dim] > box->max[dim] + PREPARED_QUERY_GEOCENTRIC_EPSILON)
+		{
+			return PreparedGeospatialMatch_NotMatched;
+		}
+	}
+
+	return PreparedGeospatialMatch_Unknown;
+}
+
+
+/*
+ * Only polygons and multi polygons get an edge index, other geometries only
+ * contribute their bounds.
+ */
+static void
+CollectShapeGeometry(const WKBGeometryConst *geometryConst, void *state)
+{
+	CollectShapeState *collectState = (CollectShapeState *) state;
+	if (geometryConst->geometryType != WKBGeometryType_Polygon &&
+		geometryConst->geometryType != WKBGeometryType_MultiPolygon)
+	{
+		collectState->isPolygonal = false;
+	}
+}
+
+
+static void
+CollectShapePoint(const WKBGeometryConst *pointConst, void *state)
+{
+	CollectShapeState *collectState = (CollectShapeState *) state;
+	PreparedGeospatialQuery *query = collectState->query;
+
+	Point point;
+	memcpy(&point, pointConst->geometryStart, WKB_BYTE_SIZE_POINT);
+
+	query->minX = Min(query->minX, point.x);
+	query->minY = Min(query->minY, point.y);
+	query->maxX = Max(query->maxX, point.x);
+	query->maxY = Max(query->maxY, point.y);
+	collectState->hasPoints = true;
+}
+
+
+static void
+CollectShapeRing(const WKBGeometryConst *ringConst, void *state)
+{
+	CollectShapeState *collectState = (CollectShapeState *) state;
+
+	Point previous, current;
+	for (int32 i = 0; i < ringConst->numPoints; i++)
+	{
+		memcpy(&current, ringConst->ringPointsStart + i * WKB_BYTE_SIZE_POINT,
+			   WKB_BYTE_SIZE_POINT);
+		if (i > 0 && (previous.x != current.x || previous.y != current.y))
+		{
+			if (collectState->numEdges == collectState->maxEdges)
+			{
+				collectState->maxEdges *= 2;
+				collectState->edges = repalloc(collectState->edges,
+											   collectState->maxEdges *
+											   sizeof(PreparedEdge));
+			}
+
+			PreparedEdge *edge = &collectState->edges[collectState->numEdges++];
+			edge->x1 = previous.x;
+			edge->y1 = previous.y;
+			edge->x2 = current.x;
+			edge->y2 = current.y;
+		}
+
+		previous = current;
+	}
+}
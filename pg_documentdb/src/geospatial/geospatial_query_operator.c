@@ -17,13 +17,17 @@
 #include "io/bson_core.h"
 #include "io/pgbsonelement.h"
 #include "geospatial/bson_geospatial_common.h"
+#include "geospatial/bson_geospatial_prepared_query.h"
 #include "geospatial/bson_geospatial_wkb_iterator.h"
 #include "planner/mongo_query_operator.h"
 #include "metadata/metadata_cache.h"
+#include "metadata/collection_field_dictionary.h"
 #include "utils/documentdb_errors.h"
 #include "utils/query_utils.h"
 #include "utils/fmgr_utils.h"
 
+extern bool EnableGeospatialPreparedQuery;
+
 
 /*
  * RuntimeBsonGeospatialState is the runtime state for the geospatial query operators
@@ -48,6 +52,9 @@ typedef struct RuntimeBsonGeospatialState
 
 	/* Shape operator specific state */
 	ShapeOperatorInfo *opInfo;
+
+	/* The query shape prepared for matching points, NULL if not available */
+	PreparedGeospatialQuery *preparedQuery;
 } RuntimeBsonGeospatialState;
 
 
@@ -109,7 +116,7 @@ static const WKBVisitorFunctions GeoWithinCenterSphereVisitorFuncs = {
 Datum
 bson_dollar_geowithin(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	pgbson *geoWithinQuery = PG_GETARG_PGBSON(1);
 	pgbsonelement element;
 	PgbsonToSinglePgbsonElement(geoWithinQuery, &element);
@@ -144,7 +151,7 @@ bson_dollar_geowithin(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_geointersects(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	pgbson *geoWithinQuery = PG_GETARG_PGBSON(1);
 	pgbsonelement element;
 	PgbsonToSinglePgbsonElement(geoWithinQuery, &element);
@@ -201,6 +208,13 @@ PopulateBsonDollarGeoWithinQueryState(RuntimeBsonGeospatialState *runtimeState,
 	 * So we use ST_Covers which includes geometries at the boundaries
 	 */
 	FillFmgrInfoForGeoWithin(shapeOperator, runtimeState);
+
+	if (EnableGeospatialPreparedQuery)
+	{
+		runtimeState->preparedQuery =
+			PrepareGeospatialQuery(runtimeState->opInfo, runtimeState->state.isSpherical,
+								   runtimeState->state.geoSpatialDatum);
+	}
 }
 
 
@@ -234,6 +248,13 @@ PopulateBsonDollarGeoIntersectQueryState(RuntimeBsonGeospatialState *runtimeStat
 	fmgr_info(intersectsFunctionOid,
 			  runtimeState->postgisFuncFmgrInfo[Geography_Intersects]);
 	runtimeState->runtimePostgisFunc = Geography_Intersects;
+
+	if (EnableGeospatialPreparedQuery)
+	{
+		runtimeState->preparedQuery =
+			PrepareGeospatialQuery(runtimeState->opInfo, runtimeState->state.isSpherical,
+								   runtimeState->state.geoSpatialDatum);
+	}
 }
 
 
@@ -295,9 +316,7 @@ CompareGeoWithinState(const pgbson *document, const char *path,
 	withinState.runtimeMatcher.isMatched = false;
 	withinState.runtimeMatcher.matcherFunc = &CompareForGeoWithinDatum;
 	withinState.runtimeMatcher.queryGeoDatum = runtimeState->state.geoSpatialDatum;
-
-	withinState.runtimeMatcher.runtimeFmgrStore =
-		(FmgrInfo **) palloc0(PostgisFuncsForDollarGeo_MAX * sizeof(FmgrInfo *));
+	withinState.runtimeMatcher.preparedQuery = runtimeState->preparedQuery;
 
 	withinState.runtimeMatcher.runtimeFmgrStore = runtimeState->postgisFuncFmgrInfo;
 	withinState.runtimeMatcher.runtimePostgisFunc = runtimeState->runtimePostgisFunc;
@@ -354,9 +373,7 @@ CompareGeoIntersectsState(const pgbson *document, const char *path,
 	geoIntersectState.runtimeMatcher.isMatched = false;
 	geoIntersectState.runtimeMatcher.matcherFunc = &CompareGeoDatumsWithFmgrInfo;
 	geoIntersectState.runtimeMatcher.queryGeoDatum = runtimeState->state.geoSpatialDatum;
-
-	geoIntersectState.runtimeMatcher.runtimeFmgrStore =
-		(FmgrInfo **) palloc0(PostgisFuncsForDollarGeo_MAX * sizeof(FmgrInfo *));
+	geoIntersectState.runtimeMatcher.preparedQuery = runtimeState->preparedQuery;
 
 	geoIntersectState.runtimeMatcher.runtimeFmgrStore =
 		runtimeState->postgisFuncFmgrInfo;
@@ -389,6 +406,14 @@ CompareGeoIntersectsState(const pgbson *document, const char *path,
 static bool
 CompareGeoDatumsWithFmgrInfo(const ProcessCommonGeospatialState *state, StringInfo buffer)
 {
+	/* Points are matched against the prepared query first, without building a datum */
+	PreparedGeospatialMatch preparedMatch =
+		MatchPreparedGeospatialQuery(state->runtimeMatcher.preparedQuery, buffer);
+	if (preparedMatch != PreparedGeospatialMatch_Unknown)
+	{
+		return preparedMatch == PreparedGeospatialMatch_Matched;
+	}
+
 	GeospatialType type = state->geospatialType;
 	bytea *wkbBytea = WKBBufferGetByteaWithSRID(buffer);
 	Datum documentGeo = type == GeospatialType_Geometry ?
@@ -477,6 +502,13 @@ CompareGeoDatumsForDollarCenter(const ProcessCommonGeospatialState *state,
 				return true;
 			}
 
+			PreparedGeospatialMatch preparedMatch =
+				MatchPreparedGeospatialQuery(runtimeMatcher->preparedQuery, buffer);
+			if (preparedMatch != PreparedGeospatialMatch_Unknown)
+			{
+				return preparedMatch == PreparedGeospatialMatch_Matched;
+			}
+
 			bytea *wkbBytea = WKBBufferGetByteaWithSRID(buffer);
 			Datum documentGeo = GetGeometryFromWKB(wkbBytea);
 			pfree(wkbBytea);
@@ -44,6 +44,10 @@ BsonIndexAmEntry RumIndexAmEntry = {
 	.get_opclass_internal_catalog_schema = GetRumInternalSchemaV2,
 	.get_multikey_status = NULL,
 	.get_truncation_status = RumGetTruncationStatus,
+	.enumerate_entry_keys = NULL,
+	.begin_shared_build = NULL,
+	.add_shared_build_tuple = NULL,
+	.end_shared_build = NULL,
 };
 
 /*
@@ -122,6 +126,51 @@ GetIndexAmSupportsIndexOnlyScan(Oid indexAm, Oid opFamilyOid,
 }
 
 
+/*
+ * Returns the function that walks the distinct entry keys of an index of the
+ * given access method (or NULL if the access method doesn't support it) along
+ * with the functions that report whether the index terms are exact.
+ */
+EnumerateIndexEntryKeysFunc
+GetIndexAmEnumerateEntryKeysFunc(Oid indexAm,
+								 GetMultikeyStatusFunc *getMultiKeyStatus,
+								 GetTruncationStatusFunc *getTruncationStatus)
+{
+	const BsonIndexAmEntry *amEntry = GetBsonIndexAmEntryByIndexOid(indexAm);
+	if (amEntry == NULL)
+	{
+		return NULL;
+	}
+
+	*getMultiKeyStatus = amEntry->get_multikey_status;
+	*getTruncationStatus = amEntry->get_truncation_status;
+	return amEntry->enumerate_entry_keys;
+}
+
+
+/*
+ * Returns the functions that build an index of the given access method from a
+ * heap scan shared with other indexes, or false if it doesn't support it.
+ */
+bool
+GetIndexAmSharedBuildFuncs(Oid indexAm, BeginSharedIndexBuildFunc *beginBuild,
+						   AddSharedIndexBuildTupleFunc *addTuple,
+						   EndSharedIndexBuildFunc *endBuild)
+{
+	const BsonIndexAmEntry *amEntry = GetBsonIndexAmEntryByIndexOid(indexAm);
+	if (amEntry == NULL || amEntry->begin_shared_build == NULL ||
+		amEntry->add_shared_build_tuple == NULL || amEntry->end_shared_build == NULL)
+	{
+		return false;
+	}
+
+	*beginBuild = amEntry->begin_shared_build;
+	*addTuple = amEntry->add_shared_build_tuple;
+	*endBuild = amEntry->end_shared_build;
+	return true;
+}
+
+
 /* Sets the Oid of the registered alternate indexAms into an input array starting at a given index */
 int
 SetDynamicIndexAmOidsAndGetCount(Datum *indexAmArray, int32_t indexAmArraySize)
@@ -15,9 +15,11 @@
 #include <fmgr.h>
 #include <utils/index_selfuncs.h>
 #include <utils/selfuncs.h>
+#include <optimizer/cost.h>
 #include <utils/lsyscache.h>
 #include <access/relscan.h>
 #include <utils/rel.h>
+#include <nodes/makefuncs.h>
 #include "math.h"
 #include <commands/explain.h>
 #include <access/gin.h>
@@ -34,15 +36,18 @@
 #include "metadata/metadata_cache.h"
 #include "opclass/bson_gin_composite_scan.h"
 #include "index_am/index_am_utils.h"
+#include "index_am/shared_heap_scan_build.h"
 #include "opclass/bson_gin_index_term.h"
 #include "opclass/bson_gin_private.h"
 #include "utils/documentdb_errors.h"
 #include "utils/error_utils.h"
+#include "query/bson_dollar_selectivity.h"
 
 extern bool ForceUseIndexIfAvailable;
 extern bool EnableIndexOrderbyPushdown;
 extern bool EnableIndexOnlyScan;
 extern bool EnableCompositeIndexPlanner;
+extern bool EnableCompositeIndexSkipScan;
 extern bool DisableExtendedRumExplainPlans;
 
 extern const RumIndexArrayStateFuncs RoaringStateFuncs;
@@ -138,6 +143,8 @@ static IndexAmRoutine * GetRumIndexHandler(PG_FUNCTION_ARGS);
 static bool RumGetMultiKeyStatusSlow(Relation relation);
 
 static bool RumScanOrderedFalse(IndexScanDesc scan);
+static bool AddCompositeSkipScanCost(PlannerInfo *root, IndexPath *path,
+									 Cost *indexStartupCost, Cost *indexTotalCost);
 static CanOrderInIndexScan rum_index_scan_ordered = RumScanOrderedFalse;
 
 static Datum (*rum_extract_tsquery_func)(PG_FUNCTION_ARGS) = NULL;
@@ -174,6 +181,10 @@ typedef enum RumFunctionCatalog
 	RumFunction_RumGetMultiKeyStatus,
 	RumFunction_RumUpdateMultiKeyStatus,
 	RumFunction_SetUnredactedLogHook,
+	RumFunction_EnumerateEntryKeys,
+	RumFunction_SharedBuildBegin,
+	RumFunction_SharedBuildAdd,
+	RumFunction_SharedBuildEnd,
 	RumFunction_Max,
 } RumFunctionCatalog;
 
@@ -192,7 +203,11 @@ static const char *RumFunctionArray[RumFunction_Max] =
 	[RumFunction_CanRumIndexScanOrdered] = "can_rum_index_scan_ordered",
 	[RumFunction_RumGetMultiKeyStatus] = "rum_get_multi_key_status",
 	[RumFunction_RumUpdateMultiKeyStatus] = "rum_update_multi_key_status",
-	[RumFunction_SetUnredactedLogHook] = "SetRumUnredactedLogEmitHook"
+	[RumFunction_SetUnredactedLogHook] = "SetRumUnredactedLogEmitHook",
+	[RumFunction_EnumerateEntryKeys] = "documentdb_rum_enumerate_entry_keys",
+	[RumFunction_SharedBuildBegin] = "documentdb_rum_shared_build_begin",
+	[RumFunction_SharedBuildAdd] = "documentdb_rum_shared_build_add",
+	[RumFunction_SharedBuildEnd] = "documentdb_rum_shared_build_end",
 };
 
 
@@ -212,6 +227,10 @@ static const char *DocumentDBRumFunctionArray[RumFunction_Max] =
 	[RumFunction_RumGetMultiKeyStatus] = "documentdb_rum_get_multi_key_status",
 	[RumFunction_RumUpdateMultiKeyStatus] = "documentdb_rum_update_multi_key_status",
 	[RumFunction_SetUnredactedLogHook] = "DocumentDBSetRumUnredactedLogEmitHook",
+	[RumFunction_EnumerateEntryKeys] = "documentdb_rum_enumerate_entry_keys",
+	[RumFunction_SharedBuildBegin] = "documentdb_rum_shared_build_begin",
+	[RumFunction_SharedBuildAdd] = "documentdb_rum_shared_build_add",
+	[RumFunction_SharedBuildEnd] = "documentdb_rum_shared_build_end",
 };
 
 
@@ -557,6 +576,37 @@ LoadRumRoutine(void)
 							   !missingOk,
 							   ignoreLibFileHandle);
 
+	/* Only available in the documentdb RUM: Public RUM doesn't expose entry keys */
+	RumIndexAmEntry.enumerate_entry_keys =
+		load_external_function(rumLibPath,
+							   functionCatalog[RumFunction_EnumerateEntryKeys],
+							   !missingOk,
+							   ignoreLibFileHandle);
+
+	/* Also only available in the documentdb RUM: building from a shared heap scan */
+	BeginSharedIndexBuildFunc beginSharedBuild =
+		load_external_function(rumLibPath,
+							   functionCatalog[RumFunction_SharedBuildBegin],
+							   !missingOk,
+							   ignoreLibFileHandle);
+	AddSharedIndexBuildTupleFunc addSharedBuildTuple =
+		load_external_function(rumLibPath,
+							   functionCatalog[RumFunction_SharedBuildAdd],
+							   !missingOk,
+							   ignoreLibFileHandle);
+	EndSharedIndexBuildFunc endSharedBuild =
+		load_external_function(rumLibPath,
+							   functionCatalog[RumFunction_SharedBuildEnd],
+							   !missingOk,
+							   ignoreLibFileHandle);
+	if (beginSharedBuild != NULL && addSharedBuildTuple != NULL &&
+		endSharedBuild != NULL)
+	{
+		RumIndexAmEntry.begin_shared_build = beginSharedBuild;
+		RumIndexAmEntry.add_shared_build_tuple = addSharedBuildTuple;
+		RumIndexAmEntry.end_shared_build = endSharedBuild;
+	}
+
 	ereport(LOG, (errmsg("rum library has update func %d, get func %d",
 						 rum_index_multi_key_update_func != NULL,
 						 rum_index_multi_key_get_func != NULL)));
@@ -614,6 +664,7 @@ extension_rumcostestimate_core(PlannerInfo *root, IndexPath *path, double loop_c
 		return;
 	}
 
+	bool isSkipScan = false;
 	if (IsCompositeOpFamilyOid(path->indexinfo->relam,
 							   path->indexinfo->opfamily[0]))
 	{
@@ -622,9 +673,12 @@ extension_rumcostestimate_core(PlannerInfo *root, IndexPath *path, double loop_c
 		/* If this is a composite index, then we need to ensure that
 		 * the first column of the index matches the query path.
 		 * This is because using the composite index would require specifying
-		 * the first column.
+		 * the first column - unless we can skip scan over the first column
+		 * with the filters on the trailing columns.
 		 */
-		if (!firstColumnSpecified)
+		isSkipScan = !firstColumnSpecified && EnableCompositeIndexSkipScan &&
+					 path->indexclauses != NIL;
+		if (!firstColumnSpecified && !isSkipScan)
 		{
 			*indexStartupCost = 0;
 			*indexTotalCost = INFINITY;
@@ -639,6 +693,17 @@ extension_rumcostestimate_core(PlannerInfo *root, IndexPath *path, double loop_c
 		root, path, loop_count, indexStartupCost, indexTotalCost,
 		indexSelectivity, indexCorrelation, indexPages);
 
+	if (isSkipScan &&
+		!AddCompositeSkipScanCost(root, path, indexStartupCost, indexTotalCost))
+	{
+		*indexStartupCost = 0;
+		*indexTotalCost = INFINITY;
+		*indexSelectivity = 0;
+		*indexCorrelation = 0;
+		*indexPages = 0;
+		return;
+	}
+
 	/* Do a pass to check for text indexes (We force push down with cost == 0) */
 	if (IsTextIndexMatch(path))
 	{
@@ -712,6 +777,62 @@ RumScanOrderedFalse(IndexScanDesc scan)
 }
 
 
+/*
+ * Adjusts the cost of a composite index path that doesn't filter on the
+ * first index path. At runtime such a scan skips over the distinct values
+ * of the leading path (seeking into each one with the bounds of the trailing
+ * paths), so each distinct value costs one descent of the entry tree.
+ * Returns false if the skip scan is not expected to be any better than
+ * walking the whole index.
+ */
+static bool
+AddCompositeSkipScanCost(PlannerInfo *root, IndexPath *path,
+						 Cost *indexStartupCost, Cost *indexTotalCost)
+{
+	IndexOptInfo *index = path->indexinfo;
+	double numIndexTuples = Max(index->tuples, 1.0);
+
+	/*
+	 * Use the number of distinct values of the leading path from the per path
+	 * statistics of the document column, if ANALYZE collected them. Otherwise
+	 * start from the Postgres default for the number of distinct values.
+	 */
+	double numPrefixes = DEFAULT_NUM_DISTINCT;
+	if (index->opclassoptions != NULL && index->ncolumns > 0 && index->indexkeys[0] != 0)
+	{
+		const char *firstPath = GetCompositeFirstIndexPath(index->opclassoptions[0]);
+		Var *documentVar = makeVar(index->rel->relid, index->indexkeys[0],
+								   BsonTypeId(), -1, InvalidOid, 0);
+		double pathDistinct = firstPath == NULL ? -1 :
+							  GetPathStatisticsDistinctValues(root, (Node *) documentVar,
+															  index->rel->relid,
+															  firstPath);
+		if (pathDistinct > 0)
+		{
+			numPrefixes = pathDistinct;
+		}
+	}
+
+	numPrefixes = Min(numPrefixes, numIndexTuples);
+
+	if (numPrefixes * 2 > numIndexTuples)
+	{
+		/* Most entries have their own prefix: we'd visit all of them anyway */
+		return false;
+	}
+
+	/* Same as the descent cost for btree (see btcostestimate) */
+	double treeHeight = index->tree_height > 0 ? index->tree_height :
+						ceil(log(Max(index->pages, 1)) / log(DEFAULT_NUM_DISTINCT));
+	Cost descentCost = ceil(log(numIndexTuples) / log(2.0)) * cpu_operator_cost +
+					   (treeHeight + 1) * 50.0 * cpu_operator_cost;
+
+	*indexStartupCost += descentCost;
+	*indexTotalCost += numPrefixes * descentCost;
+	return true;
+}
+
+
 /*
  * Validates whether an index path descriptor
  * can be satisfied by the current index.
@@ -1254,9 +1375,15 @@ extension_rumbuild_core(Relation heapRelation, Relation indexRelation,
 						UpdateMultikeyStatusFunc updateMultikeyStatus,
 						bool amCanBuildParallel)
 {
+	IndexBuildResult *result = NULL;
+	if (TryDeferIndexBuildToSharedHeapScan(heapRelation, indexRelation, indexInfo,
+										   updateMultikeyStatus, &result))
+	{
+		return result;
+	}
+
 	RumHasMultiKeyPaths = false;
-	IndexBuildResult *result = coreRoutine->ambuild(heapRelation, indexRelation,
-													indexInfo);
+	result = coreRoutine->ambuild(heapRelation, indexRelation, indexInfo);
 
 	/* Update statistics to track that we're a multi-key index:
 	 * Note: We don't use HasMultiKeyPaths here as we want to handle the parallel build
@@ -0,0 +1,359 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/index_am/shared_heap_scan_build.c
+ *
+ * Builds several indexes of a collection from a single heap scan.
+ *
+ * When a createIndexes command creates more than one index on a collection
+ * in the same transaction, each CREATE INDEX scans the whole data table.
+ * Instead, while the shared build mode is active, the ambuild of each
+ * eligible index only lays out an empty index and queues it. Once all
+ * indexes are created, EndSharedHeapScanIndexBuild() scans the table once
+ * and feeds every tuple to the build state of each queued index, splitting
+ * maintenance_work_mem across them.
+ *
+ * Only the non-concurrent createIndexes path (create_indexes_non_concurrently,
+ * used for blocking: true and in transaction blocks) enters the shared build
+ * mode. Requests served from the background index
+ * queue build each index concurrently in its own transaction, and keep one
+ * heap scan per index.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <postgres.h>
+#include <miscadmin.h>
+#include <access/genam.h>
+#include <access/htup_details.h>
+#include <access/table.h>
+#include <access/tableam.h>
+#include <access/xact.h>
+#include <catalog/index.h>
+#include <catalog/indexing.h>
+#include <catalog/pg_class.h>
+#include <catalog/pg_index.h>
+#include <utils/memutils.h>
+#include <utils/rel.h>
+#include <utils/syscache.h>
+
+#include "index_am/index_am_utils.h"
+#include "index_am/shared_heap_scan_build.h"
+
+extern bool RumHasMultiKeyPaths;
+
+/* An index whose build was deferred to the shared heap scan */
+typedef struct DeferredIndexBuild
+{
+	Oid indexOid;
+
+	BeginSharedIndexBuildFunc beginBuild;
+	AddSharedIndexBuildTupleFunc addTuple;
+	EndSharedIndexBuildFunc endBuild;
+	UpdateMultikeyStatusFunc updateMultikeyStatus;
+
+	/* Set while the shared heap scan runs */
+	Relation indexRelation;
+	void *buildState;
+	bool hasMultiKeyPaths;
+} DeferredIndexBuild;
+
+typedef struct SharedHeapScanBuildState
+{
+	/* The table whose index builds are deferred */
+	Oid heapRelationId;
+
+	/* List of DeferredIndexBuild */
+	List *deferredBuilds;
+} SharedHeapScanBuildState;
+
+/*
+ * The active shared build, allocated in the TopTransactionContext. Callers
+ * reset it on error so that it never outlives the transaction.
+ */
+static SharedHeapScanBuildState *ActiveSharedBuild = NULL;
+
+static bool IsIndexEligibleForSharedHeapScan(Relation heapRelation,
+											 IndexInfo *indexInfo);
+static void SharedHeapScanBuildCallback(Relation index, ItemPointer tid,
+										Datum *values, bool *isnull,
+										bool tupleIsAlive, void *state);
+static void UpdateRelationBuildStats(Oid relationId, BlockNumber relPages,
+									 double relTuples, bool setCheckXmin);
+
+
+/*
+ * Starts deferring the builds of the eligible indexes created on the given
+ * table until EndSharedHeapScanIndexBuild() is called.
+ */
+void
+BeginSharedHeapScanIndexBuild(Oid heapRelationId)
+{
+	if (ActiveSharedBuild != NULL)
+	{
+		ereport(ERROR, (errmsg("a shared heap scan index build is already active")));
+	}
+
+	SharedHeapScanBuildState *state =
+		MemoryContextAllocZero(TopTransactionContext, sizeof(SharedHeapScanBuildState));
+	state->heapRelationId = heapRelationId;
+	state->deferredBuilds = NIL;
+	ActiveSharedBuild = state;
+}
+
+
+/*
+ * Stops deferring index builds and builds all the deferred indexes from a
+ * single scan of the table.
+ */
+void
+EndSharedHeapScanIndexBuild(void)
+{
+	SharedHeapScanBuildState *state = ActiveSharedBuild;
+	ActiveSharedBuild = NULL;
+
+	if (state == NULL || state->deferredBuilds == NIL)
+	{
+		return;
+	}
+
+	Relation heapRelation = table_open(state->heapRelationId, NoLock);
+
+	/* Each build gets an equal share of the memory a single build would use */
+	int numBuilds = list_length(state->deferredBuilds);
+	int maxMemoryKb = Max(maintenance_work_mem / numBuilds, 1024);
+
+	ListCell *buildCell;
+	foreach(buildCell, state->deferredBuilds)
+	{
+		DeferredIndexBuild *build = lfirst(buildCell);
+
+		/* CREATE INDEX already holds the lock on the index */
+		build->indexRelation = index_open(build->indexOid, NoLock);
+		build->buildState = build->beginBuild(build->indexRelation, maxMemoryKb);
+		build->hasMultiKeyPaths = false;
+	}
+
+	/*
+	 * All the deferred indexes are on the document column only and have
+	 * neither expressions nor predicates, so the index info of any of them
+	 * produces the values for all of them.
+	 */
+	DeferredIndexBuild *firstBuild = linitial(state->deferredBuilds);
+	IndexInfo *scanIndexInfo = BuildIndexInfo(firstBuild->indexRelation);
+
+	bool allowSync = false;
+	bool reportProgress = false;
+	double heapTuples = table_index_build_scan(heapRelation,
+											   firstBuild->indexRelation,
+											   scanIndexInfo, allowSync,
+											   reportProgress,
+											   SharedHeapScanBuildCallback,
+											   state->deferredBuilds, NULL);
+
+	UpdateRelationBuildStats(RelationGetRelid(heapRelation),
+							 RelationGetNumberOfBlocks(heapRelation), heapTuples,
+							 false);
+
+	foreach(buildCell, state->deferredBuilds)
+	{
+		DeferredIndexBuild *build = lfirst(buildCell);
+		double indexTuples = build->endBuild(build->buildState);
+
+		if (build->hasMultiKeyPaths && build->updateMultikeyStatus != NULL)
+		{
+			build->updateMultikeyStatus(build->indexRelation);
+		}
+
+		/*
+		 * Like index_build(), indexes that skipped broken HOT chains must not
+		 * be used by transactions that can still see them.
+		 */
+		UpdateRelationBuildStats(build->indexOid,
+								 RelationGetNumberOfBlocks(build->indexRelation),
+								 indexTuples, scanIndexInfo->ii_BrokenHotChain);
+
+		index_close(build->indexRelation, NoLock);
+		build->indexRelation = NULL;
+	}
+
+	table_close(heapRelation, NoLock);
+	list_free_deep(state->deferredBuilds);
+	pfree(state);
+}
+
+
+/*
+ * Drops the active shared build without building the deferred indexes. Used
+ * when the transaction is about to abort anyway.
+ */
+void
+ResetSharedHeapScanIndexBuild(void)
+{
+	ActiveSharedBuild = NULL;
+}
+
+
+/*
+ * Called from ambuild: if a shared build is active for the table and the index
+ * can be built from it, lays out an empty index, queues the index for the
+ * shared heap scan and returns true along with the build result to report.
+ * Otherwise returns false and the caller builds the index as usual.
+ */
+bool
+TryDeferIndexBuildToSharedHeapScan(Relation heapRelation, Relation indexRelation,
+								   IndexInfo *indexInfo,
+								   UpdateMultikeyStatusFunc updateMultikeyStatus,
+								   IndexBuildResult **result)
+{
+	SharedHeapScanBuildState *state = ActiveSharedBuild;
+	if (state == NULL || state->heapRelationId != RelationGetRelid(heapRelation))
+	{
+		return false;
+	}
+
+	BeginSharedIndexBuildFunc beginBuild;
+	AddSharedIndexBuildTupleFunc addTuple;
+	EndSharedIndexBuildFunc endBuild;
+	if (!GetIndexAmSharedBuildFuncs(indexRelation->rd_rel->relam, &beginBuild,
+									&addTuple, &endBuild))
+	{
+		return false;
+	}
+
+	if (!IsIndexEligibleForSharedHeapScan(heapRelation, indexInfo))
+	{
+		return false;
+	}
+
+	/* Lay out the metapage and root so that the index is valid until filled */
+	void *buildState = beginBuild(indexRelation, maintenance_work_mem);
+	endBuild(buildState);
+
+	MemoryContext oldContext = MemoryContextSwitchTo(TopTransactionContext);
+	DeferredIndexBuild *build = palloc0(sizeof(DeferredIndexBuild));
+	build->indexOid = RelationGetRelid(indexRelation);
+	build->beginBuild = beginBuild;
+	build->addTuple = addTuple;
+	build->endBuild = endBuild;
+	build->updateMultikeyStatus = updateMultikeyStatus;
+	state->deferredBuilds = lappend(state->deferredBuilds, build);
+	MemoryContextSwitchTo(oldContext);
+
+	/*
+	 * Leave the table's tuple count as is, the shared heap scan updates the
+	 * statistics of the table and the index once it runs.
+	 */
+	IndexBuildResult *buildResult = palloc0(sizeof(IndexBuildResult));
+	buildResult->heap_tuples = heapRelation->rd_rel->reltuples;
+	buildResult->index_tuples = 0;
+	*result = buildResult;
+	return true;
+}
+
+
+/*
+ * Only plain indexes whose columns all index the document column can share the
+ * heap scan: unique indexes need their own uniqueness checks and expressions
+ * or predicates would need to be evaluated per index.
+ */
+static bool
+IsIndexEligibleForSharedHeapScan(Relation heapRelation, IndexInfo *indexInfo)
+{
+	if (indexInfo->ii_Unique || indexInfo->ii_ExclusionOps != NULL ||
+		indexInfo->ii_Expressions != NIL || indexInfo->ii_Predicate != NIL ||
+		indexInfo->ii_NumIndexAttrs < 1)
+	{
+		return false;
+	}
+
+	AttrNumber documentAttr = indexInfo->ii_IndexAttrNumbers[0];
+	if (documentAttr == InvalidAttrNumber)
+	{
+		return false;
+	}
+
+	for (int i = 1; i < indexInfo->ii_NumIndexAttrs; i++)
+	{
+		if (indexInfo->ii_IndexAttrNumbers[i] != documentAttr)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * Feeds a heap tuple to the build state of every deferred index.
+ */
+static void
+SharedHeapScanBuildCallback(Relation index, ItemPointer tid, Datum *values,
+							bool *isnull, bool tupleIsAlive, void *state)
+{
+	List *deferredBuilds = (List *) state;
+
+	Datum indexValues[INDEX_MAX_KEYS];
+	bool indexIsNull[INDEX_MAX_KEYS];
+
+	ListCell *buildCell;
+	foreach(buildCell, deferredBuilds)
+	{
+		DeferredIndexBuild *build = lfirst(buildCell);
+
+		int numColumns = RelationGetNumberOfAttributes(build->indexRelation);
+		for (int i = 0; i < numColumns; i++)
+		{
+			indexValues[i] = values[0];
+			indexIsNull[i] = isnull[0];
+		}
+
+		RumHasMultiKeyPaths = false;
+		build->addTuple(build->buildState, tid, indexValues, indexIsNull);
+		build->hasMultiKeyPaths = build->hasMultiKeyPaths || RumHasMultiKeyPaths;
+	}
+}
+
+
+/*
+ * Records the size of a relation built by the shared heap scan in pg_class,
+ * which index_build() did with the placeholder result of the deferred build.
+ */
+static void
+UpdateRelationBuildStats(Oid relationId, BlockNumber relPages, double relTuples,
+						 bool setCheckXmin)
+{
+	/* Make the pg_class updates of index_build() visible */
+	CommandCounterIncrement();
+
+	Relation pgClass = table_open(RelationRelationId, RowExclusiveLock);
+	HeapTuple classTuple = SearchSysCacheCopy1(RELOID, ObjectIdGetDatum(relationId));
+	if (!HeapTupleIsValid(classTuple))
+	{
+		ereport(ERROR, (errmsg("cache lookup failed for relation %u", relationId)));
+	}
+
+	Form_pg_class classForm = (Form_pg_class) GETSTRUCT(classTuple);
+	classForm->relpages = (int32) relPages;
+	classForm->reltuples = (float4) relTuples;
+	CatalogTupleUpdate(pgClass, &classTuple->t_self, classTuple);
+	heap_freetuple(classTuple);
+	table_close(pgClass, RowExclusiveLock);
+
+	if (setCheckXmin)
+	{
+		Relation pgIndex = table_open(IndexRelationId, RowExclusiveLock);
+		HeapTuple indexTuple = SearchSysCacheCopy1(INDEXRELID,
+												   ObjectIdGetDatum(relationId));
+		if (!HeapTupleIsValid(indexTuple))
+		{
+			ereport(ERROR, (errmsg("cache lookup failed for index %u", relationId)));
+		}
+
+		((Form_pg_index) GETSTRUCT(indexTuple))->indcheckxmin = true;
+		CatalogTupleUpdate(pgIndex, &indexTuple->t_self, indexTuple);
+		heap_freetuple(indexTuple);
+		table_close(pgIndex, RowExclusiveLock);
+	}
+}
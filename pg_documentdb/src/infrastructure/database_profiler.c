@@ -0,0 +1,1523 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/infrastructure/database_profiler.c
+ *
+ * Implementation of the database profiler.
+ *
+ * The profile command sets the profiling level of a database: 0 is off, 1
+ * profiles the commands slower than slowms and 2 profiles every command.
+ * As in MongoDB, the levels live in shared memory and reset on restart.
+ *
+ * Commands are recognized when the top level statement that runs them
+ * starts (e.g. SELECT ... FROM ApiSchemaName.find_cursor_first_page($1, $2))
+ * from the function it calls; its first parameter is the database and its
+ * second the command spec. For a profiled database, the nested queries of the
+ * command run with row (and optionally timer) instrumentation the way
+ * auto_explain runs them, and the plans of the ones on collections are
+ * summarized when they end: the stages, the indexes used and the keys and
+ * documents examined. CPU time, I/O time and bytes read are measured around
+ * the command. The rest of the wall clock time is time spent waiting, mostly
+ * on locks, which Postgres does not account for per statement.
+ *
+ * While documentdb.enableQueryStats is on, every command is measured this
+ * way without the stage timings and added to the statistics of its query
+ * shape (see query_stats.c), whether or not its database is profiled.
+ *
+ * Profiled commands are copied into a ring buffer in shared memory so that
+ * the command never pays for an insert. A background job flushes the ring to
+ * the system.profile collection of each database and trims the collection
+ * to documentdb.maxProfileCollectionDocuments, oldest first. When the ring
+ * wraps around before a flush, the oldest entries are dropped.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include <miscadmin.h>
+#include <sys/resource.h>
+#include <catalog/pg_type.h>
+#include <common/pg_prng.h>
+#include <executor/executor.h>
+#include <executor/instrument.h>
+#include <executor/spi.h>
+#include <nodes/nodeFuncs.h>
+#include <port/atomics.h>
+#include <storage/lwlock.h>
+#include <storage/shmem.h>
+#include <storage/spin.h>
+#include <utils/builtins.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+#include <utils/timestamp.h>
+
+#include "io/bson_core.h"
+#include "io/bsonvalue_utils.h"
+#include "commands/commands_common.h"
+#include "commands/insert.h"
+#include "commands/parse_error.h"
+#include "metadata/collection.h"
+#include "metadata/collection_compression.h"
+#include "metadata/collection_field_dictionary.h"
+#include "metadata/metadata_cache.h"
+#include "planner/documentdb_planner.h"
+#include "sharding/sharding.h"
+#include "infrastructure/database_profiler.h"
+#include "infrastructure/job_management.h"
+#include "infrastructure/query_stats.h"
+#include "infrastructure/documentdb_plan_cache.h"
+#include "background_worker/background_worker_job.h"
+#include "utils/documentdb_errors.h"
+#include "utils/query_shape.h"
+#include "utils/query_utils.h"
+#include "utils/version_utils.h"
+
+extern bool EnableDatabaseProfiler;
+extern int DatabaseProfilerRingBufferEntries;
+extern int DatabaseProfilerDefaultSlowMs;
+extern bool DatabaseProfilerCaptureStageTimings;
+extern int MaxProfileCollectionDocuments;
+extern int DatabaseProfilerFlushIntervalSec;
+
+/* The most databases that can have a profiling level */
+#define PROFILER_MAX_DATABASES 128
+
+/* The largest profile document kept in the ring */
+#define PROFILER_ENTRY_MAX_SIZE 4096
+
+/* The most plan stages reported for a command */
+#define PROFILER_MAX_STAGES 32
+
+#define PROFILE_COLLECTION_NAME "system.profile"
+
+/*
+ * The profiling settings of a database, kept for databases with a level
+ * above 0.
+ */
+typedef struct ProfilerDatabaseSettings
+{
+	char databaseName[MAX_DATABASE_NAME_LENGTH];
+	int level;
+	int slowMs;
+	double sampleRate;
+} ProfilerDatabaseSettings;
+
+/*
+ * A slot of the ring buffer. position is the ring position of the entry in
+ * the slot plus one, 0 for a slot that was never written.
+ */
+typedef struct ProfilerRingEntry
+{
+	slock_t mutex;
+	uint64 position;
+	Oid pgDatabaseId;
+	char databaseName[MAX_DATABASE_NAME_LENGTH];
+	uint32 documentSize;
+	char document[PROFILER_ENTRY_MAX_SIZE];
+} ProfilerRingEntry;
+
+/*
+ * ProfilerSharedState is the profiler state in shared memory. settingsLock
+ * protects the database settings and flushLock the read position of the
+ * ring. Writers claim ring positions with writePosition and only lock the
+ * slot they write.
+ */
+typedef struct ProfilerSharedState
+{
+	int trancheId;
+	char *trancheName;
+	LWLock settingsLock;
+	LWLock flushLock;
+
+	/* Number of databases with a level above 0, read without the lock */
+	pg_atomic_uint32 numProfiledDatabases;
+	ProfilerDatabaseSettings databases[PROFILER_MAX_DATABASES];
+
+	pg_atomic_uint64 writePosition;
+	pg_atomic_uint64 droppedEntries;
+	uint64 readPosition;
+	ProfilerRingEntry entries[FLEXIBLE_ARRAY_MEMBER];
+} ProfilerSharedState;
+
+/*
+ * A command that can be profiled, recognized by the ApiSchemaName function
+ * that runs it.
+ */
+typedef struct ProfiledCommandType
+{
+	const char *functionCall;
+	const char *commandName;
+
+	/* The op reported in system.profile, as in currentOp */
+	const char *op;
+} ProfiledCommandType;
+
+static const ProfiledCommandType ProfiledCommandTypes[] = {
+	{ ".find_cursor_first_page(", "find", "query" },
+	{ ".aggregate_cursor_first_page(", "aggregate", "command" },
+	{ ".cursor_get_more(", "getMore", "getmore" },
+	{ ".count_query(", "count", "command" },
+	{ ".distinct_query(", "distinct", "command" },
+	{ ".find_and_modify(", "findAndModify", "command" },
+	{ ".update(", "update", "update" },
+	{ ".delete(", "delete", "remove" },
+	{ ".insert(", "insert", "insert" },
+};
+
+static const int ProfiledCommandTypesCount = sizeof(ProfiledCommandTypes) /
+											 sizeof(ProfiledCommandType);
+
+typedef struct ProfiledStage
+{
+	const char *stage;
+	const char *indexName;
+	double rows;
+	double loops;
+	double totalMicros;
+} ProfiledStage;
+
+/*
+ * The command of this backend being profiled or measured for the query
+ * stats.
+ */
+typedef struct ProfiledCommand
+{
+	bool isActive;
+	const ProfiledCommandType *commandType;
+	QueryDesc *topLevelQueryDesc;
+
+	/* Profiling level of the command, 0 if it is only measured for query stats */
+	int level;
+	int slowMs;
+	bool recordQueryStats;
+	char databaseName[MAX_DATABASE_NAME_LENGTH];
+
+	instr_time startTime;
+	struct rusage startUsage;
+	BufferUsage startBufferUsage;
+	uint64 startPlanCacheHits;
+
+	/* Summary of the plans of the nested queries on collections */
+	bool hasReturnedCount;
+	double nreturned;
+	double keysExamined;
+	double docsExamined;
+	int numStages;
+	int numOmittedStages;
+	ProfiledStage stages[PROFILER_MAX_STAGES];
+} ProfiledCommand;
+
+/*
+ * The measurements of a command written to its profile document.
+ */
+typedef struct ProfiledCommandMetrics
+{
+	uint64 durationMicros;
+	uint64 cpuMicros;
+	uint64 ioWaitMicros;
+	uint64 waitMicros;
+	int64 bytesRead;
+	int64 bytesWritten;
+} ProfiledCommandMetrics;
+
+typedef struct ProfileEntryCopy
+{
+	char databaseName[MAX_DATABASE_NAME_LENGTH];
+	pgbson *document;
+} ProfileEntryCopy;
+
+
+static ProfilerSharedState *ProfilerState = NULL;
+static ProfiledCommand CurrentCommand = { 0 };
+static MemoryContext ProfilerMemoryContext = NULL;
+static int ExecutorNestingLevel = 0;
+
+static ExecutorStart_hook_type PreviousExecutorStartHook = NULL;
+static ExecutorRun_hook_type PreviousExecutorRunHook = NULL;
+static ExecutorFinish_hook_type PreviousExecutorFinishHook = NULL;
+static ExecutorEnd_hook_type PreviousExecutorEndHook = NULL;
+
+
+static void ProfilerExecutorStart(QueryDesc *queryDesc, int eflags);
+#if PG_VERSION_NUM >= 180000
+static void ProfilerExecutorRun(QueryDesc *queryDesc, ScanDirection direction,
+								uint64 count);
+#else
+static void ProfilerExecutorRun(QueryDesc *queryDesc, ScanDirection direction,
+								uint64 count, bool executeOnce);
+#endif
+static void ProfilerExecutorFinish(QueryDesc *queryDesc);
+static void ProfilerExecutorEnd(QueryDesc *queryDesc);
+
+static void TryBeginProfiledCommand(QueryDesc *queryDesc);
+static const ProfiledCommandType * DetectProfiledCommand(const char *sourceText);
+static bool GetDatabaseProfilingSettings(const char *databaseName,
+										 ProfilerDatabaseSettings *settings);
+static void SetDatabaseProfilingSettings(const ProfilerDatabaseSettings *settings);
+static void CollectPlanStatistics(QueryDesc *queryDesc);
+static bool PlanReadsCollection(PlannedStmt *plannedStmt);
+static bool CollectStageStatisticsWalker(PlanState *planState, void *context);
+static void FinishProfiledCommand(QueryDesc *queryDesc);
+static pgbson * BuildProfileDocument(pgbson *commandSpec, QueryShape *queryShape,
+									 ProfiledCommandMetrics *metrics,
+									 bool includeCommand, bool includeStages);
+static char * BuildPlanSummary(void);
+static void WriteProfileEntry(const char *databaseName, pgbson *document);
+static List * ReadProfileEntries(void);
+static MongoCollection * GetOrCreateProfileCollection(const char *databaseName);
+static void TrimProfileCollection(MongoCollection *collection);
+static int GetDatabaseProfilerScheduleInSec(void);
+
+
+/*
+ * Returns the amount of shared memory needed for the profiler.
+ */
+Size
+DatabaseProfilerShmemSize(void)
+{
+	if (DatabaseProfilerRingBufferEntries <= 0)
+	{
+		return 0;
+	}
+
+	Size size = offsetof(ProfilerSharedState, entries);
+	size = add_size(size, mul_size(DatabaseProfilerRingBufferEntries,
+								   sizeof(ProfilerRingEntry)));
+	return MAXALIGN(size);
+}
+
+
+/*
+ * Initializes the database settings and the ring buffer of the profiler.
+ */
+void
+InitializeDatabaseProfilerShmem(void)
+{
+	if (DatabaseProfilerRingBufferEntries <= 0)
+	{
+		return;
+	}
+
+	bool found = false;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	ProfilerState = (ProfilerSharedState *) ShmemInitStruct(
+		"Database Profiler State", DatabaseProfilerShmemSize(), &found);
+
+	if (!found)
+	{
+		ProfilerState->trancheId = LWLockNewTrancheId();
+		ProfilerState->trancheName = "Database Profiler Tranche";
+		LWLockRegisterTranche(ProfilerState->trancheId, ProfilerState->trancheName);
+
+		LWLockInitialize(&ProfilerState->settingsLock, ProfilerState->trancheId);
+		LWLockInitialize(&ProfilerState->flushLock, ProfilerState->trancheId);
+
+		pg_atomic_init_u32(&ProfilerState->numProfiledDatabases, 0);
+		memset(ProfilerState->databases, 0, sizeof(ProfilerState->databases));
+
+		pg_atomic_init_u64(&ProfilerState->writePosition, 0);
+		pg_atomic_init_u64(&ProfilerState->droppedEntries, 0);
+		ProfilerState->readPosition = 0;
+		for (int i = 0; i < DatabaseProfilerRingBufferEntries; i++)
+		{
+			SpinLockInit(&ProfilerState->entries[i].mutex);
+			ProfilerState->entries[i].position = 0;
+		}
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+
+/*
+ * Installs the executor hooks that capture profiled commands.
+ */
+void
+InstallDatabaseProfilerHooks(void)
+{
+	PreviousExecutorStartHook = ExecutorStart_hook;
+	ExecutorStart_hook = ProfilerExecutorStart;
+
+	PreviousExecutorRunHook = ExecutorRun_hook;
+	ExecutorRun_hook = ProfilerExecutorRun;
+
+	PreviousExecutorFinishHook = ExecutorFinish_hook;
+	ExecutorFinish_hook = ProfilerExecutorFinish;
+
+	PreviousExecutorEndHook = ExecutorEnd_hook;
+	ExecutorEnd_hook = ProfilerExecutorEnd;
+}
+
+
+void
+UninstallDatabaseProfilerHooks(void)
+{
+	ExecutorStart_hook = PreviousExecutorStartHook;
+	PreviousExecutorStartHook = NULL;
+
+	ExecutorRun_hook = PreviousExecutorRunHook;
+	PreviousExecutorRunHook = NULL;
+
+	ExecutorFinish_hook = PreviousExecutorFinishHook;
+	PreviousExecutorFinishHook = NULL;
+
+	ExecutorEnd_hook = PreviousExecutorEndHook;
+	PreviousExecutorEndHook = NULL;
+}
+
+
+/*
+ * Registers the background job that flushes the ring to system.profile.
+ */
+void
+RegisterDatabaseProfilerBackgroundWorkerJob(void)
+{
+	if (!EnableBackgroundWorker || !EnableBackgroundWorkerJobs ||
+		DatabaseProfilerRingBufferEntries <= 0)
+	{
+		return;
+	}
+
+	if (!process_shared_preload_libraries_in_progress)
+	{
+		ereport(ERROR, (errmsg(
+							"Registering a new background worker job must happen during shared_preload_libraries")));
+	}
+
+	/* Every node flushes the commands it ran */
+	BackgroundWorkerJob profilerJob = {
+		.jobId = DOCUMENTDB_DATABASE_PROFILER_JOBID,
+		.jobName = "documentdb_database_profiler_background_job",
+		.command = {
+			.schema = ApiInternalSchemaName,
+			.name = "flush_profile_entries_background"
+		},
+		.get_schedule_interval_in_seconds_hook = GetDatabaseProfilerScheduleInSec,
+		.argument = {
+			.argType = InvalidOid,
+			.argValue = NULL,
+			.isNull = true
+		},
+		.timeoutInSeconds = 60,
+		.toBeExecutedOnMetadataCoordinatorOnly = false,
+
+		/* A postponed flush lets the ring wrap and drop entries */
+		.priority = BackgroundWorkerJobPriority_Normal
+	};
+
+	RegisterBackgroundWorkerJob(profilerJob);
+}
+
+
+PG_FUNCTION_INFO_V1(command_profile);
+
+/*
+ * Implements the profile command:
+ * { profile: <level>, slowms: <int>, sampleRate: <double> }
+ * Level -1 reads the current settings without changing them. Returns the
+ * settings before the command.
+ */
+Datum
+command_profile(PG_FUNCTION_ARGS)
+{
+	char *databaseName = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	pgbson *commandSpec = PG_GETARG_PGBSON(1);
+
+	if (ProfilerState == NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
+						errmsg("The profiler is not enabled on this server"),
+						errdetail_log("documentdb.profilerRingBufferEntries is 0 or the "
+									  "extension is not in shared_preload_libraries")));
+	}
+
+	if (strlen(databaseName) >= MAX_DATABASE_NAME_LENGTH)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INVALIDNAMESPACE),
+						errmsg("Invalid database name: %s", databaseName)));
+	}
+
+	bool hasLevel = false;
+	int level = -1;
+	bool hasSlowMs = false;
+	int slowMs = 0;
+	bool hasSampleRate = false;
+	double sampleRate = 1.0;
+
+	bson_iter_t commandIter;
+	PgbsonInitIterator(commandSpec, &commandIter);
+	while (bson_iter_next(&commandIter))
+	{
+		const char *key = bson_iter_key(&commandIter);
+		const bson_value_t *value = bson_iter_value(&commandIter);
+		if (strcmp(key, "profile") == 0)
+		{
+			EnsureTopLevelFieldIsNumberLike("profile", value);
+			level = BsonValueAsInt32(value);
+			hasLevel = true;
+		}
+		else if (strcmp(key, "slowms") == 0)
+		{
+			EnsureTopLevelFieldIsNumberLike("profile.slowms", value);
+			slowMs = BsonValueAsInt32(value);
+			hasSlowMs = true;
+		}
+		else if (strcmp(key, "sampleRate") == 0)
+		{
+			EnsureTopLevelFieldIsNumberLike("profile.sampleRate", value);
+			sampleRate = BsonValueAsDouble(value);
+			hasSampleRate = true;
+		}
+		else if (strcmp(key, "filter") == 0)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
+							errmsg("profile.filter is not supported yet")));
+		}
+		else if (!IsCommonSpecIgnoredField(key))
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_UNKNOWNBSONFIELD),
+							errmsg("BSON field 'profile.%s' is an unknown field.", key)));
+		}
+	}
+
+	if (!hasLevel)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("BSON field 'profile.profile' is missing but a "
+							   "required field")));
+	}
+
+	if (level < -1 || level > 2)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("Profiling level must be -1, 0, 1 or 2, got %d", level)));
+	}
+
+	if (hasSampleRate && (sampleRate < 0 || sampleRate > 1))
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("'sampleRate' must be between 0.0 and 1.0 inclusive")));
+	}
+
+	ProfilerDatabaseSettings previous = { 0 };
+	if (!GetDatabaseProfilingSettings(databaseName, &previous))
+	{
+		previous.level = 0;
+		previous.slowMs = DatabaseProfilerDefaultSlowMs;
+		previous.sampleRate = 1.0;
+	}
+
+	if (level >= 0)
+	{
+		ProfilerDatabaseSettings settings = { 0 };
+		strlcpy(settings.databaseName, databaseName, MAX_DATABASE_NAME_LENGTH);
+		settings.level = level;
+		settings.slowMs = hasSlowMs ? slowMs : previous.slowMs;
+		settings.sampleRate = hasSampleRate ? sampleRate : previous.sampleRate;
+		SetDatabaseProfilingSettings(&settings);
+	}
+
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+	PgbsonWriterAppendInt32(&writer, "was", 3, previous.level);
+	PgbsonWriterAppendInt32(&writer, "slowms", 6, previous.slowMs);
+	PgbsonWriterAppendDouble(&writer, "sampleRate", 10, previous.sampleRate);
+	PgbsonWriterAppendDouble(&writer, "ok", 2, 1);
+	PG_RETURN_POINTER(PgbsonWriterGetPgbson(&writer));
+}
+
+
+PG_FUNCTION_INFO_V1(command_flush_profile_entries_background);
+
+/*
+ * Called periodically by the background worker framework to move the
+ * profiled commands from the ring buffer to system.profile.
+ */
+Datum
+command_flush_profile_entries_background(PG_FUNCTION_ARGS)
+{
+	if (ProfilerState == NULL || !IsClusterVersionAtleast(DocDB_V0, 110, 0))
+	{
+		PG_RETURN_VOID();
+	}
+
+	List *entries = ReadProfileEntries();
+
+	uint64 droppedEntries = pg_atomic_exchange_u64(&ProfilerState->droppedEntries, 0);
+	if (droppedEntries > 0)
+	{
+		elog(LOG, "database profiler dropped " UINT64_FORMAT " entries, the ring "
+				  "buffer filled up before it was flushed", droppedEntries);
+	}
+
+	/* Entries of a database are mostly consecutive, keep the last collection */
+	List *profileCollections = NIL;
+	MongoCollection *collection = NULL;
+	ListCell *entryCell;
+	foreach(entryCell, entries)
+	{
+		ProfileEntryCopy *entry = lfirst(entryCell);
+		if (collection == NULL ||
+			strcmp(collection->name.databaseName, entry->databaseName) != 0)
+		{
+			collection = NULL;
+			ListCell *collectionCell;
+			foreach(collectionCell, profileCollections)
+			{
+				MongoCollection *profileCollection = lfirst(collectionCell);
+				if (strcmp(profileCollection->name.databaseName,
+						   entry->databaseName) == 0)
+				{
+					collection = profileCollection;
+					break;
+				}
+			}
+
+			if (collection == NULL)
+			{
+				collection = GetOrCreateProfileCollection(entry->databaseName);
+				profileCollections = lappend(profileCollections, collection);
+			}
+		}
+
+		pgbson *document = RewriteDocumentAddObjectId(entry->document);
+		int64 shardKeyHash = ComputeShardKeyHashForDocument(collection->shardKey,
+															collection->collectionId,
+															document);
+		pgbson *objectId = PgbsonGetDocumentId(document);
+		pgbson *storedDocument = CompressDocumentForCollection(
+			collection, EncodeDocumentForCollection(collection, document));
+		InsertDocument(collection->collectionId, collection->shardTableName,
+					   shardKeyHash, objectId, storedDocument);
+	}
+
+	ListCell *collectionCell;
+	foreach(collectionCell, profileCollections)
+	{
+		TrimProfileCollection(lfirst(collectionCell));
+	}
+
+	PG_RETURN_VOID();
+}
+
+
+static void
+ProfilerExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	if (ExecutorNestingLevel == 0)
+	{
+		CurrentCommand.isActive = false;
+		if ((EnableDatabaseProfiler && ProfilerState != NULL) || IsQueryStatsEnabled())
+		{
+			TryBeginProfiledCommand(queryDesc);
+		}
+	}
+	else if (CurrentCommand.isActive)
+	{
+		queryDesc->instrument_options |= INSTRUMENT_ROWS;
+		if (CurrentCommand.level > 0 && DatabaseProfilerCaptureStageTimings)
+		{
+			queryDesc->instrument_options |= INSTRUMENT_TIMER;
+		}
+	}
+
+	if (PreviousExecutorStartHook != NULL)
+	{
+		PreviousExecutorStartHook(queryDesc, eflags);
+	}
+	else
+	{
+		standard_ExecutorStart(queryDesc, eflags);
+	}
+}
+
+
+/*
+ * Tracks the nesting level of the executor and completes the profiled command
+ * once its top level statement has run.
+ */
+#if PG_VERSION_NUM >= 180000
+static void
+ProfilerExecutorRun(QueryDesc *queryDesc, ScanDirection direction, uint64 count)
+#else
+static void
+ProfilerExecutorRun(QueryDesc *queryDesc, ScanDirection direction, uint64 count,
+					bool executeOnce)
+#endif
+{
+	ExecutorNestingLevel++;
+	PG_TRY();
+	{
+#if PG_VERSION_NUM >= 180000
+		if (PreviousExecutorRunHook != NULL)
+		{
+			PreviousExecutorRunHook(queryDesc, direction, count);
+		}
+		else
+		{
+			standard_ExecutorRun(queryDesc, direction, count);
+		}
+#else
+		if (PreviousExecutorRunHook != NULL)
+		{
+			PreviousExecutorRunHook(queryDesc, direction, count, executeOnce);
+		}
+		else
+		{
+			standard_ExecutorRun(queryDesc, direction, count, executeOnce);
+		}
+#endif
+	}
+	PG_FINALLY();
+	{
+		ExecutorNestingLevel--;
+	}
+	PG_END_TRY();
+
+	if (ExecutorNestingLevel == 0 && CurrentCommand.isActive &&
+		CurrentCommand.topLevelQueryDesc == queryDesc)
+	{
+		CurrentCommand.isActive = false;
+		FinishProfiledCommand(queryDesc);
+	}
+}
+
+
+static void
+ProfilerExecutorFinish(QueryDesc *queryDesc)
+{
+	ExecutorNestingLevel++;
+	PG_TRY();
+	{
+		if (PreviousExecutorFinishHook != NULL)
+		{
+			PreviousExecutorFinishHook(queryDesc);
+		}
+		else
+		{
+			standard_ExecutorFinish(queryDesc);
+		}
+	}
+	PG_FINALLY();
+	{
+		ExecutorNestingLevel--;
+	}
+	PG_END_TRY();
+}
+
+
+static void
+ProfilerExecutorEnd(QueryDesc *queryDesc)
+{
+	if (CurrentCommand.isActive)
+	{
+		if (queryDesc == CurrentCommand.topLevelQueryDesc)
+		{
+			/* The statement ended without running to completion */
+			CurrentCommand.isActive = false;
+		}
+		else
+		{
+			CollectPlanStatistics(queryDesc);
+		}
+	}
+
+	if (PreviousExecutorEndHook != NULL)
+	{
+		PreviousExecutorEndHook(queryDesc);
+	}
+	else
+	{
+		standard_ExecutorEnd(queryDesc);
+	}
+}
+
+
+/*
+ * Starts profiling the command run by the top level statement if it is a
+ * profiled command on a database with a profiling level, or measuring it if
+ * the query stats are enabled. This runs for every top level statement so it
+ * bails out early when neither applies.
+ */
+static void
+TryBeginProfiledCommand(QueryDesc *queryDesc)
+{
+	bool recordQueryStats = IsQueryStatsEnabled();
+	bool hasProfiledDatabases =
+		EnableDatabaseProfiler && ProfilerState != NULL &&
+		pg_atomic_read_u32(&ProfilerState->numProfiledDatabases) > 0;
+	if ((!recordQueryStats && !hasProfiledDatabases) || queryDesc->sourceText == NULL)
+	{
+		return;
+	}
+
+	const ProfiledCommandType *commandType = DetectProfiledCommand(
+		queryDesc->sourceText);
+	if (commandType == NULL)
+	{
+		return;
+	}
+
+	ParamListInfo params = queryDesc->params;
+	if (params == NULL || params->numParams < 2 || params->paramFetch != NULL ||
+		params->params[0].isnull || params->params[0].ptype != TEXTOID ||
+		params->params[1].isnull)
+	{
+		return;
+	}
+
+	char databaseName[MAX_DATABASE_NAME_LENGTH];
+	text_to_cstring_buffer(DatumGetTextPP(params->params[0].value), databaseName,
+						   MAX_DATABASE_NAME_LENGTH);
+
+	ProfilerDatabaseSettings settings = { 0 };
+	if (!hasProfiledDatabases || !GetDatabaseProfilingSettings(databaseName, &settings) ||
+		(settings.sampleRate < 1.0 &&
+		 pg_prng_double(&pg_global_prng_state) >= settings.sampleRate))
+	{
+		settings.level = 0;
+	}
+
+	if (settings.level == 0 && !recordQueryStats)
+	{
+		return;
+	}
+
+	if (ProfilerMemoryContext == NULL)
+	{
+		ProfilerMemoryContext = AllocSetContextCreate(TopMemoryContext,
+													  "DatabaseProfilerContext",
+													  ALLOCSET_SMALL_SIZES);
+	}
+	else
+	{
+		MemoryContextReset(ProfilerMemoryContext);
+	}
+
+	memset(&CurrentCommand, 0, sizeof(ProfiledCommand));
+	CurrentCommand.commandType = commandType;
+	CurrentCommand.topLevelQueryDesc = queryDesc;
+	CurrentCommand.level = settings.level;
+	CurrentCommand.slowMs = settings.slowMs;
+	CurrentCommand.recordQueryStats = recordQueryStats;
+	strlcpy(CurrentCommand.databaseName, databaseName, MAX_DATABASE_NAME_LENGTH);
+
+	INSTR_TIME_SET_CURRENT(CurrentCommand.startTime);
+	if (CurrentCommand.level > 0)
+	{
+		getrusage(RUSAGE_SELF, &CurrentCommand.startUsage);
+	}
+
+	CurrentCommand.startBufferUsage = pgBufferUsage;
+	CurrentCommand.startPlanCacheHits = QueryPlanCacheHitCount;
+	CurrentCommand.isActive = true;
+}
+
+
+/*
+ * Returns the profiled command the statement runs, as current_op.c detects
+ * it, or NULL if it does not run one.
+ */
+static const ProfiledCommandType *
+DetectProfiledCommand(const char *sourceText)
+{
+	size_t schemaLength = strlen(ApiSchemaName);
+	const char *schemaStart = strstr(sourceText, ApiSchemaName);
+	while (schemaStart != NULL)
+	{
+		const char *functionCall = schemaStart + schemaLength;
+		for (int i = 0; i < ProfiledCommandTypesCount; i++)
+		{
+			const char *expected = ProfiledCommandTypes[i].functionCall;
+			if (strncmp(functionCall, expected, strlen(expected)) == 0)
+			{
+				return &ProfiledCommandTypes[i];
+			}
+		}
+
+		schemaStart = strstr(functionCall, ApiSchemaName);
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Gets the profiling settings of a database, returns false if the database
+ * is not profiled.
+ */
+static bool
+GetDatabaseProfilingSettings(const char *databaseName,
+							 ProfilerDatabaseSettings *settings)
+{
+	bool found = false;
+	LWLockAcquire(&ProfilerState->settingsLock, LW_SHARED);
+	for (int i = 0; i < PROFILER_MAX_DATABASES; i++)
+	{
+		ProfilerDatabaseSettings *databaseSettings = &ProfilerState->databases[i];
+		if (databaseSettings->level > 0 &&
+			strcmp(databaseSettings->databaseName, databaseName) == 0)
+		{
+			*settings = *databaseSettings;
+			found = true;
+			break;
+		}
+	}
+	LWLockRelease(&ProfilerState->settingsLock);
+
+	return found;
+}
+
+
+/*
+ * Sets the profiling settings of a database. Level 0 frees the slot of the
+ * database.
+ */
+static void
+SetDatabaseProfilingSettings(const ProfilerDatabaseSettings *settings)
+{
+	LWLockAcquire(&ProfilerState->settingsLock, LW_EXCLUSIVE);
+
+	ProfilerDatabaseSettings *slot = NULL;
+	ProfilerDatabaseSettings *freeSlot = NULL;
+	for (int i = 0; i < PROFILER_MAX_DATABASES; i++)
+	{
+		ProfilerDatabaseSettings *databaseSettings = &ProfilerState->databases[i];
+		if (databaseSettings->level == 0)
+		{
+			freeSlot = freeSlot == NULL ? databaseSettings : freeSlot;
+		}
+		else if (strcmp(databaseSettings->databaseName, settings->databaseName) == 0)
+		{
+			slot = databaseSettings;
+			break;
+		}
+	}
+
+	if (slot == NULL && settings->level > 0)
+	{
+		if (freeSlot == NULL)
+		{
+			LWLockRelease(&ProfilerState->settingsLock);
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_EXCEEDEDMEMORYLIMIT),
+							errmsg("Profiling can be enabled on at most %d databases",
+								   PROFILER_MAX_DATABASES)));
+		}
+
+		slot = freeSlot;
+		pg_atomic_fetch_add_u32(&ProfilerState->numProfiledDatabases, 1);
+	}
+	else if (slot != NULL && settings->level == 0)
+	{
+		pg_atomic_fetch_sub_u32(&ProfilerState->numProfiledDatabases, 1);
+	}
+
+	if (slot != NULL)
+	{
+		*slot = *settings;
+	}
+
+	LWLockRelease(&ProfilerState->settingsLock);
+}
+
+
+/*
+ * Adds the plan of a nested query of the profiled command to its summary if
+ * the query reads a collection.
+ */
+static void
+CollectPlanStatistics(QueryDesc *queryDesc)
+{
+	if (queryDesc->planstate == NULL || queryDesc->planstate->instrument == NULL ||
+		!PlanReadsCollection(queryDesc->plannedstmt))
+	{
+		return;
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(ProfilerMemoryContext);
+	CollectStageStatisticsWalker(queryDesc->planstate, NULL);
+	MemoryContextSwitchTo(oldContext);
+
+	/* The first query on a collection is the one that returns the results */
+	if (!CurrentCommand.hasReturnedCount)
+	{
+		CurrentCommand.nreturned = queryDesc->planstate->instrument->ntuples;
+		CurrentCommand.hasReturnedCount = true;
+	}
+}
+
+
+static bool
+PlanReadsCollection(PlannedStmt *plannedStmt)
+{
+	if (plannedStmt == NULL)
+	{
+		return false;
+	}
+
+	Oid dataNamespaceId = ApiDataNamespaceOid();
+	ListCell *rteCell;
+	foreach(rteCell, plannedStmt->rtable)
+	{
+		RangeTblEntry *rte = lfirst(rteCell);
+		if (rte->rtekind == RTE_RELATION &&
+			get_rel_namespace(rte->relid) == dataNamespaceId)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * Records every plan node as a stage of the command, with the keys and
+ * documents examined by the scans.
+ */
+static bool
+CollectStageStatisticsWalker(PlanState *planState, void *context)
+{
+	Instrumentation *instrument = planState->instrument;
+	if (instrument == NULL)
+	{
+		return planstate_tree_walker(planState, CollectStageStatisticsWalker, context);
+	}
+
+	InstrEndLoop(instrument);
+
+	const char *stage = "STAGE";
+	Oid indexId = InvalidOid;
+	double examined = instrument->ntuples + instrument->nfiltered1;
+	switch (nodeTag(planState))
+	{
+		case T_SeqScanState:
+		{
+			stage = "COLLSCAN";
+			CurrentCommand.docsExamined += examined;
+			break;
+		}
+
+		case T_IndexScanState:
+		{
+			stage = "IXSCAN";
+			indexId = ((IndexScan *) planState->plan)->indexid;
+			CurrentCommand.keysExamined += examined;
+			CurrentCommand.docsExamined += examined;
+			break;
+		}
+
+		case T_IndexOnlyScanState:
+		{
+			stage = "IXSCAN";
+			indexId = ((IndexOnlyScan *) planState->plan)->indexid;
+			CurrentCommand.keysExamined += examined;
+			break;
+		}
+
+		case T_BitmapIndexScanState:
+		{
+			stage = "IXSCAN";
+			indexId = ((BitmapIndexScan *) planState->plan)->indexid;
+			CurrentCommand.keysExamined += instrument->ntuples;
+			break;
+		}
+
+		case T_BitmapHeapScanState:
+		{
+			stage = "FETCH";
+			CurrentCommand.docsExamined += examined + instrument->nfiltered2;
+			break;
+		}
+
+		case T_SortState:
+		case T_IncrementalSortState:
+		{
+			stage = "SORT";
+			break;
+		}
+
+		case T_LimitState:
+		{
+			stage = "LIMIT";
+			break;
+		}
+
+		case T_AggState:
+		{
+			stage = "GROUP";
+			break;
+		}
+
+		case T_WindowAggState:
+		{
+			stage = "SETWINDOWFIELDS";
+			break;
+		}
+
+		case T_NestLoopState:
+		case T_HashJoinState:
+		case T_MergeJoinState:
+		{
+			stage = "JOIN";
+			break;
+		}
+
+		case T_ModifyTableState:
+		{
+			stage = "WRITE";
+			break;
+		}
+
+		case T_ResultState:
+		case T_ProjectSetState:
+		{
+			stage = "PROJECTION";
+			break;
+		}
+
+		case T_SubqueryScanState:
+		case T_CteScanState:
+		case T_FunctionScanState:
+		{
+			stage = "SUBQUERY";
+			break;
+		}
+
+		case T_CustomScanState:
+		{
+			stage = ((CustomScanState *) planState)->methods->CustomName;
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
+	}
+
+	if (CurrentCommand.level == 0)
+	{
+		/* Only the counts are needed for the query stats */
+	}
+	else if (CurrentCommand.numStages < PROFILER_MAX_STAGES)
+	{
+		ProfiledStage *profiledStage = &CurrentCommand.stages[CurrentCommand.numStages++];
+		profiledStage->stage = stage;
+		profiledStage->rows = instrument->ntuples;
+		profiledStage->loops = instrument->nloops;
+		profiledStage->totalMicros = instrument->total * 1000000.0;
+		if (OidIsValid(indexId))
+		{
+			const char *indexName = ExtensionExplainGetIndexName(indexId);
+			profiledStage->indexName = indexName != NULL ? pstrdup(indexName) :
+									   get_rel_name(indexId);
+		}
+	}
+	else
+	{
+		CurrentCommand.numOmittedStages++;
+	}
+
+	return planstate_tree_walker(planState, CollectStageStatisticsWalker, context);
+}
+
+
+/*
+ * Measures the command that just completed, adds it to the query stats and,
+ * if it qualifies for the profiling level of its database, writes its
+ * profile document to the ring.
+ */
+static void
+FinishProfiledCommand(QueryDesc *queryDesc)
+{
+	instr_time duration;
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, CurrentCommand.startTime);
+
+	ProfiledCommandMetrics metrics = { 0 };
+	metrics.durationMicros = INSTR_TIME_GET_MICROSEC(duration);
+	bool writeProfileEntry =
+		CurrentCommand.level == 2 ||
+		(CurrentCommand.level == 1 &&
+		 metrics.durationMicros >= (uint64) CurrentCommand.slowMs * 1000);
+	if (!writeProfileEntry && !CurrentCommand.recordQueryStats)
+	{
+		return;
+	}
+
+	BufferUsage bufferUsage;
+	memset(&bufferUsage, 0, sizeof(BufferUsage));
+	BufferUsageAccumDiff(&bufferUsage, &pgBufferUsage,
+						 &CurrentCommand.startBufferUsage);
+
+	pgbson *commandSpec = DatumGetPgBson(queryDesc->params->params[1].value);
+	QueryShape queryShape;
+	BuildQueryShape(CurrentCommand.databaseName,
+					CurrentCommand.commandType->commandName, commandSpec, &queryShape);
+
+	if (CurrentCommand.recordQueryStats)
+	{
+		QueryStatsMeasurements measurements = {
+			.durationMicros = metrics.durationMicros,
+			.keysExamined = (uint64) CurrentCommand.keysExamined,
+			.docsExamined = (uint64) CurrentCommand.docsExamined,
+			.docsReturned = (uint64) CurrentCommand.nreturned,
+			.planCacheHits = QueryPlanCacheHitCount - CurrentCommand.startPlanCacheHits,
+			.spillBytes = (uint64) bufferUsage.temp_blks_written * BLCKSZ
+		};
+		RecordQueryStats(&queryShape, &measurements);
+	}
+
+	if (!writeProfileEntry)
+	{
+		return;
+	}
+
+	struct rusage endUsage;
+	getrusage(RUSAGE_SELF, &endUsage);
+	int64 cpuMicros =
+		(endUsage.ru_utime.tv_sec - CurrentCommand.startUsage.ru_utime.tv_sec) *
+		INT64CONST(1000000) +
+		(endUsage.ru_utime.tv_usec - CurrentCommand.startUsage.ru_utime.tv_usec) +
+		(endUsage.ru_stime.tv_sec - CurrentCommand.startUsage.ru_stime.tv_sec) *
+		INT64CONST(1000000) +
+		(endUsage.ru_stime.tv_usec - CurrentCommand.startUsage.ru_stime.tv_usec);
+	metrics.cpuMicros = Max(cpuMicros, 0);
+
+#if PG_VERSION_NUM >= 170000
+	instr_time ioTime = bufferUsage.shared_blk_read_time;
+	INSTR_TIME_ADD(ioTime, bufferUsage.shared_blk_write_time);
+	INSTR_TIME_ADD(ioTime, bufferUsage.local_blk_read_time);
+	INSTR_TIME_ADD(ioTime, bufferUsage.local_blk_write_time);
+#else
+	instr_time ioTime = bufferUsage.blk_read_time;
+	INSTR_TIME_ADD(ioTime, bufferUsage.blk_write_time);
+#endif
+	INSTR_TIME_ADD(ioTime, bufferUsage.temp_blk_read_time);
+	INSTR_TIME_ADD(ioTime, bufferUsage.temp_blk_write_time);
+	metrics.ioWaitMicros = INSTR_TIME_GET_MICROSEC(ioTime);
+
+	uint64 busyMicros = metrics.cpuMicros + metrics.ioWaitMicros;
+	metrics.waitMicros = metrics.durationMicros > busyMicros ?
+						 metrics.durationMicros - busyMicros : 0;
+	metrics.bytesRead = (bufferUsage.shared_blks_read + bufferUsage.local_blks_read +
+						 bufferUsage.temp_blks_read) * (int64) BLCKSZ;
+	metrics.bytesWritten = (bufferUsage.shared_blks_written +
+							bufferUsage.local_blks_written +
+							bufferUsage.temp_blks_written) * (int64) BLCKSZ;
+
+	/* Drop what does not fit in a ring slot, the command first */
+	pgbson *document = BuildProfileDocument(commandSpec, &queryShape, &metrics,
+											true, true);
+	if (VARSIZE(document) > PROFILER_ENTRY_MAX_SIZE)
+	{
+		document = BuildProfileDocument(commandSpec, &queryShape, &metrics, false,
+										true);
+	}
+
+	if (VARSIZE(document) > PROFILER_ENTRY_MAX_SIZE)
+	{
+		document = BuildProfileDocument(commandSpec, &queryShape, &metrics, false,
+										false);
+	}
+
+	if (VARSIZE(document) > PROFILER_ENTRY_MAX_SIZE)
+	{
+		pg_atomic_fetch_add_u64(&ProfilerState->droppedEntries, 1);
+		return;
+	}
+
+	WriteProfileEntry(CurrentCommand.databaseName, document);
+}
+
+
+/*
+ * Builds the system.profile document of the current command.
+ */
+static pgbson *
+BuildProfileDocument(pgbson *commandSpec, QueryShape *queryShape,
+					 ProfiledCommandMetrics *metrics, bool includeCommand,
+					 bool includeStages)
+{
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+
+	PgbsonWriterAppendUtf8(&writer, "op", 2, CurrentCommand.commandType->op);
+
+	const char *ns = psprintf("%s.%s", CurrentCommand.databaseName,
+							  queryShape->collectionName != NULL ?
+							  queryShape->collectionName : "$cmd");
+	PgbsonWriterAppendUtf8(&writer, "ns", 2, ns);
+
+	if (includeCommand)
+	{
+		PgbsonWriterAppendDocument(&writer, "command", 7, commandSpec);
+	}
+	else
+	{
+		PgbsonWriterAppendBool(&writer, "commandTruncated", 16, true);
+	}
+
+	PgbsonWriterAppendUtf8(&writer, "queryShapeHash", 14,
+						   QueryShapeHashToString(queryShape->shapeHash));
+	PgbsonWriterAppendDocument(&writer, "queryShape", 10, queryShape->shape);
+
+	char *planSummary = BuildPlanSummary();
+	if (planSummary != NULL)
+	{
+		PgbsonWriterAppendUtf8(&writer, "planSummary", 11, planSummary);
+	}
+
+	PgbsonWriterAppendInt64(&writer, "keysExamined", 12,
+							(int64) CurrentCommand.keysExamined);
+	PgbsonWriterAppendInt64(&writer, "docsExamined", 12,
+							(int64) CurrentCommand.docsExamined);
+	PgbsonWriterAppendInt64(&writer, "nreturned", 9, (int64) CurrentCommand.nreturned);
+
+	if (includeStages && CurrentCommand.numStages > 0)
+	{
+		pgbson_array_writer stagesWriter;
+		PgbsonWriterStartArray(&writer, "execStages", 10, &stagesWriter);
+		for (int i = 0; i < CurrentCommand.numStages; i++)
+		{
+			ProfiledStage *stage = &CurrentCommand.stages[i];
+
+			pgbson_writer stageWriter;
+			PgbsonArrayWriterStartDocument(&stagesWriter, &stageWriter);
+			PgbsonWriterAppendUtf8(&stageWriter, "stage", 5, stage->stage);
+			if (stage->indexName != NULL)
+			{
+				PgbsonWriterAppendUtf8(&stageWriter, "indexName", 9, stage->indexName);
+			}
+
+			PgbsonWriterAppendInt64(&stageWriter, "nReturned", 9, (int64) stage->rows);
+			PgbsonWriterAppendInt64(&stageWriter, "loops", 5, (int64) stage->loops);
+			if (DatabaseProfilerCaptureStageTimings)
+			{
+				PgbsonWriterAppendInt64(&stageWriter, "executionTimeMicros", 19,
+										(int64) stage->totalMicros);
+			}
+
+			PgbsonArrayWriterEndDocument(&stagesWriter, &stageWriter);
+		}
+		PgbsonWriterEndArray(&writer, &stagesWriter);
+
+		if (CurrentCommand.numOmittedStages > 0)
+		{
+			PgbsonWriterAppendInt32(&writer, "execStagesOmitted", 17,
+									CurrentCommand.numOmittedStages);
+		}
+	}
+
+	PgbsonWriterAppendInt64(&writer, "cpuMicros", 9, metrics->cpuMicros);
+	PgbsonWriterAppendInt64(&writer, "ioWaitMicros", 12, metrics->ioWaitMicros);
+	PgbsonWriterAppendInt64(&writer, "waitMicros", 10, metrics->waitMicros);
+	PgbsonWriterAppendInt64(&writer, "bytesRead", 9, metrics->bytesRead);
+	PgbsonWriterAppendInt64(&writer, "bytesWritten", 12, metrics->bytesWritten);
+	PgbsonWriterAppendInt64(&writer, "millis", 6, metrics->durationMicros / 1000);
+	PgbsonWriterAppendInt64(&writer, "durationMicros", 14, metrics->durationMicros);
+	PgbsonWriterAppendDateTime(&writer, "ts", 2, GetCurrentTimestamp());
+
+	const char *userName = GetUserNameFromId(GetUserId(), true);
+	if (userName != NULL)
+	{
+		PgbsonWriterAppendUtf8(&writer, "user", 4, userName);
+	}
+
+	return PgbsonWriterGetPgbson(&writer);
+}
+
+
+/*
+ * Builds the plan summary of the command, e.g. "IXSCAN { a_1 }, COLLSCAN",
+ * or NULL if none of its queries scanned a collection.
+ */
+static char *
+BuildPlanSummary(void)
+{
+	StringInfoData summary;
+	initStringInfo(&summary);
+
+	bool hasCollectionScan = false;
+	for (int i = 0; i < CurrentCommand.numStages; i++)
+	{
+		ProfiledStage *stage = &CurrentCommand.stages[i];
+		const char *stageSummary = NULL;
+		if (strcmp(stage->stage, "COLLSCAN") == 0 && !hasCollectionScan)
+		{
+			hasCollectionScan = true;
+			stageSummary = "COLLSCAN";
+		}
+		else if (strcmp(stage->stage, "IXSCAN") == 0 && stage->indexName != NULL)
+		{
+			stageSummary = psprintf("IXSCAN { %s }", stage->indexName);
+			if (strstr(summary.data, stageSummary) != NULL)
+			{
+				stageSummary = NULL;
+			}
+		}
+
+		if (stageSummary != NULL)
+		{
+			appendStringInfo(&summary, "%s%s", summary.len > 0 ? ", " : "",
+							 stageSummary);
+		}
+	}
+
+	return summary.len > 0 ? summary.data : NULL;
+}
+
+
+/*
+ * Copies a profile document into the next slot of the ring.
+ */
+static void
+WriteProfileEntry(const char *databaseName, pgbson *document)
+{
+	uint64 position = pg_atomic_fetch_add_u64(&ProfilerState->writePosition, 1);
+	ProfilerRingEntry *entry =
+		&ProfilerState->entries[position % DatabaseProfilerRingBufferEntries];
+
+	SpinLockAcquire(&entry->mutex);
+	entry->pgDatabaseId = MyDatabaseId;
+	strlcpy(entry->databaseName, databaseName, MAX_DATABASE_NAME_LENGTH);
+	entry->documentSize = VARSIZE(document);
+	memcpy(entry->document, document, entry->documentSize);
+	entry->position = position + 1;
+	SpinLockRelease(&entry->mutex);
+}
+
+
+/*
+ * Copies the entries of this Postgres database out of the ring and advances
+ * its read position past them. Entries overwritten before they were read are
+ * counted as dropped. Reading stops at a slot that a writer claimed but has
+ * not filled yet, it is read on the next flush.
+ */
+static List *
+ReadProfileEntries(void)
+{
+	List *entries = NIL;
+	uint64 ringSize = (uint64) DatabaseProfilerRingBufferEntries;
+
+	LWLockAcquire(&ProfilerState->flushLock, LW_EXCLUSIVE);
+
+	uint64 writePosition = pg_atomic_read_u64(&ProfilerState->writePosition);
+	uint64 position = ProfilerState->readPosition;
+	if (writePosition - position > ringSize)
+	{
+		pg_atomic_fetch_add_u64(&ProfilerState->droppedEntries,
+								writePosition - position - ringSize);
+		position = writePosition - ringSize;
+	}
+
+	for (; position < writePosition; position++)
+	{
+		ProfilerRingEntry *entry = &ProfilerState->entries[position % ringSize];
+
+		SpinLockAcquire(&entry->mutex);
+		if (entry->position < position + 1)
+		{
+			SpinLockRelease(&entry->mutex);
+			break;
+		}
+
+		if (entry->position == position + 1 && entry->pgDatabaseId == MyDatabaseId)
+		{
+			ProfileEntryCopy *entryCopy = palloc(sizeof(ProfileEntryCopy));
+			memcpy(entryCopy->databaseName, entry->databaseName,
+				   MAX_DATABASE_NAME_LENGTH);
+			entryCopy->document = palloc(entry->documentSize);
+			memcpy(entryCopy->document, entry->document, entry->documentSize);
+			entries = lappend(entries, entryCopy);
+		}
+		else if (entry->position > position + 1)
+		{
+			pg_atomic_fetch_add_u64(&ProfilerState->droppedEntries, 1);
+		}
+		SpinLockRelease(&entry->mutex);
+	}
+
+	ProfilerState->readPosition = position;
+	LWLockRelease(&ProfilerState->flushLock);
+
+	return entries;
+}
+
+
+static MongoCollection *
+GetOrCreateProfileCollection(const char *databaseName)
+{
+	Datum databaseNameDatum = CStringGetTextDatum(databaseName);
+	Datum collectionNameDatum = CStringGetTextDatum(PROFILE_COLLECTION_NAME);
+
+	MongoCollection *collection = GetMongoCollectionByNameDatum(databaseNameDatum,
+																collectionNameDatum,
+																RowExclusiveLock);
+	if (collection != NULL)
+	{
+		return collection;
+	}
+
+	CreateCollection(databaseNameDatum, collectionNameDatum);
+	collection = GetMongoCollectionByNameDatum(databaseNameDatum, collectionNameDatum,
+											   RowExclusiveLock);
+	if (collection == NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Unable to create the profile collection of %s",
+							   databaseName)));
+	}
+
+	return collection;
+}
+
+
+/*
+ * Deletes the oldest documents of a system.profile collection beyond
+ * documentdb.maxProfileCollectionDocuments. The _id of the documents are
+ * ObjectIds generated when they were flushed, so they order by age.
+ */
+static void
+TrimProfileCollection(MongoCollection *collection)
+{
+	const char *query =
+		FormatSqlQuery("DELETE FROM %s.documents_" UINT64_FORMAT
+					   " WHERE object_id OPERATOR(%s.<=) (SELECT object_id FROM %s.documents_"
+					   UINT64_FORMAT " ORDER BY object_id DESC OFFSET $1 LIMIT 1)",
+					   ApiDataSchemaName, collection->collectionId, CoreSchemaName,
+					   ApiDataSchemaName, collection->collectionId);
+
+	int nargs = 1;
+	Oid argTypes[1] = { INT8OID };
+	Datum argValues[1] = { Int64GetDatum(MaxProfileCollectionDocuments) };
+
+	bool readOnly = false;
+	bool isNull = false;
+	ExtensionExecuteQueryWithArgsViaSPI(query, nargs, argTypes, argValues, NULL,
+										readOnly, SPI_OK_DELETE, &isNull);
+}
+
+
+/*
+ * Returns the flush interval, or 0 to skip starting the flush job, and the
+ * backend it runs in, while nothing was written to the ring since its last
+ * run.
+ */
+static int
+GetDatabaseProfilerScheduleInSec(void)
+{
+	/* Shared memory is not set up yet when the job is registered */
+	if (ProfilerState == NULL || !IsUnderPostmaster)
+	{
+		return DatabaseProfilerFlushIntervalSec;
+	}
+
+	LWLockAcquire(&ProfilerState->flushLock, LW_SHARED);
+	bool hasPendingEntries = pg_atomic_read_u64(&ProfilerState->writePosition) !=
+							 ProfilerState->readPosition;
+	LWLockRelease(&ProfilerState->flushLock);
+
+	return hasPendingEntries ? DatabaseProfilerFlushIntervalSec : 0;
+}
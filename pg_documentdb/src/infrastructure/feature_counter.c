@@ -428,6 +428,7 @@ static char FeatureMapping[MAX_FEATURE_COUNT][MAX_FEATURE_NAME_LENGTH] = {
 	[FEATURE_STAGE_OUT] = "out",
 	[FEATURE_STAGE_PROJECT] = "project",
 	[FEATURE_STAGE_PROJECT_FIND] = "project_find",
+	[FEATURE_STAGE_QUERY_STATS] = "query_stats_agg",
 	[FEATURE_STAGE_REDACT] = "redact",
 	[FEATURE_STAGE_REPLACE_ROOT] = "replace_root",
 	[FEATURE_STAGE_REPLACE_WITH] = "replace_with",
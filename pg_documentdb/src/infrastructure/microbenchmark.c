@@ -0,0 +1,382 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/infrastructure/microbenchmark.c
+ *
+ * Microbenchmarks of the core bson primitives, aggregation expression
+ * operators, query operators and index term generation.
+ *
+ * documentdb_microbenchmark runs one benchmark over a set of documents a
+ * number of times and returns the timings as a bson document, so that
+ * results can be compared across builds. The functions are not part of the
+ * extension schema: the driver in src/test/microbenchmark declares them.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <postgres.h>
+#include <fmgr.h>
+#include <miscadmin.h>
+#include <portability/instr_time.h>
+#include <utils/array.h>
+#include <utils/builtins.h>
+#include <utils/memutils.h>
+
+#include "io/bson_core.h"
+#include "query/bson_compare.h"
+#include "operators/bson_expression.h"
+#include "operators/bson_expr_eval.h"
+#include "opclass/bson_gin_private.h"
+#include "opclass/bson_gin_index_mgmt.h"
+#include "utils/documentdb_errors.h"
+
+/*
+ * State of a benchmark, prepared once from the spec and reused across the
+ * documents and iterations.
+ */
+typedef struct MicrobenchmarkState
+{
+	/* The parsed expression of the "expression" benchmark */
+	AggregationExpressionData expression;
+
+	/* The compiled filter of the "query" benchmark */
+	ExprEvalState *queryState;
+
+	/* The index options of the "index_terms" benchmark */
+	BsonGinSinglePathOptions *indexOptions;
+
+	/* Folds the results so that the work is not optimized away */
+	uint64 checksum;
+} MicrobenchmarkState;
+
+typedef void (*PrepareMicrobenchmarkFunc)(MicrobenchmarkState *state,
+										  pgbson *spec);
+typedef void (*RunMicrobenchmarkFunc)(MicrobenchmarkState *state,
+									  pgbson **documents, int numDocuments);
+
+typedef struct MicrobenchmarkDefinition
+{
+	const char *name;
+	PrepareMicrobenchmarkFunc prepareFunc;
+	RunMicrobenchmarkFunc runFunc;
+} MicrobenchmarkDefinition;
+
+
+static void RunBsonCompare(MicrobenchmarkState *state, pgbson **documents,
+						   int numDocuments);
+static void RunBsonHash(MicrobenchmarkState *state, pgbson **documents,
+						int numDocuments);
+static void RunWriterAppend(MicrobenchmarkState *state, pgbson **documents,
+							int numDocuments);
+static void PrepareExpression(MicrobenchmarkState *state, pgbson *spec);
+static void RunExpression(MicrobenchmarkState *state, pgbson **documents,
+						  int numDocuments);
+static void PrepareQuery(MicrobenchmarkState *state, pgbson *spec);
+static void RunQuery(MicrobenchmarkState *state, pgbson **documents,
+					 int numDocuments);
+static void PrepareIndexTerms(MicrobenchmarkState *state, pgbson *spec);
+static void RunIndexTerms(MicrobenchmarkState *state, pgbson **documents,
+						  int numDocuments);
+static bson_value_t GetMicrobenchmarkSpecValue(pgbson *spec, const char *field);
+
+static const MicrobenchmarkDefinition Microbenchmarks[] = {
+	{ "bson_compare", NULL, RunBsonCompare },
+	{ "bson_hash", NULL, RunBsonHash },
+	{ "writer_append", NULL, RunWriterAppend },
+	{ "expression", PrepareExpression, RunExpression },
+	{ "query", PrepareQuery, RunQuery },
+	{ "index_terms", PrepareIndexTerms, RunIndexTerms },
+};
+
+PG_FUNCTION_INFO_V1(documentdb_microbenchmark);
+
+
+/*
+ * documentdb_microbenchmark(benchmark text, documents bson[], spec bson,
+ *                           iterations int4) RETURNS bson
+ *
+ * Runs the benchmark over all the documents, iterations times, and returns
+ * { benchmark, iterations, operations, totalNanos, nanosPerOperation,
+ * checksum }.
+ * Every iteration runs in a memory context that is reset afterwards so that
+ * memory use does not grow with the iterations.
+ */
+Datum
+documentdb_microbenchmark(PG_FUNCTION_ARGS)
+{
+	char *benchmarkName = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	ArrayType *documentArray = PG_GETARG_ARRAYTYPE_P(1);
+	pgbson *spec = PG_GETARG_PGBSON(2);
+	int32 iterations = PG_GETARG_INT32(3);
+
+	const MicrobenchmarkDefinition *definition = NULL;
+	for (size_t i = 0; i < lengthof(Microbenchmarks); i++)
+	{
+		if (strcmp(Microbenchmarks[i].name, benchmarkName) == 0)
+		{
+			definition = &Microbenchmarks[i];
+			break;
+		}
+	}
+
+	if (definition == NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("Unknown microbenchmark %s", benchmarkName)));
+	}
+
+	if (iterations <= 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("The number of iterations must be positive")));
+	}
+
+	Datum *documentDatums;
+	bool *documentNulls;
+	int numDocuments;
+	deconstruct_array(documentArray, ARR_ELEMTYPE(documentArray), -1, false,
+					  TYPALIGN_INT, &documentDatums, &documentNulls, &numDocuments);
+
+	pgbson **documents = palloc(sizeof(pgbson *) * Max(numDocuments, 1));
+	for (int i = 0; i < numDocuments; i++)
+	{
+		if (documentNulls[i])
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+							errmsg("Microbenchmark documents can not be null")));
+		}
+
+		documents[i] = DatumGetPgBson(documentDatums[i]);
+	}
+
+	MicrobenchmarkState state = { 0 };
+	if (definition->prepareFunc != NULL)
+	{
+		definition->prepareFunc(&state, spec);
+	}
+
+	MemoryContext iterationContext = AllocSetContextCreate(CurrentMemoryContext,
+														   "MicrobenchmarkContext",
+														   ALLOCSET_DEFAULT_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(iterationContext);
+
+	instr_time start;
+	instr_time end;
+	instr_time duration;
+	INSTR_TIME_SET_ZERO(duration);
+	for (int32 i = 0; i < iterations; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		INSTR_TIME_SET_CURRENT(start);
+		definition->runFunc(&state, documents, numDocuments);
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(duration, end, start);
+
+		MemoryContextReset(iterationContext);
+	}
+
+	MemoryContextSwitchTo(oldContext);
+	MemoryContextDelete(iterationContext);
+
+	if (state.queryState != NULL)
+	{
+		FreeExprEvalState(state.queryState, CurrentMemoryContext);
+	}
+
+	int64 operations = (int64) iterations * numDocuments;
+	double totalNanos = INSTR_TIME_GET_DOUBLE(duration) * 1000000000.0;
+
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+	PgbsonWriterAppendUtf8(&writer, "benchmark", 9, benchmarkName);
+	PgbsonWriterAppendInt32(&writer, "iterations", 10, iterations);
+	PgbsonWriterAppendInt64(&writer, "operations", 10, operations);
+	PgbsonWriterAppendDouble(&writer, "totalNanos", 10, totalNanos);
+	PgbsonWriterAppendDouble(&writer, "nanosPerOperation", 17,
+							 operations > 0 ? totalNanos / operations : 0);
+	PgbsonWriterAppendInt64(&writer, "checksum", 8, (int64) state.checksum);
+	PG_RETURN_POINTER(PgbsonWriterGetPgbson(&writer));
+}
+
+
+/*
+ * Compares every document with the next one.
+ */
+static void
+RunBsonCompare(MicrobenchmarkState *state, pgbson **documents, int numDocuments)
+{
+	for (int i = 0; i < numDocuments; i++)
+	{
+		bson_value_t left = ConvertPgbsonToBsonValue(documents[i]);
+		bson_value_t right = ConvertPgbsonToBsonValue(
+			documents[(i + 1) % numDocuments]);
+
+		bool isComparisonValid = false;
+		state->checksum += CompareBsonValueAndType(&left, &right, &isComparisonValid);
+	}
+}
+
+
+/*
+ * Hashes every document.
+ */
+static void
+RunBsonHash(MicrobenchmarkState *state, pgbson **documents, int numDocuments)
+{
+	for (int i = 0; i < numDocuments; i++)
+	{
+		bson_value_t value = ConvertPgbsonToBsonValue(documents[i]);
+		state->checksum += BsonValueHash(&value, 0);
+	}
+}
+
+
+/*
+ * Rewrites every document field by field.
+ */
+static void
+RunWriterAppend(MicrobenchmarkState *state, pgbson **documents, int numDocuments)
+{
+	for (int i = 0; i < numDocuments; i++)
+	{
+		bson_iter_t documentIterator;
+		PgbsonInitIterator(documents[i], &documentIterator);
+
+		pgbson_writer writer;
+		PgbsonWriterInit(&writer);
+		while (bson_iter_next(&documentIterator))
+		{
+			PgbsonWriterAppendValue(&writer, bson_iter_key(&documentIterator),
+									bson_iter_key_len(&documentIterator),
+									bson_iter_value(&documentIterator));
+		}
+
+		state->checksum += PgbsonGetBsonSize(PgbsonWriterGetPgbson(&writer));
+	}
+}
+
+
+/*
+ * Parses { "expression": <aggregation expression> }.
+ */
+static void
+PrepareExpression(MicrobenchmarkState *state, pgbson *spec)
+{
+	bson_value_t expression = GetMicrobenchmarkSpecValue(spec, "expression");
+	ParseAggregationExpressionContext parseContext = { 0 };
+	ParseAggregationExpressionData(&state->expression, &expression, &parseContext);
+}
+
+
+/*
+ * Evaluates the expression against every document.
+ */
+static void
+RunExpression(MicrobenchmarkState *state, pgbson **documents, int numDocuments)
+{
+	StringView path = { .string = "r", .length = 1 };
+	for (int i = 0; i < numDocuments; i++)
+	{
+		pgbson_writer writer;
+		PgbsonWriterInit(&writer);
+		EvaluateAggregationExpressionDataToWriter(&state->expression, documents[i],
+												  path, &writer, NULL, false);
+		state->checksum += PgbsonWriterGetSize(&writer);
+	}
+}
+
+
+/*
+ * Compiles { "filter": <query filter> } into the bson_dollar_* operators.
+ */
+static void
+PrepareQuery(MicrobenchmarkState *state, pgbson *spec)
+{
+	bson_value_t filter = GetMicrobenchmarkSpecValue(spec, "filter");
+	if (filter.value_type != BSON_TYPE_DOCUMENT)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("Microbenchmark filter must be a document")));
+	}
+
+	bool hasOperatorRestrictions = false;
+	state->queryState = GetExpressionEvalStateForBsonInput(&filter,
+														   CurrentMemoryContext,
+														   hasOperatorRestrictions);
+}
+
+
+/*
+ * Matches the filter against every document.
+ */
+static void
+RunQuery(MicrobenchmarkState *state, pgbson **documents, int numDocuments)
+{
+	for (int i = 0; i < numDocuments; i++)
+	{
+		bson_value_t document = ConvertPgbsonToBsonValue(documents[i]);
+		state->checksum += EvalBooleanExpressionAgainstBson(state->queryState,
+															&document);
+	}
+}
+
+
+/*
+ * Builds single path index options for { "path": <index path> }, the same
+ * way gin_bson_get_single_path_generated_terms does.
+ */
+static void
+PrepareIndexTerms(MicrobenchmarkState *state, pgbson *spec)
+{
+	bson_value_t path = GetMicrobenchmarkSpecValue(spec, "path");
+	if (path.value_type != BSON_TYPE_UTF8)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("Microbenchmark index path must be a string")));
+	}
+
+	const char *pathString = pnstrdup(path.value.v_utf8.str, path.value.v_utf8.len);
+	Size fieldSize = FillSinglePathSpec(pathString, NULL);
+	BsonGinSinglePathOptions *options = palloc0(fieldSize +
+												sizeof(BsonGinSinglePathOptions));
+	FillSinglePathSpec(pathString, ((char *) options) + sizeof(BsonGinSinglePathOptions));
+	options->path = sizeof(BsonGinSinglePathOptions);
+	options->isWildcard = false;
+	options->generateNotFoundTerm = false;
+	options->base.indexTermTruncateLimit = 0;
+	options->base.wildcardIndexTruncatedPathLimit = 0;
+	state->indexOptions = options;
+}
+
+
+/*
+ * Generates the index terms of every document.
+ */
+static void
+RunIndexTerms(MicrobenchmarkState *state, pgbson **documents, int numDocuments)
+{
+	for (int i = 0; i < numDocuments; i++)
+	{
+		GenerateTermsContext context = { 0 };
+		GinEntryPathData pathData = { 0 };
+		pathData.termMetadata = GetIndexTermMetadata(state->indexOptions);
+		GenerateSinglePathTermsCore(documents[i], &context, &pathData,
+									state->indexOptions);
+		state->checksum += pathData.terms.index;
+	}
+}
+
+
+static bson_value_t
+GetMicrobenchmarkSpecValue(pgbson *spec, const char *field)
+{
+	bson_iter_t specIterator;
+	if (!PgbsonInitIteratorAtPath(spec, field, &specIterator))
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("Microbenchmark spec requires the field %s", field)));
+	}
+
+	return *bson_iter_value(&specIterator);
+}
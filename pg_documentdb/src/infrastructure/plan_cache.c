@@ -66,6 +66,9 @@ static int CachedPlansCount = 0;
 /* number of entries allowed in the query plan cache */
 extern int QueryPlanCacheSizeLimit;
 
+/* number of lookups of this backend that found a cached plan */
+uint64 QueryPlanCacheHitCount = 0;
+
 
 /*
  * InitializeQueryPlanCache initalized the session-level query plan
@@ -185,6 +188,7 @@ GetSPIQueryPlanWithLocalShard(uint64 collectionId, const char *shardTableName, u
 		/* move entry to the tail of the queue */
 		dlist_delete(&entry->lruNode);
 		dlist_push_tail(&QueryPlanLRUQueue, &entry->lruNode);
+		QueryPlanCacheHitCount++;
 	}
 
 	return entry->plan;
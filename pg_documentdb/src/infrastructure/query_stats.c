@@ -0,0 +1,486 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/infrastructure/query_stats.c
+ *
+ * Implementation of the per query shape statistics returned by the
+ * $queryStats aggregation stage.
+ *
+ * Commands are grouped by their normalized query shape (see
+ * utils/query_shape.c) in a hash in shared memory. The executor hooks of the
+ * database profiler measure every command while documentdb.enableQueryStats
+ * is on and add the measurements to the entry of its shape: executions,
+ * latency, keys and documents examined, documents returned, plan cache hits
+ * and bytes spilled to disk.
+ *
+ * The hash holds at most documentdb.queryStatsMaxEntries shapes. When it is
+ * full, the least recently executed shapes are evicted in a batch so that the
+ * exclusive lock is taken rarely. The statistics are reset by
+ * ApiSchemaName.query_stats_reset() and on restart.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include <miscadmin.h>
+#include <fmgr.h>
+#include <funcapi.h>
+#include <port/atomics.h>
+#include <storage/lwlock.h>
+#include <storage/shmem.h>
+#include <storage/spin.h>
+#include <utils/hsearch.h>
+#include <utils/timestamp.h>
+
+#include "io/bson_core.h"
+#include "io/bson_set_returning_functions.h"
+#include "commands/commands_common.h"
+#include "commands/parse_error.h"
+#include "infrastructure/query_stats.h"
+#include "utils/documentdb_errors.h"
+
+extern bool EnableQueryStats;
+extern int QueryStatsMaxEntries;
+
+/* The largest query shape kept with the statistics */
+#define QUERY_STATS_MAX_SHAPE_SIZE 2048
+
+/* The percentage of the entries evicted when the hash is full */
+#define QUERY_STATS_EVICTION_PERCENT 5
+
+/* Shapes are grouped per Postgres database as the hash is server wide */
+typedef struct QueryStatsKey
+{
+	Oid pgDatabaseId;
+	uint64 shapeHash;
+} QueryStatsKey;
+
+/*
+ * The statistics of a query shape. The counters are protected by mutex, the
+ * rest of the entry by the lock of the hash.
+ */
+typedef struct QueryStatsEntry
+{
+	QueryStatsKey key;
+	slock_t mutex;
+
+	/* Value of the access clock at the last execution, for eviction */
+	uint64 lastUsed;
+
+	TimestampTz firstSeen;
+	TimestampTz lastSeen;
+	uint64 execCount;
+	uint64 totalMicros;
+	uint64 maxMicros;
+	uint64 lastExecutionMicros;
+	uint64 keysExamined;
+	uint64 docsExamined;
+	uint64 docsReturned;
+	uint64 planCacheHits;
+	uint64 spillBytes;
+
+	/* The shape document, shapeSize is 0 if it did not fit */
+	uint32 shapeSize;
+	char shape[QUERY_STATS_MAX_SHAPE_SIZE];
+} QueryStatsEntry;
+
+typedef struct QueryStatsSharedState
+{
+	int trancheId;
+	char *trancheName;
+
+	/* Protects the hash, writers to existing entries take it shared */
+	LWLock lock;
+
+	pg_atomic_uint64 accessClock;
+} QueryStatsSharedState;
+
+static QueryStatsSharedState *QueryStatsState = NULL;
+static HTAB *QueryStatsHash = NULL;
+
+static QueryStatsEntry * CreateQueryStatsEntry(const QueryStatsKey *key,
+											   const QueryShape *queryShape);
+static void EvictQueryStatsEntries(void);
+static int CompareQueryStatsEntryLastUsed(const void *left, const void *right);
+static pgbson * QueryStatsEntryToBson(const QueryStatsEntry *entry);
+
+
+/*
+ * Returns the amount of shared memory needed for the query stats.
+ */
+Size
+QueryStatsShmemSize(void)
+{
+	Size size = MAXALIGN(sizeof(QueryStatsSharedState));
+	if (QueryStatsMaxEntries > 0)
+	{
+		size = add_size(size, hash_estimate_size(QueryStatsMaxEntries,
+												 sizeof(QueryStatsEntry)));
+	}
+
+	return size;
+}
+
+
+/*
+ * Initializes the shared memory state and hash of the query stats.
+ */
+void
+InitializeQueryStatsShmem(void)
+{
+	bool found = false;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	QueryStatsState = (QueryStatsSharedState *) ShmemInitStruct(
+		"Query Stats State", sizeof(QueryStatsSharedState), &found);
+
+	if (!found)
+	{
+		QueryStatsState->trancheId = LWLockNewTrancheId();
+		QueryStatsState->trancheName = "Query Stats Tranche";
+		LWLockRegisterTranche(QueryStatsState->trancheId,
+							  QueryStatsState->trancheName);
+
+		LWLockInitialize(&QueryStatsState->lock, QueryStatsState->trancheId);
+		pg_atomic_init_u64(&QueryStatsState->accessClock, 0);
+	}
+
+	if (QueryStatsMaxEntries > 0)
+	{
+		HASHCTL info;
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(QueryStatsKey);
+		info.entrysize = sizeof(QueryStatsEntry);
+		QueryStatsHash = ShmemInitHash("Query Stats Hash",
+									   QueryStatsMaxEntries,
+									   QueryStatsMaxEntries,
+									   &info, HASH_ELEM | HASH_BLOBS);
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+
+/*
+ * Whether commands should be measured for the query stats: the feature is
+ * on and the hash was set up (it requires the extension to be in
+ * shared_preload_libraries).
+ */
+bool
+IsQueryStatsEnabled(void)
+{
+	return EnableQueryStats && QueryStatsHash != NULL;
+}
+
+
+/*
+ * Adds the measurements of an execution to the statistics of its shape.
+ */
+void
+RecordQueryStats(const QueryShape *queryShape,
+				 const QueryStatsMeasurements *measurements)
+{
+	if (QueryStatsHash == NULL)
+	{
+		return;
+	}
+
+	QueryStatsKey key = {
+		.pgDatabaseId = MyDatabaseId,
+		.shapeHash = queryShape->shapeHash
+	};
+
+	LWLockAcquire(&QueryStatsState->lock, LW_SHARED);
+	QueryStatsEntry *entry = hash_search(QueryStatsHash, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		/* New shape, retake the lock exclusively to add it */
+		LWLockRelease(&QueryStatsState->lock);
+		LWLockAcquire(&QueryStatsState->lock, LW_EXCLUSIVE);
+		entry = CreateQueryStatsEntry(&key, queryShape);
+		if (entry == NULL)
+		{
+			LWLockRelease(&QueryStatsState->lock);
+			return;
+		}
+	}
+
+	uint64 accessClock = pg_atomic_add_fetch_u64(&QueryStatsState->accessClock, 1);
+	TimestampTz now = GetCurrentTimestamp();
+
+	SpinLockAcquire(&entry->mutex);
+	entry->lastUsed = accessClock;
+	entry->lastSeen = now;
+	entry->execCount++;
+	entry->totalMicros += measurements->durationMicros;
+	entry->maxMicros = Max(entry->maxMicros, measurements->durationMicros);
+	entry->lastExecutionMicros = measurements->durationMicros;
+	entry->keysExamined += measurements->keysExamined;
+	entry->docsExamined += measurements->docsExamined;
+	entry->docsReturned += measurements->docsReturned;
+	entry->planCacheHits += measurements->planCacheHits;
+	entry->spillBytes += measurements->spillBytes;
+	SpinLockRelease(&entry->mutex);
+
+	LWLockRelease(&QueryStatsState->lock);
+}
+
+
+PG_FUNCTION_INFO_V1(command_query_stats_aggregation);
+
+/*
+ * Returns a document per query shape of this database for the $queryStats
+ * aggregation stage:
+ * { key: { queryShape }, queryShapeHash, metrics: { execCount, ... } }
+ */
+Datum
+command_query_stats_aggregation(PG_FUNCTION_ARGS)
+{
+	pgbson *spec = PG_GETARG_PGBSON(0);
+
+	bson_iter_t specIter;
+	PgbsonInitIterator(spec, &specIter);
+	while (bson_iter_next(&specIter))
+	{
+		const char *key = bson_iter_key(&specIter);
+		if (strcmp(key, "transformIdentifiers") == 0)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
+							errmsg("$queryStats.transformIdentifiers is not supported "
+								   "yet")));
+		}
+		else
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_UNKNOWNBSONFIELD),
+							errmsg("BSON field '$queryStats.%s' is an unknown field.",
+								   key)));
+		}
+	}
+
+	TupleDesc descriptor;
+	Tuplestorestate *tupleStore = SetupBsonTuplestore(fcinfo, &descriptor);
+	if (QueryStatsHash == NULL)
+	{
+		PG_RETURN_VOID();
+	}
+
+	/* Copy the entries out so the lock is not held while writing documents */
+	List *entries = NIL;
+	LWLockAcquire(&QueryStatsState->lock, LW_SHARED);
+
+	HASH_SEQ_STATUS status;
+	QueryStatsEntry *entry;
+	hash_seq_init(&status, QueryStatsHash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		if (entry->key.pgDatabaseId != MyDatabaseId)
+		{
+			continue;
+		}
+
+		QueryStatsEntry *entryCopy = palloc(offsetof(QueryStatsEntry, shape) +
+											entry->shapeSize);
+		SpinLockAcquire(&entry->mutex);
+		memcpy(entryCopy, entry, offsetof(QueryStatsEntry, shape));
+		SpinLockRelease(&entry->mutex);
+		memcpy(entryCopy->shape, entry->shape, entry->shapeSize);
+		entries = lappend(entries, entryCopy);
+	}
+
+	LWLockRelease(&QueryStatsState->lock);
+
+	ListCell *entryCell;
+	foreach(entryCell, entries)
+	{
+		Datum values[1] = { PointerGetDatum(QueryStatsEntryToBson(lfirst(entryCell))) };
+		bool nulls[1] = { false };
+		tuplestore_putvalues(tupleStore, descriptor, values, nulls);
+	}
+
+	PG_RETURN_VOID();
+}
+
+
+PG_FUNCTION_INFO_V1(command_query_stats_reset);
+
+/*
+ * Removes the statistics of every query shape.
+ */
+Datum
+command_query_stats_reset(PG_FUNCTION_ARGS)
+{
+	if (QueryStatsHash == NULL)
+	{
+		PG_RETURN_VOID();
+	}
+
+	LWLockAcquire(&QueryStatsState->lock, LW_EXCLUSIVE);
+
+	HASH_SEQ_STATUS status;
+	QueryStatsEntry *entry;
+	hash_seq_init(&status, QueryStatsHash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		hash_search(QueryStatsHash, &entry->key, HASH_REMOVE, NULL);
+	}
+
+	LWLockRelease(&QueryStatsState->lock);
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * Adds the entry of a shape, evicting the least recently executed shapes if
+ * the hash is full. Must be called with the lock held in exclusive mode.
+ * Returns NULL if the shape could not be added.
+ */
+static QueryStatsEntry *
+CreateQueryStatsEntry(const QueryStatsKey *key, const QueryShape *queryShape)
+{
+	bool found = false;
+	QueryStatsEntry *entry = hash_search(QueryStatsHash, key, HASH_FIND, &found);
+	if (found)
+	{
+		/* Added concurrently while the lock was released */
+		return entry;
+	}
+
+	if (hash_get_num_entries(QueryStatsHash) >= QueryStatsMaxEntries)
+	{
+		EvictQueryStatsEntries();
+	}
+
+	entry = hash_search(QueryStatsHash, key, HASH_ENTER_NULL, &found);
+	if (entry == NULL)
+	{
+		return NULL;
+	}
+
+	SpinLockInit(&entry->mutex);
+	entry->lastUsed = 0;
+	entry->firstSeen = GetCurrentTimestamp();
+	entry->lastSeen = entry->firstSeen;
+	entry->execCount = 0;
+	entry->totalMicros = 0;
+	entry->maxMicros = 0;
+	entry->lastExecutionMicros = 0;
+	entry->keysExamined = 0;
+	entry->docsExamined = 0;
+	entry->docsReturned = 0;
+	entry->planCacheHits = 0;
+	entry->spillBytes = 0;
+
+	uint32 shapeSize = VARSIZE(queryShape->shape);
+	if (shapeSize <= QUERY_STATS_MAX_SHAPE_SIZE)
+	{
+		memcpy(entry->shape, queryShape->shape, shapeSize);
+		entry->shapeSize = shapeSize;
+	}
+	else
+	{
+		entry->shapeSize = 0;
+	}
+
+	return entry;
+}
+
+
+/*
+ * Evicts the least recently executed QUERY_STATS_EVICTION_PERCENT of the
+ * entries. Must be called with the lock held in exclusive mode.
+ */
+static void
+EvictQueryStatsEntries(void)
+{
+	long numEntries = hash_get_num_entries(QueryStatsHash);
+	if (numEntries == 0)
+	{
+		return;
+	}
+
+	QueryStatsEntry **entries = palloc(numEntries * sizeof(QueryStatsEntry *));
+	int entryCount = 0;
+
+	HASH_SEQ_STATUS status;
+	QueryStatsEntry *entry;
+	hash_seq_init(&status, QueryStatsHash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		entries[entryCount++] = entry;
+	}
+
+	qsort(entries, entryCount, sizeof(QueryStatsEntry *),
+		  CompareQueryStatsEntryLastUsed);
+
+	int numEvicted = Max(entryCount * QUERY_STATS_EVICTION_PERCENT / 100, 1);
+	for (int i = 0; i < numEvicted; i++)
+	{
+		hash_search(QueryStatsHash, &entries[i]->key, HASH_REMOVE, NULL);
+	}
+
+	pfree(entries);
+}
+
+
+static int
+CompareQueryStatsEntryLastUsed(const void *left, const void *right)
+{
+	const QueryStatsEntry *leftEntry = *(const QueryStatsEntry *const *) left;
+	const QueryStatsEntry *rightEntry = *(const QueryStatsEntry *const *) right;
+
+	if (leftEntry->lastUsed < rightEntry->lastUsed)
+	{
+		return -1;
+	}
+
+	return leftEntry->lastUsed > rightEntry->lastUsed ? 1 : 0;
+}
+
+
+static pgbson *
+QueryStatsEntryToBson(const QueryStatsEntry *entry)
+{
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+
+	pgbson_writer keyWriter;
+	PgbsonWriterStartDocument(&writer, "key", 3, &keyWriter);
+	if (entry->shapeSize > 0)
+	{
+		PgbsonWriterAppendDocument(&keyWriter, "queryShape", 10,
+								   (const pgbson *) entry->shape);
+	}
+	else
+	{
+		PgbsonWriterAppendBool(&keyWriter, "queryShapeTruncated", 19, true);
+	}
+	PgbsonWriterEndDocument(&writer, &keyWriter);
+
+	PgbsonWriterAppendUtf8(&writer, "queryShapeHash", 14,
+						   QueryShapeHashToString(entry->key.shapeHash));
+
+	pgbson_writer metricsWriter;
+	PgbsonWriterStartDocument(&writer, "metrics", 7, &metricsWriter);
+	PgbsonWriterAppendInt64(&metricsWriter, "execCount", 9, entry->execCount);
+	PgbsonWriterAppendInt64(&metricsWriter, "lastExecutionMicros", 19,
+							entry->lastExecutionMicros);
+
+	pgbson_writer latencyWriter;
+	PgbsonWriterStartDocument(&metricsWriter, "totalExecMicros", 15, &latencyWriter);
+	PgbsonWriterAppendInt64(&latencyWriter, "sum", 3, entry->totalMicros);
+	PgbsonWriterAppendInt64(&latencyWriter, "max", 3, entry->maxMicros);
+	PgbsonWriterEndDocument(&metricsWriter, &latencyWriter);
+
+	PgbsonWriterAppendInt64(&metricsWriter, "keysExamined", 12, entry->keysExamined);
+	PgbsonWriterAppendInt64(&metricsWriter, "docsExamined", 12, entry->docsExamined);
+	PgbsonWriterAppendInt64(&metricsWriter, "docsReturned", 12, entry->docsReturned);
+	PgbsonWriterAppendInt64(&metricsWriter, "planCacheHits", 13, entry->planCacheHits);
+	PgbsonWriterAppendInt64(&metricsWriter, "spillBytes", 10, entry->spillBytes);
+	PgbsonWriterAppendDateTime(&metricsWriter, "firstSeenTimestamp", 18,
+							   entry->firstSeen);
+	PgbsonWriterAppendDateTime(&metricsWriter, "latestSeenTimestamp", 19,
+							   entry->lastSeen);
+	PgbsonWriterEndDocument(&writer, &metricsWriter);
+
+	return PgbsonWriterGetPgbson(&writer);
+}
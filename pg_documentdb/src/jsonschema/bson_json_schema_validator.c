@@ -19,6 +19,7 @@
 #include "jsonschema/bson_json_schema_tree.h"
 #include "utils/documentdb_errors.h"
 #include "metadata/metadata_cache.h"
+#include "metadata/collection_field_dictionary.h"
 #include "utils/fmgr_utils.h"
 #include "utils/hashset_utils.h"
 
@@ -78,7 +79,7 @@ PG_FUNCTION_INFO_V1(bson_dollar_json_schema);
 Datum
 bson_dollar_json_schema(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	pgbson *schema = PG_GETARG_PGBSON(1);
 
 	pgbsonelement element;
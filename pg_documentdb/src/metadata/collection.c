@@ -14,6 +14,7 @@
 #include "access/xact.h"
 #include "catalog/pg_attribute.h"
 #include "commands/extension.h"
+#include "commands/trigger.h"
 #include "executor/spi.h"
 #include "lib/stringinfo.h"
 #include "nodes/makefuncs.h"
@@ -31,6 +32,7 @@
 #include "utils/version_utils.h"
 
 #include "metadata/collection.h"
+#include "metadata/collection_shared_cache.h"
 #include "metadata/metadata_cache.h"
 #include "utils/documentdb_errors.h"
 #include "metadata/relation_utils.h"
@@ -110,6 +112,7 @@ extern int MaxSchemaValidatorSize;
 /* user-defined functions */
 PG_FUNCTION_INFO_V1(command_collection_table);
 PG_FUNCTION_INFO_V1(command_invalidate_collection_cache);
+PG_FUNCTION_INFO_V1(command_collection_update_trigger);
 PG_FUNCTION_INFO_V1(command_get_next_collection_id);
 PG_FUNCTION_INFO_V1(command_ensure_valid_db_coll);
 PG_FUNCTION_INFO_V1(validate_dbname);
@@ -344,21 +347,42 @@ GetMongoCollectionByColId(uint64 collectionId, LOCKMODE lockMode)
 	MongoCollection collection;
 	memset(&collection, 0, sizeof(collection));
 
-	/*
-	 * Temporarily disable unimportant logs related to collection catalog lookup
-	 * so that regression test outputs don't become flaky (e.g.: due to commands
-	 * being executed by Citus locally).
-	 */
-	int savedGUCLevel = NewGUCNestLevel();
-	SetGUCLocally("client_min_messages", "WARNING");
+	/* Try the shared cache before going to the catalog */
+	bool collectionExists = TryGetCollectionFromSharedCacheById(collectionId,
+																&collection);
+	if (collectionExists)
+	{
+		collection.relationId = documentsTableOid;
+		if (collection.shardKey == NULL && collection.viewDefinition == NULL)
+		{
+			TrySetCollectionShard(&collection);
+		}
+	}
+	else
+	{
+		uint64 sharedCacheGeneration = GetSharedCollectionCacheGeneration();
 
-	/* Read the collection metadata from ApiCatalogSchemaName.collections */
-	bool collectionExists =
-		GetMongoCollectionFromCatalogById(collectionId, documentsTableOid,
-										  &collection);
+		/*
+		 * Temporarily disable unimportant logs related to collection catalog lookup
+		 * so that regression test outputs don't become flaky (e.g.: due to commands
+		 * being executed by Citus locally).
+		 */
+		int savedGUCLevel = NewGUCNestLevel();
+		SetGUCLocally("client_min_messages", "WARNING");
 
-	/* rollback the GUC change that we made for client_min_messages */
-	RollbackGUCChange(savedGUCLevel);
+		/* Read the collection metadata from ApiCatalogSchemaName.collections */
+		collectionExists =
+			GetMongoCollectionFromCatalogById(collectionId, documentsTableOid,
+											  &collection);
+
+		/* rollback the GUC change that we made for client_min_messages */
+		RollbackGUCChange(savedGUCLevel);
+
+		if (collectionExists)
+		{
+			AddCollectionToSharedCache(&collection, sharedCacheGeneration);
+		}
+	}
 
 	if (!collectionExists)
 	{
@@ -686,26 +710,39 @@ GetMongoCollectionByNameDatumCore(Datum databaseNameDatum, Datum collectionNameD
 	MongoCollection collection;
 	memset(&collection, 0, sizeof(collection));
 
-	/*
-	 * Temporarily disable unimportant logs related to collection catalog lookup
-	 * so that regression test outputs don't become flaky (e.g.: due to commands
-	 * being executed by Citus locally).
-	 */
-	int savedGUCLevel = NewGUCNestLevel();
-	SetGUCLocally("client_min_messages", "WARNING");
+	/* Try the shared cache before going to the catalog */
+	bool collectionExists = TryGetCollectionFromSharedCacheByName(&qualifiedName,
+																  &collection);
+	if (!collectionExists)
+	{
+		uint64 sharedCacheGeneration = GetSharedCollectionCacheGeneration();
 
-	/*
-	 * Read the collection metadata from ApiCatalogSchemaName.collections or error
-	 * out if the collection does not exist. (We do not cache negative entries,
-	 * since we expect them to be rare)
-	 */
-	bool collectionExists =
-		GetMongoCollectionFromCatalogByNameDatum(databaseNameDatum,
-												 collectionNameDatum,
-												 &collection);
+		/*
+		 * Temporarily disable unimportant logs related to collection catalog lookup
+		 * so that regression test outputs don't become flaky (e.g.: due to commands
+		 * being executed by Citus locally).
+		 */
+		int savedGUCLevel = NewGUCNestLevel();
+		SetGUCLocally("client_min_messages", "WARNING");
 
-	/* rollback the GUC change that we made for client_min_messages */
-	RollbackGUCChange(savedGUCLevel);
+		/*
+		 * Read the collection metadata from ApiCatalogSchemaName.collections or error
+		 * out if the collection does not exist. (We do not cache negative entries,
+		 * since we expect them to be rare)
+		 */
+		collectionExists =
+			GetMongoCollectionFromCatalogByNameDatum(databaseNameDatum,
+													 collectionNameDatum,
+													 &collection);
+
+		/* rollback the GUC change that we made for client_min_messages */
+		RollbackGUCChange(savedGUCLevel);
+
+		if (collectionExists)
+		{
+			AddCollectionToSharedCache(&collection, sharedCacheGeneration);
+		}
+	}
 
 	if (!collectionExists)
 	{
@@ -1340,11 +1377,90 @@ command_collection_table(PG_FUNCTION_ARGS)
 Datum
 command_invalidate_collection_cache(PG_FUNCTION_ARGS)
 {
+	RecordCollectionCatalogReset();
 	CacheInvalidateRelcacheAll();
 	PG_RETURN_VOID();
 }
 
 
+/*
+ * command_collection_update_trigger is the trigger on ApiCatalogSchemaName.collections.
+ *
+ * As a row trigger it only invalidates the collection that was modified: The
+ * relcache invalidation of its data table drops it from the per backend caches
+ * and the collection is recorded to be dropped from the shared cache on commit.
+ * Views (and dropped data tables) have no relation to invalidate, so for those
+ * the per backend caches are reset wholesale, as the statement level trigger
+ * that predates the row level one does.
+ */
+Datum
+command_collection_update_trigger(PG_FUNCTION_ARGS)
+{
+	if (!CALLED_AS_TRIGGER(fcinfo))
+	{
+		ereport(ERROR, (errmsg("collection_update_trigger: not called by trigger "
+							   "manager")));
+	}
+
+	TriggerData *triggerData = (TriggerData *) fcinfo->context;
+	if (!TRIGGER_FIRED_FOR_ROW(triggerData->tg_event))
+	{
+		RecordCollectionCatalogReset();
+		CacheInvalidateRelcacheAll();
+		return PointerGetDatum(NULL);
+	}
+
+	if (TRIGGER_FIRED_BY_INSERT(triggerData->tg_event))
+	{
+		/* nothing is cached for a collection that did not exist */
+		RecordCollectionCatalogChange(0);
+		return PointerGetDatum(NULL);
+	}
+
+	TupleDesc tupleDescriptor = RelationGetDescr(triggerData->tg_relation);
+	HeapTuple oldTuple = triggerData->tg_trigtuple;
+	HeapTuple newTuple = TRIGGER_FIRED_BY_UPDATE(triggerData->tg_event) ?
+						 triggerData->tg_newtuple : NULL;
+
+	/* Attr 3 is collection_id, Attr 6 is view_definition */
+	bool isNull = false;
+	Datum collectionIdDatum = heap_getattr(oldTuple, 3, tupleDescriptor, &isNull);
+	uint64 collectionId = isNull ? 0 : DatumGetInt64(collectionIdDatum);
+
+	bool isView = tupleDescriptor->natts >= 6 &&
+				  (!heap_attisnull(oldTuple, 6, tupleDescriptor) ||
+				   (newTuple != NULL && !heap_attisnull(newTuple, 6, tupleDescriptor)));
+
+	Oid relationId = InvalidOid;
+	if (collectionId != 0 && !isView)
+	{
+		char tableName[NAMEDATALEN];
+		snprintf(tableName, NAMEDATALEN, DOCUMENT_DATA_TABLE_NAME_FORMAT, collectionId);
+		relationId = get_relname_relid(tableName, ApiDataNamespaceOid());
+	}
+
+	if (collectionId != 0)
+	{
+		RecordCollectionCatalogChange(collectionId);
+	}
+	else
+	{
+		RecordCollectionCatalogReset();
+	}
+
+	if (OidIsValid(relationId))
+	{
+		CacheInvalidateRelcacheByRelid(relationId);
+	}
+	else
+	{
+		CacheInvalidateRelcacheAll();
+	}
+
+	return PointerGetDatum(NULL);
+}
+
+
 /*
  * command_get_collection_or_view returns the output of the ApiCatalogSchemaName.collections
  * table (all attributes) by database and collection name whether the collection is a
@@ -0,0 +1,875 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/metadata/collection_compression.c
+ *
+ * Compression dictionaries of collections.
+ *
+ * A collection can store its documents compressed with a zstd dictionary
+ * trained on a sample of its documents (see io/bson_compression.h), which
+ * compresses small and medium documents far better than TOAST compresses
+ * them one by one. collMod enables compression and trains the first
+ * dictionary, the background worker retrains it periodically. Each training
+ * adds a new dictionary version, compressed documents record the version they
+ * were compressed with.
+ *
+ * Compressed documents are decompressed where the document column of a
+ * collection that has a dictionary is read, along with the decoding of
+ * encoded field names (see collection_field_dictionary.c).
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include <miscadmin.h>
+#include <access/htup_details.h>
+#include <access/table.h>
+#include <executor/executor.h>
+#include <executor/spi.h>
+#include <catalog/pg_type.h>
+#include <utils/array.h>
+#include <utils/builtins.h>
+#include <utils/hsearch.h>
+#include <utils/inval.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+#include <utils/rel.h>
+
+#include "io/bson_core.h"
+#include "io/bson_compression.h"
+#include "metadata/collection.h"
+#include "metadata/collection_compression.h"
+#include "metadata/metadata_cache.h"
+#include "infrastructure/job_management.h"
+#include "background_worker/background_worker_job.h"
+#include "utils/documentdb_errors.h"
+#include "utils/query_utils.h"
+#include "utils/version_utils.h"
+#include "api_hooks.h"
+
+extern bool EnableDocumentCompression;
+extern int DocumentCompressionLevel;
+extern int DocumentCompressionMinSizeBytes;
+extern int CompressionDictionaryRetrainIntervalSec;
+
+/* Number of documents sampled to train a dictionary */
+#define COMPRESSION_DICTIONARY_SAMPLE_SIZE 1000
+
+/* zstd recommends dictionaries about 100 times smaller than the samples */
+#define COMPRESSION_DICTIONARY_MAX_SIZE (32 * 1024)
+
+/* Number of collections the background job retrains per run */
+#define COMPRESSION_DICTIONARY_MAX_TRAININGS_PER_RUN 4
+
+#define COMPRESSION_DICTIONARY_SCHEDULE_IN_SEC 300
+
+typedef struct CompressionStateCacheEntry
+{
+	/* key, must be the first field */
+	uint64 collectionId;
+
+	/* The data table whose invalidation drops the entry */
+	Oid relationId;
+
+	/* Whether new writes are compressed */
+	bool isEnabled;
+
+	/* The version new writes are compressed with, 0 if none is trained */
+	uint32 dictionaryVersion;
+} CompressionStateCacheEntry;
+
+/*
+ * The last document DecompressStoredDocument decompressed. The query operators
+ * of a filter are each handed the same stored document, which is then
+ * decompressed once per row rather than once per operator. The entry lives in
+ * the memory context it was decompressed in, and is dropped when that context
+ * is reset. Callers get their own copy, as functions free their decoded
+ * arguments with PG_FREE_IF_COPY.
+ */
+typedef struct DecompressedDocumentCacheEntry
+{
+	MemoryContext context;
+
+	/* A copy of the stored document, to recognize it */
+	pgbson *storedDocument;
+	pgbson *document;
+} DecompressedDocumentCacheEntry;
+
+typedef struct CompressionDictionaryKey
+{
+	uint64 collectionId;
+	uint32 dictionaryVersion;
+} CompressionDictionaryKey;
+
+typedef struct CompressionDictionaryCacheEntry
+{
+	/* key, must be the first field */
+	CompressionDictionaryKey key;
+
+	BsonCompressionDictionary *dictionary;
+	MemoryContext dictionaryContext;
+} CompressionDictionaryCacheEntry;
+
+/* The outcome of training a dictionary, reported by collMod */
+typedef struct CompressionTrainingResult
+{
+	uint32 dictionaryVersion;
+	int64 sampleUncompressedBytes;
+	int64 sampleCompressedBytes;
+} CompressionTrainingResult;
+
+static HTAB *CompressionStateCache = NULL;
+static HTAB *CompressionDictionaryCache = NULL;
+static MemoryContext CompressionCacheContext = NULL;
+static DecompressedDocumentCacheEntry LastDecompressedDocument = { 0 };
+
+static void InitializeCompressionCaches(void);
+static CompressionStateCacheEntry * GetCompressionStateCacheEntry(uint64 collectionId);
+static const BsonCompressionDictionary * GetCompressionDictionary(int64 dictionaryId,
+																  uint32
+																  dictionaryVersion);
+static void InvalidateCompressionCaches(Datum argument, Oid relationId);
+static void ResetDecompressedDocumentCache(void *arg);
+static void RemoveCompressionDictionaries(uint64 collectionId);
+static pgbson * CompressDocumentWithCurrentDictionary(uint64 collectionId,
+													  pgbson *document);
+static bool TrainCollectionCompressionDictionary(uint64 collectionId,
+												 CompressionTrainingResult *result);
+static pgbson ** SampleCompressionDocuments(Oid relationId, const char *tableName,
+											int *numSamples);
+static int GetCompressionDictionaryScheduleInSec(void);
+
+
+/*
+ * Returns a stored document decompressed if it is stored compressed, or the
+ * document itself otherwise. The result may still have encoded field names.
+ */
+pgbson *
+DecompressStoredDocument(pgbson *document)
+{
+	if (!PgbsonIsCompressed(document))
+	{
+		return document;
+	}
+
+	uint32 storedLength = VARSIZE_ANY_EXHDR(document);
+	if (LastDecompressedDocument.context == CurrentMemoryContext &&
+		VARSIZE_ANY_EXHDR(LastDecompressedDocument.storedDocument) == storedLength &&
+		memcmp(VARDATA_ANY(LastDecompressedDocument.storedDocument),
+			   VARDATA_ANY(document), storedLength) == 0)
+	{
+		return CopyPgbsonIntoMemoryContext(LastDecompressedDocument.document,
+										   CurrentMemoryContext);
+	}
+
+	BsonCompressionHeader header = PgbsonGetCompressionHeader(document);
+	const BsonCompressionDictionary *dictionary =
+		GetCompressionDictionary(header.dictionaryId, header.dictionaryVersion);
+	if (dictionary == NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Compression dictionary " INT64_FORMAT
+							   " version %u of the document is not available",
+							   header.dictionaryId, header.dictionaryVersion)));
+	}
+
+	pgbson *decompressed = PgbsonDecompress(document, dictionary);
+
+	if (LastDecompressedDocument.context != CurrentMemoryContext)
+	{
+		MemoryContextCallback *callback = palloc(sizeof(MemoryContextCallback));
+		callback->func = ResetDecompressedDocumentCache;
+		callback->arg = CurrentMemoryContext;
+		MemoryContextRegisterResetCallback(CurrentMemoryContext, callback);
+	}
+
+	pgbson *storedCopy = palloc(storedLength + VARHDRSZ);
+	SET_VARSIZE(storedCopy, storedLength + VARHDRSZ);
+	memcpy(VARDATA(storedCopy), VARDATA_ANY(document), storedLength);
+
+	LastDecompressedDocument.context = CurrentMemoryContext;
+	LastDecompressedDocument.storedDocument = storedCopy;
+	LastDecompressedDocument.document =
+		CopyPgbsonIntoMemoryContext(decompressed, CurrentMemoryContext);
+	return decompressed;
+}
+
+
+/*
+ * Whether the documents of the collection may be stored compressed: a
+ * dictionary was trained for it, whether compression is still enabled or
+ * not.
+ */
+bool
+CollectionHasCompressedDocuments(uint64 collectionId)
+{
+	return GetCompressionStateCacheEntry(collectionId)->dictionaryVersion > 0;
+}
+
+
+/*
+ * Returns the document to store in the collection: the document compressed
+ * if the collection has compression enabled and a trained dictionary.
+ */
+pgbson *
+CompressDocumentForCollection(const MongoCollection *collection, pgbson *document)
+{
+	if (!EnableDocumentCompression)
+	{
+		return document;
+	}
+
+	return CompressDocumentWithCurrentDictionary(collection->collectionId, document);
+}
+
+
+/*
+ * Returns the updated version of a stored document to store: compressed with
+ * the current dictionary of the collection the stored document was
+ * compressed for, if compression is still enabled.
+ */
+pgbson *
+CompressUpdatedDocumentLike(pgbson *document, const pgbson *storedDocument)
+{
+	if (!EnableDocumentCompression || !PgbsonIsCompressed(storedDocument))
+	{
+		return document;
+	}
+
+	BsonCompressionHeader header = PgbsonGetCompressionHeader(storedDocument);
+	return CompressDocumentWithCurrentDictionary((uint64) header.dictionaryId,
+												 document);
+}
+
+
+/*
+ * Enables or disables document compression for a collection. Enabling it
+ * trains a new dictionary from a sample of the collection's documents, which
+ * the documents written from now on are compressed with. Documents already
+ * stored are left as they are.
+ */
+void
+UpdateCollectionCompression(const MongoCollection *collection, bool enable,
+							pgbson_writer *writer)
+{
+	if (!IsBsonCompressionSupported())
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_COMMANDNOTSUPPORTED),
+						errmsg(
+							"collMod.documentCompression is not supported by this build")));
+	}
+
+	const char *query =
+		FormatSqlQuery("INSERT INTO %s.collection_compression AS c"
+					   " (collection_id, is_enabled) VALUES ($1, $2)"
+					   " ON CONFLICT (collection_id) DO UPDATE"
+					   " SET is_enabled = EXCLUDED.is_enabled",
+					   ApiCatalogSchemaName);
+
+	int nargs = 2;
+	Oid argTypes[2] = { INT8OID, BOOLOID };
+	Datum argValues[2] = {
+		UInt64GetDatum(collection->collectionId),
+		BoolGetDatum(enable)
+	};
+
+	bool isNullIgnore = false;
+	RunQueryWithCommutativeWrites(query, nargs, argTypes, argValues, NULL,
+								  SPI_OK_INSERT, &isNullIgnore);
+
+	CompressionTrainingResult result = { 0 };
+	if (enable)
+	{
+		TrainCollectionCompressionDictionary(collection->collectionId, &result);
+	}
+
+	/* Drop the cached compression state of the collection in every backend */
+	CacheInvalidateRelcacheByRelid(collection->relationId);
+
+	pgbson_writer childWriter;
+	PgbsonWriterStartDocument(writer, "documentCompression", 19, &childWriter);
+	PgbsonWriterAppendBool(&childWriter, "enabled", 7, enable);
+	PgbsonWriterAppendInt32(&childWriter, "dictionaryVersion", 17,
+							result.dictionaryVersion);
+	if (result.sampleCompressedBytes > 0)
+	{
+		PgbsonWriterAppendDouble(&childWriter, "sampleCompressionRatio", 22,
+								 (double) result.sampleUncompressedBytes /
+								 result.sampleCompressedBytes);
+	}
+	PgbsonWriterEndDocument(writer, &childWriter);
+}
+
+
+/*
+ * Deletes the compression settings and dictionaries of a dropped collection.
+ */
+void
+DeleteCollectionCompression(uint64 collectionId)
+{
+	int nargs = 1;
+	Oid argTypes[1] = { INT8OID };
+	Datum argValues[1] = { UInt64GetDatum(collectionId) };
+	bool isNullIgnore = false;
+
+	const char *query =
+		FormatSqlQuery("DELETE FROM %s.collection_compression"
+					   " WHERE collection_id = $1", ApiCatalogSchemaName);
+	RunQueryWithCommutativeWrites(query, nargs, argTypes, argValues, NULL,
+								  SPI_OK_DELETE, &isNullIgnore);
+
+	query = FormatSqlQuery("DELETE FROM %s.collection_compression_dictionary"
+						   " WHERE collection_id = $1", ApiCatalogSchemaName);
+	RunQueryWithCommutativeWrites(query, nargs, argTypes, argValues, NULL,
+								  SPI_OK_DELETE, &isNullIgnore);
+}
+
+
+/*
+ * Registers the background job that retrains compression dictionaries.
+ */
+void
+RegisterCompressionDictionaryBackgroundWorkerJob(void)
+{
+	if (!EnableBackgroundWorker || !EnableBackgroundWorkerJobs)
+	{
+		return;
+	}
+
+	if (!process_shared_preload_libraries_in_progress)
+	{
+		ereport(ERROR, (errmsg(
+							"Registering a new background worker job must happen during shared_preload_libraries")));
+	}
+
+	BackgroundWorkerJob compressionDictionaryJob = {
+		.jobId = DOCUMENTDB_COMPRESSION_DICTIONARY_JOBID,
+		.jobName = "documentdb_compression_dictionary_background_job",
+		.command = {
+			.schema = ApiInternalSchemaName,
+			.name = "train_compression_dictionaries_background"
+		},
+		.get_schedule_interval_in_seconds_hook = GetCompressionDictionaryScheduleInSec,
+		.argument = {
+			.argType = InvalidOid,
+			.argValue = NULL,
+			.isNull = true
+		},
+		.timeoutInSeconds = 300,     /* 5 minutes timeout */
+		.toBeExecutedOnMetadataCoordinatorOnly = true,
+		.priority = BackgroundWorkerJobPriority_Low
+	};
+
+	RegisterBackgroundWorkerJob(compressionDictionaryJob);
+}
+
+
+PG_FUNCTION_INFO_V1(command_train_compression_dictionaries_background);
+
+/*
+ * Retrains the dictionaries of the collections with compression enabled whose
+ * dictionary is older than the retrain interval, oldest first.
+ */
+Datum
+command_train_compression_dictionaries_background(PG_FUNCTION_ARGS)
+{
+	if (!EnableDocumentCompression || CompressionDictionaryRetrainIntervalSec == 0 ||
+		!IsBsonCompressionSupported() || !IsClusterVersionAtleast(DocDB_V0, 110, 0))
+	{
+		PG_RETURN_VOID();
+	}
+
+	const char *query =
+		FormatSqlQuery("SELECT array_agg(collection_id) FROM ("
+					   " SELECT collection_id FROM %s.collection_compression"
+					   " WHERE is_enabled AND (trained_at IS NULL OR"
+					   " trained_at < now() - make_interval(secs => $1))"
+					   " ORDER BY trained_at NULLS FIRST LIMIT %d) c",
+					   ApiCatalogSchemaName, COMPRESSION_DICTIONARY_MAX_TRAININGS_PER_RUN);
+
+	int nargs = 1;
+	Oid argTypes[1] = { INT4OID };
+	Datum argValues[1] = { Int32GetDatum(CompressionDictionaryRetrainIntervalSec) };
+
+	bool readOnly = true;
+	bool isNull = false;
+	Datum collectionIds = ExtensionExecuteQueryWithArgsViaSPI(query, nargs, argTypes,
+															  argValues, NULL, readOnly,
+															  SPI_OK_SELECT, &isNull);
+	if (isNull)
+	{
+		PG_RETURN_VOID();
+	}
+
+	Datum *idDatums = NULL;
+	bool *idNulls = NULL;
+	int numIds = 0;
+	deconstruct_array(DatumGetArrayTypeP(collectionIds), INT8OID, sizeof(int64),
+					  FLOAT8PASSBYVAL, TYPALIGN_DOUBLE, &idDatums, &idNulls, &numIds);
+
+	for (int i = 0; i < numIds; i++)
+	{
+		uint64 collectionId = DatumGetUInt64(idDatums[i]);
+		CompressionTrainingResult result = { 0 };
+		if (TrainCollectionCompressionDictionary(collectionId, &result))
+		{
+			elog(LOG, "trained compression dictionary version %u of collection "
+				 UINT64_FORMAT " with sample compression ratio %.2f",
+				 result.dictionaryVersion, collectionId,
+				 result.sampleCompressedBytes > 0 ?
+				 (double) result.sampleUncompressedBytes /
+				 result.sampleCompressedBytes : 0);
+		}
+	}
+
+	PG_RETURN_VOID();
+}
+
+
+static void
+InitializeCompressionCaches(void)
+{
+	if (CompressionStateCache != NULL)
+	{
+		return;
+	}
+
+	CreateCacheMemoryContext();
+	CompressionCacheContext = AllocSetContextCreate(CacheMemoryContext,
+													"CompressionCacheContext",
+													ALLOCSET_DEFAULT_SIZES);
+
+	HASHCTL hashInfo;
+	memset(&hashInfo, 0, sizeof(hashInfo));
+	hashInfo.keysize = sizeof(uint64);
+	hashInfo.entrysize = sizeof(CompressionStateCacheEntry);
+	hashInfo.hcxt = CompressionCacheContext;
+	CompressionStateCache = hash_create("Compression state cache", 32, &hashInfo,
+										HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	memset(&hashInfo, 0, sizeof(hashInfo));
+	hashInfo.keysize = sizeof(CompressionDictionaryKey);
+	hashInfo.entrysize = sizeof(CompressionDictionaryCacheEntry);
+	hashInfo.hcxt = CompressionCacheContext;
+	CompressionDictionaryCache = hash_create("Compression dictionary cache", 32,
+											 &hashInfo,
+											 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	CacheRegisterRelcacheCallback(InvalidateCompressionCaches, (Datum) 0);
+}
+
+
+/*
+ * Returns the cached compression state of the collection, loading it if it is
+ * not cached.
+ */
+static CompressionStateCacheEntry *
+GetCompressionStateCacheEntry(uint64 collectionId)
+{
+	InitializeCompressionCaches();
+
+	bool found = false;
+	CompressionStateCacheEntry *entry = hash_search(CompressionStateCache,
+													&collectionId, HASH_FIND,
+													&found);
+	if (found)
+	{
+		return entry;
+	}
+
+	/*
+	 * Load before entering the cache: the query may process invalidations
+	 * that drop cache entries.
+	 */
+	const char *query =
+		FormatSqlQuery("SELECT is_enabled, dictionary_version"
+					   " FROM %s.collection_compression WHERE collection_id = $1",
+					   ApiCatalogSchemaName);
+
+	int nargs = 1;
+	Oid argTypes[1] = { INT8OID };
+	Datum argValues[1] = { UInt64GetDatum(collectionId) };
+
+	bool readOnly = true;
+	int numValues = 2;
+	bool isNull[2];
+	Datum results[2];
+	ExtensionExecuteMultiValueQueryWithArgsViaSPI(query, nargs, argTypes, argValues,
+												  NULL, readOnly, SPI_OK_SELECT, results,
+												  isNull, numValues);
+
+	CompressionStateCacheEntry loadedEntry = { 0 };
+	loadedEntry.collectionId = collectionId;
+	loadedEntry.isEnabled = !isNull[0] && DatumGetBool(results[0]);
+	loadedEntry.dictionaryVersion = isNull[1] ? 0 : DatumGetInt32(results[1]);
+
+	/* Resolve the data table so that its invalidations drop the entry */
+	char *tableName = psprintf(DOCUMENT_DATA_TABLE_NAME_FORMAT, collectionId);
+	loadedEntry.relationId = get_relname_relid(tableName, ApiDataNamespaceOid());
+
+	entry = hash_search(CompressionStateCache, &collectionId, HASH_ENTER, &found);
+	*entry = loadedEntry;
+	return entry;
+}
+
+
+/*
+ * Returns the given version of a compression dictionary, or NULL if there is
+ * no such dictionary: dictionaries are identified by the id of their
+ * collection. Versions never change, so they stay cached
+ * until the collection's data table is invalidated.
+ */
+static const BsonCompressionDictionary *
+GetCompressionDictionary(int64 dictionaryId, uint32 dictionaryVersion)
+{
+	InitializeCompressionCaches();
+
+	CompressionDictionaryKey key = { 0 };
+	key.collectionId = (uint64) dictionaryId;
+	key.dictionaryVersion = dictionaryVersion;
+
+	bool found = false;
+	CompressionDictionaryCacheEntry *entry = hash_search(CompressionDictionaryCache,
+														 &key, HASH_FIND, &found);
+	if (found)
+	{
+		return entry->dictionary;
+	}
+
+	const char *query =
+		FormatSqlQuery("SELECT dictionary FROM %s.collection_compression_dictionary"
+					   " WHERE collection_id = $1 AND dictionary_version = $2",
+					   ApiCatalogSchemaName);
+
+	int nargs = 2;
+	Oid argTypes[2] = { INT8OID, INT4OID };
+	Datum argValues[2] = {
+		UInt64GetDatum(key.collectionId),
+		Int32GetDatum((int32) dictionaryVersion)
+	};
+
+	bool readOnly = true;
+	bool isNull = false;
+	Datum dictionaryDatum = ExtensionExecuteQueryWithArgsViaSPI(query, nargs, argTypes,
+																argValues, NULL, readOnly,
+																SPI_OK_SELECT, &isNull);
+	if (isNull)
+	{
+		return NULL;
+	}
+
+	MemoryContext dictionaryContext = AllocSetContextCreate(CompressionCacheContext,
+															"CompressionDictionaryContext",
+															ALLOCSET_SMALL_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(dictionaryContext);
+	BsonCompressionDictionary *dictionary =
+		CreateBsonCompressionDictionary(dictionaryId, dictionaryVersion,
+										DatumGetByteaPP(dictionaryDatum),
+										DocumentCompressionLevel);
+	MemoryContextSwitchTo(oldContext);
+
+	entry = hash_search(CompressionDictionaryCache, &key, HASH_ENTER, &found);
+	if (found && entry->dictionaryContext != NULL)
+	{
+		MemoryContextDelete(entry->dictionaryContext);
+	}
+
+	entry->dictionary = dictionary;
+	entry->dictionaryContext = dictionaryContext;
+	return dictionary;
+}
+
+
+/*
+ * Forgets the last decompressed document when the memory context it lives in
+ * is reset or deleted.
+ */
+static void
+ResetDecompressedDocumentCache(void *arg)
+{
+	if (LastDecompressedDocument.context == (MemoryContext) arg)
+	{
+		memset(&LastDecompressedDocument, 0, sizeof(DecompressedDocumentCacheEntry));
+	}
+}
+
+
+/*
+ * Drops the cached compression state and dictionaries of the invalidated data
+ * table, or all of them on a reset.
+ */
+static void
+InvalidateCompressionCaches(Datum argument, Oid relationId)
+{
+	if (CompressionStateCache == NULL)
+	{
+		return;
+	}
+
+	HASH_SEQ_STATUS status;
+	hash_seq_init(&status, CompressionStateCache);
+
+	CompressionStateCacheEntry *entry;
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		if (relationId == InvalidOid || entry->relationId == relationId)
+		{
+			if (relationId != InvalidOid)
+			{
+				RemoveCompressionDictionaries(entry->collectionId);
+			}
+
+			hash_search(CompressionStateCache, &entry->collectionId, HASH_REMOVE,
+						NULL);
+		}
+	}
+
+	if (relationId == InvalidOid)
+	{
+		RemoveCompressionDictionaries(0);
+	}
+}
+
+
+/*
+ * Removes the cached dictionaries of a collection, or all of them if
+ * collectionId is 0.
+ */
+static void
+RemoveCompressionDictionaries(uint64 collectionId)
+{
+	HASH_SEQ_STATUS status;
+	hash_seq_init(&status, CompressionDictionaryCache);
+
+	CompressionDictionaryCacheEntry *entry;
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		if (collectionId == 0 || entry->key.collectionId == collectionId)
+		{
+			if (entry->dictionaryContext != NULL)
+			{
+				MemoryContextDelete(entry->dictionaryContext);
+			}
+
+			hash_search(CompressionDictionaryCache, &entry->key, HASH_REMOVE, NULL);
+		}
+	}
+}
+
+
+static pgbson *
+CompressDocumentWithCurrentDictionary(uint64 collectionId, pgbson *document)
+{
+	if (PgbsonGetBsonSize(document) < (uint32) DocumentCompressionMinSizeBytes)
+	{
+		return document;
+	}
+
+	CompressionStateCacheEntry *entry = GetCompressionStateCacheEntry(collectionId);
+	if (!entry->isEnabled || entry->dictionaryVersion == 0)
+	{
+		return document;
+	}
+
+	const BsonCompressionDictionary *dictionary =
+		GetCompressionDictionary((int64) collectionId, entry->dictionaryVersion);
+	if (dictionary == NULL)
+	{
+		return document;
+	}
+
+	return PgbsonCompress(document, dictionary);
+}
+
+
+/*
+ * Trains a new dictionary version for the collection from a sample of its
+ * documents and makes it the one new writes are compressed with. Returns
+ * false if the collection is gone or has too few documents to train one.
+ */
+static bool
+TrainCollectionCompressionDictionary(uint64 collectionId,
+									 CompressionTrainingResult *result)
+{
+	char *tableName = psprintf(DOCUMENT_DATA_TABLE_NAME_FORMAT, collectionId);
+	Oid relationId = get_relname_relid(tableName, ApiDataNamespaceOid());
+	if (!OidIsValid(relationId))
+	{
+		return false;
+	}
+
+	int numSamples = 0;
+	pgbson **samples = SampleCompressionDocuments(relationId, tableName, &numSamples);
+	bytea *trainedDictionary = TrainBsonCompressionDictionary(samples, numSamples,
+															  COMPRESSION_DICTIONARY_MAX_SIZE);
+	if (trainedDictionary == NULL)
+	{
+		return false;
+	}
+
+	const char *query =
+		FormatSqlQuery("SELECT dictionary_version + 1 FROM %s.collection_compression"
+					   " WHERE collection_id = $1", ApiCatalogSchemaName);
+
+	Oid versionArgTypes[1] = { INT8OID };
+	Datum versionArgValues[1] = { UInt64GetDatum(collectionId) };
+
+	bool readOnly = true;
+	bool isNull = false;
+	Datum versionDatum = ExtensionExecuteQueryWithArgsViaSPI(query, 1, versionArgTypes,
+															 versionArgValues, NULL,
+															 readOnly, SPI_OK_SELECT,
+															 &isNull);
+	if (isNull)
+	{
+		return false;
+	}
+
+	uint32 dictionaryVersion = (uint32) DatumGetInt32(versionDatum);
+
+	/* Measure the dictionary on the samples it was trained on */
+	MemoryContext measureContext = AllocSetContextCreate(CurrentMemoryContext,
+														 "CompressionMeasureContext",
+														 ALLOCSET_DEFAULT_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(measureContext);
+	BsonCompressionDictionary *dictionary =
+		CreateBsonCompressionDictionary((int64) collectionId, dictionaryVersion,
+										trainedDictionary, DocumentCompressionLevel);
+
+	int64 uncompressedBytes = 0;
+	int64 compressedBytes = 0;
+	for (int i = 0; i < numSamples; i++)
+	{
+		pgbson *compressed = PgbsonCompress(samples[i], dictionary);
+		uncompressedBytes += VARSIZE_ANY_EXHDR(samples[i]);
+		compressedBytes += VARSIZE_ANY_EXHDR(compressed);
+		if (compressed != samples[i])
+		{
+			pfree(compressed);
+		}
+	}
+
+	MemoryContextSwitchTo(oldContext);
+	MemoryContextDelete(measureContext);
+
+	query = FormatSqlQuery("INSERT INTO %s.collection_compression_dictionary"
+						   " (collection_id, dictionary_version, dictionary)"
+						   " VALUES ($1, $2, $3)", ApiCatalogSchemaName);
+
+	Oid insertArgTypes[3] = { INT8OID, INT4OID, BYTEAOID };
+	Datum insertArgValues[3] = {
+		UInt64GetDatum(collectionId),
+		Int32GetDatum((int32) dictionaryVersion),
+		PointerGetDatum(trainedDictionary)
+	};
+
+	bool isNullIgnore = false;
+	RunQueryWithCommutativeWrites(query, 3, insertArgTypes, insertArgValues, NULL,
+								  SPI_OK_INSERT, &isNullIgnore);
+
+	query = FormatSqlQuery("UPDATE %s.collection_compression"
+						   " SET dictionary_version = $2, trained_at = now(),"
+						   " sample_uncompressed_bytes = $3, sample_compressed_bytes = $4"
+						   " WHERE collection_id = $1", ApiCatalogSchemaName);
+
+	Oid updateArgTypes[4] = { INT8OID, INT4OID, INT8OID, INT8OID };
+	Datum updateArgValues[4] = {
+		UInt64GetDatum(collectionId),
+		Int32GetDatum((int32) dictionaryVersion),
+		Int64GetDatum(uncompressedBytes),
+		Int64GetDatum(compressedBytes)
+	};
+	RunQueryWithCommutativeWrites(query, 4, updateArgTypes, updateArgValues, NULL,
+								  SPI_OK_UPDATE, &isNullIgnore);
+
+	/* Make every backend pick up the new version */
+	CacheInvalidateRelcacheByRelid(relationId);
+
+	result->dictionaryVersion = dictionaryVersion;
+	result->sampleUncompressedBytes = uncompressedBytes;
+	result->sampleCompressedBytes = compressedBytes;
+	return true;
+}
+
+
+/*
+ * Samples documents of the data table spread over the whole table, as they
+ * are stored but decompressed: dictionaries compress documents after their
+ * field names are encoded. The rows are read whole, as the planner decodes
+ * the document column of collections with encoded documents.
+ */
+static pgbson **
+SampleCompressionDocuments(Oid relationId, const char *tableName, int *numSamples)
+{
+	Relation relation = table_open(relationId, AccessShareLock);
+	double relTuples = relation->rd_rel->reltuples;
+	table_close(relation, NoLock);
+
+	/* Read about twice the pages needed so that LIMIT gets a full sample */
+	double samplePercent = 100.0;
+	if (relTuples > 0)
+	{
+		samplePercent = Min(100.0, 200.0 * COMPRESSION_DICTIONARY_SAMPLE_SIZE /
+							relTuples);
+	}
+
+	StringInfo query = makeStringInfo();
+	appendStringInfo(query,
+					 "SELECT d FROM %s.%s d TABLESAMPLE SYSTEM (%f) LIMIT %d",
+					 ApiDataSchemaName, tableName, samplePercent,
+					 COMPRESSION_DICTIONARY_SAMPLE_SIZE);
+
+	MemoryContext sampleContext = CurrentMemoryContext;
+	pgbson **samples = palloc(sizeof(pgbson *) * COMPRESSION_DICTIONARY_SAMPLE_SIZE);
+	int sampleIndex = 0;
+
+	SPI_connect();
+	bool readOnly = true;
+	if (SPI_execute(query->data, readOnly, 0) != SPI_OK_SELECT)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("could not sample the documents of collection table %s",
+							   tableName)));
+	}
+
+	for (uint64 i = 0; i < SPI_processed &&
+		 sampleIndex < COMPRESSION_DICTIONARY_SAMPLE_SIZE; i++)
+	{
+		bool isNull = false;
+		Datum rowDatum = SPI_getbinval(SPI_tuptable->vals[i],
+									   SPI_tuptable->tupdesc, 1, &isNull);
+		if (isNull)
+		{
+			continue;
+		}
+
+		Datum documentDatum =
+			GetAttributeByNum(DatumGetHeapTupleHeader(rowDatum),
+							  DOCUMENT_DATA_TABLE_DOCUMENT_VAR_ATTR_NUMBER, &isNull);
+		if (isNull)
+		{
+			continue;
+		}
+
+		MemoryContext spiContext = MemoryContextSwitchTo(sampleContext);
+		pgbson *document = DecompressStoredDocument(DatumGetPgBson(documentDatum));
+		if ((Pointer) document == DatumGetPointer(documentDatum))
+		{
+			document = CopyPgbsonIntoMemoryContext(document, sampleContext);
+		}
+
+		samples[sampleIndex++] = document;
+		MemoryContextSwitchTo(spiContext);
+	}
+
+	SPI_finish();
+
+	*numSamples = sampleIndex;
+	return samples;
+}
+
+
+static int
+GetCompressionDictionaryScheduleInSec(void)
+{
+	return COMPRESSION_DICTIONARY_SCHEDULE_IN_SEC;
+}
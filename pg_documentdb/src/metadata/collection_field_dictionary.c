@@ -0,0 +1,634 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/metadata/collection_field_dictionary.c
+ *
+ * Field name dictionaries of collections.
+ *
+ * A collection can store its documents with their field names replaced by
+ * ids from a per collection dictionary (see io/bson_field_dictionary.h),
+ * which saves the bytes of long field names repeated in every document. The
+ * dictionaries are kept in ApiCatalogSchemaName.collection_field_dictionary,
+ * and are built by collMod from a sample of the collection's documents.
+ *
+ * Encoded documents are decoded, and compressed ones decompressed, only where
+ * the document column of a collection with a dictionary is read, whatever
+ * the settings that enable them: the planner wraps such reads in
+ * bson_decode_stored_document, and the query operators and index support
+ * functions, which are handed the column itself, decode it on their own.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include <miscadmin.h>
+#include <executor/spi.h>
+#include <catalog/pg_type.h>
+#include <utils/array.h>
+#include <utils/builtins.h>
+#include <utils/hsearch.h>
+#include <utils/inval.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+
+#include "io/bson_core.h"
+#include "io/bson_field_dictionary.h"
+#include "metadata/collection.h"
+#include "metadata/collection_compression.h"
+#include "metadata/collection_field_dictionary.h"
+#include "metadata/metadata_cache.h"
+#include "utils/documentdb_errors.h"
+#include "utils/hashset_utils.h"
+#include "utils/query_utils.h"
+#include "utils/version_utils.h"
+#include "api_hooks.h"
+
+extern bool EnableFieldNameDictionary;
+
+/* Number of documents collMod samples to pick the field names of a dictionary */
+#define FIELD_DICTIONARY_SAMPLE_SIZE 1000
+
+/* Encoded names take up to 3 bytes: shorter names are not worth an entry */
+#define FIELD_DICTIONARY_ENCODED_NAME_LENGTH 3
+
+typedef struct FieldDictionaryCacheEntry
+{
+	/* key, must be the first field */
+	uint64 collectionId;
+
+	/* The data table whose invalidation drops the entry, if known */
+	Oid relationId;
+
+	/* Whether new writes are encoded */
+	bool isEnabled;
+
+	/* NULL if the collection has no dictionary */
+	BsonFieldDictionary *dictionary;
+	MemoryContext dictionaryContext;
+} FieldDictionaryCacheEntry;
+
+typedef struct FieldNameSampleEntry
+{
+	/* key, must be the first field */
+	StringView name;
+	int64 savedBytes;
+} FieldNameSampleEntry;
+
+static HTAB *FieldDictionaryCache = NULL;
+static MemoryContext FieldDictionaryCacheContext = NULL;
+
+static const BsonFieldDictionary * GetDictionaryForEncodedDocument(const
+																   pgbson *document);
+static FieldDictionaryCacheEntry * GetFieldDictionaryCacheEntry(uint64 collectionId,
+																uint32 minNames);
+static void LoadFieldDictionary(FieldDictionaryCacheEntry *entry);
+static void InvalidateFieldDictionaryCache(Datum argument, Oid relationId);
+static void ResetFieldDictionaryCacheEntry(FieldDictionaryCacheEntry *entry);
+static List * SampleFieldDictionaryNames(const MongoCollection *collection,
+										 uint32 maxNames);
+static void CollectSampleFieldNames(bson_iter_t *iter, bool isArray, HTAB *names);
+static int CompareSampleEntriesBySavedBytes(const void *left, const void *right);
+static uint32 FieldNameSampleHashFunc(const void *obj, size_t objsize);
+static int FieldNameSampleCompareFunc(const void *obj1, const void *obj2, Size objsize);
+
+
+PG_FUNCTION_INFO_V1(bson_decode_stored_document);
+
+
+/*
+ * bson_decode_stored_document returns a document read from a collection's
+ * data table decoded, or as is if it is not stored encoded.
+ */
+Datum
+bson_decode_stored_document(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(PG_GETARG_STORED_PGBSON(0));
+}
+
+
+/*
+ * Returns a stored document decompressed and with its field names expanded
+ * if it is stored that way, or the document itself otherwise.
+ */
+pgbson *
+DecodeStoredDocument(pgbson *document)
+{
+	document = DecompressStoredDocument(document);
+	if (!PgbsonIsFieldNameEncoded(document))
+	{
+		return document;
+	}
+
+	return PgbsonExpandFieldNames(document, GetDictionaryForEncodedDocument(document));
+}
+
+
+/*
+ * Returns the dotted path to traverse to find the given path in a stored
+ * document: the encoded path if the document has encoded field names. The
+ * document must already be decompressed.
+ */
+const char *
+EncodeStoredDocumentFieldPath(const pgbson *document, const char *path)
+{
+	if (!PgbsonIsFieldNameEncoded(document))
+	{
+		return path;
+	}
+
+	return PgbsonEncodeFieldPath(document, GetDictionaryForEncodedDocument(document),
+								 path);
+}
+
+
+/*
+ * Whether the documents of the collection may be stored encoded: the
+ * collection has a field name or compression dictionary, enabled or not.
+ * This only depends on the collection's metadata, not on the settings that
+ * enable new encodings, so documents stay readable once those are turned off.
+ */
+bool
+CollectionHasEncodedDocuments(uint64 collectionId)
+{
+	if (!IsClusterVersionAtleast(DocDB_V0, 110, 0))
+	{
+		return false;
+	}
+
+	return GetFieldDictionaryCacheEntry(collectionId, 0)->dictionary != NULL ||
+		   CollectionHasCompressedDocuments(collectionId);
+}
+
+
+/*
+ * Returns the dictionary to encode the documents written to the collection
+ * with, or NULL if they are stored as is.
+ */
+const BsonFieldDictionary *
+GetCollectionFieldDictionaryForWrite(const MongoCollection *collection)
+{
+	if (!EnableFieldNameDictionary)
+	{
+		return NULL;
+	}
+
+	FieldDictionaryCacheEntry *entry =
+		GetFieldDictionaryCacheEntry(collection->collectionId, 0);
+	return entry->isEnabled ? entry->dictionary : NULL;
+}
+
+
+/*
+ * Returns the document to store in the collection: the document with its
+ * field names encoded if the collection has an enabled dictionary.
+ */
+pgbson *
+EncodeDocumentForCollection(const MongoCollection *collection, pgbson *document)
+{
+	const BsonFieldDictionary *dictionary =
+		GetCollectionFieldDictionaryForWrite(collection);
+	if (dictionary == NULL || dictionary->numNames == 0)
+	{
+		return document;
+	}
+
+	return PgbsonEncodeFieldNames(document, dictionary);
+}
+
+
+/*
+ * Returns the updated version of a stored document to store: encoded with the
+ * dictionary the stored document was encoded with, if still enabled.
+ */
+pgbson *
+EncodeUpdatedDocumentLike(pgbson *document, const pgbson *storedDocument)
+{
+	if (!PgbsonIsFieldNameEncoded(storedDocument) || !EnableFieldNameDictionary)
+	{
+		return document;
+	}
+
+	uint32 numNames = 0;
+	uint64 collectionId = (uint64) PgbsonGetFieldDictionaryId(storedDocument,
+															   &numNames);
+	FieldDictionaryCacheEntry *entry = GetFieldDictionaryCacheEntry(collectionId, 0);
+	if (!entry->isEnabled || entry->dictionary == NULL)
+	{
+		return document;
+	}
+
+	return PgbsonEncodeFieldNames(document, entry->dictionary);
+}
+
+
+/*
+ * Enables or disables the field name dictionary of a collection. Enabling it
+ * adds the field names of a sample of the collection's documents that are not
+ * in the dictionary yet. Existing documents are left as they are; documents
+ * written from now on are encoded with the dictionary.
+ */
+void
+UpdateCollectionFieldDictionary(const MongoCollection *collection, bool enable,
+								pgbson_writer *writer)
+{
+	FieldDictionaryCacheEntry *entry =
+		GetFieldDictionaryCacheEntry(collection->collectionId, 0);
+	uint32 numNames = entry->dictionary != NULL ? entry->dictionary->numNames : 0;
+
+	List *newNames = NIL;
+	if (enable && numNames < BSON_FIELD_DICTIONARY_MAX_NAMES)
+	{
+		newNames = SampleFieldDictionaryNames(collection,
+											  BSON_FIELD_DICTIONARY_MAX_NAMES -
+											  numNames);
+	}
+
+	Datum *nameDatums = palloc0(sizeof(Datum) * Max(list_length(newNames), 1));
+	ListCell *nameCell;
+	int nameIndex = 0;
+	foreach(nameCell, newNames)
+	{
+		nameDatums[nameIndex++] = CStringGetTextDatum((char *) lfirst(nameCell));
+	}
+
+	ArrayType *nameArray = construct_array(nameDatums, nameIndex, TEXTOID, -1, false,
+										   TYPALIGN_INT);
+
+	const char *query =
+		FormatSqlQuery("INSERT INTO %s.collection_field_dictionary AS d"
+					   " (collection_id, is_enabled, field_names) VALUES ($1, $2, $3)"
+					   " ON CONFLICT (collection_id) DO UPDATE"
+					   " SET is_enabled = EXCLUDED.is_enabled,"
+					   " field_names = d.field_names || EXCLUDED.field_names",
+					   ApiCatalogSchemaName);
+
+	int nargs = 3;
+	Oid argTypes[3] = { INT8OID, BOOLOID, TEXTARRAYOID };
+	Datum argValues[3] = {
+		UInt64GetDatum(collection->collectionId),
+		BoolGetDatum(enable),
+		PointerGetDatum(nameArray)
+	};
+
+	bool isNullIgnore = false;
+	RunQueryWithCommutativeWrites(query, nargs, argTypes, argValues, NULL,
+								  SPI_OK_INSERT, &isNullIgnore);
+
+	/* Drop the cached dictionary of the collection in every backend */
+	CacheInvalidateRelcacheByRelid(collection->relationId);
+
+	pgbson_writer childWriter;
+	PgbsonWriterStartDocument(writer, "fieldNameDictionary", 19, &childWriter);
+	PgbsonWriterAppendBool(&childWriter, "enabled", 7, enable);
+	PgbsonWriterAppendInt64(&childWriter, "numNames", 8, numNames + nameIndex);
+	PgbsonWriterAppendInt64(&childWriter, "numNamesAdded", 13, nameIndex);
+	PgbsonWriterEndDocument(writer, &childWriter);
+}
+
+
+/*
+ * Deletes the dictionary of a dropped collection.
+ */
+void
+DeleteCollectionFieldDictionary(uint64 collectionId)
+{
+	const char *query =
+		FormatSqlQuery("DELETE FROM %s.collection_field_dictionary"
+					   " WHERE collection_id = $1", ApiCatalogSchemaName);
+
+	int nargs = 1;
+	Oid argTypes[1] = { INT8OID };
+	Datum argValues[1] = { UInt64GetDatum(collectionId) };
+
+	bool isNullIgnore = false;
+	RunQueryWithCommutativeWrites(query, nargs, argTypes, argValues, NULL,
+								  SPI_OK_DELETE, &isNullIgnore);
+}
+
+
+/*
+ * Returns the dictionary an encoded document was encoded with: dictionaries
+ * are identified by the id of their collection.
+ */
+static const BsonFieldDictionary *
+GetDictionaryForEncodedDocument(const pgbson *document)
+{
+	uint32 numNames = 0;
+	int64 dictionaryId = PgbsonGetFieldDictionaryId(document, &numNames);
+
+	FieldDictionaryCacheEntry *entry =
+		GetFieldDictionaryCacheEntry((uint64) dictionaryId, numNames);
+	if (entry->dictionary == NULL || entry->dictionary->numNames < numNames)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Field name dictionary " INT64_FORMAT
+							   " of the document is not available", dictionaryId)));
+	}
+
+	return entry->dictionary;
+}
+
+
+/*
+ * Returns the cache entry of the collection's dictionary, loading it if it is
+ * not cached or has fewer than minNames names. Dictionaries only grow, so an
+ * entry that has enough names decodes any document that refers to it.
+ */
+static FieldDictionaryCacheEntry *
+GetFieldDictionaryCacheEntry(uint64 collectionId, uint32 minNames)
+{
+	if (FieldDictionaryCache == NULL)
+	{
+		CreateCacheMemoryContext();
+		FieldDictionaryCacheContext = AllocSetContextCreate(CacheMemoryContext,
+															"FieldDictionaryCacheContext",
+															ALLOCSET_DEFAULT_SIZES);
+
+		HASHCTL hashInfo;
+		memset(&hashInfo, 0, sizeof(hashInfo));
+		hashInfo.keysize = sizeof(uint64);
+		hashInfo.entrysize = sizeof(FieldDictionaryCacheEntry);
+		hashInfo.hcxt = FieldDictionaryCacheContext;
+		FieldDictionaryCache = hash_create("Field name dictionary cache", 32,
+										   &hashInfo,
+										   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		CacheRegisterRelcacheCallback(InvalidateFieldDictionaryCache, (Datum) 0);
+	}
+
+	bool found = false;
+	FieldDictionaryCacheEntry *entry = hash_search(FieldDictionaryCache, &collectionId,
+												   HASH_FIND, &found);
+	if (found && (minNames == 0 || (entry->dictionary != NULL &&
+									entry->dictionary->numNames >= minNames)))
+	{
+		return entry;
+	}
+
+	/*
+	 * Load before entering the cache: the query may process invalidations
+	 * that drop cache entries.
+	 */
+	FieldDictionaryCacheEntry loadedEntry = { 0 };
+	loadedEntry.collectionId = collectionId;
+	LoadFieldDictionary(&loadedEntry);
+
+	/* Resolve the data table so that its invalidations drop the entry */
+	char *tableName = psprintf(DOCUMENT_DATA_TABLE_NAME_FORMAT, collectionId);
+	loadedEntry.relationId = get_relname_relid(tableName, ApiDataNamespaceOid());
+
+	entry = hash_search(FieldDictionaryCache, &collectionId, HASH_ENTER, &found);
+	if (found)
+	{
+		ResetFieldDictionaryCacheEntry(entry);
+	}
+
+	*entry = loadedEntry;
+	return entry;
+}
+
+
+static void
+LoadFieldDictionary(FieldDictionaryCacheEntry *entry)
+{
+	const char *query =
+		FormatSqlQuery("SELECT is_enabled, field_names FROM %s.collection_field_dictionary"
+					   " WHERE collection_id = $1", ApiCatalogSchemaName);
+
+	int nargs = 1;
+	Oid argTypes[1] = { INT8OID };
+	Datum argValues[1] = { UInt64GetDatum(entry->collectionId) };
+
+	bool readOnly = true;
+	int numValues = 2;
+	bool isNull[2];
+	Datum results[2];
+	ExtensionExecuteMultiValueQueryWithArgsViaSPI(query, nargs, argTypes, argValues,
+												  NULL, readOnly, SPI_OK_SELECT, results,
+												  isNull, numValues);
+	if (isNull[0] || isNull[1])
+	{
+		return;
+	}
+
+	Datum *nameDatums = NULL;
+	bool *nameNulls = NULL;
+	int numNames = 0;
+	deconstruct_array(DatumGetArrayTypeP(results[1]), TEXTOID, -1, false,
+					  TYPALIGN_INT, &nameDatums, &nameNulls, &numNames);
+
+	MemoryContext dictionaryContext = AllocSetContextCreate(FieldDictionaryCacheContext,
+															"FieldDictionaryContext",
+															ALLOCSET_SMALL_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(dictionaryContext);
+
+	char **names = palloc(sizeof(char *) * Max(numNames, 1));
+	for (int i = 0; i < numNames; i++)
+	{
+		names[i] = nameNulls[i] ? pstrdup("") : TextDatumGetCString(nameDatums[i]);
+	}
+
+	BsonFieldDictionary *dictionary =
+		CreateBsonFieldDictionary((int64) entry->collectionId, names, numNames);
+	MemoryContextSwitchTo(oldContext);
+
+	entry->isEnabled = DatumGetBool(results[0]);
+	entry->dictionary = dictionary;
+	entry->dictionaryContext = dictionaryContext;
+}
+
+
+/*
+ * Drops the cached dictionaries of the invalidated data table, or all of them
+ * on a reset.
+ */
+static void
+InvalidateFieldDictionaryCache(Datum argument, Oid relationId)
+{
+	if (FieldDictionaryCache == NULL)
+	{
+		return;
+	}
+
+	HASH_SEQ_STATUS status;
+	hash_seq_init(&status, FieldDictionaryCache);
+
+	FieldDictionaryCacheEntry *entry;
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		if (relationId == InvalidOid || entry->relationId == relationId)
+		{
+			ResetFieldDictionaryCacheEntry(entry);
+			hash_search(FieldDictionaryCache, &entry->collectionId, HASH_REMOVE, NULL);
+		}
+	}
+}
+
+
+static void
+ResetFieldDictionaryCacheEntry(FieldDictionaryCacheEntry *entry)
+{
+	if (entry->dictionaryContext != NULL)
+	{
+		MemoryContextDelete(entry->dictionaryContext);
+	}
+
+	entry->isEnabled = false;
+	entry->dictionary = NULL;
+	entry->dictionaryContext = NULL;
+}
+
+
+/*
+ * Returns the field names of a sample of the collection's documents that are
+ * not in the dictionary, ordered by the bytes encoding them would save.
+ */
+static List *
+SampleFieldDictionaryNames(const MongoCollection *collection, uint32 maxNames)
+{
+	MemoryContext sampleContext = CurrentMemoryContext;
+
+	HASHCTL hashInfo = CreateExtensionHashCTL(sizeof(StringView),
+											  sizeof(FieldNameSampleEntry),
+											  FieldNameSampleCompareFunc,
+											  FieldNameSampleHashFunc);
+	HTAB *sampleNames = hash_create("Field name dictionary sample", 256, &hashInfo,
+									DefaultExtensionHashFlags);
+
+	StringInfo query = makeStringInfo();
+	appendStringInfo(query, "SELECT document FROM %s.%s LIMIT %d",
+					 ApiDataSchemaName, collection->tableName,
+					 FIELD_DICTIONARY_SAMPLE_SIZE);
+
+	SPI_connect();
+	bool readOnly = true;
+	if (SPI_execute(query->data, readOnly, 0) != SPI_OK_SELECT)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("could not sample the documents of collection %s.%s",
+							   collection->name.databaseName,
+							   collection->name.collectionName)));
+	}
+
+	for (uint64 i = 0; i < SPI_processed; i++)
+	{
+		bool isNull = false;
+		Datum documentDatum = SPI_getbinval(SPI_tuptable->vals[i],
+											SPI_tuptable->tupdesc, 1, &isNull);
+		if (isNull)
+		{
+			continue;
+		}
+
+		MemoryContext spiContext = MemoryContextSwitchTo(sampleContext);
+		bson_iter_t documentIter;
+		PgbsonInitIterator(DatumGetStoredPgBson(documentDatum), &documentIter);
+		CollectSampleFieldNames(&documentIter, false, sampleNames);
+		MemoryContextSwitchTo(spiContext);
+	}
+
+	SPI_finish();
+
+	/* Look the dictionary up after the query, which may have invalidated it */
+	const BsonFieldDictionary *dictionary =
+		GetFieldDictionaryCacheEntry(collection->collectionId, 0)->dictionary;
+
+	long numSampleNames = hash_get_num_entries(sampleNames);
+	FieldNameSampleEntry **candidates =
+		palloc(sizeof(FieldNameSampleEntry *) * Max(numSampleNames, 1));
+	int numCandidates = 0;
+
+	HASH_SEQ_STATUS status;
+	hash_seq_init(&status, sampleNames);
+	FieldNameSampleEntry *sampleEntry;
+	while ((sampleEntry = hash_seq_search(&status)) != NULL)
+	{
+		bool inDictionary = false;
+		if (dictionary != NULL)
+		{
+			hash_search(dictionary->nameLookup, &sampleEntry->name, HASH_FIND,
+						&inDictionary);
+		}
+
+		if (!inDictionary && sampleEntry->savedBytes > 0)
+		{
+			candidates[numCandidates++] = sampleEntry;
+		}
+	}
+
+	qsort(candidates, numCandidates, sizeof(FieldNameSampleEntry *),
+		  CompareSampleEntriesBySavedBytes);
+
+	List *names = NIL;
+	for (int i = 0; i < numCandidates && (uint32) i < maxNames; i++)
+	{
+		names = lappend(names, CreateStringFromStringView(&candidates[i]->name));
+	}
+
+	return names;
+}
+
+
+static void
+CollectSampleFieldNames(bson_iter_t *iter, bool isArray, HTAB *names)
+{
+	while (bson_iter_next(iter))
+	{
+		if (!isArray)
+		{
+			StringView name =
+				CreateStringViewFromStringWithLength(bson_iter_key(iter),
+													 bson_iter_key_len(iter));
+			if (IsBsonFieldDictionaryCandidate(name.string, name.length))
+			{
+				bool found = false;
+				FieldNameSampleEntry *entry = hash_search(names, &name, HASH_ENTER,
+														  &found);
+				if (!found)
+				{
+					entry->name.string = pnstrdup(name.string, name.length);
+					entry->name.length = name.length;
+					entry->savedBytes = 0;
+				}
+
+				entry->savedBytes += (int64) name.length -
+									 FIELD_DICTIONARY_ENCODED_NAME_LENGTH;
+			}
+		}
+
+		bson_iter_t childIter;
+		if ((BSON_ITER_HOLDS_DOCUMENT(iter) || BSON_ITER_HOLDS_ARRAY(iter)) &&
+			bson_iter_recurse(iter, &childIter))
+		{
+			CollectSampleFieldNames(&childIter, BSON_ITER_HOLDS_ARRAY(iter), names);
+		}
+	}
+}
+
+
+static int
+CompareSampleEntriesBySavedBytes(const void *left, const void *right)
+{
+	const FieldNameSampleEntry *leftEntry = *(const FieldNameSampleEntry **) left;
+	const FieldNameSampleEntry *rightEntry = *(const FieldNameSampleEntry **) right;
+
+	if (leftEntry->savedBytes != rightEntry->savedBytes)
+	{
+		return leftEntry->savedBytes > rightEntry->savedBytes ? -1 : 1;
+	}
+
+	return CompareStringView(&leftEntry->name, &rightEntry->name);
+}
+
+
+static uint32
+FieldNameSampleHashFunc(const void *obj, size_t objsize)
+{
+	return HashStringView((const StringView *) obj);
+}
+
+
+static int
+FieldNameSampleCompareFunc(const void *obj1, const void *obj2, Size objsize)
+{
+	return CompareStringView((const StringView *) obj1, (const StringView *) obj2);
+}
@@ -0,0 +1,821 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/metadata/collection_shared_cache.c
+ *
+ * Implementation of the shared memory collection metadata cache.
+ *
+ * The per backend collection caches in collection.c are filled from
+ * ApiCatalogSchemaName.collections via SPI. This cache sits underneath them
+ * so that a backend that misses in its own cache can copy the catalog entry
+ * from shared memory instead of querying the catalog.
+ *
+ * Entries are keyed by (database OID, collection_id) with a secondary
+ * (database OID, qualified name) -> collection_id map for lookups by name.
+ * The number of entries is bounded by
+ * documentdb.sharedCollectionCacheMaxEntries and entries whose BSON
+ * attributes (shard key, view definition, validator) do not fit inline
+ * are not shared.
+ *
+ * Only the collections catalog is covered: index metadata is read from
+ * ApiCatalogSchemaName.collection_indexes by each backend as before. Index
+ * builds update those rows at every step, which would need invalidation
+ * hooks of their own.
+ *
+ * Invalidation is pushed by the backend changing the catalog: Rows touched
+ * in ApiCatalogSchemaName.collections are recorded by the collections
+ * trigger and removed from the cache once the transaction commits, at
+ * which point the change is visible to everyone. Every change also bumps a
+ * generation counter: A backend reads the generation before querying the
+ * catalog and only publishes what it read if no change was committed in
+ * the meantime. This keeps a backend that read the catalog just before a
+ * commit from re-publishing the stale row after its invalidation.
+ *
+ * A prepared transaction is committed by whichever backend runs COMMIT
+ * PREPARED, which we cannot hook into. Preparing a transaction that changed
+ * the catalog therefore resets the whole cache and records its xid: Nothing
+ * is published while the xid is in progress, and the first publisher that
+ * finds it finished bumps the generation so that rows read before its commit
+ * are not published. Prepared transactions recovered after a restart are
+ * not known by xid, so publishing waits until every transaction that was
+ * running when the cache was first used has finished.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include <miscadmin.h>
+#include <access/transam.h>
+#include <access/twophase.h>
+#include <access/xact.h>
+#include <nodes/pg_list.h>
+#include <port/atomics.h>
+#include <storage/lwlock.h>
+#include <storage/procarray.h>
+#include <storage/shmem.h>
+#include <utils/hsearch.h>
+#include <utils/memutils.h>
+
+#include "io/bson_core.h"
+#include "metadata/collection_shared_cache.h"
+#include "metadata/metadata_cache.h"
+
+/* The max combined size of the BSON attributes of a shared entry */
+#define SHARED_COLLECTION_CACHE_MAX_BSON_SIZE 1024
+
+/* The number of entries inspected when picking one to evict */
+#define SHARED_COLLECTION_CACHE_EVICTION_SAMPLE_SIZE 16
+
+extern int SharedCollectionCacheMaxEntries;
+
+
+/*
+ * SharedCollectionCacheKey is the key of the primary collection hash.
+ */
+typedef struct SharedCollectionCacheKey
+{
+	Oid databaseId;
+	uint64 collectionId;
+} SharedCollectionCacheKey;
+
+/*
+ * SharedCollectionNameKey is the key of the name -> collection_id hash.
+ */
+typedef struct SharedCollectionNameKey
+{
+	Oid databaseId;
+	MongoCollectionName name;
+} SharedCollectionNameKey;
+
+/*
+ * SharedCollectionCacheEntry holds the catalog attributes of a single
+ * collection or view. Only the attributes read from the catalog are kept:
+ * the relation OID and the shard table are resolved by each backend.
+ */
+typedef struct SharedCollectionCacheEntry
+{
+	SharedCollectionCacheKey key;
+
+	/* OID of the collections table the entry was read from */
+	Oid collectionsTableId;
+
+	/* the generation at which the entry was published */
+	uint64 version;
+
+	/* value of the access clock on the last hit, used for eviction */
+	pg_atomic_uint64 lastAccess;
+
+	/* catalog metadata with all the pointers cleared */
+	MongoCollection collection;
+
+	/* sizes of the BSON attributes stored back to back in bsonData */
+	uint32 shardKeySize;
+	uint32 viewDefinitionSize;
+	uint32 validatorSize;
+	char bsonData[SHARED_COLLECTION_CACHE_MAX_BSON_SIZE];
+} SharedCollectionCacheEntry;
+
+typedef struct SharedCollectionNameEntry
+{
+	SharedCollectionNameKey key;
+	uint64 collectionId;
+} SharedCollectionNameEntry;
+
+/*
+ * SharedCollectionCacheState is the fixed part of the cache in shared memory.
+ * Everything but the access clock is protected by lock.
+ */
+typedef struct SharedCollectionCacheState
+{
+	int trancheId;
+	char *trancheName;
+	LWLock lock;
+
+	/* incremented on every committed change of the collections catalog */
+	uint64 generation;
+
+	/* entries published before this generation are stale */
+	uint64 resetGeneration;
+
+	pg_atomic_uint64 accessClock;
+
+	/*
+	 * Whether transactions recovered as prepared may still be running, and
+	 * the next xid when this was first checked (any such transaction is older).
+	 */
+	bool checkRecoveredPreparedXacts;
+	TransactionId recoveredPreparedXidHorizon;
+
+	/* xids of the prepared transactions that changed the catalog */
+	int numPreparedXids;
+	TransactionId preparedXids[FLEXIBLE_ARRAY_MEMBER];
+} SharedCollectionCacheState;
+
+
+static SharedCollectionCacheState *SharedCollectionCache = NULL;
+static HTAB *SharedCollectionHash = NULL;
+static HTAB *SharedCollectionNameHash = NULL;
+
+/*
+ * Collection IDs whose catalog rows were modified in the current transaction
+ * and that need to be removed from the cache on commit.
+ */
+static List *PendingCollectionInvalidations = NIL;
+
+/* Whether the whole cache needs to be reset on commit */
+static bool PendingCollectionCacheReset = false;
+
+/*
+ * Whether the current transaction modified the collections catalog. Such a
+ * transaction sees its own uncommitted rows and so does not publish entries.
+ */
+static bool CollectionCatalogModifiedInTransaction = false;
+
+/* xid of the transaction being prepared, if it has changes to push */
+static TransactionId PreparingCollectionCatalogXid = InvalidTransactionId;
+
+
+static bool TryGetCollectionFromSharedEntry(SharedCollectionCacheEntry *entry,
+											Oid collectionsTableId,
+											MongoCollection *collection);
+static void RemoveSharedCollectionEntry(SharedCollectionCacheEntry *entry);
+static void EvictSharedCollectionEntry(void);
+static bool RetireFinishedPreparedTransactions(void);
+static Size SharedCollectionCacheStateSize(void);
+
+
+/*
+ * Returns the amount of shared memory needed for the cache.
+ */
+Size
+SharedCollectionCacheShmemSize(void)
+{
+	Size size = MAXALIGN(SharedCollectionCacheStateSize());
+	if (SharedCollectionCacheMaxEntries > 0)
+	{
+		size = add_size(size, hash_estimate_size(SharedCollectionCacheMaxEntries,
+												 sizeof(SharedCollectionCacheEntry)));
+		size = add_size(size, hash_estimate_size(SharedCollectionCacheMaxEntries,
+												 sizeof(SharedCollectionNameEntry)));
+	}
+
+	return size;
+}
+
+
+/*
+ * Initializes the shared memory state and hashes of the cache.
+ */
+void
+InitializeSharedCollectionCacheShmem(void)
+{
+	bool found = false;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	SharedCollectionCache =
+		(SharedCollectionCacheState *) ShmemInitStruct(
+			"Shared Collection Cache State",
+			SharedCollectionCacheStateSize(),
+			&found);
+
+	if (!found)
+	{
+		SharedCollectionCache->trancheId = LWLockNewTrancheId();
+		SharedCollectionCache->trancheName = "Shared Collection Cache Tranche";
+		LWLockRegisterTranche(SharedCollectionCache->trancheId,
+							  SharedCollectionCache->trancheName);
+
+		LWLockInitialize(&SharedCollectionCache->lock,
+						 SharedCollectionCache->trancheId);
+		SharedCollectionCache->generation = 1;
+		SharedCollectionCache->resetGeneration = 0;
+		pg_atomic_init_u64(&SharedCollectionCache->accessClock, 0);
+		SharedCollectionCache->checkRecoveredPreparedXacts = max_prepared_xacts > 0;
+		SharedCollectionCache->recoveredPreparedXidHorizon = InvalidTransactionId;
+		SharedCollectionCache->numPreparedXids = 0;
+	}
+
+	if (SharedCollectionCacheMaxEntries > 0)
+	{
+		HASHCTL info;
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(SharedCollectionCacheKey);
+		info.entrysize = sizeof(SharedCollectionCacheEntry);
+		SharedCollectionHash = ShmemInitHash("Shared Collection Cache Hash",
+											 SharedCollectionCacheMaxEntries,
+											 SharedCollectionCacheMaxEntries,
+											 &info, HASH_ELEM | HASH_BLOBS);
+
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(SharedCollectionNameKey);
+		info.entrysize = sizeof(SharedCollectionNameEntry);
+		SharedCollectionNameHash = ShmemInitHash("Shared Collection Name Cache Hash",
+												 SharedCollectionCacheMaxEntries,
+												 SharedCollectionCacheMaxEntries,
+												 &info, HASH_ELEM | HASH_BLOBS);
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+
+/*
+ * Whether the shared cache is set up in this server (it requires the
+ * extension to be in shared_preload_libraries).
+ */
+bool
+IsSharedCollectionCacheEnabled(void)
+{
+	return SharedCollectionCache != NULL && SharedCollectionHash != NULL;
+}
+
+
+/*
+ * Returns the current generation of the cache. Callers read this before
+ * querying the catalog and pass it to AddCollectionToSharedCache.
+ */
+uint64
+GetSharedCollectionCacheGeneration(void)
+{
+	if (!IsSharedCollectionCacheEnabled())
+	{
+		return 0;
+	}
+
+	LWLockAcquire(&SharedCollectionCache->lock, LW_SHARED);
+	uint64 generation = SharedCollectionCache->generation;
+	LWLockRelease(&SharedCollectionCache->lock);
+
+	return generation;
+}
+
+
+/*
+ * Looks up a collection in the shared cache by its qualified name. On a hit
+ * the catalog attributes are copied into collection (with the BSON attributes
+ * allocated in the current memory context).
+ */
+bool
+TryGetCollectionFromSharedCacheByName(const MongoCollectionName *name,
+									  MongoCollection *collection)
+{
+	if (!IsSharedCollectionCacheEnabled())
+	{
+		return false;
+	}
+
+	Oid collectionsTableId = ApiCatalogCollectionsTableOid();
+
+	SharedCollectionNameKey nameKey;
+	memset(&nameKey, 0, sizeof(nameKey));
+	nameKey.databaseId = MyDatabaseId;
+	nameKey.name = *name;
+
+	bool found = false;
+	LWLockAcquire(&SharedCollectionCache->lock, LW_SHARED);
+
+	SharedCollectionNameEntry *nameEntry =
+		hash_search(SharedCollectionNameHash, &nameKey, HASH_FIND, &found);
+	if (found)
+	{
+		SharedCollectionCacheKey key;
+		memset(&key, 0, sizeof(key));
+		key.databaseId = MyDatabaseId;
+		key.collectionId = nameEntry->collectionId;
+
+		SharedCollectionCacheEntry *entry =
+			hash_search(SharedCollectionHash, &key, HASH_FIND, &found);
+		found = found && TryGetCollectionFromSharedEntry(entry, collectionsTableId,
+														 collection);
+	}
+
+	LWLockRelease(&SharedCollectionCache->lock);
+	return found;
+}
+
+
+/*
+ * Looks up a collection in the shared cache by its collection_id.
+ */
+bool
+TryGetCollectionFromSharedCacheById(uint64 collectionId, MongoCollection *collection)
+{
+	if (!IsSharedCollectionCacheEnabled())
+	{
+		return false;
+	}
+
+	Oid collectionsTableId = ApiCatalogCollectionsTableOid();
+
+	SharedCollectionCacheKey key;
+	memset(&key, 0, sizeof(key));
+	key.databaseId = MyDatabaseId;
+	key.collectionId = collectionId;
+
+	bool found = false;
+	LWLockAcquire(&SharedCollectionCache->lock, LW_SHARED);
+
+	SharedCollectionCacheEntry *entry =
+		hash_search(SharedCollectionHash, &key, HASH_FIND, &found);
+	found = found && TryGetCollectionFromSharedEntry(entry, collectionsTableId,
+													 collection);
+
+	LWLockRelease(&SharedCollectionCache->lock);
+	return found;
+}
+
+
+/*
+ * Publishes the catalog attributes of a collection that were read from the
+ * catalog at the given generation. Does nothing if the catalog changed since,
+ * if the transaction may not see the latest committed catalog, or if the
+ * BSON attributes of the collection are too large to be shared.
+ */
+void
+AddCollectionToSharedCache(const MongoCollection *collection, uint64 generation)
+{
+	if (!IsSharedCollectionCacheEnabled() || generation == 0 ||
+		CollectionCatalogModifiedInTransaction || IsolationUsesXactSnapshot() ||
+		IsInParallelMode())
+	{
+		return;
+	}
+
+	uint32 shardKeySize = collection->shardKey != NULL ?
+						  VARSIZE(collection->shardKey) : 0;
+	uint32 viewDefinitionSize = collection->viewDefinition != NULL ?
+								VARSIZE(collection->viewDefinition) : 0;
+	uint32 validatorSize = collection->schemaValidator.validator != NULL ?
+						   VARSIZE(collection->schemaValidator.validator) : 0;
+	if ((Size) shardKeySize + viewDefinitionSize + validatorSize >
+		SHARED_COLLECTION_CACHE_MAX_BSON_SIZE)
+	{
+		return;
+	}
+
+	Oid collectionsTableId = ApiCatalogCollectionsTableOid();
+	if (!OidIsValid(collectionsTableId))
+	{
+		return;
+	}
+
+	LWLockAcquire(&SharedCollectionCache->lock, LW_EXCLUSIVE);
+
+	if (!RetireFinishedPreparedTransactions())
+	{
+		/* a prepared transaction may still change what we read */
+		LWLockRelease(&SharedCollectionCache->lock);
+		return;
+	}
+
+	if (SharedCollectionCache->generation != generation)
+	{
+		/* the catalog changed after we read it */
+		LWLockRelease(&SharedCollectionCache->lock);
+		return;
+	}
+
+	SharedCollectionCacheKey key;
+	memset(&key, 0, sizeof(key));
+	key.databaseId = MyDatabaseId;
+	key.collectionId = collection->collectionId;
+
+	bool found = false;
+	SharedCollectionCacheEntry *entry =
+		hash_search(SharedCollectionHash, &key, HASH_FIND, &found);
+	if (found)
+	{
+		/* replace the existing entry, its name may be stale */
+		RemoveSharedCollectionEntry(entry);
+	}
+
+	if (hash_get_num_entries(SharedCollectionHash) >= SharedCollectionCacheMaxEntries)
+	{
+		EvictSharedCollectionEntry();
+	}
+
+	SharedCollectionNameKey nameKey;
+	memset(&nameKey, 0, sizeof(nameKey));
+	nameKey.databaseId = MyDatabaseId;
+	nameKey.name = collection->name;
+
+	/* HASH_ENTER_NULL so that a full hash skips the entry instead of erroring */
+	SharedCollectionNameEntry *nameEntry =
+		hash_search(SharedCollectionNameHash, &nameKey, HASH_ENTER_NULL, &found);
+	if (nameEntry == NULL)
+	{
+		LWLockRelease(&SharedCollectionCache->lock);
+		return;
+	}
+
+	entry = hash_search(SharedCollectionHash, &key, HASH_ENTER_NULL, &found);
+	if (entry == NULL)
+	{
+		hash_search(SharedCollectionNameHash, &nameKey, HASH_REMOVE, NULL);
+		LWLockRelease(&SharedCollectionCache->lock);
+		return;
+	}
+
+	nameEntry->collectionId = collection->collectionId;
+
+	entry->collectionsTableId = collectionsTableId;
+	entry->version = generation;
+	pg_atomic_init_u64(&entry->lastAccess,
+					   pg_atomic_fetch_add_u64(&SharedCollectionCache->accessClock, 1));
+
+	entry->collection = *collection;
+	entry->collection.relationId = InvalidOid;
+	entry->collection.shardKey = NULL;
+	entry->collection.viewDefinition = NULL;
+	entry->collection.schemaValidator.validator = NULL;
+	entry->collection.mongoDataCreationTimeVarAttrNumber = 0;
+	entry->collection.shardTableName[0] = '\0';
+	entry->collection.isShardRemote = false;
+
+	entry->shardKeySize = shardKeySize;
+	entry->viewDefinitionSize = viewDefinitionSize;
+	entry->validatorSize = validatorSize;
+
+	char *bsonData = entry->bsonData;
+	if (shardKeySize > 0)
+	{
+		memcpy(bsonData, collection->shardKey, shardKeySize);
+		bsonData += shardKeySize;
+	}
+
+	if (viewDefinitionSize > 0)
+	{
+		memcpy(bsonData, collection->viewDefinition, viewDefinitionSize);
+		bsonData += viewDefinitionSize;
+	}
+
+	if (validatorSize > 0)
+	{
+		memcpy(bsonData, collection->schemaValidator.validator, validatorSize);
+	}
+
+	LWLockRelease(&SharedCollectionCache->lock);
+}
+
+
+/*
+ * Records that the catalog row of the given collection was modified in the
+ * current transaction. The collection is removed from the shared cache when
+ * the transaction commits. A collectionId of 0 only records that the catalog
+ * was modified (e.g. on insert, where there is nothing to invalidate).
+ */
+void
+RecordCollectionCatalogChange(uint64 collectionId)
+{
+	CollectionCatalogModifiedInTransaction = true;
+
+	if (collectionId == 0 || !IsSharedCollectionCacheEnabled())
+	{
+		return;
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(TopTransactionContext);
+	uint64 *pendingCollectionId = palloc(sizeof(uint64));
+	*pendingCollectionId = collectionId;
+	PendingCollectionInvalidations = lappend(PendingCollectionInvalidations,
+											 pendingCollectionId);
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * Records that the whole shared cache should be reset when the current
+ * transaction commits.
+ */
+void
+RecordCollectionCatalogReset(void)
+{
+	CollectionCatalogModifiedInTransaction = true;
+	PendingCollectionCacheReset = true;
+}
+
+
+/*
+ * Pushes the invalidations recorded in the transaction to the shared cache
+ * on commit, and forgets them on abort.
+ */
+void
+AtEOXactSharedCollectionCache(bool isCommit)
+{
+	if (isCommit && IsSharedCollectionCacheEnabled() &&
+		(PendingCollectionCacheReset || PendingCollectionInvalidations != NIL))
+	{
+		LWLockAcquire(&SharedCollectionCache->lock, LW_EXCLUSIVE);
+
+		SharedCollectionCache->generation++;
+		if (PendingCollectionCacheReset)
+		{
+			/* existing entries are treated as misses and replaced lazily */
+			SharedCollectionCache->resetGeneration = SharedCollectionCache->generation;
+		}
+		else
+		{
+			ListCell *cell;
+			foreach(cell, PendingCollectionInvalidations)
+			{
+				SharedCollectionCacheKey key;
+				memset(&key, 0, sizeof(key));
+				key.databaseId = MyDatabaseId;
+				key.collectionId = *(uint64 *) lfirst(cell);
+
+				bool found = false;
+				SharedCollectionCacheEntry *entry =
+					hash_search(SharedCollectionHash, &key, HASH_FIND, &found);
+				if (found)
+				{
+					RemoveSharedCollectionEntry(entry);
+				}
+			}
+		}
+
+		LWLockRelease(&SharedCollectionCache->lock);
+	}
+
+	/* the list is in TopTransactionContext which is going away */
+	PendingCollectionInvalidations = NIL;
+	PreparingCollectionCatalogXid = InvalidTransactionId;
+	PendingCollectionCacheReset = false;
+	CollectionCatalogModifiedInTransaction = false;
+}
+
+
+/*
+ * Remembers the xid of a transaction that is about to be prepared with
+ * changes to push to the shared cache. The xid is no longer current once the
+ * transaction is prepared.
+ */
+void
+AtPrePrepareSharedCollectionCache(void)
+{
+	PreparingCollectionCatalogXid = InvalidTransactionId;
+	if (IsSharedCollectionCacheEnabled() &&
+		(PendingCollectionCacheReset || PendingCollectionInvalidations != NIL))
+	{
+		PreparingCollectionCatalogXid = GetTopTransactionIdIfAny();
+	}
+}
+
+
+/*
+ * Resets the shared cache once a transaction that changed the catalog is
+ * prepared, and records its xid so that nothing is published until it is
+ * committed or rolled back by whichever backend runs COMMIT PREPARED.
+ */
+void
+AtPrepareSharedCollectionCache(void)
+{
+	if (TransactionIdIsValid(PreparingCollectionCatalogXid))
+	{
+		LWLockAcquire(&SharedCollectionCache->lock, LW_EXCLUSIVE);
+
+		SharedCollectionCache->generation++;
+		SharedCollectionCache->resetGeneration = SharedCollectionCache->generation;
+
+		/* there is a slot for every transaction that can be prepared */
+		Assert(SharedCollectionCache->numPreparedXids < max_prepared_xacts);
+		if (SharedCollectionCache->numPreparedXids < max_prepared_xacts)
+		{
+			SharedCollectionCache->preparedXids[
+				SharedCollectionCache->numPreparedXids++] =
+				PreparingCollectionCatalogXid;
+		}
+
+		LWLockRelease(&SharedCollectionCache->lock);
+	}
+
+	PreparingCollectionCatalogXid = InvalidTransactionId;
+	AtEOXactSharedCollectionCache(false);
+}
+
+
+/*
+ * Copies the catalog attributes out of a shared entry if it is still current.
+ * Must be called with the cache lock held.
+ */
+static bool
+TryGetCollectionFromSharedEntry(SharedCollectionCacheEntry *entry,
+								Oid collectionsTableId, MongoCollection *collection)
+{
+	if (entry->version < SharedCollectionCache->resetGeneration ||
+		entry->collectionsTableId != collectionsTableId)
+	{
+		return false;
+	}
+
+	pg_atomic_write_u64(&entry->lastAccess,
+						pg_atomic_fetch_add_u64(&SharedCollectionCache->accessClock, 1));
+
+	*collection = entry->collection;
+
+	char *bsonData = entry->bsonData;
+	if (entry->shardKeySize > 0)
+	{
+		collection->shardKey = palloc(entry->shardKeySize);
+		memcpy(collection->shardKey, bsonData, entry->shardKeySize);
+		bsonData += entry->shardKeySize;
+	}
+
+	if (entry->viewDefinitionSize > 0)
+	{
+		collection->viewDefinition = palloc(entry->viewDefinitionSize);
+		memcpy(collection->viewDefinition, bsonData, entry->viewDefinitionSize);
+		bsonData += entry->viewDefinitionSize;
+	}
+
+	if (entry->validatorSize > 0)
+	{
+		collection->schemaValidator.validator = palloc(entry->validatorSize);
+		memcpy(collection->schemaValidator.validator, bsonData, entry->validatorSize);
+	}
+
+	return true;
+}
+
+
+/*
+ * Removes an entry and its name mapping. Must be called with the cache lock
+ * held in exclusive mode.
+ */
+static void
+RemoveSharedCollectionEntry(SharedCollectionCacheEntry *entry)
+{
+	SharedCollectionNameKey nameKey;
+	memset(&nameKey, 0, sizeof(nameKey));
+	nameKey.databaseId = entry->key.databaseId;
+	nameKey.name = entry->collection.name;
+
+	bool found = false;
+	SharedCollectionNameEntry *nameEntry =
+		hash_search(SharedCollectionNameHash, &nameKey, HASH_FIND, &found);
+
+	/* the name may have been reused by another collection since */
+	if (found && nameEntry->collectionId == entry->key.collectionId)
+	{
+		hash_search(SharedCollectionNameHash, &nameKey, HASH_REMOVE, NULL);
+	}
+
+	SharedCollectionCacheKey key = entry->key;
+	hash_search(SharedCollectionHash, &key, HASH_REMOVE, NULL);
+}
+
+
+/*
+ * Evicts the least recently accessed of a sample of entries, preferring stale
+ * ones. Must be called with the cache lock held in exclusive mode.
+ */
+static void
+EvictSharedCollectionEntry(void)
+{
+	HASH_SEQ_STATUS status;
+	SharedCollectionCacheEntry *entry;
+	SharedCollectionCacheKey victimKey = { 0 };
+	uint64 victimLastAccess = PG_UINT64_MAX;
+	bool hasVictim = false;
+	int sampled = 0;
+
+	hash_seq_init(&status, SharedCollectionHash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		uint64 lastAccess = pg_atomic_read_u64(&entry->lastAccess);
+		if (entry->version < SharedCollectionCache->resetGeneration)
+		{
+			lastAccess = 0;
+		}
+
+		if (!hasVictim || lastAccess < victimLastAccess)
+		{
+			victimKey = entry->key;
+			victimLastAccess = lastAccess;
+			hasVictim = true;
+		}
+
+		if (++sampled >= SHARED_COLLECTION_CACHE_EVICTION_SAMPLE_SIZE ||
+			victimLastAccess == 0)
+		{
+			hash_seq_term(&status);
+			break;
+		}
+	}
+
+	if (hasVictim)
+	{
+		bool found = false;
+		entry = hash_search(SharedCollectionHash, &victimKey, HASH_FIND, &found);
+		if (found)
+		{
+			RemoveSharedCollectionEntry(entry);
+		}
+	}
+}
+
+
+/*
+ * Forgets the prepared transactions that have since been committed or rolled
+ * back, and returns whether none is left in progress. When one is forgotten
+ * the generation is bumped, as rows read before its commit may be stale. Must
+ * be called with the cache lock held in exclusive mode.
+ */
+static bool
+RetireFinishedPreparedTransactions(void)
+{
+	bool retired = false;
+	bool anyInProgress = false;
+
+	if (SharedCollectionCache->checkRecoveredPreparedXacts)
+	{
+		if (!TransactionIdIsValid(SharedCollectionCache->recoveredPreparedXidHorizon))
+		{
+			SharedCollectionCache->recoveredPreparedXidHorizon = ReadNextTransactionId();
+		}
+
+		if (TransactionIdPrecedesOrEquals(
+				SharedCollectionCache->recoveredPreparedXidHorizon,
+				GetOldestTransactionIdConsideredRunning()))
+		{
+			SharedCollectionCache->checkRecoveredPreparedXacts = false;
+			retired = true;
+		}
+		else
+		{
+			anyInProgress = true;
+		}
+	}
+
+	int i = 0;
+	while (i < SharedCollectionCache->numPreparedXids)
+	{
+		if (TransactionIdIsInProgress(SharedCollectionCache->preparedXids[i]))
+		{
+			anyInProgress = true;
+			i++;
+			continue;
+		}
+
+		SharedCollectionCache->preparedXids[i] =
+			SharedCollectionCache->preparedXids[--SharedCollectionCache->numPreparedXids];
+		retired = true;
+	}
+
+	if (retired)
+	{
+		SharedCollectionCache->generation++;
+	}
+
+	return !anyInProgress;
+}
+
+
+/*
+ * Returns the size of the fixed part of the cache, with a slot for the xid
+ * of every transaction that can be prepared.
+ */
+static Size
+SharedCollectionCacheStateSize(void)
+{
+	return add_size(offsetof(SharedCollectionCacheState, preparedXids),
+					mul_size(max_prepared_xacts, sizeof(TransactionId)));
+}
@@ -2061,9 +2061,14 @@ RegisterIndexBuildBackgroundWorkerJobs(void)
 			.isNull = false
 		},
 		.timeoutInSeconds = 300,     /* 5 minutes timeout */
-		.toBeExecutedOnMetadataCoordinatorOnly = true
+		.toBeExecutedOnMetadataCoordinatorOnly = true,
+		.priority = BackgroundWorkerJobPriority_Normal
 	};
 
+	/*
+	 * The second index build job only adds build throughput, it yields to the
+	 * first one and to other jobs when concurrency slots are scarce.
+	 */
 	BackgroundWorkerJob indexBuildJob2 = {
 		.jobId = DOCUMENTDB_INDEX_BUILD_JOB2_JOBID,
 		.jobName = "documentdb_index_build_background_job_2",
@@ -2078,7 +2083,8 @@ RegisterIndexBuildBackgroundWorkerJobs(void)
 			.isNull = false
 		},
 		.timeoutInSeconds = 300,     /* 5 minutes timeout */
-		.toBeExecutedOnMetadataCoordinatorOnly = true
+		.toBeExecutedOnMetadataCoordinatorOnly = true,
+		.priority = BackgroundWorkerJobPriority_Low
 	};
 
 	RegisterBackgroundWorkerJob(indexBuildJob1);
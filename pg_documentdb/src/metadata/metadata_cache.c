@@ -212,6 +212,9 @@ typedef struct DocumentDBApiOidCacheData
 	/* OID of the current_op aggregation function */
 	Oid BsonCurrentOpAggregationFunctionId;
 
+	/* OID of the query_stats_aggregation function */
+	Oid BsonQueryStatsAggregationFunctionId;
+
 	/* OID of the ApiSchemaName.list_indexes function */
 	Oid IndexSpecAsBsonFunctionId;
 
@@ -428,6 +431,15 @@ typedef struct DocumentDBApiOidCacheData
 	/* Oid of the index hint function */
 	Oid BsonIndexHintFunctionId;
 
+	/* Oid of the bson_decode_stored_document function */
+	Oid BsonDecodeStoredDocumentFunctionId;
+
+	/* Oid of the ApiInternalSchemaName.bson_update_document function */
+	Oid BsonUpdateDocumentFunctionId;
+
+	/* Oid of the ApiInternalSchemaNameV2.update_bson_document function */
+	Oid UpdateBsonDocumentFunctionId;
+
 	/* Oid of the $range runtime operator #<> */
 	Oid BsonRangeMatchOperatorOid;
 
@@ -927,6 +939,12 @@ typedef struct DocumentDBApiOidCacheData
 	/* OID of the bson_add_to_set function. */
 	Oid ApiCatalogBsonAddToSetAggregateFunctionOid;
 
+	/* OID of the bson_add_to_set function that can spill to disk. */
+	Oid ApiInternalBsonAddToSetWithSpillAggregateFunctionOid;
+
+	/* OID of the bson_array_agg function that can spill to disk. */
+	Oid ApiInternalBsonArrayAggregateWithSpillFunctionOid;
+
 	/* OID of the bson_repath_and_build function */
 	Oid ApiCatalogBsonRepathAndBuildFunctionOid;
 
@@ -1011,6 +1029,9 @@ typedef struct DocumentDBApiOidCacheData
 	/* OID of the ApiInternalSchemaName.bson_dollar_bucket_auto function */
 	Oid BsonDollarBucketAutoFunctionOid;
 
+	/* OID of the ApiInternalSchemaName.bson_index_distinct_scan function */
+	Oid BsonIndexDistinctScanFunctionOid;
+
 	/* Postgis box2df type id */
 	Oid Box2dfTypeId;
 
@@ -1912,6 +1933,49 @@ BsonIndexHintFunctionOid(void)
 }
 
 
+Oid
+BsonDecodeStoredDocumentFunctionOid(void)
+{
+	int nargs = 1;
+	Oid argTypes[1] = { BsonTypeId() };
+	bool missingOk = false;
+	return GetSchemaFunctionIdWithNargs(&Cache.BsonDecodeStoredDocumentFunctionId,
+										ApiInternalSchemaNameV2,
+										"bson_decode_stored_document", nargs,
+										argTypes, missingOk);
+}
+
+
+Oid
+BsonUpdateDocumentFunctionOid(void)
+{
+	int nargs = 6;
+	Oid argTypes[6] = {
+		BsonTypeId(), BsonTypeId(), BsonTypeId(), BsonTypeId(), BOOLOID, BsonTypeId()
+	};
+	bool missingOk = true;
+	return GetSchemaFunctionIdWithNargs(&Cache.BsonUpdateDocumentFunctionId,
+										ApiInternalSchemaName,
+										"bson_update_document", nargs, argTypes,
+										missingOk);
+}
+
+
+Oid
+UpdateBsonDocumentFunctionOid(void)
+{
+	int nargs = 6;
+	Oid argTypes[6] = {
+		BsonTypeId(), BsonTypeId(), BsonTypeId(), BsonTypeId(), BsonTypeId(), TEXTOID
+	};
+	bool missingOk = true;
+	return GetSchemaFunctionIdWithNargs(&Cache.UpdateBsonDocumentFunctionId,
+										ApiInternalSchemaNameV2,
+										"update_bson_document", nargs, argTypes,
+										missingOk);
+}
+
+
 /*
  * Returns the OID of ApiCatalogSchemaName.bson_dollar_not_lte function.
  */
@@ -3300,6 +3364,26 @@ BsonCurrentOpAggregationFunctionId(void)
 }
 
 
+Oid
+BsonQueryStatsAggregationFunctionId(void)
+{
+	InitializeDocumentDBApiExtensionCache();
+
+	if (Cache.BsonQueryStatsAggregationFunctionId == InvalidOid)
+	{
+		List *functionNameList = list_make2(makeString(ApiToApiInternalSchemaName),
+											makeString("query_stats_aggregation"));
+		Oid paramOids[1] = { BsonTypeId() };
+		bool missingOK = false;
+
+		Cache.BsonQueryStatsAggregationFunctionId =
+			LookupFuncName(functionNameList, 1, paramOids, missingOK);
+	}
+
+	return Cache.BsonQueryStatsAggregationFunctionId;
+}
+
+
 /*
  * IndexSpecAsBsonFunctionId returns the OID of the ApiInternalSchemaName.index_spec_as_bson function.
  */
@@ -4553,8 +4637,47 @@ BsonPercentileAggregateFunctionOid(void)
 Oid
 BsonAddToSetAggregateFunctionOid(void)
 {
-	return GetAggregateFunctionByName(&Cache.ApiCatalogBsonAddToSetAggregateFunctionOid,
-									  DocumentDBApiInternalSchemaName, "bson_add_to_set");
+	int nargs = 1;
+	Oid argTypes[1] = { DocumentDBCoreBsonTypeId() };
+	bool missingOk = false;
+	return GetSchemaFunctionIdWithNargs(&Cache.ApiCatalogBsonAddToSetAggregateFunctionOid,
+										DocumentDBApiInternalSchemaName,
+										"bson_add_to_set", nargs, argTypes,
+										missingOk);
+}
+
+
+/*
+ * Returns the OID of the bson_add_to_set aggregate with the argument for
+ * whether the state can spill to disk.
+ */
+Oid
+BsonAddToSetWithSpillAggregateFunctionOid(void)
+{
+	int nargs = 2;
+	Oid argTypes[2] = { DocumentDBCoreBsonTypeId(), BOOLOID };
+	bool missingOk = false;
+	return GetSchemaFunctionIdWithNargs(
+		&Cache.ApiInternalBsonAddToSetWithSpillAggregateFunctionOid,
+		DocumentDBApiInternalSchemaName, "bson_add_to_set", nargs, argTypes,
+		missingOk);
+}
+
+
+/*
+ * Returns the OID of the bson_array_agg aggregate with the argument for
+ * whether the state can spill to disk.
+ */
+Oid
+BsonArrayAggregateWithSpillFunctionOid(void)
+{
+	int nargs = 4;
+	Oid argTypes[4] = { BsonTypeId(), TEXTOID, BOOLOID, BOOLOID };
+	bool missingOk = false;
+	return GetSchemaFunctionIdWithNargs(
+		&Cache.ApiInternalBsonArrayAggregateWithSpillFunctionOid,
+		DocumentDBApiInternalSchemaName, "bson_array_agg", nargs, argTypes,
+		missingOk);
 }
 
 
@@ -4676,6 +4799,26 @@ BsonDollarBucketAutoFunctionOid(void)
 }
 
 
+Oid
+BsonIndexDistinctScanFunctionOid(void)
+{
+	InitializeDocumentDBApiExtensionCache();
+
+	if (Cache.BsonIndexDistinctScanFunctionOid == InvalidOid)
+	{
+		List *functionNameList = list_make2(makeString(DocumentDBApiInternalSchemaName),
+											makeString("bson_index_distinct_scan"));
+		Oid paramOids[2] = { OIDOID, BsonTypeId() };
+		bool missingOK = false;
+
+		Cache.BsonIndexDistinctScanFunctionOid =
+			LookupFuncName(functionNameList, 2, paramOids, missingOK);
+	}
+
+	return Cache.BsonIndexDistinctScanFunctionOid;
+}
+
+
 Oid
 BsonRepathAndBuildFunctionOid(void)
 {
@@ -7126,6 +7269,17 @@ ApiDataNamespaceOid(void)
 }
 
 
+/*
+ * Returns the OID of the ApiCatalogSchemaName.collections table
+ */
+Oid
+ApiCatalogCollectionsTableOid(void)
+{
+	InitializeDocumentDBApiExtensionCache();
+	return Cache.CollectionsTableId;
+}
+
+
 /*
  * Returns Oid of array type for bson
  */
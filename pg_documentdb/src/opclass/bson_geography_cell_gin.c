@@ -0,0 +1,385 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/opclass/bson_geography_cell_gin.c
+ *
+ * Gin operator implementations of 2dsphere indexing with cell terms.
+ * A geography is indexed as the ids of the cells (see bson_geospatial_cells.c)
+ * covering its bounding box, a query geography is covered the same way and
+ * matches the index terms of its cells' descendants (as a range scan) and
+ * ancestors (as exact terms). The index is lossy and always rechecks.
+ * See also: https://www.postgresql.org/docs/current/gin-extensibility.html
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <postgres.h>
+#include <fmgr.h>
+#include <access/reloptions.h>
+#include <lib/qunique.h>
+
+#include "io/bson_core.h"
+#include "geospatial/bson_geospatial_cells.h"
+#include "geospatial/bson_geospatial_common.h"
+#include "geospatial/bson_geospatial_geonear.h"
+#include "geospatial/bson_geospatial_shape_operators.h"
+#include "opclass/bson_gin_common.h"
+#include "opclass/bson_gin_index_mgmt.h"
+#include "utils/documentdb_errors.h"
+#include "metadata/collection_field_dictionary.h"
+
+
+/* --------------------------------------------------------- */
+/* Forward declaration */
+/* --------------------------------------------------------- */
+
+static int GetQueryCellCovering(const pgbson *query, StrategyNumber strategy,
+								const Bson2dGeographyCellPathOptions *options,
+								uint64 *cells);
+static int GetGeographyCellCovering(Datum geography,
+									const Bson2dGeographyCellPathOptions *options,
+									uint64 *cells);
+static int CompareCellIds(const void *left, const void *right);
+
+
+/* --------------------------------------------------------- */
+/* Top level exports */
+/* --------------------------------------------------------- */
+
+PG_FUNCTION_INFO_V1(gin_bson_geography_cell_extract_value);
+PG_FUNCTION_INFO_V1(gin_bson_geography_cell_extract_query);
+PG_FUNCTION_INFO_V1(gin_bson_geography_cell_compare_partial);
+PG_FUNCTION_INFO_V1(gin_bson_geography_cell_consistent);
+PG_FUNCTION_INFO_V1(gin_bson_geography_cell_options);
+
+
+/*
+ * gin_bson_geography_cell_extract_value is run on the insert/update path and returns
+ * the ids of the cells covering the geography at the indexed path. The input is the
+ * result of bson_validate_geography so documents without a geography at the path are
+ * not indexed (the index is sparse on that path, like the GIST 2dsphere index).
+ * For more details see documentation on the 'extractValue' method in the GIN extensibility.
+ */
+Datum
+gin_bson_geography_cell_extract_value(PG_FUNCTION_ARGS)
+{
+	pgbson *bson = PG_GETARG_STORED_PGBSON_PACKED(0);
+	int32_t *nentries = (int32_t *) PG_GETARG_POINTER(1);
+
+	if (!PG_HAS_OPCLASS_OPTIONS())
+	{
+		ereport(ERROR, (errmsg("Index does not have options")));
+	}
+
+	Bson2dGeographyCellPathOptions *options =
+		(Bson2dGeographyCellPathOptions *) PG_GET_OPCLASS_OPTIONS();
+
+	const char *indexPath;
+	uint32_t indexPathLength;
+	Get_Index_Path_Option(options, path, indexPath, indexPathLength);
+
+	StringView pathView = CreateStringViewFromStringWithLength(indexPath,
+															   indexPathLength);
+	Datum geographyDatum = BsonExtractGeographyStrict(bson, &pathView);
+
+	uint64 *cells = palloc(sizeof(uint64) *
+						   Max(options->maxCells, 4 * GEO_CELL_NUM_FACES));
+	int numCells = GetGeographyCellCovering(geographyDatum, options, cells);
+
+	Datum *entries = (Datum *) palloc(sizeof(Datum) * numCells);
+	for (int i = 0; i < numCells; i++)
+	{
+		entries[i] = Int64GetDatum(GeoCellIdToTerm(cells[i]));
+	}
+
+	*nentries = numCells;
+	PG_FREE_IF_COPY(bson, 0);
+	PG_RETURN_POINTER(entries);
+}
+
+
+/*
+ * gin_bson_geography_cell_extract_query covers the query geography with cells and
+ * returns, for each cell, a partial match term starting at its first descendant (the
+ * last descendant is carried in the extra data for compare_partial) and exact terms
+ * for all its ancestors. $geoWithin and $geoIntersects use the query shape and the
+ * $geoNear range check uses the reference point expanded by $maxDistance.
+ * For more details see documentation on the 'extractQuery' method in the GIN extensibility.
+ */
+Datum
+gin_bson_geography_cell_extract_query(PG_FUNCTION_ARGS)
+{
+	pgbson *query = PG_GETARG_PGBSON(0);
+	int32 *nentries = (int32 *) PG_GETARG_POINTER(1);
+	StrategyNumber strategy = PG_GETARG_UINT16(2);
+	bool **partialmatch = (bool **) PG_GETARG_POINTER(3);
+	Pointer **extra_data = (Pointer **) PG_GETARG_POINTER(4);
+
+	if (!PG_HAS_OPCLASS_OPTIONS())
+	{
+		ereport(ERROR, (errmsg("Index does not have options")));
+	}
+
+	Bson2dGeographyCellPathOptions *options =
+		(Bson2dGeographyCellPathOptions *) PG_GET_OPCLASS_OPTIONS();
+
+	uint64 *cells = palloc(sizeof(uint64) *
+						   Max(options->maxCells, 4 * GEO_CELL_NUM_FACES));
+	int numCells = GetQueryCellCovering(query, strategy, options, cells);
+
+	/* Collect the ancestors of all the cells, deduplicated */
+	uint64 *ancestors = palloc(sizeof(uint64) * numCells * GEO_CELL_MAX_LEVEL);
+	int numAncestors = 0;
+	for (int i = 0; i < numCells; i++)
+	{
+		uint64 cell = cells[i];
+		while (GeoCellLevel(cell) > 0)
+		{
+			cell = GeoCellParent(cell);
+			ancestors[numAncestors++] = cell;
+		}
+	}
+
+	if (numAncestors > 1)
+	{
+		qsort(ancestors, numAncestors, sizeof(uint64), CompareCellIds);
+		numAncestors = qunique(ancestors, numAncestors, sizeof(uint64), CompareCellIds);
+	}
+
+	int totalEntries = numCells + numAncestors;
+	Datum *entries = (Datum *) palloc(sizeof(Datum) * totalEntries);
+	*partialmatch = (bool *) palloc0(sizeof(bool) * totalEntries);
+	*extra_data = (Pointer *) palloc0(sizeof(Pointer) * totalEntries);
+
+	for (int i = 0; i < numCells; i++)
+	{
+		int64 *rangeEnd = palloc(sizeof(int64));
+		*rangeEnd = GeoCellIdToTerm(GeoCellRangeMax(cells[i]));
+
+		entries[i] = Int64GetDatum(GeoCellIdToTerm(GeoCellRangeMin(cells[i])));
+		(*partialmatch)[i] = true;
+		(*extra_data)[i] = (Pointer) rangeEnd;
+	}
+
+	for (int i = 0; i < numAncestors; i++)
+	{
+		entries[numCells + i] = Int64GetDatum(GeoCellIdToTerm(ancestors[i]));
+	}
+
+	pfree(cells);
+	pfree(ancestors);
+
+	*nentries = totalEntries;
+	PG_RETURN_POINTER(entries);
+}
+
+
+/*
+ * gin_bson_geography_cell_compare_partial matches the index terms within the range
+ * of descendants of a query cell: the scan starts at the first descendant and stops
+ * after the last one.
+ * For more details see documentation on the 'comparePartial' method in the GIN extensibility.
+ */
+Datum
+gin_bson_geography_cell_compare_partial(PG_FUNCTION_ARGS)
+{
+	int64 key = PG_GETARG_INT64(1);
+	Pointer extraData = PG_GETARG_POINTER(3);
+
+	int64 rangeEnd = *(int64 *) extraData;
+	PG_RETURN_INT32(key > rangeEnd ? 1 : 0);
+}
+
+
+/*
+ * gin_bson_geography_cell_consistent matches a document if any of its cells is related
+ * to a query cell. Cells only approximate the geographies so the actual geospatial
+ * operator is always rechecked.
+ * For more details see documentation on the 'consistent' method in the GIN extensibility.
+ */
+Datum
+gin_bson_geography_cell_consistent(PG_FUNCTION_ARGS)
+{
+	bool *check = (bool *) PG_GETARG_POINTER(0);
+	StrategyNumber strategy = PG_GETARG_UINT16(1);
+	int32_t numKeys = (int32_t) PG_GETARG_INT32(3);
+	bool *recheck = (bool *) PG_GETARG_POINTER(5);
+
+	switch (strategy)
+	{
+		case BSON_INDEX_STRATEGY_DOLLAR_GEOWITHIN:
+		case BSON_INDEX_STRATEGY_DOLLAR_GEOINTERSECTS:
+		case BSON_INDEX_STRATEGY_GEONEAR_RANGE:
+		{
+			break;
+		}
+
+		default:
+		{
+			ereport(ERROR, errmsg("Invalid strategy number %d", strategy));
+		}
+	}
+
+	*recheck = true;
+	for (int i = 0; i < numKeys; i++)
+	{
+		if (check[i])
+		{
+			PG_RETURN_BOOL(true);
+		}
+	}
+
+	PG_RETURN_BOOL(false);
+}
+
+
+/*
+ * gin_bson_geography_cell_options sets up the option specification for 2dsphere cell
+ * indexes: the path indexed and the limits on the cells a geography is covered with.
+ * usage is as: using rum(bson_validate_geography(document, 'a')
+ *                        documentdb_rum_geography_cell_ops(path='a', maxcells=8))
+ * For more details see documentation on the 'options' method in the GIN extensibility.
+ */
+Datum
+gin_bson_geography_cell_options(PG_FUNCTION_ARGS)
+{
+	local_relopts *relopts = (local_relopts *) PG_GETARG_POINTER(0);
+
+	init_local_reloptions(relopts, sizeof(Bson2dGeographyCellPathOptions));
+
+	/* The cell index is a 2dsphere index for the purposes of query path matching */
+	add_local_int_reloption(relopts, "optionsType",
+							"The type of the options struct.",
+							IndexOptionsType_2dsphere, /* default value */
+							IndexOptionsType_2dsphere, /* min */
+							IndexOptionsType_2dsphere, /* max */
+							offsetof(Bson2dGeographyCellPathOptions, base.type));
+	add_local_int_reloption(relopts, "version",
+							"The version of the options struct.",
+							IndexOptionsVersion_V0,         /* default value */
+							IndexOptionsVersion_V0,         /* min */
+							IndexOptionsVersion_V0,         /* max */
+							offsetof(Bson2dGeographyCellPathOptions, base.version));
+	add_local_string_reloption(relopts, "path",
+							   "Prefix path for the index",
+							   NULL, &ValidateSinglePathSpec, &FillSinglePathSpec,
+							   offsetof(Bson2dGeographyCellPathOptions, path));
+	add_local_int_reloption(relopts, "maxcells",
+							"The maximum number of cells a geography is covered with.",
+							GEO_CELL_DEFAULT_MAX_CELLS, /* default value */
+							1, /* min */
+							GEO_CELL_MAX_CELLS_LIMIT, /* max */
+							offsetof(Bson2dGeographyCellPathOptions, maxCells));
+	add_local_int_reloption(relopts, "maxlevel",
+							"The finest cell level a geography is covered with.",
+							GEO_CELL_MAX_LEVEL, /* default value */
+							0, /* min */
+							GEO_CELL_MAX_LEVEL, /* max */
+							offsetof(Bson2dGeographyCellPathOptions, maxLevel));
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * Covers the region of the query with cells. Queries whose region can't be bounded
+ * (infinite $centerSphere, $geoNear without $maxDistance or with planar distances)
+ * are covered with the whole sphere.
+ */
+static int
+GetQueryCellCovering(const pgbson *query, StrategyNumber strategy,
+					 const Bson2dGeographyCellPathOptions *options, uint64 *cells)
+{
+	Datum geography = (Datum) 0;
+	switch (strategy)
+	{
+		case BSON_INDEX_STRATEGY_DOLLAR_GEOWITHIN:
+		case BSON_INDEX_STRATEGY_DOLLAR_GEOINTERSECTS:
+		{
+			/*
+			 * Query doc is of the form { <field>: <doc defining the geography> }
+			 * and is already validated in the planning.
+			 */
+			pgbsonelement queryElement;
+			PgbsonToSinglePgbsonElement(query, &queryElement);
+
+			bson_value_t points;
+			const ShapeOperator *shapeOperator =
+				GetShapeOperatorByValue(&queryElement.bsonValue, &points);
+			if (!shapeOperator->isSpherical)
+			{
+				break;
+			}
+
+			ShapeOperatorInfo *opInfo = palloc0(sizeof(ShapeOperatorInfo));
+			opInfo->queryStage = QueryStage_INDEX;
+			opInfo->queryOperatorType =
+				strategy == BSON_INDEX_STRATEGY_DOLLAR_GEOWITHIN ?
+				QUERY_OPERATOR_GEOWITHIN : QUERY_OPERATOR_GEOINTERSECTS;
+			geography = shapeOperator->getShapeDatum(&points, opInfo);
+
+			if (shapeOperator->op == GeospatialShapeOperator_CENTERSPHERE &&
+				opInfo->opState != NULL &&
+				((DollarCenterOperatorState *) opInfo->opState)->isRadiusInfinite)
+			{
+				geography = (Datum) 0;
+			}
+
+			break;
+		}
+
+		case BSON_INDEX_STRATEGY_GEONEAR_RANGE:
+		{
+			GeonearDistanceState distanceState;
+			memset(&distanceState, 0, sizeof(GeonearDistanceState));
+			BuildGeoNearRangeDistanceState(&distanceState, query);
+
+			/* Both spherical modes have their distances in meters */
+			if (distanceState.mode != DistanceMode_Cartesian &&
+				distanceState.maxDistance != NULL)
+			{
+				geography = OidFunctionCall2(PostgisGeographyExpandFunctionId(),
+											 distanceState.referencePoint,
+											 Float8GetDatum(*distanceState.maxDistance));
+			}
+
+			break;
+		}
+
+		default:
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+							errmsg("unknown geospatial query operator with strategy %d",
+								   strategy)));
+		}
+	}
+
+	if (geography == (Datum) 0)
+	{
+		return GetGeoCellCoveringForSphere(cells);
+	}
+
+	return GetGeographyCellCovering(geography, options, cells);
+}
+
+
+static int
+GetGeographyCellCovering(Datum geography,
+						 const Bson2dGeographyCellPathOptions *options, uint64 *cells)
+{
+	GeoCellBox box;
+	if (!GetGeographyGeoCellBox(geography, &box))
+	{
+		return GetGeoCellCoveringForSphere(cells);
+	}
+
+	return GetGeoCellCoveringForBox(&box, options->maxCells, options->maxLevel, cells);
+}
+
+
+static int
+CompareCellIds(const void *left, const void *right)
+{
+	uint64 leftId = *(const uint64 *) left;
+	uint64 rightId = *(const uint64 *) right;
+	return leftId < rightId ? -1 : (leftId > rightId ? 1 : 0);
+}
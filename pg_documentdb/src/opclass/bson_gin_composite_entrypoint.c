@@ -39,6 +39,7 @@
  #include "query/bson_compare.h"
  #include "utils/documentdb_errors.h"
  #include "metadata/metadata_cache.h"
+ #include "metadata/collection_field_dictionary.h"
  #include "collation/collation.h"
  #include "opclass/bson_gin_composite_scan.h"
  #include "opclass/bson_gin_composite_private.h"
@@ -189,7 +190,7 @@ GetCompositeIndexTermMetadata(void *options)
 Datum
 gin_bson_composite_path_extract_value(PG_FUNCTION_ARGS)
 {
-	pgbson *bson = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *bson = PG_GETARG_STORED_PGBSON_PACKED(0);
 	int32_t *nentries = (int32_t *) PG_GETARG_POINTER(1);
 	if (!PG_HAS_OPCLASS_OPTIONS())
 	{
@@ -35,6 +35,7 @@
 #include "query/bson_compare.h"
 #include "utils/documentdb_errors.h"
 #include "metadata/metadata_cache.h"
+#include "metadata/collection_field_dictionary.h"
 #include "collation/collation.h"
 
 extern bool EnableExprLookupIndexPushdown;
@@ -78,7 +79,7 @@ extern bool EnableCollation;
 Datum
 gin_bson_single_path_extract_value(PG_FUNCTION_ARGS)
 {
-	pgbson *bson = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *bson = PG_GETARG_STORED_PGBSON_PACKED(0);
 	int32_t *nentries = (int32_t *) PG_GETARG_POINTER(1);
 
 	if (!PG_HAS_OPCLASS_OPTIONS())
@@ -111,7 +112,7 @@ gin_bson_single_path_extract_value(PG_FUNCTION_ARGS)
 Datum
 gin_bson_wildcard_project_extract_value(PG_FUNCTION_ARGS)
 {
-	pgbson *bson = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *bson = PG_GETARG_STORED_PGBSON_PACKED(0);
 	int32_t *nentries = (int32_t *) PG_GETARG_POINTER(1);
 	GenerateTermsContext context = { 0 };
 	GinEntryPathData pathData = { 0 };
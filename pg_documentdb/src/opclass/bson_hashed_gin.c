@@ -21,6 +21,7 @@
 #include "opclass/bson_gin_index_mgmt.h"
 #include "utils/documentdb_errors.h"
 #include "io/bson_traversal.h"
+#include "metadata/collection_field_dictionary.h"
 
 /* --------------------------------------------------------- */
 /* Forward declaration */
@@ -136,7 +137,7 @@ gin_bson_hashed_extract_query(PG_FUNCTION_ARGS)
 Datum
 gin_bson_hashed_extract_value(PG_FUNCTION_ARGS)
 {
-	pgbson *bson = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *bson = PG_GETARG_STORED_PGBSON_PACKED(0);
 	int32_t *nentries = (int32_t *) PG_GETARG_POINTER(1);
 
 	if (!PG_HAS_OPCLASS_OPTIONS())
@@ -30,6 +30,7 @@
 #include "utils/documentdb_errors.h"
 #include "opclass/bson_text_gin.h"
 #include "metadata/metadata_cache.h"
+#include "metadata/collection_field_dictionary.h"
 #include "opclass/bson_index_support.h"
 
 
@@ -150,7 +151,7 @@ PG_FUNCTION_INFO_V1(bson_dollar_text_meta_qual);
 Datum
 rum_bson_single_path_extract_tsvector(PG_FUNCTION_ARGS)
 {
-	pgbson *bson = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *bson = PG_GETARG_STORED_PGBSON_PACKED(0);
 	int32_t *nentries = (int32_t *) PG_GETARG_POINTER(1);
 
 	if (!PG_HAS_OPCLASS_OPTIONS())
@@ -283,7 +284,7 @@ rum_bson_text_path_options(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_text_meta_qual(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	TSQuery query = PG_GETARG_TSQUERY(1);
 	bytea *indexOptions = PG_GETARG_BYTEA_P(2);
 	bool evaluateRuntimeCheck = PG_GETARG_BOOL(3);
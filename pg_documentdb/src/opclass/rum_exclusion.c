@@ -55,6 +55,7 @@
 #include "opclass/bson_gin_private.h"
 #include "opclass/bson_gin_index_mgmt.h"
 #include "metadata/metadata_cache.h"
+#include "metadata/collection_field_dictionary.h"
 
 /* --------------------------------------------------------- */
 /* Forward declaration */
@@ -324,7 +325,7 @@ bson_unique_index_term_equal(PG_FUNCTION_ARGS)
 Datum
 generate_unique_shard_document(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON_PACKED(0);
 	int64_t shardKeyValue = PG_GETARG_INT64(1);
 	pgbson *projectionSpec = PG_GETARG_PGBSON_PACKED(2);
 
@@ -876,7 +877,7 @@ ExtractUniqueShardTermsFromInput(pgbson *input, int32_t *nentries, Pointer **ext
 Datum
 gin_bson_unique_shard_extract_value(PG_FUNCTION_ARGS)
 {
-	pgbson *input = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *input = PG_GETARG_STORED_PGBSON_PACKED(0);
 	int32 *nentries = (int32 *) PG_GETARG_POINTER(1);
 
 	Pointer **extraData = NULL;
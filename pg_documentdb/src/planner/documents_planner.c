@@ -34,9 +34,11 @@
 #include <utils/syscache.h>
 #include <executor/spi.h>
 #include <parser/parse_relation.h>
+#include <parser/parsetree.h>
 
 #include "geospatial/bson_geospatial_geonear.h"
 #include "metadata/collection.h"
+#include "metadata/collection_field_dictionary.h"
 #include "metadata/metadata_cache.h"
 #include "planner/documentdb_planner.h"
 #include "query/query_operator.h"
@@ -100,6 +102,15 @@ typedef struct DocumentDbQueryFlagsState
 	int queryDepth;
 } DocumentDbQueryFlagsState;
 
+/*
+ * State that tracks the ReplaceStoredDocumentReads mutator
+ */
+typedef struct StoredDocumentReadsContext
+{
+	/* The range tables of the queries being mutated, innermost first */
+	List *rangeTables;
+} StoredDocumentReadsContext;
+
 static bool DocumentDbQueryFlagsWalker(Node *node, DocumentDbQueryFlagsState *queryFlags);
 static int DocumentDbQueryFlags(Query *query);
 static bool IsReadWriteCommand(Query *query);
@@ -118,6 +129,15 @@ static bool ProcessWorkerWriteQueryPath(PlannerInfo *root, RelOptInfo *rel, Inde
 static Query * ExpandAggregationFunction(Query *node, ParamListInfo boundParams,
 										 PlannedStmt **plan);
 static Query * ExpandNestedAggregationFunction(Query *node, ParamListInfo boundParams);
+static Query * ReplaceStoredDocumentReads(Query *query);
+static bool HasEncodedDocumentsRTEWalker(Node *node, void *context);
+static Node * ReplaceStoredDocumentReadsMutator(Node *node,
+												StoredDocumentReadsContext *context);
+static List * MutateArgumentsAfterStoredDocument(List *args,
+												 StoredDocumentReadsContext *context);
+static bool IsEncodedDocumentVar(Var *var, StoredDocumentReadsContext *context);
+static bool IsEncodedDocumentsRTE(RangeTblEntry *rte);
+static bool DecodesStoredDocumentArgument(Oid functionId);
 
 static void ForceExcludeNonIndexPaths(PlannerInfo *root, RelOptInfo *rel,
 									  Index rti, RangeTblEntry *rte);
@@ -240,6 +260,9 @@ DocumentDBApiPlanner(Query *parse, const char *queryString, int cursorOptions,
 														&isNonExistentCollection);
 		}
 
+		/* decode the documents of collections that store them encoded */
+		parse = ReplaceStoredDocumentReads(parse);
+
 		/* replace parameters in cursor_state calls, we need the values during planning */
 		if (queryFlags & HAS_CURSOR_STATE_PARAM)
 		{
@@ -1970,3 +1993,228 @@ ForceExcludeNonIndexPaths(PlannerInfo *root, RelOptInfo *rel,
 		}
 	}
 }
+
+
+/*
+ * Collections with a field name dictionary may store their documents with
+ * encoded field names, which are not valid bson (see
+ * metadata/collection_field_dictionary.c). This wraps the reads of the
+ * document column of such collections in bson_decode_stored_document, except
+ * where the column is handed to a function that decodes it itself: query
+ * operators, sort and index expressions keep matching the indexes on the
+ * column that way. Wrapped reads are left as is, so the rewrite can run again
+ * on the query a shard receives.
+ *
+ * This runs whatever the settings that enable encoding: whether a collection
+ * may hold encoded documents comes from its metadata, and documents written
+ * while encoding was on must stay readable after it is turned off.
+ */
+static Query *
+ReplaceStoredDocumentReads(Query *query)
+{
+	if (!HasEncodedDocumentsRTEWalker((Node *) query, NULL))
+	{
+		return query;
+	}
+
+	StoredDocumentReadsContext context = { 0 };
+	return (Query *) ReplaceStoredDocumentReadsMutator((Node *) query, &context);
+}
+
+
+static bool
+HasEncodedDocumentsRTEWalker(Node *node, void *context)
+{
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	if (IsA(node, RangeTblEntry))
+	{
+		return IsEncodedDocumentsRTE((RangeTblEntry *) node);
+	}
+	else if (IsA(node, Query))
+	{
+		return query_tree_walker((Query *) node, HasEncodedDocumentsRTEWalker,
+								 context, QTW_EXAMINE_RTES_BEFORE);
+	}
+
+	return expression_tree_walker(node, HasEncodedDocumentsRTEWalker, context);
+}
+
+
+static Node *
+ReplaceStoredDocumentReadsMutator(Node *node, StoredDocumentReadsContext *context)
+{
+	if (node == NULL)
+	{
+		return NULL;
+	}
+
+	if (IsA(node, Query))
+	{
+		Query *query = (Query *) node;
+		context->rangeTables = lcons(query->rtable, context->rangeTables);
+		query = query_tree_mutator(query, ReplaceStoredDocumentReadsMutator, context,
+								   0);
+		context->rangeTables = list_delete_first(context->rangeTables);
+		return (Node *) query;
+	}
+	else if (IsA(node, Var))
+	{
+		Var *var = (Var *) node;
+		if (IsEncodedDocumentVar(var, context))
+		{
+			return (Node *) makeFuncExpr(BsonDecodeStoredDocumentFunctionOid(),
+										 BsonTypeId(), list_make1(var), InvalidOid,
+										 InvalidOid, COERCE_EXPLICIT_CALL);
+		}
+
+		return node;
+	}
+	else if (IsA(node, FuncExpr))
+	{
+		FuncExpr *funcExpr = (FuncExpr *) node;
+		if (funcExpr->args != NIL && IsA(linitial(funcExpr->args), Var) &&
+			DecodesStoredDocumentArgument(funcExpr->funcid))
+		{
+			FuncExpr *newFuncExpr = palloc(sizeof(FuncExpr));
+			memcpy(newFuncExpr, funcExpr, sizeof(FuncExpr));
+			newFuncExpr->args = MutateArgumentsAfterStoredDocument(funcExpr->args,
+																   context);
+			return (Node *) newFuncExpr;
+		}
+	}
+	else if (IsA(node, OpExpr))
+	{
+		OpExpr *opExpr = (OpExpr *) node;
+		if (opExpr->args != NIL && IsA(linitial(opExpr->args), Var) &&
+			(opExpr->opno == BsonGeonearDistanceOperatorId() ||
+			 opExpr->opno == BsonGeonearDistanceRangeOperatorId() ||
+			 DecodesStoredDocumentArgument(get_opcode(opExpr->opno))))
+		{
+			OpExpr *newOpExpr = palloc(sizeof(OpExpr));
+			memcpy(newOpExpr, opExpr, sizeof(OpExpr));
+			newOpExpr->args = MutateArgumentsAfterStoredDocument(opExpr->args,
+																 context);
+			return (Node *) newOpExpr;
+		}
+	}
+
+	return expression_tree_mutator(node, ReplaceStoredDocumentReadsMutator, context);
+}
+
+
+/*
+ * Mutates the arguments of a function that decodes the document it is handed
+ * as its first argument, leaving that argument as is.
+ */
+static List *
+MutateArgumentsAfterStoredDocument(List *args, StoredDocumentReadsContext *context)
+{
+	List *remainingArgs = (List *) expression_tree_mutator(
+		(Node *) list_copy_tail(args, 1), ReplaceStoredDocumentReadsMutator, context);
+	return list_concat(list_make1(linitial(args)), remainingArgs);
+}
+
+
+/*
+ * Whether the Var reads the document column of a collection that may store
+ * encoded documents, directly or through a join.
+ */
+static bool
+IsEncodedDocumentVar(Var *var, StoredDocumentReadsContext *context)
+{
+	if (var->varlevelsup >= (Index) list_length(context->rangeTables) ||
+		var->vartype != BsonTypeId())
+	{
+		return false;
+	}
+
+	List *rangeTable = list_nth(context->rangeTables, var->varlevelsup);
+	while (var->varno > 0 && var->varno <= list_length(rangeTable))
+	{
+		RangeTblEntry *rte = rt_fetch(var->varno, rangeTable);
+		if (rte->rtekind == RTE_RELATION)
+		{
+			return var->varattno == DOCUMENT_DATA_TABLE_DOCUMENT_VAR_ATTR_NUMBER &&
+				   IsEncodedDocumentsRTE(rte);
+		}
+		else if (rte->rtekind != RTE_JOIN || var->varattno <= 0 ||
+				 var->varattno > list_length(rte->joinaliasvars))
+		{
+			return false;
+		}
+
+		Node *aliasVar = strip_implicit_coercions(list_nth(rte->joinaliasvars,
+														   var->varattno - 1));
+		if (aliasVar == NULL || !IsA(aliasVar, Var))
+		{
+			return false;
+		}
+
+		var = (Var *) aliasVar;
+	}
+
+	return false;
+}
+
+
+/*
+ * Whether the RTE is the data table, or a shard of the data table, of a
+ * collection that may store encoded documents.
+ */
+static bool
+IsEncodedDocumentsRTE(RangeTblEntry *rte)
+{
+	if (rte->rtekind != RTE_RELATION ||
+		get_rel_namespace(rte->relid) != ApiDataNamespaceOid())
+	{
+		return false;
+	}
+
+	char *relName = get_rel_name(rte->relid);
+	if (relName == NULL ||
+		strncmp(relName, DOCUMENT_DATA_TABLE_NAME_PREFIX,
+				strlen(DOCUMENT_DATA_TABLE_NAME_PREFIX)) != 0)
+	{
+		return false;
+	}
+
+	char *numEndPointer = NULL;
+	uint64 collectionId = strtoull(&relName[strlen(DOCUMENT_DATA_TABLE_NAME_PREFIX)],
+								   &numEndPointer, 10);
+	if (*numEndPointer != '\0' && *numEndPointer != '_')
+	{
+		return false;
+	}
+
+	return CollectionHasEncodedDocuments(collectionId);
+}
+
+
+/*
+ * Whether the function decodes the stored document it is handed as its first
+ * argument, or is only a marker for the planner to pick an index on it.
+ */
+static bool
+DecodesStoredDocumentArgument(Oid functionId)
+{
+	if (GetMongoQueryOperatorByPostgresFuncId(functionId)->operatorType !=
+		QUERY_OPERATOR_UNKNOWN)
+	{
+		return true;
+	}
+
+	return functionId == BsonDecodeStoredDocumentFunctionOid() ||
+		   functionId == BsonUpdateDocumentFunctionOid() ||
+		   functionId == UpdateBsonDocumentFunctionOid() ||
+		   functionId == BsonOrderByFunctionOid() ||
+		   functionId == BsonOrderByWithCollationFunctionOid() ||
+		   functionId == BsonValidateGeometryFunctionId() ||
+		   functionId == BsonValidateGeographyFunctionId() ||
+		   functionId == ApiCatalogBsonExtractVectorFunctionId() ||
+		   functionId == BsonFullScanFunctionOid() ||
+		   functionId == BsonIndexHintFunctionOid();
+}
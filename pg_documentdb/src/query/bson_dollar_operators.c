@@ -17,6 +17,8 @@
 #include "io/bson_core.h"
 #include "aggregation/bson_query_common.h"
 #include "io/bson_traversal.h"
+#include "metadata/collection_compression.h"
+#include "metadata/collection_field_dictionary.h"
 #include "query/bson_compare.h"
 #include "operators/bson_expression.h"
 #include "query/bson_dollar_operators.h"
@@ -621,7 +623,7 @@ PG_FUNCTION_INFO_V1(command_bson_orderby_index);
 Datum
 bson_dollar_size(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	pgbson *filter = PG_GETARG_PGBSON(1);
 
 	bson_iter_t documentIterator;
@@ -705,7 +707,7 @@ bson_value_dollar_type(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_all(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	TraverseAllValidateState validationState = {
 		.elementState =
 		{
@@ -801,7 +803,7 @@ bson_value_dollar_all(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_elemmatch(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	bson_iter_t documentIterator;
 	TraverseElemMatchValidateState state = {
 		.traverseState = { 0 },
@@ -982,7 +984,7 @@ bson_value_dollar_bits_any_set(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_regex(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	bson_iter_t documentIterator;
 	TraverseRegexValidateState state = {
 		{ 0 }, { 0 }
@@ -1224,7 +1226,7 @@ bson_dollar_index_hint(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_range(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	pgbson *filter = PG_GETARG_PGBSON(1);
 	const DollarRangeParams *cachedRangeParamsState;
 	SetCachedFunctionState(
@@ -1446,7 +1448,7 @@ bson_value_dollar_lte(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_in(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	bson_iter_t documentIterator;
 	TraverseInValidateState state = { 0 };
 
@@ -1525,7 +1527,7 @@ bson_value_dollar_in(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_nin(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	bson_iter_t documentIterator;
 	TraverseInValidateState state = { 0 };
 
@@ -1660,7 +1662,7 @@ bson_value_dollar_exists(PG_FUNCTION_ARGS)
 Datum
 bson_dollar_expr(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	pgbson *filter = PG_GETARG_PGBSON(1);
 	pgbson *variablesContext = NULL;
 
@@ -1743,7 +1745,7 @@ bson_dollar_text(PG_FUNCTION_ARGS)
 Datum
 command_bson_orderby(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON_PACKED(0);
 	pgbson *filter = PG_GETARG_PGBSON_PACKED(1);
 	char *collationString = NULL;
 
@@ -1766,7 +1768,7 @@ command_bson_orderby(PG_FUNCTION_ARGS)
 Datum
 command_bson_orderby_reverse(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON_PACKED(0);
 	pgbson *filter = PG_GETARG_PGBSON_PACKED(1);
 	char *collationString = NULL;
 
@@ -1789,7 +1791,7 @@ command_bson_orderby_reverse(PG_FUNCTION_ARGS)
 Datum
 command_bson_orderby_index(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON_PACKED(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON_PACKED(0);
 	pgbson *sortSpec = PG_GETARG_PGBSON_PACKED(1);
 	StringView collationStringView = { 0 };
 
@@ -2886,7 +2888,6 @@ CompareBsonAgainstQuery(const pgbson *element,
 	bson_iter_t documentIterator;
 	pgbsonelement filterElement;
 	TraverseElementValidateState state = { 0 };
-	PgbsonInitIterator(element, &documentIterator);
 
 	if (EnableCollation)
 	{
@@ -2898,6 +2899,33 @@ CompareBsonAgainstQuery(const pgbson *element,
 		PgbsonToSinglePgbsonElement(filter, &filterElement);
 	}
 
+	/*
+	 * Stored documents with dictionary encoded field names are matched on the
+	 * encoded path, unless the filter value holds field names to compare.
+	 * Compressed documents are decompressed once per row for all the
+	 * operators of the filter (see DecompressStoredDocument).
+	 */
+	const char *path = filterElement.path;
+	element = DecompressStoredDocument((pgbson *) element);
+	if (PgbsonIsFieldNameEncoded(element))
+	{
+		if (filterElement.bsonValue.value_type == BSON_TYPE_DOCUMENT ||
+			filterElement.bsonValue.value_type == BSON_TYPE_ARRAY)
+		{
+			element = DecodeStoredDocument((pgbson *) element);
+			PgbsonInitIterator(element, &documentIterator);
+		}
+		else
+		{
+			path = EncodeStoredDocumentFieldPath(element, filterElement.path);
+			PgbsonInitEncodedDocumentIterator(element, &documentIterator);
+		}
+	}
+	else
+	{
+		PgbsonInitIterator(element, &documentIterator);
+	}
+
 	filterElement.pathLength = 0;
 	state.filter = &filterElement;
 	state.traverseState.matchFunc = compareFunc;
@@ -2914,7 +2942,7 @@ CompareBsonAgainstQuery(const pgbson *element,
 		execFuncs = &CompareNullExecutionFuncs;
 	}
 
-	TraverseBson(&documentIterator, filterElement.path, &state.traverseState, execFuncs);
+	TraverseBson(&documentIterator, path, &state.traverseState, execFuncs);
 	return ProcessQueryResultAndGetMatch(isQueryFilterNull, &state.traverseState);
 }
 
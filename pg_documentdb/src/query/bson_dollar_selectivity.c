@@ -24,6 +24,9 @@ extern bool LowSelectivityForLookup;
 
 static double GetStatisticsNoStatsData(List *args, Oid selectivityOpExpr, double
 									   defaultExprSelectivity);
+static bool TryGetPathStatisticsSelectivityForArgs(PlannerInfo *planner,
+												   Oid selectivityOpExpr, List *args,
+												   int varRelId, double *selectivity);
 
 static double GetDisableStatisticSelectivity(List *args, double
 											 defaultDisabledSelectivity);
@@ -99,6 +102,13 @@ GetDollarOperatorSelectivity(PlannerInfo *planner, Oid selectivityOpExpr,
 		return GetDisableStatisticSelectivity(args, defaultExprSelectivity);
 	}
 
+	double pathSelectivity;
+	if (TryGetPathStatisticsSelectivityForArgs(planner, selectivityOpExpr, args,
+											   varRelId, &pathSelectivity))
+	{
+		return pathSelectivity;
+	}
+
 	double defaultInputSelectivity = GetStatisticsNoStatsData(args, selectivityOpExpr,
 															  defaultExprSelectivity);
 
@@ -114,6 +124,54 @@ GetDollarOperatorSelectivity(PlannerInfo *planner, Oid selectivityOpExpr,
 }
 
 
+/*
+ * Resolves the operator and the path it queries and estimates its selectivity
+ * from the per path statistics of the document column, if there are any.
+ */
+static bool
+TryGetPathStatisticsSelectivityForArgs(PlannerInfo *planner, Oid selectivityOpExpr,
+									   List *args, int varRelId, double *selectivity)
+{
+	if (list_length(args) != 2 || !IsA(lsecond(args), Const))
+	{
+		return false;
+	}
+
+	Const *secondConst = (Const *) lsecond(args);
+	if (secondConst->constisnull)
+	{
+		return false;
+	}
+
+	const MongoIndexOperatorInfo *indexOp;
+	if (secondConst->consttype == BsonQueryTypeId())
+	{
+		indexOp = GetMongoIndexOperatorInfoByPostgresFuncId(get_opcode(selectivityOpExpr));
+	}
+	else
+	{
+		indexOp = GetMongoIndexOperatorByPostgresOperatorId(selectivityOpExpr);
+	}
+
+	BsonIndexStrategy indexStrategy = indexOp->indexStrategy;
+	if (indexStrategy == BSON_INDEX_STRATEGY_INVALID &&
+		selectivityOpExpr == BsonRangeMatchOperatorOid())
+	{
+		indexStrategy = BSON_INDEX_STRATEGY_DOLLAR_RANGE;
+	}
+
+	if (indexStrategy == BSON_INDEX_STRATEGY_INVALID)
+	{
+		return false;
+	}
+
+	pgbsonelement queryElement;
+	PgbsonToSinglePgbsonElement(DatumGetPgBson(secondConst->constvalue), &queryElement);
+	return TryGetPathStatisticsSelectivity(planner, linitial(args), varRelId,
+										   indexStrategy, &queryElement, selectivity);
+}
+
+
 /*
  * Legacy function for compat to restore prior value to
  * implementing selectivity.
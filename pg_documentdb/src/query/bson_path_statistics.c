@@ -0,0 +1,583 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/query/bson_path_statistics.c
+ *
+ * Selectivity estimates for BSON operators from the per path statistics
+ * ANALYZE collects on the document column (see io/bson_analyze.h).
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include <fmgr.h>
+#include <catalog/pg_statistic.h>
+#include <nodes/pathnodes.h>
+#include <utils/lsyscache.h>
+#include <utils/selfuncs.h>
+
+#include "io/bson_core.h"
+#include "io/bson_analyze.h"
+#include "query/bson_compare.h"
+#include "query/bson_dollar_selectivity.h"
+#include "aggregation/bson_query_common.h"
+
+extern bool EnableBsonPathStatisticsSelectivity;
+
+
+/*
+ * The statistics of a path, the bson values point into the statistics
+ * document.
+ */
+typedef struct BsonPathStatistics
+{
+	double existsFrac;
+	double nullFrac;
+	double distinct;
+	double histogramFrac;
+
+	bson_value_t types;
+	bson_value_t mostCommonValues;
+	bson_value_t mostCommonFreqs;
+	bson_value_t histogram;
+} BsonPathStatistics;
+
+
+static bool FindPathStatistics(AttStatsSlot *slot, const char *path, uint32_t pathLength,
+							   BsonPathStatistics *statistics);
+static double GetEqualitySelectivity(BsonPathStatistics *statistics,
+									 const bson_value_t *value, double numRows);
+static double GetRangeSelectivity(BsonPathStatistics *statistics,
+								  const DollarRangeParams *range);
+static double GetTypeSelectivity(BsonPathStatistics *statistics,
+								 const bson_value_t *typeValue);
+static bool IsValueInRange(const bson_value_t *value, const DollarRangeParams *range);
+
+
+/*
+ * Estimates the selectivity of the BSON operator from the per path statistics
+ * of the queried path. Returns false if the column has no path statistics,
+ * the path wasn't among the ones collected or the operator isn't one the
+ * statistics can describe.
+ */
+bool
+TryGetPathStatisticsSelectivity(PlannerInfo *planner, Node *documentExpr, int varRelId,
+								BsonIndexStrategy indexStrategy,
+								const pgbsonelement *queryElement, double *selectivity)
+{
+	if (!EnableBsonPathStatisticsSelectivity)
+	{
+		return false;
+	}
+
+	switch (indexStrategy)
+	{
+		case BSON_INDEX_STRATEGY_DOLLAR_EQUAL:
+		case BSON_INDEX_STRATEGY_DOLLAR_NOT_EQUAL:
+		case BSON_INDEX_STRATEGY_DOLLAR_IN:
+		case BSON_INDEX_STRATEGY_DOLLAR_NOT_IN:
+		case BSON_INDEX_STRATEGY_DOLLAR_GREATER:
+		case BSON_INDEX_STRATEGY_DOLLAR_GREATER_EQUAL:
+		case BSON_INDEX_STRATEGY_DOLLAR_LESS:
+		case BSON_INDEX_STRATEGY_DOLLAR_LESS_EQUAL:
+		case BSON_INDEX_STRATEGY_DOLLAR_RANGE:
+		case BSON_INDEX_STRATEGY_DOLLAR_EXISTS:
+		case BSON_INDEX_STRATEGY_DOLLAR_TYPE:
+		{
+			break;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+
+	VariableStatData vardata;
+	examine_variable(planner, documentExpr, varRelId, &vardata);
+	if (!HeapTupleIsValid(vardata.statsTuple))
+	{
+		ReleaseVariableStats(vardata);
+		return false;
+	}
+
+	AttStatsSlot slot;
+	if (!get_attstatsslot(&slot, vardata.statsTuple, STATISTIC_KIND_BSON_PATHS,
+						  InvalidOid, ATTSTATSSLOT_VALUES))
+	{
+		ReleaseVariableStats(vardata);
+		return false;
+	}
+
+	double numRows = vardata.rel != NULL ? Max(vardata.rel->tuples, 1.0) : 1.0;
+	BsonPathStatistics statistics;
+	bool found = FindPathStatistics(&slot, queryElement->path, queryElement->pathLength,
+									&statistics);
+
+	double result = 0;
+	const bson_value_t *value = &queryElement->bsonValue;
+	if (found)
+	{
+		switch (indexStrategy)
+		{
+			case BSON_INDEX_STRATEGY_DOLLAR_EQUAL:
+			{
+				result = GetEqualitySelectivity(&statistics, value, numRows);
+				break;
+			}
+
+			case BSON_INDEX_STRATEGY_DOLLAR_NOT_EQUAL:
+			{
+				result = 1.0 - GetEqualitySelectivity(&statistics, value, numRows);
+				break;
+			}
+
+			case BSON_INDEX_STRATEGY_DOLLAR_IN:
+			case BSON_INDEX_STRATEGY_DOLLAR_NOT_IN:
+			{
+				if (value->value_type != BSON_TYPE_ARRAY)
+				{
+					found = false;
+					break;
+				}
+
+				/* $in is N $eq, assume the values match disjoint rows */
+				bson_iter_t inIter;
+				BsonValueInitIterator(value, &inIter);
+				while (bson_iter_next(&inIter))
+				{
+					result += GetEqualitySelectivity(&statistics,
+													 bson_iter_value(&inIter), numRows);
+				}
+
+				result = Min(result, 1.0);
+				if (indexStrategy == BSON_INDEX_STRATEGY_DOLLAR_NOT_IN)
+				{
+					result = 1.0 - result;
+				}
+				break;
+			}
+
+			case BSON_INDEX_STRATEGY_DOLLAR_GREATER:
+			case BSON_INDEX_STRATEGY_DOLLAR_GREATER_EQUAL:
+			case BSON_INDEX_STRATEGY_DOLLAR_LESS:
+			case BSON_INDEX_STRATEGY_DOLLAR_LESS_EQUAL:
+			{
+				/* Comparisons are type bracketed: bound the other side by the type */
+				DollarRangeParams range = { 0 };
+				bool isGreater = indexStrategy == BSON_INDEX_STRATEGY_DOLLAR_GREATER ||
+								 indexStrategy == BSON_INDEX_STRATEGY_DOLLAR_GREATER_EQUAL;
+				bool isInclusive = indexStrategy ==
+								   BSON_INDEX_STRATEGY_DOLLAR_GREATER_EQUAL ||
+								   indexStrategy == BSON_INDEX_STRATEGY_DOLLAR_LESS_EQUAL;
+				if (isGreater)
+				{
+					range.minValue = *value;
+					range.isMinInclusive = isInclusive;
+					range.maxValue.value_type = BSON_TYPE_EOD;
+				}
+				else
+				{
+					range.maxValue = *value;
+					range.isMaxInclusive = isInclusive;
+					range.minValue.value_type = BSON_TYPE_EOD;
+				}
+
+				result = GetRangeSelectivity(&statistics, &range);
+				break;
+			}
+
+			case BSON_INDEX_STRATEGY_DOLLAR_RANGE:
+			{
+				DollarRangeParams range = { 0 };
+				InitializeQueryDollarRange(value, &range);
+				if (range.isFullScan || range.isElemMatch)
+				{
+					found = false;
+					break;
+				}
+
+				result = GetRangeSelectivity(&statistics, &range);
+				break;
+			}
+
+			case BSON_INDEX_STRATEGY_DOLLAR_EXISTS:
+			{
+				result = BsonValueAsInt32(value) > 0 ? statistics.existsFrac :
+						 1.0 - statistics.existsFrac;
+				break;
+			}
+
+			case BSON_INDEX_STRATEGY_DOLLAR_TYPE:
+			{
+				result = GetTypeSelectivity(&statistics, value);
+				break;
+			}
+
+			default:
+			{
+				found = false;
+				break;
+			}
+		}
+	}
+
+	free_attstatsslot(&slot);
+	ReleaseVariableStats(vardata);
+
+	if (found)
+	{
+		/* Never rule out a match entirely, the sample may have missed it */
+		*selectivity = Max(Min(result, 1.0), 1.0 / numRows);
+		CLAMP_PROBABILITY(*selectivity);
+	}
+
+	return found;
+}
+
+
+/*
+ * Returns the number of distinct values of the path in the document column
+ * from its per path statistics, or -1 if unknown.
+ */
+double
+GetPathStatisticsDistinctValues(PlannerInfo *planner, Node *documentExpr, int varRelId,
+								const char *path)
+{
+	if (!EnableBsonPathStatisticsSelectivity)
+	{
+		return -1;
+	}
+
+	VariableStatData vardata;
+	examine_variable(planner, documentExpr, varRelId, &vardata);
+	if (!HeapTupleIsValid(vardata.statsTuple))
+	{
+		ReleaseVariableStats(vardata);
+		return -1;
+	}
+
+	AttStatsSlot slot;
+	double distinct = -1;
+	if (get_attstatsslot(&slot, vardata.statsTuple, STATISTIC_KIND_BSON_PATHS,
+						 InvalidOid, ATTSTATSSLOT_VALUES))
+	{
+		BsonPathStatistics statistics;
+		if (FindPathStatistics(&slot, path, strlen(path), &statistics) &&
+			statistics.distinct != 0)
+		{
+			double numRows = vardata.rel != NULL ? Max(vardata.rel->tuples, 1.0) : 1.0;
+			distinct = statistics.distinct > 0 ? statistics.distinct :
+					   -statistics.distinct * numRows;
+			distinct = Max(distinct, 1.0);
+		}
+
+		free_attstatsslot(&slot);
+	}
+
+	ReleaseVariableStats(vardata);
+	return distinct;
+}
+
+
+/*
+ * Finds the statistics of the path in the slot, whose documents are sorted by path.
+ */
+static bool
+FindPathStatistics(AttStatsSlot *slot, const char *path, uint32_t pathLength,
+				   BsonPathStatistics *statistics)
+{
+	int low = 0;
+	int high = slot->nvalues - 1;
+	while (low <= high)
+	{
+		int middle = low + (high - low) / 2;
+		pgbson *pathStats = DatumGetPgBson(slot->values[middle]);
+
+		bson_iter_t pathStatsIter;
+		PgbsonInitIterator(pathStats, &pathStatsIter);
+		if (!bson_iter_find(&pathStatsIter, BSON_PATH_STATS_PATH) ||
+			!BSON_ITER_HOLDS_UTF8(&pathStatsIter))
+		{
+			return false;
+		}
+
+		uint32_t statsPathLength = 0;
+		const char *statsPath = bson_iter_utf8(&pathStatsIter, &statsPathLength);
+		int compare = memcmp(statsPath, path, Min(statsPathLength, pathLength));
+		if (compare == 0)
+		{
+			compare = statsPathLength < pathLength ? -1 :
+					  statsPathLength > pathLength ? 1 : 0;
+		}
+
+		if (compare < 0)
+		{
+			low = middle + 1;
+			continue;
+		}
+		else if (compare > 0)
+		{
+			high = middle - 1;
+			continue;
+		}
+
+		memset(statistics, 0, sizeof(BsonPathStatistics));
+		PgbsonInitIterator(pathStats, &pathStatsIter);
+		while (bson_iter_next(&pathStatsIter))
+		{
+			const char *key = bson_iter_key(&pathStatsIter);
+			const bson_value_t *value = bson_iter_value(&pathStatsIter);
+			if (strcmp(key, BSON_PATH_STATS_EXISTS_FRAC) == 0)
+			{
+				statistics->existsFrac = BsonValueAsDouble(value);
+			}
+			else if (strcmp(key, BSON_PATH_STATS_NULL_FRAC) == 0)
+			{
+				statistics->nullFrac = BsonValueAsDouble(value);
+			}
+			else if (strcmp(key, BSON_PATH_STATS_DISTINCT) == 0)
+			{
+				statistics->distinct = BsonValueAsDouble(value);
+			}
+			else if (strcmp(key, BSON_PATH_STATS_HISTOGRAM_FRAC) == 0)
+			{
+				statistics->histogramFrac = BsonValueAsDouble(value);
+			}
+			else if (strcmp(key, BSON_PATH_STATS_TYPES) == 0)
+			{
+				statistics->types = *value;
+			}
+			else if (strcmp(key, BSON_PATH_STATS_MCV) == 0)
+			{
+				statistics->mostCommonValues = *value;
+			}
+			else if (strcmp(key, BSON_PATH_STATS_MCV_FREQS) == 0)
+			{
+				statistics->mostCommonFreqs = *value;
+			}
+			else if (strcmp(key, BSON_PATH_STATS_HISTOGRAM) == 0)
+			{
+				statistics->histogram = *value;
+			}
+		}
+
+		return statistics->mostCommonValues.value_type == BSON_TYPE_ARRAY &&
+			   statistics->mostCommonFreqs.value_type == BSON_TYPE_ARRAY &&
+			   statistics->histogram.value_type == BSON_TYPE_ARRAY &&
+			   statistics->types.value_type == BSON_TYPE_DOCUMENT;
+	}
+
+	return false;
+}
+
+
+/*
+ * Selectivity of { path: { $eq: value } }: the frequency of the value if it's
+ * a most common value, otherwise the rows not covered by the most common values
+ * spread evenly over the remaining distinct values.
+ */
+static double
+GetEqualitySelectivity(BsonPathStatistics *statistics, const bson_value_t *value,
+					   double numRows)
+{
+	if (value->value_type == BSON_TYPE_NULL)
+	{
+		/* $eq: null also matches the rows missing the path */
+		return statistics->nullFrac + (1.0 - statistics->existsFrac);
+	}
+
+	bson_iter_t valuesIter;
+	bson_iter_t freqsIter;
+	BsonValueInitIterator(&statistics->mostCommonValues, &valuesIter);
+	BsonValueInitIterator(&statistics->mostCommonFreqs, &freqsIter);
+
+	double mostCommonFrac = 0;
+	int numMostCommon = 0;
+	while (bson_iter_next(&valuesIter) && bson_iter_next(&freqsIter))
+	{
+		double frequency = BsonValueAsDouble(bson_iter_value(&freqsIter));
+		bool isComparisonValid = true;
+		if (CompareBsonValueAndType(bson_iter_value(&valuesIter), value,
+									&isComparisonValid) == 0 && isComparisonValid)
+		{
+			return frequency;
+		}
+
+		mostCommonFrac += frequency;
+		numMostCommon++;
+	}
+
+	double distinct = statistics->distinct >= 0 ? statistics->distinct :
+					  -statistics->distinct * numRows;
+	double otherDistinct = distinct - numMostCommon;
+	double otherFrac = Max(statistics->existsFrac - statistics->nullFrac -
+						   mostCommonFrac, 0);
+	if (otherDistinct < 1 || otherFrac <= 0)
+	{
+		/* Every value was seen in the sample: this one is rare if it exists */
+		return 1.0 / numRows;
+	}
+
+	return Min(otherFrac / otherDistinct, otherFrac);
+}
+
+
+/*
+ * Selectivity of a range over the path: the most common values within it plus
+ * the share of the histogram bounds that fall within it.
+ */
+static double
+GetRangeSelectivity(BsonPathStatistics *statistics, const DollarRangeParams *range)
+{
+	double selectivity = 0;
+
+	bson_iter_t valuesIter;
+	bson_iter_t freqsIter;
+	BsonValueInitIterator(&statistics->mostCommonValues, &valuesIter);
+	BsonValueInitIterator(&statistics->mostCommonFreqs, &freqsIter);
+	while (bson_iter_next(&valuesIter) && bson_iter_next(&freqsIter))
+	{
+		if (IsValueInRange(bson_iter_value(&valuesIter), range))
+		{
+			selectivity += BsonValueAsDouble(bson_iter_value(&freqsIter));
+		}
+	}
+
+	int numBounds = 0;
+	int numBoundsInRange = 0;
+	bson_iter_t histogramIter;
+	BsonValueInitIterator(&statistics->histogram, &histogramIter);
+	while (bson_iter_next(&histogramIter))
+	{
+		numBounds++;
+		if (IsValueInRange(bson_iter_value(&histogramIter), range))
+		{
+			numBoundsInRange++;
+		}
+	}
+
+	if (numBounds > 1)
+	{
+		/* Each bound stands for 1 / (numBounds - 1) of the histogram */
+		double histogramSelectivity = Min(numBoundsInRange, numBounds - 1) /
+									  (double) (numBounds - 1);
+		if (numBoundsInRange == 0)
+		{
+			/* The range may still fall between two bounds */
+			histogramSelectivity = 0.5 / (numBounds - 1);
+		}
+
+		selectivity += statistics->histogramFrac * histogramSelectivity;
+	}
+
+	return selectivity;
+}
+
+
+/*
+ * Selectivity of { path: { $type: ... } } from the fraction of rows holding
+ * each type at the path.
+ */
+static double
+GetTypeSelectivity(BsonPathStatistics *statistics, const bson_value_t *typeValue)
+{
+	if (typeValue->value_type == BSON_TYPE_ARRAY)
+	{
+		double selectivity = 0;
+		bson_iter_t typeIter;
+		BsonValueInitIterator(typeValue, &typeIter);
+		while (bson_iter_next(&typeIter))
+		{
+			selectivity += GetTypeSelectivity(statistics, bson_iter_value(&typeIter));
+		}
+
+		return selectivity;
+	}
+
+	bson_type_t types[4];
+	int numTypes = 1;
+	if (typeValue->value_type == BSON_TYPE_UTF8)
+	{
+		if (strcmp(typeValue->value.v_utf8.str, "number") == 0)
+		{
+			types[0] = BSON_TYPE_DOUBLE;
+			types[1] = BSON_TYPE_INT32;
+			types[2] = BSON_TYPE_INT64;
+			types[3] = BSON_TYPE_DECIMAL128;
+			numTypes = 4;
+		}
+		else
+		{
+			types[0] = BsonTypeFromName(typeValue->value.v_utf8.str);
+		}
+	}
+	else if (BsonValueIsNumberOrBool(typeValue))
+	{
+		if (!TryGetTypeFromInt64(BsonValueAsInt64(typeValue), &types[0]))
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		return 0;
+	}
+
+	double selectivity = 0;
+	for (int i = 0; i < numTypes; i++)
+	{
+		char typeCode[8];
+		pg_snprintf(typeCode, sizeof(typeCode), "%d", (int) types[i]);
+
+		bson_iter_t typesIter;
+		BsonValueInitIterator(&statistics->types, &typesIter);
+		if (bson_iter_find(&typesIter, typeCode))
+		{
+			selectivity += BsonValueAsDouble(bson_iter_value(&typesIter));
+		}
+	}
+
+	return selectivity;
+}
+
+
+/*
+ * Whether the value satisfies the range, comparisons only match values of the
+ * same sort order type as the bound.
+ */
+static bool
+IsValueInRange(const bson_value_t *value, const DollarRangeParams *range)
+{
+	bool isComparisonValid = true;
+	if (range->minValue.value_type != BSON_TYPE_EOD)
+	{
+		if (CompareBsonSortOrderType(value, &range->minValue) != 0)
+		{
+			return false;
+		}
+
+		int compare = CompareBsonValueAndType(value, &range->minValue,
+											  &isComparisonValid);
+		if (compare < 0 || (compare == 0 && !range->isMinInclusive))
+		{
+			return false;
+		}
+	}
+
+	if (range->maxValue.value_type != BSON_TYPE_EOD)
+	{
+		if (CompareBsonSortOrderType(value, &range->maxValue) != 0)
+		{
+			return false;
+		}
+
+		int compare = CompareBsonValueAndType(value, &range->maxValue,
+											  &isComparisonValid);
+		if (compare > 0 || (compare == 0 && !range->isMaxInclusive))
+		{
+			return false;
+		}
+	}
+
+	return isComparisonValid;
+}
@@ -18,4 +18,9 @@ AS '$libdir/pg_documentdb_extended_rum_core', 'documentdb_rum_get_meta_page_info
 CREATE OR REPLACE FUNCTION documentdb_api_internal.documentdb_rum_page_get_entries(page bytea, indexRelId Oid)
 RETURNS SETOF jsonb
 LANGUAGE c
-AS '$libdir/pg_documentdb_extended_rum_core', 'documentdb_rum_page_get_entries';
\ No newline at end of file
+AS '$libdir/pg_documentdb_extended_rum_core', 'documentdb_rum_page_get_entries';
+
+CREATE OR REPLACE FUNCTION documentdb_api_internal.documentdb_rum_vacuum_parallel_workers_launched()
+RETURNS bigint
+LANGUAGE c
+AS '$libdir/pg_documentdb_extended_rum_core', 'documentdb_rum_vacuum_parallel_workers_launched';
\ No newline at end of file
@@ -0,0 +1,108 @@
+SET search_path TO documentdb_api_catalog, documentdb_core, public;
+SET documentdb.next_collection_id TO 1400;
+SET documentdb.next_collection_index_id TO 1400;
+
+CREATE SCHEMA index_distinct_test;
+
+-- Whether the plan of a query walks the keys of an index
+CREATE FUNCTION index_distinct_test.uses_index_scan(p_query text) RETURNS bool AS
+$$
+    DECLARE
+        v_line text;
+    BEGIN
+        FOR v_line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || p_query LOOP
+            IF v_line LIKE '%bson_index_distinct_scan%' THEN
+                RETURN true;
+            END IF;
+        END LOOP;
+        RETURN false;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Runs a query with the index distinct scan enabled and disabled, and returns whether it walks an index keys,
+-- the rows it returns and the number of rows returned by only one of the two plans
+CREATE FUNCTION index_distinct_test.compare(p_query text, OUT uses_index bool, OUT rows int8, OUT mismatches int8) AS
+$$
+    DECLARE
+        v_index_rows text[];
+        v_regular_rows text[];
+    BEGIN
+        PERFORM set_config('documentdb.enableIndexDistinctScan', 'on', true);
+        uses_index := index_distinct_test.uses_index_scan(p_query);
+        EXECUTE FORMAT('SELECT array_agg(document::text) FROM (%s) q', p_query) INTO v_index_rows;
+
+        PERFORM set_config('documentdb.enableIndexDistinctScan', 'off', true);
+        EXECUTE FORMAT('SELECT array_agg(document::text) FROM (%s) q', p_query) INTO v_regular_rows;
+
+        SELECT COUNT(i.doc), COUNT(*) FILTER (WHERE i.doc IS NULL OR r.doc IS NULL) INTO rows, mismatches
+        FROM unnest(v_index_rows) i(doc) FULL JOIN unnest(v_regular_rows) r(doc) ON i.doc = r.doc;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- a is an int, a string, a document, null or missing
+SELECT documentdb_api.create_collection('idx_distinct_db', 'coll');
+SELECT documentdb_api_internal.create_indexes_non_concurrently(
+    'idx_distinct_db', '{ "createIndexes": "coll", "indexes": [ { "key": { "a": 1, "b": 1 }, "name": "a_1_b_1", "enableCompositeTerm": true } ] }', TRUE);
+SELECT COUNT(documentdb_api.insert_one('idx_distinct_db', 'coll', (CASE i % 11
+        WHEN 0 THEN FORMAT('{ "_id": %s, "b": %s }', i, i % 3)
+        WHEN 1 THEN FORMAT('{ "_id": %s, "a": null, "b": %s }', i, i % 3)
+        WHEN 2 THEN FORMAT('{ "_id": %s, "a": "x%s", "b": %s }', i, i % 4, i % 3)
+        WHEN 3 THEN FORMAT('{ "_id": %s, "a": { "c": %s }, "b": %s }', i, i % 2, i % 3)
+        ELSE FORMAT('{ "_id": %s, "a": %s, "b": %s }', i, i % 7, i % 3) END)::bson))
+FROM generate_series(1, 300) AS i;
+
+-- distinct and $group counts on the first path of the index walk its keys
+SELECT * FROM index_distinct_test.compare($$SELECT bson_dollar_unwind(document, '$values') AS document FROM bson_aggregation_distinct('idx_distinct_db', '{ "distinct": "coll", "key": "a" }')$$);
+SELECT * FROM index_distinct_test.compare($$SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$group": { "_id": "$a", "n": { "$sum": 1 }, "c": { "$count": {} } } } ] }')$$);
+SELECT * FROM index_distinct_test.compare($$SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$group": { "_id": "$a", "n": { "$sum": 1 } } }, { "$match": { "n": { "$gt": 20 } } }, { "$sort": { "n": -1 } } ] }')$$);
+
+-- distinct ignores the collation either way
+SELECT * FROM index_distinct_test.compare($$SELECT bson_dollar_unwind(document, '$values') AS document FROM bson_aggregation_distinct('idx_distinct_db', '{ "distinct": "coll", "key": "a", "collation": { "locale": "en", "strength": 1 } }')$$);
+
+-- filters, other paths and other accumulators keep the regular plan
+SELECT * FROM index_distinct_test.compare($$SELECT bson_dollar_unwind(document, '$values') AS document FROM bson_aggregation_distinct('idx_distinct_db', '{ "distinct": "coll", "key": "a", "query": { "b": 1 } }')$$);
+SELECT * FROM index_distinct_test.compare($$SELECT bson_dollar_unwind(document, '$values') AS document FROM bson_aggregation_distinct('idx_distinct_db', '{ "distinct": "coll", "key": "b" }')$$);
+SELECT * FROM index_distinct_test.compare($$SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$match": { "b": 1 } }, { "$group": { "_id": "$a", "n": { "$sum": 1 } } } ] }')$$);
+SELECT * FROM index_distinct_test.compare($$SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$group": { "_id": "$a", "n": { "$sum": 2 } } } ] }')$$);
+
+-- $group with a collation fails the same way with the index distinct scan
+SET documentdb_core.enableCollation TO on;
+SET documentdb.enableIndexDistinctScan TO on;
+SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$group": { "_id": "$a", "n": { "$sum": 1 } } } ], "collation": { "locale": "en", "strength": 1 } }');
+RESET documentdb.enableIndexDistinctScan;
+RESET documentdb_core.enableCollation;
+
+-- deleted documents are not counted, whether their page is all visible or not
+SELECT documentdb_api.delete('idx_distinct_db', '{ "delete": "coll", "deletes": [ { "q": { "_id": { "$gt": 200 } }, "limit": 0 } ] }');
+SELECT * FROM index_distinct_test.compare($$SELECT bson_dollar_unwind(document, '$values') AS document FROM bson_aggregation_distinct('idx_distinct_db', '{ "distinct": "coll", "key": "a" }')$$);
+SELECT * FROM index_distinct_test.compare($$SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$group": { "_id": "$a", "n": { "$sum": 1 } } } ] }')$$);
+VACUUM (FREEZE ON) documentdb_data.documents_1401;
+SELECT * FROM index_distinct_test.compare($$SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$group": { "_id": "$a", "n": { "$sum": 1 } } } ] }')$$);
+
+-- queries planned before the index becomes multi-key read the documents instead of the index keys
+SET documentdb.enableIndexDistinctScan TO on;
+PREPARE distinct_a AS SELECT bson_dollar_unwind(document, '$values') AS document FROM bson_aggregation_distinct('idx_distinct_db', '{ "distinct": "coll", "key": "a" }');
+PREPARE group_a AS SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$group": { "_id": "$a", "n": { "$sum": 1 } } } ] }');
+SELECT index_distinct_test.uses_index_scan('EXECUTE distinct_a') AS distinct_uses_index, index_distinct_test.uses_index_scan('EXECUTE group_a') AS group_uses_index;
+
+SELECT documentdb_api.insert_one('idx_distinct_db', 'coll', '{ "_id": 1000, "a": [ 1, 100 ], "b": 1 }');
+SELECT index_distinct_test.uses_index_scan($$SELECT document FROM bson_aggregation_distinct('idx_distinct_db', '{ "distinct": "coll", "key": "a" }')$$) AS new_plan_uses_index,
+    index_distinct_test.uses_index_scan('EXECUTE distinct_a') AS prepared_plan_uses_index;
+
+CREATE TEMP TABLE distinct_fallback AS EXECUTE distinct_a;
+CREATE TEMP TABLE group_fallback AS EXECUTE group_a;
+RESET documentdb.enableIndexDistinctScan;
+CREATE TEMP TABLE distinct_regular AS SELECT bson_dollar_unwind(document, '$values') AS document FROM bson_aggregation_distinct('idx_distinct_db', '{ "distinct": "coll", "key": "a" }');
+CREATE TEMP TABLE group_regular AS SELECT document FROM bson_aggregation_pipeline('idx_distinct_db', '{ "aggregate": "coll", "pipeline": [ { "$group": { "_id": "$a", "n": { "$sum": 1 } } } ] }');
+
+SELECT COUNT(f.document) AS rows, COUNT(*) FILTER (WHERE f.document IS NULL OR r.document IS NULL) AS mismatches
+FROM distinct_fallback f FULL JOIN distinct_regular r ON f.document::text = r.document::text;
+SELECT COUNT(f.document) AS rows, COUNT(*) FILTER (WHERE f.document IS NULL OR r.document IS NULL) AS mismatches
+FROM group_fallback f FULL JOIN group_regular r ON f.document::text = r.document::text;
+SELECT document FROM distinct_fallback WHERE document::text LIKE '%"100"%';
+
+DEALLOCATE distinct_a;
+DEALLOCATE group_a;
+DROP TABLE distinct_fallback, group_fallback, distinct_regular, group_regular;
+SELECT documentdb_api.drop_collection('idx_distinct_db', 'coll');
+DROP SCHEMA index_distinct_test CASCADE;
@@ -0,0 +1,105 @@
+SET search_path TO documentdb_api_catalog, documentdb_core, public;
+SET documentdb.next_collection_id TO 1300;
+SET documentdb.next_collection_index_id TO 1300;
+
+CREATE SCHEMA rum_prune_test;
+
+-- Returns the number of leaf entry pages of the a_1 index of a collection and the number of entries on them
+CREATE FUNCTION rum_prune_test.leaf_pages(p_collection text, OUT pages int8, OUT entries int8) AS
+$$
+    SELECT COUNT(*), SUM((s.stats ->> 'nEntries')::int8)
+    FROM (SELECT 'documentdb_data.documents_rum_index_' || index_id AS index_name FROM documentdb_api_catalog.collection_indexes
+          WHERE (index_spec).index_name = 'a_1' AND collection_id = (SELECT collection_id FROM documentdb_api_catalog.collections
+                                                                       WHERE database_name = 'rum_prune_db' AND collection_name = p_collection)) i,
+    LATERAL (SELECT documentdb_api_internal.documentdb_rum_page_get_stats(public.get_raw_page(i.index_name, blkno::int4)) AS stats
+             FROM generate_series(1, pg_relation_size(i.index_name::regclass) / 8192 - 1) blkno) s
+    WHERE s.stats ->> 'flagsStr' = 'LEAF';
+$$ LANGUAGE sql;
+
+-- Waits for up to p_timeout seconds until the a_1 index of a collection has no more than p_entries leaf entries
+CREATE FUNCTION rum_prune_test.wait_for_leaf_entries(p_collection text, p_entries int8, p_timeout int) RETURNS bool AS
+$$
+BEGIN
+    FOR i IN 1 .. p_timeout * 10 LOOP
+        IF (rum_prune_test.leaf_pages(p_collection)).entries <= p_entries THEN
+            RETURN true;
+        END IF;
+        PERFORM pg_sleep(0.1);
+    END LOOP;
+    RETURN false;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT documentdb_api.create_collection('rum_prune_db', 'unthrottled');
+SELECT documentdb_api.create_collection('rum_prune_db', 'throttled');
+SELECT documentdb_api.create_collection('rum_prune_db', 'background');
+
+-- disable autovacuum to have predicatability
+SELECT FORMAT('ALTER TABLE documentdb_data.documents_%s set (autovacuum_enabled = off)', collection_id) FROM documentdb_api_catalog.collections WHERE database_name = 'rum_prune_db' ORDER BY collection_id \gexec
+
+SELECT documentdb_api_internal.create_indexes_non_concurrently(
+    'rum_prune_db', '{ "createIndexes": "unthrottled", "indexes": [ { "key": { "a": 1 }, "name": "a_1", "enableCompositeTerm": true } ] }', TRUE);
+SELECT documentdb_api_internal.create_indexes_non_concurrently(
+    'rum_prune_db', '{ "createIndexes": "throttled", "indexes": [ { "key": { "a": 1 }, "name": "a_1", "enableCompositeTerm": true } ] }', TRUE);
+SELECT documentdb_api_internal.create_indexes_non_concurrently(
+    'rum_prune_db', '{ "createIndexes": "background", "indexes": [ { "key": { "a": 1 }, "name": "a_1", "enableCompositeTerm": true } ] }', TRUE);
+
+SELECT COUNT(documentdb_api.insert_one('rum_prune_db', 'unthrottled', FORMAT('{ "_id": %s, "a": %s }', i, i)::bson)) FROM generate_series(1, 3000) AS i;
+SELECT COUNT(documentdb_api.insert_one('rum_prune_db', 'throttled', FORMAT('{ "_id": %s, "a": %s }', i, i)::bson)) FROM generate_series(1, 3000) AS i;
+SELECT COUNT(documentdb_api.insert_one('rum_prune_db', 'background', FORMAT('{ "_id": %s, "a": %s }', i, i)::bson)) FROM generate_series(1, 3000) AS i;
+
+-- delete all the documents and vacuum without cleaning up the entries: the leaf pages are left with empty entries
+set documentdb_rum.vacuum_cleanup_entries to off;
+set documentdb_rum.prune_rum_empty_pages to off;
+SELECT documentdb_api.delete('rum_prune_db', '{ "delete": "unthrottled", "deletes": [ { "q": {}, "limit": 0 } ]}');
+SELECT documentdb_api.delete('rum_prune_db', '{ "delete": "throttled", "deletes": [ { "q": {}, "limit": 0 } ]}');
+SELECT documentdb_api.delete('rum_prune_db', '{ "delete": "background", "deletes": [ { "q": {}, "limit": 0 } ]}');
+VACUUM (FREEZE ON, INDEX_CLEANUP ON, DISABLE_PAGE_SKIPPING ON) documentdb_data.documents_1301;
+VACUUM (FREEZE ON, INDEX_CLEANUP ON, DISABLE_PAGE_SKIPPING ON) documentdb_data.documents_1302;
+VACUUM (FREEZE ON, INDEX_CLEANUP ON, DISABLE_PAGE_SKIPPING ON) documentdb_data.documents_1303;
+reset documentdb_rum.vacuum_cleanup_entries;
+reset documentdb_rum.prune_rum_empty_pages;
+
+SELECT pages AS leaf_pages, entries AS leaf_entries FROM rum_prune_test.leaf_pages('throttled') \gset
+SELECT :leaf_pages > 4 AS many_leaf_pages, :leaf_entries >= 3000 AS all_entries_left;
+
+-- prune an index in one pass
+set client_min_messages to WARNING;
+SELECT documentdb_api_internal.rum_prune_empty_entries_on_index(('documentdb_data.documents_rum_index_' || index_id)::regclass)
+FROM documentdb_api_catalog.collection_indexes WHERE collection_id = 1301 AND (index_spec).index_name = 'a_1';
+reset client_min_messages;
+SELECT entries AS pruned_entries FROM rum_prune_test.leaf_pages('unthrottled') \gset
+SELECT :pruned_entries < :leaf_entries AS pruned;
+
+-- prune the same index in batches of 2 pages, with a delay of 100ms between batches: it takes longer and prunes as much
+set documentdb_rum.prune_empty_entries_pages_per_cycle to 2;
+set documentdb_rum.prune_empty_entries_cycle_delay_ms to 100;
+SELECT clock_timestamp() AS prune_start \gset
+set client_min_messages to WARNING;
+SELECT documentdb_api_internal.rum_prune_empty_entries_on_index(('documentdb_data.documents_rum_index_' || index_id)::regclass)
+FROM documentdb_api_catalog.collection_indexes WHERE collection_id = 1302 AND (index_spec).index_name = 'a_1';
+reset client_min_messages;
+SELECT clock_timestamp() - :'prune_start'::timestamptz >= (:leaf_pages / 2 - 1) * interval '100 milliseconds' AS throttled;
+SELECT entries = :pruned_entries AS same_entries FROM rum_prune_test.leaf_pages('throttled');
+reset documentdb_rum.prune_empty_entries_pages_per_cycle;
+reset documentdb_rum.prune_empty_entries_cycle_delay_ms;
+
+-- the background worker prunes the last index, in batches that release the locks while it sleeps in between
+ALTER SYSTEM SET documentdb_rum.background_prune_empty_entries_access_methods = 'documentdb_extended_rum';
+ALTER SYSTEM SET documentdb_rum.background_prune_empty_entries_naptime = 1;
+ALTER SYSTEM SET documentdb_rum.prune_empty_entries_pages_per_cycle = 2;
+ALTER SYSTEM SET documentdb_rum.prune_empty_entries_cycle_delay_ms = 100;
+SELECT pg_reload_conf();
+SELECT rum_prune_test.wait_for_leaf_entries('background', :pruned_entries, 180);
+SELECT entries = :pruned_entries AS same_entries FROM rum_prune_test.leaf_pages('background');
+
+ALTER SYSTEM RESET documentdb_rum.background_prune_empty_entries_access_methods;
+ALTER SYSTEM RESET documentdb_rum.background_prune_empty_entries_naptime;
+ALTER SYSTEM RESET documentdb_rum.prune_empty_entries_pages_per_cycle;
+ALTER SYSTEM RESET documentdb_rum.prune_empty_entries_cycle_delay_ms;
+SELECT pg_reload_conf();
+
+SELECT documentdb_api.drop_collection('rum_prune_db', 'unthrottled');
+SELECT documentdb_api.drop_collection('rum_prune_db', 'throttled');
+SELECT documentdb_api.drop_collection('rum_prune_db', 'background');
+DROP SCHEMA rum_prune_test CASCADE;
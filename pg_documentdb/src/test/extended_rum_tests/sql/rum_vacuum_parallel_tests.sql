@@ -0,0 +1,70 @@
+SET search_path TO documentdb_api_catalog, documentdb_core, public;
+SET documentdb.next_collection_id TO 1200;
+SET documentdb.next_collection_index_id TO 1200;
+
+-- vacuum two identical collections: one with the serial cleanup scan, the other with the parallel one
+set documentdb_rum.enable_new_bulk_delete to on;
+set documentdb_rum.enable_new_bulk_delete_inline_data_pages to on;
+set documentdb_rum.vacuum_cleanup_entries to on;
+set documentdb_rum.prune_rum_empty_pages to on;
+set max_parallel_maintenance_workers to 2;
+set documentdb_rum.vacuum_parallel_min_pages to 16;
+
+SELECT documentdb_api.create_collection('pvacuum_par_db', 'serial');
+SELECT documentdb_api.create_collection('pvacuum_par_db', 'parallel');
+
+-- disable autovacuum to have predicatability
+SELECT FORMAT('ALTER TABLE documentdb_data.documents_%s set (autovacuum_enabled = off)', collection_id) FROM documentdb_api_catalog.collections WHERE database_name = 'pvacuum_par_db' ORDER BY collection_id \gexec
+
+-- long values of b make an index of many entry pages, the few values of a make posting trees
+SELECT COUNT(documentdb_api.insert_one('pvacuum_par_db', 'serial', FORMAT('{ "_id": %s, "a": %s, "b": "%s" }', i, i % 20, repeat('x', 200) || i)::bson)) FROM generate_series(1, 10000) AS i;
+SELECT COUNT(documentdb_api.insert_one('pvacuum_par_db', 'parallel', FORMAT('{ "_id": %s, "a": %s, "b": "%s" }', i, i % 20, repeat('x', 200) || i)::bson)) FROM generate_series(1, 10000) AS i;
+
+SELECT documentdb_api_internal.create_indexes_non_concurrently(
+    'pvacuum_par_db',
+    '{ "createIndexes": "serial", "indexes": [ { "key": { "a": 1 }, "name": "a_1", "enableCompositeTerm": true }, { "key": { "b": 1 }, "name": "b_1", "enableCompositeTerm": true } ] }', TRUE);
+SELECT documentdb_api_internal.create_indexes_non_concurrently(
+    'pvacuum_par_db',
+    '{ "createIndexes": "parallel", "indexes": [ { "key": { "a": 1 }, "name": "a_1", "enableCompositeTerm": true }, { "key": { "b": 1 }, "name": "b_1", "enableCompositeTerm": true } ] }', TRUE);
+
+-- b_1 spans more than one chunk (64 blocks) of the parallel scan
+SELECT pg_relation_size(('documentdb_data.documents_rum_index_' || index_id)::regclass) / 8192 > 64 AS multi_chunk FROM documentdb_api_catalog.collection_indexes WHERE collection_id = 1202 AND (index_spec).index_name = 'b_1';
+
+-- delete most documents and vacuum both collections: this empties pages and posting trees
+SELECT documentdb_api.delete('pvacuum_par_db', '{ "delete": "serial", "deletes": [ { "q": { "_id": { "$gt": 1000 } }, "limit": 0 } ]}');
+SELECT documentdb_api.delete('pvacuum_par_db', '{ "delete": "parallel", "deletes": [ { "q": { "_id": { "$gt": 1000 } }, "limit": 0 } ]}');
+
+set documentdb_rum.vacuum_parallel_workers to 0;
+SELECT documentdb_api_internal.documentdb_rum_vacuum_parallel_workers_launched() AS workers_launched \gset
+VACUUM (PARALLEL 0, FREEZE ON, INDEX_CLEANUP ON, DISABLE_PAGE_SKIPPING ON) documentdb_data.documents_1201;
+SELECT documentdb_api_internal.documentdb_rum_vacuum_parallel_workers_launched() = :workers_launched AS serial_cleanup;
+set documentdb_rum.vacuum_parallel_workers to 2;
+VACUUM (PARALLEL 0, FREEZE ON, INDEX_CLEANUP ON, DISABLE_PAGE_SKIPPING ON) documentdb_data.documents_1202;
+SELECT documentdb_api_internal.documentdb_rum_vacuum_parallel_workers_launched() > :workers_launched AS launched_workers;
+reset documentdb_rum.vacuum_parallel_workers;
+
+-- a second round recycles the pages deleted by the first one
+-- delete most documents and vacuum both collections: this empties pages and posting trees
+SELECT documentdb_api.delete('pvacuum_par_db', '{ "delete": "serial", "deletes": [ { "q": { "_id": { "$gt": 500 } }, "limit": 0 } ]}');
+SELECT documentdb_api.delete('pvacuum_par_db', '{ "delete": "parallel", "deletes": [ { "q": { "_id": { "$gt": 500 } }, "limit": 0 } ]}');
+
+set documentdb_rum.vacuum_parallel_workers to 0;
+SELECT documentdb_api_internal.documentdb_rum_vacuum_parallel_workers_launched() AS workers_launched \gset
+VACUUM (PARALLEL 0, FREEZE ON, INDEX_CLEANUP ON, DISABLE_PAGE_SKIPPING ON) documentdb_data.documents_1201;
+SELECT documentdb_api_internal.documentdb_rum_vacuum_parallel_workers_launched() = :workers_launched AS serial_cleanup;
+set documentdb_rum.vacuum_parallel_workers to 2;
+VACUUM (PARALLEL 0, FREEZE ON, INDEX_CLEANUP ON, DISABLE_PAGE_SKIPPING ON) documentdb_data.documents_1202;
+SELECT documentdb_api_internal.documentdb_rum_vacuum_parallel_workers_launched() > :workers_launched AS launched_workers;
+reset documentdb_rum.vacuum_parallel_workers;
+
+-- the parallel cleanup leaves the indexes as the serial one does
+WITH idx AS (SELECT collection_id, (index_spec).index_name AS name, documentdb_api_internal.documentdb_rum_get_meta_page_info(public.get_raw_page('documentdb_data.documents_rum_index_' || index_id, 0))::text AS meta FROM documentdb_api_catalog.collection_indexes WHERE collection_id IN (1201, 1202) AND (index_spec).index_name IN ('a_1', 'b_1'))
+SELECT s.name, s.meta = p.meta AS same_meta FROM idx s JOIN idx p ON s.name = p.name WHERE s.collection_id = 1201 AND p.collection_id = 1202 ORDER BY s.name;
+
+-- and queries through the vacuumed indexes return the remaining documents
+set documentdb.forceDisableSeqScan to on;
+SELECT document FROM bson_aggregation_count('pvacuum_par_db', '{ "count": "serial", "query": { "b": { "$exists": true } } }');
+SELECT document FROM bson_aggregation_count('pvacuum_par_db', '{ "count": "serial", "query": { "a": 5 } }');
+SELECT document FROM bson_aggregation_count('pvacuum_par_db', '{ "count": "parallel", "query": { "b": { "$exists": true } } }');
+SELECT document FROM bson_aggregation_count('pvacuum_par_db', '{ "count": "parallel", "query": { "a": 5 } }');
+reset documentdb.forceDisableSeqScan;
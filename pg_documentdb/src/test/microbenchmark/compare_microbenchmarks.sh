@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Compares two results files of run_microbenchmarks.sh and reports the
+# benchmarks whose time per operation changed by more than a threshold.
+# Exits with 1 if any benchmark regressed by more than the threshold.
+
+# exit immediately if a command exits with a non-zero status
+set -e
+# fail if trying to reference a variable that is not set.
+set -u
+
+if [ $# -lt 2 ]; then
+  echo "Usage: $0 <baseline results> <current results> [threshold percent, defaults to 10]"
+  exit 1
+fi
+
+baselineFile="$1"
+currentFile="$2"
+threshold="${3:-10}"
+
+# Prints "name nanosPerOperation" for every result of a results file
+ReadResults() {
+  sed -n 's/.*"name": "\([^"]*\)".*"nanosPerOperation": \([0-9.eE+-]*\).*/\1 \2/p' "$1"
+}
+
+awk -v threshold="$threshold" '
+  NR == FNR { baseline[$1] = $2; next }
+  {
+    if (!($1 in baseline)) {
+      printf "%-32s %14s %14.1f %9s\n", $1, "-", $2, "new"
+      next
+    }
+
+    change = baseline[$1] > 0 ? ($2 - baseline[$1]) * 100 / baseline[$1] : 0
+    status = ""
+    if (change > threshold) { status = "REGRESSED"; regressions++ }
+    else if (change < -threshold) { status = "improved" }
+    printf "%-32s %14.1f %14.1f %+8.1f%% %s\n", $1, baseline[$1], $2, change, status
+  }
+  BEGIN { printf "%-32s %14s %14s %9s\n", "benchmark", "baseline ns", "current ns", "change" }
+  END { exit regressions > 0 ? 1 : 0 }
+' <(ReadResults "$baselineFile") <(ReadResults "$currentFile")
@@ -0,0 +1,10 @@
+-- Declares the microbenchmark function and the table the corpora are loaded
+-- into. Run by run_microbenchmarks.sh before the benchmarks.
+CREATE SCHEMA IF NOT EXISTS documentdb_microbenchmark;
+
+CREATE OR REPLACE FUNCTION documentdb_microbenchmark.run(benchmark text, documents documentdb_core.bson[], spec documentdb_core.bson, iterations int4)
+    RETURNS documentdb_core.bson LANGUAGE C VOLATILE STRICT AS '$libdir/pg_documentdb',
+$$documentdb_microbenchmark$$;
+
+DROP TABLE IF EXISTS documentdb_microbenchmark.corpus;
+CREATE TABLE documentdb_microbenchmark.corpus (name text NOT NULL, document documentdb_core.bson NOT NULL);
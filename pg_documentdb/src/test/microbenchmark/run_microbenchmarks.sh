@@ -0,0 +1,156 @@
+#!/bin/bash
+
+# Runs the microbenchmarks in microbenchmarks.txt against a running server
+# with documentdb installed, over the documents of sample-data, and writes the
+# results as JSON. Results of two runs can be compared with
+# compare_microbenchmarks.sh.
+
+# exit immediately if a command exits with a non-zero status
+set -e
+# fail if trying to reference a variable that is not set.
+set -u
+
+scriptDir="$( cd -P "$( dirname "$(readlink -f "${BASH_SOURCE[0]}")" )" && pwd )"
+sampleDataDir="$scriptDir/../../../../sample-data"
+
+port="5432"
+database="postgres"
+iterations="1000"
+outputFile="$scriptDir/log/microbenchmark_results.json"
+filter=""
+help="false"
+
+while getopts "p:d:i:o:f:h" opt; do
+  case $opt in
+    p) port="$OPTARG"
+    ;;
+    d) database="$OPTARG"
+    ;;
+    i) iterations="$OPTARG"
+    ;;
+    o) outputFile="$OPTARG"
+    ;;
+    f) filter="$OPTARG"
+    ;;
+    h) help="true"
+    ;;
+  esac
+
+  case ${OPTARG:-""} in
+    -*) echo "Option $opt needs a valid argument. use -h to get help."
+    exit 1
+    ;;
+  esac
+done
+
+if [ "$help" == "true" ]; then
+  echo "Usage: $0 [-p port] [-d database] [-i iterations] [-o output file] [-f name filter]"
+  echo "  -p  port of the server, defaults to 5432"
+  echo "  -d  database with documentdb installed, defaults to postgres"
+  echo "  -i  iterations of each benchmark over its corpus, defaults to 1000"
+  echo "  -o  file the JSON results are written to"
+  echo "  -f  only run the benchmarks whose name matches this regular expression"
+  exit 1
+fi
+
+psqlCommand=(psql -X -q -v ON_ERROR_STOP=1 -p "$port" -d "$database")
+
+# Converts the insertMany array of a sample-data script into one extended
+# JSON document per line.
+ExtractSampleDocuments() {
+  perl -0777 -ne '
+    next unless /insertMany\((\[.*?\n\])\);/s;
+    my $data = $1;
+    $data =~ s{//[^\n]*}{}g;
+    $data =~ s/new Date\(("[^"]*")\)/{ "\$date": $1 }/g;
+    $data =~ s/([\{,]\s*)([A-Za-z_\$][A-Za-z0-9_]*)\s*:/$1"$2":/g;
+    $data =~ s/\s*\n\s*/ /g;
+
+    my ($depth, $inString, $escaped, $start) = (0, 0, 0, 0);
+    for (my $i = 0; $i < length($data); $i++) {
+      my $c = substr($data, $i, 1);
+      if ($inString) {
+        if ($escaped) { $escaped = 0; }
+        elsif ($c eq "\\") { $escaped = 1; }
+        elsif ($c eq "\"") { $inString = 0; }
+        next;
+      }
+      if ($c eq "\"") { $inString = 1; }
+      elsif ($c eq "{" || $c eq "[") {
+        $start = $i if ($depth == 1 && $c eq "{");
+        $depth++;
+      }
+      elsif ($c eq "}" || $c eq "]") {
+        $depth--;
+        print substr($data, $start, $i - $start + 1), "\n" if ($depth == 1);
+      }
+    }' "$1"
+}
+
+LoadCorpora() {
+  "${psqlCommand[@]}" -f "$scriptDir/microbenchmark_setup.sql"
+
+  local sqlFile
+  sqlFile=$(mktemp)
+  for sampleFile in "$sampleDataDir"/*.js; do
+    local corpus
+    corpus=$(perl -ne 'print $1 if /db\.(\w+)\.insertMany/' "$sampleFile")
+    ExtractSampleDocuments "$sampleFile" | while IFS= read -r document; do
+      echo "INSERT INTO documentdb_microbenchmark.corpus VALUES ('$corpus', '${document//\'/\'\'}');" >> "$sqlFile"
+    done
+  done
+
+  "${psqlCommand[@]}" -f "$sqlFile"
+  rm -f "$sqlFile"
+}
+
+RunMicrobenchmark() {
+  local name="$1" benchmark="$2" corpus="$3" spec="$4"
+  "${psqlCommand[@]}" -A -t -F ' ' -c "
+    WITH result AS (
+      SELECT documentdb_microbenchmark.run('$benchmark',
+        (SELECT array_agg(document ORDER BY document) FROM documentdb_microbenchmark.corpus WHERE name = '$corpus'),
+        '${spec//\'/\'\'}'::documentdb_core.bson, $iterations) AS document)
+    SELECT documentdb_core.bson_get_value_text(document, 'operations'),
+           documentdb_core.bson_get_value_text(document, 'totalNanos'),
+           documentdb_core.bson_get_value_text(document, 'nanosPerOperation')
+    FROM result"
+}
+
+mkdir -p "$(dirname "$outputFile")"
+LoadCorpora
+
+commit=$(git -C "$scriptDir" rev-parse HEAD 2>/dev/null || echo "unknown")
+
+# One result per line, so that compare_microbenchmarks.sh can read them back
+{
+  echo "{"
+  echo "  \"commit\": \"$commit\","
+  echo "  \"iterations\": $iterations,"
+  echo "  \"results\": ["
+  separator=""
+  while IFS='|' read -r name benchmark corpus spec; do
+    name=$(echo "$name" | xargs)
+    if [[ "$name" == "" || "$name" == \#* ]]; then
+      continue
+    fi
+
+    if [[ "$filter" != "" && ! "$name" =~ $filter ]]; then
+      continue
+    fi
+
+    benchmark=$(echo "$benchmark" | xargs)
+    corpus=$(echo "$corpus" | xargs)
+    read -r operations totalNanos nanosPerOperation <<< "$(RunMicrobenchmark "$name" "$benchmark" "$corpus" "$spec")"
+    echo "$name: $nanosPerOperation ns/op" >&2
+
+    printf '%s    { "name": "%s", "benchmark": "%s", "corpus": "%s", "operations": %s, "totalNanos": %s, "nanosPerOperation": %s }' \
+      "$separator" "$name" "$benchmark" "$corpus" "$operations" "$totalNanos" "$nanosPerOperation"
+    separator=$',\n'
+  done < "$scriptDir/microbenchmarks.txt"
+  echo ""
+  echo "  ]"
+  echo "}"
+} > "$outputFile"
+
+echo "Results written to $outputFile"
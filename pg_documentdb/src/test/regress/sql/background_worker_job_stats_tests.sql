@@ -0,0 +1,89 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 16000;
+SET documentdb.next_collection_index_id TO 16000;
+
+CREATE SCHEMA bg_job_stats_test;
+
+-- Sums a counter of background_worker_job_stats across the jobs, or for one job
+CREATE FUNCTION bg_job_stats_test.counter(p_counter text, p_job_id int DEFAULT NULL) RETURNS int8 AS
+$$
+    DECLARE
+        v_value int8;
+    BEGIN
+        EXECUTE FORMAT('SELECT COALESCE(SUM(%I), 0)::int8 FROM documentdb_api_internal.background_worker_job_stats() WHERE $1 IS NULL OR job_id = $1',
+            p_counter) USING p_job_id INTO v_value;
+        RETURN v_value;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Waits up to 30 seconds for a counter to go past a value, returns whether it did
+CREATE FUNCTION bg_job_stats_test.wait_for_counter(p_counter text, p_value int8, p_job_id int DEFAULT NULL) RETURNS bool AS
+$$
+    BEGIN
+        FOR i IN 1..300 LOOP
+            IF bg_job_stats_test.counter(p_counter, p_job_id) > p_value THEN
+                RETURN true;
+            END IF;
+            PERFORM pg_sleep(0.1);
+        END LOOP;
+        RETURN false;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Every registered job is listed with its priority and a histogram of its run times
+SELECT job_id, job_name, priority, array_length(latency_histogram, 1) AS buckets
+FROM documentdb_api_internal.background_worker_job_stats() ORDER BY job_id;
+
+-- Completed runs are part of the started runs, and no job is postponed for load without a load threshold
+SELECT job_id, failures + timeouts <= runs AS failures_are_runs,
+    (SELECT SUM(bucket) FROM unnest(latency_histogram) bucket) <= runs AS histogram_counts_runs,
+    deferred_for_load = 0 AS not_deferred_for_load
+FROM documentdb_api_internal.background_worker_job_stats() ORDER BY job_id;
+
+-- The index build job runs every documentdb.indexBuildScheduleInSec
+SELECT bg_job_stats_test.counter('runs', 90) AS runs_before \gset
+SELECT bg_job_stats_test.wait_for_counter('runs', :runs_before, 90);
+
+-- Write a first profile entry so that system.profile exists
+SELECT documentdb_api.insert_one('bg_job_stats_db', 'profiled', '{ "_id": 1, "a": 1 }');
+PREPARE profiled_find(text, documentdb_core.bson) AS SELECT cursorPage FROM documentdb_api.find_cursor_first_page($1, $2);
+SELECT documentdb_api.profile('bg_job_stats_db', '{ "profile": 2 }');
+EXECUTE profiled_find('bg_job_stats_db', '{ "find": "profiled", "filter": { "_id": 1 } }');
+DO $$
+BEGIN
+    FOR i IN 1..300 LOOP
+        EXIT WHEN (SELECT COUNT(*) FROM documentdb_api.collection('bg_job_stats_db', 'system.profile')) >= 1;
+        PERFORM pg_sleep(0.1);
+    END LOOP;
+END;
+$$;
+SELECT collection_id AS profile_collection_id FROM documentdb_api_catalog.collections
+WHERE database_name = 'bg_job_stats_db' AND collection_name = 'system.profile' \gset
+
+-- With a single job slot, jobs that are due while the profiler flush waits on system.profile are postponed
+ALTER SYSTEM SET documentdb.backgroundWorkerMaxConcurrentJobs = 1;
+SELECT pg_reload_conf();
+BEGIN;
+LOCK TABLE documentdb_data.documents_:profile_collection_id IN ACCESS EXCLUSIVE MODE;
+EXECUTE profiled_find('bg_job_stats_db', '{ "find": "profiled", "filter": { "_id": 1 } }');
+SELECT bg_job_stats_test.counter('deferred_for_slots') AS deferred_before \gset
+SELECT bg_job_stats_test.wait_for_counter('deferred_for_slots', :deferred_before);
+COMMIT;
+ALTER SYSTEM RESET documentdb.backgroundWorkerMaxConcurrentJobs;
+SELECT pg_reload_conf();
+
+-- The postponed flush completes once the lock is released
+DO $$
+BEGIN
+    FOR i IN 1..300 LOOP
+        EXIT WHEN (SELECT COUNT(*) FROM documentdb_api.collection('bg_job_stats_db', 'system.profile')) >= 2;
+        PERFORM pg_sleep(0.1);
+    END LOOP;
+END;
+$$;
+SELECT COUNT(*) FROM documentdb_api.collection('bg_job_stats_db', 'system.profile');
+
+SELECT documentdb_api.profile('bg_job_stats_db', '{ "profile": 0 }');
+DEALLOCATE profiled_find;
+SELECT documentdb_api.drop_database('bg_job_stats_db');
+DROP SCHEMA bg_job_stats_test CASCADE;
@@ -0,0 +1,60 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 15400;
+SET documentdb.next_collection_index_id TO 15400;
+
+CREATE SCHEMA aggregate_spill_test;
+
+-- Returns the temp blocks written by a query, which include the spill files of the accumulators
+CREATE FUNCTION aggregate_spill_test.get_temp_blocks_written(p_query text) RETURNS int8 AS
+$$
+    DECLARE
+        v_plan json;
+    BEGIN
+        EXECUTE 'EXPLAIN (ANALYZE, BUFFERS, TIMING OFF, SUMMARY OFF, FORMAT JSON) ' || p_query INTO v_plan;
+        RETURN (v_plan -> 0 -> 'Plan' ->> 'Temp Written Blocks')::int8;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- 2 groups of 2250 values of 2KB, each group has 750 distinct values that repeat every 750 documents
+SELECT COUNT(documentdb_api.insert_one('db', 'aggregate_spill',
+    FORMAT('{ "_id": %s, "g": %s, "s": "%s-%s" }', i, i % 2, repeat('x', 2000), i % 1500)::documentdb_core.bson,
+    NULL)) FROM generate_series(1, 4500) i;
+
+-- A large work_mem keeps the sorts and hash tables of the plans in memory
+SET work_mem TO '64MB';
+SET documentdb.aggregateStateSpillThresholdMB TO 1;
+
+-- The results of $push and $addToSet without the feature are the baseline
+\set pipeline '{ "aggregate": "aggregate_spill", "pipeline": [ { "$group": { "_id": "$g", "pushed": { "$push": "$s" }, "set": { "$addToSet": "$s" } } }, { "$project": { "pushed": 1, "pushedSize": { "$size": "$pushed" }, "set": { "$sortArray": { "input": "$set", "sortBy": 1 } }, "setSize": { "$size": "$set" } } } ], "cursor": {} }'
+\set pipelineNoDisk '{ "aggregate": "aggregate_spill", "pipeline": [ { "$group": { "_id": "$g", "pushed": { "$push": "$s" }, "set": { "$addToSet": "$s" } } }, { "$project": { "pushed": 1, "pushedSize": { "$size": "$pushed" }, "set": { "$sortArray": { "input": "$set", "sortBy": 1 } }, "setSize": { "$size": "$set" } } } ], "cursor": {}, "allowDiskUse": false }'
+SET documentdb.enableAggregateSpill TO off;
+CREATE TEMP TABLE in_memory AS SELECT document::text FROM bson_aggregation_pipeline('db', :'pipeline');
+SELECT bson_dollar_project(document::bson, '{ "pushedSize": 1, "setSize": 1 }') FROM in_memory ORDER BY 1;
+
+-- With allowDiskUse the states spill, $push keeps the order of the documents and $addToSet
+-- drops the values repeated across the spilled runs
+SET documentdb.enableAggregateSpill TO on;
+SELECT aggregate_spill_test.get_temp_blocks_written(FORMAT('SELECT document FROM bson_aggregation_pipeline(%L, %L)', 'db', :'pipeline')) > 0 AS spilled;
+CREATE TEMP TABLE spilled AS SELECT document::text FROM bson_aggregation_pipeline('db', :'pipeline');
+SELECT (SELECT COUNT(*) FROM spilled) AS rows, (SELECT COUNT(*) FROM (SELECT * FROM spilled EXCEPT SELECT * FROM in_memory UNION ALL (SELECT * FROM in_memory EXCEPT SELECT * FROM spilled)) q) AS mismatches;
+DROP TABLE spilled;
+
+-- Without it the states stay in memory
+SELECT aggregate_spill_test.get_temp_blocks_written(FORMAT('SELECT document FROM bson_aggregation_pipeline(%L, %L)', 'db', :'pipelineNoDisk')) > 0 AS spilled;
+CREATE TEMP TABLE not_spilled AS SELECT document::text FROM bson_aggregation_pipeline('db', :'pipelineNoDisk');
+SELECT (SELECT COUNT(*) FROM not_spilled) AS rows, (SELECT COUNT(*) FROM (SELECT * FROM not_spilled EXCEPT SELECT * FROM in_memory UNION ALL (SELECT * FROM in_memory EXCEPT SELECT * FROM not_spilled)) q) AS mismatches;
+DROP TABLE not_spilled, in_memory;
+
+-- Without allowDiskUse the size of an intermediate state is limited to 100MB: 10 values of 10MB exceed it
+SELECT COUNT(documentdb_api.insert_one('db', 'aggregate_spill_large',
+    FORMAT('{ "_id": %s, "s": "%s" }', i, repeat('x', 10 * 1024 * 1024))::documentdb_core.bson,
+    NULL)) FROM generate_series(1, 10) i;
+SELECT document FROM bson_aggregation_pipeline('db',
+    '{ "aggregate": "aggregate_spill_large", "pipeline": [ { "$group": { "_id": null, "pushed": { "$push": "$s" } } }, { "$project": { "pushedSize": { "$size": "$pushed" } } } ], "cursor": {}, "allowDiskUse": false }');
+
+RESET documentdb.enableAggregateSpill;
+RESET documentdb.aggregateStateSpillThresholdMB;
+RESET work_mem;
+DROP SCHEMA aggregate_spill_test CASCADE;
+SELECT documentdb_api.drop_collection('db', 'aggregate_spill');
+SELECT documentdb_api.drop_collection('db', 'aggregate_spill_large');
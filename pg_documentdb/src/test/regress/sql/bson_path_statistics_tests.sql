@@ -0,0 +1,39 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 15200;
+SET documentdb.next_collection_index_id TO 15200;
+
+-- "a" is 1 on 80% of the documents and unique otherwise, "b" is a string on every fourth one and "c" is on every fifth one
+SELECT COUNT(documentdb_api.insert_one('pathstatsdb', 'pathstats',
+    FORMAT('{ "_id": %s, "a": %s, "b": %s %s }', i, CASE WHEN i <= 800 THEN 1 ELSE i END,
+        CASE WHEN i % 4 = 0 THEN '"str"' ELSE i::text END, CASE WHEN i % 5 = 0 THEN ', "c": true' ELSE '' END)::documentdb_core.bson,
+    NULL)) FROM generate_series(1, 1000) i;
+
+-- path statistics are only collected when enabled, and only used by the new selectivity mode
+SET documentdb_core.enableBsonPathStatistics TO on;
+ANALYZE documentdb_data.documents_15201;
+SET documentdb.enableNewSelectivityMode TO on;
+SET documentdb.enableBsonPathStatisticsSelectivity TO on;
+
+-- the estimates follow the data: a most common value, a rare one, $in, $range, $exists and $type
+SELECT actual_rows, abs(estimated_rows - actual_rows) <= GREATEST(actual_rows * 0.1, 2) AS estimate_is_close FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @= '{ "a": 1 }'$$);
+SELECT actual_rows, abs(estimated_rows - actual_rows) <= GREATEST(actual_rows * 0.1, 2) AS estimate_is_close FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @= '{ "a": 900 }'$$);
+SELECT actual_rows, abs(estimated_rows - actual_rows) <= GREATEST(actual_rows * 0.1, 2) AS estimate_is_close FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @*= '{ "a": [ 1, 900 ] }'$$);
+SELECT actual_rows, abs(estimated_rows - actual_rows) <= GREATEST(actual_rows * 0.1, 2) AS estimate_is_close FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @<> '{ "a": { "min": 850, "max": 950, "minInclusive": false, "maxInclusive": false } }'$$);
+SELECT actual_rows, abs(estimated_rows - actual_rows) <= GREATEST(actual_rows * 0.1, 2) AS estimate_is_close FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @? '{ "c": true }'$$);
+SELECT actual_rows, abs(estimated_rows - actual_rows) <= GREATEST(actual_rows * 0.1, 2) AS estimate_is_close FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @? '{ "c": false }'$$);
+SELECT actual_rows, abs(estimated_rows - actual_rows) <= GREATEST(actual_rows * 0.1, 2) AS estimate_is_close FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @# '{ "b": "string" }'$$);
+SELECT actual_rows, abs(estimated_rows - actual_rows) <= GREATEST(actual_rows * 0.1, 2) AS estimate_is_close FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @# '{ "b": "number" }'$$);
+
+-- with the selectivity off, or after an ANALYZE that does not collect them, the planner keeps its default estimates
+SET documentdb.enableBsonPathStatisticsSelectivity TO off;
+CREATE TEMP TABLE default_estimates AS SELECT estimated_rows FROM documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @= '{ "a": 1 }'$$);
+SET documentdb_core.enableBsonPathStatistics TO off;
+ANALYZE documentdb_data.documents_15201;
+SET documentdb.enableBsonPathStatisticsSelectivity TO on;
+SELECT e.estimated_rows = d.estimated_rows AS estimate_is_default FROM default_estimates d, documentdb_test_helpers.get_estimated_and_actual_rows($$SELECT document FROM documentdb_api.collection('pathstatsdb', 'pathstats') WHERE document @= '{ "a": 1 }'$$) e;
+DROP TABLE default_estimates;
+
+RESET documentdb_core.enableBsonPathStatistics;
+RESET documentdb.enableNewSelectivityMode;
+RESET documentdb.enableBsonPathStatisticsSelectivity;
+SELECT documentdb_api.drop_collection('pathstatsdb', 'pathstats');
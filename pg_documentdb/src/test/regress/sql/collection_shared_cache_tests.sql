@@ -0,0 +1,60 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 15300;
+SET documentdb.next_collection_index_id TO 15300;
+
+-- Every step below runs in a new backend, which only sees the changes of the previous
+-- ones through the catalog or the shared collection cache
+SELECT documentdb_api.insert_one('sharedcache', 'renamed', '{ "_id": 1, "a": 1 }');
+SELECT document FROM bson_aggregation_find('sharedcache', '{ "find": "renamed" }');
+
+-- a rename is seen by the next backend
+\c -
+SET search_path TO documentdb_api_catalog;
+SELECT document FROM bson_aggregation_find('sharedcache', '{ "find": "renamed" }');
+SELECT documentdb_api.rename_collection('sharedcache', 'renamed', 'renamed_new');
+
+\c -
+SET search_path TO documentdb_api_catalog;
+SELECT document FROM bson_aggregation_find('sharedcache', '{ "find": "renamed" }');
+SELECT document FROM bson_aggregation_find('sharedcache', '{ "find": "renamed_new" }');
+
+-- so is a drop, and the name is then free for a new collection
+SELECT documentdb_api.drop_collection('sharedcache', 'renamed_new');
+
+\c -
+SET search_path TO documentdb_api_catalog;
+SELECT document FROM bson_aggregation_find('sharedcache', '{ "find": "renamed_new" }');
+SELECT documentdb_api.insert_one('sharedcache', 'renamed_new', '{ "_id": 2, "a": 2 }');
+
+\c -
+SET search_path TO documentdb_api_catalog;
+SELECT document FROM bson_aggregation_find('sharedcache', '{ "find": "renamed_new" }');
+
+-- a validator added with collMod applies to the next backend
+SET documentdb.enableSchemaValidation TO on;
+SELECT p_result FROM documentdb_api.insert('sharedcache', '{ "insert": "validated", "documents": [ { "_id": 1, "a": "text" } ] }');
+
+\c -
+SET search_path TO documentdb_api_catalog;
+SET documentdb.enableSchemaValidation TO on;
+SELECT p_result FROM documentdb_api.insert('sharedcache', '{ "insert": "validated", "documents": [ { "_id": 2, "a": "text" } ] }');
+SELECT documentdb_api.coll_mod('sharedcache', 'validated', '{ "collMod": "validated", "validator": { "$jsonSchema": { "bsonType": "object", "properties": { "a": { "bsonType": "int" } } } } }');
+
+\c -
+SET search_path TO documentdb_api_catalog;
+SET documentdb.enableSchemaValidation TO on;
+SELECT p_result FROM documentdb_api.insert('sharedcache', '{ "insert": "validated", "documents": [ { "_id": 3, "a": "text" } ] }');
+SELECT p_result FROM documentdb_api.insert('sharedcache', '{ "insert": "validated", "documents": [ { "_id": 4, "a": 4 } ] }');
+
+-- and so is a change of the validator
+SELECT documentdb_api.coll_mod('sharedcache', 'validated', '{ "collMod": "validated", "validator": { "$jsonSchema": { "bsonType": "object", "properties": { "a": { "bsonType": "string" } } } } }');
+
+\c -
+SET search_path TO documentdb_api_catalog;
+SET documentdb.enableSchemaValidation TO on;
+SELECT p_result FROM documentdb_api.insert('sharedcache', '{ "insert": "validated", "documents": [ { "_id": 5, "a": "text" } ] }');
+SELECT p_result FROM documentdb_api.insert('sharedcache', '{ "insert": "validated", "documents": [ { "_id": 6, "a": 6 } ] }');
+SELECT document FROM bson_aggregation_find('sharedcache', '{ "find": "validated", "projection": { "_id": 1 } }');
+
+SELECT documentdb_api.drop_collection('sharedcache', 'renamed_new');
+SELECT documentdb_api.drop_collection('sharedcache', 'validated');
@@ -0,0 +1,59 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 15500;
+SET documentdb.next_collection_index_id TO 15500;
+
+SELECT documentdb_api.insert_one('profiler_db', 'profiled', '{ "_id": 1, "a": 1 }');
+SELECT documentdb_api.insert_one('profiler_db', 'profiled', '{ "_id": 2, "a": 2 }');
+
+-- Commands are profiled when they run with the database and the spec as parameters, as the gateway runs them
+PREPARE profiled_find(text, documentdb_core.bson) AS SELECT cursorPage FROM documentdb_api.find_cursor_first_page($1, $2);
+
+-- The profile command returns the settings before the change
+SELECT documentdb_api.profile('profiler_db', '{ "profile": -1 }');
+SELECT documentdb_api.profile('profiler_db', '{ "profile": 3 }');
+SELECT documentdb_api.profile('profiler_db', '{ "profile": 1, "sampleRate": 2 }');
+SELECT documentdb_api.profile('profiler_db', '{ "profile": 1, "filter": { "op": "query" } }');
+SELECT documentdb_api.profile('profiler_db', '{ "slowms": 10 }');
+
+-- Level 0 profiles nothing
+EXECUTE profiled_find('profiler_db', '{ "find": "profiled", "filter": { "_id": 1 } }');
+
+-- Level 1 profiles the commands slower than slowms
+SELECT documentdb_api.profile('profiler_db', '{ "profile": 1, "slowms": 100000 }');
+EXECUTE profiled_find('profiler_db', '{ "find": "profiled", "filter": { "_id": 1 } }');
+SELECT documentdb_api.profile('profiler_db', '{ "profile": 1, "slowms": 0 }');
+EXECUTE profiled_find('profiler_db', '{ "find": "profiled", "filter": { "a": 2 } }');
+
+-- Level 2 profiles every command that is sampled
+SELECT documentdb_api.profile('profiler_db', '{ "profile": 2, "slowms": 100000, "sampleRate": 0 }');
+EXECUTE profiled_find('profiler_db', '{ "find": "profiled", "filter": { "_id": 1 } }');
+SELECT documentdb_api.profile('profiler_db', '{ "profile": 2, "sampleRate": 1 }');
+EXECUTE profiled_find('profiler_db', '{ "find": "profiled", "filter": { "a": { "$gt": 0 } }, "sort": { "a": -1 } }');
+
+-- Other databases are not profiled
+EXECUTE profiled_find('profiler_other_db', '{ "find": "profiled", "filter": { "_id": 1 } }');
+
+SELECT documentdb_api.profile('profiler_db', '{ "profile": 0 }');
+EXECUTE profiled_find('profiler_db', '{ "find": "profiled", "filter": { "_id": 1 } }');
+SELECT documentdb_api.profile('profiler_db', '{ "profile": -1 }');
+
+-- The profiled commands reach system.profile once the ring is flushed
+SELECT documentdb_api_internal.flush_profile_entries_background();
+
+-- The background job may flush the same entries concurrently, wait until they are visible
+DO $$
+BEGIN
+    FOR i IN 1..100 LOOP
+        EXIT WHEN (SELECT COUNT(*) FROM documentdb_api.collection('profiler_db', 'system.profile')) >= 2;
+        PERFORM pg_sleep(0.1);
+    END LOOP;
+END;
+$$;
+
+SELECT bson_dollar_project(document, '{ "_id": 0, "op": 1, "ns": 1, "command": 1, "queryShape": 1, "nreturned": 1 }') FROM documentdb_api.collection('profiler_db', 'system.profile') ORDER BY object_id;
+SELECT COUNT(*) AS measured FROM documentdb_api.collection('profiler_db', 'system.profile')
+    WHERE document @? '{ "queryShapeHash": true }' AND document @? '{ "keysExamined": true }' AND document @? '{ "docsExamined": true }'
+    AND document @? '{ "cpuMicros": true }' AND document @? '{ "durationMicros": true }' AND document @? '{ "ts": true }';
+
+DEALLOCATE profiled_find;
+SELECT documentdb_api.drop_database('profiler_db');
@@ -0,0 +1,127 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 15900;
+SET documentdb.next_collection_index_id TO 15900;
+\set VERBOSITY TERSE
+
+CREATE SCHEMA document_compression_test;
+
+-- Returns the documents a find returns from the collection with compression and from the one without, and
+-- the number of documents returned by only one of them
+CREATE FUNCTION document_compression_test.compare_find(p_filter text, p_projection text DEFAULT '{}', OUT rows int8, OUT mismatches int8) AS
+$$
+    DECLARE
+        v_compressed text := FORMAT('SELECT document::text AS doc FROM documentdb_api_catalog.bson_aggregation_find(%L, %L)',
+            'compression_db', FORMAT('{ "find": "compressed", "filter": %s, "projection": %s }', p_filter, p_projection));
+        v_plain text := FORMAT('SELECT document::text AS doc FROM documentdb_api_catalog.bson_aggregation_find(%L, %L)',
+            'compression_db', FORMAT('{ "find": "plain", "filter": %s, "projection": %s }', p_filter, p_projection));
+    BEGIN
+        EXECUTE FORMAT('SELECT COUNT(c.doc), COUNT(*) FILTER (WHERE c.doc IS NULL OR p.doc IS NULL) FROM (%s) c FULL JOIN (%s) p ON c.doc = p.doc',
+            v_compressed, v_plain) INTO rows, mismatches;
+    END;
+$$ LANGUAGE plpgsql;
+
+CREATE FUNCTION document_compression_test.collection_id(p_collection text) RETURNS int8 AS
+$$
+    SELECT collection_id FROM documentdb_api_catalog.collections
+    WHERE database_name = 'compression_db' AND collection_name = p_collection;
+$$ LANGUAGE sql;
+
+-- The bytes of the documents of a collection as they are stored: the column is read through a whole row
+-- value, which the planner does not decode
+CREATE FUNCTION document_compression_test.stored_bytes(p_collection text) RETURNS int8 AS
+$$
+    DECLARE
+        v_bytes int8;
+    BEGIN
+        EXECUTE FORMAT('SELECT SUM(pg_column_size((r).document)) FROM (SELECT d AS r FROM documentdb_data.documents_%s d OFFSET 0) s',
+            document_compression_test.collection_id(p_collection)) INTO v_bytes;
+        RETURN v_bytes;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Enables or disables compression, and returns what collMod reports without the measured ratio itself
+CREATE FUNCTION document_compression_test.set_compression(p_enable bool) RETURNS documentdb_core.bson AS
+$$
+    SELECT documentdb_api_catalog.bson_dollar_project(
+        documentdb_api.coll_mod('compression_db', 'compressed', FORMAT('{ "collMod": "compressed", "documentCompression": %s }', p_enable)::documentdb_core.bson),
+        '{ "enabled": "$documentCompression.enabled", "dictionaryVersion": "$documentCompression.dictionaryVersion", "compresses": { "$gt": [ "$documentCompression.sampleCompressionRatio", 2 ] } }');
+$$ LANGUAGE sql;
+
+CREATE FUNCTION document_compression_test.insert_documents(p_collection text, p_from int, p_to int) RETURNS int8 AS
+$$
+    SELECT COUNT(documentdb_api.insert_one('compression_db', p_collection,
+        FORMAT('{ "_id": %s, "customerName": "c%s", "region": "r%s", "quantity": %s, "address": { "city": "city%s", "zip": %s }, "description": "Order %s placed by customer c%s for delivery to the standard shipping address on file. The order is handled by the regional fulfilment center and ships with the default carrier." }',
+            i, i % 10, i % 7, i % 13, i % 5, i % 100, i, i % 10)::documentdb_core.bson,
+        NULL))
+    FROM generate_series(p_from, p_to) i;
+$$ LANGUAGE sql;
+
+SELECT document_compression_test.insert_documents('compressed', 1, 3000);
+SELECT document_compression_test.insert_documents('plain', 1, 3000);
+DO $$
+BEGIN
+    EXECUTE FORMAT('ANALYZE documentdb_data.documents_%s', document_compression_test.collection_id('compressed'));
+END;
+$$;
+
+-- collMod enables compression only when the feature is on
+SELECT document_compression_test.set_compression(true);
+SET documentdb.enableDocumentCompression TO on;
+
+-- The first dictionary is trained from a TABLESAMPLE of the collection, existing documents are left as they are
+SELECT document_compression_test.set_compression(true);
+SELECT dictionary_version, sample_uncompressed_bytes < document_compression_test.stored_bytes('compressed') / 2 AS sampled_part,
+    sample_compressed_bytes < sample_uncompressed_bytes AS compresses
+FROM documentdb_api_catalog.collection_compression WHERE collection_id = document_compression_test.collection_id('compressed');
+
+-- New documents are stored compressed, and read back as they were inserted
+SELECT document_compression_test.insert_documents('compressed', 3001, 3500);
+SELECT document_compression_test.insert_documents('plain', 3001, 3500);
+SELECT document_compression_test.stored_bytes('compressed') < document_compression_test.stored_bytes('plain');
+SELECT * FROM document_compression_test.compare_find('{}');
+SELECT * FROM document_compression_test.compare_find('{ "customerName": "c3" }');
+SELECT * FROM document_compression_test.compare_find('{ "quantity": { "$gte": 10 } }');
+SELECT * FROM document_compression_test.compare_find('{ "address.city": "city2" }');
+SELECT * FROM document_compression_test.compare_find('{ "address": { "city": "city1", "zip": 1 } }');
+SELECT * FROM document_compression_test.compare_find('{ "region": { "$in": [ "r1", "r2" ] } }');
+SELECT * FROM document_compression_test.compare_find('{ "customerName": "c3", "quantity": { "$gte": 10 }, "address.city": { "$ne": "city0" } }');
+SELECT * FROM document_compression_test.compare_find('{ "quantity": 0 }', '{ "customerName": 1, "address.zip": 1 }');
+
+-- Updates keep compressed documents compressed
+SELECT p_result FROM documentdb_api.update('compression_db', '{ "update": "compressed", "updates": [ { "q": { "region": "r3" }, "u": { "$set": { "status": "shipped" } }, "multi": true } ] }');
+SELECT p_result FROM documentdb_api.update('compression_db', '{ "update": "plain", "updates": [ { "q": { "region": "r3" }, "u": { "$set": { "status": "shipped" } }, "multi": true } ] }');
+SELECT document_compression_test.stored_bytes('compressed') < document_compression_test.stored_bytes('plain');
+SELECT * FROM document_compression_test.compare_find('{ "status": "shipped" }');
+
+-- The retrain job adds a dictionary version once the current one is older than the retrain interval
+UPDATE documentdb_api_catalog.collection_compression SET trained_at = now() - interval '2 days'
+WHERE collection_id = document_compression_test.collection_id('compressed');
+SELECT documentdb_api_internal.train_compression_dictionaries_background();
+SELECT dictionary_version FROM documentdb_api_catalog.collection_compression
+WHERE collection_id = document_compression_test.collection_id('compressed');
+SELECT COUNT(*) FROM documentdb_api_catalog.collection_compression_dictionary
+WHERE collection_id = document_compression_test.collection_id('compressed');
+
+-- Documents compressed with either version are read back
+SELECT document_compression_test.insert_documents('compressed', 3501, 3600);
+SELECT document_compression_test.insert_documents('plain', 3501, 3600);
+SELECT * FROM document_compression_test.compare_find('{}');
+SELECT * FROM document_compression_test.compare_find('{ "customerName": "c3" }');
+
+-- Reads decompress the stored documents whatever the setting: it only governs collMod, writes and retraining
+RESET documentdb.enableDocumentCompression;
+SELECT * FROM document_compression_test.compare_find('{}');
+SELECT * FROM document_compression_test.compare_find('{ "address": { "city": "city1", "zip": 1 } }');
+SELECT * FROM document_compression_test.compare_find('{ "status": { "$exists": true } }');
+
+-- Disabling compression keeps the dictionaries of the documents already compressed
+SET documentdb.enableDocumentCompression TO on;
+SELECT document_compression_test.set_compression(false);
+SELECT COUNT(*) FROM documentdb_api_catalog.collection_compression_dictionary
+WHERE collection_id = document_compression_test.collection_id('compressed');
+SELECT * FROM document_compression_test.compare_find('{ "region": { "$in": [ "r1", "r2" ] } }');
+
+RESET documentdb.enableDocumentCompression;
+SELECT documentdb_api.drop_collection('compression_db', 'compressed');
+SELECT documentdb_api.drop_collection('compression_db', 'plain');
+DROP SCHEMA document_compression_test CASCADE;
@@ -237,4 +237,21 @@ BEGIN
                           collection_name = p_collection_name)
   GROUP BY indisprimary;
 END;
+$$ LANGUAGE plpgsql;
+
+-- the planner's row estimate and the actual row count of a query's top plan node
+CREATE OR REPLACE FUNCTION documentdb_test_helpers.get_estimated_and_actual_rows(p_query text)
+RETURNS TABLE (
+  estimated_rows float8,
+  actual_rows float8
+)
+AS $$
+DECLARE
+  v_plan json;
+BEGIN
+  EXECUTE 'EXPLAIN (ANALYZE, TIMING OFF, SUMMARY OFF, FORMAT JSON) ' || p_query INTO v_plan;
+  RETURN QUERY
+  SELECT (v_plan -> 0 -> 'Plan' ->> 'Plan Rows')::float8,
+         (v_plan -> 0 -> 'Plan' ->> 'Actual Rows')::float8;
+END;
 $$ LANGUAGE plpgsql;
\ No newline at end of file
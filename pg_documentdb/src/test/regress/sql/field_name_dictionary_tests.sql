@@ -0,0 +1,162 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 15800;
+SET documentdb.next_collection_index_id TO 15800;
+
+CREATE SCHEMA field_dictionary_test;
+
+-- Returns the documents a find returns from the collection with a field name dictionary and from the one
+-- without, and the number of documents returned by only one of them
+CREATE FUNCTION field_dictionary_test.compare_find(p_filter text, p_projection text DEFAULT '{}', OUT rows int8, OUT mismatches int8) AS
+$$
+    DECLARE
+        v_encoded text := FORMAT('SELECT document::text AS doc FROM documentdb_api_catalog.bson_aggregation_find(%L, %L)',
+            'fndict_db', FORMAT('{ "find": "encoded", "filter": %s, "projection": %s }', p_filter, p_projection));
+        v_plain text := FORMAT('SELECT document::text AS doc FROM documentdb_api_catalog.bson_aggregation_find(%L, %L)',
+            'fndict_db', FORMAT('{ "find": "plain", "filter": %s, "projection": %s }', p_filter, p_projection));
+    BEGIN
+        EXECUTE FORMAT('SELECT COUNT(e.doc), COUNT(*) FILTER (WHERE e.doc IS NULL OR p.doc IS NULL) FROM (%s) e FULL JOIN (%s) p ON e.doc = p.doc',
+            v_encoded, v_plain) INTO rows, mismatches;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Same for two aggregation pipelines
+CREATE FUNCTION field_dictionary_test.compare_pipeline(p_encoded text, p_plain text, OUT rows int8, OUT mismatches int8) AS
+$$
+    DECLARE
+        v_encoded text := FORMAT('SELECT document::text AS doc FROM documentdb_api_catalog.bson_aggregation_pipeline(%L, %L)',
+            'fndict_db', p_encoded);
+        v_plain text := FORMAT('SELECT document::text AS doc FROM documentdb_api_catalog.bson_aggregation_pipeline(%L, %L)',
+            'fndict_db', p_plain);
+    BEGIN
+        EXECUTE FORMAT('SELECT COUNT(e.doc), COUNT(*) FILTER (WHERE e.doc IS NULL OR p.doc IS NULL) FROM (%s) e FULL JOIN (%s) p ON e.doc = p.doc',
+            v_encoded, v_plain) INTO rows, mismatches;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Whether the find on the collection with a field name dictionary uses an index
+CREATE FUNCTION field_dictionary_test.find_uses_index(p_filter text) RETURNS bool AS
+$$
+    DECLARE
+        v_plan json;
+    BEGIN
+        EXECUTE FORMAT('EXPLAIN (FORMAT JSON) SELECT document FROM documentdb_api_catalog.bson_aggregation_find(%L, %L)',
+            'fndict_db', FORMAT('{ "find": "encoded", "filter": %s }', p_filter)) INTO v_plan;
+        RETURN v_plan::text LIKE '%"Index Name"%';
+    END;
+$$ LANGUAGE plpgsql;
+
+-- The bytes of the documents of a collection as they are stored: the column is read through a whole row
+-- value, which the planner does not decode
+CREATE FUNCTION field_dictionary_test.stored_bytes(p_collection text) RETURNS int8 AS
+$$
+    DECLARE
+        v_collection_id int8;
+        v_bytes int8;
+    BEGIN
+        SELECT collection_id INTO v_collection_id FROM documentdb_api_catalog.collections
+            WHERE database_name = 'fndict_db' AND collection_name = p_collection;
+        EXECUTE FORMAT('SELECT SUM(pg_column_size((r).document)) FROM (SELECT d AS r FROM documentdb_data.documents_%s d OFFSET 0) s',
+            v_collection_id) INTO v_bytes;
+        RETURN v_bytes;
+    END;
+$$ LANGUAGE plpgsql;
+
+CREATE FUNCTION field_dictionary_test.insert_documents(p_collection text, p_from int, p_to int) RETURNS int8 AS
+$$
+    SELECT COUNT(documentdb_api.insert_one('fndict_db', p_collection,
+        FORMAT('{ "_id": %s, "orderNumber": %s, "customerName": "c%s", "shippingAddress": { "postalCode": %s, "countryName": "X" }, "orderItems": [ { "productCode": %s, "quantity": %s }, { "productCode": %s, "quantity": 1 } ], "tagList": [ "t%s", "t%s" ]%s }',
+            i, i, i % 10, i % 20, i % 5, i % 3, (i + 1) % 5, i % 3, i % 4, CASE WHEN i % 2 = 0 THEN ', "optionalField": true' ELSE '' END)::documentdb_core.bson,
+        NULL))
+    FROM generate_series(p_from, p_to) i;
+$$ LANGUAGE sql;
+
+SELECT field_dictionary_test.insert_documents('encoded', 1, 200);
+SELECT field_dictionary_test.insert_documents('plain', 1, 200);
+
+-- collMod builds the dictionary only when the feature is on
+SELECT documentdb_api.coll_mod('fndict_db', 'encoded', '{ "collMod": "encoded", "fieldNameDictionary": true }');
+SET documentdb.enableFieldNameDictionary TO on;
+
+-- The names longer than the encoded ids are sampled, existing documents are left as they are
+SELECT documentdb_api.coll_mod('fndict_db', 'encoded', '{ "collMod": "encoded", "fieldNameDictionary": true }');
+
+-- New documents are stored encoded, and read back as they were inserted
+SELECT field_dictionary_test.insert_documents('encoded', 201, 300);
+SELECT field_dictionary_test.insert_documents('plain', 201, 300);
+SELECT field_dictionary_test.stored_bytes('encoded') < field_dictionary_test.stored_bytes('plain');
+SELECT * FROM field_dictionary_test.compare_find('{}');
+
+-- Comparison operators match the encoded paths
+SELECT * FROM field_dictionary_test.compare_find('{ "customerName": "c3" }');
+SELECT * FROM field_dictionary_test.compare_find('{ "shippingAddress.postalCode": { "$gt": 15 } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "optionalField": { "$exists": true } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "optionalField": { "$exists": false } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "shippingAddress.countryName": { "$type": "string" } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "orderItems.productCode": 2 }');
+SELECT * FROM field_dictionary_test.compare_find('{ "orderItems.quantity": { "$lte": 0 } }');
+
+-- Document and array filter values compare field names, and are matched on the decoded document
+SELECT * FROM field_dictionary_test.compare_find('{ "shippingAddress": { "postalCode": 5, "countryName": "X" } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "orderItems": { "productCode": 1, "quantity": 1 } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "tagList": [ "t1", "t1" ] }');
+
+-- Projections
+SELECT * FROM field_dictionary_test.compare_find('{ "customerName": "c3" }', '{ "customerName": 1, "shippingAddress.postalCode": 1 }');
+SELECT * FROM field_dictionary_test.compare_find('{ "optionalField": { "$exists": true } }', '{ "orderItems.productCode": 1, "tagList": { "$slice": 1 } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "_id": { "$lte": 10 } }', '{ "shippingAddress": 0, "orderItems": 0 }');
+
+-- Updates keep encoded documents encoded
+SELECT p_result FROM documentdb_api.update('fndict_db', '{ "update": "encoded", "updates": [ { "q": { "shippingAddress.postalCode": { "$lt": 5 } }, "u": { "$set": { "customerName": "updated", "shippingAddress.countryName": "Y" }, "$inc": { "orderNumber": 1000 } }, "multi": true } ] }');
+SELECT p_result FROM documentdb_api.update('fndict_db', '{ "update": "plain", "updates": [ { "q": { "shippingAddress.postalCode": { "$lt": 5 } }, "u": { "$set": { "customerName": "updated", "shippingAddress.countryName": "Y" }, "$inc": { "orderNumber": 1000 } }, "multi": true } ] }');
+SELECT p_result FROM documentdb_api.update('fndict_db', '{ "update": "encoded", "updates": [ { "q": { "_id": 7 }, "u": { "customerName": "replaced", "additionalNotes": "n" } } ] }');
+SELECT p_result FROM documentdb_api.update('fndict_db', '{ "update": "plain", "updates": [ { "q": { "_id": 7 }, "u": { "customerName": "replaced", "additionalNotes": "n" } } ] }');
+SELECT field_dictionary_test.stored_bytes('encoded') < field_dictionary_test.stored_bytes('plain');
+SELECT * FROM field_dictionary_test.compare_find('{}');
+SELECT * FROM field_dictionary_test.compare_find('{ "customerName": "c3" }');
+SELECT * FROM field_dictionary_test.compare_find('{ "customerName": "updated" }');
+SELECT * FROM field_dictionary_test.compare_find('{ "shippingAddress.countryName": "Y" }');
+SELECT * FROM field_dictionary_test.compare_find('{ "orderNumber": { "$gt": 1000 } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "additionalNotes": { "$exists": true } }');
+
+-- Reads decode the stored documents whatever the setting: it only governs collMod and writes
+RESET documentdb.enableFieldNameDictionary;
+SELECT * FROM field_dictionary_test.compare_find('{}');
+SELECT * FROM field_dictionary_test.compare_find('{ "orderItems.productCode": 2 }');
+SELECT * FROM field_dictionary_test.compare_find('{ "shippingAddress": { "postalCode": 5, "countryName": "X" } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "customerName": "c3" }', '{ "customerName": 1, "shippingAddress.postalCode": 1 }');
+
+-- Index builds read the decoded documents
+SELECT documentdb_api_internal.create_indexes_non_concurrently('fndict_db', '{ "createIndexes": "encoded", "indexes": [ { "key": { "customerName": 1 }, "name": "customerName_1" }, { "key": { "orderNumber": 1 }, "name": "orderNumber_1", "unique": true } ] }', true);
+SELECT documentdb_api_internal.create_indexes_non_concurrently('fndict_db', '{ "createIndexes": "plain", "indexes": [ { "key": { "customerName": 1 }, "name": "customerName_1" }, { "key": { "orderNumber": 1 }, "name": "orderNumber_1", "unique": true } ] }', true);
+SET enable_seqscan TO off;
+SELECT field_dictionary_test.find_uses_index('{ "customerName": "c5" }');
+SELECT * FROM field_dictionary_test.compare_find('{ "customerName": "c5" }');
+SELECT field_dictionary_test.find_uses_index('{ "orderNumber": { "$gte": 1000 } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "orderNumber": { "$gte": 1000 } }');
+SELECT * FROM field_dictionary_test.compare_find('{ "customerName": "updated" }');
+RESET enable_seqscan;
+
+-- Unique indexes find the duplicates of encoded documents, for plain and encoded new documents
+SELECT documentdb_api.insert_one('fndict_db', 'encoded', '{ "_id": 1000, "orderNumber": 150 }');
+SET documentdb.enableFieldNameDictionary TO on;
+SELECT documentdb_api.insert_one('fndict_db', 'encoded', '{ "_id": 1001, "orderNumber": 1201, "customerName": "duplicate" }');
+
+-- $lookup decodes the documents it joins, from either side
+SELECT * FROM field_dictionary_test.compare_pipeline(
+    '{ "aggregate": "plain", "pipeline": [ { "$match": { "_id": { "$lte": 20 } } }, { "$lookup": { "from": "encoded", "localField": "customerName", "foreignField": "customerName", "as": "matches" } }, { "$unwind": "$matches" }, { "$project": { "m": "$matches._id", "p": "$matches.shippingAddress.postalCode" } } ] }',
+    '{ "aggregate": "plain", "pipeline": [ { "$match": { "_id": { "$lte": 20 } } }, { "$lookup": { "from": "plain", "localField": "customerName", "foreignField": "customerName", "as": "matches" } }, { "$unwind": "$matches" }, { "$project": { "m": "$matches._id", "p": "$matches.shippingAddress.postalCode" } } ] }');
+SELECT * FROM field_dictionary_test.compare_pipeline(
+    '{ "aggregate": "encoded", "pipeline": [ { "$match": { "_id": { "$lte": 10 } } }, { "$lookup": { "from": "plain", "localField": "shippingAddress.postalCode", "foreignField": "shippingAddress.postalCode", "as": "matches" } }, { "$unwind": "$matches" }, { "$project": { "m": "$matches._id", "n": "$matches.customerName" } } ] }',
+    '{ "aggregate": "plain", "pipeline": [ { "$match": { "_id": { "$lte": 10 } } }, { "$lookup": { "from": "plain", "localField": "shippingAddress.postalCode", "foreignField": "shippingAddress.postalCode", "as": "matches" } }, { "$unwind": "$matches" }, { "$project": { "m": "$matches._id", "n": "$matches.customerName" } } ] }');
+
+-- Disabling the dictionary stores new documents as they are, and keeps the encoded ones readable
+SELECT documentdb_api.coll_mod('fndict_db', 'encoded', '{ "collMod": "encoded", "fieldNameDictionary": false }');
+SELECT field_dictionary_test.insert_documents('encoded', 301, 310);
+SELECT field_dictionary_test.insert_documents('plain', 301, 310);
+SELECT * FROM field_dictionary_test.compare_find('{}');
+SELECT * FROM field_dictionary_test.compare_find('{ "shippingAddress.postalCode": { "$gt": 15 } }');
+
+RESET documentdb.enableFieldNameDictionary;
+SELECT documentdb_api.drop_collection('fndict_db', 'encoded');
+SELECT documentdb_api.drop_collection('fndict_db', 'plain');
+DROP SCHEMA field_dictionary_test CASCADE;
@@ -0,0 +1,139 @@
+SET search_path TO documentdb_api_catalog, documentdb_core, public;
+SET documentdb.next_collection_id TO 16200;
+SET documentdb.next_collection_index_id TO 16200;
+
+CREATE SCHEMA geo_cell_test;
+
+-- Inserts a document in the collection with the compound cell index and in the one with GIST indexes
+CREATE FUNCTION geo_cell_test.insert(p_document text) RETURNS bool AS
+$$
+    BEGIN
+        PERFORM documentdb_api.insert_one('geo_cell_db', 'cell', p_document::bson);
+        PERFORM documentdb_api.insert_one('geo_cell_db', 'gist', p_document::bson);
+        RETURN true;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Runs a find on both collections with their indexes, and returns whether it matched any document and the
+-- number of documents matched by only one of the collections
+CREATE FUNCTION geo_cell_test.compare(p_filter text, OUT has_rows bool, OUT mismatches int8) AS
+$$
+    BEGIN
+        PERFORM set_config('enable_seqscan', 'off', true);
+        SELECT COUNT(c.doc) > 0, COUNT(*) FILTER (WHERE c.doc IS NULL OR g.doc IS NULL) INTO has_rows, mismatches
+        FROM (SELECT document::text AS doc FROM bson_aggregation_find('geo_cell_db', FORMAT('{ "find": "cell", "filter": %s }', p_filter)::bson)) c
+        FULL JOIN (SELECT document::text AS doc FROM bson_aggregation_find('geo_cell_db', FORMAT('{ "find": "gist", "filter": %s }', p_filter)::bson)) g
+        ON c.doc = g.doc;
+        PERFORM set_config('enable_seqscan', 'on', true);
+    END;
+$$ LANGUAGE plpgsql;
+
+-- The collection_id of a collection of geo_cell_db
+CREATE FUNCTION geo_cell_test.collection_id(p_collection text) RETURNS int8 AS
+$$
+    SELECT collection_id FROM documentdb_api_catalog.collections
+    WHERE database_name = 'geo_cell_db' AND collection_name = p_collection;
+$$ LANGUAGE sql;
+
+-- Same for the range check of $geoNear on "loc", which $geoNear and $nearSphere add for $maxDistance
+CREATE FUNCTION geo_cell_test.compare_geonear_range(p_near text, p_max_distance float8, OUT has_rows bool, OUT mismatches int8) AS
+$$
+    DECLARE
+        v_query text := FORMAT('SELECT document::text AS doc FROM documentdb_data.documents_%%s
+            WHERE documentdb_api_catalog.bson_validate_geography(document, ''loc'') IS NOT NULL
+            AND documentdb_api_catalog.bson_validate_geography(document, ''loc'') OPERATOR(documentdb_api_internal.@|><|) %L::documentdb_core.bson',
+            FORMAT('{ "loc": { "near": %s, "distanceField": "dist", "key": "loc", "maxDistance": %s } }', p_near, p_max_distance));
+    BEGIN
+        PERFORM set_config('enable_seqscan', 'off', true);
+        EXECUTE FORMAT('SELECT COUNT(c.doc) > 0, COUNT(*) FILTER (WHERE c.doc IS NULL OR g.doc IS NULL) FROM (%s) c FULL JOIN (%s) g ON c.doc = g.doc',
+            FORMAT(v_query, geo_cell_test.collection_id('cell')), FORMAT(v_query, geo_cell_test.collection_id('gist'))) INTO has_rows, mismatches;
+        PERFORM set_config('enable_seqscan', 'on', true);
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Returns the number of index scans in the plan of a find on the collection with the cell index, and whether
+-- the index conditions of the compound index scan have the equality and the geospatial predicates
+CREATE FUNCTION geo_cell_test.explain(p_filter text, OUT index_scans int, OUT equality_in_index bool, OUT geo_in_index bool) AS
+$$
+    DECLARE
+        v_line text;
+        v_in_compound_scan bool := false;
+    BEGIN
+        index_scans := 0;
+        equality_in_index := false;
+        geo_in_index := false;
+        PERFORM set_config('enable_seqscan', 'off', true);
+        FOR v_line IN EXECUTE FORMAT('EXPLAIN (COSTS OFF) SELECT document FROM bson_aggregation_find(%L, %L::bson)',
+            'geo_cell_db', FORMAT('{ "find": "cell", "filter": %s }', p_filter)) LOOP
+            IF v_line LIKE '%Index Scan%' THEN
+                index_scans := index_scans + 1;
+                v_in_compound_scan := v_line LIKE '%a_1_loc_2dsphere%';
+            ELSIF v_in_compound_scan AND v_line LIKE '%Index Cond%' THEN
+                equality_in_index := equality_in_index OR v_line LIKE '%@=%';
+                geo_in_index := geo_in_index OR v_line LIKE '%@|-|%' OR v_line LIKE '%@|#|%';
+            END IF;
+        END LOOP;
+        PERFORM set_config('enable_seqscan', 'on', true);
+    END;
+$$ LANGUAGE plpgsql;
+
+SELECT documentdb_api.create_collection('geo_cell_db', 'cell');
+SELECT documentdb_api.create_collection('geo_cell_db', 'gist');
+
+-- Compound regular and 2dsphere indexes need the cell index
+SELECT documentdb_api_internal.create_indexes_non_concurrently('geo_cell_db', '{ "createIndexes": "cell", "indexes": [ { "key": { "a": 1, "loc": "2dsphere" }, "name": "a_1_loc_2dsphere" } ] }', TRUE);
+SET documentdb.enableGeospatialCellIndex TO on;
+SELECT documentdb_api_internal.create_indexes_non_concurrently('geo_cell_db', '{ "createIndexes": "cell", "indexes": [ { "key": { "a": 1, "loc": "2dsphere" }, "name": "a_1_loc_2dsphere" } ] }', TRUE);
+RESET documentdb.enableGeospatialCellIndex;
+SELECT documentdb_api_internal.create_indexes_non_concurrently('geo_cell_db', '{ "createIndexes": "gist", "indexes": [ { "key": { "a": 1 }, "name": "a_1" }, { "key": { "loc": "2dsphere" }, "name": "loc_2dsphere" } ] }', TRUE);
+
+-- Points on a grid that has the edges of the cube faces (longitudes 45 + 90k, latitudes 35.26 and 45), the poles
+-- and the antimeridian, and points just off the face edges
+SELECT COUNT(geo_cell_test.insert(FORMAT('{ "_id": %s, "a": %s, "loc": { "type": "Point", "coordinates": [ %s, %s ] } }', id, id % 3, lon, lat)))
+FROM (SELECT row_number() OVER (ORDER BY lon, lat) AS id, lon, lat FROM (
+    SELECT lon, lat FROM generate_series(-180, 180, 15) lon, unnest(ARRAY[ -90, -89.9, -75, -60, -45.1, -45, -44.9, -35.26, -30, -15, 0,
+        15, 30, 35.26, 44.9, 45, 45.1, 60, 75, 89.9, 90 ]::float8[]) lat
+    UNION ALL
+    SELECT lon, lat FROM unnest(ARRAY[ -135.01, -134.99, -45.01, -44.99, 44.99, 45.01, 134.99, 135.01, 179.99, -179.99 ]::float8[]) lon,
+        generate_series(-90, 90, 15) lat) grid) points;
+
+-- Legacy coordinate pairs, lines and polygons across face edges and around the poles, and documents without a location
+SELECT geo_cell_test.insert('{ "_id": 1001, "a": 1, "loc": [ 45, 35.26 ] }');
+SELECT geo_cell_test.insert('{ "_id": 1002, "a": 2, "loc": [ -135, 0 ] }');
+SELECT geo_cell_test.insert('{ "_id": 1003, "a": 1, "loc": { "type": "LineString", "coordinates": [ [ 40, -5 ], [ 50, 5 ] ] } }');
+SELECT geo_cell_test.insert('{ "_id": 1004, "a": 2, "loc": { "type": "LineString", "coordinates": [ [ 0, 80 ], [ 90, 80 ], [ 180, 80 ] ] } }');
+SELECT geo_cell_test.insert('{ "_id": 1005, "a": 0, "loc": { "type": "Polygon", "coordinates": [ [ [ 130, -10 ], [ 140, -10 ], [ 140, 10 ], [ 130, 10 ], [ 130, -10 ] ] ] } }');
+SELECT geo_cell_test.insert('{ "_id": 1006, "a": 1, "loc": { "type": "Polygon", "coordinates": [ [ [ -20, 84 ], [ 20, 84 ], [ 20, 88 ], [ -20, 88 ], [ -20, 84 ] ] ] } }');
+SELECT geo_cell_test.insert('{ "_id": 1007, "a": 2, "loc": { "type": "Polygon", "coordinates": [ [ [ 170, -88 ], [ -170, -88 ], [ -170, -86 ], [ 170, -86 ], [ 170, -88 ] ] ] } }');
+SELECT geo_cell_test.insert('{ "_id": 1008, "a": 1 }');
+SELECT geo_cell_test.insert('{ "_id": 1009, "a": 1, "loc": null }');
+
+-- $geoWithin and $geoIntersects match the same documents as with the GIST index, with and without an equality on a
+SELECT * FROM geo_cell_test.compare('{ "loc": { "$geoWithin": { "$centerSphere": [ [ 45, 0 ], 0.1 ] } } }');
+SELECT * FROM geo_cell_test.compare('{ "loc": { "$geoWithin": { "$centerSphere": [ [ 45, 35.26 ], 0.05 ] } } }');
+SELECT * FROM geo_cell_test.compare('{ "loc": { "$geoWithin": { "$centerSphere": [ [ 0, 90 ], 0.3 ] } } }');
+SELECT * FROM geo_cell_test.compare('{ "loc": { "$geoWithin": { "$centerSphere": [ [ 0, -90 ], 0.3 ] } } }');
+SELECT * FROM geo_cell_test.compare('{ "loc": { "$geoWithin": { "$centerSphere": [ [ 180, 0 ], 0.2 ] } } }');
+SELECT * FROM geo_cell_test.compare('{ "a": 1, "loc": { "$geoWithin": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ 30, 30 ], [ 60, 30 ], [ 60, 50 ], [ 30, 50 ], [ 30, 30 ] ] ] } } } }');
+SELECT * FROM geo_cell_test.compare('{ "a": 2, "loc": { "$geoWithin": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ 120, -20 ], [ 150, -20 ], [ 150, 20 ], [ 120, 20 ], [ 120, -20 ] ] ] } } } }');
+SELECT * FROM geo_cell_test.compare('{ "a": 0, "loc": { "$geoWithin": { "$centerSphere": [ [ -45, -45 ], 0.2 ] } } }');
+SELECT * FROM geo_cell_test.compare('{ "loc": { "$geoIntersects": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ -30, 80 ], [ 30, 80 ], [ 30, 89 ], [ -30, 89 ], [ -30, 80 ] ] ] } } } }');
+SELECT * FROM geo_cell_test.compare('{ "a": 2, "loc": { "$geoIntersects": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ -30, 75 ], [ 30, 75 ], [ 30, 85 ], [ -30, 85 ], [ -30, 75 ] ] ] } } } }');
+SELECT * FROM geo_cell_test.compare('{ "loc": { "$geoIntersects": { "$geometry": { "type": "LineString", "coordinates": [ [ 130, -10 ], [ 140, 10 ] ] } } } }');
+SELECT * FROM geo_cell_test.compare('{ "a": 2, "loc": { "$geoIntersects": { "$geometry": { "type": "Point", "coordinates": [ 45, 0 ] } } } }');
+SELECT * FROM geo_cell_test.compare('{ "a": 2, "loc": { "$geoIntersects": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ 160, -89 ], [ -160, -89 ], [ -160, -80 ], [ 160, -80 ], [ 160, -89 ] ] ] } } } }');
+
+-- The $geoNear range check matches the same documents as with the GIST index
+SELECT * FROM geo_cell_test.compare_geonear_range('{ "type": "Point", "coordinates": [ 45, 0 ] }', 500000);
+SELECT * FROM geo_cell_test.compare_geonear_range('{ "type": "Point", "coordinates": [ 135, 35.26 ] }', 300000);
+SELECT * FROM geo_cell_test.compare_geonear_range('{ "type": "Point", "coordinates": [ 0, 90 ] }', 1000000);
+SELECT * FROM geo_cell_test.compare_geonear_range('{ "type": "Point", "coordinates": [ 0, -89.9 ] }', 200000);
+SELECT * FROM geo_cell_test.compare_geonear_range('{ "type": "Point", "coordinates": [ 180, 0 ] }', 1700000);
+
+-- A single scan of the compound index serves the equality and the geospatial predicates
+SELECT * FROM geo_cell_test.explain('{ "a": 1, "loc": { "$geoWithin": { "$centerSphere": [ [ 45, 0 ], 0.1 ] } } }');
+SELECT * FROM geo_cell_test.explain('{ "a": 2, "loc": { "$geoIntersects": { "$geometry": { "type": "Polygon", "coordinates": [ [ [ -30, 75 ], [ 30, 75 ], [ 30, 85 ], [ -30, 85 ], [ -30, 75 ] ] ] } } } }');
+
+SELECT documentdb_api.drop_collection('geo_cell_db', 'cell');
+SELECT documentdb_api.drop_collection('geo_cell_db', 'gist');
+DROP SCHEMA geo_cell_test CASCADE;
@@ -0,0 +1,52 @@
+SET search_path TO documentdb_api_catalog, documentdb_core;
+SET documentdb.next_collection_id TO 16100;
+SET documentdb.next_collection_index_id TO 16100;
+
+CREATE SCHEMA presized_writer_test;
+
+-- A counter of bson_writer_allocation_stats()
+CREATE FUNCTION presized_writer_test.counter(p_counter text) RETURNS int8 AS
+$$
+    SELECT (documentdb_core.bson_writer_allocation_stats()::text::jsonb -> p_counter ->> '$numberLong')::int8;
+$$ LANGUAGE sql VOLATILE;
+
+-- Runs a pipeline and returns the rows it returns and how much each writer counter grew meanwhile
+CREATE FUNCTION presized_writer_test.run(p_pipeline text, OUT rows int8, OUT presized int8, OUT growths int8, OUT in_place int8) AS
+$$
+    DECLARE
+        v_presized int8 := presized_writer_test.counter('presizedWriters');
+        v_growths int8 := presized_writer_test.counter('presizedBufferGrowths');
+        v_in_place int8 := presized_writer_test.counter('finalizedInPlace');
+    BEGIN
+        SELECT COUNT(document) INTO rows FROM bson_aggregation_pipeline('presized_writer_db',
+            FORMAT('{ "aggregate": "coll", "pipeline": %s, "cursor": {} }', p_pipeline)::bson);
+        presized := presized_writer_test.counter('presizedWriters') - v_presized;
+        growths := presized_writer_test.counter('presizedBufferGrowths') - v_growths;
+        in_place := presized_writer_test.counter('finalizedInPlace') - v_in_place;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Documents of the same shape, and a last one much larger than the others
+SELECT COUNT(documentdb_api.insert_one('presized_writer_db', 'coll', FORMAT('{ "_id": %s, "a": "value", "b": %s }', i, i)::bson))
+FROM generate_series(1, 10) i;
+SELECT documentdb_api.insert_one('presized_writer_db', 'coll', FORMAT('{ "_id": 11, "a": "%s", "b": 11 }', repeat('x', 10000))::bson);
+
+-- Each projected row gets a presized writer that is returned without a copy, the first $addFields row outgrows the size of its source
+SELECT * FROM presized_writer_test.run('[ { "$match": { "_id": { "$lte": 10 } } }, { "$sort": { "_id": 1 } }, { "$project": { "a": 1 } } ]');
+SELECT * FROM presized_writer_test.run('[ { "$match": { "_id": { "$lte": 10 } } }, { "$sort": { "_id": 1 } }, { "$addFields": { "c": "$a" } } ]');
+SELECT * FROM presized_writer_test.run('[ { "$match": { "_id": { "$lte": 10 } } }, { "$sort": { "_id": 1 } }, { "$unset": "b" } ]');
+
+-- The large row is written to a writer presized from the previous row, and grows it
+SELECT * FROM presized_writer_test.run('[ { "$sort": { "_id": 1 } }, { "$project": { "a": 1 } } ]');
+SELECT document FROM bson_aggregation_pipeline('presized_writer_db',
+    '{ "aggregate": "coll", "pipeline": [ { "$sort": { "_id": 1 } }, { "$project": { "a": 1 } }, { "$group": { "_id": null, "n": { "$sum": 1 }, "length": { "$sum": { "$strLenCP": "$a" } } } } ], "cursor": {} }');
+
+-- The same documents are projected with the presized writers disabled
+SET documentdb_core.enablePresizedBsonWriter TO off;
+SELECT * FROM presized_writer_test.run('[ { "$sort": { "_id": 1 } }, { "$project": { "a": 1 } } ]');
+SELECT document FROM bson_aggregation_pipeline('presized_writer_db',
+    '{ "aggregate": "coll", "pipeline": [ { "$sort": { "_id": 1 } }, { "$project": { "a": 1 } }, { "$group": { "_id": null, "n": { "$sum": 1 }, "length": { "$sum": { "$strLenCP": "$a" } } } } ], "cursor": {} }');
+RESET documentdb_core.enablePresizedBsonWriter;
+
+SELECT documentdb_api.drop_collection('presized_writer_db', 'coll');
+DROP SCHEMA presized_writer_test CASCADE;
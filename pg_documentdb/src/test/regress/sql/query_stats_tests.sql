@@ -0,0 +1,44 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 15600;
+SET documentdb.next_collection_index_id TO 15600;
+
+SELECT documentdb_api.insert_one('querystats_db', 'stats', '{ "_id": 1, "a": 1 }');
+SELECT documentdb_api.insert_one('querystats_db', 'stats', '{ "_id": 2, "a": 2 }');
+SELECT documentdb_api.insert_one('querystats_db', 'stats', '{ "_id": 3, "a": "x" }');
+
+-- Commands are measured when they run with the database and the spec as parameters, as the gateway runs them
+PREPARE stats_find(text, documentdb_core.bson) AS SELECT cursorPage FROM documentdb_api.find_cursor_first_page($1, $2);
+\set queryStats '{ "aggregate": 1, "pipeline": [ { "$queryStats": {} }, { "$match": { "key.queryShape.cmdNs.db": "querystats_db" } }, { "$project": { "_id": 0, "filter": "$key.queryShape.filter", "execCount": "$metrics.execCount", "docsReturned": "$metrics.docsReturned" } }, { "$sort": { "execCount": -1 } } ], "cursor": {} }'
+
+SELECT documentdb_api.query_stats_reset();
+
+-- Nothing is recorded while the feature is off
+EXECUTE stats_find('querystats_db', '{ "find": "stats", "filter": { "a": 1 } }');
+SELECT document FROM bson_aggregation_pipeline('admin', :'queryStats');
+
+-- Executions with different literals share a shape, literals of another type do not
+SET documentdb.enableQueryStats TO on;
+EXECUTE stats_find('querystats_db', '{ "find": "stats", "filter": { "a": 1 } }');
+EXECUTE stats_find('querystats_db', '{ "find": "stats", "filter": { "a": 2 } }');
+EXECUTE stats_find('querystats_db', '{ "find": "stats", "filter": { "a": 5 } }');
+EXECUTE stats_find('querystats_db', '{ "find": "stats", "filter": { "a": "x" } }');
+
+-- $in lists of any length share a shape
+EXECUTE stats_find('querystats_db', '{ "find": "stats", "filter": { "a": { "$in": [ 1, 2 ] } } }');
+EXECUTE stats_find('querystats_db', '{ "find": "stats", "filter": { "a": { "$in": [ 1, 2, 5 ] } } }');
+
+SELECT document FROM bson_aggregation_pipeline('admin', :'queryStats');
+SELECT COUNT(*) AS measured FROM bson_aggregation_pipeline('admin', '{ "aggregate": 1, "pipeline": [ { "$queryStats": {} }, { "$match": { "key.queryShape.cmdNs.db": "querystats_db" } } ], "cursor": {} }')
+    WHERE document @? '{ "queryShapeHash": true }' AND document @? '{ "metrics.totalExecMicros.max": true }' AND document @? '{ "metrics.latestSeenTimestamp": true }';
+
+-- $queryStats only runs on the admin database
+SELECT document FROM bson_aggregation_pipeline('querystats_db', '{ "aggregate": 1, "pipeline": [ { "$queryStats": {} } ], "cursor": {} }');
+SELECT document FROM bson_aggregation_pipeline('admin', '{ "aggregate": 1, "pipeline": [ { "$queryStats": { "transformIdentifiers": {} } } ], "cursor": {} }');
+
+-- The reset discards every shape
+SELECT documentdb_api.query_stats_reset();
+SELECT document FROM bson_aggregation_pipeline('admin', :'queryStats');
+
+RESET documentdb.enableQueryStats;
+DEALLOCATE stats_find;
+SELECT documentdb_api.drop_collection('querystats_db', 'stats');
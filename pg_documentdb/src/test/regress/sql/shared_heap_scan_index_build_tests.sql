@@ -0,0 +1,64 @@
+SET search_path TO documentdb_api_catalog;
+SET documentdb.next_collection_id TO 15700;
+SET documentdb.next_collection_index_id TO 15700;
+
+CREATE SCHEMA shared_index_build_test;
+
+-- Returns the documents found by a filter on the collection whose indexes were built from a shared scan and on
+-- the one whose indexes were built separately, whether the filter used an index, and the number of documents
+-- found in only one of them
+CREATE FUNCTION shared_index_build_test.compare_indexes(p_filter text, OUT rows int8, OUT used_index bool, OUT mismatches int8) AS
+$$
+    DECLARE
+        v_shared text := FORMAT('SELECT document::text AS doc FROM documentdb_api_catalog.bson_aggregation_find(%L, %L)',
+            'shared_build_db', FORMAT('{ "find": "shared", "filter": %s }', p_filter));
+        v_separate text := FORMAT('SELECT document::text AS doc FROM documentdb_api_catalog.bson_aggregation_find(%L, %L)',
+            'shared_build_db', FORMAT('{ "find": "separate", "filter": %s }', p_filter));
+        v_plan json;
+    BEGIN
+        EXECUTE 'EXPLAIN (FORMAT JSON) ' || v_shared INTO v_plan;
+        used_index := v_plan::text LIKE '%"Index Name"%';
+        EXECUTE FORMAT('SELECT COUNT(s.doc), COUNT(*) FILTER (WHERE s.doc IS NULL OR p.doc IS NULL) FROM (%s) s FULL JOIN (%s) p ON s.doc = p.doc',
+            v_shared, v_separate) INTO rows, mismatches;
+    END;
+$$ LANGUAGE plpgsql;
+
+-- Two collections with the same documents, with scalar, nested and array values
+SELECT COUNT(documentdb_api.insert_one('shared_build_db', 'shared',
+    FORMAT('{ "_id": %s, "a": %s, "b": { "c": "v%s" }, "d": [ %s, %s ] }', i, i % 50, i % 13, i % 7, i % 11)::documentdb_core.bson,
+    NULL)) FROM generate_series(1, 2000) i;
+SELECT COUNT(documentdb_api.insert_one('shared_build_db', 'separate',
+    FORMAT('{ "_id": %s, "a": %s, "b": { "c": "v%s" }, "d": [ %s, %s ] }', i, i % 50, i % 13, i % 7, i % 11)::documentdb_core.bson,
+    NULL)) FROM generate_series(1, 2000) i;
+
+-- The indexes of one createIndexes are built from a single scan, a partial index is still built by its own scan
+SET documentdb.enableSharedHeapScanIndexBuild TO on;
+SELECT documentdb_api_internal.create_indexes_non_concurrently('shared_build_db', '{ "createIndexes": "shared", "indexes": [ { "key": { "a": 1 }, "name": "a_1" }, { "key": { "b.c": 1, "a": 1 }, "name": "b_c_1_a_1" }, { "key": { "d": 1 }, "name": "d_1" }, { "key": { "a": 1, "d": 1 }, "name": "a_1_d_1", "partialFilterExpression": { "a": { "$gt": 20 } } } ] }', true);
+
+-- The same indexes built one at a time
+SET documentdb.enableSharedHeapScanIndexBuild TO off;
+SELECT documentdb_api_internal.create_indexes_non_concurrently('shared_build_db', '{ "createIndexes": "separate", "indexes": [ { "key": { "a": 1 }, "name": "a_1" } ] }', true);
+SELECT documentdb_api_internal.create_indexes_non_concurrently('shared_build_db', '{ "createIndexes": "separate", "indexes": [ { "key": { "b.c": 1, "a": 1 }, "name": "b_c_1_a_1" } ] }', true);
+SELECT documentdb_api_internal.create_indexes_non_concurrently('shared_build_db', '{ "createIndexes": "separate", "indexes": [ { "key": { "d": 1 }, "name": "d_1" } ] }', true);
+SELECT documentdb_api_internal.create_indexes_non_concurrently('shared_build_db', '{ "createIndexes": "separate", "indexes": [ { "key": { "a": 1, "d": 1 }, "name": "a_1_d_1", "partialFilterExpression": { "a": { "$gt": 20 } } } ] }', true);
+
+-- The indexes find the same documents
+SET enable_seqscan TO off;
+SELECT * FROM shared_index_build_test.compare_indexes('{ "a": { "$gte": 10, "$lt": 20 } }');
+SELECT * FROM shared_index_build_test.compare_indexes('{ "b.c": "v3", "a": { "$lt": 5 } }');
+SELECT * FROM shared_index_build_test.compare_indexes('{ "b.c": { "$gte": "v5" } }');
+SELECT * FROM shared_index_build_test.compare_indexes('{ "d": 5 }');
+SELECT * FROM shared_index_build_test.compare_indexes('{ "d": { "$in": [ 0, 10 ] } }');
+SELECT * FROM shared_index_build_test.compare_indexes('{ "a": { "$gt": 20 }, "d": 3 }');
+
+-- The indexes built from the shared scan are maintained by later writes
+SELECT documentdb_api.insert_one('shared_build_db', 'shared', '{ "_id": 5000, "a": 15, "b": { "c": "v5" }, "d": [ 5 ] }');
+SELECT documentdb_api.insert_one('shared_build_db', 'separate', '{ "_id": 5000, "a": 15, "b": { "c": "v5" }, "d": [ 5 ] }');
+SELECT * FROM shared_index_build_test.compare_indexes('{ "a": { "$gte": 10, "$lt": 20 } }');
+SELECT * FROM shared_index_build_test.compare_indexes('{ "d": 5 }');
+RESET enable_seqscan;
+
+RESET documentdb.enableSharedHeapScanIndexBuild;
+SELECT documentdb_api.drop_collection('shared_build_db', 'shared');
+SELECT documentdb_api.drop_collection('shared_build_db', 'separate');
+DROP SCHEMA shared_index_build_test CASCADE;
@@ -33,6 +33,11 @@ for validationFile in $(ls $check_directory/expected/*.out); do
         continue;
     fi;
 
+    # skip the alternate outputs of a test (e.g. for builds without an optional library)
+    if [[ "$fileNameBase" =~ _[0-9]+$ ]] && [ -f "$check_directory/expected/${fileNameBase%_*}.out" ]; then
+        continue;
+    fi;
+
     if [[ $validationExceptions =~ $sqlExceptionStr ]]; then
         continue;
     fi;
@@ -28,6 +28,8 @@
 #include "utils/version_utils.h"
 #include "aggregation/bson_query.h"
 #include "commands/commands_common.h"
+#include "metadata/collection_compression.h"
+#include "metadata/collection_field_dictionary.h"
 
 #include "api_hooks.h"
 #include "api_hooks_def.h"
@@ -211,7 +213,9 @@ bson_update_document(PG_FUNCTION_ARGS)
 							   "cannot be NULL")));
 	}
 
-	pgbson *sourceDocument = PG_GETARG_PGBSON(0);
+	pgbson *storedSourceDocument = PG_GETARG_PGBSON(0);
+	pgbson *encodedSourceDocument = DecompressStoredDocument(storedSourceDocument);
+	pgbson *sourceDocument = DecodeStoredDocument(encodedSourceDocument);
 	pgbson *updateSpecDoc = PG_GETARG_PGBSON(1);
 	pgbson *querySpecDoc = PG_GETARG_PGBSON(2);
 	pgbson *arrayFiltersDoc = PG_GETARG_MAYBE_NULL_PGBSON(3);
@@ -275,6 +279,13 @@ bson_update_document(PG_FUNCTION_ARGS)
 										  &updateSpecElement.bsonValue, metadata);
 	}
 
+	if (document != NULL)
+	{
+		/* Keep documents stored encoded or compressed that way */
+		document = EncodeUpdatedDocumentLike(document, encodedSourceDocument);
+		document = CompressUpdatedDocumentLike(document, storedSourceDocument);
+	}
+
 	if (callerIsUpdateBsonDocument)
 	{
 		if (document != NULL)
@@ -0,0 +1,363 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/utils/query_shape.c
+ *
+ * Builds the normalized shape of a command: the command fields that
+ * determine how it executes (filter, sort, projection, pipeline, ...) with
+ * every literal replaced by a placeholder of its type, so that executions of
+ * the same query with different values share a shape.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+
+#include "io/bson_core.h"
+#include "io/bsonvalue_utils.h"
+#include "utils/query_shape.h"
+
+/* The most fields of a command that are part of its shape */
+#define MAX_SHAPE_FIELDS 8
+
+/*
+ * The fields of a command that make up its shape. For write commands the
+ * shape is built from the first statement of the statements array.
+ */
+typedef struct CommandShapeFields
+{
+	const char *commandName;
+	const char *fields[MAX_SHAPE_FIELDS];
+	const char *statementsField;
+	const char *statementFields[MAX_SHAPE_FIELDS];
+} CommandShapeFields;
+
+static const CommandShapeFields CommandShapes[] = {
+	{
+		.commandName = "find",
+		.fields = {
+			"filter", "sort", "projection", "hint", "skip", "limit", "collation"
+		}
+	},
+	{
+		.commandName = "aggregate",
+		.fields = { "pipeline", "hint", "collation", "let" }
+	},
+	{
+		.commandName = "count",
+		.fields = { "query", "hint", "skip", "limit", "collation" }
+	},
+	{
+		.commandName = "distinct",
+		.fields = { "key", "query", "hint", "collation" }
+	},
+	{
+		.commandName = "findAndModify",
+		.fields = {
+			"query", "sort", "update", "remove", "new", "upsert", "fields",
+			"hint"
+		}
+	},
+	{
+		.commandName = "update",
+		.statementsField = "updates",
+		.statementFields = { "q", "u", "multi", "upsert", "hint", "collation" }
+	},
+	{
+		.commandName = "delete",
+		.statementsField = "deletes",
+		.statementFields = { "q", "limit", "hint", "collation" }
+	},
+};
+
+static const int CommandShapesCount = sizeof(CommandShapes) /
+									  sizeof(CommandShapeFields);
+
+/*
+ * Command fields whose values are kept as is: they name fields or select
+ * options rather than carry values.
+ */
+static const char *VerbatimFields[] = {
+	"sort", "projection", "fields", "hint", "key", "collation", "multi",
+	"upsert", "remove", "new"
+};
+
+/*
+ * Aggregation stages whose specs are kept as is for the same reason.
+ */
+static const char *VerbatimStages[] = {
+	"$sort", "$project", "$unset", "$count", "$unwind", "$sortByCount"
+};
+
+
+static void WriteShapeFields(pgbson_writer *writer, bson_iter_t *commandIter,
+							 const char *const *fields);
+static void WriteNormalizedValue(pgbson_writer *writer, const char *key,
+								 uint32_t keyLength, const bson_value_t *value);
+static void WriteNormalizedArray(pgbson_writer *writer, const char *key,
+								 uint32_t keyLength, const bson_value_t *value);
+static bool IsStringInList(const char *value, const char **list, int listLength);
+
+
+/*
+ * Builds the shape of the command commandName with the given spec run on
+ * databaseName.
+ */
+void
+BuildQueryShape(const char *databaseName, const char *commandName,
+				pgbson *commandSpec, QueryShape *queryShape)
+{
+	memset(queryShape, 0, sizeof(QueryShape));
+	queryShape->commandName = commandName;
+
+	bson_iter_t commandIter;
+	PgbsonInitIterator(commandSpec, &commandIter);
+	if (bson_iter_next(&commandIter) && BSON_ITER_HOLDS_UTF8(&commandIter))
+	{
+		queryShape->collectionName = pstrdup(bson_iter_utf8(&commandIter, NULL));
+	}
+	else if (PgbsonInitIteratorAtPath(commandSpec, "collection", &commandIter) &&
+			 BSON_ITER_HOLDS_UTF8(&commandIter))
+	{
+		/* getMore names its collection in a separate field */
+		queryShape->collectionName = pstrdup(bson_iter_utf8(&commandIter, NULL));
+	}
+
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+
+	pgbson_writer namespaceWriter;
+	PgbsonWriterStartDocument(&writer, "cmdNs", 5, &namespaceWriter);
+	PgbsonWriterAppendUtf8(&namespaceWriter, "db", 2, databaseName);
+	if (queryShape->collectionName != NULL)
+	{
+		PgbsonWriterAppendUtf8(&namespaceWriter, "coll", 4,
+							   queryShape->collectionName);
+	}
+	PgbsonWriterEndDocument(&writer, &namespaceWriter);
+
+	PgbsonWriterAppendUtf8(&writer, "command", 7, commandName);
+
+	const CommandShapeFields *commandShape = NULL;
+	for (int i = 0; i < CommandShapesCount; i++)
+	{
+		if (strcmp(CommandShapes[i].commandName, commandName) == 0)
+		{
+			commandShape = &CommandShapes[i];
+			break;
+		}
+	}
+
+	if (commandShape != NULL && commandShape->statementsField == NULL)
+	{
+		PgbsonInitIterator(commandSpec, &commandIter);
+		WriteShapeFields(&writer, &commandIter, commandShape->fields);
+	}
+	else if (commandShape != NULL &&
+			 PgbsonInitIteratorAtPath(commandSpec, commandShape->statementsField,
+									  &commandIter) &&
+			 BSON_ITER_HOLDS_ARRAY(&commandIter))
+	{
+		bson_iter_t statementsIter;
+		bson_iter_recurse(&commandIter, &statementsIter);
+		if (bson_iter_next(&statementsIter) &&
+			BSON_ITER_HOLDS_DOCUMENT(&statementsIter))
+		{
+			bson_iter_t statementIter;
+			bson_iter_recurse(&statementsIter, &statementIter);
+			WriteShapeFields(&writer, &statementIter, commandShape->statementFields);
+		}
+	}
+
+	queryShape->shape = PgbsonWriterGetPgbson(&writer);
+
+	bson_value_t shapeValue = ConvertPgbsonToBsonValue(queryShape->shape);
+	queryShape->shapeHash = (uint64) BsonValueHash(&shapeValue, 0);
+}
+
+
+/*
+ * Formats a shape hash the way it is reported to users.
+ */
+char *
+QueryShapeHashToString(uint64 shapeHash)
+{
+	return psprintf("%016llX", (unsigned long long) shapeHash);
+}
+
+
+/*
+ * Writes the normalized values of the given fields of the command, in the
+ * order they appear in the command.
+ */
+static void
+WriteShapeFields(pgbson_writer *writer, bson_iter_t *commandIter,
+				 const char *const *fields)
+{
+	while (bson_iter_next(commandIter))
+	{
+		const char *key = bson_iter_key(commandIter);
+		bool isShapeField = false;
+		for (int i = 0; i < MAX_SHAPE_FIELDS && fields[i] != NULL; i++)
+		{
+			if (strcmp(fields[i], key) == 0)
+			{
+				isShapeField = true;
+				break;
+			}
+		}
+
+		if (!isShapeField)
+		{
+			continue;
+		}
+
+		uint32_t keyLength = bson_iter_key_len(commandIter);
+		if (IsStringInList(key, VerbatimFields, lengthof(VerbatimFields)))
+		{
+			PgbsonWriterAppendValue(writer, key, keyLength,
+									bson_iter_value(commandIter));
+		}
+		else
+		{
+			WriteNormalizedValue(writer, key, keyLength, bson_iter_value(commandIter));
+		}
+	}
+}
+
+
+/*
+ * Writes the value with its literals replaced by "?<type>" placeholders.
+ * Field paths and variables ("$a", "$$ROOT") are kept since they are part of
+ * the query rather than values.
+ */
+static void
+WriteNormalizedValue(pgbson_writer *writer, const char *key, uint32_t keyLength,
+					 const bson_value_t *value)
+{
+	switch (value->value_type)
+	{
+		case BSON_TYPE_DOCUMENT:
+		{
+			pgbson_writer childWriter;
+			PgbsonWriterStartDocument(writer, key, keyLength, &childWriter);
+
+			bson_iter_t documentIter;
+			BsonValueInitIterator(value, &documentIter);
+			while (bson_iter_next(&documentIter))
+			{
+				const char *childKey = bson_iter_key(&documentIter);
+				uint32_t childKeyLength = bson_iter_key_len(&documentIter);
+				if (IsStringInList(childKey, VerbatimStages, lengthof(VerbatimStages)))
+				{
+					PgbsonWriterAppendValue(&childWriter, childKey, childKeyLength,
+											bson_iter_value(&documentIter));
+				}
+				else
+				{
+					WriteNormalizedValue(&childWriter, childKey, childKeyLength,
+										 bson_iter_value(&documentIter));
+				}
+			}
+
+			PgbsonWriterEndDocument(writer, &childWriter);
+			break;
+		}
+
+		case BSON_TYPE_ARRAY:
+		{
+			WriteNormalizedArray(writer, key, keyLength, value);
+			break;
+		}
+
+		case BSON_TYPE_UTF8:
+		{
+			if (value->value.v_utf8.len > 0 && value->value.v_utf8.str[0] == '$')
+			{
+				PgbsonWriterAppendValue(writer, key, keyLength, value);
+			}
+			else
+			{
+				PgbsonWriterAppendUtf8(writer, key, keyLength, "?string");
+			}
+
+			break;
+		}
+
+		default:
+		{
+			const char *placeholder = BsonValueIsNumber(value) ? "?number" :
+									  psprintf("?%s", BsonTypeName(value->value_type));
+			PgbsonWriterAppendUtf8(writer, key, keyLength, placeholder);
+			break;
+		}
+	}
+}
+
+
+/*
+ * Arrays of documents ($and, $or, pipelines) are normalized element by
+ * element. Arrays of values ($in lists) collapse to a single placeholder so
+ * that lists of different lengths share a shape.
+ */
+static void
+WriteNormalizedArray(pgbson_writer *writer, const char *key, uint32_t keyLength,
+					 const bson_value_t *value)
+{
+	bool hasDocuments = false;
+	bson_iter_t arrayIter;
+	BsonValueInitIterator(value, &arrayIter);
+	while (bson_iter_next(&arrayIter))
+	{
+		if (BSON_ITER_HOLDS_DOCUMENT(&arrayIter))
+		{
+			hasDocuments = true;
+			break;
+		}
+	}
+
+	if (!hasDocuments)
+	{
+		PgbsonWriterAppendUtf8(writer, key, keyLength, "?array");
+		return;
+	}
+
+	pgbson_array_writer arrayWriter;
+	PgbsonWriterStartArray(writer, key, keyLength, &arrayWriter);
+
+	BsonValueInitIterator(value, &arrayIter);
+	while (bson_iter_next(&arrayIter))
+	{
+		pgbson_element_writer elementWriter;
+		PgbsonInitArrayElementWriter(&arrayWriter, &elementWriter);
+
+		/* Elements are written through a scratch document to reuse the normalization */
+		pgbson_writer elementDocumentWriter;
+		PgbsonWriterInit(&elementDocumentWriter);
+		WriteNormalizedValue(&elementDocumentWriter, "", 0,
+							 bson_iter_value(&arrayIter));
+
+		bson_iter_t elementIter;
+		PgbsonWriterGetIterator(&elementDocumentWriter, &elementIter);
+		if (bson_iter_next(&elementIter))
+		{
+			PgbsonElementWriterWriteValue(&elementWriter, bson_iter_value(&elementIter));
+		}
+	}
+
+	PgbsonWriterEndArray(writer, &arrayWriter);
+}
+
+
+static bool
+IsStringInList(const char *value, const char **list, int listLength)
+{
+	for (int i = 0; i < listLength; i++)
+	{
+		if (strcmp(value, list[i]) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
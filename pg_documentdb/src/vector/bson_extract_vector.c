@@ -29,6 +29,7 @@
 #include "utils/documentdb_errors.h"
 #include "io/bson_core.h"
 #include "metadata/metadata_cache.h"
+#include "metadata/collection_field_dictionary.h"
 #include "vector/bson_extract_vector.h"
 
 /* --------------------------------------------------------- */
@@ -51,7 +52,7 @@ PG_FUNCTION_INFO_V1(command_bson_extract_vector);
 Datum
 command_bson_extract_vector(PG_FUNCTION_ARGS)
 {
-	pgbson *document = PG_GETARG_PGBSON(0);
+	pgbson *document = PG_GETARG_STORED_PGBSON(0);
 	text *path = PG_GETARG_TEXT_P(1);
 
 	bool isNull = false;
@@ -0,0 +1,53 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/io/bson_analyze.h
+ *
+ * Declarations of the per path statistics ANALYZE collects on bson columns.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef BSON_ANALYZE_H
+#define BSON_ANALYZE_H
+
+/*
+ * The pg_statistic kind of the slot holding the per path statistics of a bson
+ * column. The slot's values are bson documents, one per path, sorted by path.
+ * Kinds below 1000 are reserved for Postgres and known extensions.
+ */
+#define STATISTIC_KIND_BSON_PATHS 4301
+
+/*
+ * Fields of the per path statistics document:
+ *
+ * {
+ *   "path": "a.b",
+ *   "existsFrac": <fraction of rows that have the path>,
+ *   "nullFrac": <fraction of rows where the path is null>,
+ *   "arrayFrac": <fraction of rows where the path is an array>,
+ *   "arrayLengths": [ <fraction of arrays of length 0, 1, 2, 3-4, 5-8, ...> ],
+ *   "types": { "<bson type code>": <fraction of rows with a value of the type> },
+ *   "distinct": <number of distinct values, negative if a fraction of the rows>,
+ *   "mcv": [ <most common values> ],
+ *   "mcvFreqs": [ <fraction of rows with each most common value> ],
+ *   "histogram": [ <equi-depth bounds of the other values> ],
+ *   "histogramFrac": <fraction of rows with a value the histogram describes>
+ * }
+ *
+ * Array elements count as values of the array's path, the same way queries
+ * match them.
+ */
+#define BSON_PATH_STATS_PATH "path"
+#define BSON_PATH_STATS_EXISTS_FRAC "existsFrac"
+#define BSON_PATH_STATS_NULL_FRAC "nullFrac"
+#define BSON_PATH_STATS_ARRAY_FRAC "arrayFrac"
+#define BSON_PATH_STATS_ARRAY_LENGTHS "arrayLengths"
+#define BSON_PATH_STATS_TYPES "types"
+#define BSON_PATH_STATS_DISTINCT "distinct"
+#define BSON_PATH_STATS_MCV "mcv"
+#define BSON_PATH_STATS_MCV_FREQS "mcvFreqs"
+#define BSON_PATH_STATS_HISTOGRAM "histogram"
+#define BSON_PATH_STATS_HISTOGRAM_FRAC "histogramFrac"
+
+#endif
@@ -0,0 +1,74 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/io/bson_compression.h
+ *
+ * Compression of stored documents with trained zstd dictionaries.
+ *
+ * A compressed document is stored in the BSON_STORED_FORMAT_COMPRESSED
+ * format (see io/bson_stored_format.h): an empty bson document, followed by
+ * a BsonCompressionHeader, a zstd frame of the document as it was to be
+ * stored (possibly with encoded field names) compressed with the dictionary
+ * the header refers to, and the format byte. Dictionaries are versioned and
+ * immutable, so a document can always be decompressed with the dictionary
+ * version it records.
+ *
+ * Compression needs a PostgreSQL built with zstd (USE_ZSTD).
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef BSON_COMPRESSION_H
+#define BSON_COMPRESSION_H
+
+#include "io/bson_stored_format.h"
+
+/* The header of the payload of a compressed document */
+typedef struct BsonCompressionHeader
+{
+	int64 dictionaryId;
+	uint32 dictionaryVersion;
+	uint32 uncompressedSize;
+} BsonCompressionHeader;
+
+/*
+ * A trained zstd dictionary, digested for compression and decompression. The
+ * zstd objects are freed when the memory context the dictionary was created
+ * in goes away.
+ */
+typedef struct BsonCompressionDictionary
+{
+	int64 dictionaryId;
+	uint32 dictionaryVersion;
+
+	/* ZSTD_CDict and ZSTD_DDict */
+	void *compressionDictionary;
+	void *decompressionDictionary;
+} BsonCompressionDictionary;
+
+bool IsBsonCompressionSupported(void);
+bytea * TrainBsonCompressionDictionary(pgbson **samples, int numSamples,
+									   uint32 maxDictionarySize);
+BsonCompressionDictionary * CreateBsonCompressionDictionary(int64 dictionaryId,
+															uint32 dictionaryVersion,
+															const bytea *dictionary,
+															int compressionLevel);
+
+pgbson * PgbsonCompress(const pgbson *document,
+						const BsonCompressionDictionary *dictionary);
+BsonCompressionHeader PgbsonGetCompressionHeader(const pgbson *compressedDocument);
+pgbson * PgbsonDecompress(const pgbson *compressedDocument,
+						  const BsonCompressionDictionary *dictionary);
+
+
+/*
+ * Whether the stored document is compressed.
+ */
+inline static bool
+PgbsonIsCompressed(const pgbson *document)
+{
+	return PgbsonGetStoredFormat(document) == BSON_STORED_FORMAT_COMPRESSED;
+}
+
+
+#endif
@@ -0,0 +1,79 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/io/bson_field_dictionary.h
+ *
+ * Dictionary encoding of the field names of stored documents.
+ *
+ * A document with encoded field names is stored in the
+ * BSON_STORED_FORMAT_FIELD_NAMES_ENCODED format (see io/bson_stored_format.h):
+ *  - Its bson is the document with its field names encoded:
+ *    - A field name in the dictionary is stored as 0x01 followed by its id.
+ *    - Other field names are stored as is, unless they start with a byte the
+ *      encoding reserves (0x01 or 0x02), in which case they are prefixed by
+ *      0x02.
+ *    - The keys of array elements are never encoded.
+ *  - Its trailer holds the id of the dictionary (int64), the number of
+ *    dictionary entries the document was encoded with (uint32), and the
+ *    format byte.
+ * Ids are written as base 128 digits with the high bit set, least
+ * significant first, so that they never contain '\0' or '.' and an encoded
+ * dotted path can be traversed as usual.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef BSON_FIELD_DICTIONARY_H
+#define BSON_FIELD_DICTIONARY_H
+
+#include <utils/hsearch.h>
+
+#include "io/bson_stored_format.h"
+
+/* Field names shorter than this are not worth a dictionary entry */
+#define BSON_FIELD_DICTIONARY_MIN_NAME_LENGTH 3
+
+/* Keeps every encoded name within 3 bytes plus its terminator */
+#define BSON_FIELD_DICTIONARY_MAX_NAMES (128 * 128)
+
+/*
+ * An append only list of field names. Ids are positions in the list, so a
+ * dictionary that grows still decodes the documents encoded before.
+ */
+typedef struct BsonFieldDictionary
+{
+	int64 dictionaryId;
+	uint32 numNames;
+	char **names;
+
+	/* StringView name -> id */
+	HTAB *nameLookup;
+} BsonFieldDictionary;
+
+BsonFieldDictionary * CreateBsonFieldDictionary(int64 dictionaryId, char **names,
+												uint32 numNames);
+bool IsBsonFieldDictionaryCandidate(const char *name, uint32_t nameLength);
+
+pgbson * PgbsonEncodeFieldNames(const pgbson *document,
+								const BsonFieldDictionary *dictionary);
+int64 PgbsonGetFieldDictionaryId(const pgbson *encodedDocument, uint32 *numNames);
+pgbson * PgbsonExpandFieldNames(const pgbson *encodedDocument,
+								const BsonFieldDictionary *dictionary);
+const char * PgbsonEncodeFieldPath(const pgbson *encodedDocument,
+								   const BsonFieldDictionary *dictionary,
+								   const char *path);
+void PgbsonInitEncodedDocumentIterator(const pgbson *encodedDocument,
+									   bson_iter_t *iterator);
+
+
+/*
+ * Whether a stored document has dictionary encoded field names.
+ */
+inline static bool
+PgbsonIsFieldNameEncoded(const pgbson *document)
+{
+	return PgbsonGetStoredFormat(document) == BSON_STORED_FORMAT_FIELD_NAMES_ENCODED;
+}
+
+
+#endif
@@ -0,0 +1,62 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * include/io/bson_stored_format.h
+ *
+ * The trailer of documents that a collection stores in an encoded format.
+ *
+ * An encoded document is a datum that holds bson bytes followed by a
+ * trailer, whose last byte is the format of the document. The length of the
+ * bson is then less than the length of the datum, which no bson value built
+ * otherwise has: a document written by a user can never be taken for an
+ * encoded one. Readers that do not decode stored documents fail on encoded
+ * ones as they are not valid bson.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef BSON_STORED_FORMAT_H
+#define BSON_STORED_FORMAT_H
+
+/* A plain bson document, without a trailer */
+#define BSON_STORED_FORMAT_PLAIN 0
+
+/* Field names encoded with a dictionary, see io/bson_field_dictionary.h */
+#define BSON_STORED_FORMAT_FIELD_NAMES_ENCODED 1
+
+/* Compressed with a trained dictionary, see io/bson_compression.h */
+#define BSON_STORED_FORMAT_COMPRESSED 2
+
+
+/*
+ * Returns the length of the bson at the start of the document, as per its
+ * length header.
+ */
+inline static uint32_t
+PgbsonGetStoredBsonLength(const pgbson *document)
+{
+	int32_t bsonLength;
+	memcpy(&bsonLength, VARDATA_ANY(document), sizeof(int32_t));
+	return BSON_UINT32_FROM_LE((uint32_t) bsonLength);
+}
+
+
+/*
+ * Returns the format a stored document is encoded in, or
+ * BSON_STORED_FORMAT_PLAIN if it is a plain bson document.
+ */
+inline static uint8_t
+PgbsonGetStoredFormat(const pgbson *document)
+{
+	uint32_t datumLength = VARSIZE_ANY_EXHDR(document);
+	if (datumLength <= sizeof(int32_t) ||
+		PgbsonGetStoredBsonLength(document) >= datumLength)
+	{
+		return BSON_STORED_FORMAT_PLAIN;
+	}
+
+	return ((const uint8_t *) VARDATA_ANY(document))[datumLength - 1];
+}
+
+
+#endif
@@ -21,9 +21,37 @@
 typedef struct
 {
 	bson_t innerBson;
+
+	/*
+	 * Set for writers initialized with PgbsonWriterInitWithSizeHint: the
+	 * bson is written VARHDRSZ bytes into a palloc'd chunk so that it can be
+	 * turned into a pgbson in place.
+	 */
+	uint8_t *buffer;
+	size_t bufferLength;
 } pgbson_writer;
 
 
+/*
+ * Per backend counters of the allocations done by pgbson writers.
+ */
+typedef struct PgbsonWriterAllocationStats
+{
+	/* Writers initialized with a size hint */
+	uint64 presizedWriters;
+
+	/* Times a presized writer outgrew its buffer */
+	uint64 presizedBufferGrowths;
+
+	/* Writers finalized without copying the document */
+	uint64 finalizedInPlace;
+
+	/* Writers finalized by copying the document, and the bytes copied */
+	uint64 finalizedWithCopy;
+	uint64 bytesCopied;
+} PgbsonWriterAllocationStats;
+
+
 /*
  * bson writer on heap interface
  * Note - This needs to be destroyed after usage
@@ -62,6 +90,8 @@ typedef struct pgbson_element_writer
 
 
 void PgbsonWriterInit(pgbson_writer *writer);
+void PgbsonWriterInitWithSizeHint(pgbson_writer *writer, uint32_t sizeHint);
+const PgbsonWriterAllocationStats * GetPgbsonWriterAllocationStats(void);
 uint32_t PgbsonWriterGetSize(pgbson_writer *writer);
 uint32_t PgbsonArrayWriterGetSize(pgbson_array_writer *writer);
 void PgbsonWriterCopyToBuffer(pgbson_writer *writer, uint8_t *buffer, uint32_t length);
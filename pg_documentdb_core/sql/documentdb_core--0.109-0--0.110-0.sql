@@ -0,0 +1 @@
+#include "udfs/bson_io/bson_writer_allocation_stats--0.110-0.sql"
\ No newline at end of file
@@ -0,0 +1,5 @@
+CREATE OR REPLACE FUNCTION __CORE_SCHEMA__.bson_writer_allocation_stats()
+ RETURNS __CORE_SCHEMA__.bson
+ LANGUAGE c
+ VOLATILE PARALLEL SAFE STRICT
+AS 'MODULE_PATHNAME', $function$bson_writer_allocation_stats$function$;
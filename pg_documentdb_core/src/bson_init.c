@@ -45,6 +45,14 @@ bool EnableCollation = DEFAULT_ENABLE_COLLATION;
 #define DEFAULT_SKIP_BSON_ARRAY_TRAVERSE_OPTIMIZATION false
 bool SkipBsonArrayTraverseOptimization = DEFAULT_SKIP_BSON_ARRAY_TRAVERSE_OPTIMIZATION;
 
+/* GUC deciding whether ANALYZE collects per path statistics on bson columns */
+#define DEFAULT_ENABLE_BSON_PATH_STATISTICS false
+bool EnableBsonPathStatistics = DEFAULT_ENABLE_BSON_PATH_STATISTICS;
+
+/* GUC deciding whether per row writers presize their buffer and skip the final copy */
+#define DEFAULT_ENABLE_PRESIZED_BSON_WRITER true
+bool EnablePresizedBsonWriter = DEFAULT_ENABLE_PRESIZED_BSON_WRITER;
+
 /* --------------------------------------------------------- */
 /* Top level exports */
 /* --------------------------------------------------------- */
@@ -91,6 +99,22 @@ InitDocumentDBCoreConfigurations(const char *prefix)
 		NULL, &SkipBsonArrayTraverseOptimization,
 		DEFAULT_SKIP_BSON_ARRAY_TRAVERSE_OPTIMIZATION,
 		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enableBsonPathStatistics", prefix),
+		gettext_noop(
+			"Determines whether ANALYZE collects per path statistics on bson columns."),
+		NULL, &EnableBsonPathStatistics,
+		DEFAULT_ENABLE_BSON_PATH_STATISTICS,
+		PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enablePresizedBsonWriter", prefix),
+		gettext_noop(
+			"Determines whether per row bson writers are presized from the previous row and finalized without a copy."),
+		NULL, &EnablePresizedBsonWriter,
+		DEFAULT_ENABLE_PRESIZED_BSON_WRITER,
+		PGC_USERSET, 0, NULL, NULL, NULL);
 }
 
 
@@ -11,19 +11,805 @@
 
 #include <postgres.h>
 #include <fmgr.h>
+#include <miscadmin.h>
+#include <math.h>
 #include <commands/vacuum.h>
+#include <port/pg_bitutils.h>
+#include <utils/hsearch.h>
+#include <utils/memutils.h>
+
+#include "io/bson_core.h"
+#include "io/bson_analyze.h"
+#include "query/bson_compare.h"
+
+extern bool EnableBsonPathStatistics;
+
+/* Paths longer than this are not tracked */
+#define BSON_PATH_STATS_MAX_PATH_LENGTH 128
+
+/* The number of distinct paths tracked while sampling */
+#define BSON_PATH_STATS_MAX_TRACKED_PATHS 256
+
+/* The number of paths (the most frequent ones) whose statistics are stored */
+#define BSON_PATH_STATS_MAX_PATHS 64
+
+/* Nesting depth of the documents and arrays that are walked */
+#define BSON_PATH_STATS_MAX_DEPTH 8
+
+/* Strings longer than this are counted, but not sampled for MCVs and histograms */
+#define BSON_PATH_STATS_MAX_STRING_LENGTH 1024
+
+/* Array lengths 0, 1, 2, 3-4, 5-8, 9-16, 17-32 and 33+ */
+#define BSON_PATH_STATS_NUM_ARRAY_LENGTH_BUCKETS 8
+
+/* Bson types double (0x01) to decimal128 (0x13), minKey and maxKey */
+#define BSON_PATH_STATS_NUM_TYPES 21
+
+
+/*
+ * The analyze data of the standard statistics that the bson statistics
+ * wrap around.
+ */
+typedef struct BsonAnalyzeData
+{
+	AnalyzeAttrComputeStatsFunc stdComputeStats;
+	void *stdExtraData;
+} BsonAnalyzeData;
+
+
+/*
+ * A value sampled at a path along with the sample row it came from.
+ */
+typedef struct PathSampleValue
+{
+	bson_value_t value;
+	int rowIndex;
+} PathSampleValue;
+
+
+/*
+ * The statistics gathered for a path over the sample rows.
+ */
+typedef struct PathStatsEntry
+{
+	/* The dotted path, this is the hash key and must be the first field */
+	char path[BSON_PATH_STATS_MAX_PATH_LENGTH];
+
+	/* Number of rows the path exists in, is null in and is an array in */
+	int rowCount;
+	int nullCount;
+	int arrayCount;
+
+	/* The last row counted in each of the counts above */
+	int lastRow;
+	int lastNullRow;
+	int lastArrayRow;
+
+	int arrayLengthCounts[BSON_PATH_STATS_NUM_ARRAY_LENGTH_BUCKETS];
+
+	/* Number of rows with a value of each type */
+	int typeCounts[BSON_PATH_STATS_NUM_TYPES];
+	int typeLastRow[BSON_PATH_STATS_NUM_TYPES];
+
+	/* The scalar values sampled at the path */
+	PathSampleValue *values;
+	int numValues;
+	int maxValues;
+} PathStatsEntry;
+
+
+typedef struct PathStatsContext
+{
+	HTAB *paths;
+	int numPaths;
+
+	/* Upper bound on the values sampled per path */
+	int maxValuesPerPath;
+
+	/* The path of the field being visited */
+	StringInfoData currentPath;
+} PathStatsContext;
+
+
+/*
+ * A run of equal values in the sorted sample of a path.
+ */
+typedef struct PathValueGroup
+{
+	int start;
+	int numValues;
+	int numRows;
+	bool isMostCommon;
+} PathValueGroup;
+
+
+static void ComputeBsonStats(VacAttrStatsP stats, AnalyzeAttrFetchFunc fetchfunc,
+							 int samplerows, double totalrows);
+static void ComputeBsonPathStats(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfunc,
+								 int samplerows, double totalrows);
+static void CollectDocumentPaths(bson_iter_t *documentIter, PathStatsContext *context,
+								 int rowIndex, int depth);
+static PathStatsEntry * GetPathStatsEntry(PathStatsContext *context, const char *path);
+static void RecordPathValue(PathStatsContext *context, PathStatsEntry *entry,
+							const bson_value_t *value, int rowIndex, bool isFieldValue);
+static pgbson * BuildPathStatsDocument(PathStatsEntry *entry, int samplerows,
+									   double totalrows, int statisticsTarget);
+static int ComparePathSampleValues(const void *left, const void *right);
+static int ComparePathStatsByRowCount(const void *left, const void *right);
+static int ComparePathStatsByPath(const void *left, const void *right);
+static int ComparePathValueGroupsByRows(const void *left, const void *right);
+
 
 PG_FUNCTION_INFO_V1(bson_typanalyze);
 
 
 /*
  * Implement type analyze for bson.
- * Right now thunks to the default - but in the future
- * will be extended to support more.
+ * The standard statistics of the document as a whole are computed as before,
+ * on top of which per path statistics are collected from the same sample
+ * when enabled.
  */
 Datum
 bson_typanalyze(PG_FUNCTION_ARGS)
 {
 	VacAttrStats *stats = (VacAttrStats *) PG_GETARG_POINTER(0);
-	PG_RETURN_BOOL(std_typanalyze(stats));
+	if (!std_typanalyze(stats))
+	{
+		PG_RETURN_BOOL(false);
+	}
+
+	if (EnableBsonPathStatistics)
+	{
+		BsonAnalyzeData *analyzeData = palloc0(sizeof(BsonAnalyzeData));
+		analyzeData->stdComputeStats = stats->compute_stats;
+		analyzeData->stdExtraData = stats->extra_data;
+		stats->compute_stats = ComputeBsonStats;
+		stats->extra_data = analyzeData;
+	}
+
+	PG_RETURN_BOOL(true);
+}
+
+
+/*
+ * Runs the standard statistics and then adds the per path statistics in the next
+ * free slot.
+ */
+static void
+ComputeBsonStats(VacAttrStatsP stats, AnalyzeAttrFetchFunc fetchfunc, int samplerows,
+				 double totalrows)
+{
+	BsonAnalyzeData *analyzeData = (BsonAnalyzeData *) stats->extra_data;
+
+	/* The standard functions expect their own extra data */
+	stats->extra_data = analyzeData->stdExtraData;
+	analyzeData->stdComputeStats(stats, fetchfunc, samplerows, totalrows);
+
+	if (stats->stats_valid)
+	{
+		ComputeBsonPathStats(stats, fetchfunc, samplerows, totalrows);
+	}
+
+	stats->extra_data = analyzeData;
+}
+
+
+/*
+ * Walks the sample documents and stores the statistics of the most frequent paths
+ * as bson documents in a STATISTIC_KIND_BSON_PATHS slot.
+ */
+static void
+ComputeBsonPathStats(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfunc,
+					 int samplerows, double totalrows)
+{
+	int slot = 0;
+	while (slot < STATISTIC_NUM_SLOTS && stats->stakind[slot] != 0)
+	{
+		slot++;
+	}
+
+	if (slot == STATISTIC_NUM_SLOTS || samplerows <= 0)
+	{
+		return;
+	}
+
+	HASHCTL hashInfo;
+	memset(&hashInfo, 0, sizeof(HASHCTL));
+	hashInfo.keysize = BSON_PATH_STATS_MAX_PATH_LENGTH;
+	hashInfo.entrysize = sizeof(PathStatsEntry);
+	hashInfo.hcxt = CurrentMemoryContext;
+
+	PathStatsContext context;
+	memset(&context, 0, sizeof(PathStatsContext));
+	context.paths = hash_create("Bson path statistics", BSON_PATH_STATS_MAX_TRACKED_PATHS,
+								&hashInfo, HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+	context.maxValuesPerPath = 2 * samplerows;
+	initStringInfo(&context.currentPath);
+
+	for (int rowIndex = 0; rowIndex < samplerows; rowIndex++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		bool isNull;
+		Datum value = fetchfunc(stats, rowIndex, &isNull);
+		if (isNull)
+		{
+			continue;
+		}
+
+		pgbson *document = DatumGetPgBson(value);
+
+		bson_iter_t documentIter;
+		PgbsonInitIterator(document, &documentIter);
+		resetStringInfo(&context.currentPath);
+		CollectDocumentPaths(&documentIter, &context, rowIndex, 0);
+
+		if ((Pointer) document != DatumGetPointer(value))
+		{
+			pfree(document);
+		}
+	}
+
+	if (context.numPaths == 0)
+	{
+		hash_destroy(context.paths);
+		return;
+	}
+
+	PathStatsEntry **entries = palloc(context.numPaths * sizeof(PathStatsEntry *));
+	int numEntries = 0;
+
+	HASH_SEQ_STATUS status;
+	PathStatsEntry *entry;
+	hash_seq_init(&status, context.paths);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		entries[numEntries++] = entry;
+	}
+
+	/* Keep the most frequent paths, sorted by path for lookups */
+	qsort(entries, numEntries, sizeof(PathStatsEntry *), ComparePathStatsByRowCount);
+	numEntries = Min(numEntries, BSON_PATH_STATS_MAX_PATHS);
+	qsort(entries, numEntries, sizeof(PathStatsEntry *), ComparePathStatsByPath);
+
+#if PG_VERSION_NUM >= 170000
+	int statisticsTarget = stats->attstattarget;
+#else
+	int statisticsTarget = stats->attr->attstattarget < 0 ?
+						   default_statistics_target :
+						   stats->attr->attstattarget;
+#endif
+
+	/* The statistics must survive past the per column context */
+	MemoryContext oldContext = MemoryContextSwitchTo(stats->anl_context);
+	Datum *pathStats = palloc(numEntries * sizeof(Datum));
+	for (int i = 0; i < numEntries; i++)
+	{
+		pathStats[i] = PointerGetDatum(
+			BuildPathStatsDocument(entries[i], samplerows, totalrows,
+								   statisticsTarget));
+	}
+	MemoryContextSwitchTo(oldContext);
+
+	stats->stakind[slot] = STATISTIC_KIND_BSON_PATHS;
+	stats->staop[slot] = InvalidOid;
+	stats->stacoll[slot] = InvalidOid;
+	stats->stavalues[slot] = pathStats;
+	stats->numvalues[slot] = numEntries;
+	stats->statypid[slot] = stats->attrtypid;
+	stats->statyplen[slot] = stats->attrtype->typlen;
+	stats->statypbyval[slot] = stats->attrtype->typbyval;
+	stats->statypalign[slot] = stats->attrtype->typalign;
+
+	hash_destroy(context.paths);
+	pfree(entries);
+}
+
+
+/*
+ * Records the fields of a document (and of the documents nested in it) against their
+ * dotted paths. Elements of arrays are recorded against the path of the array and
+ * documents in arrays contribute to the paths below it, same as query paths match.
+ */
+static void
+CollectDocumentPaths(bson_iter_t *documentIter, PathStatsContext *context, int rowIndex,
+					 int depth)
+{
+	StringInfo currentPath = &context->currentPath;
+	int prefixLength = currentPath->len;
+	while (bson_iter_next(documentIter))
+	{
+		currentPath->len = prefixLength;
+		currentPath->data[prefixLength] = '\0';
+		if (prefixLength > 0)
+		{
+			appendStringInfoChar(currentPath, '.');
+		}
+
+		appendStringInfoString(currentPath, bson_iter_key(documentIter));
+		if (currentPath->len >= BSON_PATH_STATS_MAX_PATH_LENGTH)
+		{
+			continue;
+		}
+
+		PathStatsEntry *entry = GetPathStatsEntry(context, currentPath->data);
+		const bson_value_t *value = bson_iter_value(documentIter);
+		if (entry != NULL)
+		{
+			RecordPathValue(context, entry, value, rowIndex, true);
+		}
+
+		if (depth >= BSON_PATH_STATS_MAX_DEPTH)
+		{
+			continue;
+		}
+
+		if (value->value_type == BSON_TYPE_DOCUMENT)
+		{
+			bson_iter_t childIter;
+			if (bson_iter_recurse(documentIter, &childIter))
+			{
+				CollectDocumentPaths(&childIter, context, rowIndex, depth + 1);
+			}
+		}
+		else if (value->value_type == BSON_TYPE_ARRAY)
+		{
+			int fieldPathLength = currentPath->len;
+			bson_iter_t arrayIter;
+			if (!bson_iter_recurse(documentIter, &arrayIter))
+			{
+				continue;
+			}
+
+			while (bson_iter_next(&arrayIter))
+			{
+				const bson_value_t *element = bson_iter_value(&arrayIter);
+				if (entry != NULL)
+				{
+					RecordPathValue(context, entry, element, rowIndex, false);
+				}
+
+				bson_iter_t childIter;
+				if (element->value_type == BSON_TYPE_DOCUMENT &&
+					bson_iter_recurse(&arrayIter, &childIter))
+				{
+					CollectDocumentPaths(&childIter, context, rowIndex, depth + 1);
+					currentPath->len = fieldPathLength;
+					currentPath->data[fieldPathLength] = '\0';
+				}
+			}
+		}
+	}
+
+	currentPath->len = prefixLength;
+	currentPath->data[prefixLength] = '\0';
+}
+
+
+/*
+ * Returns the statistics entry of a path, or NULL if the path isn't tracked
+ * because enough other paths were found first.
+ */
+static PathStatsEntry *
+GetPathStatsEntry(PathStatsContext *context, const char *path)
+{
+	bool found = false;
+	PathStatsEntry *entry = hash_search(context->paths, path, HASH_FIND, &found);
+	if (found)
+	{
+		return entry;
+	}
+
+	if (context->numPaths >= BSON_PATH_STATS_MAX_TRACKED_PATHS)
+	{
+		return NULL;
+	}
+
+	entry = hash_search(context->paths, path, HASH_ENTER, &found);
+	memset(((char *) entry) + BSON_PATH_STATS_MAX_PATH_LENGTH, 0,
+		   sizeof(PathStatsEntry) - BSON_PATH_STATS_MAX_PATH_LENGTH);
+	entry->lastRow = entry->lastNullRow = entry->lastArrayRow = -1;
+	for (int i = 0; i < BSON_PATH_STATS_NUM_TYPES; i++)
+	{
+		entry->typeLastRow[i] = -1;
+	}
+
+	context->numPaths++;
+	return entry;
+}
+
+
+/*
+ * Maps a bson type to its slot in the type counts, -1 for unknown types.
+ */
+static inline int
+PathStatsTypeIndex(bson_type_t type)
+{
+	if (type >= BSON_TYPE_DOUBLE && type <= BSON_TYPE_DECIMAL128)
+	{
+		return (int) type - (int) BSON_TYPE_DOUBLE;
+	}
+	else if (type == BSON_TYPE_MINKEY)
+	{
+		return BSON_PATH_STATS_NUM_TYPES - 2;
+	}
+	else if (type == BSON_TYPE_MAXKEY)
+	{
+		return BSON_PATH_STATS_NUM_TYPES - 1;
+	}
+
+	return -1;
+}
+
+
+static inline bson_type_t
+PathStatsTypeFromIndex(int index)
+{
+	if (index == BSON_PATH_STATS_NUM_TYPES - 2)
+	{
+		return BSON_TYPE_MINKEY;
+	}
+	else if (index == BSON_PATH_STATS_NUM_TYPES - 1)
+	{
+		return BSON_TYPE_MAXKEY;
+	}
+
+	return (bson_type_t) (index + (int) BSON_TYPE_DOUBLE);
+}
+
+
+/*
+ * Whether the value is a scalar that is sampled for MCVs and histograms.
+ */
+static inline bool
+IsSampledPathValue(const bson_value_t *value)
+{
+	switch (value->value_type)
+	{
+		case BSON_TYPE_DOUBLE:
+		case BSON_TYPE_INT32:
+		case BSON_TYPE_INT64:
+		case BSON_TYPE_DECIMAL128:
+		case BSON_TYPE_BOOL:
+		case BSON_TYPE_DATE_TIME:
+		case BSON_TYPE_TIMESTAMP:
+		case BSON_TYPE_OID:
+		{
+			return true;
+		}
+
+		case BSON_TYPE_UTF8:
+		{
+			return value->value.v_utf8.len <= BSON_PATH_STATS_MAX_STRING_LENGTH;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+
+/*
+ * Records a value found at the path of the entry. isFieldValue is false for the
+ * elements of an array at the path.
+ */
+static void
+RecordPathValue(PathStatsContext *context, PathStatsEntry *entry,
+				const bson_value_t *value, int rowIndex, bool isFieldValue)
+{
+	if (entry->lastRow != rowIndex)
+	{
+		entry->lastRow = rowIndex;
+		entry->rowCount++;
+	}
+
+	if (isFieldValue && value->value_type == BSON_TYPE_NULL &&
+		entry->lastNullRow != rowIndex)
+	{
+		entry->lastNullRow = rowIndex;
+		entry->nullCount++;
+	}
+
+	if (isFieldValue && value->value_type == BSON_TYPE_ARRAY &&
+		entry->lastArrayRow != rowIndex)
+	{
+		entry->lastArrayRow = rowIndex;
+		entry->arrayCount++;
+
+		uint32 arrayLength = (uint32) BsonDocumentValueCountKeys(value);
+		int bucket = arrayLength <= 2 ? (int) arrayLength :
+					 Min(BSON_PATH_STATS_NUM_ARRAY_LENGTH_BUCKETS - 1,
+						 1 + pg_ceil_log2_32(arrayLength));
+		entry->arrayLengthCounts[bucket]++;
+	}
+
+	int typeIndex = PathStatsTypeIndex(value->value_type);
+	if (typeIndex >= 0 && entry->typeLastRow[typeIndex] != rowIndex)
+	{
+		entry->typeLastRow[typeIndex] = rowIndex;
+		entry->typeCounts[typeIndex]++;
+	}
+
+	if (!IsSampledPathValue(value) || entry->numValues >= context->maxValuesPerPath)
+	{
+		return;
+	}
+
+	if (entry->numValues == entry->maxValues)
+	{
+		entry->maxValues = Max(16, entry->maxValues * 2);
+		entry->values = entry->values == NULL ?
+						palloc(entry->maxValues * sizeof(PathSampleValue)) :
+						repalloc(entry->values,
+								 entry->maxValues * sizeof(PathSampleValue));
+	}
+
+	PathSampleValue *sample = &entry->values[entry->numValues++];
+	sample->value = *value;
+	sample->rowIndex = rowIndex;
+	if (value->value_type == BSON_TYPE_UTF8)
+	{
+		/* The document is freed after it is walked */
+		sample->value.value.v_utf8.str = pnstrdup(value->value.v_utf8.str,
+												  value->value.v_utf8.len);
+	}
+}
+
+
+/*
+ * Serializes the statistics of a path (see bson_analyze.h for the layout).
+ * The most common values are the values found in more than one row, up to the
+ * statistics target, the histogram describes the remaining values.
+ */
+static pgbson *
+BuildPathStatsDocument(PathStatsEntry *entry, int samplerows, double totalrows,
+					   int statisticsTarget)
+{
+	double rows = (double) samplerows;
+	statisticsTarget = Max(statisticsTarget, 1);
+
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+	PgbsonWriterAppendUtf8(&writer, BSON_PATH_STATS_PATH, strlen(BSON_PATH_STATS_PATH),
+						   entry->path);
+	PgbsonWriterAppendDouble(&writer, BSON_PATH_STATS_EXISTS_FRAC,
+							 strlen(BSON_PATH_STATS_EXISTS_FRAC),
+							 entry->rowCount / rows);
+	PgbsonWriterAppendDouble(&writer, BSON_PATH_STATS_NULL_FRAC,
+							 strlen(BSON_PATH_STATS_NULL_FRAC),
+							 entry->nullCount / rows);
+	PgbsonWriterAppendDouble(&writer, BSON_PATH_STATS_ARRAY_FRAC,
+							 strlen(BSON_PATH_STATS_ARRAY_FRAC),
+							 entry->arrayCount / rows);
+
+	bson_value_t doubleValue = { .value_type = BSON_TYPE_DOUBLE };
+	pgbson_array_writer arrayWriter;
+	PgbsonWriterStartArray(&writer, BSON_PATH_STATS_ARRAY_LENGTHS,
+						   strlen(BSON_PATH_STATS_ARRAY_LENGTHS), &arrayWriter);
+	for (int i = 0; i < BSON_PATH_STATS_NUM_ARRAY_LENGTH_BUCKETS; i++)
+	{
+		doubleValue.value.v_double = entry->arrayCount > 0 ?
+									 entry->arrayLengthCounts[i] /
+									 (double) entry->arrayCount : 0;
+		PgbsonArrayWriterWriteValue(&arrayWriter, &doubleValue);
+	}
+	PgbsonWriterEndArray(&writer, &arrayWriter);
+
+	pgbson_writer typesWriter;
+	PgbsonWriterStartDocument(&writer, BSON_PATH_STATS_TYPES,
+							  strlen(BSON_PATH_STATS_TYPES), &typesWriter);
+	for (int i = 0; i < BSON_PATH_STATS_NUM_TYPES; i++)
+	{
+		if (entry->typeCounts[i] > 0)
+		{
+			char typeCode[8];
+			int typeCodeLength = pg_snprintf(typeCode, sizeof(typeCode), "%d",
+											 (int) PathStatsTypeFromIndex(i));
+			PgbsonWriterAppendDouble(&typesWriter, typeCode, typeCodeLength,
+									 entry->typeCounts[i] / rows);
+		}
+	}
+	PgbsonWriterEndDocument(&writer, &typesWriter);
+
+	/* Group the equal values of the sample */
+	int numValues = entry->numValues;
+	qsort(entry->values, numValues, sizeof(PathSampleValue), ComparePathSampleValues);
+
+	PathValueGroup *groups = palloc(Max(numValues, 1) * sizeof(PathValueGroup));
+	int numGroups = 0;
+	int numSingletons = 0;
+	for (int i = 0; i < numValues; i++)
+	{
+		bool isComparisonValid = true;
+		if (numGroups == 0 ||
+			CompareBsonValueAndType(&entry->values[groups[numGroups - 1].start].value,
+									&entry->values[i].value, &isComparisonValid) != 0)
+		{
+			groups[numGroups].start = i;
+			groups[numGroups].numValues = 0;
+			groups[numGroups].numRows = 0;
+			groups[numGroups].isMostCommon = false;
+			numGroups++;
+		}
+
+		PathValueGroup *group = &groups[numGroups - 1];
+		if (group->numValues == 0 ||
+			entry->values[i - 1].rowIndex != entry->values[i].rowIndex)
+		{
+			group->numRows++;
+		}
+
+		group->numValues++;
+	}
+
+	for (int i = 0; i < numGroups; i++)
+	{
+		numSingletons += groups[i].numValues == 1 ? 1 : 0;
+	}
+
+	/* Estimate the number of distinct values in the table the same way Postgres does */
+	double distinct = 0;
+	if (numValues > 0)
+	{
+		double valuesPerRow = numValues / rows;
+		double totalValues = Max(valuesPerRow * totalrows, numValues);
+		if (numSingletons == numGroups)
+		{
+			/* Every value is unique */
+			distinct = totalValues;
+		}
+		else
+		{
+			double denominator = (numValues - numSingletons) +
+								 numSingletons * numValues / totalValues;
+			distinct = (numValues * (double) numGroups) / denominator;
+			distinct = Max(distinct, numGroups);
+			distinct = Min(distinct, totalValues);
+		}
+
+		if (distinct > 0.1 * totalrows && totalrows > 0)
+		{
+			/* Scales with the table */
+			distinct = -Min(distinct / totalrows, 1.0);
+		}
+	}
+
+	PgbsonWriterAppendDouble(&writer, BSON_PATH_STATS_DISTINCT,
+							 strlen(BSON_PATH_STATS_DISTINCT), distinct);
+
+	/* Pick the most common values */
+	PathValueGroup **candidates = palloc(Max(numGroups, 1) * sizeof(PathValueGroup *));
+	for (int i = 0; i < numGroups; i++)
+	{
+		candidates[i] = &groups[i];
+	}
+
+	qsort(candidates, numGroups, sizeof(PathValueGroup *), ComparePathValueGroupsByRows);
+
+	bool keepAllValues = numGroups <= statisticsTarget;
+	int numMostCommon = 0;
+	while (numMostCommon < numGroups && numMostCommon < statisticsTarget &&
+		   (keepAllValues || candidates[numMostCommon]->numRows > 1))
+	{
+		candidates[numMostCommon]->isMostCommon = true;
+		numMostCommon++;
+	}
+
+	PgbsonWriterStartArray(&writer, BSON_PATH_STATS_MCV, strlen(BSON_PATH_STATS_MCV),
+						   &arrayWriter);
+	for (int i = 0; i < numMostCommon; i++)
+	{
+		PgbsonArrayWriterWriteValue(&arrayWriter,
+									&entry->values[candidates[i]->start].value);
+	}
+	PgbsonWriterEndArray(&writer, &arrayWriter);
+
+	PgbsonWriterStartArray(&writer, BSON_PATH_STATS_MCV_FREQS,
+						   strlen(BSON_PATH_STATS_MCV_FREQS), &arrayWriter);
+	for (int i = 0; i < numMostCommon; i++)
+	{
+		doubleValue.value.v_double = candidates[i]->numRows / rows;
+		PgbsonArrayWriterWriteValue(&arrayWriter, &doubleValue);
+	}
+	PgbsonWriterEndArray(&writer, &arrayWriter);
+
+	/* Equi-depth histogram over the values that are not most common */
+	int numRemaining = 0;
+	int numRemainingGroups = 0;
+	int *remaining = palloc(Max(numValues, 1) * sizeof(int));
+	for (int i = 0; i < numGroups; i++)
+	{
+		if (groups[i].isMostCommon)
+		{
+			continue;
+		}
+
+		numRemainingGroups++;
+		for (int j = 0; j < groups[i].numValues; j++)
+		{
+			remaining[numRemaining++] = groups[i].start + j;
+		}
+	}
+
+	PgbsonWriterStartArray(&writer, BSON_PATH_STATS_HISTOGRAM,
+						   strlen(BSON_PATH_STATS_HISTOGRAM), &arrayWriter);
+	double histogramFrac = 0;
+	if (numRemainingGroups > 1)
+	{
+		int numBounds = Min(statisticsTarget + 1, numRemaining);
+		for (int i = 0; i < numBounds; i++)
+		{
+			int position = (int) (((int64) i * (numRemaining - 1)) / (numBounds - 1));
+			PgbsonArrayWriterWriteValue(&arrayWriter,
+										&entry->values[remaining[position]].value);
+		}
+
+		histogramFrac = Min(numRemaining / rows, entry->rowCount / rows);
+	}
+	PgbsonWriterEndArray(&writer, &arrayWriter);
+
+	PgbsonWriterAppendDouble(&writer, BSON_PATH_STATS_HISTOGRAM_FRAC,
+							 strlen(BSON_PATH_STATS_HISTOGRAM_FRAC), histogramFrac);
+
+	pfree(remaining);
+	pfree(candidates);
+	pfree(groups);
+	return PgbsonWriterGetPgbson(&writer);
+}
+
+
+static int
+ComparePathSampleValues(const void *left, const void *right)
+{
+	const PathSampleValue *leftValue = (const PathSampleValue *) left;
+	const PathSampleValue *rightValue = (const PathSampleValue *) right;
+
+	bool isComparisonValid = true;
+	int result = CompareBsonValueAndType(&leftValue->value, &rightValue->value,
+										 &isComparisonValid);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	return leftValue->rowIndex - rightValue->rowIndex;
+}
+
+
+static int
+ComparePathStatsByRowCount(const void *left, const void *right)
+{
+	const PathStatsEntry *leftEntry = *(const PathStatsEntry **) left;
+	const PathStatsEntry *rightEntry = *(const PathStatsEntry **) right;
+	if (leftEntry->rowCount != rightEntry->rowCount)
+	{
+		return rightEntry->rowCount - leftEntry->rowCount;
+	}
+
+	return strcmp(leftEntry->path, rightEntry->path);
+}
+
+
+static int
+ComparePathStatsByPath(const void *left, const void *right)
+{
+	const PathStatsEntry *leftEntry = *(const PathStatsEntry **) left;
+	const PathStatsEntry *rightEntry = *(const PathStatsEntry **) right;
+	return strcmp(leftEntry->path, rightEntry->path);
+}
+
+
+static int
+ComparePathValueGroupsByRows(const void *left, const void *right)
+{
+	const PathValueGroup *leftGroup = *(const PathValueGroup **) left;
+	const PathValueGroup *rightGroup = *(const PathValueGroup **) right;
+	if (leftGroup->numRows != rightGroup->numRows)
+	{
+		return rightGroup->numRows - leftGroup->numRows;
+	}
+
+	return leftGroup->start - rightGroup->start;
 }
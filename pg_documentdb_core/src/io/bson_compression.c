@@ -0,0 +1,324 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/io/bson_compression.c
+ *
+ * Implementation of the compression of stored documents with trained zstd
+ * dictionaries. See io/bson_compression.h for the format.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include <utils/memutils.h>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#define PRIVATE_PGBSON_H
+#include "io/pgbson.h"
+#undef PRIVATE_PGBSON_H
+
+#include "io/bson_compression.h"
+#include "utils/documentdb_errors.h"
+
+/* The empty bson document a compressed document starts with */
+static const char CompressedDocumentPrefix[5] = { 5, 0, 0, 0, 0 };
+
+/* The bytes a compressed document adds around its zstd frame */
+#define COMPRESSED_DOCUMENT_OVERHEAD (sizeof(CompressedDocumentPrefix) + \
+									  sizeof(BsonCompressionHeader) + 1)
+
+#ifdef USE_ZSTD
+
+/* Reused across documents, zstd keeps its working memory in them */
+static ZSTD_CCtx *CompressionContext = NULL;
+static ZSTD_DCtx *DecompressionContext = NULL;
+
+static void FreeBsonCompressionDictionary(void *arg);
+#else
+static void ThrowCompressionNotSupported(void);
+#endif
+
+
+/*
+ * Whether documents can be compressed in this build.
+ */
+bool
+IsBsonCompressionSupported(void)
+{
+#ifdef USE_ZSTD
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/*
+ * Trains a dictionary of at most maxDictionarySize bytes from sample
+ * documents. Returns NULL if the samples are not enough to train one.
+ */
+bytea *
+TrainBsonCompressionDictionary(pgbson **samples, int numSamples,
+							   uint32 maxDictionarySize)
+{
+#ifdef USE_ZSTD
+	size_t totalSize = 0;
+	size_t *sampleSizes = palloc(sizeof(size_t) * Max(numSamples, 1));
+	for (int i = 0; i < numSamples; i++)
+	{
+		sampleSizes[i] = VARSIZE_ANY_EXHDR(samples[i]);
+		totalSize += sampleSizes[i];
+	}
+
+	char *sampleBuffer = palloc(Max(totalSize, 1));
+	size_t offset = 0;
+	for (int i = 0; i < numSamples; i++)
+	{
+		memcpy(sampleBuffer + offset, VARDATA_ANY(samples[i]), sampleSizes[i]);
+		offset += sampleSizes[i];
+	}
+
+	bytea *dictionary = palloc(VARHDRSZ + maxDictionarySize);
+	size_t dictionarySize = ZDICT_trainFromBuffer(VARDATA(dictionary),
+												  maxDictionarySize, sampleBuffer,
+												  sampleSizes, numSamples);
+
+	pfree(sampleBuffer);
+	pfree(sampleSizes);
+
+	if (ZDICT_isError(dictionarySize))
+	{
+		elog(DEBUG1, "could not train a compression dictionary: %s",
+			 ZDICT_getErrorName(dictionarySize));
+		pfree(dictionary);
+		return NULL;
+	}
+
+	SET_VARSIZE(dictionary, VARHDRSZ + dictionarySize);
+	return dictionary;
+#else
+	ThrowCompressionNotSupported();
+#endif
+}
+
+
+/*
+ * Digests a trained dictionary for compression at the given level and for
+ * decompression.
+ */
+BsonCompressionDictionary *
+CreateBsonCompressionDictionary(int64 dictionaryId, uint32 dictionaryVersion,
+								const bytea *dictionary, int compressionLevel)
+{
+#ifdef USE_ZSTD
+	BsonCompressionDictionary *result = palloc0(sizeof(BsonCompressionDictionary));
+	result->dictionaryId = dictionaryId;
+	result->dictionaryVersion = dictionaryVersion;
+
+	/* Free the zstd objects along with the dictionary */
+	MemoryContextCallback *callback = palloc0(sizeof(MemoryContextCallback));
+	callback->func = FreeBsonCompressionDictionary;
+	callback->arg = result;
+	MemoryContextRegisterResetCallback(CurrentMemoryContext, callback);
+
+	result->compressionDictionary =
+		ZSTD_createCDict(VARDATA_ANY(dictionary), VARSIZE_ANY_EXHDR(dictionary),
+						 compressionLevel);
+	result->decompressionDictionary =
+		ZSTD_createDDict(VARDATA_ANY(dictionary), VARSIZE_ANY_EXHDR(dictionary));
+	if (result->compressionDictionary == NULL ||
+		result->decompressionDictionary == NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY),
+						errmsg("could not create compression dictionary " INT64_FORMAT,
+							   dictionaryId)));
+	}
+
+	return result;
+#else
+	ThrowCompressionNotSupported();
+#endif
+}
+
+
+/*
+ * Compresses a stored document with the dictionary. Returns the document
+ * itself if compression does not make it smaller.
+ */
+pgbson *
+PgbsonCompress(const pgbson *document, const BsonCompressionDictionary *dictionary)
+{
+#ifdef USE_ZSTD
+	if (PgbsonIsCompressed(document))
+	{
+		return (pgbson *) document;
+	}
+
+	if (CompressionContext == NULL)
+	{
+		CompressionContext = ZSTD_createCCtx();
+		if (CompressionContext == NULL)
+		{
+			ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY),
+							errmsg("could not create zstd compression context")));
+		}
+	}
+
+	uint32 documentSize = VARSIZE_ANY_EXHDR(document);
+	size_t bound = ZSTD_compressBound(documentSize);
+	pgbson *result = palloc(VARHDRSZ + COMPRESSED_DOCUMENT_OVERHEAD + bound);
+
+	char *data = VARDATA(result);
+	memcpy(data, CompressedDocumentPrefix, sizeof(CompressedDocumentPrefix));
+	data += sizeof(CompressedDocumentPrefix);
+
+	BsonCompressionHeader header = {
+		.dictionaryId = dictionary->dictionaryId,
+		.dictionaryVersion = dictionary->dictionaryVersion,
+		.uncompressedSize = documentSize
+	};
+	memcpy(data, &header, sizeof(BsonCompressionHeader));
+	data += sizeof(BsonCompressionHeader);
+
+	size_t compressedSize =
+		ZSTD_compress_usingCDict(CompressionContext, data, bound,
+								 VARDATA_ANY(document), documentSize,
+								 dictionary->compressionDictionary);
+	if (ZSTD_isError(compressedSize))
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("could not compress document: %s",
+							   ZSTD_getErrorName(compressedSize))));
+	}
+
+	uint32 resultSize = COMPRESSED_DOCUMENT_OVERHEAD + compressedSize;
+	if (resultSize >= documentSize)
+	{
+		pfree(result);
+		return (pgbson *) document;
+	}
+
+	data[compressedSize] = BSON_STORED_FORMAT_COMPRESSED;
+	SET_VARSIZE(result, VARHDRSZ + resultSize);
+	return result;
+#else
+	ThrowCompressionNotSupported();
+#endif
+}
+
+
+/*
+ * Returns the header of a compressed document.
+ */
+BsonCompressionHeader
+PgbsonGetCompressionHeader(const pgbson *compressedDocument)
+{
+	if (!PgbsonIsCompressed(compressedDocument) ||
+		VARSIZE_ANY_EXHDR(compressedDocument) <= COMPRESSED_DOCUMENT_OVERHEAD ||
+		PgbsonGetStoredBsonLength(compressedDocument) !=
+		sizeof(CompressedDocumentPrefix))
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Document is not compressed")));
+	}
+
+	BsonCompressionHeader header;
+	memcpy(&header, VARDATA_ANY(compressedDocument) + sizeof(CompressedDocumentPrefix),
+		   sizeof(BsonCompressionHeader));
+	return header;
+}
+
+
+/*
+ * Decompresses a compressed document with the dictionary it was compressed
+ * with. The result is the document as it was given to PgbsonCompress.
+ */
+pgbson *
+PgbsonDecompress(const pgbson *compressedDocument,
+				 const BsonCompressionDictionary *dictionary)
+{
+#ifdef USE_ZSTD
+	BsonCompressionHeader header = PgbsonGetCompressionHeader(compressedDocument);
+	if (header.dictionaryId != dictionary->dictionaryId ||
+		header.dictionaryVersion != dictionary->dictionaryVersion)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Compression dictionary " INT64_FORMAT
+							   " version %u does not match the document",
+							   dictionary->dictionaryId,
+							   dictionary->dictionaryVersion)));
+	}
+
+	if (DecompressionContext == NULL)
+	{
+		DecompressionContext = ZSTD_createDCtx();
+		if (DecompressionContext == NULL)
+		{
+			ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY),
+							errmsg("could not create zstd decompression context")));
+		}
+	}
+
+	const char *frame = VARDATA_ANY(compressedDocument) +
+						sizeof(CompressedDocumentPrefix) +
+						sizeof(BsonCompressionHeader);
+	size_t frameSize = VARSIZE_ANY_EXHDR(compressedDocument) -
+					   COMPRESSED_DOCUMENT_OVERHEAD;
+
+	pgbson *result = palloc(VARHDRSZ + header.uncompressedSize);
+	SET_VARSIZE(result, VARHDRSZ + header.uncompressedSize);
+
+	size_t decompressedSize =
+		ZSTD_decompress_usingDDict(DecompressionContext, VARDATA(result),
+								   header.uncompressedSize, frame, frameSize,
+								   dictionary->decompressionDictionary);
+	if (ZSTD_isError(decompressedSize) ||
+		decompressedSize != header.uncompressedSize)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("could not decompress document: %s",
+							   ZSTD_isError(decompressedSize) ?
+							   ZSTD_getErrorName(decompressedSize) :
+							   "unexpected size")));
+	}
+
+	return result;
+#else
+	ThrowCompressionNotSupported();
+#endif
+}
+
+
+#ifdef USE_ZSTD
+static void
+FreeBsonCompressionDictionary(void *arg)
+{
+	BsonCompressionDictionary *dictionary = (BsonCompressionDictionary *) arg;
+	if (dictionary->compressionDictionary != NULL)
+	{
+		ZSTD_freeCDict(dictionary->compressionDictionary);
+		dictionary->compressionDictionary = NULL;
+	}
+
+	if (dictionary->decompressionDictionary != NULL)
+	{
+		ZSTD_freeDDict(dictionary->decompressionDictionary);
+		dictionary->decompressionDictionary = NULL;
+	}
+}
+
+
+#else
+static void
+pg_attribute_noreturn()
+ThrowCompressionNotSupported(void)
+{
+	ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("Document compression requires a build with zstd support")));
+}
+
+
+#endif
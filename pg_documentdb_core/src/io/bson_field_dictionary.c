@@ -0,0 +1,552 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/io/bson_field_dictionary.c
+ *
+ * Implementation of the dictionary encoding of document field names.
+ * See io/bson_field_dictionary.h for the format.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <postgres.h>
+#include <lib/stringinfo.h>
+#include <utils/hsearch.h>
+#include <utils/memutils.h>
+
+#define PRIVATE_PGBSON_H
+#include "io/pgbson.h"
+#include "io/pgbson_writer.h"
+#undef PRIVATE_PGBSON_H
+
+#include "io/pgbsonelement.h"
+#include "io/bson_field_dictionary.h"
+#include "utils/documentdb_errors.h"
+#include "utils/hashset_utils.h"
+#include "utils/string_view.h"
+
+/* The first byte of an encoded field name that refers to a dictionary entry */
+#define FIELD_NAME_DICTIONARY_ENTRY 0x01
+
+/* The first byte of an encoded field name that is stored literally */
+#define FIELD_NAME_ESCAPE 0x02
+
+/* Base 128 digits, least significant first: 3 digits cover any entry id */
+#define MAX_ENCODED_NUMBER_LENGTH 4
+
+/* The dictionary id, the number of entries and the format byte */
+#define FIELD_NAME_TRAILER_LENGTH (sizeof(int64) + sizeof(uint32) + 1)
+
+typedef struct FieldNameHashEntry
+{
+	/* The name, must be the first field */
+	StringView name;
+	uint32 id;
+} FieldNameHashEntry;
+
+/*
+ * The last path encoded by PgbsonEncodeFieldPath: queries encode the same
+ * path for each document they match.
+ */
+typedef struct EncodedPathCache
+{
+	int64 dictionaryId;
+	uint32 numNames;
+	char *path;
+	char *encodedPath;
+} EncodedPathCache;
+
+static EncodedPathCache LastEncodedPath = { 0 };
+static MemoryContext EncodedPathCacheContext = NULL;
+
+static uint32 FieldNameHashFunc(const void *obj, size_t objsize);
+static int FieldNameCompareFunc(const void *obj1, const void *obj2, Size objsize);
+static void ReadFieldNameTrailer(const pgbson *encodedDocument, int64 *dictionaryId,
+								 uint32 *numNames);
+static uint32 GetEncodedNumNames(const pgbson *encodedDocument,
+								 const BsonFieldDictionary *dictionary);
+static void EncodeDocumentFieldNames(bson_iter_t *iter, bson_t *target, bool isArray,
+									 const BsonFieldDictionary *dictionary,
+									 StringInfo nameBuffer, bool *hasEncodedNames);
+static void ExpandDocumentFieldNames(bson_iter_t *iter, bson_t *target, bool isArray,
+									 const BsonFieldDictionary *dictionary,
+									 uint32 numNames);
+static void EncodeFieldName(const char *name, uint32_t nameLength,
+							const BsonFieldDictionary *dictionary, uint32 numNames,
+							StringInfo nameBuffer);
+static const char * ExpandFieldName(const char *name, uint32_t *nameLength,
+									const BsonFieldDictionary *dictionary,
+									uint32 numNames);
+static void AppendEncodedNumber(StringInfo buffer, uint32 number);
+static uint32 ReadEncodedNumber(const uint8_t *bytes, uint32_t length);
+
+
+/*
+ * Creates a dictionary over the given names in the current memory context.
+ * The names are not copied.
+ */
+BsonFieldDictionary *
+CreateBsonFieldDictionary(int64 dictionaryId, char **names, uint32 numNames)
+{
+	BsonFieldDictionary *dictionary = palloc0(sizeof(BsonFieldDictionary));
+	dictionary->dictionaryId = dictionaryId;
+	dictionary->numNames = numNames;
+	dictionary->names = names;
+
+	HASHCTL hashInfo = CreateExtensionHashCTL(sizeof(StringView),
+											  sizeof(FieldNameHashEntry),
+											  FieldNameCompareFunc,
+											  FieldNameHashFunc);
+	dictionary->nameLookup = hash_create("Bson field dictionary",
+										 Max(numNames, 16), &hashInfo,
+										 DefaultExtensionHashFlags);
+
+	for (uint32 i = 0; i < numNames; i++)
+	{
+		StringView name = CreateStringViewFromString(names[i]);
+		bool found = false;
+		FieldNameHashEntry *entry = hash_search(dictionary->nameLookup, &name,
+												HASH_ENTER, &found);
+		if (!found)
+		{
+			entry->id = i;
+		}
+	}
+
+	return dictionary;
+}
+
+
+/*
+ * Whether a field name may be added to a dictionary: it must be long enough
+ * to save space, and must not be an array index or start with a byte that
+ * the encoding reserves.
+ */
+bool
+IsBsonFieldDictionaryCandidate(const char *name, uint32_t nameLength)
+{
+	if (nameLength < BSON_FIELD_DICTIONARY_MIN_NAME_LENGTH ||
+		(uint8_t) name[0] <= FIELD_NAME_ESCAPE ||
+		memchr(name, '.', nameLength) != NULL)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < nameLength; i++)
+	{
+		if (name[i] < '0' || name[i] > '9')
+		{
+			return true;
+		}
+	}
+
+	/* all digits */
+	return false;
+}
+
+
+/*
+ * Encodes the field names of a plain document with the dictionary. Returns the
+ * document itself if none of its field names are in the dictionary.
+ */
+pgbson *
+PgbsonEncodeFieldNames(const pgbson *document, const BsonFieldDictionary *dictionary)
+{
+	bson_t target;
+	bson_init(&target);
+
+	StringInfoData nameBuffer;
+	initStringInfo(&nameBuffer);
+
+	bson_iter_t iter;
+	PgbsonInitIterator(document, &iter);
+
+	bool hasEncodedNames = false;
+	EncodeDocumentFieldNames(&iter, &target, false, dictionary, &nameBuffer,
+							 &hasEncodedNames);
+
+	pgbson *result = (pgbson *) document;
+	if (hasEncodedNames)
+	{
+		uint32_t dataLength = target.len + FIELD_NAME_TRAILER_LENGTH;
+		result = (pgbson *) palloc(VARHDRSZ + dataLength);
+		SET_VARSIZE(result, VARHDRSZ + dataLength);
+
+		char *data = VARDATA(result);
+		memcpy(data, bson_get_data(&target), target.len);
+		data += target.len;
+
+		memcpy(data, &dictionary->dictionaryId, sizeof(int64));
+		data += sizeof(int64);
+		memcpy(data, &dictionary->numNames, sizeof(uint32));
+		data += sizeof(uint32);
+		*data = BSON_STORED_FORMAT_FIELD_NAMES_ENCODED;
+	}
+
+	bson_destroy(&target);
+	pfree(nameBuffer.data);
+	return result;
+}
+
+
+/*
+ * Returns the id of the dictionary an encoded document was encoded with,
+ * along with the number of entries it was encoded with.
+ */
+int64
+PgbsonGetFieldDictionaryId(const pgbson *encodedDocument, uint32 *numNames)
+{
+	int64 dictionaryId = 0;
+	ReadFieldNameTrailer(encodedDocument, &dictionaryId, numNames);
+	return dictionaryId;
+}
+
+
+/*
+ * Expands the field names of a document encoded with the dictionary.
+ */
+pgbson *
+PgbsonExpandFieldNames(const pgbson *encodedDocument,
+					   const BsonFieldDictionary *dictionary)
+{
+	uint32 numNames = GetEncodedNumNames(encodedDocument, dictionary);
+
+	bson_iter_t iter;
+	PgbsonInitEncodedDocumentIterator(encodedDocument, &iter);
+
+	bson_t target;
+	bson_init(&target);
+	ExpandDocumentFieldNames(&iter, &target, false, dictionary, numNames);
+
+	pgbson *result = PgbsonInitFromBuffer((const char *) bson_get_data(&target),
+										  target.len);
+	bson_destroy(&target);
+	return result;
+}
+
+
+/*
+ * Initializes an iterator over the bson of an encoded document, whose field
+ * names are left encoded.
+ */
+void
+PgbsonInitEncodedDocumentIterator(const pgbson *encodedDocument, bson_iter_t *iterator)
+{
+	if (!bson_iter_init_from_data(iterator,
+								  (const uint8_t *) VARDATA_ANY(encodedDocument),
+								  PgbsonGetStoredBsonLength(encodedDocument)))
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_BADVALUE),
+						errmsg("invalid input syntax for BSON")));
+	}
+}
+
+
+/*
+ * Returns the dotted path to traverse to find the given path in an encoded
+ * document, or the path itself if the document is not encoded. The document
+ * must be encoded with the given dictionary.
+ */
+const char *
+PgbsonEncodeFieldPath(const pgbson *encodedDocument,
+					  const BsonFieldDictionary *dictionary, const char *path)
+{
+	if (!PgbsonIsFieldNameEncoded(encodedDocument))
+	{
+		return path;
+	}
+
+	uint32 numNames = GetEncodedNumNames(encodedDocument, dictionary);
+
+	if (LastEncodedPath.path != NULL &&
+		LastEncodedPath.dictionaryId == dictionary->dictionaryId &&
+		LastEncodedPath.numNames == numNames &&
+		strcmp(LastEncodedPath.path, path) == 0)
+	{
+		return LastEncodedPath.encodedPath;
+	}
+
+	if (EncodedPathCacheContext == NULL)
+	{
+		EncodedPathCacheContext = AllocSetContextCreate(TopMemoryContext,
+														"Encoded field path cache",
+														ALLOCSET_SMALL_SIZES);
+	}
+
+	MemoryContextReset(EncodedPathCacheContext);
+	LastEncodedPath.path = NULL;
+
+	MemoryContext oldContext = MemoryContextSwitchTo(EncodedPathCacheContext);
+
+	StringInfoData encodedPath;
+	initStringInfo(&encodedPath);
+
+	StringView remaining = CreateStringViewFromString(path);
+	while (true)
+	{
+		StringView segment = StringViewFindPrefix(&remaining, '.');
+		if (segment.string == NULL)
+		{
+			segment = remaining;
+		}
+
+		EncodeFieldName(segment.string, segment.length, dictionary, numNames,
+						&encodedPath);
+
+		if (segment.length >= remaining.length)
+		{
+			break;
+		}
+
+		appendStringInfoChar(&encodedPath, '.');
+		remaining = StringViewSubstring(&remaining, segment.length + 1);
+	}
+
+	LastEncodedPath.dictionaryId = dictionary->dictionaryId;
+	LastEncodedPath.numNames = numNames;
+	LastEncodedPath.path = pstrdup(path);
+	LastEncodedPath.encodedPath = encodedPath.data;
+	MemoryContextSwitchTo(oldContext);
+
+	return LastEncodedPath.encodedPath;
+}
+
+
+/*
+ * Reads the trailer of a document with encoded field names.
+ */
+static void
+ReadFieldNameTrailer(const pgbson *encodedDocument, int64 *dictionaryId,
+					 uint32 *numNames)
+{
+	uint32_t datumLength = VARSIZE_ANY_EXHDR(encodedDocument);
+	if (!PgbsonIsFieldNameEncoded(encodedDocument) ||
+		datumLength - PgbsonGetStoredBsonLength(encodedDocument) !=
+		FIELD_NAME_TRAILER_LENGTH)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Document does not have dictionary encoded field names")));
+	}
+
+	const char *trailer = VARDATA_ANY(encodedDocument) + datumLength -
+						  FIELD_NAME_TRAILER_LENGTH;
+	memcpy(dictionaryId, trailer, sizeof(int64));
+	memcpy(numNames, trailer + sizeof(int64), sizeof(uint32));
+}
+
+
+/*
+ * Returns the number of dictionary entries an encoded document was encoded
+ * with, checking that the given dictionary decodes it.
+ */
+static uint32
+GetEncodedNumNames(const pgbson *encodedDocument, const BsonFieldDictionary *dictionary)
+{
+	int64 dictionaryId = 0;
+	uint32 numNames = 0;
+	ReadFieldNameTrailer(encodedDocument, &dictionaryId, &numNames);
+	if (dictionary->dictionaryId != dictionaryId || dictionary->numNames < numNames)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Field name dictionary " INT64_FORMAT
+							   " of the document is not available", dictionaryId)));
+	}
+
+	return numNames;
+}
+
+
+static void
+EncodeDocumentFieldNames(bson_iter_t *iter, bson_t *target, bool isArray,
+						 const BsonFieldDictionary *dictionary, StringInfo nameBuffer,
+						 bool *hasEncodedNames)
+{
+	while (bson_iter_next(iter))
+	{
+		const char *name = bson_iter_key(iter);
+		uint32_t nameLength = bson_iter_key_len(iter);
+		if (!isArray)
+		{
+			resetStringInfo(nameBuffer);
+			EncodeFieldName(name, nameLength, dictionary, dictionary->numNames,
+							nameBuffer);
+			*hasEncodedNames = *hasEncodedNames ||
+							   nameBuffer->len != (int) nameLength ||
+							   memcmp(nameBuffer->data, name, nameLength) != 0;
+		}
+
+		/* The buffer is reused by nested documents, copy the name out */
+		char *targetName = isArray ? (char *) name : pnstrdup(nameBuffer->data,
+															  nameBuffer->len);
+		uint32_t targetNameLength = isArray ? nameLength : nameBuffer->len;
+
+		bson_iter_t childIter;
+		bson_t childTarget;
+		if (BSON_ITER_HOLDS_DOCUMENT(iter) && bson_iter_recurse(iter, &childIter))
+		{
+			bson_append_document_begin(target, targetName, targetNameLength,
+									   &childTarget);
+			EncodeDocumentFieldNames(&childIter, &childTarget, false, dictionary,
+									 nameBuffer, hasEncodedNames);
+			bson_append_document_end(target, &childTarget);
+		}
+		else if (BSON_ITER_HOLDS_ARRAY(iter) && bson_iter_recurse(iter, &childIter))
+		{
+			bson_append_array_begin(target, targetName, targetNameLength, &childTarget);
+			EncodeDocumentFieldNames(&childIter, &childTarget, true, dictionary,
+									 nameBuffer, hasEncodedNames);
+			bson_append_array_end(target, &childTarget);
+		}
+		else
+		{
+			bson_append_iter(target, targetName, targetNameLength, iter);
+		}
+
+		if (!isArray)
+		{
+			pfree(targetName);
+		}
+	}
+}
+
+
+static void
+ExpandDocumentFieldNames(bson_iter_t *iter, bson_t *target, bool isArray,
+						 const BsonFieldDictionary *dictionary, uint32 numNames)
+{
+	while (bson_iter_next(iter))
+	{
+		uint32_t nameLength = bson_iter_key_len(iter);
+		const char *name = bson_iter_key(iter);
+		if (!isArray)
+		{
+			name = ExpandFieldName(name, &nameLength, dictionary, numNames);
+		}
+
+		bson_iter_t childIter;
+		bson_t childTarget;
+		if (BSON_ITER_HOLDS_DOCUMENT(iter) && bson_iter_recurse(iter, &childIter))
+		{
+			bson_append_document_begin(target, name, nameLength, &childTarget);
+			ExpandDocumentFieldNames(&childIter, &childTarget, false, dictionary,
+									 numNames);
+			bson_append_document_end(target, &childTarget);
+		}
+		else if (BSON_ITER_HOLDS_ARRAY(iter) && bson_iter_recurse(iter, &childIter))
+		{
+			bson_append_array_begin(target, name, nameLength, &childTarget);
+			ExpandDocumentFieldNames(&childIter, &childTarget, true, dictionary,
+									 numNames);
+			bson_append_array_end(target, &childTarget);
+		}
+		else
+		{
+			bson_append_iter(target, name, nameLength, iter);
+		}
+	}
+}
+
+
+/*
+ * Appends the encoded form of a field name: its dictionary entry if it is one
+ * of the first numNames entries, otherwise the name, escaped if need be.
+ */
+static void
+EncodeFieldName(const char *name, uint32_t nameLength,
+				const BsonFieldDictionary *dictionary, uint32 numNames,
+				StringInfo nameBuffer)
+{
+	if (nameLength >= BSON_FIELD_DICTIONARY_MIN_NAME_LENGTH)
+	{
+		StringView nameView = CreateStringViewFromStringWithLength(name, nameLength);
+		bool found = false;
+		FieldNameHashEntry *entry = hash_search(dictionary->nameLookup, &nameView,
+												HASH_FIND, &found);
+		if (found && entry->id < numNames)
+		{
+			appendStringInfoChar(nameBuffer, FIELD_NAME_DICTIONARY_ENTRY);
+			AppendEncodedNumber(nameBuffer, entry->id);
+			return;
+		}
+	}
+
+	if (nameLength > 0 && (uint8_t) name[0] <= FIELD_NAME_ESCAPE)
+	{
+		appendStringInfoChar(nameBuffer, FIELD_NAME_ESCAPE);
+	}
+
+	appendBinaryStringInfo(nameBuffer, name, nameLength);
+}
+
+
+static const char *
+ExpandFieldName(const char *name, uint32_t *nameLength,
+				const BsonFieldDictionary *dictionary, uint32 numNames)
+{
+	if (*nameLength == 0)
+	{
+		return name;
+	}
+
+	if (name[0] == FIELD_NAME_DICTIONARY_ENTRY)
+	{
+		uint32 id = ReadEncodedNumber((const uint8_t *) name + 1, *nameLength - 1);
+		if (id >= numNames)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+							errmsg("Field name dictionary entry %u is out of range", id)));
+		}
+
+		*nameLength = strlen(dictionary->names[id]);
+		return dictionary->names[id];
+	}
+	else if (name[0] == FIELD_NAME_ESCAPE)
+	{
+		*nameLength = *nameLength - 1;
+		return name + 1;
+	}
+
+	return name;
+}
+
+
+static void
+AppendEncodedNumber(StringInfo buffer, uint32 number)
+{
+	do {
+		appendStringInfoChar(buffer, (char) (0x80 | (number & 0x7F)));
+		number >>= 7;
+	} while (number != 0);
+}
+
+
+static uint32
+ReadEncodedNumber(const uint8_t *bytes, uint32_t length)
+{
+	if (length == 0 || length > MAX_ENCODED_NUMBER_LENGTH)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Invalid field name dictionary reference")));
+	}
+
+	uint32 number = 0;
+	for (int i = length - 1; i >= 0; i--)
+	{
+		number = (number << 7) | (bytes[i] & 0x7F);
+	}
+
+	return number;
+}
+
+
+static uint32
+FieldNameHashFunc(const void *obj, size_t objsize)
+{
+	return HashStringView((const StringView *) obj);
+}
+
+
+static int
+FieldNameCompareFunc(const void *obj1, const void *obj2, Size objsize)
+{
+	return CompareStringView((const StringView *) obj1, (const StringView *) obj2);
+}
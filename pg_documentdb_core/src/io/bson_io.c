@@ -72,6 +72,7 @@ PG_FUNCTION_INFO_V1(bson_to_bson_hex);
 PG_FUNCTION_INFO_V1(bson_hex_to_bson);
 PG_FUNCTION_INFO_V1(bson_json_to_bson);
 PG_FUNCTION_INFO_V1(bson_to_json_string);
+PG_FUNCTION_INFO_V1(bson_writer_allocation_stats);
 
 
 /*
@@ -274,6 +275,30 @@ bson_to_bytea(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * bson_writer_allocation_stats returns the allocation counters of the bson
+ * writers of the current backend.
+ */
+Datum
+bson_writer_allocation_stats(PG_FUNCTION_ARGS)
+{
+	const PgbsonWriterAllocationStats *stats = GetPgbsonWriterAllocationStats();
+
+	pgbson_writer writer;
+	PgbsonWriterInit(&writer);
+	PgbsonWriterAppendInt64(&writer, "presizedWriters", 15,
+							(int64) stats->presizedWriters);
+	PgbsonWriterAppendInt64(&writer, "presizedBufferGrowths", 21,
+							(int64) stats->presizedBufferGrowths);
+	PgbsonWriterAppendInt64(&writer, "finalizedInPlace", 16,
+							(int64) stats->finalizedInPlace);
+	PgbsonWriterAppendInt64(&writer, "finalizedWithCopy", 17,
+							(int64) stats->finalizedWithCopy);
+	PgbsonWriterAppendInt64(&writer, "bytesCopied", 11, (int64) stats->bytesCopied);
+	PG_RETURN_POINTER(PgbsonWriterGetPgbson(&writer));
+}
+
+
 /*
  * Converts a PostgreSQL row to a bson document
  */
@@ -13,6 +13,7 @@
 #include <lib/stringinfo.h>
 #include <utils/timestamp.h>
 #include <utils/json.h>
+#include <utils/memutils.h>
 
 #define PRIVATE_PGBSON_H
 #include "io/pgbson.h"
@@ -30,9 +31,15 @@ static pgbson * CreatePgbsonfromBson_t(bson_t *document, bool destroyDocument);
 
 static pgbson * CreatePgbsonfromBsonBytes(const uint8_t *rawbytes, uint32_t length);
 
+static void * PresizedWriterRealloc(void *memory, size_t numBytes, void *context);
+
 static const char *BsonHexPrefix = "BSONHEX";
 static const uint32_t BsonHexPrefixLength = 7;
 
+static PgbsonWriterAllocationStats WriterAllocationStats = { 0 };
+
+extern bool EnablePresizedBsonWriter;
+
 
 /* --------------------------------------------------------- */
 /* pgbson functions */
@@ -758,6 +765,65 @@ pgbson_require_alignment() void
 PgbsonWriterInit(pgbson_writer *writer)
 {
 	bson_init(&(writer->innerBson));
+	writer->buffer = NULL;
+	writer->bufferLength = 0;
+}
+
+
+/*
+ * Initializes a bson writer whose buffer is allocated upfront for a document
+ * of sizeHint bytes, typically the size of the previous document written by
+ * the caller. The buffer is allocated in the CurrentMemoryContext with room
+ * for the varlena header, so that PgbsonWriterGetPgbson can hand it out as the
+ * pgbson instead of copying it. This is meant for writers that build one
+ * document per row in the per tuple memory context, which the executor
+ * resets in bulk.
+ */
+pgbson_require_alignment() void
+PgbsonWriterInitWithSizeHint(pgbson_writer *writer, uint32_t sizeHint)
+{
+	if (!EnablePresizedBsonWriter || sizeHint == 0)
+	{
+		PgbsonWriterInit(writer);
+		return;
+	}
+
+	/* Account for the empty document written before the size is known */
+	writer->bufferLength = Min(Max(sizeHint, 5), MaxAllocSize - VARHDRSZ);
+	writer->buffer = (uint8_t *) palloc(VARHDRSZ + writer->bufferLength) + VARHDRSZ;
+
+	uint32_t emptyDocumentLength = BSON_UINT32_TO_LE(5);
+	memcpy(writer->buffer, &emptyDocumentLength, sizeof(uint32_t));
+	writer->buffer[4] = '\0';
+
+	bson_t *bson = bson_new_from_buffer(&writer->buffer, &writer->bufferLength,
+										PresizedWriterRealloc, CurrentMemoryContext);
+	if (bson == NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DOCUMENTDB_INTERNALERROR),
+						errmsg("Could not initialize a presized bson writer")));
+	}
+
+	/*
+	 * The bson refers to the buffer through writer->buffer, so it can live in
+	 * the writer like any other bson_t. It does not own the buffer and is not
+	 * freed itself on bson_destroy.
+	 */
+	writer->innerBson = *bson;
+	writer->innerBson.flags |= BSON_FLAG_STATIC;
+	bson_free(bson);
+
+	WriterAllocationStats.presizedWriters++;
+}
+
+
+/*
+ * Returns the allocation counters of the pgbson writers of this backend.
+ */
+const PgbsonWriterAllocationStats *
+GetPgbsonWriterAllocationStats(void)
+{
+	return &WriterAllocationStats;
 }
 
 
@@ -1195,6 +1261,9 @@ PgbsonWriterStartDocument(pgbson_writer *writer, const char *path, uint32_t path
 							"adding StartDocument( value: failed due to value being too large"))
 				);
 	}
+
+	childWriter->buffer = NULL;
+	childWriter->bufferLength = 0;
 }
 
 
@@ -1230,6 +1299,9 @@ PgbsonArrayWriterStartDocument(pgbson_array_writer *writer, pgbson_writer *child
 							"adding ArrayWriterStartDocument value: failed due to value being too large"))
 				);
 	}
+
+	childWriter->buffer = NULL;
+	childWriter->bufferLength = 0;
 }
 
 
@@ -1484,7 +1556,30 @@ PgbsonHeapWriterGetValue(pgbson_heap_writer *writer)
 pgbson_require_alignment() pgbson *
 PgbsonWriterGetPgbson(pgbson_writer * writer)
 {
-	return CreatePgbsonfromBson_t(&(writer->innerBson), true);
+	/*
+	 * A presized writer already has the document behind a varlena header, it
+	 * only needs to be copied if the caller wants it in another memory context.
+	 */
+	if (writer->buffer != NULL &&
+		GetMemoryChunkContext(writer->buffer - VARHDRSZ) == CurrentMemoryContext)
+	{
+		pgbson *result = (pgbson *) (writer->buffer - VARHDRSZ);
+		SET_VARSIZE(result, VARHDRSZ + writer->innerBson.len);
+		writer->buffer = NULL;
+		WriterAllocationStats.finalizedInPlace++;
+		return result;
+	}
+
+	WriterAllocationStats.finalizedWithCopy++;
+	WriterAllocationStats.bytesCopied += writer->innerBson.len;
+	pgbson *result = CreatePgbsonfromBson_t(&(writer->innerBson), true);
+	if (writer->buffer != NULL)
+	{
+		pfree(writer->buffer - VARHDRSZ);
+		writer->buffer = NULL;
+	}
+
+	return result;
 }
 
 
@@ -1506,6 +1601,11 @@ void
 PgbsonWriterFree(pgbson_writer *writer)
 {
 	bson_destroy(&writer->innerBson);
+	if (writer->buffer != NULL)
+	{
+		pfree(writer->buffer - VARHDRSZ);
+		writer->buffer = NULL;
+	}
 }
 
 
@@ -1786,6 +1886,25 @@ CreatePgbsonfromBson_t(bson_t * document, bool destroyDocument)
 }
 
 
+/*
+ * Grows the buffer of a presized writer, keeping the room for the varlena
+ * header in front of it.
+ */
+static void *
+PresizedWriterRealloc(void *memory, size_t numBytes, void *context)
+{
+	if (memory == NULL)
+	{
+		return (char *) MemoryContextAlloc((MemoryContext) context,
+										   VARHDRSZ + numBytes) + VARHDRSZ;
+	}
+
+	WriterAllocationStats.presizedBufferGrowths++;
+	return (char *) repalloc((char *) memory - VARHDRSZ, VARHDRSZ + numBytes) +
+		   VARHDRSZ;
+}
+
+
 /*
  * Creates a pgbson structure from a raw buffer of bytes
  */
@@ -849,6 +849,9 @@ typedef struct RumScanEntryData
 
 	/* Optional used in skipscans */
 	Datum queryKeyOverride;
+
+	/* Number of times a partial match scan seeked past skippable entries */
+	uint32 numSkips;
 }   RumScanEntryData;
 
 typedef struct
@@ -983,6 +986,26 @@ extern int64 rumgetbitmap(IndexScanDesc scan, TIDBitmap *tbm);
 extern bool rumgettuple(IndexScanDesc scan, ScanDirection direction);
 extern void RumKillEntryItems(RumScanOpaque so, RumOrderByScanData *scanData);
 
+/*
+ * Result of visiting a chunk of the TIDs of an entry key in
+ * documentdb_rum_enumerate_entry_keys.
+ * CODESYNC: Keep in sync with IndexEntryKeyVisitResult in index_am_exports.h
+ */
+typedef enum RumEntryKeyVisitResult
+{
+	/* Send the next chunk of TIDs of the same key (if any) */
+	RumEntryKeyVisit_NextChunk = 0,
+
+	/* Done with the current key, move to the next one */
+	RumEntryKeyVisit_NextKey = 1,
+
+	/* Stop the enumeration */
+	RumEntryKeyVisit_Stop = 2,
+} RumEntryKeyVisitResult;
+
+typedef RumEntryKeyVisitResult (*RumEntryKeyVisitor)(Datum key, ItemPointerData *items,
+													 int32 numItems, void *state);
+
 /* rumvacuum.c */
 extern IndexBulkDeleteResult * rumbulkdelete(IndexVacuumInfo *info,
 											 IndexBulkDeleteResult *stats,
@@ -1003,7 +1026,26 @@ extern RumVacuumCycleId rum_vacuum_get_cycleId(Relation rel);
 extern bool rumvalidate(Oid opclassoid);
 
 /* rumvacuum.c */
+typedef struct RumPruneEmptyEntriesStats
+{
+	uint32 numEmptyPages;
+	uint32 numEmptyEntries;
+	uint32 numPrunedEntries;
+	uint32 numPrunedPages;
+	uint32 prunedEmptyPostingRoots;
+} RumPruneEmptyEntriesStats;
+
+extern uint64 RumVacuumNumParallelWorkersLaunched;
 extern void rumVacuumPruneEmptyEntries(Relation indexRel);
+extern BlockNumber rumVacuumPruneEmptyEntriesBatch(Relation indexRel,
+												   BlockNumber startBlkno,
+												   uint32 maxPages,
+												   RumPruneEmptyEntriesStats *stats);
+extern bool RumVacuumThrottleEnabled(void);
+extern void RumVacuumThrottleDelay(void);
+
+/* rum_background_prune.c */
+extern void RegisterRumBackgroundPruneWorker(void);
 
 /* rumbulk.c */
 #if PG_VERSION_NUM <= 100006 || PG_VERSION_NUM == 110000
@@ -1089,6 +1131,7 @@ extern PGDLLIMPORT bool RumSkipRetryOnDeletePage;
 extern PGDLLIMPORT bool RumForceOrderedIndexScan;
 extern PGDLLIMPORT bool RumPreferOrderedIndexScan;
 extern PGDLLIMPORT bool RumEnableSkipIntermediateEntry;
+extern PGDLLIMPORT bool RumEnablePartialMatchSkipScan;
 extern PGDLLIMPORT bool RumVacuumEntryItems;
 extern PGDLLIMPORT bool RumUseNewItemPtrDecoding;
 extern PGDLLIMPORT bool RumPruneEmptyPages;
@@ -1620,6 +1663,17 @@ extern Datum FunctionCall10Coll(FmgrInfo *flinfo, Oid collation,
 #define PROGRESS_RUM_PHASE_MERGE_2 6
 #define PROGRESS_RUM_PHASE_WRITE_WAL 7
 
+/*
+ * Progress reporting for vacuum. The vacuum command owns the lower progress
+ * parameters, so the RUM specific vacuum phase is tracked in the parameter
+ * following the scanned blocks.
+ */
+#define PROGRESS_RUM_VACUUM_PHASE (PROGRESS_SCAN_BLOCKS_DONE + 1)
+#define PROGRESS_RUM_VACUUM_PHASE_BULK_DELETE 1
+#define PROGRESS_RUM_VACUUM_PHASE_CLEANUP_SCAN 2
+#define PROGRESS_RUM_VACUUM_PHASE_CLEANUP_SCAN_PARALLEL 3
+#define PROGRESS_RUM_VACUUM_PHASE_VACUUM_FSM 4
+
 
 #define UNREDACTED_RUM_LOG_CODE MAKE_SQLSTATE('R', 'Z', 'Z', 'Z', 'Z')
 typedef int (*rum_format_log_hook)(const char *fmt, ...) pg_attribute_printf (1, 2);
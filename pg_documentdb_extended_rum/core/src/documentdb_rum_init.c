@@ -76,6 +76,9 @@ _PG_init(void)
 		InitializeCommonDocumentDBGUCs("documentdb_rum", "documentdb_rum");
 	}
 
+	/* Needs to happen after the GUCs are defined */
+	RegisterRumBackgroundPruneWorker();
+
 	MarkGUCPrefixReserved("documentdb_rum");
 }
 
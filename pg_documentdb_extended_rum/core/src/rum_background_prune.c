@@ -0,0 +1,331 @@
+/*-------------------------------------------------------------------------
+ *
+ * rum_background_prune.c
+ *	  background worker that prunes empty entries from RUM indexes
+ *	  independently of VACUUM.
+ *
+ * Portions Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * Vacuum only prunes empty entries as part of the bulk delete of an index,
+ * which on large indexes may not keep up with the rate at which entries
+ * become empty. This worker periodically walks the entry tree of each RUM
+ * index and prunes the empty entries (and optionally pages) in a throttled
+ * manner (see RumPruneEmptyEntriesPagesPerCycle) so that it doesn't compete
+ * with the foreground workload. The table and index locks are released
+ * while the worker sleeps between batches.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "miscadmin.h"
+
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "access/xact.h"
+#include "catalog/index.h"
+#include "catalog/pg_class.h"
+#include "commands/defrem.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lmgr.h"
+#include "tcop/tcopprot.h"
+#include "utils/backend_status.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+#include "utils/varlena.h"
+#include "utils/wait_event.h"
+
+#include "pg_documentdb_rum.h"
+
+extern bool RumEnableBackgroundPrune;
+extern int RumBackgroundPruneNaptimeSec;
+extern char *RumBackgroundPruneDatabase;
+extern char *RumBackgroundPruneAccessMethods;
+extern int RumPruneEmptyEntriesPagesPerCycle;
+
+#define RUM_BACKGROUND_PRUNE_WORKER_NAME "documentdb rum background prune"
+#define RUM_BACKGROUND_PRUNE_RESTART_SEC 60
+
+PGDLLEXPORT void documentdb_rum_background_prune_main(Datum main_arg);
+
+static void RunBackgroundPruneCycle(void);
+static List * GetBackgroundPruneIndexes(void);
+static void PruneEmptyEntriesOnIndex(Oid indexOid);
+static bool PruneEmptyEntriesBatchOnIndex(Oid indexOid, BlockNumber *blkno,
+										  RumPruneEmptyEntriesStats *stats);
+
+
+/*
+ * Registers the background prune worker. Must be called from _PG_init
+ * while the shared_preload_libraries are being processed.
+ */
+void
+RegisterRumBackgroundPruneWorker(void)
+{
+	BackgroundWorker worker;
+
+	if (!RumEnableBackgroundPrune)
+	{
+		return;
+	}
+
+	memset(&worker, 0, sizeof(BackgroundWorker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = RUM_BACKGROUND_PRUNE_RESTART_SEC;
+	strlcpy(worker.bgw_library_name, "pg_documentdb_extended_rum_core", BGW_MAXLEN);
+	strlcpy(worker.bgw_function_name, "documentdb_rum_background_prune_main",
+			BGW_MAXLEN);
+	strlcpy(worker.bgw_name, RUM_BACKGROUND_PRUNE_WORKER_NAME, BGW_MAXLEN);
+	strlcpy(worker.bgw_type, RUM_BACKGROUND_PRUNE_WORKER_NAME, BGW_MAXLEN);
+	worker.bgw_main_arg = (Datum) 0;
+	worker.bgw_notify_pid = 0;
+
+	RegisterBackgroundWorker(&worker);
+}
+
+
+/*
+ * Main loop of the background prune worker.
+ */
+PGDLLEXPORT void
+documentdb_rum_background_prune_main(Datum main_arg)
+{
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	BackgroundWorkerInitializeConnection(RumBackgroundPruneDatabase, NULL, 0);
+	pgstat_report_appname(RUM_BACKGROUND_PRUNE_WORKER_NAME);
+
+	elog(LOG, "%s started on database %s", RUM_BACKGROUND_PRUNE_WORKER_NAME,
+		 RumBackgroundPruneDatabase);
+
+	for (;;)
+	{
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 RumBackgroundPruneNaptimeSec * 1000L, PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		RunBackgroundPruneCycle();
+	}
+}
+
+
+/*
+ * Runs a single pass of pruning over all the RUM indexes in the database.
+ * Each index is pruned in its own transaction so that locks are not held
+ * across indexes.
+ */
+static void
+RunBackgroundPruneCycle(void)
+{
+	MemoryContext cycleContext = AllocSetContextCreate(TopMemoryContext,
+													   "RUM background prune context",
+													   ALLOCSET_DEFAULT_SIZES);
+	MemoryContext oldContext;
+	List *indexOids;
+	ListCell *cell;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	pgstat_report_activity(STATE_RUNNING, "collecting rum indexes to prune");
+
+	oldContext = MemoryContextSwitchTo(cycleContext);
+	indexOids = GetBackgroundPruneIndexes();
+	MemoryContextSwitchTo(oldContext);
+
+	CommitTransactionCommand();
+
+	foreach(cell, indexOids)
+	{
+		CHECK_FOR_INTERRUPTS();
+		PruneEmptyEntriesOnIndex(lfirst_oid(cell));
+	}
+
+	MemoryContextDelete(cycleContext);
+	pgstat_report_activity(STATE_IDLE, NULL);
+}
+
+
+/*
+ * Returns the list of indexes in the current database that belong to
+ * one of the access methods in RumBackgroundPruneAccessMethods.
+ */
+static List *
+GetBackgroundPruneIndexes(void)
+{
+	List *accessMethodNames = NIL;
+	List *accessMethodOids = NIL;
+	List *indexOids = NIL;
+	ListCell *cell;
+	Relation classRel;
+	SysScanDesc scan;
+	HeapTuple tuple;
+	char *accessMethods = pstrdup(RumBackgroundPruneAccessMethods);
+
+	if (!SplitIdentifierString(accessMethods, ',', &accessMethodNames))
+	{
+		ereport(WARNING, (errmsg("invalid list of access methods \"%s\" for %s",
+								 RumBackgroundPruneAccessMethods,
+								 RUM_BACKGROUND_PRUNE_WORKER_NAME)));
+		return NIL;
+	}
+
+	foreach(cell, accessMethodNames)
+	{
+		Oid amOid = get_index_am_oid((const char *) lfirst(cell), true);
+		if (OidIsValid(amOid))
+		{
+			accessMethodOids = lappend_oid(accessMethodOids, amOid);
+		}
+	}
+
+	if (accessMethodOids == NIL)
+	{
+		return NIL;
+	}
+
+	classRel = table_open(RelationRelationId, AccessShareLock);
+	scan = systable_beginscan(classRel, InvalidOid, false, NULL, 0, NULL);
+	while (HeapTupleIsValid(tuple = systable_getnext(scan)))
+	{
+		Form_pg_class classForm = (Form_pg_class) GETSTRUCT(tuple);
+
+		if (classForm->relkind != RELKIND_INDEX ||
+			classForm->relpersistence == RELPERSISTENCE_TEMP)
+		{
+			continue;
+		}
+
+		if (list_member_oid(accessMethodOids, classForm->relam))
+		{
+			indexOids = lappend_oid(indexOids, classForm->oid);
+		}
+	}
+
+	systable_endscan(scan);
+	table_close(classRel, AccessShareLock);
+
+	return indexOids;
+}
+
+
+/*
+ * Prunes the empty entries on a single index. When throttling is
+ * configured, the index is pruned in batches of
+ * RumPruneEmptyEntriesPagesPerCycle pages, each in its own transaction, and
+ * the locks are released while sleeping between batches so that VACUUM and
+ * DDL on the table are only held off for the duration of a batch.
+ */
+static void
+PruneEmptyEntriesOnIndex(Oid indexOid)
+{
+	RumPruneEmptyEntriesStats stats = { 0 };
+	BlockNumber blkno = RUM_ROOT_BLKNO;
+
+	while (PruneEmptyEntriesBatchOnIndex(indexOid, &blkno, &stats))
+	{
+		if (blkno == InvalidBlockNumber)
+		{
+			elog(DEBUG1, "%s found %u empty pages, %u empty entries, %u pruned entries, "
+						 "%u pruned pages on index %u", RUM_BACKGROUND_PRUNE_WORKER_NAME,
+				 stats.numEmptyPages, stats.numEmptyEntries, stats.numPrunedEntries,
+				 stats.numPrunedPages, indexOid);
+			return;
+		}
+
+		pgstat_report_activity(STATE_IDLE, NULL);
+		RumVacuumThrottleDelay();
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+
+/*
+ * Prunes the next batch of leaf entry pages of an index, starting with
+ * *blkno, and sets *blkno to the page the next batch starts with or to
+ * InvalidBlockNumber once the index is done. Returns false if the index
+ * was skipped because the table is being vacuumed (or is undergoing DDL)
+ * or the index was dropped: It'll be picked up on the next cycle.
+ */
+static bool
+PruneEmptyEntriesBatchOnIndex(Oid indexOid, BlockNumber *blkno,
+							  RumPruneEmptyEntriesStats *stats)
+{
+	Oid heapOid;
+	Relation indexRel;
+	bool isPruned = false;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+
+	heapOid = IndexGetRelation(indexOid, true);
+	if (!OidIsValid(heapOid))
+	{
+		CommitTransactionCommand();
+		return false;
+	}
+
+	/*
+	 * VACUUM holds ShareUpdateExclusiveLock on the table so this keeps us
+	 * from racing with it while still allowing concurrent writes.
+	 */
+	if (!ConditionalLockRelationOid(heapOid, ShareUpdateExclusiveLock))
+	{
+		CommitTransactionCommand();
+		return false;
+	}
+
+	if (!ConditionalLockRelationOid(indexOid, RowExclusiveLock))
+	{
+		CommitTransactionCommand();
+		return false;
+	}
+
+	/* The index may have been dropped since we collected it */
+	if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(indexOid)))
+	{
+		CommitTransactionCommand();
+		return false;
+	}
+
+	indexRel = index_open(indexOid, NoLock);
+	if (indexRel->rd_index->indisready && indexRel->rd_index->indisvalid)
+	{
+		uint32 pagesPerBatch = RumVacuumThrottleEnabled() ?
+							   (uint32) RumPruneEmptyEntriesPagesPerCycle : 0;
+
+		pgstat_report_activity(STATE_RUNNING, RelationGetRelationName(indexRel));
+
+		if (*blkno == RUM_ROOT_BLKNO)
+		{
+			RumStatsData statsData;
+
+			/* This call at least validates the meta page state */
+			rumGetStats(indexRel, &statsData);
+		}
+
+		*blkno = rumVacuumPruneEmptyEntriesBatch(indexRel, *blkno, pagesPerBatch,
+												 stats);
+		isPruned = true;
+	}
+
+	index_close(indexRel, NoLock);
+	CommitTransactionCommand();
+	return isPruned;
+}
@@ -47,6 +47,7 @@ PG_FUNCTION_INFO_V1(documentdb_rum_get_meta_page_info);
 PG_FUNCTION_INFO_V1(documentdb_rum_page_get_stats);
 PG_FUNCTION_INFO_V1(documentdb_rum_page_get_entries);
 PG_FUNCTION_INFO_V1(documentdb_rum_page_get_data_items);
+PG_FUNCTION_INFO_V1(documentdb_rum_vacuum_parallel_workers_launched);
 
 
 PGDLLEXPORT Datum
@@ -298,6 +299,17 @@ documentdb_rum_page_get_data_items(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * Returns the number of parallel workers launched by the vacuum cleanups
+ * that ran in this backend.
+ */
+PGDLLEXPORT Datum
+documentdb_rum_vacuum_parallel_workers_launched(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT64((int64) RumVacuumNumParallelWorkersLaunched);
+}
+
+
 static Jsonb *
 GetResultJsonB(int count, char **keys, JsonbValue *values)
 {
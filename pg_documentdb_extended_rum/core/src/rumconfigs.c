@@ -14,6 +14,7 @@
 #include "postgres.h"
 #include "utils/guc.h"
 #include "access/reloptions.h"
+#include "postmaster/bgworker_internals.h"
 #include "pg_documentdb_rum.h"
 
 /* Kind of relation optioms for rum index */
@@ -65,6 +66,10 @@ PGDLLEXPORT bool RumPreferOrderedIndexScan = RUM_DEFAULT_PREFER_ORDERED_INDEX_SC
 PGDLLEXPORT bool RumEnableSkipIntermediateEntry =
 	RUM_DEFAULT_ENABLE_SKIP_INTERMEDIATE_ENTRY;
 
+#define RUM_DEFAULT_ENABLE_PARTIAL_MATCH_SKIP_SCAN false
+PGDLLEXPORT bool RumEnablePartialMatchSkipScan =
+	RUM_DEFAULT_ENABLE_PARTIAL_MATCH_SKIP_SCAN;
+
 /* ruminsert.c */
 #define RUM_DEFAULT_ENABLE_PARALLEL_INDEX_BUILD true
 PGDLLEXPORT bool RumEnableParallelIndexBuild = RUM_DEFAULT_ENABLE_PARALLEL_INDEX_BUILD;
@@ -105,6 +110,37 @@ PGDLLEXPORT bool RumTraversePageOnlyOnBackTrack =
 PGDLLEXPORT bool RumSkipGlobalVisibilityCheckOnPrune =
 	RUM_DEFAULT_SKIP_GLOBAL_VISIBILITY_CHECK_ON_PRUNE;
 
+#define RUM_DEFAULT_VACUUM_PARALLEL_WORKERS 0
+PGDLLEXPORT int RumVacuumParallelWorkers = RUM_DEFAULT_VACUUM_PARALLEL_WORKERS;
+
+#define RUM_DEFAULT_VACUUM_PARALLEL_MIN_PAGES 8192
+PGDLLEXPORT int RumVacuumParallelMinPages = RUM_DEFAULT_VACUUM_PARALLEL_MIN_PAGES;
+
+#define RUM_DEFAULT_VACUUM_PREFETCH_DISTANCE 32
+PGDLLEXPORT int RumVacuumPrefetchDistance = RUM_DEFAULT_VACUUM_PREFETCH_DISTANCE;
+
+#define RUM_DEFAULT_PRUNE_EMPTY_ENTRIES_PAGES_PER_CYCLE 0
+PGDLLEXPORT int RumPruneEmptyEntriesPagesPerCycle =
+	RUM_DEFAULT_PRUNE_EMPTY_ENTRIES_PAGES_PER_CYCLE;
+
+#define RUM_DEFAULT_PRUNE_EMPTY_ENTRIES_CYCLE_DELAY_MS 10
+PGDLLEXPORT int RumPruneEmptyEntriesCycleDelayMs =
+	RUM_DEFAULT_PRUNE_EMPTY_ENTRIES_CYCLE_DELAY_MS;
+
+/* rum_background_prune.c */
+#define RUM_DEFAULT_ENABLE_BACKGROUND_PRUNE false
+PGDLLEXPORT bool RumEnableBackgroundPrune = RUM_DEFAULT_ENABLE_BACKGROUND_PRUNE;
+
+#define RUM_DEFAULT_BACKGROUND_PRUNE_NAPTIME_SEC 600
+PGDLLEXPORT int RumBackgroundPruneNaptimeSec = RUM_DEFAULT_BACKGROUND_PRUNE_NAPTIME_SEC;
+
+#define RUM_DEFAULT_BACKGROUND_PRUNE_DATABASE "postgres"
+PGDLLEXPORT char *RumBackgroundPruneDatabase = RUM_DEFAULT_BACKGROUND_PRUNE_DATABASE;
+
+#define RUM_DEFAULT_BACKGROUND_PRUNE_ACCESS_METHODS "documentdb_extended_rum"
+PGDLLEXPORT char *RumBackgroundPruneAccessMethods =
+	RUM_DEFAULT_BACKGROUND_PRUNE_ACCESS_METHODS;
+
 /* rumget.c */
 #define RUM_DEFAULT_ENABLE_SUPPORT_DEAD_INDEX_ITEMS false
 PGDLLEXPORT bool RumEnableSupportDeadIndexItems =
@@ -216,6 +252,15 @@ InitializeCommonDocumentDBGUCs(const char *rumGucPrefix, const
 		PGC_USERSET, 0,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		psprintf("%s.enablePartialMatchSkipScan", documentDBRumGucPrefix),
+		"Sets whether or not partial match (bitmap) scans seek past ranges of entries the opclass marks as skippable",
+		NULL,
+		&RumEnablePartialMatchSkipScan,
+		RUM_DEFAULT_ENABLE_PARTIAL_MATCH_SKIP_SCAN,
+		PGC_USERSET, 0,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		psprintf("%s.vacuum_cleanup_entries", documentDBRumGucPrefix),
 		"Sets whether or not to clean up entries during vacuuming",
@@ -333,6 +378,88 @@ InitializeCommonDocumentDBGUCs(const char *rumGucPrefix, const
 		RUM_DEFAULT_TRAVERSE_PAGE_ONLY_ON_BACKTRACK,
 		PGC_USERSET, 0,
 		NULL, NULL, NULL);
+	DefineCustomIntVariable(
+		psprintf("%s.vacuum_parallel_workers", documentDBRumGucPrefix),
+		"Sets the max number of parallel workers used for the vacuum cleanup of a single index (0 disables it)",
+		NULL,
+		&RumVacuumParallelWorkers,
+		RUM_DEFAULT_VACUUM_PARALLEL_WORKERS, 0, MAX_PARALLEL_WORKER_LIMIT,
+		PGC_USERSET, 0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.vacuum_parallel_min_pages", documentDBRumGucPrefix),
+		"Sets the min number of index pages per worker for the vacuum cleanup to run in parallel",
+		NULL,
+		&RumVacuumParallelMinPages,
+		RUM_DEFAULT_VACUUM_PARALLEL_MIN_PAGES, 0, INT_MAX,
+		PGC_USERSET, 0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.vacuum_prefetch_distance", documentDBRumGucPrefix),
+		"Sets the number of blocks to prefetch ahead of the vacuum scans (0 disables it)",
+		NULL,
+		&RumVacuumPrefetchDistance,
+		RUM_DEFAULT_VACUUM_PREFETCH_DISTANCE, 0, 1024,
+		PGC_USERSET, 0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.prune_empty_entries_pages_per_cycle", documentDBRumGucPrefix),
+		"Sets the number of entry pages pruned between throttling delays when pruning empty entries (0 disables throttling)",
+		NULL,
+		&RumPruneEmptyEntriesPagesPerCycle,
+		RUM_DEFAULT_PRUNE_EMPTY_ENTRIES_PAGES_PER_CYCLE, 0, INT_MAX,
+		PGC_USERSET, 0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.prune_empty_entries_cycle_delay_ms", documentDBRumGucPrefix),
+		"Sets the delay in milliseconds between throttled cycles when pruning empty entries",
+		NULL,
+		&RumPruneEmptyEntriesCycleDelayMs,
+		RUM_DEFAULT_PRUNE_EMPTY_ENTRIES_CYCLE_DELAY_MS, 0, INT_MAX,
+		PGC_USERSET, GUC_UNIT_MS,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		psprintf("%s.enable_background_prune_empty_entries", documentDBRumGucPrefix),
+		"Sets whether or not to run a background worker that prunes empty entries independently of vacuum",
+		NULL,
+		&RumEnableBackgroundPrune,
+		RUM_DEFAULT_ENABLE_BACKGROUND_PRUNE,
+		PGC_POSTMASTER, 0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		psprintf("%s.background_prune_empty_entries_naptime", documentDBRumGucPrefix),
+		"Sets the time in seconds between runs of the background prune of empty entries",
+		NULL,
+		&RumBackgroundPruneNaptimeSec,
+		RUM_DEFAULT_BACKGROUND_PRUNE_NAPTIME_SEC, 1, INT_MAX,
+		PGC_SIGHUP, GUC_UNIT_S,
+		NULL, NULL, NULL);
+
+	DefineCustomStringVariable(
+		psprintf("%s.background_prune_empty_entries_database", documentDBRumGucPrefix),
+		"Sets the database the background prune of empty entries connects to",
+		NULL,
+		&RumBackgroundPruneDatabase,
+		RUM_DEFAULT_BACKGROUND_PRUNE_DATABASE,
+		PGC_POSTMASTER, GUC_SUPERUSER_ONLY,
+		NULL, NULL, NULL);
+
+	DefineCustomStringVariable(
+		psprintf("%s.background_prune_empty_entries_access_methods",
+				 documentDBRumGucPrefix),
+		"Sets the comma separated list of index access methods whose indexes are pruned in the background",
+		NULL,
+		&RumBackgroundPruneAccessMethods,
+		RUM_DEFAULT_BACKGROUND_PRUNE_ACCESS_METHODS,
+		PGC_SIGHUP, GUC_SUPERUSER_ONLY,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		psprintf("%s.track_incomplete_split", documentDBRumGucPrefix),
 		"Sets whether or not to track incomplete splits",
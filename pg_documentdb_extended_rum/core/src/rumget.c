@@ -57,6 +57,12 @@ static void entryGetItem(RumState *rumstate, RumScanEntry entry, bool *nextEntry
 static void entryFindItem(RumState *rumstate, RumScanEntry entry, RumItem *item, Snapshot
 						  snapshot);
 
+extern PGDLLEXPORT void documentdb_rum_enumerate_entry_keys(Relation index,
+															OffsetNumber attnum,
+															Snapshot snapshot,
+															RumEntryKeyVisitor visitor,
+															void *state);
+
 /*
  * Extract key value for ordering.
  *
@@ -432,6 +438,89 @@ scanPostingTree(Relation index, RumScanEntry scanEntry,
 }
 
 
+/*
+ * Used by collectMatchBitmap when comparePartial indicates that the current
+ * entry starts a range that cannot match (cmp < -1). Asks the opclass for the
+ * next key that can match and repositions the stack at the first entry >= that
+ * key: within the current leaf if the key falls on it, otherwise by descending
+ * the entry tree again. Returns false if the opclass has no key to skip to,
+ * in which case the caller just moves to the next entry.
+ *
+ * On return the stack's buffer is locked, same as on entry. *skipKey holds
+ * the last key generated so that it can be freed on the next skip.
+ */
+static bool
+collectMatchSkipToNextRange(RumBtreeData *btree, RumBtreeStack *stack,
+							RumScanEntry scanEntry, Datum idatum, Datum *skipKey,
+							Snapshot snapshot)
+{
+	RumState *rumstate = btree->rumstate;
+	OffsetNumber attnum = scanEntry->attnumOrig;
+	Form_pg_attribute attr = RumTupleDescAttr(rumstate->origTupdesc, attnum - 1);
+	Page page = BufferGetPage(stack->buffer);
+	OffsetNumber targetOffset;
+	Datum nextKey;
+
+	nextKey = FunctionCall4Coll(&rumstate->outerOrderingFn[attnum - 1],
+								rumstate->supportCollation[attnum - 1],
+								idatum,
+								scanEntry->queryKey,
+								UInt16GetDatum(RumIndexTransform_IndexGenerateSkipBound),
+								PointerGetDatum(scanEntry->extra_data));
+	if (nextKey == (Datum) 0)
+	{
+		return false;
+	}
+
+	if (*skipKey != (Datum) 0 && !attr->attbyval)
+	{
+		pfree(DatumGetPointer(*skipKey));
+	}
+
+	*skipKey = nextKey;
+	btree->entryKey = nextKey;
+	btree->entryCategory = RUM_CAT_NORM_KEY;
+
+	if (!entryIsMoveRight(btree, page))
+	{
+		/* The next key is on this page, binary search forward to it */
+		entryLocateLeafEntryBounds(btree, page, stack->off,
+								   PageGetMaxOffsetNumber(page), &targetOffset);
+		if (targetOffset <= stack->off)
+		{
+			return false;
+		}
+
+		stack->off = targetOffset;
+	}
+	else
+	{
+		/*
+		 * The next key is past this page: descend from the root rather than
+		 * walk the leaves in between. In search mode the returned stack only
+		 * holds a buffer for the leaf, so swap that into the caller's stack.
+		 */
+		RumBtreeStack *newStack;
+
+		LockBuffer(stack->buffer, RUM_UNLOCK);
+		newStack = rumFindLeafPage(btree, NULL);
+		btree->findItem(btree, newStack);
+
+		ReleaseBuffer(stack->buffer);
+		stack->buffer = newStack->buffer;
+		stack->blkno = newStack->blkno;
+		stack->off = newStack->off;
+		newStack->buffer = InvalidBuffer;
+		freeRumBtreeStack(newStack);
+
+		PredicateLockPage(rumstate->index, stack->blkno, snapshot);
+	}
+
+	scanEntry->numSkips++;
+	return true;
+}
+
+
 /*
  * Collects TIDs into scanEntry->matchSortstate for all heap tuples that
  * match the search entry.  This supports three different match modes:
@@ -454,6 +543,8 @@ collectMatchBitmap(RumBtreeData *btree, RumBtreeStack *stack,
 	Form_pg_attribute attr;
 	FmgrInfo *cmp = NULL;
 	RumState *rumstate = btree->rumstate;
+	bool canSkipScan;
+	Datum skipKey = (Datum) 0;
 
 	if (rumstate->useAlternativeOrder &&
 		scanEntry->attnumOrig == rumstate->attrnAddToColumn)
@@ -486,6 +577,18 @@ collectMatchBitmap(RumBtreeData *btree, RumBtreeStack *stack,
 	attnum = scanEntry->attnumOrig;
 	attr = RumTupleDescAttr(rumstate->origTupdesc, attnum - 1);
 
+	/*
+	 * The opclass signals ranges that can be skipped with a comparePartial
+	 * result < -1 (e.g. a composite key with an unconstrained prefix whose
+	 * trailing bounds are exhausted for the current prefix). If it also
+	 * provides a transform to generate the next key to seek to, we can
+	 * skip over those ranges instead of walking every entry in them.
+	 */
+	canSkipScan = RumEnablePartialMatchSkipScan && scanEntry->isPartialMatch &&
+				  !rumstate->useAlternativeOrder &&
+				  rumstate->canOuterOrdering[attnum - 1] &&
+				  rumstate->outerOrderingFn[attnum - 1].fn_nargs == 4;
+
 	for (;;)
 	{
 		Page page;
@@ -559,6 +662,12 @@ collectMatchBitmap(RumBtreeData *btree, RumBtreeStack *stack,
 			{
 				return true;
 			}
+			else if (cmp < -1 && canSkipScan &&
+					 collectMatchSkipToNextRange(btree, stack, scanEntry, idatum,
+												 &skipKey, snapshot))
+			{
+				continue;
+			}
 			else if (cmp < 0)
 			{
 				stack->off++;
@@ -4802,3 +4911,322 @@ rumgettuple(IndexScanDesc scan, ScanDirection direction)
 
 	return false;
 }
+
+
+/* The copy of an entry key and its posting list for the visitor */
+typedef struct RumEntryKeyBatchItem
+{
+	Datum key;
+	ItemPointerData *items;
+	int32 numItems;
+} RumEntryKeyBatchItem;
+
+
+/*
+ * Ensures that the buffer of TIDs handed out to the entry key visitor can
+ * hold at least numItems TIDs.
+ */
+static ItemPointerData *
+ensureEntryKeyItemsCapacity(ItemPointerData *items, int32 *capacity,
+							int32 numItems)
+{
+	if (numItems <= *capacity)
+	{
+		return items;
+	}
+
+	while (*capacity < numItems)
+	{
+		*capacity *= 2;
+	}
+
+	return repalloc(items, sizeof(ItemPointerData) * (*capacity));
+}
+
+
+/*
+ * Moves the position of documentdb_rum_enumerate_entry_keys to the given key.
+ */
+static void
+setEntryKeyEnumerationPosition(Datum *lastKey, RumNullCategory *lastCategory,
+							   Datum key, Form_pg_attribute attr)
+{
+	if (*lastCategory == RUM_CAT_NORM_KEY && !attr->attbyval)
+	{
+		pfree(DatumGetPointer(*lastKey));
+	}
+
+	*lastKey = datumCopy(key, attr->attbyval, attr->attlen);
+	*lastCategory = RUM_CAT_NORM_KEY;
+}
+
+
+/*
+ * Hands the TIDs of a posting tree to the entry key visitor, one chunk per
+ * leaf page, until the visitor is done with the key. The TIDs of a page are
+ * copied and the page unlocked (but kept pinned) while the visitor runs; if
+ * a concurrent split moves some of them to the right page meanwhile, they
+ * are skipped there as they sort before the last TID visited.
+ */
+static RumEntryKeyVisitResult
+enumeratePostingTreeItems(Relation index, BlockNumber rootPostingTree,
+						  OffsetNumber attnum, RumState *rumstate, Datum key,
+						  Snapshot snapshot, RumEntryKeyVisitor visitor,
+						  void *state, ItemPointerData **items, int32 *capacity)
+{
+	RumPostingTreeScan *gdi;
+	RumEntryKeyVisitResult result = RumEntryKeyVisit_NextKey;
+	ItemPointerData lastItem;
+	Buffer buffer;
+
+	gdi = rumPrepareScanPostingTree(index, rootPostingTree, true,
+									ForwardScanDirection, attnum, rumstate);
+	buffer = rumScanBeginPostingTree(gdi, NULL);
+	IncrBufferRefCount(buffer); /* prevent unpin in freeRumBtreeStack */
+	freeRumBtreeStack(gdi->stack);
+	pfree(gdi);
+
+	PredicateLockPage(index, BufferGetBlockNumber(buffer), snapshot);
+	ItemPointerSetMin(&lastItem);
+
+	for (;;)
+	{
+		Page page = BufferGetPage(buffer);
+		OffsetNumber maxoff = RumDataPageMaxOff(page);
+		int32 numItems = 0;
+
+		if (RumPageIsNotDeleted(page) && maxoff >= FirstOffsetNumber &&
+			!IsDataPageDeadForKilledTuple(true, page))
+		{
+			Pointer ptr = RumDataPageGetData(page);
+			RumItem item;
+			OffsetNumber i;
+
+			*items = ensureEntryKeyItemsCapacity(*items, capacity, maxoff);
+
+			MemSet(&item, 0, sizeof(item));
+			ItemPointerSetMin(&item.iptr);
+			for (i = FirstOffsetNumber; i <= maxoff; i++)
+			{
+				ptr = rumDataPageLeafReadPointer(ptr, attnum, &item, rumstate);
+				if (ItemPointerCompare(&item.iptr, &lastItem) > 0)
+				{
+					(*items)[numItems++] = item.iptr;
+				}
+			}
+		}
+
+		if (numItems > 0)
+		{
+			lastItem = (*items)[numItems - 1];
+
+			LockBuffer(buffer, RUM_UNLOCK);
+			result = visitor(key, *items, numItems, state);
+			LockBuffer(buffer, RUM_SHARE);
+
+			if (result != RumEntryKeyVisit_NextChunk)
+			{
+				break;
+			}
+		}
+
+		if (RumPageRightMost(page))
+		{
+			result = RumEntryKeyVisit_NextKey;
+			break;
+		}
+
+		buffer = rumStep(buffer, index, RUM_SHARE, ForwardScanDirection);
+		PredicateLockPage(index, BufferGetBlockNumber(buffer), snapshot);
+	}
+
+	UnlockReleaseBuffer(buffer);
+	return result;
+}
+
+
+/*
+ * Walks the keys of the entry tree for the given attribute in key order and
+ * hands the TIDs of each key to the visitor: the posting list of the entry,
+ * or one chunk per leaf page of its posting tree. Callers can stop reading
+ * the TIDs of a key at any chunk, so this answers questions about the
+ * distinct keys of an index (the distinct values, or counts per value)
+ * without materializing the TIDs of every key like a full index scan.
+ *
+ * The keys and TIDs of a leaf page are copied, up to its first posting
+ * tree, and the visitor runs once the page is unlocked, so it can check
+ * the TIDs against the heap. Killed entries are skipped, but otherwise the
+ * TIDs are not checked against the snapshot: that's left to the visitor.
+ */
+extern PGDLLEXPORT void
+documentdb_rum_enumerate_entry_keys(Relation index, OffsetNumber attnum,
+									Snapshot snapshot, RumEntryKeyVisitor visitor,
+									void *state)
+{
+	RumState rumstate;
+	Form_pg_attribute attr;
+	ItemPointerData *items;
+	RumEntryKeyBatchItem *batch;
+	MemoryContext batchContext;
+	MemoryContext oldContext;
+	int32 capacity = 64;
+	Datum lastKey = (Datum) 0;
+	RumNullCategory lastCategory = RUM_CAT_EMPTY_QUERY;
+	bool done = false;
+
+	initRumState(&rumstate, index);
+	if (rumstate.useAlternativeOrder)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot enumerate entry keys of an index with "
+							   "alternative order")));
+	}
+
+	attr = RumTupleDescAttr(rumstate.origTupdesc, attnum - 1);
+	items = palloc(sizeof(ItemPointerData) * capacity);
+	batch = palloc(sizeof(RumEntryKeyBatchItem) * MaxIndexTuplesPerPage);
+	batchContext = AllocSetContextCreate(CurrentMemoryContext,
+										 "RumEnumerateEntryKeysContext",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	while (!done)
+	{
+		RumBtreeData btree;
+		RumBtreeStack *stack;
+		BlockNumber rootPostingTree = InvalidBlockNumber;
+		int32 numBatch = 0;
+		int32 i;
+		bool checkLastKey = lastCategory == RUM_CAT_NORM_KEY;
+
+		CHECK_FOR_INTERRUPTS();
+		MemoryContextReset(batchContext);
+
+		/*
+		 * (Re)position at the first entry >= the last key visited: For the
+		 * first pass the empty query category positions at the leftmost
+		 * entry of the attribute.
+		 */
+		rumPrepareEntryScan(&btree, attnum, lastKey, lastCategory, &rumstate);
+		btree.searchMode = true;
+		stack = rumFindLeafPage(&btree, NULL);
+		btree.findItem(&btree, stack);
+		PredicateLockPage(index, BufferGetBlockNumber(stack->buffer), snapshot);
+
+		for (;;)
+		{
+			Page page;
+			ItemId itemId;
+			IndexTuple itup;
+			Datum idatum;
+			RumNullCategory icategory;
+
+			/* Visit the entries copied so far before moving to the next page */
+			if (numBatch > 0 &&
+				stack->off > PageGetMaxOffsetNumber(BufferGetPage(stack->buffer)))
+			{
+				break;
+			}
+
+			if (!moveRightIfItNeeded(&btree, stack))
+			{
+				done = true;
+				break;
+			}
+
+			page = BufferGetPage(stack->buffer);
+			itemId = PageGetItemId(page, stack->off);
+			itup = (IndexTuple) PageGetItem(page, itemId);
+
+			if (rumtuple_get_attrnum(&rumstate, itup) != attnum)
+			{
+				done = true;
+				break;
+			}
+
+			idatum = rumtuple_get_key(&rumstate, itup, &icategory);
+
+			/* Null categories sort after all the keys of the attribute */
+			if (icategory != RUM_CAT_NORM_KEY)
+			{
+				done = true;
+				break;
+			}
+
+			if (checkLastKey)
+			{
+				checkLastKey = false;
+				if (rumCompareEntries(&rumstate, attnum, idatum, icategory,
+									  lastKey, lastCategory) == 0)
+				{
+					stack->off++;
+					continue;
+				}
+			}
+
+			if (IsEntryDeadForKilledTuple(true, itemId))
+			{
+				stack->off++;
+				continue;
+			}
+
+			if (RumIsPostingTree(itup))
+			{
+				/* Walked after the entries copied before it */
+				rootPostingTree = RumGetPostingTree(itup);
+				setEntryKeyEnumerationPosition(&lastKey, &lastCategory, idatum,
+											   attr);
+				break;
+			}
+
+			oldContext = MemoryContextSwitchTo(batchContext);
+			batch[numBatch].key = datumCopy(idatum, attr->attbyval, attr->attlen);
+			batch[numBatch].numItems = RumGetNPosting(itup);
+			batch[numBatch].items = palloc(sizeof(ItemPointerData) *
+										   Max(batch[numBatch].numItems, 1));
+			rumReadTuplePointers(&rumstate, attnum, itup, batch[numBatch].items);
+			MemoryContextSwitchTo(oldContext);
+
+			numBatch++;
+			stack->off++;
+		}
+
+		if (rootPostingTree == InvalidBlockNumber && numBatch > 0)
+		{
+			setEntryKeyEnumerationPosition(&lastKey, &lastCategory,
+										   batch[numBatch - 1].key, attr);
+		}
+
+		/*
+		 * Unlock the entry page (but keep it pinned so vacuum can't remove
+		 * the posting tree) while visiting, and descend again to the key
+		 * after the last one visited once done.
+		 */
+		LockBuffer(stack->buffer, RUM_UNLOCK);
+
+		for (i = 0; i < numBatch; i++)
+		{
+			if (visitor(batch[i].key, batch[i].items, batch[i].numItems, state) ==
+				RumEntryKeyVisit_Stop)
+			{
+				done = true;
+				rootPostingTree = InvalidBlockNumber;
+				break;
+			}
+		}
+
+		if (rootPostingTree != InvalidBlockNumber)
+		{
+			RumEntryKeyVisitResult result =
+				enumeratePostingTreeItems(index, rootPostingTree, attnum,
+										  &rumstate, lastKey, snapshot,
+										  visitor, state, &items, &capacity);
+			done = result == RumEntryKeyVisit_Stop;
+		}
+
+		freeRumBtreeStack(stack);
+	}
+
+	MemoryContextDelete(batchContext);
+	pfree(batch);
+	pfree(items);
+}
@@ -44,6 +44,13 @@ extern int RumParallelIndexWorkersOverride;
 
 extern PGDLLEXPORT void documentdb_rum_parallel_build_main(dsm_segment *seg,
 														   shm_toc *toc);
+extern PGDLLEXPORT void * documentdb_rum_shared_build_begin(Relation index,
+															int maxMemoryKb);
+extern PGDLLEXPORT void documentdb_rum_shared_build_add(void *sharedState,
+														ItemPointer tid,
+														Datum *values,
+														bool *isnull);
+extern PGDLLEXPORT double documentdb_rum_shared_build_end(void *sharedState);
 
 /* Magic numbers for parallel state sharing */
 #define PARALLEL_KEY_RUM_SHARED UINT64CONST(0xB000000000000001)
@@ -748,24 +755,18 @@ rumHeapTupleBulkInsert(RumBuildState *buildstate, OffsetNumber attnum,
 }
 
 
+/*
+ * Adds the entries of a heap tuple to the build accumulator, and dumps the
+ * accumulator to the index once it uses more than maxMemoryKb.
+ */
 static void
-rumBuildCallback(Relation index,
-#if PG_VERSION_NUM < 130000
-				 HeapTuple htup,
-#else
-				 ItemPointer tid,
-#endif
-				 Datum *values,
-				 bool *isnull, bool tupleIsAlive, void *state)
+rumBuildAddTuple(RumBuildState *buildstate, ItemPointer tid, Datum *values,
+				 bool *isnull, int maxMemoryKb)
 {
-	RumBuildState *buildstate = (RumBuildState *) state;
 	MemoryContext oldCtx;
 	int i;
 	Datum outerAddInfo = (Datum) 0;
 	bool outerAddInfoIsNull = true;
-#if PG_VERSION_NUM < 130000
-	ItemPointer tid = &htup->t_self;
-#endif
 
 	if (AttributeNumberIsValid(buildstate->rumstate.attrnAttachColumn))
 	{
@@ -784,7 +785,7 @@ rumBuildCallback(Relation index,
 	}
 
 	/* If we've maxed out our available memory, dump everything to the index */
-	if (buildstate->accum.allocatedMemory >= maintenance_work_mem * 1024L)
+	if (buildstate->accum.allocatedMemory >= maxMemoryKb * 1024L)
 	{
 		RumItem *items;
 		Datum key;
@@ -810,14 +811,62 @@ rumBuildCallback(Relation index,
 }
 
 
+static void
+rumBuildCallback(Relation index,
+#if PG_VERSION_NUM < 130000
+				 HeapTuple htup,
+#else
+				 ItemPointer tid,
+#endif
+				 Datum *values,
+				 bool *isnull, bool tupleIsAlive, void *state)
+{
+	RumBuildState *buildstate = (RumBuildState *) state;
+#if PG_VERSION_NUM < 130000
+	ItemPointer tid = &htup->t_self;
+#endif
+
+	rumBuildAddTuple(buildstate, tid, values, isnull, maintenance_work_mem);
+}
+
+
+/*
+ * Initializes the meta page and the (empty) root page of an index that is
+ * being built.
+ */
+static void
+rumInitBuildPages(Relation index, RumBuildState *buildstate)
+{
+	Buffer RootBuffer,
+		   MetaBuffer;
+
+	/* initialize the meta page */
+	MetaBuffer = RumNewBuffer(index);
+
+	/* initialize the root page */
+	RootBuffer = RumNewBuffer(index);
+
+	START_CRIT_SECTION();
+	RumInitMetabuffer(NULL, MetaBuffer, buildstate->rumstate.isBuild);
+	MarkBufferDirty(MetaBuffer);
+	RumInitBuffer(NULL, RootBuffer, RUM_LEAF, buildstate->rumstate.isBuild);
+	MarkBufferDirty(RootBuffer);
+
+	UnlockReleaseBuffer(MetaBuffer);
+	UnlockReleaseBuffer(RootBuffer);
+	END_CRIT_SECTION();
+
+	/* count the root as first entry page */
+	buildstate->buildStats.nEntryPages++;
+}
+
+
 IndexBuildResult *
 rumbuild(Relation heap, Relation index, struct IndexInfo *indexInfo)
 {
 	bool isParallelIndexCapable = true;
 	int i = 0;
 	RumBuildState buildstate;
-	Buffer RootBuffer,
-		   MetaBuffer;
 
 	if (RelationGetNumberOfBlocks(index) != 0)
 	{
@@ -840,24 +889,7 @@ rumbuild(Relation heap, Relation index, struct IndexInfo *indexInfo)
 	buildstate.bs_leader = NULL;
 	memset(&buildstate.tid, 0, sizeof(ItemPointerData));
 
-	/* initialize the meta page */
-	MetaBuffer = RumNewBuffer(index);
-
-	/* initialize the root page */
-	RootBuffer = RumNewBuffer(index);
-
-	START_CRIT_SECTION();
-	RumInitMetabuffer(NULL, MetaBuffer, buildstate.rumstate.isBuild);
-	MarkBufferDirty(MetaBuffer);
-	RumInitBuffer(NULL, RootBuffer, RUM_LEAF, buildstate.rumstate.isBuild);
-	MarkBufferDirty(RootBuffer);
-
-	UnlockReleaseBuffer(MetaBuffer);
-	UnlockReleaseBuffer(RootBuffer);
-	END_CRIT_SECTION();
-
-	/* count the root as first entry page */
-	buildstate.buildStats.nEntryPages++;
+	rumInitBuildPages(index, &buildstate);
 
 	/*
 	 * create a temporary memory context that is reset once for each tuple
@@ -906,26 +938,20 @@ rumbuild(Relation heap, Relation index, struct IndexInfo *indexInfo)
 }
 
 
-static IndexBuildResult *
-rumbuild_serial(Relation heap, Relation index, struct IndexInfo *indexInfo,
-				RumBuildState *buildstate)
+/*
+ * Dumps the remaining accumulated entries to the index, updates the metapage
+ * and writes the whole index to the WAL.
+ */
+static void
+rumFinishSerialBuild(Relation index, RumBuildState *buildstate)
 {
 	MemoryContext oldCtx;
-	IndexBuildResult *result;
 	RumItem *items;
 	Datum key;
 	RumNullCategory category;
 	uint32 nlist;
 	OffsetNumber attnum;
 	BlockNumber blkno;
-	double reltuples;
-
-	/*
-	 * Do the heap scan.  We disallow sync scan here because dataPlaceToPage
-	 * prefers to receive tuples in TID order.
-	 */
-	reltuples = IndexBuildHeapScan(heap, index, indexInfo, false,
-								   rumBuildCallback, (void *) buildstate);
 
 	/* dump remaining entries to the index */
 	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
@@ -968,6 +994,24 @@ rumbuild_serial(Relation heap, Relation index, struct IndexInfo *indexInfo,
 
 		UnlockReleaseBuffer(buffer);
 	}
+}
+
+
+static IndexBuildResult *
+rumbuild_serial(Relation heap, Relation index, struct IndexInfo *indexInfo,
+				RumBuildState *buildstate)
+{
+	IndexBuildResult *result;
+	double reltuples;
+
+	/*
+	 * Do the heap scan.  We disallow sync scan here because dataPlaceToPage
+	 * prefers to receive tuples in TID order.
+	 */
+	reltuples = IndexBuildHeapScan(heap, index, indexInfo, false,
+								   rumBuildCallback, (void *) buildstate);
+
+	rumFinishSerialBuild(index, buildstate);
 
 	/*
 	 * Return statistics
@@ -981,6 +1025,95 @@ rumbuild_serial(Relation heap, Relation index, struct IndexInfo *indexInfo,
 }
 
 
+/*
+ * State of an index built from tuples that the caller supplies
+ * (see documentdb_rum_shared_build_begin).
+ */
+typedef struct RumSharedBuildState
+{
+	RumBuildState buildstate;
+	Relation index;
+	int maxMemoryKb;
+} RumSharedBuildState;
+
+
+/*
+ * Starts building an index from tuples that the caller feeds it with
+ * documentdb_rum_shared_build_add rather than from a heap scan of its own.
+ * This lets one heap scan build several indexes of a table, each of which
+ * accumulates entries in up to maxMemoryKb before writing them out.
+ *
+ * The index must either have no pages yet, or have been built empty by an
+ * earlier begin/end pair (in which case it is filled in now). The index
+ * must stay open until documentdb_rum_shared_build_end.
+ */
+extern PGDLLEXPORT void *
+documentdb_rum_shared_build_begin(Relation index, int maxMemoryKb)
+{
+	RumSharedBuildState *state = palloc0(sizeof(RumSharedBuildState));
+	RumBuildState *buildstate = &state->buildstate;
+
+	state->index = index;
+	state->maxMemoryKb = Max(maxMemoryKb, 64);
+
+	initRumState(&buildstate->rumstate, index);
+	buildstate->rumstate.isBuild = true;
+
+	if (RelationGetNumberOfBlocks(index) == 0)
+	{
+		rumInitBuildPages(index, buildstate);
+	}
+	else
+	{
+		rumGetStats(index, &buildstate->buildStats);
+		if (buildstate->buildStats.nEntries != 0 ||
+			buildstate->buildStats.nDataPages != 0)
+		{
+			elog(ERROR, "index \"%s\" already contains data",
+				 RelationGetRelationName(index));
+		}
+	}
+
+	buildstate->tmpCtx = RumContextCreate(CurrentMemoryContext,
+										  "Rum shared build temporary context");
+	buildstate->funcCtx = RumContextCreate(CurrentMemoryContext,
+										   "Rum shared build temporary context for user-defined function");
+
+	buildstate->accum.rumstate = &buildstate->rumstate;
+	rumInitBA(&buildstate->accum);
+	return state;
+}
+
+
+/*
+ * Adds the entries of a heap tuple to an index started with
+ * documentdb_rum_shared_build_begin. Tuples are expected in TID order.
+ */
+extern PGDLLEXPORT void
+documentdb_rum_shared_build_add(void *sharedState, ItemPointer tid, Datum *values,
+								bool *isnull)
+{
+	RumSharedBuildState *state = (RumSharedBuildState *) sharedState;
+	rumBuildAddTuple(&state->buildstate, tid, values, isnull, state->maxMemoryKb);
+}
+
+
+/*
+ * Completes an index started with documentdb_rum_shared_build_begin and
+ * returns the number of entries written.
+ */
+extern PGDLLEXPORT double
+documentdb_rum_shared_build_end(void *sharedState)
+{
+	RumSharedBuildState *state = (RumSharedBuildState *) sharedState;
+	double indexTuples = state->buildstate.indtuples;
+
+	rumFinishSerialBuild(state->index, &state->buildstate);
+	pfree(state);
+	return indexTuples;
+}
+
+
 typedef struct
 {
 	dlist_node node;            /* linked list pointers */
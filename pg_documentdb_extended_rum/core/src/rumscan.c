@@ -182,6 +182,7 @@ rumFillScanEntry(RumScanOpaque so, OffsetNumber attnum,
 	scanEntry->useMarkAddInfo = false;
 	scanEntry->scanDirection = ForwardScanDirection;
 	scanEntry->predictNumberResult = 0;
+	scanEntry->numSkips = 0;
 	ItemPointerSetMin(&scanEntry->markAddInfo.iptr);
 
 	return scanEntry;
@@ -1338,6 +1339,7 @@ try_explain_documentdb_rum_index(IndexScanDesc scan, ExplainState *es)
 {
 	/* This function is called from explain.c */
 	int i, j;
+	uint64 numSkips;
 	List *entryList = NIL;
 	const char *scanType = "unknown";
 	RumScanOpaque so = (RumScanOpaque) scan->opaque;
@@ -1349,6 +1351,17 @@ try_explain_documentdb_rum_index(IndexScanDesc scan, ExplainState *es)
 							   so->killedItemsSkipped, es);
 	}
 
+	numSkips = 0;
+	for (i = 0; i < (int) so->totalentries; i++)
+	{
+		numSkips += so->entries[i]->numSkips;
+	}
+
+	if (numSkips > 0)
+	{
+		ExplainPropertyInteger("entryRangeSkips", "skips", numSkips, es);
+	}
+
 	if (scan->parallel_scan != NULL)
 	{
 		ExplainPropertyBool("parallelScanCapable", so->isParallelEnabled, es);
@@ -14,15 +14,23 @@
 #include "postgres.h"
 #include "miscadmin.h"
 
+#include "access/parallel.h"
 #include "commands/progress.h"
 #include "commands/vacuum.h"
 #include "commands/progress.h"
+#include "pgstat.h"
+#include "port/atomics.h"
 #include "postmaster/autovacuum.h"
 #include "storage/indexfsm.h"
+#include "storage/latch.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
 #include "storage/ipc.h"
+#include "storage/shm_toc.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
 #include "utils/backend_progress.h"
+#include "utils/wait_event.h"
 
 #include "pg_documentdb_rum.h"
 
@@ -41,6 +49,31 @@ extern bool RumEnableNewBulkDelete;
 extern bool RumVacuumSkipPrunePostingTreePages;
 extern bool RumTraversePageOnlyOnBackTrack;
 extern bool RumSkipGlobalVisibilityCheckOnPrune;
+extern int RumVacuumParallelWorkers;
+extern int RumVacuumParallelMinPages;
+extern int RumVacuumPrefetchDistance;
+extern int RumPruneEmptyEntriesPagesPerCycle;
+extern int RumPruneEmptyEntriesCycleDelayMs;
+
+extern PGDLLEXPORT void documentdb_rum_parallel_vacuum_main(dsm_segment *seg,
+															shm_toc *toc);
+
+/* Magic numbers for parallel vacuum state sharing */
+#define PARALLEL_KEY_RUM_VACUUM_SHARED UINT64CONST(0xB000000000000011)
+#define PARALLEL_KEY_RUM_VACUUM_QUERY_TEXT UINT64CONST(0xB000000000000012)
+
+/*
+ * Number of blocks handed out to a parallel vacuum participant at a time.
+ * Large enough to amortize the atomic fetch, small enough that the tail of
+ * the index is spread evenly across the workers.
+ */
+#define RUM_VACUUM_PARALLEL_CHUNK_SIZE 64
+
+/*
+ * The number of parallel workers launched by the vacuum cleanups run in
+ * this backend (see documentdb_rum_vacuum_parallel_workers_launched).
+ */
+uint64 RumVacuumNumParallelWorkersLaunched = 0;
 
 typedef struct
 {
@@ -72,6 +105,35 @@ typedef struct RumVacuumStatistics
 	uint32_t numPagesSkippedForBackTrack;
 } RumVacuumStatistics;
 
+/*
+ * State shared between the leader and the workers of a parallel
+ * vacuum cleanup. Each participant claims chunks of blocks from
+ * nextBlock and vacuums the pages in that range (and the posting trees
+ * rooted on its leaf entry pages).
+ */
+typedef struct RumVacuumParallelShared
+{
+	/* Immutable state set up by the leader */
+	Oid indexrelid;
+	BlockNumber npages;
+	BlockNumber chunkSize;
+	bool inlineVacuumBulkDelDataPages;
+
+	/* The next block to hand out to a participant */
+	pg_atomic_uint32 nextBlock;
+
+	/* The number of blocks processed across all participants */
+	pg_atomic_uint32 blocksDone;
+
+	/* Aggregated results of all participants - protected by mutex */
+	slock_t mutex;
+	int nparticipantsdone;
+	RumStatsData idxStat;
+	BlockNumber totFreePages;
+	BlockNumber pagesDeleted;
+	RumVacuumStatistics vacStats;
+} RumVacuumParallelShared;
+
 typedef struct RumPostingTreeDeleteEntry
 {
 	RumItem pageMaxItem;
@@ -89,6 +151,18 @@ static void LogFinalVacuumState(Relation index, RumVacuumStatistics *stats,
 static void TraverseAndPrunePostingTrees(RumVacuumState *gvs, Page page, Buffer buffer,
 										 BlockNumber currentBlockNo,
 										 RumVacuumStatistics *vacStats);
+static void rumVacuumCleanupPage(RumVacuumState *gvs, BlockNumber blkno,
+								 RumStatsData *idxStat, BlockNumber *totFreePages,
+								 RumVacuumStatistics *vacStats);
+static bool rumVacuumCleanupParallel(IndexVacuumInfo *info, RumVacuumState *gvs,
+									 BlockNumber npages, RumStatsData *idxStat,
+									 BlockNumber *totFreePages,
+									 RumVacuumStatistics *vacStats);
+static void rumVacuumCleanupParallelScan(RumVacuumState *gvs,
+										 RumVacuumParallelShared *shared,
+										 bool isLeader);
+static void RumVacuumAccumulateStats(RumVacuumStatistics *target,
+									 const RumVacuumStatistics *source);
 
 inline static bool
 IsCurrentVacuumCycleId(RumVacuumState *gvs, Page page)
@@ -99,6 +173,36 @@ IsCurrentVacuumCycleId(RumVacuumState *gvs, Page page)
 }
 
 
+/*
+ * Issues asynchronous read-ahead for the blocks following scanblkno (up to
+ * endblkno) so that the physical order vacuum scans don't stall on a
+ * synchronous read for every page. prefetchblkno tracks how far ahead
+ * we've already prefetched.
+ */
+inline static void
+RumVacuumPrefetchBlocks(Relation index, BlockNumber scanblkno, BlockNumber endblkno,
+						BlockNumber *prefetchblkno)
+{
+	BlockNumber targetblkno;
+
+	if (RumVacuumPrefetchDistance <= 0)
+	{
+		return;
+	}
+
+	targetblkno = Min(endblkno, scanblkno + (BlockNumber) RumVacuumPrefetchDistance);
+	if (*prefetchblkno <= scanblkno)
+	{
+		*prefetchblkno = scanblkno + 1;
+	}
+
+	for (; *prefetchblkno < targetblkno; (*prefetchblkno)++)
+	{
+		(void) PrefetchBuffer(index, MAIN_FORKNUM, *prefetchblkno);
+	}
+}
+
+
 /*
  * Cleans array of ItemPointer (removes dead pointers)
  * Results are always stored in *cleaned, which will be allocated
@@ -1681,19 +1785,80 @@ rumPruneEmptyEntriesInEntryPage(Buffer buffer, RumState *rumState, bool *isEmpty
 }
 
 
+/*
+ * Prunes the empty entries (and with RumPruneEmptyPages the empty pages) of
+ * the leaf entry pages of the index, throttled as configured by
+ * RumPruneEmptyEntriesPagesPerCycle.
+ */
 void
 rumVacuumPruneEmptyEntries(Relation index)
 {
+	RumPruneEmptyEntriesStats stats = { 0 };
 	BlockNumber blkno = RUM_ROOT_BLKNO;
+	uint32 pagesPerBatch = RumVacuumThrottleEnabled() ?
+						   (uint32) RumPruneEmptyEntriesPagesPerCycle : 0;
+
+	for (;;)
+	{
+		blkno = rumVacuumPruneEmptyEntriesBatch(index, blkno, pagesPerBatch, &stats);
+		if (blkno == InvalidBlockNumber)
+		{
+			break;
+		}
+
+		/* Yield to the foreground workload between batches */
+		RumVacuumThrottleDelay();
+	}
+
+	elog(INFO,
+		 "Vacuum found %u empty pages, %u empty entries, %u pruned entries, %u pruned pages, %u pruned posting trees",
+		 stats.numEmptyPages, stats.numEmptyEntries, stats.numPrunedEntries,
+		 stats.numPrunedPages, stats.prunedEmptyPostingRoots);
+}
+
+
+/*
+ * Prunes the empty entries of up to maxPages leaf entry pages (all of them
+ * if maxPages is 0), starting with startBlkno or with the leftmost leaf page
+ * if startBlkno is RUM_ROOT_BLKNO, and adds what it found to stats.
+ * Returns the leaf page to resume from, or InvalidBlockNumber once the
+ * rightmost page was pruned.
+ *
+ * No lock is held across calls, so callers can release their relation locks
+ * in between. Deleted pages keep their right links, so a resumed walk still
+ * reaches the pages right of it. If the page to resume from was recycled
+ * into something other than a leaf entry page, the walk ends early: the
+ * remaining pages are picked up by the next pass.
+ */
+BlockNumber
+rumVacuumPruneEmptyEntriesBatch(Relation index, BlockNumber startBlkno,
+								uint32 maxPages, RumPruneEmptyEntriesStats *stats)
+{
+	BlockNumber blkno = startBlkno;
 	Buffer buffer;
 	RumState rumState;
-	uint32 numEmptyPages = 0, numEmptyEntries = 0, numPrunedEntries = 0, numPrunedPages =
-		0,
-		   prunedEmptyPostingRoots = 0;
+	uint32 numPages = 0;
 
 	initRumState(&rumState, index);
 
-	buffer = rumFindLeftMostLeafPage(index, blkno, NULL);
+	if (startBlkno == RUM_ROOT_BLKNO)
+	{
+		buffer = rumFindLeftMostLeafPage(index, blkno, NULL);
+	}
+	else
+	{
+		Page page;
+
+		buffer = ReadBufferExtended(index, MAIN_FORKNUM, blkno,
+									RBM_NORMAL, NULL);
+		LockBuffer(buffer, RUM_EXCLUSIVE);
+		page = BufferGetPage(buffer);
+		if (PageIsNew(page) || RumPageIsData(page) || !RumPageIsLeaf(page))
+		{
+			UnlockReleaseBuffer(buffer);
+			return InvalidBlockNumber;
+		}
+	}
 
 	/* right now we found leftmost page in entry's BTree */
 	for (;;)
@@ -1705,8 +1870,8 @@ rumVacuumPruneEmptyEntries(Relation index)
 
 		Assert(!RumPageIsData(page));
 		resPage = rumPruneEmptyEntriesInEntryPage(buffer, &rumState, &isEmptyPage,
-												  &numEmptyEntries,
-												  &numPrunedEntries);
+												  &stats->numEmptyEntries,
+												  &stats->numPrunedEntries);
 
 		currentBlockNo = blkno;
 		blkno = RumPageGetOpaque(page)->rightlink;
@@ -1728,7 +1893,7 @@ rumVacuumPruneEmptyEntries(Relation index)
 
 		if (isEmptyPage)
 		{
-			numEmptyPages++;
+			stats->numEmptyPages++;
 		}
 
 		if (blkno == InvalidBlockNumber)        /* rightmost page */
@@ -1740,12 +1905,18 @@ rumVacuumPruneEmptyEntries(Relation index)
 		{
 			BufferAccessStrategy bufferStrategy = NULL;
 			if (CheckAndPruneEmptyRumPage(&rumState, bufferStrategy, currentBlockNo,
-										  &prunedEmptyPostingRoots))
+										  &stats->prunedEmptyPostingRoots))
 			{
-				numPrunedPages++;
+				stats->numPrunedPages++;
 			}
 		}
 
+		numPages++;
+		if (maxPages > 0 && numPages >= maxPages)
+		{
+			return blkno;
+		}
+
 		/* Check for interrupts before locking the next buffer */
 		CHECK_FOR_INTERRUPTS();
 		buffer = ReadBufferExtended(index, MAIN_FORKNUM, blkno,
@@ -1753,10 +1924,7 @@ rumVacuumPruneEmptyEntries(Relation index)
 		LockBuffer(buffer, RUM_EXCLUSIVE);
 	}
 
-	elog(INFO,
-		 "Vacuum found %u empty pages, %u empty entries, %u pruned entries, %u pruned pages, %u pruned posting trees",
-		 numEmptyPages, numEmptyEntries, numPrunedEntries, numPrunedPages,
-		 prunedEmptyPostingRoots);
+	return InvalidBlockNumber;
 }
 
 
@@ -1878,77 +2046,22 @@ rumvacuumcleanup(IndexVacuumInfo *info, IndexBulkDeleteResult *stats)
 								 0);
 	totFreePages = 0;
 
-	for (blkno = RUM_ROOT_BLKNO; blkno < npages; blkno++)
+	if (!rumVacuumCleanupParallel(info, &gvs, npages, &idxStat, &totFreePages,
+								  &vacStats))
 	{
-		Buffer buffer;
-		Page page;
-		bool releaseBuffer = true;
-
-		RumVacuumDelayPointCompat();
-
-		buffer = ReadBufferExtended(index, MAIN_FORKNUM, blkno,
-									RBM_NORMAL, info->strategy);
-		LockBuffer(buffer, RUM_SHARE);
-		page = (Page) BufferGetPage(buffer);
+		BlockNumber prefetchblkno = RUM_ROOT_BLKNO;
 
-		if (PageIsNew(page))
+		pgstat_progress_update_param(PROGRESS_RUM_VACUUM_PHASE,
+									 PROGRESS_RUM_VACUUM_PHASE_CLEANUP_SCAN);
+		gvs.strategy = info->strategy;
+		for (blkno = RUM_ROOT_BLKNO; blkno < npages; blkno++)
 		{
-			Assert(blkno != RUM_ROOT_BLKNO);
-			RecordFreeIndexPage(index, blkno);
-			totFreePages++;
-		}
-		else if (RumPageIsRecyclable(page))
-		{
-			if (!RumPageIsDeleted(page) && RumPruneEmptyPages)
-			{
-				/* Mark the page as explicitly deleted */
-				LockBuffer(buffer, RUM_UNLOCK);
-				LockBuffer(buffer, RUM_EXCLUSIVE);
-				RumPageMarkAsDeleted(info->index, buffer);
-			}
+			RumVacuumPrefetchBlocks(index, blkno, npages, &prefetchblkno);
+			rumVacuumCleanupPage(&gvs, blkno, &idxStat, &totFreePages, &vacStats);
 
-			Assert(blkno != RUM_ROOT_BLKNO);
-			RecordFreeIndexPage(index, blkno);
-			totFreePages++;
-		}
-		else if (RumPageIsData(page))
-		{
-			idxStat.nDataPages++;
+			pgstat_progress_update_param(PROGRESS_SCAN_BLOCKS_DONE,
+										 blkno);
 		}
-		else
-		{
-			idxStat.nEntryPages++;
-
-			if (RumPageIsLeaf(page))
-			{
-				if (gvs.inlineVacuumBulkDelDataPages &&
-					!RumVacuumSkipPrunePostingTreePages)
-				{
-					/* If we did an inline bulk delete of data pages, then
-					 * We will have empty data pages that are still parented
-					 * to their posting trees. We don't want to prune them in
-					 * bulk delete since that would happen with multiple cycles
-					 * on large indexes. Instead we do the pruning as part of the
-					 * vacuumcleanup once per vacuum cycle here.
-					 * As part of that, if the page becomes empty, we apply page
-					 * deletion to the page.
-					 * TraverseAndPrunePostingTrees will release the buffer as well.
-					 */
-					releaseBuffer = false;
-					TraverseAndPrunePostingTrees(&gvs, page, buffer, blkno, &vacStats);
-				}
-
-				idxStat.nEntries += PageGetMaxOffsetNumber(page);
-			}
-		}
-
-		if (releaseBuffer)
-		{
-			UnlockReleaseBuffer(buffer);
-		}
-
-		pgstat_progress_update_param(PROGRESS_SCAN_BLOCKS_DONE,
-									 blkno);
 	}
 
 	/* Update the metapage with accurate page and entry counts */
@@ -1956,6 +2069,8 @@ rumvacuumcleanup(IndexVacuumInfo *info, IndexBulkDeleteResult *stats)
 	rumUpdateStats(info->index, &idxStat, false);
 
 	/* Finally, vacuum the FSM */
+	pgstat_progress_update_param(PROGRESS_RUM_VACUUM_PHASE,
+								 PROGRESS_RUM_VACUUM_PHASE_VACUUM_FSM);
 	IndexFreeSpaceMapVacuum(info->index);
 
 	stats->pages_free = totFreePages;
@@ -2189,6 +2304,7 @@ rum_bulk_delete_new_core(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 	RumVacuumState gvs;
 	BlockNumber num_pages;
 	BlockNumber scanblkno;
+	BlockNumber prefetchblkno;
 	BlockNumber blocks_done;
 	bool isVacuumCleanup = false;
 	bool isNewBulkDelete = true;
@@ -2204,10 +2320,14 @@ rum_bulk_delete_new_core(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 	/* we'll re-count the tuples each time */
 	stats->num_index_tuples = 0;
 
+	pgstat_progress_update_param(PROGRESS_RUM_VACUUM_PHASE,
+								 PROGRESS_RUM_VACUUM_PHASE_BULK_DELETE);
+
 	/*
 	 * For more details on this loop see btvacuumscan.
 	 */
 	scanblkno = RUM_ROOT_BLKNO;
+	prefetchblkno = RUM_ROOT_BLKNO;
 	blocks_done = 0;
 	for (;;)
 	{
@@ -2226,6 +2346,7 @@ rum_bulk_delete_new_core(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 		/* Iterate over pages, then loop back to recheck length */
 		for (; scanblkno < num_pages; scanblkno++)
 		{
+			RumVacuumPrefetchBlocks(rel, scanblkno, num_pages, &prefetchblkno);
 			rum_vacuum_page_new(&gvs, scanblkno, &vacStats, &blocks_done);
 
 			pgstat_progress_update_param(PROGRESS_SCAN_BLOCKS_DONE, scanblkno);
@@ -2577,3 +2698,377 @@ TraverseAndPrunePostingTrees(RumVacuumState *gvs, Page page, Buffer buffer,
 								  currentBlockNo, &vacStats->prunedEmptyPostingRoots);
 	}
 }
+
+
+/*
+ * Vacuums a single page as part of rumvacuumcleanup: Records free and
+ * recyclable pages in the FSM, prunes the posting trees rooted on leaf
+ * entry pages (if the bulk delete vacuumed the data pages inline) and
+ * tracks the page statistics for the metapage.
+ */
+static void
+rumVacuumCleanupPage(RumVacuumState *gvs, BlockNumber blkno, RumStatsData *idxStat,
+					 BlockNumber *totFreePages, RumVacuumStatistics *vacStats)
+{
+	Relation index = gvs->index;
+	Buffer buffer;
+	Page page;
+	bool releaseBuffer = true;
+
+	RumVacuumDelayPointCompat();
+
+	buffer = ReadBufferExtended(index, MAIN_FORKNUM, blkno,
+								RBM_NORMAL, gvs->strategy);
+	LockBuffer(buffer, RUM_SHARE);
+	page = (Page) BufferGetPage(buffer);
+
+	if (PageIsNew(page))
+	{
+		Assert(blkno != RUM_ROOT_BLKNO);
+		RecordFreeIndexPage(index, blkno);
+		(*totFreePages)++;
+	}
+	else if (RumPageIsRecyclable(page))
+	{
+		if (!RumPageIsDeleted(page) && RumPruneEmptyPages)
+		{
+			/* Mark the page as explicitly deleted */
+			LockBuffer(buffer, RUM_UNLOCK);
+			LockBuffer(buffer, RUM_EXCLUSIVE);
+			RumPageMarkAsDeleted(index, buffer);
+		}
+
+		Assert(blkno != RUM_ROOT_BLKNO);
+		RecordFreeIndexPage(index, blkno);
+		(*totFreePages)++;
+	}
+	else if (RumPageIsData(page))
+	{
+		idxStat->nDataPages++;
+	}
+	else
+	{
+		idxStat->nEntryPages++;
+
+		if (RumPageIsLeaf(page))
+		{
+			/* Track the entries before the buffer is potentially released below */
+			idxStat->nEntries += PageGetMaxOffsetNumber(page);
+
+			if (gvs->inlineVacuumBulkDelDataPages &&
+				!RumVacuumSkipPrunePostingTreePages)
+			{
+				/* If we did an inline bulk delete of data pages, then
+				 * We will have empty data pages that are still parented
+				 * to their posting trees. We don't want to prune them in
+				 * bulk delete since that would happen with multiple cycles
+				 * on large indexes. Instead we do the pruning as part of the
+				 * vacuumcleanup once per vacuum cycle here.
+				 * As part of that, if the page becomes empty, we apply page
+				 * deletion to the page.
+				 * TraverseAndPrunePostingTrees will release the buffer as well.
+				 */
+				releaseBuffer = false;
+				TraverseAndPrunePostingTrees(gvs, page, buffer, blkno, vacStats);
+			}
+		}
+	}
+
+	if (releaseBuffer)
+	{
+		UnlockReleaseBuffer(buffer);
+	}
+}
+
+
+/*
+ * Returns the number of parallel workers to use for the vacuum cleanup
+ * scan of the index. Returns 0 if the cleanup should be done serially.
+ */
+static int
+RumVacuumCleanupParallelWorkers(Relation index, BlockNumber npages)
+{
+	int nworkers;
+	BlockNumber minPages;
+
+	if (RumVacuumParallelWorkers <= 0 || max_parallel_maintenance_workers <= 0)
+	{
+		return 0;
+	}
+
+	/*
+	 * If we're already in a parallel operation (e.g. this is a parallel vacuum
+	 * where Postgres spreads the indexes across workers) or the index is local
+	 * to this backend, we can't launch our own workers.
+	 */
+	if (IsInParallelMode() || RELATION_IS_LOCAL(index))
+	{
+		return 0;
+	}
+
+	minPages = (BlockNumber) Max(RumVacuumParallelMinPages, 1);
+	if (npages < minPages)
+	{
+		return 0;
+	}
+
+	/* Give each worker at least minPages worth of the index to vacuum */
+	nworkers = Min(RumVacuumParallelWorkers, max_parallel_maintenance_workers);
+	if ((BlockNumber) nworkers > npages / minPages)
+	{
+		nworkers = (int) (npages / minPages);
+	}
+
+	return nworkers;
+}
+
+
+/*
+ * Runs the vacuum cleanup scan of the index in parallel: the pages are
+ * sharded across the leader and a set of parallel workers in chunks of
+ * blocks, and each participant vacuums the pages of its chunks as the
+ * serial scan does. Every block is visited by exactly one participant, and
+ * a posting tree is only pruned by the participant that owns the leaf entry
+ * page it is rooted on. The page changes take the same buffer locks as the
+ * serial scan, which already runs concurrently with inserts and scans: the
+ * deletion of empty entry pages finds the page again from the root and
+ * locks its siblings left to right, so participants pruning neighbouring
+ * pages wait on each other as they would on an insert.
+ * Returns false if the scan could not be run in parallel, in which case
+ * the caller must do the serial scan.
+ */
+static bool
+rumVacuumCleanupParallel(IndexVacuumInfo *info, RumVacuumState *gvs,
+						 BlockNumber npages, RumStatsData *idxStat,
+						 BlockNumber *totFreePages, RumVacuumStatistics *vacStats)
+{
+	ParallelContext *pcxt;
+	RumVacuumParallelShared *shared;
+	int nworkers;
+	int querylen = 0;
+
+	nworkers = RumVacuumCleanupParallelWorkers(info->index, npages);
+	if (nworkers <= 0)
+	{
+		return false;
+	}
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("pg_documentdb_extended_rum_core",
+								 "documentdb_rum_parallel_vacuum_main",
+								 nworkers);
+
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(RumVacuumParallelShared));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial cleanup) */
+	if (pcxt->seg == NULL)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return false;
+	}
+
+	shared = (RumVacuumParallelShared *) shm_toc_allocate(pcxt->toc,
+														  sizeof(RumVacuumParallelShared));
+	memset(shared, 0, sizeof(RumVacuumParallelShared));
+	shared->indexrelid = RelationGetRelid(info->index);
+	shared->npages = npages;
+	shared->chunkSize = RUM_VACUUM_PARALLEL_CHUNK_SIZE;
+	shared->inlineVacuumBulkDelDataPages = gvs->inlineVacuumBulkDelDataPages;
+	pg_atomic_init_u32(&shared->nextBlock, RUM_ROOT_BLKNO);
+	pg_atomic_init_u32(&shared->blocksDone, 0);
+	SpinLockInit(&shared->mutex);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_RUM_VACUUM_SHARED, shared);
+
+	if (debug_query_string)
+	{
+		char *sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_RUM_VACUUM_QUERY_TEXT, sharedquery);
+	}
+
+	LaunchParallelWorkers(pcxt);
+	pgstat_progress_update_param(PROGRESS_RUM_VACUUM_PHASE,
+								 PROGRESS_RUM_VACUUM_PHASE_CLEANUP_SCAN_PARALLEL);
+
+	/*
+	 * The leader always participates: This ensures the scan completes even if
+	 * none of the workers could be launched.
+	 */
+	gvs->strategy = info->strategy;
+	rumVacuumCleanupParallelScan(gvs, shared, true);
+
+	WaitForParallelWorkersToFinish(pcxt);
+
+	/* All participants are done - the aggregated state can be read without the lock */
+	idxStat->nEntryPages += shared->idxStat.nEntryPages;
+	idxStat->nDataPages += shared->idxStat.nDataPages;
+	idxStat->nEntries += shared->idxStat.nEntries;
+	*totFreePages += shared->totFreePages;
+	gvs->result->pages_deleted += shared->pagesDeleted;
+	RumVacuumAccumulateStats(vacStats, &shared->vacStats);
+	RumVacuumNumParallelWorkersLaunched += pcxt->nworkers_launched;
+
+	elog(DEBUG1, "Rum vacuum cleanup of index %u used %d parallel workers "
+				 "(%d requested) across %d participants",
+		 shared->indexrelid, pcxt->nworkers_launched, nworkers,
+		 shared->nparticipantsdone);
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+	return true;
+}
+
+
+/*
+ * The per participant loop of the parallel vacuum cleanup: Claims chunks of
+ * blocks until the index is exhausted and then publishes the statistics
+ * gathered to the shared state.
+ */
+static void
+rumVacuumCleanupParallelScan(RumVacuumState *gvs, RumVacuumParallelShared *shared,
+							 bool isLeader)
+{
+	RumStatsData idxStat = { 0 };
+	RumVacuumStatistics vacStats = { 0 };
+	BlockNumber totFreePages = 0;
+	BlockNumber prefetchblkno = RUM_ROOT_BLKNO;
+	IndexBulkDeleteResult *result = gvs->result;
+	IndexBulkDeleteResult localResult = { 0 };
+
+	/* Track pages deleted by this participant separately so they can be aggregated */
+	gvs->result = &localResult;
+
+	for (;;)
+	{
+		BlockNumber startblkno,
+					endblkno,
+					blkno;
+		uint32 blocksDone;
+
+		startblkno = pg_atomic_fetch_add_u32(&shared->nextBlock, shared->chunkSize);
+		if (startblkno >= shared->npages)
+		{
+			break;
+		}
+
+		endblkno = Min(startblkno + shared->chunkSize, shared->npages);
+		for (blkno = startblkno; blkno < endblkno; blkno++)
+		{
+			RumVacuumPrefetchBlocks(gvs->index, blkno, endblkno, &prefetchblkno);
+			rumVacuumCleanupPage(gvs, blkno, &idxStat, &totFreePages, &vacStats);
+		}
+
+		blocksDone = pg_atomic_add_fetch_u32(&shared->blocksDone,
+											 endblkno - startblkno);
+
+		/* Only the leader can report progress for the vacuum command */
+		if (isLeader)
+		{
+			pgstat_progress_update_param(PROGRESS_SCAN_BLOCKS_DONE, blocksDone);
+		}
+	}
+
+	gvs->result = result;
+
+	SpinLockAcquire(&shared->mutex);
+	shared->nparticipantsdone++;
+	shared->idxStat.nEntryPages += idxStat.nEntryPages;
+	shared->idxStat.nDataPages += idxStat.nDataPages;
+	shared->idxStat.nEntries += idxStat.nEntries;
+	shared->totFreePages += totFreePages;
+	shared->pagesDeleted += (BlockNumber) localResult.pages_deleted;
+	RumVacuumAccumulateStats(&shared->vacStats, &vacStats);
+	SpinLockRelease(&shared->mutex);
+}
+
+
+/*
+ * Entry point for the parallel vacuum cleanup workers.
+ */
+PGDLLEXPORT void
+documentdb_rum_parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
+{
+	RumVacuumParallelShared *shared;
+	RumVacuumState gvs;
+	Relation indexRel;
+	char *sharedquery;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_RUM_VACUUM_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	shared = shm_toc_lookup(toc, PARALLEL_KEY_RUM_VACUUM_SHARED, false);
+
+	/* The leader holds RowExclusiveLock on the index during vacuum */
+	indexRel = index_open(shared->indexrelid, RowExclusiveLock);
+
+	InitRumVacuumState(&gvs, indexRel, NULL);
+	gvs.inlineVacuumBulkDelDataPages = shared->inlineVacuumBulkDelDataPages;
+	gvs.strategy = GetAccessStrategy(BAS_VACUUM);
+
+	rumVacuumCleanupParallelScan(&gvs, shared, false);
+
+	FreeAccessStrategy(gvs.strategy);
+	index_close(indexRel, RowExclusiveLock);
+}
+
+
+static void
+RumVacuumAccumulateStats(RumVacuumStatistics *target,
+						 const RumVacuumStatistics *source)
+{
+	target->numEmptyPages += source->numEmptyPages;
+	target->numEmptyEntries += source->numEmptyEntries;
+	target->numEmptyPostingTrees += source->numEmptyPostingTrees;
+	target->numPrunedEntries += source->numPrunedEntries;
+	target->numPrunedPages += source->numPrunedPages;
+	target->prunedEmptyPostingRoots += source->prunedEmptyPostingRoots;
+	target->numPostingTreePagesDeleted += source->numPostingTreePagesDeleted;
+	target->numEmptyPostingTreePages += source->numEmptyPostingTreePages;
+	target->numEntryBacktracks += source->numEntryBacktracks;
+	target->numEntryPages += source->numEntryPages;
+	target->numDataPages += source->numDataPages;
+	target->numVoidPages += source->numVoidPages;
+	target->numPagesSkippedForBackTrack += source->numPagesSkippedForBackTrack;
+}
+
+
+/*
+ * Returns whether the standalone prune of empty entries (which runs outside
+ * of VACUUM and so is not subject to the vacuum cost delay) is throttled:
+ * After every RumPruneEmptyEntriesPagesPerCycle pages, it sleeps for
+ * RumPruneEmptyEntriesCycleDelayMs so that the pass doesn't compete with
+ * the foreground workload for I/O and buffer locks.
+ */
+bool
+RumVacuumThrottleEnabled(void)
+{
+	return RumPruneEmptyEntriesPagesPerCycle > 0 &&
+		   RumPruneEmptyEntriesCycleDelayMs > 0;
+}
+
+
+/*
+ * Sleeps for the throttling delay of the standalone prune of empty entries.
+ */
+void
+RumVacuumThrottleDelay(void)
+{
+	(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+					 RumPruneEmptyEntriesCycleDelayMs, PG_WAIT_EXTENSION);
+	ResetLatch(MyLatch);
+}
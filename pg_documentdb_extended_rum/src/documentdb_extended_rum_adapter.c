@@ -55,6 +55,17 @@ extern PGDLLIMPORT bool can_documentdb_rum_index_scan_ordered(IndexScanDesc scan
 extern PGDLLIMPORT Datum documentdb_rumhandler(PG_FUNCTION_ARGS);
 extern PGDLLIMPORT bool documentdb_rum_get_multi_key_status(Relation indexRelation);
 extern PGDLLIMPORT void documentdb_rum_update_multi_key_status(Relation indexRelation);
+extern PGDLLIMPORT void documentdb_rum_enumerate_entry_keys(Relation indexRelation,
+															OffsetNumber attnum,
+															Snapshot snapshot,
+															IndexEntryKeyVisitorFunc
+															visitor,
+															void *state);
+extern PGDLLIMPORT void * documentdb_rum_shared_build_begin(Relation indexRelation,
+															int maxMemoryKb);
+extern PGDLLIMPORT void documentdb_rum_shared_build_add(void *state, ItemPointer tid,
+														Datum *values, bool *isnull);
+extern PGDLLIMPORT double documentdb_rum_shared_build_end(void *state);
 
 /* Static Globals */
 static BsonIndexAmEntry DocumentDBIndexAmEntry = {
@@ -77,6 +88,10 @@ static BsonIndexAmEntry DocumentDBIndexAmEntry = {
 	.get_opclass_internal_catalog_schema = GetDocumentDBCatalogSchema,
 	.get_multikey_status = documentdb_rum_get_multi_key_status,
 	.get_truncation_status = RumGetTruncationStatus,
+	.enumerate_entry_keys = documentdb_rum_enumerate_entry_keys,
+	.begin_shared_build = documentdb_rum_shared_build_begin,
+	.add_shared_build_tuple = documentdb_rum_shared_build_add,
+	.end_shared_build = documentdb_rum_shared_build_end,
 };
 static DocumentDBRumOidCacheData Cache = { 0 };
 static bool has_custom_routine = false;
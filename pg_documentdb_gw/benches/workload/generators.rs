@@ -0,0 +1,141 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * benches/workload/generators.rs
+ *
+ *-------------------------------------------------------------------------
+ */
+
+use bson::{doc, Document};
+use rand::{distributions::Alphanumeric, rngs::StdRng, Rng};
+
+pub const FIELD_COUNT: usize = 10;
+pub const GROUP_COUNT: u64 = 100;
+
+const TEXT_WORDS: [&str; 24] = [
+    "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india", "juliet",
+    "kilo", "lima", "mike", "november", "oscar", "papa", "quebec", "romeo", "sierra", "tango",
+    "uniform", "victor", "whiskey", "yankee",
+];
+
+/// The key distribution of the reads and updates of a workload.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub enum KeyDistribution {
+    Uniform,
+    Zipfian,
+}
+
+/// Zipfian distributed item numbers in [0, item_count), scrambled so that the
+/// popular items are spread across the key space, as YCSB does.
+pub struct ZipfianGenerator {
+    item_count: u64,
+    theta: f64,
+    alpha: f64,
+    zeta_n: f64,
+    eta: f64,
+}
+
+impl ZipfianGenerator {
+    const ZIPFIAN_CONSTANT: f64 = 0.99;
+
+    pub fn new(item_count: u64) -> Self {
+        let theta = Self::ZIPFIAN_CONSTANT;
+        let zeta_n = Self::zeta(item_count, theta);
+        let zeta_2 = Self::zeta(2, theta);
+        let eta =
+            (1.0 - (2.0 / item_count as f64).powf(1.0 - theta)) / (1.0 - zeta_2 / zeta_n);
+        ZipfianGenerator {
+            item_count,
+            theta,
+            alpha: 1.0 / (1.0 - theta),
+            zeta_n,
+            eta,
+        }
+    }
+
+    /// The rank of the next item, 0 being the most popular.
+    pub fn next_rank(&self, rng: &mut StdRng) -> u64 {
+        let u: f64 = rng.gen();
+        let uz = u * self.zeta_n;
+        if uz < 1.0 {
+            return 0;
+        }
+
+        if uz < 1.0 + 0.5f64.powf(self.theta) {
+            return 1.min(self.item_count - 1);
+        }
+
+        let rank = (self.item_count as f64 * (self.eta * u - self.eta + 1.0).powf(self.alpha)) as u64;
+        rank.min(self.item_count - 1)
+    }
+
+    /// The next item, with the ranks scrambled across the items.
+    pub fn next_item(&self, rng: &mut StdRng) -> u64 {
+        fnv_hash(self.next_rank(rng)) % self.item_count
+    }
+
+    fn zeta(item_count: u64, theta: f64) -> f64 {
+        (1..=item_count).map(|i| 1.0 / (i as f64).powf(theta)).sum()
+    }
+}
+
+fn fnv_hash(value: u64) -> u64 {
+    let mut hash: u64 = 0xcbf29ce484222325;
+    for byte in value.to_le_bytes() {
+        hash ^= byte as u64;
+        hash = hash.wrapping_mul(0x100000001b3);
+    }
+    hash
+}
+
+pub fn record_key(key: u64) -> String {
+    format!("user{key:012}")
+}
+
+/// Builds a YCSB record of about document_size bytes spread over FIELD_COUNT
+/// fields, with the fields the non key-value workloads query.
+pub fn build_record(
+    key: u64,
+    document_size: usize,
+    vector_dimensions: usize,
+    rng: &mut StdRng,
+) -> Document {
+    let mut record = doc! {
+        "_id": record_key(key),
+        "group": (key % GROUP_COUNT) as i64,
+    };
+
+    let field_length = (document_size / FIELD_COUNT).max(1);
+    for field in 0..FIELD_COUNT {
+        record.insert(format!("field{field}"), random_string(field_length, rng));
+    }
+
+    record.insert("text", random_text(8, rng));
+    if vector_dimensions > 0 {
+        record.insert("embedding", random_vector(vector_dimensions, rng));
+    }
+
+    record
+}
+
+pub fn random_string(length: usize, rng: &mut StdRng) -> String {
+    rng.sample_iter(&Alphanumeric)
+        .take(length)
+        .map(char::from)
+        .collect()
+}
+
+pub fn random_word(rng: &mut StdRng) -> &'static str {
+    TEXT_WORDS[rng.gen_range(0..TEXT_WORDS.len())]
+}
+
+fn random_text(words: usize, rng: &mut StdRng) -> String {
+    (0..words)
+        .map(|_| random_word(rng))
+        .collect::<Vec<_>>()
+        .join(" ")
+}
+
+pub fn random_vector(dimensions: usize, rng: &mut StdRng) -> Vec<f64> {
+    (0..dimensions).map(|_| rng.gen_range(-1.0..1.0)).collect()
+}
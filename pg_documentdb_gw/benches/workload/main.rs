@@ -0,0 +1,696 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * benches/workload/main.rs
+ *
+ * End to end workload benchmark driven through the gateway: the YCSB core
+ * workloads A to F plus aggregation, $lookup, $text and vector search
+ * workloads. Latency percentiles and throughput of every workload are
+ * written as JSON.
+ *
+ * By default the gateway is started in process against the local Postgres,
+ * like the integration tests do; --uri runs against a gateway that is
+ * already running.
+ *
+ *   cargo bench --bench workload -- --workloads a,b,c --threads 16 \
+ *       --records 100000 --operations 1000000 --output results.json
+ *
+ *-------------------------------------------------------------------------
+ */
+
+mod generators;
+
+#[allow(dead_code)]
+#[path = "../../tests/common/mod.rs"]
+mod common;
+
+use std::{
+    collections::BTreeMap,
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Arc,
+    },
+    time::Instant,
+};
+
+use bson::{doc, Document};
+use documentdb_gateway::telemetry::metrics::{LatencyHistogram, LatencySnapshot};
+use futures::TryStreamExt;
+use mongodb::{Client, Collection, Database, IndexModel};
+use rand::{rngs::StdRng, Rng, SeedableRng};
+use serde_json::json;
+
+use generators::{KeyDistribution, ZipfianGenerator};
+
+const DATABASE_NAME: &str = "workload_benchmark";
+const RECORD_COLLECTION: &str = "usertable";
+const ORDER_COLLECTION: &str = "orders";
+const ORDERS_PER_RECORD: u64 = 2;
+const MAX_SCAN_LENGTH: i64 = 100;
+const INSERT_BATCH_SIZE: u64 = 1000;
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq, PartialOrd, Ord)]
+enum OperationType {
+    Read,
+    Update,
+    Insert,
+    Scan,
+    ReadModifyWrite,
+    Aggregate,
+    Lookup,
+    Text,
+    Vector,
+}
+
+impl OperationType {
+    fn name(self) -> &'static str {
+        match self {
+            OperationType::Read => "read",
+            OperationType::Update => "update",
+            OperationType::Insert => "insert",
+            OperationType::Scan => "scan",
+            OperationType::ReadModifyWrite => "readModifyWrite",
+            OperationType::Aggregate => "aggregate",
+            OperationType::Lookup => "lookup",
+            OperationType::Text => "text",
+            OperationType::Vector => "vector",
+        }
+    }
+}
+
+/// A workload is a mix of operations, with the proportion of each, and the
+/// distribution of the keys they touch.
+struct Workload {
+    name: &'static str,
+    mix: &'static [(OperationType, f64)],
+    read_latest: bool,
+}
+
+const WORKLOADS: &[Workload] = &[
+    Workload {
+        name: "a",
+        mix: &[(OperationType::Read, 0.5), (OperationType::Update, 0.5)],
+        read_latest: false,
+    },
+    Workload {
+        name: "b",
+        mix: &[(OperationType::Read, 0.95), (OperationType::Update, 0.05)],
+        read_latest: false,
+    },
+    Workload {
+        name: "c",
+        mix: &[(OperationType::Read, 1.0)],
+        read_latest: false,
+    },
+    Workload {
+        name: "d",
+        mix: &[(OperationType::Read, 0.95), (OperationType::Insert, 0.05)],
+        read_latest: true,
+    },
+    Workload {
+        name: "e",
+        mix: &[(OperationType::Scan, 0.95), (OperationType::Insert, 0.05)],
+        read_latest: false,
+    },
+    Workload {
+        name: "f",
+        mix: &[
+            (OperationType::Read, 0.5),
+            (OperationType::ReadModifyWrite, 0.5),
+        ],
+        read_latest: false,
+    },
+    Workload {
+        name: "aggregate",
+        mix: &[(OperationType::Aggregate, 1.0)],
+        read_latest: false,
+    },
+    Workload {
+        name: "lookup",
+        mix: &[(OperationType::Lookup, 1.0)],
+        read_latest: false,
+    },
+    Workload {
+        name: "text",
+        mix: &[(OperationType::Text, 1.0)],
+        read_latest: false,
+    },
+    Workload {
+        name: "vector",
+        mix: &[(OperationType::Vector, 1.0)],
+        read_latest: false,
+    },
+];
+
+struct Options {
+    uri: Option<String>,
+    workloads: Vec<String>,
+    threads: usize,
+    records: u64,
+    operations: u64,
+    document_size: usize,
+    vector_dimensions: usize,
+    distribution: KeyDistribution,
+    indexes: Vec<String>,
+    output: String,
+    seed: u64,
+}
+
+impl Options {
+    fn parse() -> Options {
+        let mut options = Options {
+            uri: None,
+            workloads: ["a", "b", "c", "d", "e", "f"]
+                .iter()
+                .map(|w| w.to_string())
+                .collect(),
+            threads: 8,
+            records: 10000,
+            operations: 100000,
+            document_size: 1000,
+            vector_dimensions: 16,
+            distribution: KeyDistribution::Zipfian,
+            indexes: vec!["group".to_string()],
+            output: "target/workload_results.json".to_string(),
+            seed: 42,
+        };
+
+        let mut args = std::env::args().skip(1);
+        while let Some(arg) = args.next() {
+            // cargo bench passes --bench to benchmarks without the test harness
+            if arg == "--bench" {
+                continue;
+            }
+
+            let mut value = || {
+                args.next()
+                    .unwrap_or_else(|| usage(&format!("{arg} requires a value")))
+            };
+
+            match arg.as_str() {
+                "--uri" => options.uri = Some(value()),
+                "--workloads" => options.workloads = split_list(&value()),
+                "--threads" => options.threads = parse_number(&arg, &value()),
+                "--records" => options.records = parse_number(&arg, &value()),
+                "--operations" => options.operations = parse_number(&arg, &value()),
+                "--document-size" => options.document_size = parse_number(&arg, &value()),
+                "--vector-dimensions" => {
+                    options.vector_dimensions = parse_number(&arg, &value())
+                }
+                "--distribution" => {
+                    options.distribution = match value().as_str() {
+                        "uniform" => KeyDistribution::Uniform,
+                        "zipfian" => KeyDistribution::Zipfian,
+                        other => usage(&format!("Unknown distribution {other}")),
+                    }
+                }
+                "--indexes" => {
+                    let indexes = value();
+                    options.indexes = if indexes == "none" {
+                        Vec::new()
+                    } else {
+                        split_list(&indexes)
+                    }
+                }
+                "--output" => options.output = value(),
+                "--seed" => options.seed = parse_number(&arg, &value()),
+                "--help" => usage(""),
+                other => usage(&format!("Unknown option {other}")),
+            }
+        }
+
+        for workload in &options.workloads {
+            if !WORKLOADS.iter().any(|w| w.name == workload) {
+                usage(&format!("Unknown workload {workload}"));
+            }
+        }
+
+        if options.threads == 0 || options.records == 0 {
+            usage("--threads and --records must be positive");
+        }
+
+        options
+    }
+
+    fn uses_workload(&self, name: &str) -> bool {
+        self.workloads.iter().any(|w| w == name)
+    }
+}
+
+fn split_list(value: &str) -> Vec<String> {
+    value
+        .split(',')
+        .map(|item| item.trim().to_string())
+        .filter(|item| !item.is_empty())
+        .collect()
+}
+
+fn parse_number<T: std::str::FromStr>(option: &str, value: &str) -> T {
+    value
+        .parse()
+        .unwrap_or_else(|_| usage(&format!("{option} expects a number, got {value}")))
+}
+
+fn usage(error: &str) -> ! {
+    if !error.is_empty() {
+        eprintln!("{error}");
+    }
+
+    eprintln!(
+        "Usage: cargo bench --bench workload -- [options]
+  --uri <uri>                 gateway to connect to, the gateway is started in process if not set
+  --workloads <list>          comma separated workloads out of a,b,c,d,e,f,aggregate,lookup,text,vector (default a,b,c,d,e,f)
+  --threads <n>               concurrent clients (default 8)
+  --records <n>               records loaded before the workloads (default 10000)
+  --operations <n>            operations per workload (default 100000)
+  --document-size <bytes>     size of the record fields (default 1000)
+  --vector-dimensions <n>     dimensions of the vector workload embeddings (default 16)
+  --distribution <d>          uniform or zipfian keys (default zipfian)
+  --indexes <list>            record fields to index, or none (default group)
+  --output <file>             JSON results file (default target/workload_results.json)
+  --seed <n>                  random seed (default 42)"
+    );
+    std::process::exit(if error.is_empty() { 0 } else { 1 })
+}
+
+/// Shared state of the clients running a workload.
+struct WorkloadContext {
+    records: Collection<Document>,
+    distribution: KeyDistribution,
+    zipfian: ZipfianGenerator,
+    read_latest: bool,
+    document_size: usize,
+    vector_dimensions: usize,
+
+    // Keys below this have been inserted, new records take the next key
+    next_key: AtomicU64,
+}
+
+impl WorkloadContext {
+    fn choose_key(&self, rng: &mut StdRng) -> u64 {
+        let inserted = self.next_key.load(Ordering::Relaxed);
+        if self.read_latest {
+            // The most recently inserted records are the most popular
+            let rank = self.zipfian.next_rank(rng);
+            return inserted.saturating_sub(1 + rank);
+        }
+
+        match self.distribution {
+            KeyDistribution::Uniform => rng.gen_range(0..inserted),
+            KeyDistribution::Zipfian => self.zipfian.next_item(rng),
+        }
+    }
+
+    async fn run_operation(
+        &self,
+        operation: OperationType,
+        rng: &mut StdRng,
+    ) -> mongodb::error::Result<()> {
+        match operation {
+            OperationType::Read => {
+                let key = generators::record_key(self.choose_key(rng));
+                self.records.find_one(doc! { "_id": key }).await?;
+            }
+            OperationType::Update => {
+                self.update(rng).await?;
+            }
+            OperationType::Insert => {
+                let key = self.next_key.fetch_add(1, Ordering::Relaxed);
+                let record =
+                    generators::build_record(key, self.document_size, self.vector_dimensions, rng);
+                self.records.insert_one(record).await?;
+            }
+            OperationType::Scan => {
+                let key = generators::record_key(self.choose_key(rng));
+                let length = rng.gen_range(1..=MAX_SCAN_LENGTH);
+                let cursor = self
+                    .records
+                    .find(doc! { "_id": { "$gte": key } })
+                    .sort(doc! { "_id": 1 })
+                    .limit(length)
+                    .await?;
+                cursor.try_collect::<Vec<_>>().await?;
+            }
+            OperationType::ReadModifyWrite => {
+                let key = generators::record_key(self.choose_key(rng));
+                self.records.find_one(doc! { "_id": key.as_str() }).await?;
+                let field = format!("field{}", rng.gen_range(0..generators::FIELD_COUNT));
+                let value = generators::random_string(self.field_length(), rng);
+                self.records
+                    .update_one(doc! { "_id": key }, doc! { "$set": { field: value } })
+                    .await?;
+            }
+            OperationType::Aggregate => {
+                let group = rng.gen_range(0..generators::GROUP_COUNT) as i64;
+                let cursor = self
+                    .records
+                    .aggregate(vec![
+                        doc! { "$match": { "group": { "$gte": group, "$lt": group + 10 } } },
+                        doc! { "$group": {
+                            "_id": "$group",
+                            "count": { "$sum": 1 },
+                            "maxId": { "$max": "$_id" },
+                        } },
+                        doc! { "$sort": { "count": -1 } },
+                    ])
+                    .await?;
+                cursor.try_collect::<Vec<_>>().await?;
+            }
+            OperationType::Lookup => {
+                let key = generators::record_key(self.choose_key(rng));
+                let cursor = self
+                    .records
+                    .aggregate(vec![
+                        doc! { "$match": { "_id": key } },
+                        doc! { "$lookup": {
+                            "from": ORDER_COLLECTION,
+                            "localField": "_id",
+                            "foreignField": "userId",
+                            "as": "orders",
+                        } },
+                        doc! { "$project": { "field0": 1, "orders.amount": 1 } },
+                    ])
+                    .await?;
+                cursor.try_collect::<Vec<_>>().await?;
+            }
+            OperationType::Text => {
+                let search = format!(
+                    "{} {}",
+                    generators::random_word(rng),
+                    generators::random_word(rng)
+                );
+                let cursor = self
+                    .records
+                    .find(doc! { "$text": { "$search": search } })
+                    .limit(10)
+                    .await?;
+                cursor.try_collect::<Vec<_>>().await?;
+            }
+            OperationType::Vector => {
+                let vector = generators::random_vector(self.vector_dimensions, rng);
+                let cursor = self
+                    .records
+                    .aggregate(vec![
+                        doc! { "$search": { "cosmosSearch": {
+                            "vector": vector,
+                            "path": "embedding",
+                            "k": 10,
+                        } } },
+                        doc! { "$project": { "embedding": 0 } },
+                    ])
+                    .await?;
+                cursor.try_collect::<Vec<_>>().await?;
+            }
+        }
+
+        Ok(())
+    }
+
+    async fn update(&self, rng: &mut StdRng) -> mongodb::error::Result<()> {
+        let key = generators::record_key(self.choose_key(rng));
+        let field = format!("field{}", rng.gen_range(0..generators::FIELD_COUNT));
+        let value = generators::random_string(self.field_length(), rng);
+        self.records
+            .update_one(doc! { "_id": key }, doc! { "$set": { field: value } })
+            .await?;
+        Ok(())
+    }
+
+    fn field_length(&self) -> usize {
+        (self.document_size / generators::FIELD_COUNT).max(1)
+    }
+}
+
+/// Latencies and errors of one client, merged once the workload completes.
+#[derive(Default)]
+struct ClientResult {
+    latencies: BTreeMap<OperationType, LatencyHistogram>,
+    errors: u64,
+}
+
+fn choose_operation(mix: &[(OperationType, f64)], rng: &mut StdRng) -> OperationType {
+    let mut choice: f64 = rng.gen();
+    for (operation, proportion) in mix {
+        if choice < *proportion {
+            return *operation;
+        }
+
+        choice -= proportion;
+    }
+
+    mix[mix.len() - 1].0
+}
+
+// Latencies are recorded in nanoseconds and reported in microseconds.
+fn latency_summary(snapshot: &LatencySnapshot) -> serde_json::Value {
+    json!({
+        "count": snapshot.count(),
+        "min": snapshot.min_nanos() / 1000,
+        "mean": snapshot.mean_nanos() as f64 / 1000.0,
+        "p50": snapshot.percentile_nanos(0.50) / 1000,
+        "p90": snapshot.percentile_nanos(0.90) / 1000,
+        "p95": snapshot.percentile_nanos(0.95) / 1000,
+        "p99": snapshot.percentile_nanos(0.99) / 1000,
+        "p999": snapshot.percentile_nanos(0.999) / 1000,
+        "max": snapshot.max_nanos() / 1000,
+    })
+}
+
+async fn run_workload(
+    workload: &Workload,
+    database: &Database,
+    options: &Options,
+) -> serde_json::Value {
+    let context = Arc::new(WorkloadContext {
+        records: database.collection(RECORD_COLLECTION),
+        distribution: options.distribution,
+        zipfian: ZipfianGenerator::new(options.records),
+        read_latest: workload.read_latest,
+        document_size: options.document_size,
+        vector_dimensions: options.vector_dimensions,
+        next_key: AtomicU64::new(current_record_count(database).await),
+    });
+
+    let remaining = Arc::new(AtomicU64::new(options.operations));
+    let start = Instant::now();
+    let mut clients = Vec::with_capacity(options.threads);
+    for client in 0..options.threads {
+        let context = Arc::clone(&context);
+        let remaining = Arc::clone(&remaining);
+        let mix = workload.mix;
+        let seed = options.seed.wrapping_add(client as u64);
+        clients.push(tokio::spawn(async move {
+            let mut rng = StdRng::seed_from_u64(seed);
+            let mut result = ClientResult::default();
+            while remaining
+                .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |r| r.checked_sub(1))
+                .is_ok()
+            {
+                let operation = choose_operation(mix, &mut rng);
+                let operation_start = Instant::now();
+                match context.run_operation(operation, &mut rng).await {
+                    Ok(()) => result
+                        .latencies
+                        .entry(operation)
+                        .or_default()
+                        .record(operation_start.elapsed().as_nanos() as u64),
+                    Err(error) => {
+                        if result.errors == 0 {
+                            eprintln!("{} failed: {error}", operation.name());
+                        }
+                        result.errors += 1;
+                    }
+                }
+            }
+            result
+        }));
+    }
+
+    let empty = LatencyHistogram::default().snapshot();
+    let mut overall = empty.clone();
+    let mut by_operation: BTreeMap<OperationType, LatencySnapshot> = BTreeMap::new();
+    let mut errors = 0;
+    for client in clients {
+        let result = client.await.expect("Workload client panicked");
+        errors += result.errors;
+        for (operation, latencies) in result.latencies {
+            let latencies = latencies.snapshot();
+            overall.merge(&latencies);
+            by_operation
+                .entry(operation)
+                .or_insert_with(|| empty.clone())
+                .merge(&latencies);
+        }
+    }
+
+    let elapsed = start.elapsed().as_secs_f64();
+    let mut latencies = serde_json::Map::new();
+    latencies.insert("overall".to_string(), latency_summary(&overall));
+    for (operation, snapshot) in &by_operation {
+        latencies.insert(operation.name().to_string(), latency_summary(snapshot));
+    }
+
+    println!(
+        "workload {}: {:.0} ops/s, p50 {}us, p99 {}us, {} errors",
+        workload.name,
+        overall.count() as f64 / elapsed,
+        overall.percentile_nanos(0.5) / 1000,
+        overall.percentile_nanos(0.99) / 1000,
+        errors
+    );
+
+    json!({
+        "workload": workload.name,
+        "operations": overall.count(),
+        "errors": errors,
+        "durationSeconds": elapsed,
+        "operationsPerSecond": overall.count() as f64 / elapsed,
+        "latencyMicros": latencies,
+    })
+}
+
+async fn current_record_count(database: &Database) -> u64 {
+    database
+        .collection::<Document>(RECORD_COLLECTION)
+        .estimated_document_count()
+        .await
+        .expect("Failed to count the records")
+}
+
+async fn load(database: &Database, options: &Options) {
+    database.drop().await.expect("Failed to drop the database");
+
+    let records = database.collection::<Document>(RECORD_COLLECTION);
+    let orders = database.collection::<Document>(ORDER_COLLECTION);
+    let mut rng = StdRng::seed_from_u64(options.seed);
+    let vector_dimensions = if options.uses_workload("vector") {
+        options.vector_dimensions
+    } else {
+        0
+    };
+
+    let start = Instant::now();
+    let mut key = 0;
+    while key < options.records {
+        let batch_end = (key + INSERT_BATCH_SIZE).min(options.records);
+        let batch: Vec<Document> = (key..batch_end)
+            .map(|k| {
+                generators::build_record(k, options.document_size, vector_dimensions, &mut rng)
+            })
+            .collect();
+        records
+            .insert_many(batch)
+            .await
+            .expect("Failed to load the records");
+
+        if options.uses_workload("lookup") {
+            let batch: Vec<Document> = (key..batch_end)
+                .flat_map(|k| (0..ORDERS_PER_RECORD).map(move |o| (k, o)))
+                .map(|(k, o)| {
+                    doc! {
+                        "_id": format!("{}-{o}", generators::record_key(k)),
+                        "userId": generators::record_key(k),
+                        "amount": (k * 7 + o) as i64 % 1000,
+                    }
+                })
+                .collect();
+            orders
+                .insert_many(batch)
+                .await
+                .expect("Failed to load the orders");
+        }
+
+        key = batch_end;
+    }
+
+    for field in &options.indexes {
+        records
+            .create_index(IndexModel::builder().keys(doc! { field: 1 }).build())
+            .await
+            .expect("Failed to create the record index");
+    }
+
+    if options.uses_workload("lookup") {
+        orders
+            .create_index(IndexModel::builder().keys(doc! { "userId": 1 }).build())
+            .await
+            .expect("Failed to create the order index");
+    }
+
+    if options.uses_workload("text") {
+        records
+            .create_index(IndexModel::builder().keys(doc! { "text": "text" }).build())
+            .await
+            .expect("Failed to create the text index");
+    }
+
+    if options.uses_workload("vector") {
+        database
+            .run_command(doc! {
+                "createIndexes": RECORD_COLLECTION,
+                "indexes": [{
+                    "key": { "embedding": "cosmosSearch" },
+                    "name": "embedding_vector",
+                    "cosmosSearchOptions": {
+                        "kind": "vector-hnsw",
+                        "m": 16,
+                        "efConstruction": 64,
+                        "similarity": "COS",
+                        "dimensions": options.vector_dimensions as i32,
+                    },
+                }],
+            })
+            .await
+            .expect("Failed to create the vector index");
+    }
+
+    println!(
+        "loaded {} records in {:.1}s",
+        options.records,
+        start.elapsed().as_secs_f64()
+    );
+}
+
+#[tokio::main]
+async fn main() {
+    let options = Options::parse();
+
+    let client = match &options.uri {
+        Some(uri) => Client::with_uri_str(uri)
+            .await
+            .expect("Failed to connect to the gateway"),
+        None => common::initialize().await,
+    };
+
+    let database = client.database(DATABASE_NAME);
+    load(&database, &options).await;
+
+    let mut results = Vec::new();
+    for workload in WORKLOADS {
+        if options.uses_workload(workload.name) {
+            results.push(run_workload(workload, &database, &options).await);
+        }
+    }
+
+    let report = json!({
+        "configuration": {
+            "workloads": options.workloads,
+            "threads": options.threads,
+            "records": options.records,
+            "operations": options.operations,
+            "documentSize": options.document_size,
+            "vectorDimensions": options.vector_dimensions,
+            "distribution": format!("{:?}", options.distribution).to_lowercase(),
+            "indexes": options.indexes,
+            "seed": options.seed,
+        },
+        "results": results,
+    });
+
+    std::fs::write(
+        &options.output,
+        serde_json::to_string_pretty(&report).expect("Failed to serialize the results"),
+    )
+    .expect("Failed to write the results");
+    println!("results written to {}", options.output);
+}
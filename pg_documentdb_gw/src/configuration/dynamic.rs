@@ -11,7 +11,11 @@ use std::fmt::Debug;
 use async_trait::async_trait;
 use bson::RawBson;
 
-use crate::{configuration::Version, postgres};
+use crate::{
+    configuration::Version,
+    postgres,
+    protocol::compression::{self, Compressor},
+};
 
 pub const POSTGRES_RECOVERY_KEY: &str = "IsPostgresInRecovery";
 
@@ -97,6 +101,48 @@ pub trait DynamicConfiguration: Send + Sync + Debug {
             .unwrap_or(Version::Seven)
     }
 
+    async fn wire_compressors(&self) -> Vec<Compressor> {
+        self.get_str("wireCompressors")
+            .await
+            .as_deref()
+            .map(compression::parse_compressor_list)
+            .unwrap_or_else(|| compression::DEFAULT_COMPRESSORS.to_vec())
+    }
+
+    async fn wire_compression_min_response_bytes(&self) -> i32 {
+        self.get_i32("wireCompressionMinResponseBytes", 1024).await
+    }
+
+    async fn enable_metadata_response_cache(&self) -> bool {
+        self.get_bool("enableMetadataResponseCache", false).await
+    }
+
+    async fn metadata_response_cache_ttl_secs(&self) -> u64 {
+        self.get_u64("metadataResponseCacheTtlSeconds", 5).await
+    }
+
+    async fn metadata_response_cache_max_entries(&self) -> usize {
+        self.get_i32("metadataResponseCacheMaxEntries", 10000)
+            .await
+            .max(0) as usize
+    }
+
+    async fn enable_cursor_prefetch(&self) -> bool {
+        self.get_bool("enableCursorPrefetch", false).await
+    }
+
+    async fn cursor_prefetch_max_batch_bytes(&self) -> usize {
+        self.get_i32("cursorPrefetchMaxBatchBytes", 16 * 1024 * 1024)
+            .await
+            .max(0) as usize
+    }
+
+    async fn cursor_prefetch_max_total_bytes(&self) -> usize {
+        self.get_i32("cursorPrefetchMaxTotalBytes", 256 * 1024 * 1024)
+            .await
+            .max(0) as usize
+    }
+
     async fn enable_stateless_cursor_timeout(&self) -> bool {
         self.get_bool("enableStatelessCursorTimeout", false).await
     }
@@ -19,9 +19,10 @@ use uuid::{Builder, Uuid};
 use crate::{
     auth::AuthState,
     configuration::DynamicConfiguration,
-    context::{Cursor, CursorStoreEntry, ServiceContext},
+    context::{Cursor, CursorPrefetch, CursorStoreEntry, ServiceContext},
     error::{DocumentDBError, Result},
     postgres::Connection,
+    protocol::compression::CompressionContext,
     telemetry::TelemetryProvider,
 };
 
@@ -37,6 +38,7 @@ pub struct ConnectionContext {
     pub ip_address: String,
     pub cipher_type: i32,
     pub ssl_protocol: String,
+    pub compression: CompressionContext,
     transport_protocol: String,
     connection_id_hash: i32,
 }
@@ -74,6 +76,7 @@ impl ConnectionContext {
             ip_address,
             cipher_type,
             ssl_protocol,
+            compression: CompressionContext::default(),
             transport_protocol,
             connection_id_hash: Self::get_uuid_hash(connection_id),
         }
@@ -108,6 +111,7 @@ impl ConnectionContext {
         collection: &str,
         cursor_timeout: Duration,
         session_id: Option<Vec<u8>>,
+        prefetch: Option<CursorPrefetch>,
     ) {
         let key = (cursor.cursor_id, username.to_string());
         let value = CursorStoreEntry {
@@ -118,6 +122,7 @@ impl ConnectionContext {
             timestamp: Instant::now(),
             cursor_timeout,
             session_id,
+            prefetch,
         };
 
         // If there is a transaction, add the cursor to its store
@@ -6,7 +6,10 @@
  *-------------------------------------------------------------------------
  */
 
-use std::sync::Arc;
+use std::sync::{
+    atomic::{AtomicU64, AtomicUsize, Ordering},
+    Arc,
+};
 
 use bson::RawDocumentBuf;
 use dashmap::DashMap;
@@ -14,8 +17,13 @@ use tokio::{
     task::JoinHandle,
     time::{Duration, Instant},
 };
+use tokio_postgres::Row;
 
-use crate::{configuration::DynamicConfiguration, postgres::Connection};
+use crate::{
+    configuration::DynamicConfiguration,
+    error::{DocumentDBError, Result},
+    postgres::Connection,
+};
 
 #[derive(Debug)]
 pub struct Cursor {
@@ -31,11 +39,89 @@ pub struct CursorStoreEntry {
     pub timestamp: Instant,
     pub cursor_timeout: Duration,
     pub session_id: Option<Vec<u8>>,
+    pub prefetch: Option<CursorPrefetch>,
+}
+
+/// Counters of the getMore prefetching, and the memory reserved by the batches being
+/// prefetched or waiting for their getMore.
+#[derive(Debug, Default)]
+pub struct CursorPrefetchStats {
+    pub started: AtomicU64,
+    pub served: AtomicU64,
+    pub discarded: AtomicU64,
+    pub failed: AtomicU64,
+    pub skipped: AtomicU64,
+    pub buffered_bytes: AtomicUsize,
+}
+
+/// The next batch of a cursor, fetched in the background after the previous getMore was
+/// answered. Dropping it, as happens when the cursor is killed, times out or is
+/// invalidated, cancels the fetch and releases its memory reservation.
+pub struct CursorPrefetch {
+    handle: JoinHandle<Result<Vec<Row>>>,
+    batch_size: Option<i64>,
+    reserved_bytes: usize,
+    stats: Arc<CursorPrefetchStats>,
+}
+
+impl CursorPrefetch {
+    pub fn new(
+        handle: JoinHandle<Result<Vec<Row>>>,
+        batch_size: Option<i64>,
+        reserved_bytes: usize,
+        stats: Arc<CursorPrefetchStats>,
+    ) -> Self {
+        stats.started.fetch_add(1, Ordering::Relaxed);
+        stats
+            .buffered_bytes
+            .fetch_add(reserved_bytes, Ordering::Relaxed);
+        CursorPrefetch {
+            handle,
+            batch_size,
+            reserved_bytes,
+            stats,
+        }
+    }
+
+    /// Returns the prefetched batch if it answers a getMore asking for the given batch size.
+    /// A batch fetched with another batch size is discarded, and a failed prefetch is
+    /// counted; the caller then runs the getMore itself.
+    pub async fn take(mut self, batch_size: Option<i64>) -> Option<Vec<Row>> {
+        if self.batch_size != batch_size {
+            self.stats.discarded.fetch_add(1, Ordering::Relaxed);
+            return None;
+        }
+
+        let result = match (&mut self.handle).await {
+            Ok(result) => result,
+            Err(e) => Err(DocumentDBError::internal_error(format!(
+                "Cursor prefetch did not complete: {e}"
+            ))),
+        };
+
+        let counter = if result.is_ok() {
+            &self.stats.served
+        } else {
+            &self.stats.failed
+        };
+        counter.fetch_add(1, Ordering::Relaxed);
+        result.ok()
+    }
+}
+
+impl Drop for CursorPrefetch {
+    fn drop(&mut self) {
+        self.handle.abort();
+        self.stats
+            .buffered_bytes
+            .fetch_sub(self.reserved_bytes, Ordering::Relaxed);
+    }
 }
 
 // Maps CursorId, Username -> Connection, Cursor
 pub struct CursorStore {
     cursors: Arc<DashMap<(i64, String), CursorStoreEntry>>,
+    prefetch_stats: Arc<CursorPrefetchStats>,
     _reaper: Option<JoinHandle<()>>,
 }
 
@@ -66,10 +152,15 @@ impl CursorStore {
 
         CursorStore {
             cursors,
+            prefetch_stats: Arc::new(CursorPrefetchStats::default()),
             _reaper: reaper,
         }
     }
 
+    pub fn prefetch_stats(&self) -> &Arc<CursorPrefetchStats> {
+        &self.prefetch_stats
+    }
+
     pub async fn add_cursor(&self, k: (i64, String), v: CursorStoreEntry) {
         self.cursors.insert(k, v);
     }
@@ -106,3 +197,97 @@ impl CursorStore {
         (removed_cursors, missing_cursors)
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // A prefetch of the given batch size that never completes, and a handle that is only
+    // released once its task is cancelled.
+    fn pending_prefetch(
+        batch_size: Option<i64>,
+        stats: &Arc<CursorPrefetchStats>,
+    ) -> (CursorPrefetch, Arc<()>) {
+        let alive = Arc::new(());
+        let task_alive = Arc::clone(&alive);
+        let handle = tokio::spawn(async move {
+            let _alive = task_alive;
+            std::future::pending::<Result<Vec<Row>>>().await
+        });
+        (
+            CursorPrefetch::new(handle, batch_size, 1024, Arc::clone(stats)),
+            alive,
+        )
+    }
+
+    async fn wait_for_cancellation(alive: &Arc<()>) {
+        for _ in 0..100 {
+            if Arc::strong_count(alive) == 1 {
+                return;
+            }
+            tokio::task::yield_now().await;
+        }
+        panic!("The prefetch task was not cancelled");
+    }
+
+    #[tokio::test]
+    async fn test_take_with_same_batch_size() {
+        let stats = Arc::new(CursorPrefetchStats::default());
+        let prefetch = CursorPrefetch::new(
+            tokio::spawn(async { Ok(Vec::new()) }),
+            Some(10),
+            1024,
+            Arc::clone(&stats),
+        );
+        assert_eq!(stats.buffered_bytes.load(Ordering::Relaxed), 1024);
+
+        assert!(prefetch.take(Some(10)).await.is_some());
+        assert_eq!(stats.started.load(Ordering::Relaxed), 1);
+        assert_eq!(stats.served.load(Ordering::Relaxed), 1);
+        assert_eq!(stats.discarded.load(Ordering::Relaxed), 0);
+        assert_eq!(stats.buffered_bytes.load(Ordering::Relaxed), 0);
+    }
+
+    #[tokio::test]
+    async fn test_take_with_other_batch_size_discards() {
+        let stats = Arc::new(CursorPrefetchStats::default());
+
+        // Neither a different batch size nor a missing one reuse the prefetched batch
+        for batch_size in [Some(20), None] {
+            let (prefetch, alive) = pending_prefetch(Some(10), &stats);
+            assert!(prefetch.take(batch_size).await.is_none());
+            wait_for_cancellation(&alive).await;
+        }
+
+        assert_eq!(stats.discarded.load(Ordering::Relaxed), 2);
+        assert_eq!(stats.served.load(Ordering::Relaxed), 0);
+        assert_eq!(stats.buffered_bytes.load(Ordering::Relaxed), 0);
+    }
+
+    #[tokio::test]
+    async fn test_failed_prefetch() {
+        let stats = Arc::new(CursorPrefetchStats::default());
+        let prefetch = CursorPrefetch::new(
+            tokio::spawn(async { Err(DocumentDBError::internal_error("failed".to_string())) }),
+            None,
+            1024,
+            Arc::clone(&stats),
+        );
+
+        assert!(prefetch.take(None).await.is_none());
+        assert_eq!(stats.failed.load(Ordering::Relaxed), 1);
+        assert_eq!(stats.buffered_bytes.load(Ordering::Relaxed), 0);
+    }
+
+    #[tokio::test]
+    async fn test_drop_cancels_prefetch() {
+        let stats = Arc::new(CursorPrefetchStats::default());
+        let (prefetch, alive) = pending_prefetch(Some(10), &stats);
+
+        // As when the cursor is killed or times out
+        drop(prefetch);
+        wait_for_cancellation(&alive).await;
+        assert_eq!(stats.buffered_bytes.load(Ordering::Relaxed), 0);
+        assert_eq!(stats.discarded.load(Ordering::Relaxed), 0);
+    }
+}
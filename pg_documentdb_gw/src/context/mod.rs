@@ -9,13 +9,15 @@
 mod connection;
 mod cursor;
 mod request;
+mod response_cache;
 mod service;
 mod transaction;
 
-pub use cursor::{Cursor, CursorStore, CursorStoreEntry};
+pub use cursor::{Cursor, CursorPrefetch, CursorPrefetchStats, CursorStore, CursorStoreEntry};
 
 pub use transaction::{RequestTransactionInfo, Transaction, TransactionStore};
 
 pub use connection::ConnectionContext;
 pub use request::RequestContext;
+pub use response_cache::{CacheLookup, CachedCommand, CommandCacheStats, ResponseCache};
 pub use service::ServiceContext;
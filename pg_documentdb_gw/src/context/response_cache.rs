@@ -0,0 +1,508 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/context/response_cache.rs
+ *
+ *-------------------------------------------------------------------------
+ */
+
+use std::sync::atomic::{AtomicU64, Ordering};
+
+use bson::{RawDocument, RawDocumentBuf};
+use dashmap::DashMap;
+use tokio::time::{Duration, Instant};
+
+use crate::{
+    configuration::DynamicConfiguration,
+    context::{ConnectionContext, RequestContext},
+    requests::RequestType,
+    responses::{RawResponse, Response},
+};
+
+/// Read-only metadata commands whose responses are served from the cache.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum CachedCommand {
+    ConnectionStatus,
+    GetParameter,
+    ListCollections,
+    ListIndexes,
+}
+
+const CACHED_COMMANDS: [CachedCommand; 4] = [
+    CachedCommand::ConnectionStatus,
+    CachedCommand::GetParameter,
+    CachedCommand::ListCollections,
+    CachedCommand::ListIndexes,
+];
+
+impl CachedCommand {
+    fn from_request_type(request_type: &RequestType) -> Option<Self> {
+        match request_type {
+            RequestType::ConnectionStatus => Some(CachedCommand::ConnectionStatus),
+            RequestType::GetParameter => Some(CachedCommand::GetParameter),
+            RequestType::ListCollections => Some(CachedCommand::ListCollections),
+            RequestType::ListIndexes => Some(CachedCommand::ListIndexes),
+            _ => None,
+        }
+    }
+
+    pub fn name(self) -> &'static str {
+        match self {
+            CachedCommand::ConnectionStatus => "connectionStatus",
+            CachedCommand::GetParameter => "getParameter",
+            CachedCommand::ListCollections => "listCollections",
+            CachedCommand::ListIndexes => "listIndexes",
+        }
+    }
+}
+
+/// What a command invalidates once it has run through this gateway.
+enum Invalidation {
+    None,
+    Namespace,
+    Database,
+    OutputDatabase,
+    All,
+}
+
+// Bounds the namespaces remembered as existing, the set starts over once full.
+const MAX_KNOWN_NAMESPACES: usize = 10_000;
+
+fn invalidation_for(request_type: &RequestType) -> Invalidation {
+    match request_type {
+        RequestType::Create
+        | RequestType::CreateIndex
+        | RequestType::CreateIndexes
+        | RequestType::CollMod
+        | RequestType::Drop
+        | RequestType::DropDatabase
+        | RequestType::DropIndexes
+        | RequestType::ReIndex
+        | RequestType::ShardCollection
+        | RequestType::ReshardCollection
+        | RequestType::UnshardCollection => Invalidation::Database,
+
+        // Writes create the collection they target when it does not exist yet
+        RequestType::Insert | RequestType::Update | RequestType::FindAndModify => {
+            Invalidation::Namespace
+        }
+
+        // $out and $merge create or replace their target collection, which may be in another database
+        RequestType::Aggregate => Invalidation::OutputDatabase,
+
+        // Renames may cross databases and user or role changes alter what every command may see
+        RequestType::RenameCollection
+        | RequestType::CreateUser
+        | RequestType::DropUser
+        | RequestType::UpdateUser
+        | RequestType::CreateRole
+        | RequestType::UpdateRole
+        | RequestType::DropRole => Invalidation::All,
+
+        _ => Invalidation::None,
+    }
+}
+
+// Fields that differ between otherwise identical requests without affecting the response.
+fn is_volatile_field(name: &str) -> bool {
+    name.starts_with('$')
+        || matches!(
+            name,
+            "lsid" | "txnNumber" | "autocommit" | "startTransaction" | "maxTimeMS" | "comment"
+        )
+}
+
+#[derive(Debug, Eq, Hash, PartialEq)]
+struct CacheKey {
+    user: String,
+    db: String,
+    command: Vec<u8>,
+}
+
+struct CacheEntry {
+    response: RawDocumentBuf,
+    inserted: Instant,
+}
+
+#[derive(Default)]
+struct CommandCounters {
+    hits: AtomicU64,
+    misses: AtomicU64,
+}
+
+/// Hit and miss counts of one cached command.
+#[derive(Clone, Debug)]
+pub struct CommandCacheStats {
+    pub command: CachedCommand,
+    pub hits: u64,
+    pub misses: u64,
+}
+
+impl CommandCacheStats {
+    pub fn hit_rate(&self) -> f64 {
+        let total = self.hits + self.misses;
+        if total == 0 {
+            return 0.0;
+        }
+
+        self.hits as f64 / total as f64
+    }
+}
+
+/// Returned by a cache miss, used to store the response once it has been computed.
+pub struct CacheTicket {
+    key: CacheKey,
+    epoch: u64,
+    ttl: Duration,
+    max_entries: usize,
+}
+
+pub enum CacheLookup {
+    Hit(Response),
+    Miss(CacheTicket),
+}
+
+/// Caches the responses of read-only metadata commands per (user, db, command).
+///
+/// Entries expire after a TTL so that DDL issued through other gateways is picked up, and
+/// DDL flowing through this gateway drops the affected entries immediately. Every
+/// invalidation also advances an epoch, so that a response computed concurrently with the
+/// DDL is not stored. Writes may create their collection, so the first write to a namespace
+/// invalidates its database as well; later ones are known not to change the metadata.
+#[derive(Default)]
+pub struct ResponseCache {
+    entries: DashMap<CacheKey, CacheEntry>,
+    known_namespaces: DashMap<(String, String), ()>,
+    epoch: AtomicU64,
+    counters: [CommandCounters; CACHED_COMMANDS.len()],
+}
+
+impl ResponseCache {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Looks the request up. Returns None when the request is not cacheable: the command is
+    /// not a cached one, the cache is disabled, the connection is not authenticated or is
+    /// in a transaction.
+    pub async fn lookup(
+        &self,
+        request_context: &RequestContext<'_>,
+        connection_context: &ConnectionContext,
+        dynamic_configuration: &dyn DynamicConfiguration,
+    ) -> Option<CacheLookup> {
+        let command = CachedCommand::from_request_type(request_context.payload.request_type())?;
+        if connection_context.transaction.is_some()
+            || !dynamic_configuration.enable_metadata_response_cache().await
+            || !*connection_context.auth_state.is_authorized().read().await
+        {
+            return None;
+        }
+
+        let key = CacheKey {
+            user: connection_context.auth_state.username().ok()?.to_string(),
+            db: request_context.info.db().ok()?.to_string(),
+            command: normalized_command(request_context.payload.document())?,
+        };
+        let ttl = Duration::from_secs(
+            dynamic_configuration
+                .metadata_response_cache_ttl_secs()
+                .await,
+        );
+        let max_entries = dynamic_configuration
+            .metadata_response_cache_max_entries()
+            .await;
+
+        // Taken before the lookup so that an invalidation racing with the miss is detected
+        let epoch = self.epoch.load(Ordering::Acquire);
+
+        let counters = &self.counters[command as usize];
+        if let Some(entry) = self.entries.get(&key) {
+            if entry.inserted.elapsed() < ttl {
+                counters.hits.fetch_add(1, Ordering::Relaxed);
+                return Some(CacheLookup::Hit(Response::Raw(RawResponse(
+                    entry.response.clone(),
+                ))));
+            }
+        }
+
+        counters.misses.fetch_add(1, Ordering::Relaxed);
+        Some(CacheLookup::Miss(CacheTicket {
+            key,
+            epoch,
+            ttl,
+            max_entries,
+        }))
+    }
+
+    /// Stores the response computed for a miss, unless it leaves a cursor open or the cache
+    /// was invalidated while it was computed.
+    pub fn insert(&self, ticket: CacheTicket, response: &Response) {
+        let Ok(document) = response.as_raw_document() else {
+            return;
+        };
+        if !is_complete_response(document) || self.epoch.load(Ordering::Acquire) != ticket.epoch {
+            return;
+        }
+
+        if self.entries.len() >= ticket.max_entries {
+            self.entries
+                .retain(|_, entry| entry.inserted.elapsed() < ticket.ttl);
+            if self.entries.len() >= ticket.max_entries {
+                return;
+            }
+        }
+
+        let CacheTicket { key, epoch, .. } = ticket;
+        let db = key.db.clone();
+        self.entries.insert(
+            key,
+            CacheEntry {
+                response: document.to_raw_document_buf(),
+                inserted: Instant::now(),
+            },
+        );
+
+        // An invalidation may have completed between the epoch check and the insert
+        if self.epoch.load(Ordering::Acquire) != epoch {
+            self.entries.retain(|key, _| key.db != db);
+        }
+    }
+
+    /// Drops the entries a command may have made stale.
+    pub fn invalidate(
+        &self,
+        request_type: &RequestType,
+        db: Option<&str>,
+        command: &RawDocument,
+        succeeded: bool,
+    ) {
+        match (invalidation_for(request_type), db) {
+            (Invalidation::None, _) => {}
+            (Invalidation::Namespace, Some(db)) => {
+                let Some(collection) = command_collection(command) else {
+                    self.invalidate_database(db);
+                    return;
+                };
+
+                let namespace = (db.to_string(), collection.to_string());
+                if self.known_namespaces.contains_key(&namespace) {
+                    return;
+                }
+
+                self.invalidate_database(db);
+                if succeeded {
+                    if self.known_namespaces.len() >= MAX_KNOWN_NAMESPACES {
+                        self.known_namespaces.clear();
+                    }
+                    self.known_namespaces.insert(namespace, ());
+                }
+            }
+            (Invalidation::Database, Some(db)) => self.invalidate_database(db),
+            (Invalidation::OutputDatabase, Some(db)) => {
+                if let Some(output_db) = aggregate_output_database(command) {
+                    self.invalidate_database(output_db.unwrap_or(db));
+                }
+            }
+            (
+                Invalidation::Namespace | Invalidation::Database | Invalidation::OutputDatabase,
+                None,
+            )
+            | (Invalidation::All, _) => {
+                self.epoch.fetch_add(1, Ordering::AcqRel);
+                self.entries.clear();
+                self.known_namespaces.clear();
+            }
+        }
+    }
+
+    fn invalidate_database(&self, db: &str) {
+        self.epoch.fetch_add(1, Ordering::AcqRel);
+        self.entries.retain(|key, _| key.db != db);
+        self.known_namespaces
+            .retain(|(known_db, _), _| known_db != db);
+    }
+
+    /// Per command hit and miss counts since startup.
+    pub fn stats(&self) -> Vec<CommandCacheStats> {
+        CACHED_COMMANDS
+            .iter()
+            .map(|command| {
+                let counters = &self.counters[*command as usize];
+                CommandCacheStats {
+                    command: *command,
+                    hits: counters.hits.load(Ordering::Relaxed),
+                    misses: counters.misses.load(Ordering::Relaxed),
+                }
+            })
+            .collect()
+    }
+}
+
+// The command document without its volatile fields, as the cache key.
+fn normalized_command(command: &RawDocument) -> Option<Vec<u8>> {
+    let mut normalized = RawDocumentBuf::new();
+    for element in command {
+        let (name, value) = element.ok()?;
+        if !is_volatile_field(name) {
+            normalized.append(name, value.to_raw_bson());
+        }
+    }
+
+    Some(normalized.into_bytes())
+}
+
+// The collection a command targets, as the value of its command name field.
+fn command_collection(command: &RawDocument) -> Option<&str> {
+    let (_, value) = command.into_iter().next()?.ok()?;
+    value.as_str()
+}
+
+// The database an aggregation writes to with its final $out or $merge stage: None when the
+// pipeline does not write, Some(None) when it writes to the database of the request.
+fn aggregate_output_database(command: &RawDocument) -> Option<Option<&str>> {
+    let pipeline = command.get_array("pipeline").ok()?;
+    let last_stage = pipeline.into_iter().last()?.ok()?.as_document()?;
+    let (stage_name, spec) = last_stage.into_iter().next()?.ok()?;
+    let target = match stage_name {
+        "$out" => spec.as_document(),
+        "$merge" => spec
+            .as_document()
+            .and_then(|merge| merge.get_document("into").ok()),
+        _ => return None,
+    };
+
+    Some(target.and_then(|target| target.get_str("db").ok()))
+}
+
+// Only successful responses that do not leave a cursor open to continue from are cached.
+fn is_complete_response(response: &RawDocument) -> bool {
+    let ok = match response.get("ok") {
+        Ok(Some(ok)) => ok.as_f64().or_else(|| ok.as_i32().map(f64::from)),
+        _ => None,
+    };
+    if ok != Some(1.0) {
+        return false;
+    }
+
+    match response.get_document("cursor") {
+        Ok(cursor) => matches!(cursor.get_i64("id"), Ok(0)),
+        Err(_) => true,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use bson::rawdoc;
+
+    use super::*;
+
+    fn cache_list_collections(cache: &ResponseCache, db: &str) {
+        cache.entries.insert(
+            CacheKey {
+                user: "test".to_string(),
+                db: db.to_string(),
+                command: normalized_command(&rawdoc! { "listCollections": 1 }).unwrap(),
+            },
+            CacheEntry {
+                response: rawdoc! { "cursor": { "id": 0_i64, "firstBatch": [] }, "ok": 1.0 },
+                inserted: Instant::now(),
+            },
+        );
+    }
+
+    fn is_cached(cache: &ResponseCache, db: &str) -> bool {
+        cache.entries.iter().any(|entry| entry.key().db == db)
+    }
+
+    #[test]
+    fn test_insert_invalidates_list_collections() {
+        let cache = ResponseCache::new();
+        let insert = rawdoc! { "insert": "coll", "documents": [{ "a": 1 }] };
+
+        // The first insert may have created the collection
+        cache_list_collections(&cache, "db");
+        cache_list_collections(&cache, "other");
+        cache.invalidate(&RequestType::Insert, Some("db"), &insert, true);
+        assert!(!is_cached(&cache, "db"));
+        assert!(is_cached(&cache, "other"));
+
+        // Later ones to the same collection do not change the metadata
+        cache_list_collections(&cache, "db");
+        cache.invalidate(&RequestType::Insert, Some("db"), &insert, true);
+        assert!(is_cached(&cache, "db"));
+
+        // Neither do updates to it, but an upsert to another collection may create it
+        let update = rawdoc! { "update": "coll", "updates": [] };
+        cache.invalidate(&RequestType::Update, Some("db"), &update, true);
+        assert!(is_cached(&cache, "db"));
+        let upsert = rawdoc! { "findAndModify": "new", "upsert": true };
+        cache.invalidate(&RequestType::FindAndModify, Some("db"), &upsert, true);
+        assert!(!is_cached(&cache, "db"));
+    }
+
+    #[test]
+    fn test_drop_forgets_known_collections() {
+        let cache = ResponseCache::new();
+        let insert = rawdoc! { "insert": "coll", "documents": [{ "a": 1 }] };
+        cache.invalidate(&RequestType::Insert, Some("db"), &insert, true);
+
+        let drop = rawdoc! { "drop": "coll" };
+        cache.invalidate(&RequestType::Drop, Some("db"), &drop, true);
+
+        // The collection is created again by the next insert
+        cache_list_collections(&cache, "db");
+        cache.invalidate(&RequestType::Insert, Some("db"), &insert, true);
+        assert!(!is_cached(&cache, "db"));
+    }
+
+    #[test]
+    fn test_aggregate_output_invalidates_target_database() {
+        let cache = ResponseCache::new();
+        cache_list_collections(&cache, "db");
+        cache_list_collections(&cache, "other");
+
+        // Reads do not change the metadata
+        let read = rawdoc! { "aggregate": "coll", "pipeline": [{ "$match": { "a": 1 } }] };
+        cache.invalidate(&RequestType::Aggregate, Some("db"), &read, true);
+        assert!(is_cached(&cache, "db"));
+        assert!(is_cached(&cache, "other"));
+
+        // $out to a collection of the request database
+        let out =
+            rawdoc! { "aggregate": "coll", "pipeline": [{ "$match": {} }, { "$out": "copy" }] };
+        cache.invalidate(&RequestType::Aggregate, Some("db"), &out, true);
+        assert!(!is_cached(&cache, "db"));
+        assert!(is_cached(&cache, "other"));
+
+        // $out and $merge to another database only invalidate that one
+        cache_list_collections(&cache, "db");
+        let out = rawdoc! { "aggregate": "coll", "pipeline": [{ "$out": { "db": "other", "coll": "copy" } }] };
+        cache.invalidate(&RequestType::Aggregate, Some("db"), &out, true);
+        assert!(is_cached(&cache, "db"));
+        assert!(!is_cached(&cache, "other"));
+
+        cache_list_collections(&cache, "other");
+        let merge = rawdoc! { "aggregate": "coll", "pipeline": [{ "$merge": { "into": { "db": "other", "coll": "copy" } } }] };
+        cache.invalidate(&RequestType::Aggregate, Some("db"), &merge, false);
+        assert!(is_cached(&cache, "db"));
+        assert!(!is_cached(&cache, "other"));
+
+        cache_list_collections(&cache, "other");
+        let merge = rawdoc! { "aggregate": "coll", "pipeline": [{ "$merge": { "into": "copy" } }] };
+        cache.invalidate(&RequestType::Aggregate, Some("db"), &merge, true);
+        assert!(!is_cached(&cache, "db"));
+        assert!(is_cached(&cache, "other"));
+    }
+
+    #[test]
+    fn test_failed_insert_is_not_remembered() {
+        let cache = ResponseCache::new();
+        let insert = rawdoc! { "insert": "coll", "documents": [{ "a": 1 }] };
+        cache.invalidate(&RequestType::Insert, Some("db"), &insert, false);
+
+        cache_list_collections(&cache, "db");
+        cache.invalidate(&RequestType::Insert, Some("db"), &insert, true);
+        assert!(!is_cached(&cache, "db"));
+    }
+}
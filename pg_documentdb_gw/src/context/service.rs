@@ -10,9 +10,10 @@ use std::{sync::Arc, time::Duration};
 
 use crate::{
     configuration::{DynamicConfiguration, SetupConfiguration},
-    context::{CursorStore, TransactionStore},
+    context::{CursorStore, ResponseCache, TransactionStore},
     postgres::{PoolManager, QueryCatalog},
     service::TlsProvider,
+    telemetry::metrics::RequestMetrics,
 };
 
 pub struct ServiceContextInner {
@@ -21,6 +22,8 @@ pub struct ServiceContextInner {
     pub connection_pool_manager: PoolManager,
     pub cursor_store: CursorStore,
     pub transaction_store: TransactionStore,
+    pub response_cache: ResponseCache,
+    pub request_metrics: RequestMetrics,
     pub query_catalog: QueryCatalog,
     pub tls_provider: TlsProvider,
 }
@@ -47,6 +50,8 @@ impl ServiceContext {
             connection_pool_manager,
             cursor_store,
             transaction_store: TransactionStore::new(Duration::from_secs(timeout_secs)),
+            response_cache: ResponseCache::new(),
+            request_metrics: RequestMetrics::new(),
             query_catalog,
             tls_provider,
         };
@@ -69,6 +74,14 @@ impl ServiceContext {
         &self.0.transaction_store
     }
 
+    pub fn response_cache(&self) -> &ResponseCache {
+        &self.0.response_cache
+    }
+
+    pub fn request_metrics(&self) -> &RequestMetrics {
+        &self.0.request_metrics
+    }
+
     pub fn query_catalog(&self) -> &QueryCatalog {
         &self.0.query_catalog
     }
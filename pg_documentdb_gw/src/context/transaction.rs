@@ -20,6 +20,7 @@ use crate::{
     context::{ConnectionContext, CursorStore},
     error::{DocumentDBError, ErrorCode, Result},
     postgres::{self, Connection, PgDataClient},
+    requests::request_tracker::RequestTracker,
 };
 
 #[derive(Debug)]
@@ -45,11 +46,14 @@ impl Transaction {
         conn: Arc<Connection>,
         isolation_level: IsolationLevel,
         session_id: Vec<u8>,
+        request_tracker: &RequestTracker,
     ) -> Result<Self> {
         Ok(Transaction {
             session_id,
             transaction_number: request.transaction_number,
-            transaction: Some(postgres::Transaction::start(conn, isolation_level).await?),
+            transaction: Some(
+                postgres::Transaction::start(conn, isolation_level, request_tracker).await?,
+            ),
             cursors: CursorStore::new(config, false),
         })
     }
@@ -62,7 +66,7 @@ impl Transaction {
         &self.session_id
     }
 
-    pub async fn commit(&mut self) -> Result<()> {
+    pub async fn commit(&mut self, request_tracker: &RequestTracker) -> Result<()> {
         let t = self
             .transaction
             .as_mut()
@@ -70,7 +74,7 @@ impl Transaction {
                 ErrorCode::NoSuchTransaction,
                 "No transaction found to commit".to_string(),
             ))?;
-        t.commit().await
+        t.commit(request_tracker).await
     }
 
     pub async fn abort(&mut self) -> Result<()> {
@@ -165,6 +169,7 @@ impl TransactionStore {
         transaction_info: &RequestTransactionInfo,
         session_id: Vec<u8>,
         pg_data_client: &impl PgDataClient,
+        request_tracker: &RequestTracker,
     ) -> Result<()> {
         if let Some((_, transaction_number)) = connection_context.transaction.as_ref() {
             if transaction_number > &transaction_info.transaction_number {
@@ -222,6 +227,7 @@ impl TransactionStore {
                     .isolation_level
                     .unwrap_or(IsolationLevel::ReadCommitted),
                 session_id.clone(),
+                request_tracker,
             )
             .await?;
 
@@ -297,9 +303,9 @@ impl TransactionStore {
         }
     }
 
-    pub async fn commit(&self, session_id: &[u8]) -> Result<()> {
+    pub async fn commit(&self, session_id: &[u8], request_tracker: &RequestTracker) -> Result<()> {
         if let Some((_, (_, mut transaction))) = self.transactions.remove(session_id) {
-            transaction.commit().await?;
+            transaction.commit(request_tracker).await?;
             if let Some(mut last_seen) = self.last_seen_transactions.get_mut(session_id) {
                 last_seen.state = TransactionState::Committed;
             } else {
@@ -30,6 +30,9 @@ mod query_diagnostics;
 
 static MAX_EXPLAIN_BSON_COMMAND_LENGTH: usize = 100 * 1024;
 
+/// Postgres block size, used to convert temp blocks written to bytes.
+const PG_BLOCK_SIZE: i64 = 8192;
+
 type AggregationStage = (
     &'static str,
     Option<fn(&ExplainPlan, &mut RawDocumentBuf, &QueryCatalog) -> ()>,
@@ -1554,9 +1557,16 @@ fn execution_stats(plan: ExplainPlan, query_catalog: &QueryCatalog) -> RawDocume
         if stage_name == "TEXT_MATCH" {
             doc.append("textIndexVersion", 3)
         }
-        if plan.sort_space_type.as_deref().is_some_and(|s| s == "Disk") {
+        let spilled_blocks = exclusive_temp_written_blocks(plan);
+        if plan.sort_space_type.as_deref().is_some_and(|s| s == "Disk") || spilled_blocks > 0 {
             doc.append("usedDisk", true)
         }
+        if spilled_blocks > 0 {
+            doc.append(
+                "spilledBytes",
+                smallest_from_i64(spilled_blocks * PG_BLOCK_SIZE),
+            )
+        }
         if let Some(method) = plan.sort_method.as_deref() {
             doc.append("sortMethod", method)
         }
@@ -1602,6 +1612,21 @@ fn execution_stats(plan: ExplainPlan, query_catalog: &QueryCatalog) -> RawDocume
     }
 }
 
+/// Temp blocks written by the node itself (Postgres reports buffers including the children).
+fn exclusive_temp_written_blocks(plan: &ExplainPlan) -> i64 {
+    let Some(blocks) = plan.temp_written_blocks else {
+        return 0;
+    };
+
+    let inner_blocks: i64 = plan
+        .inner_plans
+        .iter()
+        .flatten()
+        .filter_map(|p| p.temp_written_blocks)
+        .sum();
+    blocks - inner_blocks
+}
+
 fn distribute_index_details(plan: &mut ExplainPlan, index_details: Option<Vec<IndexDetails>>) {
     plan.index_details = index_details;
 
@@ -169,6 +169,9 @@ pub struct ExplainPlan {
     #[serde(rename = "Shared Read Blocks")]
     pub shared_read_blocks: Option<i64>,
 
+    #[serde(rename = "Temp Written Blocks")]
+    pub temp_written_blocks: Option<i64>,
+
     #[serde(rename = "I/O Read Time")]
     pub io_read_time: Option<i64>,
 
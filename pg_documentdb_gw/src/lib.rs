@@ -568,6 +568,15 @@ where
             }
         }
     }
+
+    if let Some(telemetry) = connection_context.telemetry_provider.as_ref() {
+        let compression_stats = connection_context.compression.stats();
+        if !compression_stats.is_empty() {
+            telemetry
+                .emit_compression_metrics(&connection_context, compression_stats)
+                .await;
+        }
+    }
 }
 
 async fn get_response<T>(
@@ -620,9 +629,16 @@ where
 
     // Read the request message off the stream
     let read_request_start = Instant::now();
-    let message = protocol::reader::read_request(header, stream).await?;
+    let message =
+        protocol::reader::read_request(header, stream, &mut connection_context.compression).await?;
     request_tracker.record_duration(RequestIntervalKind::ReadRequest, read_request_start);
 
+    // A compressed request is answered in the format of the message it wraps
+    let header = &Header {
+        op_code: message.op_code,
+        ..*header
+    };
+
     // HandleMessage captures the overall duration needed by the server to handle/process
     // a user operation message/request. Client-to-Gateway networking latency should be
     // excluded from HandleMessage; therefore, ReadRequest is closed before this starts,
@@ -694,6 +710,11 @@ where
         None
     };
 
+    connection_context
+        .service_context
+        .request_metrics()
+        .record(*request.request_type(), &request_tracker);
+
     if connection_context
         .dynamic_configuration()
         .enable_verbose_logging_in_gateway()
@@ -741,7 +762,13 @@ where
 
     if connection_context.requires_response {
         let write_response_start = Instant::now();
-        responses::writer::write(header, &response, stream).await?;
+        responses::writer::write(
+            header,
+            &response,
+            stream,
+            &mut connection_context.compression,
+        )
+        .await?;
         request_context
             .tracker
             .record_duration(RequestIntervalKind::WriteResponse, write_response_start);
@@ -831,11 +858,12 @@ async fn log_verbose_latency(
     tracing::info!(
         activity_id = request_context.activity_id,
         event_id = EventId::RequestTrace.code(),
-        "Latency for Mongo Request with interval timings (ns): ReadRequest={}, HandleMessage={} FormatRequest={}, HandleRequest={}, ProcessRequest={}, PostgresBeginTransaction={}, PostgresSetStatementTimeout={}, PostgresCommitTransaction={}, WriteResponse={}, Address={}, TransportProtocol={}, DatabaseName={}, CollectionName={}, OperationName={}, StatusCode={}, SubStatusCode={}, ErrorCode={}",
+        "Latency for Mongo Request with interval timings (ns): ReadRequest={}, HandleMessage={} FormatRequest={}, HandleRequest={}, PoolWait={}, ProcessRequest={}, PostgresBeginTransaction={}, PostgresSetStatementTimeout={}, PostgresCommitTransaction={}, WriteResponse={}, Address={}, TransportProtocol={}, DatabaseName={}, CollectionName={}, OperationName={}, StatusCode={}, SubStatusCode={}, ErrorCode={}",
         request_context.tracker.get_interval_elapsed_time(RequestIntervalKind::ReadRequest),
         request_context.tracker.get_interval_elapsed_time(RequestIntervalKind::HandleMessage),
         request_context.tracker.get_interval_elapsed_time(RequestIntervalKind::FormatRequest),
         request_context.tracker.get_interval_elapsed_time(RequestIntervalKind::HandleRequest),
+        request_context.tracker.get_interval_elapsed_time(RequestIntervalKind::PoolWait),
         request_context.tracker.get_interval_elapsed_time(RequestIntervalKind::ProcessRequest),
         request_context.tracker.get_interval_elapsed_time(RequestIntervalKind::PostgresBeginTransaction),
         request_context.tracker.get_interval_elapsed_time(RequestIntervalKind::PostgresSetStatementTimeout),
@@ -6,6 +6,8 @@
  *-------------------------------------------------------------------------
  */
 
+use std::sync::atomic::{AtomicI64, Ordering};
+
 use tokio::time::{Duration, Instant};
 use tokio_postgres::{
     types::{ToSql, Type},
@@ -25,6 +27,10 @@ use crate::{
 pub struct Connection {
     pool_connection: PoolConnection,
     pub in_transaction: bool,
+
+    // Time spent checking the connection out of the pool, charged to the first request
+    // that queries with it.
+    pool_wait_nanos: AtomicI64,
 }
 
 pub enum TimeoutType {
@@ -70,6 +76,37 @@ impl Connection {
         Ok(self.pool_connection.query(&statement, params).await?)
     }
 
+    // Runs the query between the setup and teardown commands. All three requests are sent
+    // before any response is awaited, so Postgres executes them back to back and the whole
+    // exchange costs a single network round trip instead of one per command.
+    async fn query_pipelined(
+        &self,
+        setup: &str,
+        query: &str,
+        parameter_types: &[Type],
+        params: &[&(dyn ToSql + Sync)],
+        teardown: &str,
+    ) -> Result<Vec<Row>> {
+        // Prepare first: a statement cache miss needs its own round trip, and the teardown
+        // must not be sent ahead of the query.
+        let statement = self
+            .pool_connection
+            .prepare_typed_cached(query, parameter_types)
+            .await?;
+
+        let (setup_result, query_result, teardown_result) = tokio::join!(
+            self.pool_connection.batch_execute(setup),
+            self.pool_connection.query(&statement, params),
+            self.pool_connection.batch_execute(teardown),
+        );
+
+        // Report the earliest failure; a failed query also fails a teardown in its transaction.
+        setup_result?;
+        let results = query_result?;
+        teardown_result?;
+        Ok(results)
+    }
+
     pub async fn query(
         &self,
         query: &str,
@@ -78,114 +115,59 @@ impl Connection {
         timeout: Option<Timeout>,
         request_tracker: &RequestTracker,
     ) -> Result<Vec<Row>> {
-        match timeout {
+        let pool_wait_nanos = self.pool_wait_nanos.swap(0, Ordering::Relaxed);
+        if pool_wait_nanos > 0 {
+            request_tracker.record_nanos(RequestIntervalKind::PoolWait, pool_wait_nanos);
+        }
+
+        let default_timeout_ms = Duration::from_secs(120).as_millis();
+        let request_start = Instant::now();
+        let results = match timeout {
             Some(Timeout {
                 timeout_type: _,
                 max_time_ms,
             }) if self.in_transaction => {
-                let set_timeout_start = Instant::now();
-                self.pool_connection
-                    .batch_execute(&format!("set local statement_timeout to {max_time_ms}"))
-                    .await?;
-                request_tracker.record_duration(
-                    RequestIntervalKind::PostgresSetStatementTimeout,
-                    set_timeout_start,
-                );
-
-                let request_start = Instant::now();
-                let results = self.query_internal(query, parameter_types, params).await;
-                request_tracker.record_duration(RequestIntervalKind::ProcessRequest, request_start);
-
-                let set_timeout_start = Instant::now();
-                self.pool_connection
-                    .batch_execute(&format!(
-                        "set local statement_timeout to {}",
-                        Duration::from_secs(120).as_millis()
-                    ))
-                    .await?;
-                request_tracker.record_duration(
-                    RequestIntervalKind::PostgresSetStatementTimeout,
-                    set_timeout_start,
-                );
-
-                Ok(results?)
+                self.query_pipelined(
+                    &format!("set local statement_timeout to {max_time_ms}"),
+                    query,
+                    parameter_types,
+                    params,
+                    &format!("set local statement_timeout to {default_timeout_ms}"),
+                )
+                .await
             }
             Some(Timeout {
                 timeout_type: TimeoutType::Transaction,
                 max_time_ms,
             }) => {
-                let begin_transaction_start = Instant::now();
-                self.pool_connection.batch_execute("BEGIN").await?;
-                request_tracker.record_duration(
-                    RequestIntervalKind::PostgresBeginTransaction,
-                    begin_transaction_start,
-                );
-
-                let set_timeout_start = Instant::now();
-                self.pool_connection
-                    .batch_execute(&format!("set local statement_timeout to {max_time_ms}"))
-                    .await?;
-                request_tracker.record_duration(
-                    RequestIntervalKind::PostgresSetStatementTimeout,
-                    set_timeout_start,
-                );
-
-                let request_start = Instant::now();
-                let results = match self.query_internal(query, parameter_types, params).await {
-                    Ok(results) => Ok(results),
-                    Err(e) => {
-                        self.pool_connection.batch_execute("ROLLBACK").await?;
-                        Err(e)
-                    }
-                }?;
-                request_tracker.record_duration(RequestIntervalKind::ProcessRequest, request_start);
-
-                let commit_start = Instant::now();
-                self.pool_connection.batch_execute("COMMIT").await?;
-                request_tracker
-                    .record_duration(RequestIntervalKind::PostgresCommitTransaction, commit_start);
-
-                Ok(results)
+                // COMMIT of a transaction aborted by a failed query rolls it back.
+                self.query_pipelined(
+                    &format!("BEGIN; set local statement_timeout to {max_time_ms}"),
+                    query,
+                    parameter_types,
+                    params,
+                    "COMMIT",
+                )
+                .await
             }
             Some(Timeout {
                 timeout_type: TimeoutType::Command,
                 max_time_ms,
             }) => {
-                let set_timeout_start = Instant::now();
-                self.pool_connection
-                    .batch_execute(&format!("set statement_timeout to {max_time_ms}"))
-                    .await?;
-                request_tracker.record_duration(
-                    RequestIntervalKind::PostgresSetStatementTimeout,
-                    set_timeout_start,
-                );
-
-                let request_start = Instant::now();
-                let results = self.query_internal(query, parameter_types, params).await;
-                request_tracker.record_duration(RequestIntervalKind::ProcessRequest, request_start);
-
-                let set_timeout_start = Instant::now();
-                self.pool_connection
-                    .batch_execute(&format!(
-                        "set statement_timeout to {}",
-                        Duration::from_secs(120).as_millis()
-                    ))
-                    .await?;
-                request_tracker.record_duration(
-                    RequestIntervalKind::PostgresSetStatementTimeout,
-                    set_timeout_start,
-                );
-
-                Ok(results?)
+                self.query_pipelined(
+                    &format!("set statement_timeout to {max_time_ms}"),
+                    query,
+                    parameter_types,
+                    params,
+                    &format!("set statement_timeout to {default_timeout_ms}"),
+                )
+                .await
             }
-            None => {
-                let request_start = Instant::now();
-                let results = self.query_internal(query, parameter_types, params).await;
-                request_tracker.record_duration(RequestIntervalKind::ProcessRequest, request_start);
+            None => self.query_internal(query, parameter_types, params).await,
+        };
+        request_tracker.record_duration(RequestIntervalKind::ProcessRequest, request_start);
 
-                results
-            }
-        }
+        results
     }
 
     pub async fn query_db_bson(
@@ -214,6 +196,14 @@ impl Connection {
         Connection {
             pool_connection,
             in_transaction,
+            pool_wait_nanos: AtomicI64::new(0),
         }
     }
+
+    pub fn with_pool_wait(self, pool_wait: Duration) -> Self {
+        let pool_wait_nanos = i64::try_from(pool_wait.as_nanos()).unwrap_or(i64::MAX);
+        self.pool_wait_nanos
+            .store(pool_wait_nanos, Ordering::Relaxed);
+        self
+    }
 }
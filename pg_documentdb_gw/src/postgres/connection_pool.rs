@@ -7,21 +7,46 @@
  */
 
 use std::{
+    cell::Cell,
     collections::hash_map::DefaultHasher,
     hash::{Hash, Hasher},
+    sync::atomic::{AtomicU64, AtomicUsize, Ordering},
 };
 
-use deadpool_postgres::{Manager, Pool, Runtime, Status};
-use tokio::{
-    sync::RwLock,
-    time::{Duration, Instant},
-};
+use deadpool_postgres::{Manager, Pool, PoolError, Runtime, Status, Timeouts};
+use tokio::time::{Duration, Instant};
 use tokio_postgres::NoTls;
 
-use crate::{configuration::SetupConfiguration, error::Result, QueryCatalog};
+use crate::{
+    configuration::SetupConfiguration,
+    error::Result,
+    telemetry::metrics::{LatencyHistogram, LatencySnapshot},
+    QueryCatalog,
+};
 
 const POOL_PRUNE_INTERVAL_SECS: u64 = 10;
 
+/// Pools are only split into shards when every shard gets at least this many connections.
+const MIN_CONNECTIONS_PER_SHARD: usize = 8;
+
+static NEXT_SHARD_HINT: AtomicUsize = AtomicUsize::new(0);
+
+thread_local! {
+    // Assigned round robin on first use so the runtime worker threads spread across shards.
+    static SHARD_HINT: Cell<Option<usize>> = const { Cell::new(None) };
+}
+
+fn shard_hint() -> usize {
+    SHARD_HINT.with(|hint| match hint.get() {
+        Some(value) => value,
+        None => {
+            let value = NEXT_SHARD_HINT.fetch_add(1, Ordering::Relaxed);
+            hint.set(Some(value));
+            value
+        }
+    })
+}
+
 fn pg_configuration(
     setup_configuration: &dyn SetupConfiguration,
     query_catalog: &QueryCatalog,
@@ -63,11 +88,16 @@ pub type PoolConnection = deadpool_postgres::Object;
 pub struct ConnectionPoolStatus {
     identifier: String,
     status: Status,
+    wait_latency: LatencySnapshot,
 }
 
 impl ConnectionPoolStatus {
     pub fn new(identifier: String, status: Status) -> Self {
-        ConnectionPoolStatus { identifier, status }
+        ConnectionPoolStatus {
+            identifier,
+            status,
+            wait_latency: LatencyHistogram::default().snapshot(),
+        }
     }
 
     pub fn identifier(&self) -> &str {
@@ -77,12 +107,23 @@ impl ConnectionPoolStatus {
     pub fn status(&self) -> Status {
         self.status
     }
+
+    /// How long connection checkouts waited for a connection.
+    pub fn wait_latency(&self) -> &LatencySnapshot {
+        &self.wait_latency
+    }
 }
 
+/// A connection pool split into per worker thread shards. Each runtime worker checks out
+/// from its own shard and only turns to the other shards when its shard is exhausted,
+/// taking their idle connections first and then opening new ones, so concurrent checkouts
+/// rarely contend on the same pool and a busy worker can still use the whole pool size.
 #[derive(Debug)]
 pub struct ConnectionPool {
-    pool: Pool,
-    last_used: RwLock<Instant>,
+    shards: Vec<Pool>,
+    created: Instant,
+    last_used_ms: AtomicU64,
+    wait_latency: LatencyHistogram,
     identifier: String,
 }
 
@@ -103,19 +144,31 @@ impl ConnectionPool {
             &application_name,
         );
 
-        let manager = Manager::new(config, NoTls);
+        let shard_count = setup_configuration
+            .async_runtime_worker_threads()
+            .min(max_size / MIN_CONNECTIONS_PER_SHARD)
+            .max(1);
 
-        let pool_builder = Pool::builder(manager)
-            .runtime(Runtime::Tokio1)
-            .max_size(max_size)
-            // The time to wait while trying to establish a connection before terminating the attempt
-            // Should be the same as the command timeout
-            .wait_timeout(Some(Duration::from_secs(
-                setup_configuration.postgres_command_timeout_secs(),
-            )));
-        let pool = pool_builder.build()?;
+        let mut shards = Vec::with_capacity(shard_count);
+        for shard in 0..shard_count {
+            // Spread the remainder so the shard sizes add up to max_size
+            let shard_max_size =
+                max_size / shard_count + usize::from(shard < max_size % shard_count);
 
-        let pool_copy = pool.clone();
+            let manager = Manager::new(config.clone(), NoTls);
+
+            let pool_builder = Pool::builder(manager)
+                .runtime(Runtime::Tokio1)
+                .max_size(shard_max_size)
+                // The time to wait while trying to establish a connection before terminating the attempt
+                // Should be the same as the command timeout
+                .wait_timeout(Some(Duration::from_secs(
+                    setup_configuration.postgres_command_timeout_secs(),
+                )));
+            shards.push(pool_builder.build()?);
+        }
+
+        let shards_copy = shards.clone();
 
         // how long a connection can be idle before it is pruned
         let idle_connection_max_age = Duration::from_secs(
@@ -129,8 +182,11 @@ impl ConnectionPool {
 
             loop {
                 prune_interval.tick().await;
-                pool_copy
-                    .retain(|_, conn_metrics| conn_metrics.last_used() < idle_connection_max_age);
+                for pool in &shards_copy {
+                    pool.retain(|_, conn_metrics| {
+                        conn_metrics.last_used() < idle_connection_max_age
+                    });
+                }
             }
         });
         let mut hasher = DefaultHasher::new();
@@ -138,27 +194,92 @@ impl ConnectionPool {
         let pool_identifier = format!("{:x}-{application_name}-{max_size}", hasher.finish());
 
         Ok(ConnectionPool {
-            pool,
-            last_used: RwLock::new(Instant::now()),
+            shards,
+            created: Instant::now(),
+            last_used_ms: AtomicU64::new(0),
+            wait_latency: LatencyHistogram::default(),
             identifier: pool_identifier,
         })
     }
 
     pub async fn acquire_connection(&self) -> Result<PoolConnection> {
-        let mut write_lock = self.last_used.write().await;
-        *write_lock = Instant::now();
-        Ok(self.pool.get().await?)
+        let start = Instant::now();
+        self.touch(start);
+
+        let home = &self.shards[shard_hint() % self.shards.len()];
+        let home_status = home.status();
+        let connection = if home_status.available > 0 || home_status.size < home_status.max_size {
+            home.get().await?
+        } else {
+            match self.steal_connection().await? {
+                Some(connection) => connection,
+                None => home.get().await?,
+            }
+        };
+
+        self.wait_latency
+            .record(u64::try_from(start.elapsed().as_nanos()).unwrap_or(u64::MAX));
+        Ok(connection)
+    }
+
+    // Takes an idle connection from any shard without waiting, or else opens one on a shard
+    // that is below its size. Returns None when every shard is busy and full, in which case
+    // the caller queues on its home shard.
+    async fn steal_connection(&self) -> Result<Option<PoolConnection>> {
+        let no_wait = Timeouts::wait_millis(0);
+        let idle_shards = self
+            .shards
+            .iter()
+            .filter(|shard| shard.status().available > 0);
+        let growable_shards = self.shards.iter().filter(|shard| {
+            let status = shard.status();
+            status.size < status.max_size
+        });
+
+        for shard in idle_shards.chain(growable_shards) {
+            match shard.timeout_get(&no_wait).await {
+                Ok(connection) => return Ok(Some(connection)),
+                Err(PoolError::Timeout(_)) => continue,
+                Err(e) => return Err(e.into()),
+            }
+        }
+
+        Ok(None)
+    }
+
+    // Records the checkout time, only writing when the millisecond changes so concurrent
+    // checkouts mostly read a shared cache line.
+    fn touch(&self, now: Instant) {
+        let elapsed_ms =
+            u64::try_from(now.duration_since(self.created).as_millis()).unwrap_or(u64::MAX);
+        if self.last_used_ms.load(Ordering::Relaxed) != elapsed_ms {
+            self.last_used_ms.store(elapsed_ms, Ordering::Relaxed);
+        }
     }
 
-    pub async fn last_used(&self) -> Instant {
-        let read_lock = self.last_used.read().await;
-        *read_lock
+    /// Whether a connection can be checked out without waiting or opening a new one.
+    pub fn has_idle_connection(&self) -> bool {
+        self.shards.iter().any(|shard| shard.status().available > 0)
+    }
+
+    pub fn last_used(&self) -> Instant {
+        self.created + Duration::from_millis(self.last_used_ms.load(Ordering::Relaxed))
     }
 
     pub fn status(&self) -> ConnectionPoolStatus {
+        let mut status = self.shards[0].status();
+        for shard in &self.shards[1..] {
+            let shard_status = shard.status();
+            status.max_size += shard_status.max_size;
+            status.size += shard_status.size;
+            status.available += shard_status.available;
+            status.waiting += shard_status.waiting;
+        }
+
         ConnectionPoolStatus {
             identifier: self.identifier.clone(),
-            status: self.pool.status(),
+            status,
+            wait_latency: self.wait_latency.snapshot(),
         }
     }
 }
@@ -9,7 +9,8 @@
 use std::{future::Future, sync::Arc};
 
 use async_trait::async_trait;
-use bson::RawDocument;
+use bson::{RawDocument, RawDocumentBuf};
+use tokio::task::JoinHandle;
 use tokio_postgres::Row;
 
 use crate::{
@@ -18,6 +19,7 @@ use crate::{
     error::Result,
     explain::Verbosity,
     postgres::Transaction,
+    requests::request_tracker::RequestTracker,
     responses::{PgResponse, Response},
 };
 
@@ -156,6 +158,19 @@ pub trait PgDataClient: Send + Sync {
         connection_context: &ConnectionContext,
     ) -> Result<Vec<Row>>;
 
+    /// Starts fetching the next batch of a stateless cursor in the background. Returns None
+    /// when the client cannot prefetch, e.g. because no idle connection can be spared.
+    fn prefetch_cursor_get_more(
+        &self,
+        _: &ConnectionContext,
+        _: &str,
+        _: RawDocumentBuf,
+        _: RawDocumentBuf,
+        _: Option<i64>,
+    ) -> Option<JoinHandle<Result<Vec<Row>>>> {
+        None
+    }
+
     async fn execute_insert(
         &self,
         request_context: &RequestContext<'_>,
@@ -255,6 +270,12 @@ pub trait PgDataClient: Send + Sync {
         connection_context: &ConnectionContext,
     ) -> Result<Response>;
 
+    async fn execute_profile(
+        &self,
+        request_context: &RequestContext<'_>,
+        connection_context: &ConnectionContext,
+    ) -> Result<Response>;
+
     async fn execute_rename_collection(
         &self,
         request_context: &RequestContext<'_>,
@@ -295,6 +316,15 @@ pub trait PgDataClient: Send + Sync {
         connection_context: &ConnectionContext,
     ) -> Result<Response>;
 
+    /// Whether the user of the connection has a privilege on the cluster resource that
+    /// allows the action (e.g. serverStatus).
+    async fn execute_has_cluster_action(
+        &self,
+        action: &str,
+        request_context: &RequestContext<'_>,
+        connection_context: &ConnectionContext,
+    ) -> Result<bool>;
+
     async fn execute_compact(
         &self,
         request_context: &RequestContext<'_>,
@@ -337,6 +367,7 @@ pub trait PgDataClient: Send + Sync {
         is_read_only_for_disk_full: bool,
         connection: Arc<Connection>,
         query_catalog: &QueryCatalog,
+        request_tracker: &RequestTracker,
         f: F,
     ) -> Result<Vec<Row>>
     where
@@ -344,9 +375,12 @@ pub trait PgDataClient: Send + Sync {
         Fut: Future<Output = Result<Vec<Row>>> + Send,
     {
         if !connection.in_transaction && is_read_only_for_disk_full {
-            let mut transaction =
-                Transaction::start(connection, tokio_postgres::IsolationLevel::RepeatableRead)
-                    .await?;
+            let mut transaction = Transaction::start(
+                connection,
+                tokio_postgres::IsolationLevel::RepeatableRead,
+                request_tracker,
+            )
+            .await?;
 
             // Allow to write for this transaction
             let connection = transaction.get_connection();
@@ -355,7 +389,7 @@ pub trait PgDataClient: Send + Sync {
                 .await?;
 
             let result = f(connection).await?;
-            transaction.commit().await?;
+            transaction.commit(request_tracker).await?;
             Ok(result)
         } else {
             f(connection).await
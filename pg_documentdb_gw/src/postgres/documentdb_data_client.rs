@@ -9,7 +9,8 @@
 use std::sync::Arc;
 
 use async_trait::async_trait;
-use bson::RawDocument;
+use bson::{rawdoc, RawDocument, RawDocumentBuf};
+use tokio::{task::JoinHandle, time::Instant};
 use tokio_postgres::{error::SqlState, types::Type, Row};
 
 use crate::{
@@ -18,6 +19,7 @@ use crate::{
     error::{DocumentDBError, Result},
     explain::Verbosity,
     postgres::{PgDataClient, PoolConnection},
+    requests::request_tracker::RequestTracker,
     responses::{PgResponse, Response},
 };
 
@@ -69,9 +71,13 @@ impl PgDataClient for DocumentDBDataClient {
     }
 
     async fn pull_connection_with_transaction(&self, in_transaction: bool) -> Result<Connection> {
+        let acquire_start = Instant::now();
         let pool_connection = self.acquire_pool_connection().await?;
 
-        Ok(Connection::new(pool_connection, in_transaction))
+        Ok(
+            Connection::new(pool_connection, in_transaction)
+                .with_pool_wait(acquire_start.elapsed()),
+        )
     }
 
     async fn execute_aggregate(
@@ -242,6 +248,7 @@ impl PgDataClient for DocumentDBDataClient {
                 is_read_only_for_disk_full,
                 self.pull_connection(connection_context).await?,
                 query_catalog,
+                request_tracker,
                 move |connection| async move {
                     connection
                         .query(
@@ -304,6 +311,7 @@ impl PgDataClient for DocumentDBDataClient {
                 is_read_only_for_disk_full,
                 self.pull_connection(connection_context).await?,
                 query_catalog,
+                request_tracker,
                 move |connection| async move {
                     connection
                         .query(
@@ -336,6 +344,7 @@ impl PgDataClient for DocumentDBDataClient {
                 is_read_only_for_disk_full,
                 self.pull_connection(connection_context).await?,
                 query_catalog,
+                request_tracker,
                 move |connection| async move {
                     connection
                         .query(
@@ -511,6 +520,41 @@ impl PgDataClient for DocumentDBDataClient {
         Ok(get_more_rows)
     }
 
+    fn prefetch_cursor_get_more(
+        &self,
+        connection_context: &ConnectionContext,
+        db: &str,
+        get_more: RawDocumentBuf,
+        continuation: RawDocumentBuf,
+        max_time_ms: Option<i64>,
+    ) -> Option<JoinHandle<Result<Vec<Row>>>> {
+        let connection_pool = Arc::clone(self.connection_pool.as_ref()?);
+
+        // Prefetching must not take connections that requests are waiting for
+        if !connection_pool.has_idle_connection() {
+            return None;
+        }
+
+        let query = connection_context
+            .service_context
+            .query_catalog()
+            .cursor_get_more()
+            .to_string();
+        let db = db.to_string();
+        Some(tokio::spawn(async move {
+            let connection = Connection::new(connection_pool.acquire_connection().await?, false);
+            connection
+                .query(
+                    &query,
+                    &[Type::TEXT, Type::BYTEA, Type::BYTEA],
+                    &[&db, &PgDocument(&get_more), &PgDocument(&continuation)],
+                    Timeout::command(max_time_ms),
+                    &RequestTracker::new(),
+                )
+                .await
+        }))
+    }
+
     async fn execute_insert(
         &self,
         request_context: &RequestContext<'_>,
@@ -930,6 +974,30 @@ impl PgDataClient for DocumentDBDataClient {
         Ok(Response::Pg(PgResponse::new(db_stats_rows)))
     }
 
+    async fn execute_profile(
+        &self,
+        request_context: &RequestContext<'_>,
+        connection_context: &ConnectionContext,
+    ) -> Result<Response> {
+        let (request, request_info, request_tracker) = request_context.get_components();
+        let profile_rows = self
+            .pull_connection(connection_context)
+            .await?
+            .query(
+                connection_context.service_context.query_catalog().profile(),
+                &[Type::TEXT, Type::BYTEA],
+                &[
+                    &request_info.db()?.to_string(),
+                    &PgDocument(request.document()),
+                ],
+                Timeout::command(request_info.max_time_ms),
+                request_tracker,
+            )
+            .await?;
+
+        Ok(Response::Pg(PgResponse::new(profile_rows)))
+    }
+
     async fn execute_rename_collection(
         &self,
         request_context: &RequestContext<'_>,
@@ -1193,6 +1261,63 @@ impl PgDataClient for DocumentDBDataClient {
         Ok(Response::Pg(PgResponse::new(connection_status_rows)))
     }
 
+    async fn execute_has_cluster_action(
+        &self,
+        action: &str,
+        request_context: &RequestContext<'_>,
+        connection_context: &ConnectionContext,
+    ) -> Result<bool> {
+        let (_, request_info, request_tracker) = request_context.get_components();
+        let spec = rawdoc! { "connectionStatus": 1, "showPrivileges": true };
+        let connection_status_rows = self
+            .pull_connection(connection_context)
+            .await?
+            .query(
+                connection_context
+                    .service_context
+                    .query_catalog()
+                    .connection_status(),
+                &[Type::BYTEA],
+                &[&PgDocument(&spec)],
+                Timeout::command(request_info.max_time_ms),
+                request_tracker,
+            )
+            .await?;
+
+        let status: PgDocument = connection_status_rows
+            .first()
+            .ok_or(DocumentDBError::pg_response_empty())?
+            .try_get(0)?;
+        let privileges = status
+            .0
+            .get_document("authInfo")
+            .and_then(|auth_info| auth_info.get_array("authenticatedUserPrivileges"))
+            .map_err(DocumentDBError::pg_response_invalid)?;
+
+        // The privileges are the ones the backend grants to the user's role (see role_utils.c)
+        for privilege in privileges.into_iter().flatten() {
+            let Some(privilege) = privilege.as_document() else {
+                continue;
+            };
+
+            let is_cluster = privilege
+                .get_document("resource")
+                .and_then(|resource| resource.get_bool("cluster"))
+                .unwrap_or(false);
+            let has_action = privilege.get_array("actions").is_ok_and(|actions| {
+                actions
+                    .into_iter()
+                    .flatten()
+                    .any(|value| value.as_str() == Some(action))
+            });
+            if is_cluster && has_action {
+                return Ok(true);
+            }
+        }
+
+        Ok(false)
+    }
+
     async fn execute_compact(
         &self,
         request_context: &RequestContext<'_>,
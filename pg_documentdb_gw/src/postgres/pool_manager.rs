@@ -6,12 +6,10 @@
  *-------------------------------------------------------------------------
  */
 
-use std::{collections::HashMap, hash::Hash, sync::Arc};
+use std::{hash::Hash, sync::Arc};
 
-use tokio::{
-    sync::RwLock,
-    time::{interval, Duration},
-};
+use dashmap::{mapref::entry::Entry, DashMap};
+use tokio::time::{interval, Duration};
 
 use crate::{
     configuration::{DynamicConfiguration, SetupConfiguration},
@@ -42,8 +40,9 @@ pub struct PoolManager {
 
     // Maps user credentials to their respective connection pools
     // We need Arc on the ConnectionPool to allow sharing across threads from different connections
-    user_data_pools: RwLock<HashMap<ClientKey, Arc<ConnectionPool>>>,
-    system_shared_pools: RwLock<HashMap<usize, Arc<ConnectionPool>>>,
+    // The maps are sharded so lookups on the request path don't serialize on a single lock
+    user_data_pools: DashMap<ClientKey, Arc<ConnectionPool>>,
+    system_shared_pools: DashMap<usize, Arc<ConnectionPool>>,
 }
 
 impl PoolManager {
@@ -60,8 +59,8 @@ impl PoolManager {
             dynamic_configuration,
             system_requests_pool,
             system_auth_pool,
-            user_data_pools: RwLock::new(HashMap::new()),
-            system_shared_pools: RwLock::new(HashMap::new()),
+            user_data_pools: DashMap::new(),
+            system_shared_pools: DashMap::new(),
         }
     }
 
@@ -71,13 +70,15 @@ impl PoolManager {
         password: &str,
     ) -> Result<Arc<ConnectionPool>> {
         let max_connections = self.dynamic_configuration.max_connections().await;
-        let read_lock = self.user_data_pools.read().await;
-
-        match read_lock.get(&(username.to_string(), password.to_string(), max_connections)) {
+        match self.user_data_pools.get(&(
+            username.to_string(),
+            password.to_string(),
+            max_connections,
+        )) {
             None => Err(DocumentDBError::internal_error(
                 "Connection pool missing for user.".to_string(),
             )),
-            Some(pool_ref) => Ok(Arc::clone(pool_ref)),
+            Some(pool_ref) => Ok(Arc::clone(pool_ref.value())),
         }
     }
 
@@ -110,95 +111,75 @@ impl PoolManager {
 
         let key = (username.to_string(), password.to_string(), max_connections);
 
-        if self.user_data_pools.read().await.contains_key(&key) {
+        if self.user_data_pools.contains_key(&key) {
             return Ok(());
         }
 
-        let mut write_lock = self.user_data_pools.write().await;
-
-        // Check again after acquiring write lock to handle race condition
-        if write_lock.contains_key(&key) {
-            return Ok(());
+        // Computed before taking the entry, map guards must not be held across an await
+        let real_max_connections = self.get_real_max_connections(max_connections).await;
+
+        // The entry locks the key's shard to handle the race with a concurrent allocation
+        if let Entry::Vacant(entry) = self.user_data_pools.entry(key) {
+            entry.insert(Arc::new(ConnectionPool::new_with_user(
+                self.setup_configuration.as_ref(),
+                &self.query_catalog,
+                username,
+                Some(password),
+                format!("{}-UserData", self.setup_configuration.application_name()),
+                real_max_connections,
+            )?));
         }
 
-        let user_data_pool = Arc::new(ConnectionPool::new_with_user(
-            self.setup_configuration.as_ref(),
-            &self.query_catalog,
-            username,
-            Some(password),
-            format!("{}-UserData", self.setup_configuration.application_name()),
-            self.get_real_max_connections(max_connections).await,
-        )?);
-
-        write_lock.insert(key, user_data_pool);
-
         Ok(())
     }
 
     pub async fn get_system_shared_pool(&self) -> Result<Arc<ConnectionPool>> {
         let max_connections = self.dynamic_configuration.max_connections().await;
 
-        if let Some(pool_ref) = self.system_shared_pools.read().await.get(&max_connections) {
-            return Ok(Arc::clone(pool_ref));
+        if let Some(pool_ref) = self.system_shared_pools.get(&max_connections) {
+            return Ok(Arc::clone(pool_ref.value()));
         }
 
-        let mut write_lock = self.system_shared_pools.write().await;
-
-        // Check again after acquiring write lock to handle race condition
-        if let Some(pool_ref) = write_lock.get(&max_connections) {
-            return Ok(Arc::clone(pool_ref));
+        // Computed before taking the entry, map guards must not be held across an await
+        let real_max_connections = self.get_real_max_connections(max_connections).await;
+
+        // The entry locks the key's shard to handle the race with a concurrent allocation
+        match self.system_shared_pools.entry(max_connections) {
+            Entry::Occupied(entry) => Ok(Arc::clone(entry.get())),
+            Entry::Vacant(entry) => {
+                let system_shared_pool = Arc::new(ConnectionPool::new_with_user(
+                    self.setup_configuration.as_ref(),
+                    &self.query_catalog,
+                    &self.setup_configuration.postgres_system_user(),
+                    None,
+                    format!("{}-SharedData", self.setup_configuration.application_name()),
+                    real_max_connections,
+                )?);
+
+                entry.insert(Arc::clone(&system_shared_pool));
+                Ok(system_shared_pool)
+            }
         }
-
-        let system_shared_pool = Arc::new(ConnectionPool::new_with_user(
-            self.setup_configuration.as_ref(),
-            &self.query_catalog,
-            &self.setup_configuration.postgres_system_user(),
-            None,
-            format!("{}-SharedData", self.setup_configuration.application_name()),
-            self.get_real_max_connections(max_connections).await,
-        )?);
-
-        write_lock.insert(max_connections, Arc::clone(&system_shared_pool));
-
-        Ok(system_shared_pool)
     }
 
     pub async fn clean_unused_pools(&self, max_age: Duration) {
-        async fn clean<K>(map: &RwLock<HashMap<K, Arc<ConnectionPool>>>, max_age: Duration)
+        fn clean<K>(map: &DashMap<K, Arc<ConnectionPool>>, max_age: Duration)
         where
-            K: Clone + Eq + Hash,
+            K: Eq + Hash,
         {
-            let mut keys_to_remove = Vec::new();
-            {
-                let read_lock = map.read().await;
-                for (key, pool) in read_lock.iter() {
-                    if pool.last_used().await.elapsed() > max_age {
-                        keys_to_remove.push(key.clone());
-                    }
-                }
-            }
-
-            {
-                let mut write_lock = map.write().await;
-                for key in keys_to_remove {
-                    write_lock.remove(&key);
-                }
-            }
+            map.retain(|_, pool| pool.last_used().elapsed() <= max_age);
         }
 
-        clean(&self.user_data_pools, max_age).await;
-        clean(&self.system_shared_pools, max_age).await;
+        clean(&self.user_data_pools, max_age);
+        clean(&self.system_shared_pools, max_age);
     }
 
     pub async fn report_pool_stats(&self) -> Vec<ConnectionPoolStatus> {
-        async fn report<K>(
-            map: &RwLock<HashMap<K, Arc<ConnectionPool>>>,
-            reports: &mut Vec<ConnectionPoolStatus>,
-        ) where
-            K: Clone + Eq + Hash,
+        fn report<K>(map: &DashMap<K, Arc<ConnectionPool>>, reports: &mut Vec<ConnectionPoolStatus>)
+        where
+            K: Eq + Hash,
         {
-            let read_lock = map.read().await;
-            for (_, pool) in read_lock.iter() {
+            for pool in map.iter() {
                 reports.push(pool.status())
             }
         }
@@ -208,8 +189,8 @@ impl PoolManager {
             self.system_requests_pool.status(),
         ];
 
-        report(&self.user_data_pools, &mut pool_stats).await;
-        report(&self.system_shared_pools, &mut pool_stats).await;
+        report(&self.user_data_pools, &mut pool_stats);
+        report(&self.system_shared_pools, &mut pool_stats);
 
         pool_stats
     }
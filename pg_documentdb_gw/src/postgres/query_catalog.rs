@@ -84,6 +84,7 @@ pub struct QueryCatalog {
     pub count_query: String,
     pub coll_stats: String,
     pub db_stats: String,
+    pub profile: String,
     pub current_op: String,
     pub get_parameter: String,
     pub compact: String,
@@ -347,6 +348,10 @@ impl QueryCatalog {
         &self.db_stats
     }
 
+    pub fn profile(&self) -> &str {
+        &self.profile
+    }
+
     pub fn shard_collection(&self) -> &str {
         &self.shard_collection
     }
@@ -527,6 +532,7 @@ pub fn create_query_catalog() -> QueryCatalog {
             count_query: "SELECT document FROM documentdb_api.count_query($1, $2)".to_string(),
             coll_stats: "SELECT documentdb_api.coll_stats($1, $2, $3)".to_string(),
             db_stats: "SELECT documentdb_api.db_stats($1, $2, $3)".to_string(),
+            profile: "SELECT documentdb_api.profile($1, $2)".to_string(),
             current_op: "SELECT documentdb_api.current_op_command($1)".to_string(),
             get_parameter: "SELECT documentdb_api.get_parameter($1, $2, $3)".to_string(),
             compact: "SELECT documentdb_api.compact($1)".to_string(),
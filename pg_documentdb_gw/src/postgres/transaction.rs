@@ -8,10 +8,14 @@
 
 use std::sync::Arc;
 
+use tokio::time::Instant;
 use tokio_postgres::IsolationLevel;
 
 use super::{Connection, QueryCatalog};
-use crate::error::{DocumentDBError, Result};
+use crate::{
+    error::{DocumentDBError, Result},
+    requests::{request_tracker::RequestTracker, RequestIntervalKind},
+};
 
 pub struct Transaction {
     conn: Arc<Connection>,
@@ -19,7 +23,11 @@ pub struct Transaction {
 }
 
 impl Transaction {
-    pub async fn start(conn: Arc<Connection>, isolation_level: IsolationLevel) -> Result<Self> {
+    pub async fn start(
+        conn: Arc<Connection>,
+        isolation_level: IsolationLevel,
+        request_tracker: &RequestTracker,
+    ) -> Result<Self> {
         let isolation = match isolation_level {
             IsolationLevel::RepeatableRead => "REPEATABLE READ",
             IsolationLevel::ReadCommitted => "READ COMMITTED",
@@ -30,11 +38,13 @@ impl Transaction {
             }
         };
 
+        let begin_start = Instant::now();
         conn
             .batch_execute(&format!(
                 "START TRANSACTION ISOLATION LEVEL {isolation}; SET LOCAL lock_timeout='20ms'; SET LOCAL citus.max_adaptive_executor_pool_size=1;"
             ))
             .await?;
+        request_tracker.record_duration(RequestIntervalKind::PostgresBeginTransaction, begin_start);
 
         Ok(Transaction {
             conn,
@@ -46,8 +56,11 @@ impl Transaction {
         Arc::clone(&self.conn)
     }
 
-    pub async fn commit(&mut self) -> Result<()> {
+    pub async fn commit(&mut self, request_tracker: &RequestTracker) -> Result<()> {
+        let commit_start = Instant::now();
         self.conn.batch_execute("COMMIT").await?;
+        request_tracker
+            .record_duration(RequestIntervalKind::PostgresCommitTransaction, commit_start);
         self.committed = true;
         Ok(())
     }
@@ -559,6 +559,14 @@ static SUPPORTED_COMMANDS : [CommandInfo; 62] = [
 		requires_auth: false,
 		secondary_override_ok: None,
 	},
+	CommandInfo {
+		command_name: "profile",
+		admin_only: false,
+		help: "Set or get the profiling level of a database.",
+		secondary_ok: false,
+		requires_auth: true,
+		secondary_override_ok: None,
+	},
 	CommandInfo {
 		command_name: "reIndex",
 		admin_only: false,
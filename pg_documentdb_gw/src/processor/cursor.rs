@@ -6,12 +6,15 @@
  *-------------------------------------------------------------------------
  */
 
-use std::{sync::Arc, time::Duration};
+use std::{
+    sync::{atomic::Ordering, Arc},
+    time::Duration,
+};
 
-use bson::{rawdoc, RawArrayBuf};
+use bson::{rawdoc, RawArrayBuf, RawDocumentBuf};
 
 use crate::{
-    context::{ConnectionContext, Cursor, CursorStoreEntry, RequestContext},
+    context::{ConnectionContext, Cursor, CursorPrefetch, CursorStoreEntry, RequestContext},
     error::{DocumentDBError, ErrorCode, Result},
     postgres::{Connection, PgDataClient, PgDocument},
     protocol::OK_SUCCEEDED,
@@ -43,6 +46,7 @@ pub async fn save_cursor(
                 request_info.collection()?,
                 cursor_timeout,
                 request_info.session_id.map(|v| v.to_vec()),
+                None,
             )
             .await;
     }
@@ -121,11 +125,21 @@ pub async fn process_get_more(
     let request = request_context.payload;
 
     let mut id = None;
+    let mut batch_size = None;
     request.extract_fields(|k, v| {
-        if k == "getMore" {
-            id = Some(v.as_i64().ok_or(DocumentDBError::bad_value(
-                "getMore value should be an i64".to_string(),
-            ))?)
+        match k {
+            "getMore" => {
+                id = Some(v.as_i64().ok_or(DocumentDBError::bad_value(
+                    "getMore value should be an i64".to_string(),
+                ))?)
+            }
+            "batchSize" => {
+                batch_size = v
+                    .as_i64()
+                    .or_else(|| v.as_i32().map(i64::from))
+                    .or_else(|| v.as_f64().map(|f| f as i64))
+            }
+            _ => {}
         }
         Ok(())
     })?;
@@ -139,6 +153,7 @@ pub async fn process_get_more(
         collection,
         session_id,
         mut cursor_timeout,
+        prefetch,
         ..
     } = connection_context
         .get_cursor(id, connection_context.auth_state.username()?)
@@ -148,46 +163,69 @@ pub async fn process_get_more(
             "Provided cursor was not found.".to_string(),
         ))?;
 
-    let results = pg_data_client
-        .execute_cursor_get_more(
-            request_context,
-            &db,
-            &cursor,
-            &cursor_connection,
-            connection_context,
-        )
-        .await?;
+    // A prefetched batch was fetched with the batch size of the previous getMore. As only
+    // stateless cursors are prefetched, the batch can be fetched again from the saved
+    // continuation when that batch size changed or the prefetch failed.
+    let prefetched = match prefetch {
+        Some(prefetch) => prefetch.take(batch_size).await,
+        None => None,
+    };
 
-    if !connection_context
-        .service_context
-        .dynamic_configuration()
-        .enable_stateless_cursor_timeout()
-        .await
-    {
-        cursor_timeout = Duration::from_secs(
-            connection_context
-                .service_context
-                .dynamic_configuration()
-                .default_cursor_idle_timeout_sec()
-                .await,
-        );
+    let results = match prefetched {
+        Some(results) => results,
+        None => {
+            pg_data_client
+                .execute_cursor_get_more(
+                    request_context,
+                    &db,
+                    &cursor,
+                    &cursor_connection,
+                    connection_context,
+                )
+                .await?
+        }
+    };
+
+    let dynamic_config = connection_context.service_context.dynamic_configuration();
+    if !dynamic_config.enable_stateless_cursor_timeout().await {
+        cursor_timeout =
+            Duration::from_secs(dynamic_config.default_cursor_idle_timeout_sec().await);
     }
 
     if let Some(row) = results.first() {
         let continuation: Option<PgDocument> = row.try_get(1)?;
         if let Some(continuation) = continuation {
+            let continuation = continuation.0.to_raw_document_buf();
+            let prefetch =
+                if cursor_connection.is_none() && connection_context.transaction.is_none() {
+                    let response: PgDocument = row.try_get(0)?;
+                    start_prefetch(
+                        request_context,
+                        connection_context,
+                        pg_data_client,
+                        &db,
+                        &continuation,
+                        batch_size,
+                        response.0.as_bytes().len(),
+                    )
+                    .await
+                } else {
+                    None
+                };
+
             connection_context
                 .add_cursor(
                     cursor_connection,
                     Cursor {
                         cursor_id: id,
-                        continuation: continuation.0.to_raw_document_buf(),
+                        continuation,
                     },
                     connection_context.auth_state.username()?,
                     &db,
                     &collection,
                     cursor_timeout,
                     session_id,
+                    prefetch,
                 )
                 .await;
         }
@@ -195,3 +233,51 @@ pub async fn process_get_more(
 
     Ok(Response::Pg(PgResponse::new(results)))
 }
+
+// Starts fetching the batch after the one being returned, so that the client's next getMore
+// is answered from memory. Only one batch is fetched ahead per cursor, and none when the
+// batches or the memory already reserved by other cursors exceed the configured budgets.
+async fn start_prefetch(
+    request_context: &RequestContext<'_>,
+    connection_context: &ConnectionContext,
+    pg_data_client: &impl PgDataClient,
+    db: &str,
+    continuation: &RawDocumentBuf,
+    batch_size: Option<i64>,
+    batch_bytes: usize,
+) -> Option<CursorPrefetch> {
+    let dynamic_config = connection_context.service_context.dynamic_configuration();
+    if !dynamic_config.enable_cursor_prefetch().await {
+        return None;
+    }
+
+    let stats = connection_context
+        .service_context
+        .cursor_store()
+        .prefetch_stats();
+    if batch_bytes > dynamic_config.cursor_prefetch_max_batch_bytes().await
+        || stats.buffered_bytes.load(Ordering::Relaxed) + batch_bytes
+            > dynamic_config.cursor_prefetch_max_total_bytes().await
+    {
+        stats.skipped.fetch_add(1, Ordering::Relaxed);
+        return None;
+    }
+
+    let Some(handle) = pg_data_client.prefetch_cursor_get_more(
+        connection_context,
+        db,
+        request_context.payload.document().to_raw_document_buf(),
+        continuation.clone(),
+        request_context.info.max_time_ms,
+    ) else {
+        stats.skipped.fetch_add(1, Ordering::Relaxed);
+        return None;
+    };
+
+    Some(CursorPrefetch::new(
+        handle,
+        batch_size,
+        batch_bytes,
+        Arc::clone(stats),
+    ))
+}
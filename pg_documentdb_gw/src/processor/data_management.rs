@@ -228,6 +228,16 @@ pub async fn process_db_stats(
         .await
 }
 
+pub async fn process_profile(
+    request_context: &RequestContext<'_>,
+    connection_context: &ConnectionContext,
+    pg_data_client: &impl PgDataClient,
+) -> Result<Response> {
+    pg_data_client
+        .execute_profile(request_context, connection_context)
+        .await
+}
+
 pub async fn process_current_op(
     request_context: &RequestContext<'_>,
     connection_context: &ConnectionContext,
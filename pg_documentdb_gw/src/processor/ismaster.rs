@@ -11,7 +11,7 @@ use std::{
     time::{SystemTime, UNIX_EPOCH},
 };
 
-use bson::rawdoc;
+use bson::{rawdoc, RawBson};
 
 use crate::{
     configuration::DynamicConfiguration,
@@ -65,6 +65,23 @@ pub async fn process(
         "ok": OK_SUCCEEDED,
     };
 
+    // Negotiate wire compression, advertising the enabled compressors the client also supports
+    if let Ok(requested) = request.document().get_array("compression") {
+        let enabled = dynamic_configuration.wire_compressors().await;
+        let min_response_bytes = usize::try_from(
+            dynamic_configuration
+                .wire_compression_min_response_bytes()
+                .await,
+        )
+        .unwrap_or(0);
+
+        let compressors =
+            connection_context
+                .compression
+                .negotiate(requested, &enabled, min_response_bytes)?;
+        response_doc.append("compression", RawBson::Array(compressors));
+    }
+
     // Add the operationTime field if change streams GUC is enabled
     if dynamic_configuration.enable_change_streams().await {
         response_doc.append(
@@ -14,13 +14,13 @@ use tokio_postgres::error::SqlState;
 
 use crate::{
     configuration::DynamicConfiguration,
-    context::{ConnectionContext, RequestContext},
+    context::{CacheLookup, ConnectionContext, RequestContext},
     error::{DocumentDBError, ErrorCode, Result},
     explain,
     postgres::PgDataClient,
     processor::{
-        constant, cursor, data_description, data_management, indexing, ismaster, roles, session,
-        transaction, users,
+        constant, cursor, data_description, data_management, indexing, ismaster, roles,
+        server_status, session, transaction, users,
     },
     requests::RequestType,
     responses::Response,
@@ -36,6 +36,39 @@ pub async fn process_request(
     request_context: &RequestContext<'_>,
     connection_context: &mut ConnectionContext,
     pg_data_client: impl PgDataClient,
+) -> Result<Response> {
+    let service_context = Arc::clone(&connection_context.service_context);
+    let response_cache = service_context.response_cache();
+    let dynamic_config = connection_context.dynamic_configuration();
+
+    let cache_ticket = match response_cache
+        .lookup(request_context, connection_context, dynamic_config.as_ref())
+        .await
+    {
+        Some(CacheLookup::Hit(response)) => return Ok(response),
+        Some(CacheLookup::Miss(ticket)) => Some(ticket),
+        None => None,
+    };
+
+    let result = dispatch_request(request_context, connection_context, pg_data_client).await;
+
+    if let (Some(ticket), Ok(response)) = (cache_ticket, &result) {
+        response_cache.insert(ticket, response);
+    }
+    response_cache.invalidate(
+        request_context.payload.request_type(),
+        request_context.info.db().ok(),
+        request_context.payload.document(),
+        result.is_ok(),
+    );
+
+    result
+}
+
+async fn dispatch_request(
+    request_context: &RequestContext<'_>,
+    connection_context: &mut ConnectionContext,
+    pg_data_client: impl PgDataClient,
 ) -> Result<Response> {
     let dynamic_config = connection_context.dynamic_configuration();
 
@@ -301,6 +334,14 @@ pub async fn process_request(
                 )
                 .await
             }
+            RequestType::Profile => {
+                data_management::process_profile(
+                    request_context,
+                    connection_context,
+                    &pg_data_client,
+                )
+                .await
+            }
             RequestType::RenameCollection => {
                 data_description::process_rename_collection(
                     request_context,
@@ -310,7 +351,9 @@ pub async fn process_request(
                 .await
             }
             RequestType::PrepareTransaction => constant::process_prepare_transaction(),
-            RequestType::CommitTransaction => transaction::process_commit(connection_context).await,
+            RequestType::CommitTransaction => {
+                transaction::process_commit(request_context, connection_context).await
+            }
             RequestType::AbortTransaction => transaction::process_abort(connection_context).await,
             RequestType::ListCommands => constant::list_commands(),
             RequestType::EndSessions => {
@@ -325,6 +368,9 @@ pub async fn process_request(
                 )
                 .await
             }
+            RequestType::ServerStatus => {
+                server_status::process(request_context, connection_context, &pg_data_client).await
+            }
             RequestType::WhatsMyUri => constant::process_whats_my_uri(),
             RequestType::CreateUser => {
                 users::process_create_user(request_context, connection_context, &pg_data_client)
@@ -0,0 +1,135 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/processor/server_status.rs
+ *
+ *-------------------------------------------------------------------------
+ */
+
+use std::sync::atomic::Ordering;
+
+use bson::{rawdoc, RawArrayBuf, RawDocumentBuf};
+
+use crate::{
+    context::{ConnectionContext, RequestContext},
+    error::{DocumentDBError, Result},
+    postgres::PgDataClient,
+    protocol::OK_SUCCEEDED,
+    responses::{RawResponse, Response},
+    telemetry::metrics::{LatencySnapshot, TRACKED_INTERVALS},
+};
+
+// serverStatus field names are camel case, the request and interval names are Pascal case.
+fn camel_case(name: &str) -> String {
+    let mut chars = name.chars();
+    match chars.next() {
+        Some(first) => first.to_lowercase().chain(chars).collect(),
+        None => String::new(),
+    }
+}
+
+fn to_i64(value: u64) -> i64 {
+    i64::try_from(value).unwrap_or(i64::MAX)
+}
+
+fn micros(nanos: u64) -> f64 {
+    nanos as f64 / 1000.0
+}
+
+fn latency_document(snapshot: &LatencySnapshot) -> RawDocumentBuf {
+    rawdoc! {
+        "count": to_i64(snapshot.count()),
+        "meanMicros": micros(snapshot.mean_nanos()),
+        "p50Micros": micros(snapshot.percentile_nanos(0.5)),
+        "p90Micros": micros(snapshot.percentile_nanos(0.9)),
+        "p99Micros": micros(snapshot.percentile_nanos(0.99)),
+        "p999Micros": micros(snapshot.percentile_nanos(0.999)),
+        "maxMicros": micros(snapshot.max_nanos()),
+    }
+}
+
+/// Reports the gateway's own metrics: latency percentiles per command broken down by
+/// request interval, connection pool gauges, getMore prefetching and metadata response cache
+/// hit rates.
+/// Like the backend, this requires the serverStatus action on the cluster, which comes with
+/// the clusterMonitor privileges.
+pub async fn process(
+    request_context: &RequestContext<'_>,
+    connection_context: &ConnectionContext,
+    pg_data_client: &impl PgDataClient,
+) -> Result<Response> {
+    if !pg_data_client
+        .execute_has_cluster_action("serverStatus", request_context, connection_context)
+        .await?
+    {
+        return Err(DocumentDBError::unauthorized(
+            "not authorized on admin to execute command serverStatus".to_string(),
+        ));
+    }
+
+    let service_context = &connection_context.service_context;
+
+    let mut latencies = RawDocumentBuf::new();
+    for (request_type, snapshots) in service_context.request_metrics().snapshot() {
+        let mut intervals = RawDocumentBuf::new();
+        for (interval, snapshot) in TRACKED_INTERVALS.iter().zip(&snapshots) {
+            if snapshot.count() > 0 {
+                intervals.append(
+                    camel_case(&format!("{interval:?}")),
+                    latency_document(snapshot),
+                );
+            }
+        }
+        latencies.append(camel_case(&request_type.to_string()), intervals);
+    }
+
+    let mut pools = RawArrayBuf::new();
+    for pool in service_context
+        .connection_pool_manager()
+        .report_pool_stats()
+        .await
+    {
+        let status = pool.status();
+        pools.push(rawdoc! {
+            "identifier": pool.identifier(),
+            "maxSize": i64::try_from(status.max_size).unwrap_or(i64::MAX),
+            "size": i64::try_from(status.size).unwrap_or(i64::MAX),
+            "available": i64::try_from(status.available).unwrap_or(i64::MAX),
+            "waiting": i64::try_from(status.waiting).unwrap_or(i64::MAX),
+            "checkoutWait": latency_document(pool.wait_latency()),
+        });
+    }
+
+    let prefetch = service_context.cursor_store().prefetch_stats();
+    let cursor_prefetch = rawdoc! {
+        "started": to_i64(prefetch.started.load(Ordering::Relaxed)),
+        "served": to_i64(prefetch.served.load(Ordering::Relaxed)),
+        "discarded": to_i64(prefetch.discarded.load(Ordering::Relaxed)),
+        "failed": to_i64(prefetch.failed.load(Ordering::Relaxed)),
+        "skipped": to_i64(prefetch.skipped.load(Ordering::Relaxed)),
+        "bufferedBytes": i64::try_from(prefetch.buffered_bytes.load(Ordering::Relaxed))
+            .unwrap_or(i64::MAX),
+    };
+
+    let mut response_cache = RawDocumentBuf::new();
+    for stats in service_context.response_cache().stats() {
+        response_cache.append(
+            stats.command.name(),
+            rawdoc! {
+                "hits": to_i64(stats.hits),
+                "misses": to_i64(stats.misses),
+                "hitRate": stats.hit_rate(),
+            },
+        );
+    }
+
+    Ok(Response::Raw(RawResponse(rawdoc! {
+        "process": "documentdb_gateway",
+        "localTime": bson::DateTime::now(),
+        "opLatencyBreakdown": latencies,
+        "connectionPools": pools,
+        "cursorPrefetch": cursor_prefetch,
+        "metadataResponseCache": response_cache,
+        "ok": OK_SUCCEEDED,
+    })))
+}
@@ -152,6 +152,7 @@ pub async fn handle(
                 request_transaction_info,
                 session_id.clone(),
                 pg_data_client,
+                request_context.tracker,
             )
             .await;
 
@@ -172,10 +173,13 @@ pub async fn handle(
     Ok(())
 }
 
-pub async fn process_commit(context: &ConnectionContext) -> Result<Response> {
+pub async fn process_commit(
+    request_context: &RequestContext<'_>,
+    context: &ConnectionContext,
+) -> Result<Response> {
     if let Some((session_id, _)) = context.transaction.as_ref() {
         let store = context.service_context.transaction_store();
-        store.commit(session_id).await?;
+        store.commit(session_id, request_context.tracker).await?;
     }
     Ok(Response::ok())
 }
@@ -0,0 +1,430 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/protocol/compression.rs
+ *
+ *-------------------------------------------------------------------------
+ */
+
+use std::time::{Duration, Instant};
+
+use bson::{RawArray, RawArrayBuf, RawBson};
+use flate2::{Compress, Compression, Decompress, FlushCompress, FlushDecompress, Status};
+
+use crate::{
+    error::{DocumentDBError, Result},
+    protocol::MAX_MESSAGE_SIZE_BYTES,
+};
+
+/// Size of the OP_COMPRESSED fields preceding the compressed payload:
+/// originalOpcode (i32), uncompressedSize (i32) and compressorId (u8).
+pub const COMPRESSED_MESSAGE_HEADER_LENGTH: usize =
+    2 * std::mem::size_of::<i32>() + std::mem::size_of::<u8>();
+
+/// Compressors advertised when the dynamic configuration does not override them.
+pub const DEFAULT_COMPRESSORS: [Compressor; 2] = [Compressor::Zstd, Compressor::Zlib];
+
+// Responses are compressed on the request path, so favor latency over ratio.
+const ZSTD_COMPRESSION_LEVEL: i32 = 1;
+
+/// Wire protocol compressor identifiers.
+#[derive(Copy, Clone, Debug, Eq, PartialEq)]
+pub enum Compressor {
+    Noop = 0,
+    Snappy = 1,
+    Zlib = 2,
+    Zstd = 3,
+}
+
+impl Compressor {
+    pub fn from_id(id: u8) -> Option<Compressor> {
+        match id {
+            0 => Some(Compressor::Noop),
+            1 => Some(Compressor::Snappy),
+            2 => Some(Compressor::Zlib),
+            3 => Some(Compressor::Zstd),
+            _ => None,
+        }
+    }
+
+    pub fn from_name(name: &str) -> Option<Compressor> {
+        match name {
+            "noop" => Some(Compressor::Noop),
+            "snappy" => Some(Compressor::Snappy),
+            "zlib" => Some(Compressor::Zlib),
+            "zstd" => Some(Compressor::Zstd),
+            _ => None,
+        }
+    }
+
+    pub fn id(self) -> u8 {
+        self as u8
+    }
+
+    pub fn name(self) -> &'static str {
+        match self {
+            Compressor::Noop => "noop",
+            Compressor::Snappy => "snappy",
+            Compressor::Zlib => "zlib",
+            Compressor::Zstd => "zstd",
+        }
+    }
+
+    /// Whether the gateway can decode and produce messages with this compressor.
+    pub fn is_supported(self) -> bool {
+        !matches!(self, Compressor::Snappy)
+    }
+}
+
+/// Parses a comma separated compressor list, ignoring unknown and unsupported names.
+pub fn parse_compressor_list(value: &str) -> Vec<Compressor> {
+    value
+        .split(',')
+        .filter_map(|name| Compressor::from_name(name.trim()))
+        .filter(|compressor| compressor.is_supported() && *compressor != Compressor::Noop)
+        .collect()
+}
+
+/// Accumulated compression statistics for one compressor on one connection.
+#[derive(Clone, Debug)]
+pub struct CompressorStats {
+    pub compressor: Compressor,
+    pub messages_compressed: u64,
+    pub messages_decompressed: u64,
+    pub uncompressed_bytes: u64,
+    pub compressed_bytes: u64,
+    pub compress_time: Duration,
+    pub decompress_time: Duration,
+}
+
+impl CompressorStats {
+    fn new(compressor: Compressor) -> Self {
+        CompressorStats {
+            compressor,
+            messages_compressed: 0,
+            messages_decompressed: 0,
+            uncompressed_bytes: 0,
+            compressed_bytes: 0,
+            compress_time: Duration::ZERO,
+            decompress_time: Duration::ZERO,
+        }
+    }
+
+    /// Ratio of uncompressed to compressed bytes over both directions.
+    pub fn ratio(&self) -> f64 {
+        if self.compressed_bytes == 0 {
+            return 1.0;
+        }
+
+        self.uncompressed_bytes as f64 / self.compressed_bytes as f64
+    }
+}
+
+/// Per connection compression state: the negotiated compressors, the compressor
+/// used by the request currently being served and the codec contexts and buffers
+/// that are reused across messages.
+#[derive(Default)]
+pub struct CompressionContext {
+    negotiated: Vec<Compressor>,
+    min_response_bytes: usize,
+    request_compressor: Option<Compressor>,
+
+    staging_buffer: Vec<u8>,
+    output_buffer: Vec<u8>,
+    zlib_compress: Option<Compress>,
+    zlib_decompress: Option<Decompress>,
+    zstd_compressor: Option<zstd::bulk::Compressor<'static>>,
+    zstd_decompressor: Option<zstd::bulk::Decompressor<'static>>,
+
+    stats: Vec<CompressorStats>,
+}
+
+impl CompressionContext {
+    /// Intersects the compressors requested in a hello with the enabled ones, keeping
+    /// the client's order of preference, and returns the names to advertise back.
+    pub fn negotiate(
+        &mut self,
+        requested: &RawArray,
+        enabled: &[Compressor],
+        min_response_bytes: usize,
+    ) -> Result<RawArrayBuf> {
+        self.negotiated.clear();
+        self.min_response_bytes = min_response_bytes;
+
+        let mut names = RawArrayBuf::new();
+        for value in requested {
+            let Some(compressor) = value?.as_str().and_then(Compressor::from_name) else {
+                continue;
+            };
+
+            if enabled.contains(&compressor) && !self.negotiated.contains(&compressor) {
+                self.negotiated.push(compressor);
+                names.push(RawBson::String(compressor.name().to_string()));
+            }
+        }
+
+        Ok(names)
+    }
+
+    /// Records the compressor of the request being served; None for uncompressed requests.
+    pub fn set_request_compressor(&mut self, compressor: Option<Compressor>) {
+        self.request_compressor = compressor;
+    }
+
+    /// The compressor to use for a response of the given size. Responses are only
+    /// compressed when the request was compressed, using the same compressor.
+    pub fn response_compressor(&self, response_size: usize) -> Option<Compressor> {
+        match self.request_compressor {
+            Some(Compressor::Noop) | None => None,
+            Some(compressor) if response_size >= self.min_response_bytes => Some(compressor),
+            Some(_) => None,
+        }
+    }
+
+    /// Returns a reusable buffer sized to receive the compressed payload of a request.
+    pub fn input_buffer(&mut self, size: usize) -> &mut [u8] {
+        self.staging_buffer.clear();
+        self.staging_buffer.resize(size, 0);
+        &mut self.staging_buffer
+    }
+
+    /// Decompresses the payload previously read into the input buffer. The result is
+    /// decoded directly into a request buffer sized from the envelope.
+    pub fn decompress(&mut self, compressor_id: u8, uncompressed_size: i32) -> Result<Vec<u8>> {
+        let compressor = Compressor::from_id(compressor_id)
+            .filter(|compressor| compressor.is_supported())
+            .ok_or_else(|| {
+                DocumentDBError::bad_value(format!("Unsupported compressor id: {compressor_id}"))
+            })?;
+
+        if compressor != Compressor::Noop && !self.negotiated.contains(&compressor) {
+            return Err(DocumentDBError::bad_value(format!(
+                "Compressor {} was not negotiated for this connection",
+                compressor.name()
+            )));
+        }
+
+        if !(0..=MAX_MESSAGE_SIZE_BYTES).contains(&uncompressed_size) {
+            return Err(DocumentDBError::bad_value(format!(
+                "Invalid uncompressed message size: {uncompressed_size}"
+            )));
+        }
+
+        let uncompressed_size = uncompressed_size as usize;
+        let start = Instant::now();
+        let mut message = Vec::with_capacity(uncompressed_size);
+
+        match compressor {
+            Compressor::Noop => message.extend_from_slice(&self.staging_buffer),
+            Compressor::Zlib => {
+                let decompress = self
+                    .zlib_decompress
+                    .get_or_insert_with(|| Decompress::new(true));
+                decompress.reset(true);
+
+                let status = decompress
+                    .decompress_vec(&self.staging_buffer, &mut message, FlushDecompress::Finish)
+                    .map_err(|e| {
+                        DocumentDBError::bad_value(format!("Failed to decompress message: {e}"))
+                    })?;
+                if status != Status::StreamEnd {
+                    return Err(DocumentDBError::bad_value(
+                        "Compressed message did not match its declared size".to_string(),
+                    ));
+                }
+            }
+            Compressor::Zstd => {
+                if self.zstd_decompressor.is_none() {
+                    self.zstd_decompressor = Some(zstd::bulk::Decompressor::new()?);
+                }
+                if let Some(decompressor) = self.zstd_decompressor.as_mut() {
+                    decompressor
+                        .decompress_to_buffer(&self.staging_buffer, &mut message)
+                        .map_err(|e| {
+                            DocumentDBError::bad_value(format!("Failed to decompress message: {e}"))
+                        })?;
+                }
+            }
+            Compressor::Snappy => unreachable!("snappy is rejected above"),
+        }
+
+        if message.len() != uncompressed_size {
+            return Err(DocumentDBError::bad_value(format!(
+                "Decompressed message size {} does not match the declared size {uncompressed_size}",
+                message.len()
+            )));
+        }
+
+        let compressed_bytes = self.staging_buffer.len() as u64;
+        let stats = self.stats_for(compressor);
+        stats.messages_decompressed += 1;
+        stats.uncompressed_bytes += uncompressed_size as u64;
+        stats.compressed_bytes += compressed_bytes;
+        stats.decompress_time += start.elapsed();
+
+        Ok(message)
+    }
+
+    /// Compresses the concatenation of `parts` and returns the compressed bytes,
+    /// which remain valid until the next call on this context.
+    pub fn compress(&mut self, compressor: Compressor, parts: &[&[u8]]) -> Result<&[u8]> {
+        let start = Instant::now();
+
+        self.staging_buffer.clear();
+        for part in parts {
+            self.staging_buffer.extend_from_slice(part);
+        }
+        let input = &self.staging_buffer;
+        let output = &mut self.output_buffer;
+        output.clear();
+
+        match compressor {
+            Compressor::Zlib => {
+                let compress = self
+                    .zlib_compress
+                    .get_or_insert_with(|| Compress::new(Compression::fast(), true));
+                compress.reset();
+
+                // Start from the zlib bound and grow until the stream is finished.
+                output.reserve(input.len() + (input.len() >> 12) + (input.len() >> 14) + 13);
+                loop {
+                    let consumed = compress.total_in() as usize;
+                    let status = compress
+                        .compress_vec(&input[consumed..], output, FlushCompress::Finish)
+                        .map_err(|e| {
+                            DocumentDBError::internal_error(format!(
+                                "Failed to compress response: {e}"
+                            ))
+                        })?;
+                    if status == Status::StreamEnd {
+                        break;
+                    }
+                    output.reserve(output.capacity().max(1024));
+                }
+            }
+            Compressor::Zstd => {
+                if self.zstd_compressor.is_none() {
+                    self.zstd_compressor =
+                        Some(zstd::bulk::Compressor::new(ZSTD_COMPRESSION_LEVEL)?);
+                }
+                output.reserve(zstd::zstd_safe::compress_bound(input.len()));
+                if let Some(zstd_compressor) = self.zstd_compressor.as_mut() {
+                    zstd_compressor.compress_to_buffer(input, output)?;
+                }
+            }
+            Compressor::Noop | Compressor::Snappy => {
+                return Err(DocumentDBError::internal_error(format!(
+                    "Cannot compress responses with {}",
+                    compressor.name()
+                )));
+            }
+        }
+
+        let uncompressed_bytes = self.staging_buffer.len() as u64;
+        let compressed_bytes = self.output_buffer.len() as u64;
+        let stats = self.stats_for(compressor);
+        stats.messages_compressed += 1;
+        stats.uncompressed_bytes += uncompressed_bytes;
+        stats.compressed_bytes += compressed_bytes;
+        stats.compress_time += start.elapsed();
+
+        Ok(&self.output_buffer)
+    }
+
+    /// Statistics for every compressor that handled traffic on this connection.
+    pub fn stats(&self) -> &[CompressorStats] {
+        &self.stats
+    }
+
+    fn stats_for(&mut self, compressor: Compressor) -> &mut CompressorStats {
+        let index = match self.stats.iter().position(|s| s.compressor == compressor) {
+            Some(index) => index,
+            None => {
+                self.stats.push(CompressorStats::new(compressor));
+                self.stats.len() - 1
+            }
+        };
+        &mut self.stats[index]
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use bson::rawdoc;
+
+    fn negotiated_context(compressor: Compressor) -> CompressionContext {
+        let mut context = CompressionContext::default();
+        let hello = rawdoc! { "compression": [compressor.name()] };
+        context
+            .negotiate(
+                hello.get_array("compression").unwrap(),
+                &DEFAULT_COMPRESSORS,
+                0,
+            )
+            .unwrap();
+        context
+    }
+
+    fn round_trip(compressor: Compressor) {
+        let mut context = negotiated_context(compressor);
+        let payload = b"{\"find\": \"collection\"}".repeat(64);
+
+        let compressed = context
+            .compress(compressor, &[&[0, 0, 0, 0, 0], &payload])
+            .unwrap()
+            .to_vec();
+        assert!(compressed.len() < payload.len());
+
+        context
+            .input_buffer(compressed.len())
+            .copy_from_slice(&compressed);
+        let decompressed = context
+            .decompress(compressor.id(), (payload.len() + 5) as i32)
+            .unwrap();
+        assert_eq!(&decompressed[5..], payload.as_slice());
+
+        let stats = &context.stats()[0];
+        assert_eq!(stats.messages_compressed, 1);
+        assert_eq!(stats.messages_decompressed, 1);
+        assert!(stats.ratio() > 1.0);
+    }
+
+    #[test]
+    fn test_zlib_round_trip() {
+        round_trip(Compressor::Zlib);
+    }
+
+    #[test]
+    fn test_zstd_round_trip() {
+        round_trip(Compressor::Zstd);
+    }
+
+    #[test]
+    fn test_negotiate_keeps_client_order() {
+        let mut context = CompressionContext::default();
+        let hello = rawdoc! { "compression": ["snappy", "zlib", "zstd"] };
+        let names = context
+            .negotiate(
+                hello.get_array("compression").unwrap(),
+                &DEFAULT_COMPRESSORS,
+                0,
+            )
+            .unwrap();
+
+        let advertised: Vec<&str> = names
+            .into_iter()
+            .map(|v| v.unwrap().as_str().unwrap())
+            .collect();
+        assert_eq!(advertised, vec!["zlib", "zstd"]);
+    }
+
+    #[test]
+    fn test_rejects_oversized_declared_length() {
+        let mut context = negotiated_context(Compressor::Zlib);
+        context.input_buffer(1);
+        assert!(context
+            .decompress(Compressor::Zlib.id(), MAX_MESSAGE_SIZE_BYTES + 1)
+            .is_err());
+    }
+}
@@ -16,7 +16,11 @@ use tokio::io::{AsyncRead, AsyncReadExt};
 
 use crate::{
     error::{DocumentDBError, Result},
-    protocol::{extract_database_and_collection_names, opcode::OpCode},
+    protocol::{
+        compression::{CompressionContext, Compressor, COMPRESSED_MESSAGE_HEADER_LENGTH},
+        extract_database_and_collection_names,
+        opcode::OpCode,
+    },
     requests::{Request, RequestMessage, RequestType},
 };
 
@@ -46,8 +50,13 @@ where
     }
 }
 
-/// Given an already read header, read the remaining message bytes into a RequestMessage
-pub async fn read_request<S>(header: &Header, stream: &mut S) -> Result<RequestMessage>
+/// Given an already read header, read the remaining message bytes into a RequestMessage.
+/// OP_COMPRESSED messages are decompressed and returned with the op code they wrap.
+pub async fn read_request<S>(
+    header: &Header,
+    stream: &mut S,
+    compression: &mut CompressionContext,
+) -> Result<RequestMessage>
 where
     S: AsyncRead + Unpin,
 {
@@ -55,6 +64,11 @@ where
         DocumentDBError::bad_value("Message length could not be converted to a usize".to_string())
     })?;
 
+    if header.op_code == OpCode::Compressed {
+        return read_compressed_request(header, message_size, stream, compression).await;
+    }
+    compression.set_request_compressor(None);
+
     // 16 bytes of the message were already used by the headers
     let mut message: Vec<u8> = vec![0; message_size - Header::LENGTH];
 
@@ -68,6 +82,45 @@ where
     })
 }
 
+/// Read the body of an OP_COMPRESSED message and decompress the message it wraps
+async fn read_compressed_request<S>(
+    header: &Header,
+    message_size: usize,
+    stream: &mut S,
+    compression: &mut CompressionContext,
+) -> Result<RequestMessage>
+where
+    S: AsyncRead + Unpin,
+{
+    let compressed_size = message_size
+        .checked_sub(Header::LENGTH + COMPRESSED_MESSAGE_HEADER_LENGTH)
+        .ok_or_else(|| DocumentDBError::bad_value("Compressed message is too short".to_string()))?;
+
+    let original_op_code = OpCode::from_value(stream.read_i32_le().await?);
+    let uncompressed_size = stream.read_i32_le().await?;
+    let compressor_id = stream.read_u8().await?;
+
+    stream
+        .read_exact(compression.input_buffer(compressed_size))
+        .await?;
+
+    if matches!(original_op_code, OpCode::Compressed | OpCode::INVALID) {
+        return Err(DocumentDBError::bad_value(format!(
+            "Invalid op code in compressed message: {original_op_code:?}"
+        )));
+    }
+
+    let message = compression.decompress(compressor_id, uncompressed_size)?;
+    compression.set_request_compressor(Compressor::from_id(compressor_id));
+
+    Ok(RequestMessage {
+        request: message,
+        op_code: original_op_code,
+        request_id: header.request_id,
+        response_to: header.response_to,
+    })
+}
+
 /// Parse a request message into a typed Request
 pub async fn parse_request<'a>(
     message: &'a RequestMessage,
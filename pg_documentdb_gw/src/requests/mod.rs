@@ -84,7 +84,7 @@ impl RequestInfo<'_> {
     }
 }
 
-#[derive(PartialEq, Debug)]
+#[derive(Clone, Copy, Debug, Eq, Hash, PartialEq)]
 pub enum RequestType {
     AbortTransaction,
     Aggregate,
@@ -137,12 +137,14 @@ pub enum RequestType {
     Logout,
     Ping,
     PrepareTransaction,
+    Profile,
     ReIndex,
     RenameCollection,
     ReshardCollection,
     RolesInfo,
     SaslContinue,
     SaslStart,
+    ServerStatus,
     ShardCollection,
     UnshardCollection,
     Update,
@@ -229,6 +231,7 @@ impl FromStr for RequestType {
             "logout" => Ok(RequestType::Logout),
             "ping" => Ok(RequestType::Ping),
             "prepareTransaction" => Ok(RequestType::PrepareTransaction),
+            "profile" => Ok(RequestType::Profile),
             "reindex" => Ok(RequestType::ReIndex),
             "reIndex" => Ok(RequestType::ReIndex),
             "renameCollection" => Ok(RequestType::RenameCollection),
@@ -236,6 +239,7 @@ impl FromStr for RequestType {
             "rolesInfo" => Ok(RequestType::RolesInfo),
             "saslContinue" => Ok(RequestType::SaslContinue),
             "saslStart" => Ok(RequestType::SaslStart),
+            "serverStatus" => Ok(RequestType::ServerStatus),
             "shardCollection" => Ok(RequestType::ShardCollection),
             "unshardCollection" => Ok(RequestType::UnshardCollection),
             "update" => Ok(RequestType::Update),
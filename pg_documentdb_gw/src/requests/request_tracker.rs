@@ -21,20 +21,23 @@ pub enum RequestIntervalKind {
     /// Time spent formatting and parsing the incoming request.
     FormatRequest,
 
-    /// Time spent handling the request, which includes ProcessRequest and, if applicable,
-    /// PostgresBeginTransaction, PostgresSetStatementTimeout, and PostgresCommitTransaction.
+    /// Time spent handling the request, which includes ProcessRequest.
     HandleRequest,
 
-    /// Time spent in network transport and Postgres processing.
+    /// Time spent waiting for a Postgres connection to be checked out of the pool.
+    PoolWait,
+
+    /// Time spent in network transport and Postgres processing. Statement timeouts and the
+    /// transaction control around a query are pipelined with it and are included here.
     ProcessRequest,
 
-    /// Time spent beginning a Postgres transaction.
+    /// Time spent beginning a Postgres transaction outside of a pipelined query.
     PostgresBeginTransaction,
 
-    /// Time spent setting statement timeout parameters in Postgres.
+    /// Time spent setting statement timeout parameters in Postgres outside of a pipelined query.
     PostgresSetStatementTimeout,
 
-    /// Time spent committing a Postgres transaction.
+    /// Time spent committing a Postgres transaction outside of a pipelined query.
     PostgresCommitTransaction,
 
     /// Time spent writing the response to the stream.
@@ -68,6 +71,10 @@ impl RequestTracker {
             .fetch_add(elapsed.as_nanos() as i64, Ordering::Relaxed);
     }
 
+    pub fn record_nanos(&self, interval: RequestIntervalKind, nanos: i64) {
+        self.request_interval_metrics_array[interval as usize].fetch_add(nanos, Ordering::Relaxed);
+    }
+
     pub fn get_interval_elapsed_time(&self, interval: RequestIntervalKind) -> i64 {
         self.request_interval_metrics_array[interval as usize].load(Ordering::Relaxed)
     }
@@ -9,18 +9,42 @@
 use crate::{
     context::ConnectionContext,
     error::{DocumentDBError, Result},
-    protocol::{header::Header, opcode::OpCode},
+    protocol::{
+        compression::{CompressionContext, Compressor, COMPRESSED_MESSAGE_HEADER_LENGTH},
+        header::Header,
+        opcode::OpCode,
+    },
     CommandError, Response,
 };
 use bson::RawDocument;
+use std::io::IoSlice;
 use tokio::io::{AsyncWrite, AsyncWriteExt};
 
-/// Write a server response to the client stream
-pub async fn write<S>(header: &Header, response: &Response, stream: &mut S) -> Result<()>
+/// OP_REPLY fields between the header and the documents: responseFlags (i32),
+/// cursorID (i64), startingFrom (i32) and numberReturned (i32).
+const REPLY_HEADER_LENGTH: usize = 20;
+
+/// Write a server response to the client stream, compressing it when the request was
+/// compressed and the response is large enough to benefit
+pub async fn write<S>(
+    header: &Header,
+    response: &Response,
+    stream: &mut S,
+    compression: &mut CompressionContext,
+) -> Result<()>
 where
     S: AsyncWrite + Unpin,
 {
-    write_and_flush(header, response.as_raw_document()?, stream).await
+    let response = response.as_raw_document()?;
+    if header.op_code == OpCode::Msg {
+        if let Some(compressor) = compression.response_compressor(response.as_bytes().len()) {
+            write_compressed_message(header, response, compressor, compression, stream).await?;
+            stream.flush().await?;
+            return Ok(());
+        }
+    }
+
+    write_and_flush(header, response, stream).await
 }
 
 /// Write a raw BSON object to the client stream
@@ -41,27 +65,27 @@ where
 
         // Query is responded to with Reply
         OpCode::Query => {
-            // Write the header
+            let mut envelope = [0u8; Header::LENGTH + REPLY_HEADER_LENGTH];
             let header = Header {
                 // Total size of the response is the bytes + standard header + reply header
-                length: (response.as_bytes().len() + Header::LENGTH + 20) as i32,
+                length: (response.as_bytes().len() + envelope.len()) as i32,
                 request_id: header.request_id,
                 response_to: header.request_id,
                 op_code: OpCode::Reply,
             };
-            header.write_to(stream).await?;
+            envelope[..Header::LENGTH].copy_from_slice(&header.to_bytes());
 
-            stream.write_i32_le(0).await?; // Response flags
-            stream.write_i64_le(0).await?; // Cursor Id
-            stream.write_i32_le(0).await?; // startingFrom
-            stream.write_i32_le(1).await?; // numberReturned
+            // Response flags, cursor id and startingFrom stay zero
+            envelope[Header::LENGTH + 16..].copy_from_slice(&1i32.to_le_bytes()); // numberReturned
 
-            stream.write_all(response.as_bytes()).await?;
-            Ok(())
+            write_envelope_and_document(stream, &envelope, response).await
         }
 
         // Insert has no response
         OpCode::Insert => Ok(()),
+
+        // The compressed envelope itself could not be read, so the wrapped op code is unknown
+        OpCode::Compressed => write_message(header, response, stream).await,
         _ => Err(DocumentDBError::internal_error(format!(
             "Unexpected response opcode: {:?}",
             header.op_code
@@ -78,26 +102,73 @@ pub async fn write_message<S>(header: &Header, response: &RawDocument, writer: &
 where
     S: AsyncWrite + Unpin,
 {
-    let total_length = Header::LENGTH
-        + std::mem::size_of::<u32>()
-        + std::mem::size_of::<u8>()
-        + response.as_bytes().len(); // Message payload + status code
-
+    // Header, flags and the payload type of the single document section
+    let mut envelope =
+        [0u8; Header::LENGTH + std::mem::size_of::<u32>() + std::mem::size_of::<u8>()];
     let header = Header {
-        length: total_length as i32,
+        length: (envelope.len() + response.as_bytes().len()) as i32,
         request_id: header.request_id,
         response_to: header.request_id,
         op_code: OpCode::Msg,
     };
-    header.write_to(writer).await?;
+    envelope[..Header::LENGTH].copy_from_slice(&header.to_bytes());
 
-    // Write Flags
-    writer.write_u32_le(0).await?;
+    write_envelope_and_document(writer, &envelope, response).await
+}
 
-    // Write payload type + section
-    writer.write_u8(0).await?;
+/// Writes a message envelope followed by the document, which is borrowed straight from the
+/// backend row. Both go out in vectored writes, so on streams that support them a large
+/// document is sent together with its envelope instead of after a separate small write.
+async fn write_envelope_and_document<S>(
+    writer: &mut S,
+    envelope: &[u8],
+    response: &RawDocument,
+) -> Result<()>
+where
+    S: AsyncWrite + Unpin,
+{
+    let mut slices = [IoSlice::new(envelope), IoSlice::new(response.as_bytes())];
+    let mut remaining = &mut slices[..];
+    while !remaining.is_empty() {
+        let written = writer.write_vectored(remaining).await?;
+        if written == 0 {
+            return Err(std::io::Error::from(std::io::ErrorKind::WriteZero).into());
+        }
+        IoSlice::advance_slices(&mut remaining, written);
+    }
 
-    writer.write_all(response.as_bytes()).await?;
+    Ok(())
+}
+
+/// Serializes the Message, compresses it and writes it to `writer` as an OP_COMPRESSED.
+async fn write_compressed_message<S>(
+    header: &Header,
+    response: &RawDocument,
+    compressor: Compressor,
+    compression: &mut CompressionContext,
+    writer: &mut S,
+) -> Result<()>
+where
+    S: AsyncWrite + Unpin,
+{
+    // Flags followed by the payload type of the single document section
+    let message_prefix = [0u8; std::mem::size_of::<u32>() + std::mem::size_of::<u8>()];
+    let uncompressed_length = message_prefix.len() + response.as_bytes().len();
+
+    let compressed = compression.compress(compressor, &[&message_prefix, response.as_bytes()])?;
+
+    let header = Header {
+        length: (Header::LENGTH + COMPRESSED_MESSAGE_HEADER_LENGTH + compressed.len()) as i32,
+        request_id: header.request_id,
+        response_to: header.request_id,
+        op_code: OpCode::Compressed,
+    };
+    header.write_to(writer).await?;
+
+    writer.write_i32_le(OpCode::Msg as i32).await?;
+    writer.write_i32_le(uncompressed_length as i32).await?;
+    writer.write_u8(compressor.id()).await?;
+    writer.write_all(compressed).await?;
 
     Ok(())
 }
@@ -126,3 +197,146 @@ where
 
     Ok(())
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use bson::rawdoc;
+    use std::{
+        pin::Pin,
+        task::{Context, Poll},
+    };
+
+    // Accepts at most max_write bytes per write and counts the writes.
+    struct ChunkedWriter {
+        written: Vec<u8>,
+        max_write: usize,
+        writes: usize,
+    }
+
+    impl ChunkedWriter {
+        fn new(max_write: usize) -> Self {
+            ChunkedWriter {
+                written: Vec::new(),
+                max_write,
+                writes: 0,
+            }
+        }
+    }
+
+    impl AsyncWrite for ChunkedWriter {
+        fn poll_write(
+            self: Pin<&mut Self>,
+            cx: &mut Context<'_>,
+            buf: &[u8],
+        ) -> Poll<std::io::Result<usize>> {
+            self.poll_write_vectored(cx, &[IoSlice::new(buf)])
+        }
+
+        fn poll_write_vectored(
+            self: Pin<&mut Self>,
+            _: &mut Context<'_>,
+            bufs: &[IoSlice<'_>],
+        ) -> Poll<std::io::Result<usize>> {
+            let this = self.get_mut();
+            let mut budget = this.max_write;
+            for buf in bufs {
+                let length = buf.len().min(budget);
+                this.written.extend_from_slice(&buf[..length]);
+                budget -= length;
+            }
+            this.writes += 1;
+            Poll::Ready(Ok(this.max_write - budget))
+        }
+
+        fn is_write_vectored(&self) -> bool {
+            true
+        }
+
+        fn poll_flush(self: Pin<&mut Self>, _: &mut Context<'_>) -> Poll<std::io::Result<()>> {
+            Poll::Ready(Ok(()))
+        }
+
+        fn poll_shutdown(self: Pin<&mut Self>, _: &mut Context<'_>) -> Poll<std::io::Result<()>> {
+            Poll::Ready(Ok(()))
+        }
+    }
+
+    fn request_header(op_code: OpCode) -> Header {
+        Header {
+            length: 0,
+            request_id: 7,
+            response_to: 0,
+            op_code,
+        }
+    }
+
+    fn expected_header(length: usize, op_code: OpCode) -> Vec<u8> {
+        let mut bytes = Vec::new();
+        bytes.extend_from_slice(&(length as i32).to_le_bytes());
+        bytes.extend_from_slice(&7i32.to_le_bytes());
+        bytes.extend_from_slice(&7i32.to_le_bytes());
+        bytes.extend_from_slice(&(op_code as i32).to_le_bytes());
+        bytes
+    }
+
+    fn expected_message(response: &RawDocument) -> Vec<u8> {
+        let mut bytes =
+            expected_header(Header::LENGTH + 5 + response.as_bytes().len(), OpCode::Msg);
+        bytes.extend_from_slice(&0u32.to_le_bytes());
+        bytes.push(0);
+        bytes.extend_from_slice(response.as_bytes());
+        bytes
+    }
+
+    fn expected_reply(response: &RawDocument) -> Vec<u8> {
+        let mut bytes = expected_header(
+            Header::LENGTH + REPLY_HEADER_LENGTH + response.as_bytes().len(),
+            OpCode::Reply,
+        );
+        bytes.extend_from_slice(&0i32.to_le_bytes());
+        bytes.extend_from_slice(&0i64.to_le_bytes());
+        bytes.extend_from_slice(&0i32.to_le_bytes());
+        bytes.extend_from_slice(&1i32.to_le_bytes());
+        bytes.extend_from_slice(response.as_bytes());
+        bytes
+    }
+
+    #[tokio::test]
+    async fn test_large_message_single_write() {
+        let response = rawdoc! { "payload": "x".repeat(1 << 20) };
+        let mut writer = ChunkedWriter::new(usize::MAX);
+        write_and_flush(&request_header(OpCode::Msg), &response, &mut writer)
+            .await
+            .unwrap();
+
+        assert_eq!(writer.writes, 1);
+        assert_eq!(writer.written, expected_message(&response));
+    }
+
+    #[tokio::test]
+    async fn test_message_partial_writes() {
+        let response = rawdoc! { "payload": "x".repeat(1 << 20) };
+
+        // Partial writes end inside the envelope, on its boundary and inside the document
+        for max_write in [3, Header::LENGTH + 5, 4096] {
+            let mut writer = ChunkedWriter::new(max_write);
+            write_and_flush(&request_header(OpCode::Msg), &response, &mut writer)
+                .await
+                .unwrap();
+            assert_eq!(writer.written, expected_message(&response));
+        }
+    }
+
+    #[tokio::test]
+    async fn test_reply_partial_writes() {
+        let response = rawdoc! { "payload": "x".repeat(1 << 20) };
+        for max_write in [usize::MAX, 7, Header::LENGTH + REPLY_HEADER_LENGTH, 4096] {
+            let mut writer = ChunkedWriter::new(max_write);
+            write_and_flush(&request_header(OpCode::Query), &response, &mut writer)
+                .await
+                .unwrap();
+            assert_eq!(writer.written, expected_reply(&response));
+        }
+    }
+}
@@ -0,0 +1,297 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * src/telemetry/metrics.rs
+ *
+ *-------------------------------------------------------------------------
+ */
+
+use std::sync::{
+    atomic::{AtomicU64, Ordering},
+    Arc,
+};
+
+use dashmap::DashMap;
+
+use crate::requests::{request_tracker::RequestTracker, RequestIntervalKind, RequestType};
+
+// Values below 2^SUB_BUCKET_BITS are counted exactly, larger ones in buckets of
+// 1/SUB_BUCKET_COUNT of their power of two, bounding the relative error to ~6%.
+const SUB_BUCKET_BITS: u32 = 4;
+const SUB_BUCKET_COUNT: usize = 1 << SUB_BUCKET_BITS;
+
+// Values of 2^37ns (~137s) and above are counted in the last bucket.
+const MAX_VALUE_BITS: u32 = 37;
+const MAX_SHIFT: usize = (MAX_VALUE_BITS - SUB_BUCKET_BITS) as usize - 1;
+const BUCKET_COUNT: usize = (MAX_SHIFT + 2) * SUB_BUCKET_COUNT;
+
+/// The intervals of a request that are tracked per command, in the order they are reported.
+pub const TRACKED_INTERVALS: [RequestIntervalKind; 8] = [
+    RequestIntervalKind::HandleMessage,
+    RequestIntervalKind::FormatRequest,
+    RequestIntervalKind::PoolWait,
+    RequestIntervalKind::PostgresBeginTransaction,
+    RequestIntervalKind::PostgresSetStatementTimeout,
+    RequestIntervalKind::ProcessRequest,
+    RequestIntervalKind::PostgresCommitTransaction,
+    RequestIntervalKind::WriteResponse,
+];
+
+/// A fixed size log-linear latency histogram in the spirit of HDR histograms. Recording
+/// is a handful of relaxed atomic adds, so any number of threads record concurrently
+/// without locks.
+#[derive(Debug)]
+pub struct LatencyHistogram {
+    buckets: [AtomicU64; BUCKET_COUNT],
+    count: AtomicU64,
+    sum: AtomicU64,
+    max: AtomicU64,
+}
+
+impl Default for LatencyHistogram {
+    fn default() -> Self {
+        LatencyHistogram {
+            buckets: std::array::from_fn(|_| AtomicU64::new(0)),
+            count: AtomicU64::new(0),
+            sum: AtomicU64::new(0),
+            max: AtomicU64::new(0),
+        }
+    }
+}
+
+fn bucket_index(value: u64) -> usize {
+    if value < SUB_BUCKET_COUNT as u64 {
+        return value as usize;
+    }
+
+    let shift = (u64::BITS - SUB_BUCKET_BITS - 1 - value.leading_zeros()) as usize;
+    if shift > MAX_SHIFT {
+        return BUCKET_COUNT - 1;
+    }
+
+    shift * SUB_BUCKET_COUNT + (value >> shift) as usize
+}
+
+// The midpoint of the values counted in a bucket.
+fn bucket_value(index: usize) -> u64 {
+    if index < 2 * SUB_BUCKET_COUNT {
+        return index as u64;
+    }
+
+    let shift = index / SUB_BUCKET_COUNT - 1;
+    let lowest = ((index - shift * SUB_BUCKET_COUNT) as u64) << shift;
+    lowest + (1 << shift) / 2
+}
+
+impl LatencyHistogram {
+    pub fn record(&self, nanos: u64) {
+        self.buckets[bucket_index(nanos)].fetch_add(1, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.sum.fetch_add(nanos, Ordering::Relaxed);
+        self.max.fetch_max(nanos, Ordering::Relaxed);
+    }
+
+    /// A point in time copy of the histogram. Concurrent recordings may be partially
+    /// included, which only skews the result by the few requests in flight.
+    pub fn snapshot(&self) -> LatencySnapshot {
+        LatencySnapshot {
+            buckets: self
+                .buckets
+                .iter()
+                .map(|bucket| bucket.load(Ordering::Relaxed))
+                .collect(),
+            count: self.count.load(Ordering::Relaxed),
+            sum: self.sum.load(Ordering::Relaxed),
+            max: self.max.load(Ordering::Relaxed),
+        }
+    }
+}
+
+#[derive(Clone, Debug)]
+pub struct LatencySnapshot {
+    buckets: Vec<u64>,
+    count: u64,
+    sum: u64,
+    max: u64,
+}
+
+impl LatencySnapshot {
+    pub fn count(&self) -> u64 {
+        self.count
+    }
+
+    pub fn max_nanos(&self) -> u64 {
+        self.max
+    }
+
+    /// The lowest recorded value, to the precision of its bucket.
+    pub fn min_nanos(&self) -> u64 {
+        self.buckets
+            .iter()
+            .position(|count| *count > 0)
+            .map_or(0, |index| bucket_value(index).min(self.max))
+    }
+
+    pub fn mean_nanos(&self) -> u64 {
+        self.sum.checked_div(self.count).unwrap_or(0)
+    }
+
+    /// The value below which the given fraction of the recorded values fall.
+    pub fn percentile_nanos(&self, percentile: f64) -> u64 {
+        let total: u64 = self.buckets.iter().sum();
+        if total == 0 {
+            return 0;
+        }
+
+        let rank = ((percentile.clamp(0.0, 1.0) * total as f64).ceil() as u64).max(1);
+        let mut seen = 0;
+        for (index, count) in self.buckets.iter().enumerate() {
+            seen += count;
+            if seen >= rank {
+                return bucket_value(index).min(self.max);
+            }
+        }
+
+        self.max
+    }
+
+    /// Adds the values recorded by another histogram, such as the one of another client.
+    pub fn merge(&mut self, other: &LatencySnapshot) {
+        for (bucket, other_bucket) in self.buckets.iter_mut().zip(&other.buckets) {
+            *bucket += other_bucket;
+        }
+
+        self.count += other.count;
+        self.sum += other.sum;
+        self.max = self.max.max(other.max);
+    }
+}
+
+#[derive(Debug, Default)]
+struct CommandLatencies {
+    intervals: [LatencyHistogram; TRACKED_INTERVALS.len()],
+}
+
+/// Latency histograms per command and request interval, so that tail latency can be
+/// attributed to the pool, Postgres or the network.
+#[derive(Debug, Default)]
+pub struct RequestMetrics {
+    commands: DashMap<RequestType, Arc<CommandLatencies>>,
+}
+
+impl RequestMetrics {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Adds the intervals a request went through. Intervals the request did not go
+    /// through, such as BEGIN outside of a transaction, are not recorded.
+    pub fn record(&self, request_type: RequestType, tracker: &RequestTracker) {
+        let latencies = match self.commands.get(&request_type) {
+            Some(latencies) => Arc::clone(&latencies),
+            None => Arc::clone(&self.commands.entry(request_type).or_default()),
+        };
+
+        for (histogram, interval) in latencies.intervals.iter().zip(TRACKED_INTERVALS) {
+            let nanos = tracker.get_interval_elapsed_time(interval);
+            if nanos > 0 {
+                histogram.record(nanos as u64);
+            }
+        }
+    }
+
+    /// Snapshots of every command seen so far, with one histogram per TRACKED_INTERVALS entry.
+    pub fn snapshot(&self) -> Vec<(RequestType, Vec<LatencySnapshot>)> {
+        let mut snapshots: Vec<_> = self
+            .commands
+            .iter()
+            .map(|entry| {
+                let histograms = entry.intervals.iter().map(LatencyHistogram::snapshot);
+                (*entry.key(), histograms.collect())
+            })
+            .collect();
+        snapshots.sort_by_cached_key(|(request_type, _)| request_type.to_string());
+        snapshots
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_bucket_bounds() {
+        let mut previous = 0;
+        for value in (0..1 << 20).chain([u64::MAX / 2, u64::MAX]) {
+            let index = bucket_index(value);
+            assert!(index < BUCKET_COUNT);
+            assert!(index >= previous, "buckets must be monotonic at {value}");
+            previous = index;
+
+            if value < 1 << MAX_VALUE_BITS {
+                let midpoint = bucket_value(index);
+                assert!(midpoint.abs_diff(value) * SUB_BUCKET_COUNT as u64 <= value.max(1));
+            }
+        }
+    }
+
+    #[test]
+    fn test_percentiles() {
+        let histogram = LatencyHistogram::default();
+        for micros in 1..=1000u64 {
+            histogram.record(micros * 1000);
+        }
+
+        let snapshot = histogram.snapshot();
+        assert_eq!(snapshot.count(), 1000);
+        assert_eq!(snapshot.max_nanos(), 1_000_000);
+        assert_eq!(snapshot.mean_nanos(), 500_500);
+        for (percentile, expected) in [(0.5, 500_000u64), (0.99, 990_000), (1.0, 1_000_000)] {
+            let value = snapshot.percentile_nanos(percentile);
+            assert!(
+                value.abs_diff(expected) <= expected / 16,
+                "{percentile}: {value}"
+            );
+        }
+    }
+
+    #[test]
+    fn test_merge() {
+        let first = LatencyHistogram::default();
+        let second = LatencyHistogram::default();
+        for micros in 1..=500u64 {
+            first.record(micros * 1000);
+            second.record((micros + 500) * 1000);
+        }
+
+        let mut snapshot = second.snapshot();
+        snapshot.merge(&first.snapshot());
+        assert_eq!(snapshot.count(), 1000);
+        assert_eq!(snapshot.max_nanos(), 1_000_000);
+        assert_eq!(snapshot.mean_nanos(), 500_500);
+        assert!(snapshot.min_nanos().abs_diff(1000) <= 1000 / 16);
+        let median = snapshot.percentile_nanos(0.5);
+        assert!(median.abs_diff(500_000) <= 500_000 / 16, "{median}");
+    }
+
+    #[test]
+    fn test_record_skips_untouched_intervals() {
+        let metrics = RequestMetrics::new();
+        let tracker = RequestTracker::new();
+        tracker.record_nanos(RequestIntervalKind::ProcessRequest, 2000);
+        metrics.record(RequestType::Find, &tracker);
+        metrics.record(RequestType::Find, &tracker);
+
+        let snapshot = metrics.snapshot();
+        assert_eq!(snapshot.len(), 1);
+        let (request_type, histograms) = &snapshot[0];
+        assert_eq!(*request_type, RequestType::Find);
+        for (interval, histogram) in TRACKED_INTERVALS.iter().zip(histograms) {
+            let expected = match interval {
+                RequestIntervalKind::ProcessRequest => 2,
+                _ => 0,
+            };
+            assert_eq!(histogram.count(), expected, "{interval:?}");
+        }
+    }
+}
@@ -8,11 +8,12 @@
 
 pub mod client_info;
 pub mod event_id;
+pub mod metrics;
 
 use crate::{
     context::ConnectionContext,
     error::ErrorCode,
-    protocol::header::Header,
+    protocol::{compression::CompressorStats, header::Header},
     requests::{request_tracker::RequestTracker, Request},
     responses::{CommandError, Response},
 };
@@ -37,6 +38,10 @@ pub trait TelemetryProvider: Send + Sync + DynClone {
         _: &str,
         _: &str,
     );
+
+    // Emits the per-compressor wire compression ratio and CPU time of a connection
+    // when it closes
+    async fn emit_compression_metrics(&self, _: &ConnectionContext, _: &[CompressorStats]) {}
 }
 
 clone_trait_object!(TelemetryProvider);
@@ -141,9 +141,13 @@ pub fn setup_configuration_with_unix_socket_custom(
 }
 
 pub fn get_client() -> Client {
+    get_client_with_credentials("test", "test")
+}
+
+pub fn get_client_with_credentials(user: &str, pass: &str) -> Client {
     let credential = Credential::builder()
-        .username("test".to_string())
-        .password("test".to_string())
+        .username(user.to_string())
+        .password(pass.to_string())
         .mechanism(AuthMechanism::ScramSha256)
         .build();
 
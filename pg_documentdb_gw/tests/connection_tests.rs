@@ -0,0 +1,177 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * tests/connection_tests.rs
+ *
+ *-------------------------------------------------------------------------
+ */
+
+pub mod common;
+
+use std::{sync::Arc, thread};
+
+use documentdb_gateway::{
+    configuration::SetupConfiguration,
+    postgres::{create_query_catalog, Connection, ConnectionPool, Timeout},
+    requests::request_tracker::RequestTracker,
+};
+use tokio::{runtime::Handle, time::Duration};
+
+fn test_pool(worker_threads: usize, max_size: usize) -> ConnectionPool {
+    let mut setup_config = common::setup_configuration();
+    setup_config.async_runtime_worker_threads = Some(worker_threads);
+    ConnectionPool::new_with_user(
+        &setup_config,
+        &create_query_catalog(),
+        &setup_config.postgres_system_user(),
+        None,
+        format!("{}-ConnectionTests", setup_config.application_name()),
+        max_size,
+    )
+    .expect("Failed to create pool")
+}
+
+// A pool with a single connection, so every checkout reuses the same Postgres session.
+fn single_connection_pool() -> ConnectionPool {
+    test_pool(1, 1)
+}
+
+// Runs the future on a new thread, which gets the next shard of the pools as its home.
+fn run_on_new_thread<F>(future: F) -> F::Output
+where
+    F: std::future::Future + Send + 'static,
+    F::Output: Send + 'static,
+{
+    let handle = Handle::current();
+    thread::spawn(move || handle.block_on(future))
+        .join()
+        .unwrap()
+}
+
+async fn statement_timeout(pool: &ConnectionPool) -> String {
+    let connection = Connection::new(pool.acquire_connection().await.unwrap(), false);
+    let rows = connection
+        .query(
+            "SELECT current_setting('statement_timeout')",
+            &[],
+            &[],
+            None,
+            &RequestTracker::new(),
+        )
+        .await
+        .unwrap();
+    rows[0].get(0)
+}
+
+// Runs a query that exceeds its timeout, then checks that the session it ran on is back
+// outside of any transaction and with its own statement timeout.
+async fn validate_timed_out_query(timeout: Option<Timeout>) {
+    let pool = single_connection_pool();
+    let default_timeout = statement_timeout(&pool).await;
+
+    let connection = Connection::new(pool.acquire_connection().await.unwrap(), false);
+    let result = connection
+        .query(
+            "SELECT pg_sleep(5)",
+            &[],
+            &[],
+            timeout,
+            &RequestTracker::new(),
+        )
+        .await;
+    assert!(result.is_err(), "Expected the query to time out");
+    drop(connection);
+
+    // A session left in the aborted transaction would fail any query, and one that kept the
+    // short timeout would cancel this sleep.
+    let connection = Connection::new(pool.acquire_connection().await.unwrap(), false);
+    connection
+        .query(
+            "SELECT pg_sleep(0.5)",
+            &[],
+            &[],
+            None,
+            &RequestTracker::new(),
+        )
+        .await
+        .unwrap();
+    drop(connection);
+
+    assert_eq!(statement_timeout(&pool).await, default_timeout);
+}
+
+#[tokio::test]
+async fn validate_transaction_timeout_failure_resets_connection() {
+    validate_timed_out_query(Timeout::transaction(Some(100))).await;
+}
+
+#[tokio::test]
+async fn validate_command_timeout_failure_resets_connection() {
+    validate_timed_out_query(Timeout::command(Some(100))).await;
+}
+
+#[tokio::test(flavor = "multi_thread", worker_threads = 2)]
+async fn validate_checkout_steals_from_other_shards() {
+    // Two shards of 8 connections
+    let pool = Arc::new(test_pool(2, 16));
+
+    // Threads reuse the idle connection of their home shard, so two idle connections mean
+    // that each shard has one.
+    for _ in 0..64 {
+        if pool.status().status().available == 2 {
+            break;
+        }
+
+        let thread_pool = Arc::clone(&pool);
+        run_on_new_thread(async move {
+            drop(thread_pool.acquire_connection().await.unwrap());
+        });
+    }
+    assert_eq!(pool.status().status().available, 2);
+
+    let thread_pool = Arc::clone(&pool);
+    run_on_new_thread(async move {
+        let mut connections = Vec::new();
+        for _ in 0..8 {
+            connections.push(thread_pool.acquire_connection().await.unwrap());
+        }
+
+        // The home shard is exhausted, the idle connection of the other shard is taken
+        // instead of waiting for one to be returned.
+        let stolen = tokio::time::timeout(Duration::from_secs(5), thread_pool.acquire_connection())
+            .await
+            .expect("Checkout waited on the exhausted home shard")
+            .unwrap();
+        connections.push(stolen);
+
+        let status = thread_pool.status().status();
+        assert_eq!(status.size, 9);
+        assert_eq!(status.available, 0);
+    });
+}
+
+#[tokio::test(flavor = "multi_thread", worker_threads = 2)]
+async fn validate_checkout_grows_other_shards() {
+    // Two shards of 8 connections, none opened yet
+    let pool = Arc::new(test_pool(2, 16));
+
+    let thread_pool = Arc::clone(&pool);
+    run_on_new_thread(async move {
+        let mut connections = Vec::new();
+        for _ in 0..8 {
+            connections.push(thread_pool.acquire_connection().await.unwrap());
+        }
+
+        // The home shard is full and the other shard has no idle connection, a new one is
+        // opened there instead of waiting for one to be returned.
+        let opened = tokio::time::timeout(Duration::from_secs(5), thread_pool.acquire_connection())
+            .await
+            .expect("Checkout waited on the exhausted home shard")
+            .unwrap();
+        connections.push(opened);
+
+        let status = thread_pool.status().status();
+        assert_eq!(status.size, 9);
+        assert_eq!(status.available, 0);
+    });
+}
@@ -0,0 +1,132 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * tests/server_status_tests.rs
+ *
+ *-------------------------------------------------------------------------
+ */
+
+use bson::{doc, Document};
+use mongodb::{error::ErrorKind, Client};
+use uuid::Uuid;
+
+pub mod common;
+
+async fn server_status(client: &Client) -> Document {
+    client
+        .database("admin")
+        .run_command(doc! { "serverStatus": 1 })
+        .await
+        .unwrap()
+}
+
+fn find_latency(status: &Document) -> Option<Document> {
+    status
+        .get_document("opLatencyBreakdown")
+        .unwrap()
+        .get_document("find")
+        .ok()
+        .and_then(|find| find.get_document("processRequest").ok())
+        .cloned()
+}
+
+#[tokio::test]
+async fn validate_latency_breakdown() {
+    let client = common::initialize().await;
+    let db = common::setup_db(&client, "server_status_latency").await;
+    let coll = db.collection("test");
+    coll.insert_many((0..10).map(|i| doc! { "_id": i }))
+        .await
+        .unwrap();
+
+    // Other tests share the gateway, so only the growth of the counts is checked
+    let before = find_latency(&server_status(&client).await)
+        .map(|latency| latency.get_i64("count").unwrap())
+        .unwrap_or(0);
+
+    for i in 0..5 {
+        db.run_command(doc! { "find": "test", "filter": { "_id": i } })
+            .await
+            .unwrap();
+    }
+
+    let status = server_status(&client).await;
+    let latency = find_latency(&status).expect("find latencies should be reported");
+    assert!(latency.get_i64("count").unwrap() >= before + 5);
+
+    let p50 = latency.get_f64("p50Micros").unwrap();
+    let p99 = latency.get_f64("p99Micros").unwrap();
+    let max = latency.get_f64("maxMicros").unwrap();
+    assert!(p50 > 0.0);
+    assert!(p50 <= p99, "{latency:?}");
+    assert!(p99 <= max, "{latency:?}");
+    assert!(latency.get_f64("meanMicros").unwrap() <= max);
+}
+
+#[tokio::test]
+async fn validate_connection_pool_gauges() {
+    let client = common::initialize().await;
+    let db = common::setup_db(&client, "server_status_pools").await;
+    db.run_command(doc! { "find": "test", "filter": {} })
+        .await
+        .unwrap();
+
+    let status = server_status(&client).await;
+    let pools = status.get_array("connectionPools").unwrap();
+    assert!(!pools.is_empty());
+
+    let mut checkouts = 0;
+    for pool in pools {
+        let pool = pool.as_document().unwrap();
+        assert!(!pool.get_str("identifier").unwrap().is_empty());
+        assert!(pool.get_i64("size").unwrap() <= pool.get_i64("maxSize").unwrap());
+        assert!(pool.get_i64("available").unwrap() <= pool.get_i64("size").unwrap());
+
+        let wait = pool.get_document("checkoutWait").unwrap();
+        checkouts += wait.get_i64("count").unwrap();
+        assert!(
+            wait.get_f64("p50Micros").unwrap() <= wait.get_f64("p99Micros").unwrap(),
+            "{wait:?}"
+        );
+        assert!(
+            wait.get_f64("p99Micros").unwrap() <= wait.get_f64("maxMicros").unwrap(),
+            "{wait:?}"
+        );
+    }
+
+    // The find checked a connection out of one of the pools
+    assert!(checkouts > 0);
+}
+
+#[tokio::test]
+async fn validate_server_status_requires_cluster_monitor() {
+    let client = common::initialize().await;
+    let admin = client.database("admin");
+    let username = format!("user_{}", Uuid::new_v4().simple());
+    let password = "Valid$1Pass";
+    admin
+        .run_command(doc! {
+            "createUser": &username,
+            "pwd": password,
+            "roles": [ { "role": "readAnyDatabase", "db": "admin" } ]
+        })
+        .await
+        .unwrap();
+
+    // readAnyDatabase doesn't grant the clusterMonitor privileges
+    let reader = common::get_client_with_credentials(&username, password);
+    let error = reader
+        .database("admin")
+        .run_command(doc! { "serverStatus": 1 })
+        .await
+        .unwrap_err();
+    match *error.kind {
+        ErrorKind::Command(ref command_error) => assert_eq!(command_error.code, 13),
+        ref kind => panic!("Expected an Unauthorized error, got {kind:?}"),
+    }
+
+    admin
+        .run_command(doc! { "dropUser": &username })
+        .await
+        .unwrap();
+}
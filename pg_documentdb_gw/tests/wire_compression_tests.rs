@@ -0,0 +1,275 @@
+/*-------------------------------------------------------------------------
+ * Copyright (c) Microsoft Corporation.  All rights reserved.
+ *
+ * tests/wire_compression_tests.rs
+ *
+ *-------------------------------------------------------------------------
+ */
+
+use std::io::{Read, Write};
+
+use base64::{engine::general_purpose, Engine as _};
+use bson::{doc, rawdoc, spec::BinarySubtype, Binary, RawDocument, RawDocumentBuf};
+use openssl::{hash::MessageDigest, pkcs5::pbkdf2_hmac, pkey::PKey, sha::sha256, sign::Signer};
+use tokio::{
+    io::{AsyncReadExt, AsyncWriteExt},
+    net::TcpStream,
+};
+
+pub mod common;
+
+const OP_COMPRESSED: i32 = 2012;
+const OP_MSG: i32 = 2013;
+const ZLIB: u8 = 2;
+const ZSTD: u8 = 3;
+
+struct WireClient {
+    stream: TcpStream,
+    request_id: i32,
+}
+
+impl WireClient {
+    async fn connect() -> Self {
+        WireClient {
+            stream: TcpStream::connect("127.0.0.1:10260").await.unwrap(),
+            request_id: 0,
+        }
+    }
+
+    // Sends the command as an OP_MSG, wrapped in an OP_COMPRESSED when a compressor is
+    // given, and returns the compressor of the response (if any) with its document.
+    async fn run_command(
+        &mut self,
+        command: &RawDocument,
+        compressor: Option<u8>,
+    ) -> (Option<u8>, RawDocumentBuf) {
+        let mut message = 0u32.to_le_bytes().to_vec();
+        message.push(0);
+        message.extend_from_slice(command.as_bytes());
+
+        self.request_id += 1;
+        let mut request = Vec::new();
+        match compressor {
+            Some(compressor) => {
+                let compressed = compress(compressor, &message);
+                request.extend_from_slice(&((16 + 9 + compressed.len()) as i32).to_le_bytes());
+                request.extend_from_slice(&self.request_id.to_le_bytes());
+                request.extend_from_slice(&0i32.to_le_bytes());
+                request.extend_from_slice(&OP_COMPRESSED.to_le_bytes());
+                request.extend_from_slice(&OP_MSG.to_le_bytes());
+                request.extend_from_slice(&(message.len() as i32).to_le_bytes());
+                request.push(compressor);
+                request.extend_from_slice(&compressed);
+            }
+            None => {
+                request.extend_from_slice(&((16 + message.len()) as i32).to_le_bytes());
+                request.extend_from_slice(&self.request_id.to_le_bytes());
+                request.extend_from_slice(&0i32.to_le_bytes());
+                request.extend_from_slice(&OP_MSG.to_le_bytes());
+                request.extend_from_slice(&message);
+            }
+        }
+        self.stream.write_all(&request).await.unwrap();
+
+        let length = self.stream.read_i32_le().await.unwrap();
+        let _request_id = self.stream.read_i32_le().await.unwrap();
+        let response_to = self.stream.read_i32_le().await.unwrap();
+        let op_code = self.stream.read_i32_le().await.unwrap();
+        assert_eq!(response_to, self.request_id);
+
+        let mut body = vec![0u8; length as usize - 16];
+        self.stream.read_exact(&mut body).await.unwrap();
+
+        let (response_compressor, message) = if op_code == OP_COMPRESSED {
+            let original_op_code = i32::from_le_bytes(body[0..4].try_into().unwrap());
+            let uncompressed_size = i32::from_le_bytes(body[4..8].try_into().unwrap());
+            assert_eq!(original_op_code, OP_MSG);
+
+            let message = decompress(body[8], &body[9..]);
+            assert_eq!(message.len(), uncompressed_size as usize);
+            (Some(body[8]), message)
+        } else {
+            assert_eq!(op_code, OP_MSG);
+            (None, body)
+        };
+
+        // Flags and the kind of the single document section
+        let document = RawDocumentBuf::from_bytes(message[5..].to_vec()).unwrap();
+        (response_compressor, document)
+    }
+
+    // Authenticates as the test user with SCRAM-SHA-256.
+    async fn authenticate(&mut self) {
+        let client_nonce = general_purpose::STANDARD.encode(uuid::Uuid::new_v4().as_bytes());
+        let client_first_bare = format!("n=test,r={client_nonce}");
+        let (_, response) = self
+            .run_command(
+                &rawdoc! {
+                    "saslStart": 1,
+                    "mechanism": "SCRAM-SHA-256",
+                    "payload": sasl_payload(&format!("n,,{client_first_bare}")),
+                    "$db": "admin",
+                },
+                None,
+            )
+            .await;
+
+        let server_first =
+            String::from_utf8(response.get_binary("payload").unwrap().bytes.to_vec()).unwrap();
+        let field = |name: &str| {
+            server_first
+                .split(',')
+                .find_map(|field| field.strip_prefix(name))
+                .unwrap()
+                .to_string()
+        };
+        let nonce = field("r=");
+        let salt = general_purpose::STANDARD.decode(field("s=")).unwrap();
+        let iterations: usize = field("i=").parse().unwrap();
+
+        let mut salted_password = [0u8; 32];
+        pbkdf2_hmac(
+            b"test",
+            &salt,
+            iterations,
+            MessageDigest::sha256(),
+            &mut salted_password,
+        )
+        .unwrap();
+        let client_key = hmac(&salted_password, b"Client Key");
+        let stored_key = sha256(&client_key);
+
+        let client_final_without_proof = format!("c=biws,r={nonce}");
+        let auth_message =
+            format!("{client_first_bare},{server_first},{client_final_without_proof}");
+        let client_signature = hmac(&stored_key, auth_message.as_bytes());
+        let proof: Vec<u8> = client_key
+            .iter()
+            .zip(client_signature)
+            .map(|(key, signature)| key ^ signature)
+            .collect();
+
+        let (_, response) = self
+            .run_command(
+                &rawdoc! {
+                    "saslContinue": 1,
+                    "conversationId": 1,
+                    "payload": sasl_payload(&format!(
+                        "{client_final_without_proof},p={}",
+                        general_purpose::STANDARD.encode(proof)
+                    )),
+                    "$db": "admin",
+                },
+                None,
+            )
+            .await;
+        assert_eq!(response.get_f64("ok").unwrap(), 1.0, "{response:?}");
+    }
+}
+
+fn sasl_payload(payload: &str) -> Binary {
+    Binary {
+        subtype: BinarySubtype::Generic,
+        bytes: payload.as_bytes().to_vec(),
+    }
+}
+
+fn hmac(key: &[u8], data: &[u8]) -> Vec<u8> {
+    let key = PKey::hmac(key).unwrap();
+    let mut signer = Signer::new(MessageDigest::sha256(), &key).unwrap();
+    signer.update(data).unwrap();
+    signer.sign_to_vec().unwrap()
+}
+
+fn compress(compressor: u8, data: &[u8]) -> Vec<u8> {
+    match compressor {
+        ZLIB => {
+            let mut encoder =
+                flate2::write::ZlibEncoder::new(Vec::new(), flate2::Compression::default());
+            encoder.write_all(data).unwrap();
+            encoder.finish().unwrap()
+        }
+        ZSTD => zstd::bulk::compress(data, 0).unwrap(),
+        _ => unreachable!(),
+    }
+}
+
+fn decompress(compressor: u8, data: &[u8]) -> Vec<u8> {
+    let mut message = Vec::new();
+    match compressor {
+        ZLIB => {
+            flate2::read::ZlibDecoder::new(data)
+                .read_to_end(&mut message)
+                .unwrap();
+        }
+        ZSTD => message = zstd::stream::decode_all(data).unwrap(),
+        compressor => panic!("Unexpected response compressor {compressor}"),
+    }
+    message
+}
+
+async fn validate_compressed_requests(compressor: u8, name: &str) {
+    let db = common::initialize_with_db(&format!("wire_compression_{name}")).await;
+    let coll = db.collection("test");
+    coll.insert_many((0..10).map(|i| doc! { "_id": i, "payload": "x".repeat(1000) }))
+        .await
+        .unwrap();
+
+    let mut client = WireClient::connect().await;
+    let (_, hello) = client
+        .run_command(
+            &rawdoc! { "hello": 1, "compression": [name], "$db": "admin" },
+            None,
+        )
+        .await;
+    let negotiated: Vec<&str> = hello
+        .get_array("compression")
+        .unwrap()
+        .into_iter()
+        .map(|value| value.unwrap().as_str().unwrap())
+        .collect();
+    assert_eq!(negotiated, vec![name]);
+
+    client.authenticate().await;
+
+    // Large responses to compressed requests come back with the same compressor
+    let (response_compressor, response) = client
+        .run_command(
+            &rawdoc! { "find": "test", "filter": {}, "$db": db.name() },
+            Some(compressor),
+        )
+        .await;
+    assert_eq!(response_compressor, Some(compressor));
+    let first_batch = response
+        .get_document("cursor")
+        .unwrap()
+        .get_array("firstBatch")
+        .unwrap();
+    assert_eq!(first_batch.into_iter().count(), 10);
+
+    // Small ones are not worth compressing
+    let (response_compressor, response) = client
+        .run_command(&rawdoc! { "ping": 1, "$db": "admin" }, Some(compressor))
+        .await;
+    assert_eq!(response_compressor, None);
+    assert_eq!(response.get_f64("ok").unwrap(), 1.0);
+
+    // Nor are responses to uncompressed requests
+    let (response_compressor, _) = client
+        .run_command(
+            &rawdoc! { "find": "test", "filter": {}, "$db": db.name() },
+            None,
+        )
+        .await;
+    assert_eq!(response_compressor, None);
+}
+
+#[tokio::test]
+async fn validate_zlib_compressed_requests() {
+    validate_compressed_requests(ZLIB, "zlib").await;
+}
+
+#[tokio::test]
+async fn validate_zstd_compressed_requests() {
+    validate_compressed_requests(ZSTD, "zstd").await;
+}